@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AAudioCommandRing"
+//#define LOG_NDEBUG 0
+#include <utils/Log.h>
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binding/AAudioCommandRing.h"
+#include "utility/AudioClock.h"
+
+using namespace aaudio;
+
+// The memory is shared with another process, so the futexes cannot be private.
+static void futexWait(std::atomic<uint32_t> *address, uint32_t value, int64_t timeoutNanos) {
+    struct timespec time;
+    struct timespec *timePtr = nullptr;
+    if (timeoutNanos >= 0) {
+        time.tv_sec = timeoutNanos / AAUDIO_NANOS_PER_SECOND;
+        time.tv_nsec = timeoutNanos - (time.tv_sec * AAUDIO_NANOS_PER_SECOND);
+        timePtr = &time;
+    }
+    (void) syscall(SYS_futex, address, FUTEX_WAIT, value, timePtr, NULL, 0);
+}
+
+static void futexWake(std::atomic<uint32_t> *address, int count) {
+    (void) syscall(SYS_futex, address, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+aaudio_result_t AAudioCommandFuture::wait(int64_t timeoutNanos) {
+    if (!isValid()) {
+        return AAUDIO_ERROR_INVALID_STATE;
+    }
+    const uint32_t pending = mSequence << 1;
+    const uint32_t done = pending | 1;
+    const int64_t deadlineNanos = AudioClock::getNanoseconds() + timeoutNanos;
+    while (true) {
+        const uint32_t state = mSlot->state.load(std::memory_order_acquire);
+        if (state == done) {
+            return mSlot->result;
+        } else if (state != pending) {
+            ALOGE("%s() command %u was overwritten", __func__, mSequence);
+            return AAUDIO_ERROR_INTERNAL;
+        }
+        const int64_t remainingNanos = deadlineNanos - AudioClock::getNanoseconds();
+        if (remainingNanos <= 0) {
+            ALOGW("%s() command %u timed out", __func__, mSequence);
+            return AAUDIO_ERROR_TIMEOUT;
+        }
+        futexWait(&mSlot->state, state, remainingNanos);
+    }
+}
+
+aaudio_result_t AAudioCommandRing::configure(const RingBufferDescriptor &descriptor) {
+    if (descriptor.bytesPerFrame != kBytesPerFrame
+            || descriptor.capacityInFrames != kCapacityInFrames
+            || descriptor.dataAddress == nullptr
+            || descriptor.readCounterAddress == nullptr
+            || descriptor.writeCounterAddress == nullptr) {
+        ALOGV("%s() no command ring, capacity = %d", __func__, descriptor.capacityInFrames);
+        return AAUDIO_ERROR_UNIMPLEMENTED;
+    }
+    if (reinterpret_cast<uintptr_t>(descriptor.dataAddress) % alignof(AAudioCommandRingData)
+            != 0) {
+        ALOGE("%s() misaligned data %p", __func__, descriptor.dataAddress);
+        return AAUDIO_ERROR_UNIMPLEMENTED;
+    }
+    mData = reinterpret_cast<AAudioCommandRingData *>(descriptor.dataAddress);
+    mReadCounter = reinterpret_cast<std::atomic<int64_t> *>(descriptor.readCounterAddress);
+    mWriteCounter = reinterpret_cast<std::atomic<int64_t> *>(descriptor.writeCounterAddress);
+    return AAUDIO_OK;
+}
+
+AAudioCommandFuture AAudioCommandRing::send(aaudio_client_command_t command) {
+    if (!isConfigured() || mData->closed.load(std::memory_order_acquire) != 0) {
+        return AAudioCommandFuture();
+    }
+    // The service advances the read counter when the command is done,
+    // so a slot is free when the ring is not full.
+    const int64_t writeIndex = mWriteCounter->load(std::memory_order_relaxed);
+    const int64_t readIndex = mReadCounter->load(std::memory_order_acquire);
+    const uint64_t pending = (uint64_t) writeIndex - (uint64_t) readIndex;
+    if (pending >= kCapacity) {
+        ALOGW("%s() ring is full, %llu commands not done",
+              __func__, (unsigned long long) pending);
+        return AAudioCommandFuture();
+    }
+    AAudioCommandSlot *slot = getSlot(writeIndex);
+    const uint32_t sequence = sequenceOf(writeIndex);
+    slot->command = command;
+    slot->result = AAUDIO_OK;
+    slot->state.store(sequence << 1, std::memory_order_release);
+    mWriteCounter->store(nextIndex(writeIndex), std::memory_order_release);
+    ringDoorbell();
+    // The service may have closed the ring after the check above, and then not seen this
+    // command. Pairs with the fence in close(): either close() completes the command,
+    // or the client sees that the ring is closed.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (mData->closed.load(std::memory_order_relaxed) != 0
+            && slot->state.load(std::memory_order_acquire) != ((sequence << 1) | 1)) {
+        // The service no longer executes commands, so it is safe to send this one with Binder.
+        ALOGD("%s() ring closed while sending command %u", __func__, sequence);
+        return AAudioCommandFuture();
+    }
+    return AAudioCommandFuture(slot, sequence);
+}
+
+uint32_t AAudioCommandRing::getDoorbell() const {
+    return mData->doorbell.load(std::memory_order_acquire);
+}
+
+void AAudioCommandRing::ringDoorbell() {
+    mData->doorbell.fetch_add(1, std::memory_order_acq_rel);
+    futexWake(&mData->doorbell, 1);
+}
+
+void AAudioCommandRing::waitForDoorbell(uint32_t doorbell, int64_t timeoutNanos) const {
+    futexWait(&mData->doorbell, doorbell, timeoutNanos);
+}
+
+bool AAudioCommandRing::hasCommand() const {
+    return mWriteCounter->load(std::memory_order_acquire) != mServiceReadIndex;
+}
+
+bool AAudioCommandRing::take(Command *command) {
+    // The read counter is in shared memory too, so the service uses its own copy.
+    const int64_t readIndex = mServiceReadIndex;
+    const int64_t writeIndex = mWriteCounter->load(std::memory_order_acquire);
+    const uint64_t pending = (uint64_t) writeIndex - (uint64_t) readIndex;
+    if (pending == 0) {
+        return false;
+    } else if (pending > kCapacity) {
+        ALOGE("%s() corrupted by the client, read = %lld, write = %lld, dropped",
+              __func__, (long long) readIndex, (long long) writeIndex);
+        mServiceReadIndex = writeIndex;
+        mReadCounter->store(writeIndex, std::memory_order_release);
+        return false;
+    }
+    const AAudioCommandSlot *slot = getSlot(readIndex);
+    command->index = readIndex;
+    // Read the command only once because the client can change it at any time.
+    command->command = static_cast<aaudio_client_command_t>(
+            reinterpret_cast<const volatile uint32_t &>(slot->command));
+    return true;
+}
+
+void AAudioCommandRing::complete(const Command &command, aaudio_result_t result) {
+    AAudioCommandSlot *slot = getSlot(command.index);
+    slot->result = result;
+    slot->state.store((sequenceOf(command.index) << 1) | 1, std::memory_order_release);
+    mServiceReadIndex = nextIndex(command.index);
+    mReadCounter->store(mServiceReadIndex, std::memory_order_release);
+    futexWake(&slot->state, INT_MAX);
+}
+
+void AAudioCommandRing::close(aaudio_result_t result) {
+    if (!isConfigured()) {
+        return;
+    }
+    mData->closed.store(1, std::memory_order_release);
+    // Pairs with the fence in send().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // The client may keep sending, so only the commands in the ring are completed.
+    Command command;
+    for (int32_t i = 0; i < kCapacity && take(&command); i++) {
+        complete(command, result);
+    }
+}
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AAUDIO_AAUDIO_COMMAND_RING_H
+#define ANDROID_AAUDIO_AAUDIO_COMMAND_RING_H
+
+#include <atomic>
+#include <stdint.h>
+
+#include <aaudio/AAudio.h>
+
+#include "binding/AAudioServiceDefinitions.h"
+#include "binding/AAudioServiceMessage.h"
+
+namespace aaudio {
+
+// One command in shared memory.
+struct AAudioCommandSlot {
+    // Futex: sequence << 1 when the command is written, (sequence << 1) | 1 when it is done.
+    std::atomic<uint32_t> state;
+    uint32_t command;           // aaudio_client_command_t, written by the client
+    int32_t  result;            // aaudio_result_t, written by the service
+    uint32_t reserved;
+};
+
+class AAudioCommandRing;
+
+/**
+ * The completion of a command sent through an AAudioCommandRing.
+ */
+class AAudioCommandFuture {
+public:
+    AAudioCommandFuture() = default;
+
+    /**
+     * @return true if the command was sent, false if the ring was not available
+     */
+    bool isValid() const {
+        return mSlot != nullptr;
+    }
+
+    /**
+     * Wait for the service to execute the command.
+     *
+     * @param timeoutNanos maximum time to wait
+     * @return the result of the command, AAUDIO_ERROR_TIMEOUT if the service did not execute it
+     *         in time, or AAUDIO_ERROR_INVALID_STATE if the command was not sent
+     */
+    aaudio_result_t wait(int64_t timeoutNanos);
+
+private:
+    friend class AAudioCommandRing;
+
+    AAudioCommandFuture(AAudioCommandSlot *slot, uint32_t sequence)
+            : mSlot(slot), mSequence(sequence) {}
+
+    AAudioCommandSlot *mSlot = nullptr;
+    uint32_t           mSequence = 0;
+};
+
+/**
+ * A ring of control commands in shared memory, from the client to the service.
+ *
+ * This lets the client start, pause, stop and flush a stream without a Binder call.
+ * The client writes a command in the next slot and rings a doorbell, which is a futex that
+ * the service command thread waits on. The service executes the command and writes the result
+ * in the slot, which is a futex that the client waits on.
+ *
+ * The shared memory is a RingBufferDescriptor whose data holds AAudioCommandRingData:
+ *  - the write counter is the number of commands sent by the client,
+ *  - the read counter is the number of commands done by the service.
+ * The service must not trust anything that the client writes in the shared memory.
+ *
+ * The client side is safe for one thread at a time, such as a thread holding the stream lock.
+ * The service side is safe for one thread, the command thread of the stream,
+ * except for ringDoorbell(), which can be called by any thread of the service.
+ */
+class AAudioCommandRing {
+public:
+    static constexpr int32_t kCapacity = 4; // commands in flight
+
+    // The data starts with a header the size of a slot, so it can be allocated as frames.
+    static constexpr int32_t kBytesPerFrame = sizeof(AAudioCommandSlot);
+    static constexpr int32_t kCapacityInFrames = kCapacity + 1;
+
+    struct Command {
+        int64_t                 index;
+        aaudio_client_command_t command;
+    };
+
+    AAudioCommandRing() = default;
+
+    /**
+     * @param descriptor shared memory allocated with kBytesPerFrame and kCapacityInFrames
+     * @return AAUDIO_OK, or AAUDIO_ERROR_UNIMPLEMENTED if the descriptor does not match,
+     *         for example if the service does not provide a command ring
+     */
+    aaudio_result_t configure(const RingBufferDescriptor &descriptor);
+
+    bool isConfigured() const {
+        return mData != nullptr;
+    }
+
+    // ================ client side ================
+
+    /**
+     * Send a command to the service, without waiting.
+     *
+     * @return the future result of the command, which is not valid if the ring is full,
+     *         for example because a previous command timed out, or if the service closed it,
+     *         even while the command was being sent. The command must then be sent with Binder.
+     */
+    AAudioCommandFuture send(aaudio_client_command_t command);
+
+    // ================ service side ================
+
+    /**
+     * @return the doorbell, to pass to waitForDoorbell() after checking for commands
+     */
+    uint32_t getDoorbell() const;
+
+    /**
+     * Wake up the thread waiting for the doorbell.
+     */
+    void ringDoorbell();
+
+    /**
+     * Wait until the doorbell changes from the value returned by getDoorbell(),
+     * or until the timeout.
+     *
+     * @param doorbell value returned by getDoorbell()
+     * @param timeoutNanos maximum time to wait, or negative to wait forever
+     */
+    void waitForDoorbell(uint32_t doorbell, int64_t timeoutNanos) const;
+
+    /**
+     * @return true if a command can be taken
+     */
+    bool hasCommand() const;
+
+    /**
+     * Take the next command sent by the client.
+     * If the client corrupted the ring, the pending commands are dropped.
+     * Each command must be completed before the next one is taken.
+     *
+     * @param command the command to execute, then pass to complete()
+     * @return true if a command was taken
+     */
+    bool take(Command *command);
+
+    /**
+     * Write the result of a command taken by take() and wake up the client.
+     */
+    void complete(const Command &command, aaudio_result_t result);
+
+    /**
+     * Complete the pending commands with the result, and refuse new commands so that
+     * the client falls back to Binder. Called when the service stops taking commands.
+     */
+    void close(aaudio_result_t result);
+
+private:
+    struct AAudioCommandRingData {
+        std::atomic<uint32_t> doorbell;   // futex, incremented for each command
+        std::atomic<uint32_t> closed;     // set by the service, never cleared
+        uint32_t              reserved[2];
+        AAudioCommandSlot     slots[kCapacity];
+    };
+    static_assert(sizeof(AAudioCommandRingData) == kBytesPerFrame * kCapacityInFrames);
+
+    static uint32_t sequenceOf(int64_t index) {
+        return (uint32_t) nextIndex(index); // so that a zeroed slot is not pending
+    }
+
+    // The counters may be corrupted by the client, so they wrap instead of overflowing.
+    static int64_t nextIndex(int64_t index) {
+        return (int64_t) ((uint64_t) index + 1);
+    }
+
+    // The index may come from the other process, so it may be negative.
+    AAudioCommandSlot *getSlot(int64_t index) const {
+        return &mData->slots[(uint64_t) index % kCapacity];
+    }
+
+    AAudioCommandRingData        *mData = nullptr;
+    std::atomic<int64_t>         *mReadCounter = nullptr;   // commands done by the service
+    std::atomic<int64_t>         *mWriteCounter = nullptr;  // commands sent by the client
+    int64_t                       mServiceReadIndex = 0;    // only used by the service
+};
+
+} /* namespace aaudio */
+
+#endif //ANDROID_AAUDIO_AAUDIO_COMMAND_RING_H
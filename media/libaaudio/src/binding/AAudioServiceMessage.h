@@ -68,6 +68,16 @@ typedef struct AAudioServiceMessage_s {
     };
 } AAudioServiceMessage;
 
+// Used by the client to control the stream through shared memory, see AAudioCommandRing.
+// These are the commands that the client may send without Binder.
+typedef enum aaudio_client_command_e : uint32_t {
+    AAUDIO_CLIENT_COMMAND_START,
+    AAUDIO_CLIENT_COMMAND_PAUSE,
+    AAUDIO_CLIENT_COMMAND_STOP,
+    AAUDIO_CLIENT_COMMAND_FLUSH,
+    AAUDIO_CLIENT_COMMAND_COUNT // not a command
+} aaudio_client_command_t;
+
 } /* namespace aaudio */
 
 #endif //ANDROID_AAUDIO_AAUDIO_SERVICE_MESSAGE_H
@@ -67,6 +67,8 @@ AAudioStreamConfiguration::AAudioStreamConfiguration(const StreamParameters& par
 
     static_assert(sizeof(aaudio_input_preset_t) == sizeof(parcelable.inputPreset));
     setInputPreset(parcelable.inputPreset);
+    static_assert(sizeof(aaudio_performance_mode_t) == sizeof(parcelable.performanceMode));
+    setPerformanceMode(parcelable.performanceMode);
     setBufferCapacity(parcelable.bufferCapacity);
     static_assert(
             sizeof(aaudio_allowed_capture_policy_t) == sizeof(parcelable.allowedCapturePolicy));
@@ -131,6 +133,8 @@ StreamParameters AAudioStreamConfiguration::parcelable() const {
     result.isContentSpatialized = isContentSpatialized();
     static_assert(sizeof(aaudio_input_preset_t) == sizeof(result.inputPreset));
     result.inputPreset = getInputPreset();
+    static_assert(sizeof(aaudio_performance_mode_t) == sizeof(result.performanceMode));
+    result.performanceMode = getPerformanceMode();
     result.bufferCapacity = getBufferCapacity();
     static_assert(sizeof(aaudio_allowed_capture_policy_t) == sizeof(result.allowedCapturePolicy));
     result.allowedCapturePolicy = getAllowedCapturePolicy();
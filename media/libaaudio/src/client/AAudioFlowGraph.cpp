@@ -18,6 +18,8 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
+
 #include "AAudioFlowGraph.h"
 
 #include <flowgraph/Limiter.h>
@@ -48,7 +50,8 @@ aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
                           bool useMonoBlend,
                           bool useVolumeRamps,
                           float audioBalance,
-                          aaudio::resampler::MultiChannelResampler::Quality resamplerQuality) {
+                          aaudio::resampler::MultiChannelResampler::Quality resamplerQuality,
+                          bool allowFusedKernel) {
     FlowGraphPortFloatOutput *lastOutput = nullptr;
 
     ALOGD("%s() source format = 0x%08x, channels = %d, sample rate = %d, "
@@ -153,19 +156,75 @@ aaudio_result_t AAudioFlowGraph::configure(audio_format_t sourceFormat,
     }
     lastOutput->connect(&mSink->input);
 
+    // The nodes are still connected, to hold the volume ramps and to support reset().
+    if (allowFusedKernel && sourceSampleRate == sinkSampleRate && !useMonoBlend) {
+        mFusedKernel = aaudio::getFusedKernel(sourceFormat, sinkFormat,
+                sourceChannelCount != sinkChannelCount, useVolumeRamps);
+        mSourceBytesPerFrame = sourceChannelCount * audio_bytes_per_sample(sourceFormat);
+        mSinkBytesPerFrame = sinkChannelCount * audio_bytes_per_sample(sinkFormat);
+        mSinkChannelCount = sinkChannelCount;
+        mFusedGains.resize(mVolumeRamps.size());
+    }
+    ALOGD("%s() fused = %d", __func__, isFused());
+
     return AAUDIO_OK;
 }
 
 int32_t AAudioFlowGraph::pull(void *destination, int32_t targetFramesToRead) {
+    if (isFused()) {
+        return pullFused(destination, targetFramesToRead);
+    }
     return mSink->read(destination, targetFramesToRead);
 }
 
 int32_t AAudioFlowGraph::process(const void *source, int32_t numFramesToWrite, void *destination,
                     int32_t targetFramesToRead) {
+    if (isFused()) {
+        mFusedSource = static_cast<const uint8_t *>(source);
+        mFusedFramesLeft = numFramesToWrite;
+        return pullFused(destination, targetFramesToRead);
+    }
     mSource->setData(source, numFramesToWrite);
     return mSink->read(destination, targetFramesToRead);
 }
 
+int32_t AAudioFlowGraph::pullFused(void *destination, int32_t targetFramesToRead) {
+    const int32_t framesToRead = std::min(targetFramesToRead, mFusedFramesLeft);
+    if (framesToRead <= 0) {
+        return 0;
+    }
+    uint8_t *sink = static_cast<uint8_t *>(destination);
+    int32_t framesLeft = framesToRead;
+
+    if (!mVolumeRamps.empty()) {
+        int32_t rampFrames = 0;
+        for (auto& ramp : mVolumeRamps) {
+            rampFrames = std::max(rampFrames, ramp->startFrames());
+        }
+        // Ramping? This doesn't happen very often, so run the kernel one frame at a time.
+        rampFrames = std::min(rampFrames, framesLeft);
+        for (int32_t frame = 0; frame < rampFrames; frame++) {
+            for (size_t i = 0; i < mVolumeRamps.size(); i++) {
+                mFusedGains[i] = mVolumeRamps[i]->nextLevel();
+            }
+            mFusedKernel(mFusedSource, sink, 1 /* numFrames */, mSinkChannelCount,
+                         mFusedGains.data(), &mLastValidOutput);
+            mFusedSource += mSourceBytesPerFrame;
+            sink += mSinkBytesPerFrame;
+        }
+        framesLeft -= rampFrames;
+        for (size_t i = 0; i < mVolumeRamps.size(); i++) {
+            mFusedGains[i] = mVolumeRamps[i]->getLevel();
+        }
+    }
+
+    mFusedKernel(mFusedSource, sink, framesLeft, mSinkChannelCount,
+                 mFusedGains.data(), &mLastValidOutput);
+    mFusedSource += framesLeft * mSourceBytesPerFrame;
+    mFusedFramesLeft -= framesToRead;
+    return framesToRead;
+}
+
 /**
  * @param volume between 0.0 and 1.0
  */
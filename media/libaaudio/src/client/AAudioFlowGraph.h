@@ -32,11 +32,18 @@
 #include <flowgraph/RampLinear.h>
 #include <flowgraph/SampleRateConverter.h>
 
+#include "AAudioFusedKernels.h"
+
 class AAudioFlowGraph {
 public:
     /** Connect several modules together to convert from source to sink.
      * This should only be called once for each instance.
      *
+     * If the graph has no sample rate conversion and no mono blend, then all of its
+     * nodes are pointwise, and they are run as a single fused kernel, see AAudioFusedKernel.
+     * The output is the same, except that a change of volume is picked up at the start
+     * of each process() or pull() rather than within it.
+     *
      * @param sourceFormat
      * @param sourceChannelCount
      * @param sourceSampleRate
@@ -47,6 +54,7 @@ public:
      * @param useVolumeRamps
      * @param audioBalance
      * @param resamplerQuality
+     * @param allowFusedKernel false to always run the nodes one by one, for comparison
      * @return
      */
     aaudio_result_t configure(audio_format_t sourceFormat,
@@ -58,7 +66,12 @@ public:
                               bool useMonoBlend,
                               bool useVolumeRamps,
                               float audioBalance,
-                              aaudio::resampler::MultiChannelResampler::Quality resamplerQuality);
+                              aaudio::resampler::MultiChannelResampler::Quality resamplerQuality,
+                              bool allowFusedKernel = true);
+
+    bool isFused() const {
+        return mFusedKernel != nullptr;
+    }
 
     /**
      * Attempt to read targetFramesToRead from the flowgraph.
@@ -88,6 +101,9 @@ public:
      *
      * TODO: b/289510598 - Calculate the exact number of input frames needed for Y output frames.
      *
+     * If isFused(), one frame is written for each frame read, and a call converts any number
+     * of frames in one pass, so callers should pass all the frames they have.
+     *
      * @param source
      * @param numFramesToWrite
      * @param destination
@@ -113,6 +129,8 @@ public:
     void setRampLengthInFrames(int32_t numFrames);
 
 private:
+    int32_t pullFused(void *destination, int32_t targetFramesToRead);
+
     std::unique_ptr<FLOWGRAPH_OUTER_NAMESPACE::flowgraph::FlowGraphSourceBuffered> mSource;
     std::unique_ptr<RESAMPLER_OUTER_NAMESPACE::resampler::MultiChannelResampler> mResampler;
     std::unique_ptr<FLOWGRAPH_OUTER_NAMESPACE::flowgraph::SampleRateConverter> mRateConverter;
@@ -128,6 +146,16 @@ private:
     float mTargetVolume = 1.0f;
     android::audio_utils::Balance mBalance;
     std::unique_ptr<FLOWGRAPH_OUTER_NAMESPACE::flowgraph::FlowGraphSink> mSink;
+
+    // Used instead of the nodes from mSource to mSink, when not null.
+    aaudio::AAudioFusedKernel mFusedKernel = nullptr;
+    const uint8_t *mFusedSource = nullptr;
+    int32_t mFusedFramesLeft = 0;
+    int32_t mSourceBytesPerFrame = 0;
+    int32_t mSinkBytesPerFrame = 0;
+    int32_t mSinkChannelCount = 0;
+    std::vector<float> mFusedGains;     // current level of each of mVolumeRamps
+    float mLastValidOutput = 0.0f;      // state of the fused Limiter
 };
 
 
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+
+#include <audio_utils/primitives.h>
+#include <flowgraph/Limiter.h>
+
+#include "AAudioFusedKernels.h"
+
+using namespace aaudio;
+using FLOWGRAPH_OUTER_NAMESPACE::flowgraph::Limiter;
+
+namespace {
+
+// Sample conversions, matching the memcpy_to_*() functions used by the Source and Sink nodes.
+template <audio_format_t FORMAT>
+struct FusedSample;
+
+template <>
+struct FusedSample<AUDIO_FORMAT_PCM_FLOAT> {
+    static float read(const void *data, int32_t index) {
+        return static_cast<const float *>(data)[index];
+    }
+    static void write(void *data, int32_t index, float value) {
+        static_cast<float *>(data)[index] = value;
+    }
+};
+
+template <>
+struct FusedSample<AUDIO_FORMAT_PCM_16_BIT> {
+    static float read(const void *data, int32_t index) {
+        return float_from_i16(static_cast<const int16_t *>(data)[index]);
+    }
+    static void write(void *data, int32_t index, float value) {
+        static_cast<int16_t *>(data)[index] = clamp16_from_float(value);
+    }
+};
+
+template <>
+struct FusedSample<AUDIO_FORMAT_PCM_24_BIT_PACKED> {
+    static float read(const void *data, int32_t index) {
+        return float_from_p24(static_cast<const uint8_t *>(data) + index * 3);
+    }
+    static void write(void *data, int32_t index, float value) {
+        const int32_t packed = clamp24_from_float(value);
+        uint8_t *bytes = static_cast<uint8_t *>(data) + index * 3;
+        // Little Endian, as memcpy_to_p24_from_float().
+        bytes[0] = packed;
+        bytes[1] = packed >> 8;
+        bytes[2] = packed >> 16;
+    }
+};
+
+template <>
+struct FusedSample<AUDIO_FORMAT_PCM_32_BIT> {
+    static float read(const void *data, int32_t index) {
+        return float_from_i32(static_cast<const int32_t *>(data)[index]);
+    }
+    static void write(void *data, int32_t index, float value) {
+        static_cast<int32_t *>(data)[index] = clamp32_from_float(value);
+    }
+};
+
+template <>
+struct FusedSample<AUDIO_FORMAT_PCM_8_24_BIT> {
+    static float read(const void *data, int32_t index) {
+        return float_from_q8_23(static_cast<const int32_t *>(data)[index]);
+    }
+    static void write(void *data, int32_t index, float value) {
+        static_cast<int32_t *>(data)[index] = clamp24_from_float(value);
+    }
+};
+
+template <audio_format_t SOURCE, audio_format_t SINK, bool MONO_TO_MULTI, bool GAINS>
+void fusedKernel(const void *source, void *destination, int32_t numFrames,
+                 int32_t sinkChannelCount, const float *gains, float *lastValidOutput) {
+    // AAudioFlowGraph only inserts a Limiter in a float to float graph.
+    constexpr bool kLimit = SOURCE == AUDIO_FORMAT_PCM_FLOAT && SINK == AUDIO_FORMAT_PCM_FLOAT;
+    float lastValid = *lastValidOutput;
+    int32_t sourceIndex = 0;
+    int32_t sinkIndex = 0;
+    for (int32_t frame = 0; frame < numFrames; frame++) {
+        float sample = 0.0f;
+        for (int32_t channel = 0; channel < sinkChannelCount; channel++) {
+            if (!MONO_TO_MULTI || channel == 0) {
+                sample = FusedSample<SOURCE>::read(source, sourceIndex++);
+                if constexpr (kLimit) {
+                    // Use the previous valid output for NaN inputs, as the Limiter.
+                    if (!isnan(sample)) {
+                        lastValid = Limiter::processFloat(sample);
+                    }
+                    sample = lastValid;
+                }
+            }
+            float value = sample;
+            if constexpr (GAINS) {
+                value *= gains[channel];
+            }
+            FusedSample<SINK>::write(destination, sinkIndex++, value);
+        }
+    }
+    *lastValidOutput = lastValid;
+}
+
+template <audio_format_t SOURCE, audio_format_t SINK>
+AAudioFusedKernel selectKernel(bool monoToMulti, bool applyGains) {
+    if (monoToMulti) {
+        return applyGains ? fusedKernel<SOURCE, SINK, true, true>
+                : fusedKernel<SOURCE, SINK, true, false>;
+    }
+    return applyGains ? fusedKernel<SOURCE, SINK, false, true>
+            : fusedKernel<SOURCE, SINK, false, false>;
+}
+
+template <audio_format_t SOURCE>
+AAudioFusedKernel selectKernel(audio_format_t sinkFormat, bool monoToMulti, bool applyGains) {
+    switch (sinkFormat) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+            return selectKernel<SOURCE, AUDIO_FORMAT_PCM_FLOAT>(monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_16_BIT:
+            return selectKernel<SOURCE, AUDIO_FORMAT_PCM_16_BIT>(monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            return selectKernel<SOURCE, AUDIO_FORMAT_PCM_24_BIT_PACKED>(monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_32_BIT:
+            return selectKernel<SOURCE, AUDIO_FORMAT_PCM_32_BIT>(monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_8_24_BIT:
+            return selectKernel<SOURCE, AUDIO_FORMAT_PCM_8_24_BIT>(monoToMulti, applyGains);
+        default:
+            return nullptr;
+    }
+}
+
+} // namespace
+
+AAudioFusedKernel aaudio::getFusedKernel(audio_format_t sourceFormat, audio_format_t sinkFormat,
+                                         bool monoToMulti, bool applyGains) {
+    switch (sourceFormat) {
+        case AUDIO_FORMAT_PCM_FLOAT:
+            return selectKernel<AUDIO_FORMAT_PCM_FLOAT>(sinkFormat, monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_16_BIT:
+            return selectKernel<AUDIO_FORMAT_PCM_16_BIT>(sinkFormat, monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+            return selectKernel<AUDIO_FORMAT_PCM_24_BIT_PACKED>(sinkFormat, monoToMulti,
+                                                                applyGains);
+        case AUDIO_FORMAT_PCM_32_BIT:
+            return selectKernel<AUDIO_FORMAT_PCM_32_BIT>(sinkFormat, monoToMulti, applyGains);
+        case AUDIO_FORMAT_PCM_8_24_BIT:
+            return selectKernel<AUDIO_FORMAT_PCM_8_24_BIT>(sinkFormat, monoToMulti, applyGains);
+        default:
+            return nullptr;
+    }
+}
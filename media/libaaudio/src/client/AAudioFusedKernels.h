@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AAUDIO_FUSED_KERNELS_H
+#define ANDROID_AAUDIO_FUSED_KERNELS_H
+
+#include <stdint.h>
+#include <system/audio.h>
+
+namespace aaudio {
+
+/**
+ * A fused kernel runs the pointwise nodes of an AAudioFlowGraph in a single pass
+ * over the data, instead of one pass per node through the node buffers:
+ *     source format conversion
+ *     -> Limiter, for a float to float graph
+ *     -> MonoToMultiConverter, if the source is mono and the sink is not
+ *     -> one RampLinear per sink channel, if the graph uses volume ramps
+ *     -> sink format conversion, with clipping.
+ * The output is identical to the output of the nodes.
+ *
+ * @param source frames in the source format
+ * @param destination frames in the sink format
+ * @param numFrames to convert
+ * @param sinkChannelCount the source has the same channel count, or is mono
+ * @param gains for each sink channel, ignored if the kernel does not apply gains
+ * @param lastValidOutput limiter output for the last sample that was not NaN, updated
+ */
+using AAudioFusedKernel = void (*)(const void *source, void *destination, int32_t numFrames,
+                                   int32_t sinkChannelCount, const float *gains,
+                                   float *lastValidOutput);
+
+/**
+ * @return the fused kernel for this configuration, or nullptr if a format is not supported
+ */
+AAudioFusedKernel getFusedKernel(audio_format_t sourceFormat, audio_format_t sinkFormat,
+                                 bool monoToMulti, bool applyGains);
+
+} // namespace aaudio
+
+#endif //ANDROID_AAUDIO_FUSED_KERNELS_H
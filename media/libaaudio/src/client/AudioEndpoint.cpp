@@ -138,6 +138,10 @@ aaudio_result_t AudioEndpoint::configure(const EndpointDescriptor *pEndpointDesc
             descriptor->dataAddress
     );
 
+    // ============================ down message queue =============================
+    // Optional, commands are sent with Binder if the ring is not configured.
+    (void) mCommandRing.configure(pEndpointDescriptor->downMessageQueueDescriptor);
+
     // ============================ data queue =============================
     result = configureDataQueue(pEndpointDescriptor->dataQueueDescriptor, direction);
 
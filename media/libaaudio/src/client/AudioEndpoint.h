@@ -21,6 +21,7 @@
 
 #include <aaudio/AAudio.h>
 
+#include "binding/AAudioCommandRing.h"
 #include "binding/AAudioServiceMessage.h"
 #include "binding/AudioEndpointParcelable.h"
 #include "fifo/FifoBuffer.h"
@@ -53,6 +54,12 @@ public:
      */
     aaudio_result_t readUpCommand(AAudioServiceMessage *commandPtr);
 
+    /**
+     * @return the ring for sending commands to the service without Binder,
+     *         which is not configured if the service does not provide one
+     */
+    AAudioCommandRing *getCommandRing() { return &mCommandRing; }
+
     int32_t getEmptyFramesAvailable(android::WrappingBuffer *wrappingBuffer);
 
     int32_t getEmptyFramesAvailable();
@@ -116,6 +123,7 @@ public:
 private:
     std::unique_ptr<android::FifoBufferIndirect> mUpCommandQueue;
     std::unique_ptr<android::FifoBufferIndirect> mDataQueue;
+    AAudioCommandRing       mCommandRing;
     bool                    mFreeRunning{false};
     android::fifo_counter_t mDataReadCounter{0}; // only used if free-running
     android::fifo_counter_t mDataWriteCounter{0}; // only used if free-running
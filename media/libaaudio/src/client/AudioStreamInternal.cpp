@@ -21,6 +21,7 @@
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
 #include <stdint.h>
+#include <sstream>
 
 #include <binder/IServiceManager.h>
 
@@ -58,6 +59,9 @@ using namespace aaudio;
 
 #define MIN_TIMEOUT_NANOS        (1000 * AAUDIO_NANOS_PER_MILLISECOND)
 
+// How long to wait for the service to execute a command sent through the command ring.
+#define COMMAND_RING_TIMEOUT_NANOS    (3000 * AAUDIO_NANOS_PER_MILLISECOND)
+
 // Wait at least this many times longer than the operation should take.
 #define MIN_TIMEOUT_OPERATIONS    4
 
@@ -70,6 +74,7 @@ AudioStreamInternal::AudioStreamInternal(AAudioServiceInterface  &serviceInterfa
         : AudioStream()
         , mClockModel()
         , mInService(inService)
+        , mUseCommandRing(!inService && AAudioProperty_getCommandRingEnabled())
         , mServiceInterface(serviceInterface)
         , mAtomicInternalTimestamp()
         , mWakeupDelayNanos(AAudioProperty_getWakeupDelayMicros() * AAUDIO_NANOS_PER_MICROSECOND)
@@ -132,6 +137,7 @@ aaudio_result_t AudioStreamInternal::open(const AudioStreamBuilder &builder) {
     request.getConfiguration().setSpatializationBehavior(getSpatializationBehavior());
     request.getConfiguration().setIsContentSpatialized(isContentSpatialized());
     request.getConfiguration().setInputPreset(getInputPreset());
+    request.getConfiguration().setPerformanceMode(getPerformanceMode());
     request.getConfiguration().setPrivacySensitive(isPrivacySensitive());
 
     request.getConfiguration().setBufferCapacity(builder.getBufferCapacity());
@@ -244,13 +250,24 @@ aaudio_result_t AudioStreamInternal::configureDataInformation(int32_t callbackFr
     // or at high sample rates. The actual number of frames that we call back to
     // the app with will be 0 < N <= framesPerBurst so round up the division.
     int32_t burstMicros = 0;
-    const int32_t burstMinMicros = android::AudioSystem::getAAudioHardwareBurstMinUsec();
+    int32_t burstMinMicros = android::AudioSystem::getAAudioHardwareBurstMinUsec();
+    // The power optimized shared endpoint in the service uses much larger bursts,
+    // but keeps at least four of them in the MMAP buffer.
+    const bool powerOptimized =
+            mInService && getPerformanceMode() == AAUDIO_PERFORMANCE_MODE_POWER_SAVING;
+    int32_t powerOptimizedMaxFrames = 0;
+    if (powerOptimized) {
+        burstMinMicros = std::max(burstMinMicros, AAudioProperty_getPowerSavingBurstMicros());
+        powerOptimizedMaxFrames = std::min(MAX_FRAMES_PER_BURST,
+                mEndpointDescriptor.dataQueueDescriptor.capacityInFrames / 4);
+    }
     do {
         if (burstMicros > 0) {  // skip first loop
             deviceFramesPerBurst *= 2;
         }
         burstMicros = deviceFramesPerBurst * static_cast<int64_t>(1000000) / getDeviceSampleRate();
-    } while (burstMicros < burstMinMicros);
+    } while (burstMicros < burstMinMicros
+            && (!powerOptimized || deviceFramesPerBurst * 2 <= powerOptimizedMaxFrames));
     ALOGD("%s() original HW burst = %d, minMicros = %d => SW burst = %d\n",
           __func__, originalFramesPerBurst, burstMinMicros, deviceFramesPerBurst);
 
@@ -347,6 +364,7 @@ aaudio_result_t AudioStreamInternal::release_l() {
         }
 
         logReleaseBufferState();
+        logDump();
 
         setState(AAUDIO_STREAM_STATE_CLOSING);
         auto serviceStreamHandleInfo = mServiceStreamHandleInfo;
@@ -477,12 +495,12 @@ aaudio_result_t AudioStreamInternal::requestStart_l()
 
     prepareBuffersForStart(); // tell subclasses to get ready
 
-    aaudio_result_t result = mServiceInterface.startStream(mServiceStreamHandleInfo);
+    aaudio_result_t result = sendControlCommand_l(AAUDIO_CLIENT_COMMAND_START);
     if (result == AAUDIO_ERROR_STANDBY) {
         // The stream is at standby mode. Need to exit standby before starting the stream.
         result = exitStandby_l();
         if (result == AAUDIO_OK) {
-            result = mServiceInterface.startStream(mServiceStreamHandleInfo);
+            result = sendControlCommand_l(AAUDIO_CLIENT_COMMAND_START);
         }
     }
     if (result != AAUDIO_OK) {
@@ -581,7 +599,7 @@ aaudio_result_t AudioStreamInternal::requestStop_l() {
     AudioClock::sleepForNanos(800 * AAUDIO_NANOS_PER_MILLISECOND);
 #endif
 
-    result = mServiceInterface.stopStream(mServiceStreamHandleInfo);
+    result = sendControlCommand_l(AAUDIO_CLIENT_COMMAND_STOP);
     if (result == AAUDIO_ERROR_INVALID_HANDLE) {
         ALOGD("%s() INVALID_HANDLE, stream was probably stolen", __func__);
         result = AAUDIO_OK;
@@ -589,6 +607,27 @@ aaudio_result_t AudioStreamInternal::requestStop_l() {
     return result;
 }
 
+aaudio_result_t AudioStreamInternal::sendControlCommand_l(aaudio_client_command_t command) {
+    if (mUseCommandRing && mAudioEndpoint != nullptr) {
+        AAudioCommandFuture future = mAudioEndpoint->getCommandRing()->send(command);
+        if (future.isValid()) {
+            return future.wait(COMMAND_RING_TIMEOUT_NANOS);
+        }
+    }
+    switch (command) {
+        case AAUDIO_CLIENT_COMMAND_START:
+            return mServiceInterface.startStream(mServiceStreamHandleInfo);
+        case AAUDIO_CLIENT_COMMAND_PAUSE:
+            return mServiceInterface.pauseStream(mServiceStreamHandleInfo);
+        case AAUDIO_CLIENT_COMMAND_STOP:
+            return mServiceInterface.stopStream(mServiceStreamHandleInfo);
+        case AAUDIO_CLIENT_COMMAND_FLUSH:
+            return mServiceInterface.flushStream(mServiceStreamHandleInfo);
+        default:
+            return AAUDIO_ERROR_ILLEGAL_ARGUMENT;
+    }
+}
+
 aaudio_result_t AudioStreamInternal::registerThread() {
     if (getServiceHandle() == AAUDIO_HANDLE_INVALID) {
         ALOGW("%s() mServiceStreamHandle invalid", __func__);
@@ -880,8 +919,7 @@ aaudio_result_t AudioStreamInternal::processData(void *buffer, int32_t numFrames
                       (long long) wakeTimeNanos, (long long) deadlineNanos);
                 ALOGW("processData(): past deadline by %d micros",
                       (int)((wakeTimeNanos - deadlineNanos) / AAUDIO_NANOS_PER_MICROSECOND));
-                mClockModel.dump();
-                mAudioEndpoint->dump();
+                logDump();
                 break;
             }
 
@@ -974,6 +1012,30 @@ int32_t AudioStreamInternal::getDeviceBufferCapacity() const {
     return mDeviceBufferCapacityInFrames;
 }
 
+std::string AudioStreamInternal::dump() const {
+    std::stringstream result;
+    result << "handle = 0x" << std::hex << getServiceHandle() << std::dec
+           << ", " << (getDirection() == AAUDIO_DIRECTION_OUTPUT ? "output" : "input")
+           << ", state = " << AAudio_convertStreamStateToText(getState()) << "\n";
+    result << "buffer = " << getBufferSize() << "/" << getBufferCapacity()
+           << ", device buffer = " << getDeviceBufferSize() << "/" << getDeviceBufferCapacity()
+           << ", xruns = " << mXRunCount << "\n";
+    if (mAudioEndpoint != nullptr) {
+        result << "data readCounter = " << mAudioEndpoint->getDataReadCounter()
+               << ", writeCounter = " << mAudioEndpoint->getDataWriteCounter() << "\n";
+    }
+    result << mClockModel.dumpToString();
+    return result.str();
+}
+
+void AudioStreamInternal::logDump() const {
+    std::istringstream istr(dump());
+    std::string line;
+    while (std::getline(istr, line)) {
+        ALOGD("%s", line.c_str());
+    }
+}
+
 bool AudioStreamInternal::isClockModelInControl() const {
     return isActive() && mAudioEndpoint->isFreeRunning() && mClockModel.isRunning();
 }
@@ -59,6 +59,12 @@ public:
 
     int32_t getDeviceBufferSize() const;
 
+    /**
+     * @return the buffer state and the clock model, with its lateness and jitter
+     *         statistics, one item per line
+     */
+    std::string dump() const;
+
     int32_t getBufferCapacity() const override;
 
     int32_t getDeviceBufferCapacity() const override;
@@ -119,6 +125,12 @@ protected:
 
     aaudio_result_t drainTimestampsFromService();
 
+    /**
+     * Send start, pause, stop or flush to the service, through the command ring
+     * if the service provides one, otherwise with Binder.
+     */
+    aaudio_result_t sendControlCommand_l(aaudio_client_command_t command);
+
     aaudio_result_t stopCallback_l();
 
     virtual void prepareBuffersForStart() {}
@@ -153,6 +165,9 @@ protected:
      */
     bool isClockModelInControl() const;
 
+    // Log dump() one line at a time, at release or when a blocking transfer times out.
+    void logDump() const;
+
     IsochronousClockModel    mClockModel;      // timing model for chasing the HAL
 
     std::unique_ptr<AudioEndpoint> mAudioEndpoint;   // source for reads or sink for writes
@@ -170,6 +185,7 @@ protected:
 
     // The service uses this for SHARED mode.
     bool                     mInService = false;  // Is this running in the client or the service?
+    const bool               mUseCommandRing;     // Use the command ring if the service has one.
 
     AAudioServiceInterface  &mServiceInterface;   // abstract interface to the service
 
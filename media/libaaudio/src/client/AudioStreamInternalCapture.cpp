@@ -216,12 +216,16 @@ aaudio_result_t AudioStreamInternalCapture::readNowWithConversion(void *buffer,
 
         if (framesAvailableInWrappingBuffer <= 0) break;
 
-        // Put data from the wrapping buffer into the flowgraph 8 frames at a time.
+        // Put data from the wrapping buffer into the flowgraph 8 frames at a time,
+        // or the whole span at once if the flowgraph runs as a fused kernel.
         // Continuously pull as much data as possible from the flowgraph into the byte buffer.
         // The return value of mFlowGraph.process is the number of frames actually pulled.
         while (framesAvailableInWrappingBuffer > 0 && framesLeftInByteBuffer > 0) {
-            const int32_t framesToReadFromWrappingBuffer = std::min(flowgraph::kDefaultBufferSize,
-                    framesAvailableInWrappingBuffer);
+            // The fused kernel writes one frame for each frame it reads, so nothing is left
+            // in the flowgraph when the byte buffer is full.
+            const int32_t framesToReadFromWrappingBuffer = mFlowGraph.isFused()
+                    ? std::min(framesAvailableInWrappingBuffer, framesLeftInByteBuffer)
+                    : std::min(flowgraph::kDefaultBufferSize, framesAvailableInWrappingBuffer);
 
             const int32_t numBytesToReadFromWrappingBuffer = getBytesPerDeviceFrame() *
                     framesToReadFromWrappingBuffer;
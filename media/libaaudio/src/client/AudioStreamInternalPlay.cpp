@@ -88,7 +88,7 @@ aaudio_result_t AudioStreamInternalPlay::requestPause_l()
     mClockModel.stop(AudioClock::getNanoseconds());
     setState(AAUDIO_STREAM_STATE_PAUSING);
     mAtomicInternalTimestamp.clear();
-    return mServiceInterface.pauseStream(mServiceStreamHandleInfo);
+    return sendControlCommand_l(AAUDIO_CLIENT_COMMAND_PAUSE);
 }
 
 aaudio_result_t AudioStreamInternalPlay::requestFlush_l() {
@@ -98,7 +98,7 @@ aaudio_result_t AudioStreamInternalPlay::requestFlush_l() {
     }
 
     setState(AAUDIO_STREAM_STATE_FLUSHING);
-    return mServiceInterface.flushStream(mServiceStreamHandleInfo);
+    return sendControlCommand_l(AAUDIO_CLIENT_COMMAND_FLUSH);
 }
 
 void AudioStreamInternalPlay::prepareBuffersForStart() {
@@ -329,15 +329,23 @@ aaudio_result_t AudioStreamInternalPlay::writeNowWithConversion(const void *buff
             break;
         }
 
-        // Put data from byteBuffer into the flowgraph one buffer (8 frames) at a time.
+        // Put data from byteBuffer into the flowgraph one buffer (8 frames) at a time,
+        // or the whole span at once if the flowgraph runs as a fused kernel.
         // Continuously pull as much data as possible from the flowgraph into the wrapping buffer.
         // The return value of mFlowGraph.process is the number of frames actually pulled.
         while (framesAvailableInWrappingBuffer > 0 && framesLeftInByteBuffer > 0) {
-            int32_t framesToWriteFromByteBuffer = std::min(flowgraph::kDefaultBufferSize,
-                    framesLeftInByteBuffer);
-            // If the wrapping buffer is running low, write one frame at a time.
-            if (framesAvailableInWrappingBuffer < flowgraph::kDefaultBufferSize) {
-                framesToWriteFromByteBuffer = 1;
+            int32_t framesToWriteFromByteBuffer;
+            if (mFlowGraph.isFused()) {
+                // The fused kernel writes one frame for each frame it reads.
+                framesToWriteFromByteBuffer = std::min(framesAvailableInWrappingBuffer,
+                        framesLeftInByteBuffer);
+            } else {
+                framesToWriteFromByteBuffer = std::min(flowgraph::kDefaultBufferSize,
+                        framesLeftInByteBuffer);
+                // If the wrapping buffer is running low, write one frame at a time.
+                if (framesAvailableInWrappingBuffer < flowgraph::kDefaultBufferSize) {
+                    framesToWriteFromByteBuffer = 1;
+                }
             }
 
             const int32_t numBytesToWriteFromByteBuffer = getBytesPerFrame() *
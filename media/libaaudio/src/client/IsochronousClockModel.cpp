@@ -19,8 +19,10 @@
 #include <log/log.h>
 
 #include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <algorithm>
+#include <sstream>
 
 #include "utility/AudioClock.h"
 #include "utility/AAudioUtilities.h"
@@ -34,18 +36,31 @@ using namespace android::audio_utils;
 #define ICM_LOG_DRIFT   0
 #endif // ICM_LOG_DRIFT
 
-// To enable the timestamp histogram, enter this before opening the stream:
+// Histograms of the lateness and of the jitter of the timestamps are cleared
+// when the stream is started, and updated when the model is stable and receives a timestamp.
+// They are included in dump().
+// To also dump them to the log when the stream is stopped,
+// enter this before opening the stream:
 //    adb root
 //    adb shell setprop aaudio.log_mask 1
-// A histogram of the lateness of the timestamps will be cleared when the stream is started.
-// It will be updated when the model is stable and receives a timestamp,
-// and dumped to the log when the stream is stopped.
+// To log every timestamp in CSV format, for replay by test_clock_model, use:
+//    adb shell setprop aaudio.log_mask 2
 
 IsochronousClockModel::IsochronousClockModel()
 {
-    if ((AAudioProperty_getLogMask() & AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM) != 0) {
-        mHistogramMicros = std::make_unique<Histogram>(kHistogramBinCount,
-                kHistogramBinWidthMicros);
+    const int32_t logMask = AAudioProperty_getLogMask();
+    mLogHistogram = (logMask & AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM) != 0;
+    mLogTimestamps = (logMask & AAUDIO_LOG_CLOCK_MODEL_TIMESTAMPS) != 0;
+    mHistogramMicros = std::make_unique<Histogram>(kHistogramBinCount,
+            kHistogramBinWidthMicros);
+    mJitterHistogramMicros = std::make_unique<Histogram>(kHistogramBinCount,
+            kHistogramBinWidthMicros);
+    const int32_t aggressiveness =
+            AAudioProperty_getClockModelAggressiveness(kDefaultAggressiveness);
+    setAggressiveness(aggressiveness);
+    if (mAggressiveness != aggressiveness) {
+        ALOGW("%s: clipped %s from %d to %d", __func__, AAUDIO_PROP_CLOCK_MODEL_AGGRESSIVENESS,
+              aggressiveness, mAggressiveness);
     }
     update();
 }
@@ -62,9 +77,15 @@ void IsochronousClockModel::start(int64_t nanoTime) {
     mState = STATE_STARTING;
     mConsecutiveVeryLateCount = 0;
     mDspStallCount = 0;
-    if (mHistogramMicros) {
-        mHistogramMicros->clear();
-    }
+    mEarlyCorrectionCount = 0;
+    mLateCorrectionCount = 0;
+    mStatisticsCount = 0;
+    mLatenessSumMicros = 0.0;
+    mLatenessSumSquaresMicros = 0.0;
+    mMaxJitterNanos = 0;
+    // Keep the rate estimate because it is a property of the HW clock.
+    mHistogramMicros->clear();
+    mJitterHistogramMicros->clear();
 }
 
 void IsochronousClockModel::stop(int64_t nanoTime) {
@@ -76,7 +97,7 @@ void IsochronousClockModel::stop(int64_t nanoTime) {
     setPositionAndTime(convertTimeToPosition(nanoTime), nanoTime);
     // TODO should we set position?
     mState = STATE_STOPPED;
-    if (mHistogramMicros) {
+    if (mLogHistogram) {
         dumpHistogram();
     }
 }
@@ -91,9 +112,12 @@ bool IsochronousClockModel::isRunning() const {
 
 void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nanoTime) {
     mTimestampCount++;
-// Log position and time in CSV format so we can import it easily into spreadsheets.
-    //ALOGD("%s() CSV, %d, %lld, %lld", __func__,
-          //mTimestampCount, (long long)framePosition, (long long)nanoTime);
+    // Log position and time in CSV format so we can import it easily into spreadsheets,
+    // or replay it in test_clock_model.
+    if (mLogTimestamps) {
+        ALOGD("%s() CSV, %d, %lld, %lld", __func__,
+              mTimestampCount, (long long)framePosition, (long long)nanoTime);
+    }
     int64_t framesDelta = framePosition - mMarkerFramePosition;
     int64_t nanosDelta = nanoTime - mMarkerNanoTime;
     if (nanosDelta < 1000) {
@@ -104,7 +128,7 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
 //         (long long)mMarkerFramePosition,
 //         (long long)mMarkerNanoTime);
 
-    int64_t expectedNanosDelta = convertDeltaPositionToTime(framesDelta);
+    int64_t expectedNanosDelta = convertDeltaPositionToModelTime(framesDelta);
 //    ALOGD("processTimestamp() - expectedNanosDelta = %lld, nanosDelta = %llu",
 //         (long long)expectedNanosDelta,
 //         (long long)nanosDelta);
@@ -128,19 +152,24 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
         } else {
 //            ALOGD("processTimestamp() - advance to STATE_RUNNING");
             mState = STATE_RUNNING;
+            mPreviousFramePosition = framePosition;
+            mPreviousNanoTime = nanoTime;
+            // The first window only finds the early edge, so do not use it for the rate.
+            mLastCorrectionNanoTime = nanoTime + kMinRateWindowNanos;
+            mRateCorrectionNanos = 0;
         }
         break;
     case STATE_RUNNING:
-        if (mHistogramMicros) {
-            mHistogramMicros->add(latenessNanos / AAUDIO_NANOS_PER_MICROSECOND);
-        }
+        updateStatistics(latenessNanos, framePosition, nanoTime);
         // Modify estimated position based on lateness.
         // This affects the "early" side of the window, which controls output glitches.
         if (latenessNanos < 0) {
             // Earlier than expected timestamp.
             // This data is probably more accurate, so use it.
             // Or we may be drifting due to a fast HW clock.
+            updateRate(latenessNanos, nanoTime);
             setPositionAndTime(framePosition, nanoTime);
+            mEarlyCorrectionCount++;
 #if ICM_LOG_DRIFT
             int earlyDeltaMicros = (int) ((expectedNanosDelta - nanosDelta)
                     / AAUDIO_NANOS_PER_MICROSECOND);
@@ -162,6 +191,9 @@ void IsochronousClockModel::processTimestamp(int64_t framePosition, int64_t nano
                 // move the window quickly to the correct place.
                 setPositionAndTime(framePosition, nanoTime); // JUMP!
                 mDspStallCount++;
+                // A stall is not a rate error, so restart the rate window after it.
+                mLastCorrectionNanoTime = nanoTime;
+                mRateCorrectionNanos = 0;
                 // Throttle the warnings but do not silence them.
                 // They indicate a bug that needs to be fixed!
                 if ((nanoTime - mLastJumpWarningTimeNanos) > AAUDIO_NANOS_PER_SECOND) {
@@ -219,7 +251,9 @@ void IsochronousClockModel::driftForward(int64_t latenessNanos,
     const int64_t minDriftNanos = std::min(driftNanos, kMaxDriftNanos);
     const int64_t expectedMarkerNanoTime = mMarkerNanoTime + expectedNanosDelta;
     const int64_t driftedTime = expectedMarkerNanoTime + minDriftNanos;
+    updateRate(minDriftNanos, driftedTime);
     setPositionAndTime(framePosition, driftedTime);
+    mLateCorrectionCount++;
 #if ICM_LOG_DRIFT
     ALOGD("%s() - STATE_RUNNING - #%d, %5d micros LATE, nudge window forward by %d micros",
           __func__,
@@ -260,6 +294,96 @@ int64_t IsochronousClockModel::convertDeltaTimeToPosition(int64_t nanosDelta) co
     return (mSampleRate * nanosDelta) / AAUDIO_NANOS_PER_SECOND;
 }
 
+int64_t IsochronousClockModel::convertDeltaPositionToModelTime(int64_t framesDelta) const {
+    const int64_t nanosDelta = convertDeltaPositionToTime(framesDelta);
+    if (mModelRateError == 0.0) {
+        return nanosDelta;
+    }
+    return (int64_t) llround(nanosDelta / (1.0 + mModelRateError));
+}
+
+int64_t IsochronousClockModel::convertDeltaTimeToModelPosition(int64_t nanosDelta) const {
+    if (mModelRateError == 0.0) {
+        return convertDeltaTimeToPosition(nanosDelta);
+    }
+    // Truncate like convertDeltaTimeToPosition().
+    return (int64_t) (mSampleRate * (1.0 + mModelRateError) * nanosDelta
+            / AAUDIO_NANOS_PER_SECOND);
+}
+
+void IsochronousClockModel::setAggressiveness(int32_t aggressiveness) {
+    mAggressiveness = std::clamp(aggressiveness, 0, kMaxAggressiveness);
+    if (mAggressiveness == 0) {
+        mRateError = 0.0;
+        mModelRateError = 0.0;
+    }
+}
+
+// The phase corrections made by early and late timestamps are accumulated over a window.
+// Their sum divided by the window is the residual rate error of the model,
+// which is a noisy measurement because the timestamps are sampled randomly in the
+// burst window. So the rate estimate is a low pass filter of the measured rate,
+// with a gain set by the aggressiveness.
+// This is a second order loop: the phase follows the timestamps immediately and
+// the rate follows the phase slowly.
+// The model only uses the estimate when it is above the noise, so that it keeps the
+// nominal rate, and the early edge of the window, for a HW clock that is accurate.
+// And it runs slightly slower than the estimate, because a model that is late is
+// corrected immediately by an early timestamp, but a model that is early is only
+// nudged slowly by the late timestamps.
+void IsochronousClockModel::updateRate(int64_t correctionNanos, int64_t nanoTime) {
+    if (mAggressiveness == 0) {
+        return;
+    }
+    const int64_t windowNanos = nanoTime - mLastCorrectionNanoTime;
+    if (windowNanos < 0) {
+        return; // still finding the early edge
+    }
+    // Like the late corrections, the early corrections are limited, because a large
+    // early correction is more likely to be the early edge of the window being found
+    // than a rate error. A real rate error produces many small corrections.
+    mRateCorrectionNanos += std::clamp(correctionNanos, -kMaxDriftNanos, kMaxDriftNanos);
+    if (windowNanos < kMinRateWindowNanos) {
+        return;
+    }
+    // An early correction means that the HW clock is faster than the model.
+    const double measuredError = mModelRateError
+            - ((double) mRateCorrectionNanos / windowNanos);
+    const double gain = (double) mAggressiveness / (2 * kMaxAggressiveness);
+    mRateError = std::clamp(mRateError + (gain * (measuredError - mRateError)),
+            -kMaxRateError, kMaxRateError);
+    mModelRateError = (std::abs(mRateError) < kMinRateError)
+            ? 0.0 : mRateError - kRateErrorMargin;
+    mLastCorrectionNanoTime = nanoTime;
+    mRateCorrectionNanos = 0;
+#if ICM_LOG_DRIFT
+    ALOGD("%s() - #%d, measured %.2f ppm over %d millis, rate error now %.2f ppm",
+          __func__,
+          mTimestampCount,
+          measuredError * 1.0e6,
+          (int) (windowNanos / AAUDIO_NANOS_PER_MILLISECOND),
+          getRateErrorPpm());
+#endif
+}
+
+void IsochronousClockModel::updateStatistics(int64_t latenessNanos,
+                                             int64_t framePosition,
+                                             int64_t nanoTime) {
+    const double latenessMicros = (double) latenessNanos / AAUDIO_NANOS_PER_MICROSECOND;
+    mStatisticsCount++;
+    mLatenessSumMicros += latenessMicros;
+    mLatenessSumSquaresMicros += latenessMicros * latenessMicros;
+    mHistogramMicros->add(latenessNanos / AAUDIO_NANOS_PER_MICROSECOND);
+
+    const int64_t expectedNanosDelta =
+            convertDeltaPositionToModelTime(framePosition - mPreviousFramePosition);
+    const int64_t jitterNanos = std::abs((nanoTime - mPreviousNanoTime) - expectedNanosDelta);
+    mMaxJitterNanos = std::max(mMaxJitterNanos, jitterNanos);
+    mJitterHistogramMicros->add(jitterNanos / AAUDIO_NANOS_PER_MICROSECOND);
+    mPreviousFramePosition = framePosition;
+    mPreviousNanoTime = nanoTime;
+}
+
 int64_t IsochronousClockModel::convertPositionToTime(int64_t framePosition) const {
     if (mState == STATE_STOPPED) {
         return mMarkerNanoTime;
@@ -267,7 +391,7 @@ int64_t IsochronousClockModel::convertPositionToTime(int64_t framePosition) cons
     int64_t nextBurstIndex = (framePosition + mFramesPerBurst - 1) / mFramesPerBurst;
     int64_t nextBurstPosition = mFramesPerBurst * nextBurstIndex;
     int64_t framesDelta = nextBurstPosition - mMarkerFramePosition;
-    int64_t nanosDelta = convertDeltaPositionToTime(framesDelta);
+    int64_t nanosDelta = convertDeltaPositionToModelTime(framesDelta);
     int64_t time = mMarkerNanoTime + nanosDelta;
 //    ALOGD("%s(): pos = %" PRId64 " --> time = %" PRId64, __func__,
 //            framePosition, time);
@@ -279,7 +403,7 @@ int64_t IsochronousClockModel::convertTimeToPosition(int64_t nanoTime) const {
         return mMarkerFramePosition;
     }
     int64_t nanosDelta = nanoTime - mMarkerNanoTime;
-    int64_t framesDelta = convertDeltaTimeToPosition(nanosDelta);
+    int64_t framesDelta = convertDeltaTimeToModelPosition(nanosDelta);
     int64_t nextBurstPosition = mMarkerFramePosition + framesDelta;
     int64_t nextBurstIndex = nextBurstPosition / mFramesPerBurst;
     int64_t position = nextBurstIndex * mFramesPerBurst;
@@ -304,19 +428,68 @@ int64_t IsochronousClockModel::convertLatestTimeToPosition(int64_t nanoTime) con
 }
 
 void IsochronousClockModel::dump() const {
-    ALOGD("mMarkerFramePosition = %" PRId64, mMarkerFramePosition);
-    ALOGD("mMarkerNanoTime      = %" PRId64, mMarkerNanoTime);
-    ALOGD("mSampleRate          = %6d", mSampleRate);
-    ALOGD("mFramesPerBurst      = %6d", mFramesPerBurst);
-    ALOGD("mMaxMeasuredLatenessNanos = %6" PRId64, mMaxMeasuredLatenessNanos);
-    ALOGD("mState               = %6d", mState);
+    std::istringstream istr(dumpToString());
+    std::string line;
+    while (std::getline(istr, line)) {
+        ALOGD("%s", line.c_str());
+    }
 }
 
 void IsochronousClockModel::dumpHistogram() const {
-    if (!mHistogramMicros) return;
     std::istringstream istr(mHistogramMicros->dump());
     std::string line;
     while (std::getline(istr, line)) {
         ALOGD("lateness, %s", line.c_str());
     }
+    std::istringstream jitterStr(mJitterHistogramMicros->dump());
+    while (std::getline(jitterStr, line)) {
+        ALOGD("jitter, %s", line.c_str());
+    }
+}
+
+std::string IsochronousClockModel::dumpToString() const {
+    std::stringstream result;
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), "mMarkerFramePosition = %" PRId64 "\n",
+             mMarkerFramePosition);
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "mMarkerNanoTime      = %" PRId64 "\n", mMarkerNanoTime);
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "mSampleRate          = %6d\n", mSampleRate);
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "mFramesPerBurst      = %6d\n", mFramesPerBurst);
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "mMaxMeasuredLatenessNanos = %6" PRId64 "\n",
+             mMaxMeasuredLatenessNanos);
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "mState               = %6d\n", mState);
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "mAggressiveness      = %6d, rate error = %.2f ppm\n",
+             mAggressiveness, getRateErrorPpm());
+    result << buffer;
+    snprintf(buffer, sizeof(buffer), "corrections: early = %d, late = %d, DSP stalls = %d\n",
+             mEarlyCorrectionCount, mLateCorrectionCount, mDspStallCount);
+    result << buffer;
+    if (mStatisticsCount > 0) {
+        const double mean = mLatenessSumMicros / mStatisticsCount;
+        const double variance = std::max(0.0,
+                (mLatenessSumSquaresMicros / mStatisticsCount) - (mean * mean));
+        snprintf(buffer, sizeof(buffer),
+                 "lateness: count = %d, mean = %.1f, deviation = %.1f micros\n",
+                 mStatisticsCount, mean, sqrt(variance));
+        result << buffer;
+        snprintf(buffer, sizeof(buffer), "jitter: max = %d micros\n",
+                 (int) (mMaxJitterNanos / AAUDIO_NANOS_PER_MICROSECOND));
+        result << buffer;
+        std::istringstream istr(mHistogramMicros->dump());
+        std::string line;
+        while (std::getline(istr, line)) {
+            result << "lateness, " << line << "\n";
+        }
+        std::istringstream jitterStr(mJitterHistogramMicros->dump());
+        while (std::getline(jitterStr, line)) {
+            result << "jitter, " << line << "\n";
+        }
+    }
+    return result.str();
 }
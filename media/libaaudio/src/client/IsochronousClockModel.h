@@ -18,6 +18,8 @@
 #define ANDROID_AAUDIO_ISOCHRONOUS_CLOCK_MODEL_H
 
 #include <stdint.h>
+#include <memory>
+#include <string>
 
 #include <audio_utils/Histogram.h>
 
@@ -29,6 +31,11 @@ namespace aaudio {
  * Model an isochronous data stream using occasional timestamps as input.
  * This can be used to predict the position of the stream at a given time.
  *
+ * The phase of the model is the early edge of the timestamp window, which is moved by
+ * early and late timestamps. The rate of the model is filtered from those phase corrections,
+ * so that a HW clock that is slightly fast or slow is tracked without a continuous series
+ * of corrections. How fast the rate follows the corrections is set by the aggressiveness.
+ *
  * This class is not thread safe and should only be called from one thread.
  */
 class IsochronousClockModel {
@@ -123,10 +130,63 @@ public:
      */
     int64_t convertDeltaTimeToPosition(int64_t nanosDelta) const;
 
+    /**
+     * Set how fast the estimated rate follows the phase corrections.
+     * Zero disables the rate estimation, so the model runs at the nominal sample rate.
+     * The default is read from the AAUDIO_PROP_CLOCK_MODEL_AGGRESSIVENESS property.
+     *
+     * @param aggressiveness between 0 and kMaxAggressiveness, will be clipped
+     */
+    void setAggressiveness(int32_t aggressiveness);
+
+    int32_t getAggressiveness() const {
+        return mAggressiveness;
+    }
+
+    /**
+     * @return estimated deviation of the HW clock from the nominal sample rate,
+     *         in parts per million, positive if the HW clock is fast
+     */
+    double getRateErrorPpm() const {
+        return mRateError * 1.0e6;
+    }
+
+    /**
+     * @return number of times the phase was moved earlier by an early timestamp
+     */
+    int32_t getEarlyCorrectionCount() const {
+        return mEarlyCorrectionCount;
+    }
+
+    /**
+     * @return number of times the phase was nudged later by a late timestamp
+     */
+    int32_t getLateCorrectionCount() const {
+        return mLateCorrectionCount;
+    }
+
+    /**
+     * @return number of times the phase jumped because the DSP stalled
+     */
+    int32_t getDspStallCount() const {
+        return mDspStallCount;
+    }
+
     void dump() const;
 
     void dumpHistogram() const;
 
+    /**
+     * @return the state of the model, the rate estimate and the lateness and jitter
+     *         statistics since start(), with their histograms, one item per line
+     */
+    std::string dumpToString() const;
+
+    static constexpr int32_t   kMaxAggressiveness = 8;
+    // Rate tracking stays off until it has been checked against timestamps from real devices.
+    // Aggressiveness 2 follows a 20 ppm HW clock within a couple of minutes.
+    static constexpr int32_t   kDefaultAggressiveness = 0;
+
 private:
 
     void driftForward(int64_t latenessNanos,
@@ -134,6 +194,12 @@ private:
                       int64_t framePosition);
     int32_t getLateTimeOffsetNanos() const;
     void update();
+    // Deltas at the estimated HW rate, which is the nominal rate when mRateError is zero.
+    int64_t convertDeltaPositionToModelTime(int64_t framesDelta) const;
+    int64_t convertDeltaTimeToModelPosition(int64_t nanosDelta) const;
+    // Feed a phase correction to the rate estimate.
+    void updateRate(int64_t correctionNanos, int64_t nanoTime);
+    void updateStatistics(int64_t latenessNanos, int64_t framePosition, int64_t nanoTime);
 
     enum clock_model_state_t {
         STATE_STOPPED,
@@ -157,6 +223,15 @@ private:
     // the drift value for the window. This is meant to be a very slight nudge forward.
     static constexpr int32_t   kShifterForDrift = 6; // divide by 2^N
     static constexpr int32_t   kVeryLateCountsNeededToTriggerJump = 2;
+    // Phase corrections are averaged over at least this time to estimate the rate,
+    // so that the corrections that find the early edge after start() hardly move it.
+    static constexpr int64_t   kMinRateWindowNanos = AAUDIO_NANOS_PER_SECOND;
+    // Real HW clocks are well within this deviation from the nominal rate.
+    static constexpr double    kMaxRateError = 500.0e-6;
+    // Below this deviation, the estimate is mostly timestamp jitter.
+    static constexpr double    kMinRateError = 5.0e-6;
+    // The model runs this much slower than the estimate, so that it errs on the late side.
+    static constexpr double    kRateErrorMargin = 2.0e-6;
 
     static constexpr int32_t   kHistogramBinWidthMicros = 50;
     static constexpr int32_t   kHistogramBinCount       = 128;
@@ -180,9 +255,32 @@ private:
 
     int32_t             mTimestampCount = 0;  // For logging.
     int32_t             mDspStallCount = 0;  // For logging.
+    int32_t             mEarlyCorrectionCount = 0;
+    int32_t             mLateCorrectionCount = 0;
+    bool                mLogHistogram = false;
+    bool                mLogTimestamps = false;
+
+    // Rate estimate: (HW rate / nominal rate) - 1
+    int32_t             mAggressiveness{kDefaultAggressiveness};
+    double              mRateError{0.0};
+    double              mModelRateError{0.0};  // mRateError, or zero if within the noise.
+    int64_t             mLastCorrectionNanoTime{0}; // Start of the current rate window.
+    int64_t             mRateCorrectionNanos{0};    // Sum of corrections in the window.
+
+    // Lateness and jitter statistics since start().
+    // Jitter is the difference between the interval of consecutive timestamps
+    // and the interval expected from their positions.
+    int32_t             mStatisticsCount = 0;
+    double              mLatenessSumMicros = 0.0;
+    double              mLatenessSumSquaresMicros = 0.0;
+    int64_t             mMaxJitterNanos = 0;
+    int64_t             mPreviousFramePosition = 0;
+    int64_t             mPreviousNanoTime = 0;
 
     // distribution of timestamps relative to earliest
     std::unique_ptr<android::audio_utils::Histogram>   mHistogramMicros;
+    // distribution of the jitter between consecutive timestamps
+    std::unique_ptr<android::audio_utils::Histogram>   mJitterHistogramMicros;
 
 };
 
@@ -41,6 +41,7 @@ void AAudioStreamParameters::copyFrom(const AAudioStreamParameters &other) {
     mSpatializationBehavior = other.mSpatializationBehavior;
     mIsContentSpatialized = other.mIsContentSpatialized;
     mInputPreset          = other.mInputPreset;
+    mPerformanceMode      = other.mPerformanceMode;
     mAllowedCapturePolicy = other.mAllowedCapturePolicy;
     mIsPrivacySensitive   = other.mIsPrivacySensitive;
     mOpPackageName        = other.mOpPackageName;
@@ -202,6 +203,18 @@ aaudio_result_t AAudioStreamParameters::validate() const {
             // break;
     }
 
+    switch (mPerformanceMode) {
+        case AAUDIO_PERFORMANCE_MODE_NONE:
+        case AAUDIO_PERFORMANCE_MODE_POWER_SAVING:
+        case AAUDIO_PERFORMANCE_MODE_LOW_LATENCY:
+        case AAUDIO_PERFORMANCE_MODE_POWER_SAVING_OFFLOADED:
+            break; // valid
+        default:
+            ALOGD("performance mode not valid = %d", mPerformanceMode);
+            return AAUDIO_ERROR_ILLEGAL_ARGUMENT;
+            // break;
+    }
+
     switch (mAllowedCapturePolicy) {
         case AAUDIO_UNSPECIFIED:
         case AAUDIO_ALLOW_CAPTURE_BY_ALL:
@@ -328,6 +341,7 @@ void AAudioStreamParameters::dump() const {
     ALOGD("mSpatializationBehavior = %6d", mSpatializationBehavior);
     ALOGD("mIsContentSpatialized = %s", mIsContentSpatialized ? "true" : "false");
     ALOGD("mInputPreset          = %6d", mInputPreset);
+    ALOGD("mPerformanceMode      = %6d", mPerformanceMode);
     ALOGD("mAllowedCapturePolicy = %6d", mAllowedCapturePolicy);
     ALOGD("mIsPrivacySensitive   = %s", mIsPrivacySensitive ? "true" : "false");
     ALOGD("mOpPackageName        = %s", !mOpPackageName.has_value() ?
@@ -132,6 +132,14 @@ public:
         mInputPreset = inputPreset;
     }
 
+    aaudio_performance_mode_t getPerformanceMode() const {
+        return mPerformanceMode;
+    }
+
+    void setPerformanceMode(aaudio_performance_mode_t performanceMode) {
+        mPerformanceMode = performanceMode;
+    }
+
     aaudio_allowed_capture_policy_t getAllowedCapturePolicy() const {
         return mAllowedCapturePolicy;
     }
@@ -241,6 +249,7 @@ private:
                                                           = AAUDIO_UNSPECIFIED;
     bool                            mIsContentSpatialized = false;
     aaudio_input_preset_t           mInputPreset          = AAUDIO_UNSPECIFIED;
+    aaudio_performance_mode_t       mPerformanceMode      = AAUDIO_PERFORMANCE_MODE_NONE;
     int32_t                         mBufferCapacity       = AAUDIO_UNSPECIFIED;
     aaudio_allowed_capture_policy_t mAllowedCapturePolicy = AAUDIO_UNSPECIFIED;
     aaudio_session_id_t             mSessionId            = AAUDIO_SESSION_ID_NONE;
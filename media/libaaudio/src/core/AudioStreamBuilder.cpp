@@ -170,8 +170,14 @@ aaudio_result_t AudioStreamBuilder::build(AudioStream** streamPtr) {
     bool allowLegacy = mmapPolicy != AAUDIO_POLICY_ALWAYS;
 
     // TODO Support other performance settings in MMAP mode.
-    // Disable MMAP if low latency not requested.
-    if (getPerformanceMode() != AAUDIO_PERFORMANCE_MODE_LOW_LATENCY) {
+    // SHARED output may use a power optimized endpoint in the service,
+    // otherwise disable MMAP if low latency not requested.
+    const bool allowPowerSavingMMap =
+            getPerformanceMode() == AAUDIO_PERFORMANCE_MODE_POWER_SAVING
+            && sharingMode == AAUDIO_SHARING_MODE_SHARED
+            && getDirection() == AAUDIO_DIRECTION_OUTPUT
+            && AAudioProperty_getPowerSavingMMapEnabled();
+    if (getPerformanceMode() != AAUDIO_PERFORMANCE_MODE_LOW_LATENCY && !allowPowerSavingMMap) {
         ALOGD("%s() MMAP not used because AAUDIO_PERFORMANCE_MODE_LOW_LATENCY not requested.",
               __func__);
         allowMMap = false;
@@ -263,23 +269,14 @@ aaudio_result_t AudioStreamBuilder::validate() const {
         return result;
     }
 
-    switch (mPerformanceMode) {
-        case AAUDIO_PERFORMANCE_MODE_NONE:
-        case AAUDIO_PERFORMANCE_MODE_POWER_SAVING:
-        case AAUDIO_PERFORMANCE_MODE_LOW_LATENCY:
-            break;
-        case AAUDIO_PERFORMANCE_MODE_POWER_SAVING_OFFLOADED:
-            if (getDirection() != AAUDIO_DIRECTION_OUTPUT ||
-                getFormat() == AUDIO_FORMAT_DEFAULT ||
-                getSampleRate() == 0 ||
-                getChannelMask() == AAUDIO_UNSPECIFIED) {
-                return AAUDIO_ERROR_ILLEGAL_ARGUMENT;
-            }
-            break;
-        default:
-            ALOGE("illegal performanceMode = %d", mPerformanceMode);
+    // The performance mode itself is validated by AAudioStreamParameters.
+    if (getPerformanceMode() == AAUDIO_PERFORMANCE_MODE_POWER_SAVING_OFFLOADED) {
+        if (getDirection() != AAUDIO_DIRECTION_OUTPUT ||
+            getFormat() == AUDIO_FORMAT_DEFAULT ||
+            getSampleRate() == 0 ||
+            getChannelMask() == AAUDIO_UNSPECIFIED) {
             return AAUDIO_ERROR_ILLEGAL_ARGUMENT;
-            // break;
+        }
     }
 
     // Prevent ridiculous values from causing problems.
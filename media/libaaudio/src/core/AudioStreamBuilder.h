@@ -45,12 +45,8 @@ public:
         return this;
     }
 
-    int32_t getPerformanceMode() const {
-        return mPerformanceMode;
-    }
-
     AudioStreamBuilder* setPerformanceMode(aaudio_performance_mode_t performanceMode) {
-        mPerformanceMode = performanceMode;
+        AAudioStreamParameters::setPerformanceMode(performanceMode);
         return this;
     }
 
@@ -142,7 +138,6 @@ private:
     static AudioStream *startUsingStream(android::sp<AudioStream> &spAudioStream);
 
     bool                       mSharingModeMatchRequired = false; // must match sharing mode requested
-    aaudio_performance_mode_t  mPerformanceMode = AAUDIO_PERFORMANCE_MODE_NONE;
 
     AAudioStream_dataCallback  mDataCallbackProc = nullptr;  // external callback functions
     void                      *mDataCallbackUserData = nullptr;
@@ -35,14 +35,6 @@ public:
         return "Limiter";
     }
 
-private:
-    // These numbers are based on a polynomial spline for a quadratic solution Ax^2 + Bx + C
-    // The range is up to 3 dB, (10^(3/20)), to match AudioTrack for float data.
-    static constexpr float kPolynomialSplineA = -0.6035533905; // -(1+sqrt(2))/4
-    static constexpr float kPolynomialSplineB = 2.2071067811; // (3+sqrt(2))/2
-    static constexpr float kPolynomialSplineC = -0.6035533905; // -(1+sqrt(2))/4
-    static constexpr float kXWhenYis3Decibels = 1.8284271247; // -1+2sqrt(2)
-
     /**
      * Process an input based on the following:
      * If between -1 and 1, return the input value.
@@ -52,8 +44,18 @@ private:
      * If between -kXWhenYis3Decibels and -1, use the absolute value for the spline and flip it.
      * The derivative of the spline is 1 at 1 and 0 at kXWhenYis3Decibels.
      * This way, the graph is both continuous and differentiable.
+     *
+     * The input must not be NaN.
      */
-    float processFloat(float in);
+    static float processFloat(float in);
+
+private:
+    // These numbers are based on a polynomial spline for a quadratic solution Ax^2 + Bx + C
+    // The range is up to 3 dB, (10^(3/20)), to match AudioTrack for float data.
+    static constexpr float kPolynomialSplineA = -0.6035533905; // -(1+sqrt(2))/4
+    static constexpr float kPolynomialSplineB = 2.2071067811; // (3+sqrt(2))/2
+    static constexpr float kPolynomialSplineC = -0.6035533905; // -(1+sqrt(2))/4
+    static constexpr float kXWhenYis3Decibels = 1.8284271247; // -1+2sqrt(2)
 
     // Use the previous valid output for NaN inputs
     float mLastValidOutput = 0.0f;
@@ -50,11 +50,7 @@ float RampLinear::interpolateCurrent() {
     return mLevelTo - (mRemaining * mScaler);
 }
 
-int32_t RampLinear::onProcess(int32_t numFrames) {
-    const float *inputBuffer = input.getBuffer();
-    float *outputBuffer = output.getBuffer();
-    int32_t channelCount = output.getSamplesPerFrame();
-
+int32_t RampLinear::startFrames() {
     float target = getTarget();
     if (target != mLevelTo) {
         // Start new ramp. Continue from previous level.
@@ -63,6 +59,19 @@ int32_t RampLinear::onProcess(int32_t numFrames) {
         mRemaining = mLengthInFrames;
         mScaler = (mLevelTo - mLevelFrom) / mLengthInFrames; // for interpolation
     }
+    // The ramp has been used, so a new target must ramp rather than start immediately.
+    if (mLastCallCount == kInitialCallCount) {
+        mLastCallCount = 0;
+    }
+    return mRemaining;
+}
+
+int32_t RampLinear::onProcess(int32_t numFrames) {
+    const float *inputBuffer = input.getBuffer();
+    float *outputBuffer = output.getBuffer();
+    int32_t channelCount = output.getSamplesPerFrame();
+
+    startFrames();
 
     int32_t framesLeft = numFrames;
 
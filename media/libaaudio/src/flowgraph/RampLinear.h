@@ -78,6 +78,28 @@ public:
         return "RampLinear";
     }
 
+    /**
+     * These let another node apply the ramp while processing the data itself,
+     * with the same levels as onProcess().
+     *
+     * Call startFrames() before each block of frames. It starts a new ramp if the target
+     * has changed, and returns the number of frames left in the ramp.
+     * Then use nextLevel() for each of those frames, and getLevel() after the ramp.
+     */
+    int32_t startFrames();
+
+    float nextLevel() {
+        float level = interpolateCurrent();
+        if (mRemaining > 0) {
+            mRemaining--;
+        }
+        return level;
+    }
+
+    float getLevel() const {
+        return mLevelTo;
+    }
+
 private:
 
     float interpolateCurrent();
@@ -676,6 +676,33 @@ int32_t AAudioProperty_getLogMask() {
     return property_get_int32(AAUDIO_PROP_LOG_MASK, 0);
 }
 
+int32_t AAudioProperty_getClockModelAggressiveness(int32_t defaultValue) {
+    return property_get_int32(AAUDIO_PROP_CLOCK_MODEL_AGGRESSIVENESS, defaultValue);
+}
+
+bool AAudioProperty_getCommandRingEnabled() {
+    return property_get_bool(AAUDIO_PROP_COMMAND_RING, true);
+}
+
+bool AAudioProperty_getPowerSavingMMapEnabled() {
+    return property_get_bool(AAUDIO_PROP_MMAP_POWER_SAVING, false);
+}
+
+int32_t AAudioProperty_getPowerSavingBurstMicros() {
+    const int32_t minMicros = 1000; // arbitrary
+    const int32_t defaultMicros = 20 * 1000; // arbitrary
+    const int32_t maxMicros = 200 * 1000; // arbitrary
+    int32_t prop = property_get_int32(AAUDIO_PROP_POWER_SAVING_BURST_USEC, defaultMicros);
+    if (prop < minMicros) {
+        ALOGW("%s: clipped %d to %d", __func__, prop, minMicros);
+        prop = minMicros;
+    } else if (prop > maxMicros) {
+        ALOGW("%s: clipped %d to %d", __func__, prop, maxMicros);
+        prop = maxMicros;
+    }
+    return prop;
+}
+
 aaudio_result_t AAudio_isFlushAllowed(aaudio_stream_state_t state) {
     aaudio_result_t result = AAUDIO_OK;
     switch (state) {
@@ -169,7 +169,8 @@ int32_t AAudioProperty_getOutputMMapOffsetMicros();
 // These are powers of two that can be combined as a bit mask.
 // AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM must be enabled before the stream is opened.
 #define AAUDIO_LOG_CLOCK_MODEL_HISTOGRAM   1
-#define AAUDIO_LOG_RESERVED_2              2
+// Log every timestamp given to the clock model, in CSV format.
+#define AAUDIO_LOG_CLOCK_MODEL_TIMESTAMPS  2
 #define AAUDIO_LOG_RESERVED_4              4
 #define AAUDIO_LOG_RESERVED_8              8
 
@@ -180,6 +181,49 @@ int32_t AAudioProperty_getOutputMMapOffsetMicros();
 int32_t AAudioProperty_getLogMask();
 #define AAUDIO_PROP_LOG_MASK   "aaudio.log_mask"
 
+/**
+ * Read a system property that specifies how fast the clock model follows a HW clock
+ * that is faster or slower than the nominal sample rate.
+ * Zero disables the rate tracking. Higher values track faster but are more sensitive
+ * to timestamp jitter.
+ * The range is checked by IsochronousClockModel::setAggressiveness().
+ *
+ * @param defaultValue returned if the property is not set
+ * @return aggressiveness, not clipped
+ */
+int32_t AAudioProperty_getClockModelAggressiveness(int32_t defaultValue);
+#define AAUDIO_PROP_CLOCK_MODEL_AGGRESSIVENESS   "aaudio.clock_model_aggressiveness"
+
+/**
+ * Read a system property that specifies whether the client sends start, pause, stop
+ * and flush through the shared memory command ring, when the service provides one.
+ * Set it to false to use Binder, for example to compare the latencies.
+ *
+ * @return true by default
+ */
+bool AAudioProperty_getCommandRingEnabled();
+#define AAUDIO_PROP_COMMAND_RING   "aaudio.command_ring"
+
+/**
+ * Are SHARED output streams with AAUDIO_PERFORMANCE_MODE_POWER_SAVING allowed to use MMAP?
+ * They are mixed by a power optimized endpoint in the service, which uses much larger bursts.
+ * The default is false.
+ *
+ * @return true if power saving streams may use MMAP
+ */
+bool AAudioProperty_getPowerSavingMMapEnabled();
+#define AAUDIO_PROP_MMAP_POWER_SAVING   "aaudio.mmap_power_saving"
+
+/**
+ * Read the minimum burst of a power optimized shared endpoint, in microseconds.
+ * The hardware burst is doubled until it reaches this size, or until it is
+ * a quarter of the MMAP buffer capacity.
+ *
+ * @return minimum burst in microseconds
+ */
+int32_t AAudioProperty_getPowerSavingBurstMicros();
+#define AAUDIO_PROP_POWER_SAVING_BURST_USEC   "aaudio.power_saving_burst_usec"
+
 /**
  * Is flush allowed for the given state?
  * @param state
@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measure the latency of the control commands sent through AAudioCommandRing:
+ *  - the round trip of a command to another process, which is the cost of the ring itself,
+ *  - AAudioStream_requestStart() and requestStop() of a shared stream,
+ *    through the command ring and through Binder.
+ *
+ * Changing "aaudio.command_ring" requires root, for example:
+ *   adb root
+ *   adb shell /data/benchmarktest64/benchmark_command_ring/benchmark_command_ring
+ */
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <android-base/properties.h>
+#include <benchmark/benchmark.h>
+
+#include <aaudio/AAudio.h>
+#include "binding/AAudioCommandRing.h"
+#include "utility/AAudioUtilities.h"
+#include "utility/AudioClock.h"
+
+using namespace aaudio;
+
+static void BM_CommandRingRoundTrip(benchmark::State& state) {
+    const size_t sizeInBytes = 2 * sizeof(int64_t)
+            + AAudioCommandRing::kBytesPerFrame * AAudioCommandRing::kCapacityInFrames;
+    auto memory = (uint8_t *) mmap(nullptr, sizeInBytes, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        state.SkipWithError("mmap failed");
+        return;
+    }
+    RingBufferDescriptor descriptor{};
+    descriptor.readCounterAddress = (int64_t *) &memory[0];
+    descriptor.writeCounterAddress = (int64_t *) &memory[sizeof(int64_t)];
+    descriptor.dataAddress = &memory[2 * sizeof(int64_t)];
+    descriptor.bytesPerFrame = AAudioCommandRing::kBytesPerFrame;
+    descriptor.framesPerBurst = 1;
+    descriptor.capacityInFrames = AAudioCommandRing::kCapacityInFrames;
+
+    const pid_t pid = fork();
+    if (pid == 0) {
+        // Like the command thread of the service, until it is killed.
+        AAudioCommandRing service;
+        (void) service.configure(descriptor);
+        while (true) {
+            const uint32_t doorbell = service.getDoorbell();
+            AAudioCommandRing::Command command;
+            if (service.take(&command)) {
+                service.complete(command, AAUDIO_OK);
+            } else {
+                service.waitForDoorbell(doorbell, -1);
+            }
+        }
+    }
+
+    AAudioCommandRing client;
+    (void) client.configure(descriptor);
+    for (auto _ : state) {
+        aaudio_result_t result = client.send(AAUDIO_CLIENT_COMMAND_START)
+                .wait(AAUDIO_NANOS_PER_SECOND);
+        if (result != AAUDIO_OK) {
+            state.SkipWithError("command failed");
+            break;
+        }
+    }
+
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    munmap(memory, sizeInBytes);
+}
+
+BENCHMARK(BM_CommandRingRoundTrip);
+
+// Arg is 1 to send the commands through the ring, 0 to send them with Binder.
+static void BM_StreamStartStop(benchmark::State& state) {
+    const bool useCommandRing = state.range(0) != 0;
+    const bool previous = android::base::GetBoolProperty(AAUDIO_PROP_COMMAND_RING, true);
+    // The property is read when the stream is opened.
+    if (!android::base::SetProperty(AAUDIO_PROP_COMMAND_RING, useCommandRing ? "1" : "0")
+            || android::base::GetBoolProperty(AAUDIO_PROP_COMMAND_RING, true) != useCommandRing) {
+        state.SkipWithError("cannot set " AAUDIO_PROP_COMMAND_RING ", run as root");
+        return;
+    }
+
+    AAudioStreamBuilder *builder = nullptr;
+    AAudioStream *stream = nullptr;
+    AAudio_createStreamBuilder(&builder);
+    AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_SHARED);
+    AAudioStreamBuilder_setPerformanceMode(builder, AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &stream);
+    AAudioStreamBuilder_delete(builder);
+    if (result != AAUDIO_OK) {
+        state.SkipWithError(AAudio_convertResultToText(result));
+    } else {
+        for (auto _ : state) {
+            if ((result = AAudioStream_requestStart(stream)) != AAUDIO_OK
+                    || (result = AAudioStream_requestStop(stream)) != AAUDIO_OK) {
+                state.SkipWithError(AAudio_convertResultToText(result));
+                break;
+            }
+        }
+        AAudioStream_close(stream);
+    }
+
+    android::base::SetProperty(AAUDIO_PROP_COMMAND_RING, previous ? "1" : "0");
+}
+
+BENCHMARK(BM_StreamStartStop)->ArgName("ring")->Arg(0)->Arg(1)->UseRealTime();
+
+BENCHMARK_MAIN();
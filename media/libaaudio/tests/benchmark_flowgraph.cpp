@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compare the cost of converting one burst through AAudioFlowGraph
+ * with the fused kernel and with the nodes run one by one,
+ * for common client configurations.
+ *
+ * The burst is passed to process() the way AudioStreamInternalPlay and
+ * AudioStreamInternalCapture do: kDefaultBufferSize frames per call for the nodes,
+ * and the whole burst in one call for the fused kernel. The fused kernel is also
+ * measured with kDefaultBufferSize frames per call, to show the cost of the calls.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <aaudio/AAudio.h>
+#include "client/AAudioFlowGraph.h"
+
+using namespace RESAMPLER_OUTER_NAMESPACE::resampler;
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kFramesPerBurst = 192;
+
+struct FlowGraphConfig {
+    audio_format_t sourceFormat;
+    int32_t sourceChannelCount;
+    audio_format_t sinkFormat;
+    int32_t sinkChannelCount;
+    bool useVolumeRamps;
+};
+
+static const FlowGraphConfig kConfigs[] = {
+    // Playback of an app writing 16-bit or float, to a float shared stream.
+    {AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_FLOAT, 2, false},
+    {AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_FLOAT, 2, false},
+    {AUDIO_FORMAT_PCM_16_BIT, 1, AUDIO_FORMAT_PCM_FLOAT, 2, false},
+    // Playback to an exclusive stream, with volume ramps.
+    {AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_16_BIT, 2, true},
+    {AUDIO_FORMAT_PCM_16_BIT, 2, AUDIO_FORMAT_PCM_24_BIT_PACKED, 2, true},
+    {AUDIO_FORMAT_PCM_FLOAT, 8, AUDIO_FORMAT_PCM_32_BIT, 8, true},
+    // Capture from a float or 24-bit device.
+    {AUDIO_FORMAT_PCM_FLOAT, 2, AUDIO_FORMAT_PCM_16_BIT, 2, false},
+    {AUDIO_FORMAT_PCM_24_BIT_PACKED, 8, AUDIO_FORMAT_PCM_FLOAT, 8, false},
+};
+
+enum CallPattern {
+    NODES,              // the nodes, kDefaultBufferSize frames per process()
+    FUSED_SMALL_CALLS,  // the fused kernel, kDefaultBufferSize frames per process()
+    FUSED,              // the fused kernel, the whole burst in one process()
+};
+
+static void BM_FlowGraphBurst(benchmark::State& state) {
+    const FlowGraphConfig& config = kConfigs[state.range(0)];
+    const CallPattern callPattern = (CallPattern) state.range(1);
+    const bool allowFusedKernel = callPattern != NODES;
+
+    AAudioFlowGraph flowgraph;
+    if (flowgraph.configure(config.sourceFormat, config.sourceChannelCount, kSampleRate,
+            config.sinkFormat, config.sinkChannelCount, kSampleRate,
+            false /* useMonoBlend */, config.useVolumeRamps, 0.0f /* audioBalance */,
+            MultiChannelResampler::Quality::Medium, allowFusedKernel) != AAUDIO_OK) {
+        state.SkipWithError("configure failed");
+        return;
+    }
+    std::vector<uint8_t> source(kFramesPerBurst * config.sourceChannelCount
+            * audio_bytes_per_sample(config.sourceFormat));
+    for (size_t i = 0; i < source.size(); i++) {
+        source[i] = (uint8_t) (i * 7);
+    }
+    if (config.sourceFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        std::vector<float> samples(kFramesPerBurst * config.sourceChannelCount, 0.25f);
+        memcpy(source.data(), samples.data(), source.size());
+    }
+    std::vector<uint8_t> sink(kFramesPerBurst * config.sinkChannelCount
+            * audio_bytes_per_sample(config.sinkFormat));
+
+    const int32_t framesPerCall = callPattern == FUSED
+            ? kFramesPerBurst : FLOWGRAPH_OUTER_NAMESPACE::flowgraph::kDefaultBufferSize;
+    const int32_t sourceBytesPerCall = framesPerCall * config.sourceChannelCount
+            * audio_bytes_per_sample(config.sourceFormat);
+    const int32_t sinkBytesPerFrame = config.sinkChannelCount
+            * audio_bytes_per_sample(config.sinkFormat);
+
+    for (auto _ : state) {
+        const uint8_t *sourceData = source.data();
+        uint8_t *sinkData = sink.data();
+        int32_t framesLeft = kFramesPerBurst;
+        while (framesLeft > 0) {
+            const int32_t framesToWrite = std::min(framesPerCall, framesLeft);
+            const int32_t framesRead = flowgraph.process(sourceData, framesToWrite,
+                    sinkData, framesLeft);
+            sourceData += sourceBytesPerCall;
+            sinkData += framesRead * sinkBytesPerFrame;
+            framesLeft -= framesToWrite;
+        }
+        benchmark::DoNotOptimize(sinkData);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetLabel(std::string(audio_format_to_string(config.sourceFormat))
+            + "x" + std::to_string(config.sourceChannelCount)
+            + "->" + audio_format_to_string(config.sinkFormat)
+            + "x" + std::to_string(config.sinkChannelCount)
+            + (config.useVolumeRamps ? " ramps" : "")
+            + (callPattern == NODES ? " nodes"
+                    : callPattern == FUSED_SMALL_CALLS ? " fused small calls" : " fused"));
+    state.SetItemsProcessed(state.iterations() * kFramesPerBurst);
+}
+
+BENCHMARK(BM_FlowGraphBurst)
+        ->ArgNames({"config", "calls"})
+        ->ArgsProduct({benchmark::CreateDenseRange(0, std::size(kConfigs) - 1, 1),
+                       {NODES, FUSED_SMALL_CALLS, FUSED}});
+
+BENCHMARK_MAIN();
@@ -19,6 +19,10 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include <aaudio/AAudio.h>
 #include <audio_utils/clock.h>
@@ -120,6 +124,90 @@ public:
         }
     }
 
+    struct Timestamp {
+        int64_t position;
+        int64_t nanoTime;
+    };
+
+    /**
+     * Parse the timestamps logged by the model when AAUDIO_LOG_CLOCK_MODEL_TIMESTAMPS
+     * is set in aaudio.log_mask, for example:
+     *   ... D IsochronousClockModel: processTimestamp() CSV, 12, 4800, 1234567890
+     * Other lines are ignored, so a whole logcat can be replayed.
+     */
+    static std::vector<Timestamp> parseTrace(std::istream &input) {
+        std::vector<Timestamp> trace;
+        std::string line;
+        while (std::getline(input, line)) {
+            const size_t start = line.find("CSV, ");
+            if (start == std::string::npos) continue;
+            int count;
+            long long position;
+            long long nanoTime;
+            if (sscanf(line.c_str() + start, "CSV, %d, %lld, %lld",
+                       &count, &position, &nanoTime) == 3) {
+                trace.push_back({position, nanoTime});
+            }
+        }
+        return trace;
+    }
+
+    /**
+     * Write a trace in the logged format for a DSP running at the specified rate,
+     * sampled randomly like checkDriftingClock(), with a pause at the specified time.
+     */
+    static std::string makeTrace(double hardwareFramesPerSecond, int numTimestamps,
+                                 double pauseAtSeconds = -1.0, double pauseSeconds = 0.0) {
+        std::stringstream trace;
+        const int64_t startTimeNanos = 500000000; // arbitrary
+        double elapsedTimeSeconds = 0.0;
+        double pausedSeconds = 0.0;
+        srand48(654321); // arbitrary seed for repeatable test results
+        for (int i = 0; i < numTimestamps; i++) {
+            elapsedTimeSeconds += 10.0 * drand48() * NANOS_PER_BURST / NANOS_PER_SECOND;
+            if (pauseAtSeconds >= 0.0 && elapsedTimeSeconds > pauseAtSeconds) {
+                pausedSeconds = pauseSeconds;
+            }
+            const int64_t runningFrames = (int64_t) (hardwareFramesPerSecond
+                    * (elapsedTimeSeconds - pausedSeconds));
+            const int64_t position = HW_FRAMES_PER_BURST
+                    + (runningFrames / HW_FRAMES_PER_BURST) * HW_FRAMES_PER_BURST;
+            const int64_t nanoTime = startTimeNanos + NANOS_PER_MILLISECOND
+                    + (int64_t) ((elapsedTimeSeconds + (drand48() * NANOS_PER_BURST
+                    / NANOS_PER_SECOND)) * NANOS_PER_SECOND);
+            trace << "10-16 12:00:00.000  1234  1250 D IsochronousClockModel: "
+                  << "processTimestamp() CSV, " << (i + 1) << ", " << position
+                  << ", " << nanoTime << "\n";
+        }
+        return trace.str();
+    }
+
+    /**
+     * Replay a trace through the model.
+     * @return number of timestamps, after the first second, where the model position
+     *         was more than the tolerance away from the HW position
+     */
+    int replayTrace(const std::vector<Timestamp> &trace, int32_t aggressiveness,
+                    int64_t toleranceFrames) {
+        int misses = 0;
+        if (trace.empty()) return misses;
+        model.setAggressiveness(aggressiveness);
+        model.start(trace[0].nanoTime - NANOS_PER_MILLISECOND);
+        for (const Timestamp &timestamp : trace) {
+            model.processTimestamp(timestamp.position, timestamp.nanoTime);
+            if (timestamp.nanoTime - trace[0].nanoTime < NANOS_PER_SECOND) continue;
+            const int64_t modelPosition = model.convertTimeToPosition(timestamp.nanoTime);
+            if (std::abs(modelPosition - timestamp.position) > toleranceFrames) {
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    int32_t getCorrectionCount() const {
+        return model.getEarlyCorrectionCount() + model.getLateCorrectionCount();
+    }
+
     IsochronousClockModel model;
 };
 
@@ -127,6 +215,8 @@ public:
 TEST_F(ClockModelTestFixture, clock_setup) {
     ASSERT_EQ(SAMPLE_RATE, model.getSampleRate());
     ASSERT_EQ(HW_FRAMES_PER_BURST, model.getFramesPerBurst());
+    // Rate tracking is off unless aaudio.clock_model_aggressiveness is set.
+    ASSERT_EQ(0.0, model.getRateErrorPpm());
 }
 
 // Test delta calculations.
@@ -208,3 +298,59 @@ TEST_F(ClockModelTestFixture, clock_fast_drift) {
 TEST_F(ClockModelTestFixture, clock_jump_forward_500) {
     checkDriftingClock(SAMPLE_RATE, NUM_LOOPS_DRIFT, 0.500);
 }
+
+// Replay a trace of a slow DSP clock, with a pause, through the logged format.
+// Tracking the rate should remove most of the corrections without losing the position.
+TEST_F(ClockModelTestFixture, clock_replay_trace) {
+    constexpr double kSlowRate = 0.99996 * SAMPLE_RATE; // -40 ppm
+    const std::vector<Timestamp> trace = [&]() {
+        std::istringstream input(makeTrace(kSlowRate, 40000, 60.0, 0.200));
+        return parseTrace(input);
+    }();
+    ASSERT_EQ(40000u, trace.size());
+
+    const int missesFixedRate = replayTrace(trace, 0 /* aggressiveness */,
+            2 * HW_FRAMES_PER_BURST);
+    const int32_t correctionsFixedRate = getCorrectionCount();
+    EXPECT_EQ(0.0, model.getRateErrorPpm());
+
+    const int missesTracked = replayTrace(trace, 2 /* aggressiveness */,
+            2 * HW_FRAMES_PER_BURST);
+    const int32_t correctionsTracked = getCorrectionCount();
+    EXPECT_NEAR(-40.0, model.getRateErrorPpm(), 5.0);
+    EXPECT_EQ(1, model.getDspStallCount());
+    EXPECT_LT(correctionsTracked * 4, correctionsFixedRate);
+    EXPECT_LE(missesTracked, missesFixedRate);
+
+    const std::string dump = model.dumpToString();
+    EXPECT_NE(std::string::npos, dump.find("rate error = "));
+    EXPECT_NE(std::string::npos, dump.find("lateness, "));
+    EXPECT_NE(std::string::npos, dump.find("jitter, "));
+}
+
+// Replay a trace recorded on a device, if specified, for example:
+//    adb shell setprop aaudio.log_mask 2
+//    (run the app)
+//    adb logcat -d -s IsochronousClockModel > trace.txt
+//    adb push trace.txt /data/local/tmp
+//    adb shell AAUDIO_CLOCK_MODEL_TRACE=/data/local/tmp/trace.txt test_clock_model
+TEST_F(ClockModelTestFixture, clock_replay_recorded_trace) {
+    const char *fileName = getenv("AAUDIO_CLOCK_MODEL_TRACE");
+    if (fileName == nullptr) {
+        GTEST_SKIP() << "AAUDIO_CLOCK_MODEL_TRACE not set";
+    }
+    std::ifstream input(fileName);
+    ASSERT_TRUE(input.good()) << fileName;
+    const std::vector<Timestamp> trace = parseTrace(input);
+    ASSERT_FALSE(trace.empty()) << "no timestamps in " << fileName;
+
+    const int missesFixedRate = replayTrace(trace, 0 /* aggressiveness */,
+            2 * HW_FRAMES_PER_BURST);
+    const int32_t correctionsFixedRate = getCorrectionCount();
+    const int missesTracked = replayTrace(trace, IsochronousClockModel::kMaxAggressiveness / 4,
+            2 * HW_FRAMES_PER_BURST);
+    printf("%s", model.dumpToString().c_str());
+    printf("fixed rate: %d corrections, %d misses; tracked: %d corrections, %d misses\n",
+           correctionsFixedRate, missesFixedRate, getCorrectionCount(), missesTracked);
+    EXPECT_LE(missesTracked, missesFixedRate);
+}
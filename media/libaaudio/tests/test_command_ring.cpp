@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Unit tests for AAudioCommandRing, the shared memory ring of client control commands.
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <aaudio/AAudio.h>
+#include "binding/AAudioCommandRing.h"
+#include "utility/AudioClock.h"
+
+using namespace aaudio;
+
+// Shared memory with the same layout as SharedRingBuffer in the service.
+class CommandRingMemory {
+public:
+    CommandRingMemory() {
+        mMemory = (uint8_t *) mmap(nullptr, kSizeInBytes, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        EXPECT_NE(MAP_FAILED, mMemory);
+        mDescriptor.readCounterAddress = (int64_t *) &mMemory[0];
+        mDescriptor.writeCounterAddress = (int64_t *) &mMemory[sizeof(int64_t)];
+        mDescriptor.dataAddress = &mMemory[2 * sizeof(int64_t)];
+        mDescriptor.bytesPerFrame = AAudioCommandRing::kBytesPerFrame;
+        mDescriptor.framesPerBurst = 1;
+        mDescriptor.capacityInFrames = AAudioCommandRing::kCapacityInFrames;
+    }
+
+    ~CommandRingMemory() {
+        munmap(mMemory, kSizeInBytes);
+    }
+
+    const RingBufferDescriptor &getDescriptor() const { return mDescriptor; }
+
+    void setWriteCounter(int64_t counter) { *mDescriptor.writeCounterAddress = counter; }
+
+private:
+    static constexpr size_t kSizeInBytes = 2 * sizeof(int64_t)
+            + AAudioCommandRing::kBytesPerFrame * AAudioCommandRing::kCapacityInFrames;
+
+    uint8_t *mMemory = nullptr;
+    RingBufferDescriptor mDescriptor{};
+};
+
+class CommandRingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_EQ(AAUDIO_OK, mClient.configure(mMemory.getDescriptor()));
+        ASSERT_EQ(AAUDIO_OK, mService.configure(mMemory.getDescriptor()));
+    }
+
+    CommandRingMemory mMemory;
+    AAudioCommandRing mClient;
+    AAudioCommandRing mService;
+};
+
+TEST(test_command_ring, command_ring_not_provided) {
+    AAudioCommandRing ring;
+    RingBufferDescriptor descriptor{}; // as resolved when the service does not provide a ring
+    EXPECT_EQ(AAUDIO_ERROR_UNIMPLEMENTED, ring.configure(descriptor));
+    EXPECT_FALSE(ring.isConfigured());
+    AAudioCommandFuture future = ring.send(AAUDIO_CLIENT_COMMAND_START);
+    EXPECT_FALSE(future.isValid());
+    EXPECT_EQ(AAUDIO_ERROR_INVALID_STATE, future.wait(0));
+}
+
+TEST_F(CommandRingTest, command_ring_send_take_complete) {
+    const uint32_t doorbell = mService.getDoorbell();
+    EXPECT_FALSE(mService.hasCommand());
+
+    AAudioCommandFuture future = mClient.send(AAUDIO_CLIENT_COMMAND_PAUSE);
+    ASSERT_TRUE(future.isValid());
+    EXPECT_NE(doorbell, mService.getDoorbell());
+    EXPECT_TRUE(mService.hasCommand());
+
+    AAudioCommandRing::Command command;
+    ASSERT_TRUE(mService.take(&command));
+    EXPECT_EQ(AAUDIO_CLIENT_COMMAND_PAUSE, command.command);
+    mService.complete(command, AAUDIO_ERROR_INVALID_STATE);
+    EXPECT_FALSE(mService.hasCommand());
+    EXPECT_FALSE(mService.take(&command));
+
+    EXPECT_EQ(AAUDIO_ERROR_INVALID_STATE, future.wait(0));
+}
+
+TEST_F(CommandRingTest, command_ring_wraps) {
+    for (int i = 0; i < 10 * AAudioCommandRing::kCapacity; i++) {
+        const auto sent = static_cast<aaudio_client_command_t>(i % AAUDIO_CLIENT_COMMAND_COUNT);
+        AAudioCommandFuture future = mClient.send(sent);
+        ASSERT_TRUE(future.isValid());
+        AAudioCommandRing::Command command;
+        ASSERT_TRUE(mService.take(&command));
+        EXPECT_EQ(sent, command.command);
+        mService.complete(command, -i);
+        EXPECT_EQ(-i, future.wait(0));
+    }
+}
+
+TEST_F(CommandRingTest, command_ring_full) {
+    AAudioCommandFuture futures[AAudioCommandRing::kCapacity];
+    for (auto &future : futures) {
+        future = mClient.send(AAUDIO_CLIENT_COMMAND_STOP);
+        ASSERT_TRUE(future.isValid());
+    }
+    EXPECT_FALSE(mClient.send(AAUDIO_CLIENT_COMMAND_STOP).isValid());
+
+    // The service catches up, in order.
+    for (int i = 0; i < AAudioCommandRing::kCapacity; i++) {
+        AAudioCommandRing::Command command;
+        ASSERT_TRUE(mService.take(&command));
+        mService.complete(command, i);
+    }
+    for (int i = 0; i < AAudioCommandRing::kCapacity; i++) {
+        EXPECT_EQ(i, futures[i].wait(0));
+    }
+    EXPECT_TRUE(mClient.send(AAUDIO_CLIENT_COMMAND_STOP).isValid());
+}
+
+TEST_F(CommandRingTest, command_ring_timeout) {
+    AAudioCommandFuture future = mClient.send(AAUDIO_CLIENT_COMMAND_START);
+    ASSERT_TRUE(future.isValid());
+    const int64_t timeoutNanos = 20 * AAUDIO_NANOS_PER_MILLISECOND;
+    const int64_t beginNanos = AudioClock::getNanoseconds();
+    EXPECT_EQ(AAUDIO_ERROR_TIMEOUT, future.wait(timeoutNanos));
+    EXPECT_GE(AudioClock::getNanoseconds() - beginNanos, timeoutNanos);
+}
+
+TEST_F(CommandRingTest, command_ring_corrupted_by_client) {
+    AAudioCommandRing::Command command;
+    for (int64_t counter : {int64_t{-1}, int64_t{AAudioCommandRing::kCapacity + 1},
+                            INT64_MIN, INT64_MAX}) {
+        mMemory.setWriteCounter(counter);
+        EXPECT_FALSE(mService.take(&command)) << counter;
+        // The service dropped the commands and now follows the client.
+        EXPECT_FALSE(mService.hasCommand()) << counter;
+    }
+    mMemory.setWriteCounter(0);
+    EXPECT_FALSE(mService.take(&command));
+
+    AAudioCommandFuture future = mClient.send(AAUDIO_CLIENT_COMMAND_FLUSH);
+    ASSERT_TRUE(future.isValid());
+    ASSERT_TRUE(mService.take(&command));
+    mService.complete(command, AAUDIO_OK);
+    EXPECT_EQ(AAUDIO_OK, future.wait(0));
+}
+
+TEST_F(CommandRingTest, command_ring_closed) {
+    AAudioCommandFuture future = mClient.send(AAUDIO_CLIENT_COMMAND_START);
+    ASSERT_TRUE(future.isValid());
+    mService.close(AAUDIO_ERROR_INVALID_HANDLE);
+    EXPECT_EQ(AAUDIO_ERROR_INVALID_HANDLE, future.wait(0));
+    // The client falls back to Binder.
+    EXPECT_FALSE(mClient.send(AAUDIO_CLIENT_COMMAND_STOP).isValid());
+}
+
+// The service closes the ring while the client is sending a command: the command is
+// either completed by close(), or not sent so that the client falls back to Binder.
+// It must never be left pending until the timeout.
+TEST(test_command_ring, command_ring_closed_while_sending) {
+    for (int i = 0; i < 2000; i++) {
+        CommandRingMemory memory;
+        AAudioCommandRing client;
+        AAudioCommandRing service;
+        ASSERT_EQ(AAUDIO_OK, client.configure(memory.getDescriptor()));
+        ASSERT_EQ(AAUDIO_OK, service.configure(memory.getDescriptor()));
+
+        std::atomic<bool> go{false};
+        std::thread closer([&]() {
+            while (!go.load()) {}
+            service.close(AAUDIO_ERROR_INVALID_HANDLE);
+        });
+        go.store(true);
+        AAudioCommandFuture future = client.send(AAUDIO_CLIENT_COMMAND_STOP);
+        closer.join();
+        if (future.isValid()) {
+            EXPECT_EQ(AAUDIO_ERROR_INVALID_HANDLE, future.wait(0)) << "iteration " << i;
+        }
+        EXPECT_FALSE(client.send(AAUDIO_CLIENT_COMMAND_STOP).isValid());
+    }
+}
+
+TEST_F(CommandRingTest, command_ring_cross_process) {
+    constexpr int kNumCommands = 100;
+    const pid_t pid = fork();
+    ASSERT_NE(-1, pid);
+    if (pid == 0) {
+        // The service executes each command as its index.
+        int executed = 0;
+        while (executed < kNumCommands) {
+            const uint32_t doorbell = mService.getDoorbell();
+            AAudioCommandRing::Command command;
+            if (mService.take(&command)) {
+                mService.complete(command, (aaudio_result_t) command.index);
+                executed++;
+            } else {
+                mService.waitForDoorbell(doorbell, AAUDIO_NANOS_PER_SECOND);
+            }
+        }
+        _exit(0);
+    }
+    for (int i = 0; i < kNumCommands; i++) {
+        AAudioCommandFuture future = mClient.send(AAUDIO_CLIENT_COMMAND_START);
+        ASSERT_TRUE(future.isValid());
+        EXPECT_EQ(i, future.wait(AAUDIO_NANOS_PER_SECOND));
+    }
+    int status = 0;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(0, WEXITSTATUS(status));
+}
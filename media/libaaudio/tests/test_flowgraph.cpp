@@ -22,6 +22,7 @@
  */
 
 #include <iostream>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -509,6 +510,86 @@ TEST(test_flowgraph, module_sourceI8_24) {
     }
 }
 
+// Run the same data through a fused and an unfused flowgraph, in chunks of varied sizes,
+// changing the volume between the chunks, and check that the outputs are identical.
+void checkFusedMatchesNodes(audio_format_t sourceFormat, int32_t sourceChannelCount,
+                            audio_format_t sinkFormat, int32_t sinkChannelCount,
+                            bool useVolumeRamps) {
+    SCOPED_TRACE(testing::Message() << "source format " << sourceFormat
+            << ", channels " << sourceChannelCount << ", sink format " << sinkFormat
+            << ", channels " << sinkChannelCount << ", ramps " << useVolumeRamps);
+    constexpr int32_t kSampleRate = 48000;
+    constexpr int32_t kNumFrames = 1000;
+    AAudioFlowGraph graphs[2];
+    for (int i = 0; i < 2; i++) {
+        ASSERT_EQ(AAUDIO_OK, graphs[i].configure(sourceFormat, sourceChannelCount, kSampleRate,
+                sinkFormat, sinkChannelCount, kSampleRate,
+                false /* useMonoBlend */, useVolumeRamps, 0.5f /* audioBalance */,
+                MultiChannelResampler::Quality::Medium, i == 0 /* allowFusedKernel */));
+        graphs[i].setRampLengthInFrames(37);
+    }
+    ASSERT_TRUE(graphs[0].isFused());
+    ASSERT_FALSE(graphs[1].isFused());
+
+    const int32_t sourceBytesPerFrame = sourceChannelCount * audio_bytes_per_sample(sourceFormat);
+    const int32_t sinkBytesPerFrame = sinkChannelCount * audio_bytes_per_sample(sinkFormat);
+    std::vector<uint8_t> source(kNumFrames * sourceBytesPerFrame);
+    if (sourceFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        // Exceed the range of the Limiter, and include a NaN.
+        float *samples = reinterpret_cast<float *>(source.data());
+        for (int i = 0; i < kNumFrames * sourceChannelCount; i++) {
+            samples[i] = 2.5f * sinf(i * 0.05f);
+        }
+        samples[101] = NAN;
+    } else {
+        for (size_t i = 0; i < source.size(); i++) {
+            source[i] = (uint8_t) (i * 37 + (i >> 3));
+        }
+    }
+
+    std::vector<uint8_t> sinks[2];
+    for (int i = 0; i < 2; i++) {
+        sinks[i].resize(kNumFrames * sinkBytesPerFrame);
+        int32_t framesDone = 0;
+        int32_t chunk = 1;
+        float volume = 1.0f;
+        while (framesDone < kNumFrames) {
+            chunk = std::min(chunk, kNumFrames - framesDone);
+            // Read half of each chunk with process() and the rest with pull().
+            const int32_t half = chunk / 2;
+            int32_t framesRead = graphs[i].process(
+                    source.data() + framesDone * sourceBytesPerFrame, chunk,
+                    sinks[i].data() + framesDone * sinkBytesPerFrame, half);
+            ASSERT_EQ(half, framesRead);
+            framesRead += graphs[i].pull(
+                    sinks[i].data() + (framesDone + half) * sinkBytesPerFrame, chunk - half);
+            ASSERT_EQ(chunk, framesRead);
+            framesDone += chunk;
+            chunk += 13;
+            volume = volume > 0.5f ? 0.25f : 0.75f;
+            graphs[i].setTargetVolume(volume);
+        }
+    }
+    for (size_t i = 0; i < sinks[0].size(); i++) {
+        ASSERT_EQ(sinks[1][i], sinks[0][i]) << "byte " << i;
+    }
+}
+
+TEST(test_flowgraph, flowgraph_fused_matches_nodes) {
+    const audio_format_t formats[] = {AUDIO_FORMAT_PCM_FLOAT, AUDIO_FORMAT_PCM_16_BIT,
+            AUDIO_FORMAT_PCM_24_BIT_PACKED, AUDIO_FORMAT_PCM_32_BIT, AUDIO_FORMAT_PCM_8_24_BIT};
+    for (audio_format_t sourceFormat : formats) {
+        for (audio_format_t sinkFormat : formats) {
+            for (bool useVolumeRamps : {false, true}) {
+                checkFusedMatchesNodes(sourceFormat, 1, sinkFormat, 1, useVolumeRamps);
+                checkFusedMatchesNodes(sourceFormat, 1, sinkFormat, 2, useVolumeRamps);
+                checkFusedMatchesNodes(sourceFormat, 2, sinkFormat, 2, useVolumeRamps);
+                checkFusedMatchesNodes(sourceFormat, 8, sinkFormat, 8, useVolumeRamps);
+            }
+        }
+    }
+}
+
 void checkSampleRateConversionVariedSizes(int32_t sourceSampleRate,
                     int32_t sinkSampleRate,
                     MultiChannelResampler::Quality resamplerQuality) {
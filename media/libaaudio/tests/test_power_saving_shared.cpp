@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Compare the wakeup rate and the CPU load of a SHARED MMAP output stream
+ * mixed by the low latency endpoint and by the power optimized endpoint.
+ *
+ * Changing "aaudio.mmap_power_saving" requires root, for example:
+ *   adb root
+ *   adb shell /data/nativetest64/test_power_saving_shared/test_power_saving_shared
+ */
+
+#define LOG_TAG "test_power_saving_shared"
+
+#include <atomic>
+#include <dirent.h>
+#include <fstream>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#include <aaudio/AAudio.h>
+#include <aaudio/AAudioTesting.h>
+#include <android-base/properties.h>
+#include <android/log.h>
+#include <android/media/audio/common/AudioMMapPolicyInfo.h>
+#include <android/media/audio/common/AudioMMapPolicyType.h>
+#include <media/AudioSystem.h>
+
+#include <gtest/gtest.h>
+
+#include "core/AudioGlobal.h"
+#include "utility/AAudioUtilities.h"
+#include "utility/AudioClock.h"
+
+using android::media::audio::common::AudioMMapPolicyInfo;
+using android::media::audio::common::AudioMMapPolicyType;
+using namespace aaudio;
+
+constexpr int64_t kSettleNanos = 500 * AAUDIO_NANOS_PER_MILLISECOND;
+constexpr int64_t kMeasureNanos = 2 * AAUDIO_NANOS_PER_SECOND;
+
+// CPU time and context switches of all the threads of a process, from /proc.
+struct ProcessUsage {
+    int64_t cpuNanos = -1;
+    int64_t contextSwitches = -1;
+};
+
+static pid_t findProcess(const std::string &name) {
+    pid_t result = -1;
+    DIR *dir = opendir("/proc");
+    if (dir == nullptr) return result;
+    while (struct dirent *entry = readdir(dir)) {
+        const pid_t pid = atoi(entry->d_name);
+        if (pid <= 0) continue;
+        std::ifstream comm("/proc/" + std::to_string(pid) + "/comm");
+        std::string line;
+        if (std::getline(comm, line) && line == name) {
+            result = pid;
+            break;
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+static ProcessUsage getProcessUsage(pid_t pid) {
+    ProcessUsage usage;
+    if (pid <= 0) return usage;
+    const std::string path = "/proc/" + std::to_string(pid);
+
+    // utime and stime are the 14th and 15th fields, after the command in parentheses.
+    std::ifstream stat(path + "/stat");
+    std::string line;
+    if (std::getline(stat, line)) {
+        const size_t end = line.rfind(')');
+        long long utime = 0, stime = 0;
+        if (end != std::string::npos
+                && sscanf(line.c_str() + end + 1,
+                          " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lld %lld",
+                          &utime, &stime) == 2) {
+            usage.cpuNanos = (utime + stime) * AAUDIO_NANOS_PER_SECOND / sysconf(_SC_CLK_TCK);
+        }
+    }
+
+    // Each thread counts its own context switches.
+    DIR *dir = opendir((path + "/task").c_str());
+    if (dir == nullptr) return usage;
+    int64_t switches = 0;
+    while (struct dirent *entry = readdir(dir)) {
+        if (atoi(entry->d_name) <= 0) continue;
+        std::ifstream status(path + "/task/" + entry->d_name + "/status");
+        while (std::getline(status, line)) {
+            long long value = 0;
+            if (sscanf(line.c_str(), "voluntary_ctxt_switches: %lld", &value) == 1
+                    || sscanf(line.c_str(), "nonvoluntary_ctxt_switches: %lld", &value) == 1) {
+                switches += value;
+            }
+        }
+    }
+    closedir(dir);
+    usage.contextSwitches = switches;
+    return usage;
+}
+
+static int64_t getProcessCpuNanos() {
+    struct timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec * AAUDIO_NANOS_PER_SECOND + time.tv_nsec;
+}
+
+struct Measurement {
+    int32_t framesPerBurst = 0;
+    double callbacksPerSecond = 0;
+    double clientCpuPercent = 0;
+    double serviceCpuPercent = -1;      // negative if not available
+    double serviceSwitchesPerSecond = -1;
+};
+
+static aaudio_data_callback_result_t countingCallback(AAudioStream *stream, void *userData,
+                                                      void *audioData, int32_t numFrames) {
+    memset(audioData, 0, numFrames * AAudioStream_getChannelCount(stream) * sizeof(float));
+    static_cast<std::atomic<int64_t> *>(userData)->fetch_add(1);
+    return AAUDIO_CALLBACK_RESULT_CONTINUE;
+}
+
+static double perSecond(int64_t count, int64_t nanos) {
+    return count * static_cast<double>(AAUDIO_NANOS_PER_SECOND) / nanos;
+}
+
+// Plays silence on a SHARED output stream, which must use MMAP.
+static void measure(aaudio_performance_mode_t performanceMode, Measurement *measurement) {
+    std::atomic<int64_t> callbacks{0};
+    AAudioStreamBuilder *builder = nullptr;
+    AAudioStream *stream = nullptr;
+    ASSERT_EQ(AAUDIO_OK, AAudio_createStreamBuilder(&builder));
+    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_SHARED);
+    AAudioStreamBuilder_setPerformanceMode(builder, performanceMode);
+    AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+    AAudioStreamBuilder_setDataCallback(builder, countingCallback, &callbacks);
+    const aaudio_result_t result = AAudioStreamBuilder_openStream(builder, &stream);
+    AAudioStreamBuilder_delete(builder);
+    ASSERT_EQ(AAUDIO_OK, result);
+    if (!AAudioStream_isMMapUsed(stream)) {
+        AAudioStream_close(stream);
+        GTEST_SKIP() << AudioGlobal_convertPerformanceModeToText(performanceMode)
+                     << " stream does not use MMAP";
+    }
+    measurement->framesPerBurst = AAudioStream_getFramesPerBurst(stream);
+
+    const pid_t service = findProcess("audioserver");
+    ASSERT_EQ(AAUDIO_OK, AAudioStream_requestStart(stream));
+    AudioClock::sleepForNanos(kSettleNanos);
+
+    const int64_t beginNanos = AudioClock::getNanoseconds();
+    const int64_t beginCallbacks = callbacks.load();
+    const int64_t beginCpuNanos = getProcessCpuNanos();
+    const ProcessUsage beginService = getProcessUsage(service);
+    AudioClock::sleepForNanos(kMeasureNanos);
+    const ProcessUsage endService = getProcessUsage(service);
+    const int64_t elapsedNanos = AudioClock::getNanoseconds() - beginNanos;
+
+    measurement->callbacksPerSecond = perSecond(callbacks.load() - beginCallbacks, elapsedNanos);
+    measurement->clientCpuPercent = 100.0 * (getProcessCpuNanos() - beginCpuNanos) / elapsedNanos;
+    if (beginService.cpuNanos >= 0 && endService.cpuNanos >= 0) {
+        measurement->serviceCpuPercent =
+                100.0 * (endService.cpuNanos - beginService.cpuNanos) / elapsedNanos;
+    }
+    if (beginService.contextSwitches >= 0 && endService.contextSwitches >= 0) {
+        measurement->serviceSwitchesPerSecond = perSecond(
+                endService.contextSwitches - beginService.contextSwitches, elapsedNanos);
+    }
+
+    EXPECT_EQ(AAUDIO_OK, AAudioStream_requestStop(stream));
+    AAudioStream_close(stream);
+
+    printf("%-28s burst = %5d, callbacks/s = %7.1f, client CPU = %5.2f%%"
+           ", audioserver CPU = %5.2f%%, audioserver switches/s = %7.1f\n",
+           AudioGlobal_convertPerformanceModeToText(performanceMode),
+           measurement->framesPerBurst, measurement->callbacksPerSecond,
+           measurement->clientCpuPercent, measurement->serviceCpuPercent,
+           measurement->serviceSwitchesPerSecond);
+}
+
+static AAudioStream *openSharedOutput(aaudio_performance_mode_t performanceMode) {
+    AAudioStreamBuilder *builder = nullptr;
+    AAudioStream *stream = nullptr;
+    if (AAudio_createStreamBuilder(&builder) != AAUDIO_OK) return nullptr;
+    AAudioStreamBuilder_setDirection(builder, AAUDIO_DIRECTION_OUTPUT);
+    AAudioStreamBuilder_setSharingMode(builder, AAUDIO_SHARING_MODE_SHARED);
+    AAudioStreamBuilder_setPerformanceMode(builder, performanceMode);
+    AAudioStreamBuilder_setFormat(builder, AAUDIO_FORMAT_PCM_FLOAT);
+    if (AAudioStreamBuilder_openStream(builder, &stream) != AAUDIO_OK) {
+        stream = nullptr;
+    }
+    AAudioStreamBuilder_delete(builder);
+    return stream;
+}
+
+// Enables the power optimized endpoint, when MMAP is supported.
+class test_power_saving_shared : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::vector<AudioMMapPolicyInfo> policyInfos;
+        ASSERT_EQ(android::NO_ERROR, android::AudioSystem::getMmapPolicyInfos(
+                AudioMMapPolicyType::DEFAULT, &policyInfos));
+        if (AAudio_getAAudioPolicy(policyInfos) == AAUDIO_POLICY_NEVER) {
+            GTEST_SKIP() << "MMAP is not supported";
+        }
+
+        // The property is read when the stream is opened.
+        mPrevious = android::base::GetBoolProperty(AAUDIO_PROP_MMAP_POWER_SAVING, false);
+        if (!android::base::SetProperty(AAUDIO_PROP_MMAP_POWER_SAVING, "1")
+                || !android::base::GetBoolProperty(AAUDIO_PROP_MMAP_POWER_SAVING, false)) {
+            GTEST_SKIP() << "cannot set " AAUDIO_PROP_MMAP_POWER_SAVING ", run as root";
+        }
+        mPropertySet = true;
+    }
+
+    void TearDown() override {
+        if (mPropertySet) {
+            android::base::SetProperty(AAUDIO_PROP_MMAP_POWER_SAVING, mPrevious ? "1" : "0");
+        }
+    }
+
+private:
+    bool mPrevious = false;
+    bool mPropertySet = false;
+};
+
+TEST_F(test_power_saving_shared, wakeups_and_cpu) {
+    // One at a time, so that each one gets its own endpoint.
+    Measurement lowLatency;
+    Measurement powerSaving;
+    ASSERT_NO_FATAL_FAILURE(measure(AAUDIO_PERFORMANCE_MODE_LOW_LATENCY, &lowLatency));
+    if (IsSkipped()) return;
+    ASSERT_NO_FATAL_FAILURE(measure(AAUDIO_PERFORMANCE_MODE_POWER_SAVING, &powerSaving));
+    if (IsSkipped()) return;
+
+    // The CPU loads are reported but not checked, they depend too much on the device.
+    EXPECT_GT(powerSaving.framesPerBurst, lowLatency.framesPerBurst);
+    EXPECT_LT(powerSaving.callbacksPerSecond, lowLatency.callbacksPerSecond);
+}
+
+// A power saving stream that holds the MMAP device must not push a later low latency
+// stream onto the legacy path: the power saving stream is disconnected instead.
+TEST_F(test_power_saving_shared, low_latency_takes_priority) {
+    AAudioStream *powerSaving = openSharedOutput(AAUDIO_PERFORMANCE_MODE_POWER_SAVING);
+    ASSERT_NE(nullptr, powerSaving);
+    if (!AAudioStream_isMMapUsed(powerSaving)) {
+        AAudioStream_close(powerSaving);
+        GTEST_SKIP() << "power saving stream does not use MMAP";
+    }
+    EXPECT_EQ(AAUDIO_OK, AAudioStream_requestStart(powerSaving));
+
+    AAudioStream *lowLatency = openSharedOutput(AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
+    EXPECT_NE(nullptr, lowLatency);
+    if (lowLatency != nullptr) {
+        EXPECT_TRUE(AAudioStream_isMMapUsed(lowLatency));
+        aaudio_stream_state_t state = AAUDIO_STREAM_STATE_UNINITIALIZED;
+        AAudioStream_waitForStateChange(powerSaving, AAUDIO_STREAM_STATE_STARTED, &state,
+                                        AAUDIO_NANOS_PER_SECOND);
+        EXPECT_EQ(AAUDIO_STREAM_STATE_DISCONNECTED, AAudioStream_getState(powerSaving));
+
+        // A power saving stream opened now mixes into the low latency endpoint.
+        AAudioStream *reopened = openSharedOutput(AAUDIO_PERFORMANCE_MODE_POWER_SAVING);
+        EXPECT_NE(nullptr, reopened);
+        if (reopened != nullptr) {
+            EXPECT_TRUE(AAudioStream_isMMapUsed(reopened));
+            AAudioStream_close(reopened);
+        }
+        AAudioStream_close(lowLatency);
+    }
+    AAudioStream_close(powerSaving);
+}
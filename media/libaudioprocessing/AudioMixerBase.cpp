@@ -28,6 +28,7 @@
 #include <utils/Log.h>
 
 #include "AudioMixerOps.h"
+#include "AudioMixerOpsSimd.h"
 
 // The FCC_2 macro refers to the Fixed Channel Count of 2 for the legacy integer mixer.
 #ifndef FCC_2
@@ -652,6 +653,7 @@ void AudioMixerBase::process__validate()
             n |= NEEDS_MUTE;
         }
         t->needs = n;
+        t->mVolumeMixSimd = getVolumeMixSimdTable(t->mMixerChannelCount, t->mMixerInFormat);
 
         if (n & NEEDS_MUTE) {
             t->hook = &TrackBase::track__nop;
@@ -1387,6 +1389,53 @@ static void volumeMulti(uint32_t channels, TO* out, size_t frameCount,
     }
 }
 
+#if USE_MIXER_SIMD
+template <int NCHAN>
+static constexpr VolumeMixSimdTable makeVolumeMixSimdTable()
+{
+    return VolumeMixSimdTable{
+        { &volumeMixSimd<MIXTYPE_MONOVOL(MIXTYPE_MULTI, NCHAN), NCHAN, false>,
+          &volumeMixSimd<MIXTYPE_MONOVOL(MIXTYPE_MULTI, NCHAN), NCHAN, true> },
+        { &volumeMixSimd<MIXTYPE_MONOVOL(MIXTYPE_MULTI_SAVEONLY, NCHAN), NCHAN, false>,
+          &volumeMixSimd<MIXTYPE_MONOVOL(MIXTYPE_MULTI_SAVEONLY, NCHAN), NCHAN, true> },
+        { &volumeMixSimd<MIXTYPE_MULTI_STEREOVOL, NCHAN, false>,
+          &volumeMixSimd<MIXTYPE_MULTI_STEREOVOL, NCHAN, true> },
+        { &volumeMixSimd<MIXTYPE_MULTI_SAVEONLY_STEREOVOL, NCHAN, false>,
+          &volumeMixSimd<MIXTYPE_MULTI_SAVEONLY_STEREOVOL, NCHAN, true> },
+    };
+}
+
+// Helper to make the per channel count array of SIMD kernel tables.
+template <std::size_t ... Is>
+static constexpr auto makeVolumeMixSimdTables(std::index_sequence<Is...>)
+{
+    return std::array<VolumeMixSimdTable, sizeof...(Is)>{
+            { makeVolumeMixSimdTable<Is + 1>() ... }
+        };
+}
+#endif
+
+/* Returns the SIMD volume kernels for a track mixing in mixerInFormat with
+ * channelCount channels, or nullptr if there are none.
+ */
+/* static */
+const VolumeMixSimdTable *AudioMixerBase::getVolumeMixSimdTable(
+        uint32_t channelCount, audio_format_t mixerInFormat)
+{
+#if USE_MIXER_SIMD
+    static constexpr auto volumeMixSimdTables =
+            makeVolumeMixSimdTables(std::make_index_sequence<kMaxVolumeMixSimdChannels>());
+    if (kUseSimdMixer && mixerInFormat == AUDIO_FORMAT_PCM_FLOAT
+            && channelCount > 0 && channelCount <= volumeMixSimdTables.size()) {
+        return &volumeMixSimdTables[channelCount - 1];
+    }
+#else
+    (void)channelCount;
+    (void)mixerInFormat;
+#endif
+    return nullptr;
+}
+
 /* MIXTYPE     (see AudioMixerOps.h MIXTYPE_* enumeration)
  * USEFLOATVOL (set to true if float volume is used)
  * ADJUSTVOL   (set to true if volume ramp parameters needs adjustment afterwards)
@@ -1399,6 +1448,23 @@ template <int MIXTYPE, bool USEFLOATVOL, bool ADJUSTVOL,
 void AudioMixerBase::TrackBase::volumeMix(TO *out, size_t outFrames,
         const TI *in, TA *aux, bool ramp)
 {
+    if constexpr (std::is_same_v<TO, float> && std::is_same_v<TI, float>
+            && VolumeMixSimdTable::supports(MIXTYPE)) {
+        // The SIMD kernels do not handle the aux send.
+        if (mVolumeMixSimd != nullptr && aux == nullptr) {
+            if (ramp) {
+                mVolumeMixSimd->get<MIXTYPE>(true /* ramp */)(
+                        out, outFrames, in, mPrevVolume, mVolumeInc);
+                if (ADJUSTVOL) {
+                    adjustVolumeRamp(false /* aux */, true /* useFloat */);
+                }
+            } else {
+                mVolumeMixSimd->get<MIXTYPE>(false /* ramp */)(
+                        out, outFrames, in, mVolume, nullptr /* volinc */);
+            }
+            return;
+        }
+    }
     if (USEFLOATVOL) {
         if (ramp) {
             volumeRampMulti<MIXTYPE>(mMixerChannelCount, out, outFrames, in, aux,
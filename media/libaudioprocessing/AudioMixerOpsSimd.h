@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_MIXER_OPS_SIMD_H
+#define ANDROID_AUDIO_MIXER_OPS_SIMD_H
+
+#include <array>
+#include <numeric>
+
+#include "AudioMixerOps.h"
+
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#ifndef USE_MIXER_NEON
+#define USE_MIXER_NEON (true)
+#endif
+#else
+#define USE_MIXER_NEON (false)
+#endif
+
+#if USE_MIXER_NEON
+#include <arm_neon.h>
+#define USE_MIXER_AVX2 (false)
+#define USE_MIXER_SSE (false)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define USE_MIXER_AVX2 (true)
+#define USE_MIXER_SSE (false)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define USE_MIXER_AVX2 (false)
+#define USE_MIXER_SSE (true)
+#else
+#define USE_MIXER_AVX2 (false)
+#define USE_MIXER_SSE (false)
+#endif
+
+#define USE_MIXER_SIMD (USE_MIXER_NEON || USE_MIXER_AVX2 || USE_MIXER_SSE)
+
+namespace android {
+
+/*
+ * Specialized float volume kernels for the AudioMixer.
+ *
+ * These cover the common case of float tracks mixed into a float mix buffer
+ * without an aux send, which otherwise goes through the per-sample scalar loops
+ * of volumeMulti() and volumeRampMulti() in AudioMixerOps.h.
+ *
+ * The kernels are templated on the (MIXTYPE_MONOVOL adjusted) MIXTYPE, the channel count
+ * and the volume ramp state. The per-channel volume pattern of an interleaved
+ * buffer repeats every NCHAN samples, so we process blocks of
+ * lcm(NCHAN, lanes) samples with the volume pattern kept in vector registers.
+ * Leftover frames are handed to the scalar implementation.
+ *
+ * Results are not bit-exact with the scalar implementation when ramping,
+ * as the ramp is computed by multiplication rather than repeated accumulation.
+ */
+
+#if USE_MIXER_NEON
+struct MixerSimdFloat {
+    using vec_t = float32x4_t;
+    static constexpr size_t kLanes = 4;
+    static inline vec_t load(const float *p) { return vld1q_f32(p); }
+    static inline void store(float *p, vec_t v) { vst1q_f32(p, v); }
+    static inline vec_t add(vec_t a, vec_t b) { return vaddq_f32(a, b); }
+    static inline vec_t mul(vec_t a, vec_t b) { return vmulq_f32(a, b); }
+};
+#elif USE_MIXER_AVX2
+struct MixerSimdFloat {
+    using vec_t = __m256;
+    static constexpr size_t kLanes = 8;
+    static inline vec_t load(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void store(float *p, vec_t v) { _mm256_storeu_ps(p, v); }
+    static inline vec_t add(vec_t a, vec_t b) { return _mm256_add_ps(a, b); }
+    static inline vec_t mul(vec_t a, vec_t b) { return _mm256_mul_ps(a, b); }
+};
+#elif USE_MIXER_SSE
+struct MixerSimdFloat {
+    using vec_t = __m128;
+    static constexpr size_t kLanes = 4;
+    static inline vec_t load(const float *p) { return _mm_loadu_ps(p); }
+    static inline void store(float *p, vec_t v) { _mm_storeu_ps(p, v); }
+    static inline vec_t add(vec_t a, vec_t b) { return _mm_add_ps(a, b); }
+    static inline vec_t mul(vec_t a, vec_t b) { return _mm_mul_ps(a, b); }
+};
+#endif
+
+// Maximum channel count with a specialized kernel.
+constexpr inline size_t kMaxVolumeMixSimdChannels = 8;
+
+// Indices into the per-frame volume array used by the SIMD kernels.
+enum {
+    VOLUME_INDEX_LEFT = 0,
+    VOLUME_INDEX_RIGHT = 1,
+    VOLUME_INDEX_CENTER = 2,
+};
+
+// compile-time function.
+// Returns true if the MIXTYPE accumulates into the out pointer.
+constexpr inline bool mixTypeAccumulates(int mixtype) {
+    return mixtype == MIXTYPE_MULTI
+            || mixtype == MIXTYPE_MULTI_MONOVOL
+            || mixtype == MIXTYPE_MULTI_STEREOVOL;
+}
+
+// compile-time function.
+// Returns the volume index for each of the NCHAN interleaved channels,
+// matching the channel affinity of volumeMulti() for the same MIXTYPE.
+template <int MIXTYPE, int NCHAN>
+constexpr std::array<int, NCHAN> volumeIndexMap() {
+    std::array<int, NCHAN> map{};
+    if constexpr (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY) {
+        static_assert(NCHAN <= 2);
+        for (int i = 0; i < NCHAN; ++i) {
+            map[i] = i;
+        }
+    } else if constexpr (MIXTYPE == MIXTYPE_MULTI_MONOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_MONOVOL) {
+        for (int i = 0; i < NCHAN; ++i) {
+            map[i] = VOLUME_INDEX_LEFT;
+        }
+    } else if constexpr (MIXTYPE == MIXTYPE_MULTI_STEREOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_STEREOVOL) {
+        // See stereoVolumeHelperWithChannelMask().
+        using namespace audio_utils::channels;
+        constexpr audio_channel_mask_t MASK{canonicalChannelMaskFromCount(NCHAN)};
+        static_assert(MASK != AUDIO_CHANNEL_NONE);
+        constexpr unsigned LFE_LFE2 =
+                AUDIO_CHANNEL_OUT_LOW_FREQUENCY | AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2;
+        constexpr bool has_LFE_LFE2 = (MASK & LFE_LFE2) == LFE_LFE2;
+        int channel = 0;
+        for (size_t i = 0; i < std::size(kSideFromChannelIdx); ++i) {
+            if ((MASK & (1u << i)) == 0) continue;
+            const auto side = kSideFromChannelIdx[i];
+            if (side == AUDIO_GEOMETRY_SIDE_LEFT
+                    || (has_LFE_LFE2 && (1u << i) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY)) {
+                map[channel++] = VOLUME_INDEX_LEFT;
+            } else if (side == AUDIO_GEOMETRY_SIDE_RIGHT
+                    || (has_LFE_LFE2 && (1u << i) == AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2)) {
+                map[channel++] = VOLUME_INDEX_RIGHT;
+            } else {
+                map[channel++] = VOLUME_INDEX_CENTER;
+            }
+        }
+    } else /* constexpr */ {
+        static_assert(dependent_false<MIXTYPE>, "invalid mixtype");
+    }
+    return map;
+}
+
+#if USE_MIXER_SIMD
+
+/*
+ * volumeMixSimd is equivalent to volumeMulti() (RAMP false) or
+ * volumeRampMulti() (RAMP true) with float TO, TI and TV, and a null aux buffer.
+ *
+ * MIXTYPE: MIXTYPE_MULTI, MIXTYPE_MULTI_SAVEONLY (NCHAN <= 2),
+ *          MIXTYPE_MULTI_MONOVOL, MIXTYPE_MULTI_SAVEONLY_MONOVOL,
+ *          MIXTYPE_MULTI_STEREOVOL, MIXTYPE_MULTI_SAVEONLY_STEREOVOL.
+ * NCHAN:   number of input and output channels.
+ * vol:     volume array, updated to the final ramp volume if RAMP.
+ * volinc:  volume increment per frame, unused (may be nullptr) if !RAMP.
+ */
+template <int MIXTYPE, int NCHAN, bool RAMP>
+void volumeMixSimd(float *out, size_t frameCount, const float *in,
+        float *vol, const float *volinc)
+{
+    using V = MixerSimdFloat;
+    constexpr size_t kLanes = V::kLanes;
+    constexpr size_t kBlockFrames = kLanes / std::gcd(static_cast<size_t>(NCHAN), kLanes);
+    constexpr size_t kBlockSamples = kBlockFrames * NCHAN;
+    constexpr size_t kBlockVectors = kBlockSamples / kLanes;
+    constexpr std::array<int, NCHAN> kIndex = volumeIndexMap<MIXTYPE, NCHAN>();
+    constexpr bool kStereoVol = MIXTYPE == MIXTYPE_MULTI_STEREOVOL
+            || MIXTYPE == MIXTYPE_MULTI_SAVEONLY_STEREOVOL;
+    constexpr bool kUsesRight = kStereoVol || (NCHAN == 2
+            && (MIXTYPE == MIXTYPE_MULTI || MIXTYPE == MIXTYPE_MULTI_SAVEONLY));
+
+    const size_t blocks = frameCount / kBlockFrames;
+    if (blocks > 0) {
+        // center volume is the average of left and right (see stereoVolumeHelper).
+        const float frameVol[3] = { vol[0], vol[1], (vol[0] + vol[1]) * 0.5f };
+        float frameInc[3] = {};
+        if constexpr (RAMP) {
+            frameInc[0] = volinc[0];
+            frameInc[1] = volinc[1];
+            frameInc[2] = (volinc[0] + volinc[1]) * 0.5f;
+        }
+
+        float gain[kBlockSamples];
+        float gainInc[kBlockSamples];
+        for (size_t f = 0; f < kBlockFrames; ++f) {
+            for (size_t c = 0; c < NCHAN; ++c) {
+                const int index = kIndex[c];
+                gain[f * NCHAN + c] = frameVol[index] + f * frameInc[index];
+                gainInc[f * NCHAN + c] = kBlockFrames * frameInc[index];
+            }
+        }
+        typename V::vec_t g[kBlockVectors];
+        typename V::vec_t gi[kBlockVectors];
+        for (size_t v = 0; v < kBlockVectors; ++v) {
+            g[v] = V::load(gain + v * kLanes);
+            gi[v] = V::load(gainInc + v * kLanes);
+        }
+
+        for (size_t b = 0; b < blocks; ++b) {
+            for (size_t v = 0; v < kBlockVectors; ++v) {
+                typename V::vec_t x = V::mul(V::load(in), g[v]);
+                if constexpr (mixTypeAccumulates(MIXTYPE)) {
+                    x = V::add(V::load(out), x);
+                }
+                V::store(out, x);
+                in += kLanes;
+                out += kLanes;
+                if constexpr (RAMP) {
+                    g[v] = V::add(g[v], gi[v]);
+                }
+            }
+        }
+
+        if constexpr (RAMP) {
+            const size_t frames = blocks * kBlockFrames;
+            vol[0] += frames * volinc[0];
+            if constexpr (kUsesRight) {
+                vol[1] += frames * volinc[1];
+            }
+        }
+    }
+
+    const size_t remaining = frameCount - blocks * kBlockFrames;
+    if (remaining > 0) {
+        if constexpr (RAMP) {
+            volumeRampMulti<MIXTYPE, NCHAN>(out, remaining, in, (float *)nullptr,
+                    vol, volinc, (float *)nullptr, 0.f /* volainc */);
+        } else {
+            volumeMulti<MIXTYPE, NCHAN>(out, remaining, in, (float *)nullptr,
+                    vol, 0.f /* vola */);
+        }
+    }
+}
+
+#endif // USE_MIXER_SIMD
+
+/*
+ * The SIMD kernels for a given channel count, selected per track by
+ * AudioMixerBase::process__validate().
+ *
+ * Entries are indexed by the volume ramp state, [0] for constant volume, [1] for ramp.
+ * The MIXTYPE_MULTI and MIXTYPE_MULTI_SAVEONLY entries become the MONOVOL variants
+ * for more than 2 channels, consistent with the scalar mixer.
+ */
+struct VolumeMixSimdTable {
+    using kernel_t = void (*)(float *out, size_t frameCount, const float *in,
+            float *vol, const float *volinc);
+
+    kernel_t multi[2];
+    kernel_t multiSaveOnly[2];
+    kernel_t multiStereoVol[2];
+    kernel_t multiSaveOnlyStereoVol[2];
+
+    // compile-time function.
+    static constexpr bool supports(int mixtype) {
+        return mixtype == MIXTYPE_MULTI
+                || mixtype == MIXTYPE_MULTI_SAVEONLY
+                || mixtype == MIXTYPE_MULTI_STEREOVOL
+                || mixtype == MIXTYPE_MULTI_SAVEONLY_STEREOVOL;
+    }
+
+    template <int MIXTYPE>
+    kernel_t get(bool ramp) const {
+        static_assert(supports(MIXTYPE));
+        if constexpr (MIXTYPE == MIXTYPE_MULTI) {
+            return multi[ramp];
+        } else if constexpr (MIXTYPE == MIXTYPE_MULTI_SAVEONLY) {
+            return multiSaveOnly[ramp];
+        } else if constexpr (MIXTYPE == MIXTYPE_MULTI_STEREOVOL) {
+            return multiStereoVol[ramp];
+        } else /* constexpr */ {
+            return multiSaveOnlyStereoVol[ramp];
+        }
+    }
+};
+
+} // namespace android
+
+#endif /* ANDROID_AUDIO_MIXER_OPS_SIMD_H */
@@ -23,14 +23,18 @@
 #include <dlfcn.h>
 #include <math.h>
 
+#include <algorithm>
+
 #include <cutils/compiler.h>
 #include <cutils/properties.h>
 #include <utils/Log.h>
 #include <audio_utils/primitives.h>
 
 #include "AudioResamplerFirOps.h" // USE_NEON, USE_SSE and USE_INLINE_ASSEMBLY defined here
+#include "AudioResamplerFirProcessMulti.h"
 #include "AudioResamplerFirProcess.h"
 #include "AudioResamplerFirProcessNeon.h"
+#include "AudioResamplerFirProcessAVX.h"
 #include "AudioResamplerFirProcessSSE.h"
 #include "AudioResamplerFirGen.h" // requires math.h
 #include "AudioResamplerDyn.h"
@@ -42,6 +46,65 @@ constexpr size_t CACHE_LINE_SIZE = 64;
 
 namespace android {
 
+#if USE_SSE
+static AudioResampler::fir_simd detectFirSimd()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return AudioResampler::FIR_SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return AudioResampler::FIR_SIMD_AVX2;
+    }
+    return AudioResampler::FIR_SIMD_DEFAULT;
+}
+
+// AVX-512 may lower the clock of the core, which is not worth it for the resamplers
+// of an always-on audio path, so it must be opted into.
+static AudioResampler::fir_simd defaultFirSimd(AudioResampler::fir_simd maxFirSimd)
+{
+    if (maxFirSimd == AudioResampler::FIR_SIMD_AVX512
+            && !property_get_bool("ro.audio.resampler.avx512", false /* default_value */)) {
+        return AudioResampler::FIR_SIMD_AVX2;
+    }
+    return maxFirSimd;
+}
+
+static const AudioResampler::fir_simd kMaxFirSimd = detectFirSimd();
+static const AudioResampler::fir_simd kDefaultFirSimd = defaultFirSimd(kMaxFirSimd);
+std::atomic<int> gFirSimd{kDefaultFirSimd};
+#endif
+
+/* static */
+AudioResampler::fir_simd AudioResampler::maxFirSimd()
+{
+#if USE_SSE
+    return kMaxFirSimd;
+#else
+    return FIR_SIMD_DEFAULT;
+#endif
+}
+
+/* static */
+AudioResampler::fir_simd AudioResampler::defaultFirSimd()
+{
+#if USE_SSE
+    return kDefaultFirSimd;
+#else
+    return FIR_SIMD_DEFAULT;
+#endif
+}
+
+/* static */
+AudioResampler::fir_simd AudioResampler::setFirSimd(fir_simd simd)
+{
+    simd = std::min(simd, maxFirSimd());
+#if USE_SSE
+    gFirSimd.store(simd, std::memory_order_relaxed);
+#endif
+    return simd;
+}
+
 /*
  * InBuffer is a type agnostic input buffer.
  *
@@ -17,8 +17,6 @@
 #ifndef ANDROID_AUDIO_RESAMPLER_FIR_OPS_H
 #define ANDROID_AUDIO_RESAMPLER_FIR_OPS_H
 
-namespace android {
-
 #if defined(__arm__) && !defined(__thumb__)
 #define USE_INLINE_ASSEMBLY (true)
 #else
@@ -46,9 +44,10 @@ namespace android {
 #include <tmmintrin.h>
 #else
 #define USE_SSE (false)
-#define USE_AVX2(false)
+#define USE_AVX2 (false)
 #endif
 
+namespace android {
 
 template<typename T, typename U>
 struct is_same
@@ -19,7 +19,7 @@
 
 namespace android {
 
-// depends on AudioResamplerFirOps.h
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcessMulti.h
 
 /* variant for input type TI = int16_t input samples */
 template<typename TC>
@@ -256,6 +256,13 @@ void ProcessL(TO* const out,
         const TI* sN,
         const TO* const volumeLR)
 {
+#if USE_FIR_MULTI
+    if constexpr (isFirMultiSupported<CHANNELS, TC, TI, TO>()) {
+        ProcessMultiIntrinsic<CHANNELS, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
+        return;
+    }
+#endif
     ProcessBase<CHANNELS, STRIDE, InterpNull>(out, count, coefsP, coefsN, sP, sN, 0, volumeLR);
 }
 
@@ -305,6 +312,13 @@ void Process(TO* const out,
         TINTERP lerpP,
         const TO* const volumeLR)
 {
+#if USE_FIR_MULTI
+    if constexpr (isFirMultiSupported<CHANNELS, TC, TI, TO>()) {
+        ProcessMultiIntrinsic<CHANNELS, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        return;
+    }
+#endif
     ProcessBase<CHANNELS, STRIDE, InterpCompute>(out, count, coefsP, coefsN, sP, sN, lerpP,
             volumeLR);
 }
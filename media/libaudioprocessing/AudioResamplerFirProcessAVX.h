@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX_H
+
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+
+#if USE_SSE
+#include <atomic>
+#include <immintrin.h>
+
+#include <media/AudioResampler.h>
+#endif
+
+namespace android {
+
+#if USE_SSE
+
+//
+// AVX2 and AVX-512 versions of ProcessSSEIntrinsic() in AudioResamplerFirProcessSSE.h.
+//
+// The x86 ABI only guarantees SSSE3 (x86) or SSE4.2 (x86_64), so these are compiled
+// for their instruction set with the target attribute, and the SSEx specializations
+// of Process() and ProcessL() select them at run time through gFirSimd.
+//
+// The coefficient count is a multiple of 8, so the AVX-512 loop does a last iteration
+// of 8 with the AVX2 step if needed.
+//
+// The helpers must be inlined, as the vectors cannot be passed in registers to functions
+// of another target. The kernels clear the upper register state before returning;
+// otherwise the SSE code of the caller (and of the rest of the mixer) may run several
+// times slower.
+//
+
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#define AVX512_TARGET __attribute__((target("avx512f,avx2,fma")))
+#define AVX2_INLINE AVX2_TARGET __attribute__((always_inline))
+#define AVX512_INLINE AVX512_TARGET __attribute__((always_inline))
+
+// One of AudioResampler::fir_simd, set from the CPU features in AudioResamplerDyn.cpp.
+extern std::atomic<int> gFirSimd;
+
+// Loads 8 positive and negative coefficients, interpolated if not FIXED.
+template <bool FIXED>
+AVX2_INLINE static inline void LoadCoefsAVX2(__m256& posCoef, __m256& negCoef,
+        const float*& coefsP, const float*& coefsN,
+        const float*& coefsP1, const float*& coefsN1, __m256 interp)
+{
+    posCoef = _mm256_load_ps(coefsP);
+    negCoef = _mm256_load_ps(coefsN);
+    coefsP += 8;
+    coefsN += 8;
+
+    if (!FIXED) { // interpolate
+        __m256 posCoef1 = _mm256_load_ps(coefsP1);
+        __m256 negCoef1 = _mm256_load_ps(coefsN1);
+        coefsP1 += 8;
+        coefsN1 += 8;
+
+        // posCoef = interp * (posCoef1 - posCoef) + posCoef
+        // negCoef = interp * (negCoef - negCoef1) + negCoef1
+        posCoef = _mm256_fmadd_ps(_mm256_sub_ps(posCoef1, posCoef), interp, posCoef);
+        negCoef = _mm256_fmadd_ps(_mm256_sub_ps(negCoef, negCoef1), interp, negCoef1);
+    }
+}
+
+// Accumulates 8 frames of the positive (reversed, ending at sP) and negative
+// (starting at sN) sides into accL and accR.
+template <int CHANNELS>
+AVX2_INLINE static inline void AccumulateAVX2(__m256& accL, __m256& accR,
+        const float*& sP, const float*& sN, __m256 posCoef, __m256 negCoef)
+{
+    switch (CHANNELS) {
+    case 1: {
+        const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        __m256 posSamp = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sP - 7), reverse);
+        __m256 negSamp = _mm256_loadu_ps(sN);
+        sP -= 8;
+        sN += 8;
+
+        accL = _mm256_fmadd_ps(posSamp, posCoef, accL);
+        accL = _mm256_fmadd_ps(negSamp, negCoef, accL);
+    } break;
+    case 2: {
+        // deinterleave to L in the low lane and R in the high lane,
+        // reversing the positives.
+        const __m256i reverse = _mm256_setr_epi32(6, 4, 2, 0, 7, 5, 3, 1);
+        const __m256i forward = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        __m256 posSamp0 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sP - 6), reverse);
+        __m256 posSamp1 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sP - 14), reverse);
+        __m256 negSamp0 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sN), forward);
+        __m256 negSamp1 = _mm256_permutevar8x32_ps(_mm256_loadu_ps(sN + 8), forward);
+        sP -= 16;
+        sN += 16;
+
+        __m256 posSampL = _mm256_permute2f128_ps(posSamp0, posSamp1, 0x20);
+        __m256 posSampR = _mm256_permute2f128_ps(posSamp0, posSamp1, 0x31);
+        __m256 negSampL = _mm256_permute2f128_ps(negSamp0, negSamp1, 0x20);
+        __m256 negSampR = _mm256_permute2f128_ps(negSamp0, negSamp1, 0x31);
+
+        accL = _mm256_fmadd_ps(posSampL, posCoef, accL);
+        accR = _mm256_fmadd_ps(posSampR, posCoef, accR);
+        accL = _mm256_fmadd_ps(negSampL, negCoef, accL);
+        accR = _mm256_fmadd_ps(negSampR, negCoef, accR);
+    } break;
+    }
+}
+
+// Funnels down the accumulators, multiplies by volume and adds to out.
+template <int CHANNELS>
+AVX2_INLINE static inline void SaveAVX2(float* out, const float* volumeLR,
+        __m256 accL, __m256 accR)
+{
+    __m128 vLR = _mm_setzero_ps();
+    __m128 outSamp;
+    vLR = _mm_loadl_pi(vLR, reinterpret_cast<const __m64*>(volumeLR));
+    outSamp = _mm_loadl_pi(vLR, reinterpret_cast<__m64*>(out));
+
+    __m128 sumL = _mm_add_ps(_mm256_castps256_ps128(accL), _mm256_extractf128_ps(accL, 1));
+    __m128 outAccum;
+    if (CHANNELS == 1) {
+        // duplicate accL to both L and R
+        outAccum = _mm_add_ps(sumL, _mm_movehl_ps(sumL, sumL));
+        outAccum = _mm_add_ps(outAccum, _mm_shuffle_ps(outAccum, outAccum, 0x11));
+    } else {
+        __m128 sumR = _mm_add_ps(_mm256_castps256_ps128(accR), _mm256_extractf128_ps(accR, 1));
+        outAccum = _mm_hadd_ps(sumL, sumR);
+        outAccum = _mm_hadd_ps(outAccum, outAccum);
+    }
+    outSamp = _mm_fmadd_ps(outAccum, vLR, outSamp);
+
+    _mm_storel_pi(reinterpret_cast<__m64*>(out), outSamp);
+}
+
+template <int CHANNELS, bool FIXED>
+AVX2_TARGET static void ProcessAVX2Intrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS == 1 || CHANNELS == 2, "CHANNELS must be 1 or 2");
+
+    const __m256 interp = _mm256_set1_ps(lerpP);
+    __m256 accL = _mm256_setzero_ps();
+    __m256 accR = _mm256_setzero_ps();
+
+    do {
+        __m256 posCoef, negCoef;
+        LoadCoefsAVX2<FIXED>(posCoef, negCoef, coefsP, coefsN, coefsP1, coefsN1, interp);
+        AccumulateAVX2<CHANNELS>(accL, accR, sP, sN, posCoef, negCoef);
+    } while (count -= 8);
+
+    SaveAVX2<CHANNELS>(out, volumeLR, accL, accR);
+    _mm256_zeroupper();
+}
+
+// Adds the upper half of a 512 bit accumulator to its lower half.
+AVX512_INLINE static inline __m256 FoldAVX512(__m512 acc)
+{
+    return _mm256_add_ps(_mm512_castps512_ps256(acc),
+            _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(acc), 1)));
+}
+
+template <int CHANNELS, bool FIXED>
+AVX512_TARGET static void ProcessAVX512Intrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 7) == 0); // multiple of 8
+    static_assert(CHANNELS == 1 || CHANNELS == 2, "CHANNELS must be 1 or 2");
+
+    const __m512 interp = _mm512_set1_ps(lerpP);
+    __m512 accL = _mm512_setzero_ps();
+    __m512 accR = _mm512_setzero_ps();
+
+    for (; count >= 16; count -= 16) {
+        // coefficients are only 32 byte aligned.
+        __m512 posCoef = _mm512_loadu_ps(coefsP);
+        __m512 negCoef = _mm512_loadu_ps(coefsN);
+        coefsP += 16;
+        coefsN += 16;
+
+        if (!FIXED) { // interpolate
+            __m512 posCoef1 = _mm512_loadu_ps(coefsP1);
+            __m512 negCoef1 = _mm512_loadu_ps(coefsN1);
+            coefsP1 += 16;
+            coefsN1 += 16;
+
+            posCoef = _mm512_fmadd_ps(_mm512_sub_ps(posCoef1, posCoef), interp, posCoef);
+            negCoef = _mm512_fmadd_ps(_mm512_sub_ps(negCoef, negCoef1), interp, negCoef1);
+        }
+        switch (CHANNELS) {
+        case 1: {
+            const __m512i reverse = _mm512_setr_epi32(
+                    15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+            __m512 posSamp = _mm512_permutexvar_ps(reverse, _mm512_loadu_ps(sP - 15));
+            __m512 negSamp = _mm512_loadu_ps(sN);
+            sP -= 16;
+            sN += 16;
+
+            accL = _mm512_fmadd_ps(posSamp, posCoef, accL);
+            accL = _mm512_fmadd_ps(negSamp, negCoef, accL);
+        } break;
+        case 2: {
+            // index 0-15 selects from the first vector, 16-31 from the second.
+            const __m512i reverseL = _mm512_setr_epi32(
+                    14, 12, 10, 8, 6, 4, 2, 0, 30, 28, 26, 24, 22, 20, 18, 16);
+            const __m512i forwardL = _mm512_setr_epi32(
+                    0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 20, 22, 24, 26, 28, 30);
+            const __m512i one = _mm512_set1_epi32(1);
+            __m512 posSamp0 = _mm512_loadu_ps(sP - 14);
+            __m512 posSamp1 = _mm512_loadu_ps(sP - 30);
+            __m512 negSamp0 = _mm512_loadu_ps(sN);
+            __m512 negSamp1 = _mm512_loadu_ps(sN + 16);
+            sP -= 32;
+            sN += 32;
+
+            __m512 posSampL = _mm512_permutex2var_ps(posSamp0, reverseL, posSamp1);
+            __m512 posSampR = _mm512_permutex2var_ps(
+                    posSamp0, _mm512_add_epi32(reverseL, one), posSamp1);
+            __m512 negSampL = _mm512_permutex2var_ps(negSamp0, forwardL, negSamp1);
+            __m512 negSampR = _mm512_permutex2var_ps(
+                    negSamp0, _mm512_add_epi32(forwardL, one), negSamp1);
+
+            accL = _mm512_fmadd_ps(posSampL, posCoef, accL);
+            accR = _mm512_fmadd_ps(posSampR, posCoef, accR);
+            accL = _mm512_fmadd_ps(negSampL, negCoef, accL);
+            accR = _mm512_fmadd_ps(negSampR, negCoef, accR);
+        } break;
+        }
+    }
+
+    __m256 accL8 = FoldAVX512(accL);
+    __m256 accR8 = CHANNELS == 2 ? FoldAVX512(accR) : _mm256_setzero_ps();
+    if (count != 0) { // last 8 coefficients
+        __m256 posCoef, negCoef;
+        LoadCoefsAVX2<FIXED>(posCoef, negCoef, coefsP, coefsN, coefsP1, coefsN1,
+                _mm512_castps512_ps256(interp));
+        AccumulateAVX2<CHANNELS>(accL8, accR8, sP, sN, posCoef, negCoef);
+    }
+
+    SaveAVX2<CHANNELS>(out, volumeLR, accL8, accR8);
+    _mm256_zeroupper();
+}
+
+// Returns true if the AVX2 or AVX-512 kernel processed the frame.
+template <int CHANNELS, bool FIXED>
+static inline bool ProcessAVXIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    switch (gFirSimd.load(std::memory_order_relaxed)) {
+    case AudioResampler::FIR_SIMD_AVX512:
+        ProcessAVX512Intrinsic<CHANNELS, FIXED>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        return true;
+    case AudioResampler::FIR_SIMD_AVX2:
+        ProcessAVX2Intrinsic<CHANNELS, FIXED>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+                lerpP, coefsP1, coefsN1);
+        return true;
+    default:
+        return false;
+    }
+}
+
+#endif //USE_SSE
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_AVX_H*/
@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_MULTI_H
+#define ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_MULTI_H
+
+#include <type_traits>
+#include <utility>
+
+namespace android {
+
+// depends on AudioResamplerFirOps.h
+
+//
+// Multichannel float specializations, used by Process() and ProcessL() in
+// AudioResamplerFirProcess.h for an even number of channels greater than 2
+// (quad, 5.1, 7.1, 5.1.4, 7.1.4, 9.1.6, 22.2 ...).
+//
+// The mono and stereo kernels deinterleave the samples to process several filter taps
+// in each vector. With more channels, an interleaved frame already fills one or more
+// vectors, so frames are loaded as they are and multiplied by the (broadcast)
+// coefficient of their tap, with one accumulator vector per 4 channels.
+// When the channel count is not a multiple of 4, two frames are processed together
+// and the vector straddling them takes the coefficients of both taps.
+//
+// Like the generic ProcessBase(), all channels are scaled by volumeLR[0].
+//
+
+#if USE_NEON || USE_SSE
+#define USE_FIR_MULTI (true)
+#else
+#define USE_FIR_MULTI (false)
+#endif
+
+#if USE_FIR_MULTI
+
+#if USE_NEON
+struct FirMultiFloat {
+    using vec_t = float32x4_t;
+    static inline vec_t zero() { return vdupq_n_f32(0.f); }
+    static inline vec_t load(const float* p) { return vld1q_f32(p); }
+    static inline void store(float* p, vec_t v) { vst1q_f32(p, v); }
+    // returns acc + a * b
+    static inline vec_t mla(vec_t acc, vec_t a, vec_t b) { return vmlaq_f32(acc, a, b); }
+    // returns c0 + lerp * (c1 - c0)
+    static inline vec_t interpolate(vec_t c0, vec_t c1, float lerp) {
+        return vmlaq_n_f32(c0, vsubq_f32(c1, c0), lerp);
+    }
+    // returns { v[LANE], v[LANE], v[LANE], v[LANE] }
+    template <int LANE>
+    static inline vec_t dup(vec_t v) {
+        if constexpr (LANE < 2) {
+            return vdupq_lane_f32(vget_low_f32(v), LANE);
+        } else {
+            return vdupq_lane_f32(vget_high_f32(v), LANE - 2);
+        }
+    }
+    // returns { v[LANE0], v[LANE0], v[LANE1], v[LANE1] }
+    template <int LANE0, int LANE1>
+    static inline vec_t dup2(vec_t v) {
+        return vcombine_f32(vget_low_f32(dup<LANE0>(v)), vget_low_f32(dup<LANE1>(v)));
+    }
+};
+#else // USE_SSE
+struct FirMultiFloat {
+    using vec_t = __m128;
+    static inline vec_t zero() { return _mm_setzero_ps(); }
+    static inline vec_t load(const float* p) { return _mm_loadu_ps(p); }
+    static inline void store(float* p, vec_t v) { _mm_storeu_ps(p, v); }
+    static inline vec_t mla(vec_t acc, vec_t a, vec_t b) {
+#if USE_AVX2
+        return _mm_fmadd_ps(a, b, acc);
+#else
+        return _mm_add_ps(acc, _mm_mul_ps(a, b));
+#endif
+    }
+    static inline vec_t interpolate(vec_t c0, vec_t c1, float lerp) {
+        return mla(c0, _mm_sub_ps(c1, c0), _mm_set1_ps(lerp));
+    }
+    template <int LANE>
+    static inline vec_t dup(vec_t v) {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(LANE, LANE, LANE, LANE));
+    }
+    template <int LANE0, int LANE1>
+    static inline vec_t dup2(vec_t v) {
+        return _mm_shuffle_ps(v, v, _MM_SHUFFLE(LANE1, LANE1, LANE0, LANE0));
+    }
+};
+#endif
+
+// compile-time function.
+// Returns true if ProcessMultiIntrinsic() handles the channel count and types.
+template <int CHANNELS, typename TC, typename TI, typename TO>
+constexpr inline bool isFirMultiSupported() {
+    return CHANNELS > 2 && CHANNELS % 2 == 0
+            && std::is_same_v<TC, float> && std::is_same_v<TI, float>
+            && std::is_same_v<TO, float>;
+}
+
+// Accumulates the frames starting at s, with the tap coefficients in lane LANE0
+// (first frame) and LANE1 (second frame, if CHANNELS is not a multiple of 4) of coefs.
+template <int CHANNELS, int LANE0, int LANE1, int... K>
+static inline void MacFramesMulti(FirMultiFloat::vec_t* acc, const float* s,
+        FirMultiFloat::vec_t coefs, std::integer_sequence<int, K...>)
+{
+    using F = FirMultiFloat;
+    auto mac = [&](auto k) {
+        constexpr int kVector = decltype(k)::value;
+        constexpr int firstFrame = 4 * kVector / CHANNELS;
+        constexpr int lastFrame = (4 * kVector + 3) / CHANNELS;
+        const F::vec_t samples = F::load(s + 4 * kVector);
+        if constexpr (firstFrame != lastFrame) {
+            // CHANNELS % 4 == 2, the frames meet in the middle of the vector.
+            acc[kVector] = F::mla(acc[kVector], samples, F::template dup2<LANE0, LANE1>(coefs));
+        } else {
+            constexpr int lane = firstFrame == 0 ? LANE0 : LANE1;
+            acc[kVector] = F::mla(acc[kVector], samples, F::template dup<lane>(coefs));
+        }
+    };
+    (mac(std::integral_constant<int, K>{}), ...);
+}
+
+template <int CHANNELS, bool FIXED>
+static inline void ProcessMultiIntrinsic(float* out,
+        int count,
+        const float* coefsP,
+        const float* coefsN,
+        const float* sP,
+        const float* sN,
+        const float* volumeLR,
+        float lerpP,
+        const float* coefsP1,
+        const float* coefsN1)
+{
+    ALOG_ASSERT(count > 0 && (count & 3) == 0); // multiple of 4
+    static_assert(CHANNELS > 2 && CHANNELS % 2 == 0, "CHANNELS must be even and > 2");
+
+    using F = FirMultiFloat;
+    constexpr int FRAMES = CHANNELS % 4 == 0 ? 1 : 2;   // frames per group of vectors
+    constexpr int VECTORS = FRAMES * CHANNELS / 4;
+    constexpr auto kVectors = std::make_integer_sequence<int, VECTORS>{};
+
+    F::vec_t acc[VECTORS];
+    for (auto& a : acc) {
+        a = F::zero();
+    }
+
+    do {
+        // 4 taps of coefficients
+        F::vec_t posCoef = F::load(coefsP);
+        F::vec_t negCoef = F::load(coefsN);
+        coefsP += 4;
+        coefsN += 4;
+        if (!FIXED) { // interpolate
+            posCoef = F::interpolate(posCoef, F::load(coefsP1), lerpP);
+            negCoef = F::interpolate(F::load(coefsN1), negCoef, lerpP);
+            coefsP1 += 4;
+            coefsN1 += 4;
+        }
+
+        if constexpr (FRAMES == 1) {
+            MacFramesMulti<CHANNELS, 0, 0>(acc, sP, posCoef, kVectors);
+            MacFramesMulti<CHANNELS, 1, 1>(acc, sP - CHANNELS, posCoef, kVectors);
+            MacFramesMulti<CHANNELS, 2, 2>(acc, sP - 2 * CHANNELS, posCoef, kVectors);
+            MacFramesMulti<CHANNELS, 3, 3>(acc, sP - 3 * CHANNELS, posCoef, kVectors);
+            MacFramesMulti<CHANNELS, 0, 0>(acc, sN, negCoef, kVectors);
+            MacFramesMulti<CHANNELS, 1, 1>(acc, sN + CHANNELS, negCoef, kVectors);
+            MacFramesMulti<CHANNELS, 2, 2>(acc, sN + 2 * CHANNELS, negCoef, kVectors);
+            MacFramesMulti<CHANNELS, 3, 3>(acc, sN + 3 * CHANNELS, negCoef, kVectors);
+        } else {
+            // the positive side goes backwards, so the earlier frame in memory has the later tap.
+            MacFramesMulti<CHANNELS, 1, 0>(acc, sP - CHANNELS, posCoef, kVectors);
+            MacFramesMulti<CHANNELS, 3, 2>(acc, sP - 3 * CHANNELS, posCoef, kVectors);
+            MacFramesMulti<CHANNELS, 0, 1>(acc, sN, negCoef, kVectors);
+            MacFramesMulti<CHANNELS, 2, 3>(acc, sN + 2 * CHANNELS, negCoef, kVectors);
+        }
+        sP -= 4 * CHANNELS;
+        sN += 4 * CHANNELS;
+    } while (count -= 4);
+
+    // multiply by volume and save
+    float sum[FRAMES * CHANNELS];
+    for (int i = 0; i < VECTORS; ++i) {
+        F::store(sum + 4 * i, acc[i]);
+    }
+    for (int i = 0; i < CHANNELS; ++i) {
+        float value = sum[i];
+        if constexpr (FRAMES == 2) {
+            value += sum[CHANNELS + i];
+        }
+        out[i] += value * volumeLR[0];
+    }
+}
+
+#endif // USE_FIR_MULTI
+
+} // namespace android
+
+#endif /*ANDROID_AUDIO_RESAMPLER_FIR_PROCESS_MULTI_H*/
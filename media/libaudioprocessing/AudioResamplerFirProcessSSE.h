@@ -19,7 +19,7 @@
 
 namespace android {
 
-// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h
+// depends on AudioResamplerFirOps.h, AudioResamplerFirProcess.h, AudioResamplerFirProcessAVX.h
 
 #if USE_SSE
 
@@ -32,6 +32,7 @@ namespace android {
 
 //
 // SSEx specializations are enabled for Process() and ProcessL() in AudioResamplerFirProcess.h
+// They defer to the AVX2 and AVX-512 kernels of AudioResamplerFirProcessAVX.h when selected.
 //
 
 template <int CHANNELS, int STRIDE, bool FIXED>
@@ -182,6 +183,10 @@ inline void ProcessL<1, 16>(float* const out,
         const float* sN,
         const float* const volumeLR)
 {
+    if (ProcessAVXIntrinsic<1, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/)) {
+        return;
+    }
     ProcessSSEIntrinsic<1, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
 }
@@ -195,6 +200,10 @@ inline void ProcessL<2, 16>(float* const out,
         const float* sN,
         const float* const volumeLR)
 {
+    if (ProcessAVXIntrinsic<2, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/)) {
+        return;
+    }
     ProcessSSEIntrinsic<2, 16, true>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             0 /*lerpP*/, NULL /*coefsP1*/, NULL /*coefsN1*/);
 }
@@ -211,6 +220,10 @@ inline void Process<1, 16>(float* const out,
         float lerpP,
         const float* const volumeLR)
 {
+    if (ProcessAVXIntrinsic<1, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1)) {
+        return;
+    }
     ProcessSSEIntrinsic<1, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             lerpP, coefsP1, coefsN1);
 }
@@ -227,6 +240,10 @@ inline void Process<2, 16>(float* const out,
         float lerpP,
         const float* const volumeLR)
 {
+    if (ProcessAVXIntrinsic<2, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
+            lerpP, coefsP1, coefsN1)) {
+        return;
+    }
     ProcessSSEIntrinsic<2, 16, false>(out, count, coefsP, coefsN, sP, sN, volumeLR,
             lerpP, coefsP1, coefsN1);
 }
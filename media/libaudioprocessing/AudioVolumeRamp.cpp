@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioVolumeRamp"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+#include <audio_utils/primitives.h>
+#include <log/log.h>
+#include <media/AudioVolumeRamp.h>
+
+#include "AudioMixerOps.h"
+#include "AudioMixerOpsSimd.h"
+
+namespace android {
+
+// In place stereo volume for NCHAN channels, with the SIMD kernels where available.
+template <int NCHAN, bool RAMP>
+static void applyVolume(float *out, size_t frameCount, const float *in,
+        float *vol, const float *volinc)
+{
+#if USE_MIXER_SIMD
+    if constexpr (NCHAN <= kMaxVolumeMixSimdChannels) {
+        volumeMixSimd<MIXTYPE_MULTI_SAVEONLY_STEREOVOL, NCHAN, RAMP>(
+                out, frameCount, in, vol, volinc);
+        return;
+    }
+#endif
+    if constexpr (RAMP) {
+        volumeRampMulti<MIXTYPE_MULTI_SAVEONLY_STEREOVOL, NCHAN>(out, frameCount, in,
+                (float *)nullptr, vol, volinc, (float *)nullptr, 0.f /* volainc */);
+    } else {
+        volumeMulti<MIXTYPE_MULTI_SAVEONLY_STEREOVOL, NCHAN>(out, frameCount, in,
+                (float *)nullptr, vol, 0.f /* vola */);
+    }
+}
+
+template <std::size_t ... Is>
+static constexpr auto makeKernels(std::index_sequence<Is...>)
+{
+    using kernel_t = void (*)(float *, size_t, const float *, float *, const float *);
+    return std::array<std::array<kernel_t, 2>, sizeof...(Is)>{{
+            {{ &applyVolume<Is + 1, false>, &applyVolume<Is + 1, true> }} ...
+        }};
+}
+
+AudioVolumeRamp::AudioVolumeRamp(audio_format_t format, uint32_t channelCount)
+    : mFormat(format)
+    , mChannelCount(channelCount)
+{
+    static constexpr auto kernels = makeKernels(std::make_index_sequence<FCC_LIMIT>());
+    LOG_ALWAYS_FATAL_IF(!isFormatSupported(format), "%s: unsupported format %#x",
+            __func__, format);
+    LOG_ALWAYS_FATAL_IF(channelCount == 0 || channelCount > kernels.size(),
+            "%s: unsupported channel count %u", __func__, channelCount);
+    mKernel[0] = kernels[channelCount - 1][0];
+    mKernel[1] = kernels[channelCount - 1][1];
+    if (format != AUDIO_FORMAT_PCM_FLOAT) {
+        mConversionBuffer.resize(kConversionFrames * channelCount);
+    }
+}
+
+/* static */
+bool AudioVolumeRamp::isFormatSupported(audio_format_t format)
+{
+    switch (format) {
+    case AUDIO_FORMAT_PCM_FLOAT:
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void AudioVolumeRamp::setVolume(float left, float right, size_t rampFrames)
+{
+    if (left == mTargetVolume[0] && right == mTargetVolume[1]) {
+        return; // already there, or ramping there
+    }
+    mTargetVolume[0] = left;
+    mTargetVolume[1] = right;
+    if (rampFrames == 0) {
+        mVolume[0] = left;
+        mVolume[1] = right;
+        mRampFrames = 0;
+        return;
+    }
+    mVolumeInc[0] = (left - mVolume[0]) / rampFrames;
+    mVolumeInc[1] = (right - mVolume[1]) / rampFrames;
+    mRampFrames = rampFrames;
+}
+
+void AudioVolumeRamp::process(void *buffer, size_t frameCount)
+{
+    if (!isRamping()) {
+        if (mVolume[0] == 1.f && mVolume[1] == 1.f) {
+            return;
+        }
+        if (mVolume[0] == 0.f && mVolume[1] == 0.f) {
+            memset(buffer, 0, frameCount * mChannelCount * audio_bytes_per_sample(mFormat));
+            return;
+        }
+    }
+    if (mFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        processFloat(static_cast<float *>(buffer), frameCount);
+        return;
+    }
+    const size_t sampleSize = audio_bytes_per_sample(mFormat);
+    uint8_t *data = static_cast<uint8_t *>(buffer);
+    while (frameCount > 0) {
+        const size_t frames = std::min(frameCount, kConversionFrames);
+        const size_t samples = frames * mChannelCount;
+        memcpy_by_audio_format(mConversionBuffer.data(), AUDIO_FORMAT_PCM_FLOAT,
+                data, mFormat, samples);
+        processFloat(mConversionBuffer.data(), frames);
+        memcpy_by_audio_format(data, mFormat,
+                mConversionBuffer.data(), AUDIO_FORMAT_PCM_FLOAT, samples);
+        data += samples * sampleSize;
+        frameCount -= frames;
+    }
+}
+
+void AudioVolumeRamp::processFloat(float *buffer, size_t frameCount)
+{
+    if (isRamping()) {
+        const size_t frames = std::min(frameCount, mRampFrames);
+        mKernel[1](buffer, frames, buffer, mVolume, mVolumeInc);
+        mRampFrames -= frames;
+        if (mRampFrames == 0) {
+            // do not let the rounding of the increments drift from the target.
+            mVolume[0] = mTargetVolume[0];
+            mVolume[1] = mTargetVolume[1];
+        }
+        buffer += frames * mChannelCount;
+        frameCount -= frames;
+    }
+    if (frameCount > 0) {
+        mKernel[0](buffer, frameCount, buffer, mVolume, nullptr /* volinc */);
+    }
+}
+
+} // namespace android
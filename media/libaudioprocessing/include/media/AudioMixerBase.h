@@ -36,6 +36,8 @@
 
 namespace android {
 
+struct VolumeMixSimdTable;
+
 // ----------------------------------------------------------------------------
 
 // AudioMixerBase is functional on its own if only mixing and resampling
@@ -148,6 +150,10 @@ public:
     // If kUseNewMixer is false, this is ignored or may be overridden internally
     static constexpr bool kUseFloat = true;
 
+    // Set kUseSimdMixer to true to use the SIMD volume kernels for float tracks
+    // (see AudioMixerOpsSimd.h), where supported by the architecture.
+    static constexpr bool kUseSimdMixer = true;
+
 #ifdef FLOAT_AUX
     using TYPE_AUX = float;
     static_assert(kUseNewMixer && kUseFloat,
@@ -271,6 +277,10 @@ public:
         hook_t      hook;
         const void  *mIn;             // current location in buffer
 
+        // SIMD float volume kernels for this track's channel count, set by process__validate().
+        // nullptr if the track is not float or has no specialized kernel.
+        const VolumeMixSimdTable *mVolumeMixSimd = nullptr;
+
         std::unique_ptr<AudioResampler> mResampler;
         uint32_t    sampleRate;
         int32_t*    mainBuffer;
@@ -359,6 +369,9 @@ public:
             audio_format_t mixerInFormat, audio_format_t mixerOutFormat,
             bool useStereoVolume);
 
+    static const VolumeMixSimdTable *getVolumeMixSimdTable(uint32_t channelCount,
+            audio_format_t mixerInFormat);
+
     static void convertMixerFormat(void *out, audio_format_t mixerOutFormat,
             void *in, audio_format_t mixerInFormat, size_t sampleCount);
 
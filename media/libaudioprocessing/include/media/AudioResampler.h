@@ -49,11 +49,34 @@ public:
         DYN_HIGH_QUALITY=7,
     };
 
+    // Determines the instruction set of the float FIR kernels of the dynamic
+    // resamplers on x86.
+    //  FIR_SIMD_DEFAULT: the kernels of the build target (SSE on x86, NEON on arm)
+    //  FIR_SIMD_AVX2: 8 wide AVX2/FMA kernels
+    //  FIR_SIMD_AVX512: 16 wide AVX-512 kernels
+    // Only mono and stereo have AVX2/AVX-512 kernels.
+    enum fir_simd {
+        FIR_SIMD_DEFAULT=0,
+        FIR_SIMD_AVX2=1,
+        FIR_SIMD_AVX512=2,
+    };
+
     static const CONSTEXPR float UNITY_GAIN_FLOAT = 1.0f;
 
     static AudioResampler* create(audio_format_t format, int inChannelCount,
             int32_t sampleRate, src_quality quality=DEFAULT_QUALITY);
 
+    // Returns the widest FIR kernels the CPU supports.
+    static fir_simd maxFirSimd();
+
+    // Returns the FIR kernels used by default: AVX-512 only if
+    // "ro.audio.resampler.avx512" is set, otherwise at most AVX2.
+    static fir_simd defaultFirSimd();
+
+    // Selects the FIR kernels used by all dynamic resamplers, for testing.
+    // Returns the kernels selected, which are limited to maxFirSimd().
+    static fir_simd setFirSimd(fir_simd simd);
+
     virtual ~AudioResampler();
 
     virtual void init() = 0;
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_VOLUME_RAMP_H
+#define ANDROID_AUDIO_VOLUME_RAMP_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <vector>
+
+#include <system/audio.h>
+
+namespace android {
+
+/* AudioVolumeRamp applies a left and right volume in place to interleaved PCM,
+ * for outputs which do not go through the AudioMixer.
+ *
+ * Channels follow the volume affinity of the AudioMixer stereo volume
+ * (MIXTYPE_MULTI_SAVEONLY_STEREOVOL): left side channels take the left volume,
+ * right side channels the right volume, and center channels their average.
+ * Volume changes are ramped linearly over the given number of frames.
+ *
+ * Float data is processed by the SIMD volume kernels of the AudioMixer
+ * (see AudioMixerOpsSimd.h); the other formats are converted to float and back
+ * in blocks. Unity volume leaves the data untouched, and zero volume clears it.
+ *
+ * AudioVolumeRamp is not thread-safe.
+ */
+class AudioVolumeRamp {
+public:
+    AudioVolumeRamp(audio_format_t format, uint32_t channelCount);
+
+    // Returns true for AUDIO_FORMAT_PCM_FLOAT, AUDIO_FORMAT_PCM_16_BIT,
+    // AUDIO_FORMAT_PCM_24_BIT_PACKED, AUDIO_FORMAT_PCM_32_BIT and AUDIO_FORMAT_PCM_8_24_BIT.
+    static bool isFormatSupported(audio_format_t format);
+
+    // Sets the volume reached after rampFrames frames of process(),
+    // or at once if rampFrames is 0. A ramp in progress continues from its current volume.
+    void setVolume(float left, float right, size_t rampFrames);
+
+    // Applies the volume to frameCount interleaved frames of buffer.
+    void process(void *buffer, size_t frameCount);
+
+    bool isRamping() const { return mRampFrames > 0; }
+
+private:
+    using kernel_t = void (*)(float *out, size_t frameCount, const float *in,
+            float *vol, const float *volinc);
+
+    void processFloat(float *buffer, size_t frameCount);
+
+    // Number of frames converted to float at a time for the integer formats.
+    static constexpr size_t kConversionFrames = 256;
+
+    const audio_format_t mFormat;
+    const uint32_t mChannelCount;
+    kernel_t mKernel[2];            // [0] for constant volume, [1] for ramp
+    float mVolume[2] = {1.f, 1.f};  // current left and right volume
+    float mTargetVolume[2] = {1.f, 1.f};
+    float mVolumeInc[2] = {};       // increment per frame while ramping
+    size_t mRampFrames = 0;         // frames left in the ramp
+    std::vector<float> mConversionBuffer;
+};
+
+} // namespace android
+
+#endif // ANDROID_AUDIO_VOLUME_RAMP_H
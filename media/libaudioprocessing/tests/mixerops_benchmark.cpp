@@ -16,10 +16,13 @@
 
 #include <inttypes.h>
 #include <type_traits>
+#include <vector>
 #define LOG_ALWAYS_FATAL(...)
 
 #include <../AudioMixerOps.h>
+#include <../AudioMixerOpsSimd.h>
 #include <benchmark/benchmark.h>
+#include <media/AudioVolumeRamp.h>
 
 using namespace android;
 
@@ -72,6 +75,31 @@ static void BM_VolumeMulti(benchmark::State& state) {
     }
 }
 
+#if USE_MIXER_SIMD
+template <int MIXTYPE, int NCHAN, bool RAMP>
+static void BM_VolumeMixSimd(benchmark::State& state) {
+    constexpr size_t FRAME_COUNT = 1000;
+    constexpr size_t SAMPLE_COUNT = FRAME_COUNT * NCHAN;
+
+    // data inialized to 0.
+    float out[SAMPLE_COUNT]{};
+    float in[SAMPLE_COUNT]{};
+
+    // volume initialized to 0
+    float vol[2] = {0.f, 0.f};
+
+    // some volume increment
+    float volinc[2] = {0.01f, 0.01f};
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(out);
+        benchmark::DoNotOptimize(in);
+        volumeMixSimd<MIXTYPE, NCHAN, RAMP>(out, FRAME_COUNT, in, vol, volinc);
+        benchmark::ClobberMemory();
+    }
+}
+#endif
+
 // MULTI mode and MULTI_SAVEONLY mode are not used by AudioMixer for channels > 2,
 // which is ensured by a static_assert (won't compile for those configurations).
 // So we benchmark MIXTYPE_MULTI_MONOVOL and MIXTYPE_MULTI_SAVEONLY_MONOVOL compared
@@ -101,4 +129,64 @@ BENCHMARK_TEMPLATE(BM_VolumeMulti, MIXTYPE_MULTI_SAVEONLY_MONOVOL, 8);
 BENCHMARK_TEMPLATE(BM_VolumeMulti, MIXTYPE_MULTI_STEREOVOL, 8);
 BENCHMARK_TEMPLATE(BM_VolumeMulti, MIXTYPE_MULTI_SAVEONLY_STEREOVOL, 8);
 
+// Scalar versus SIMD float kernels (no aux) used by the AudioMixer, per channel mask
+// from canonicalChannelMaskFromCount(): stereo, 2.1, quad, penta, 5.1, 6.1, 7.1.
+#define BENCHMARK_VOLUME_MIX(NCHAN) \
+BENCHMARK_TEMPLATE(BM_VolumeMulti, MIXTYPE_MULTI_STEREOVOL, NCHAN); \
+BENCHMARK_TEMPLATE(BM_VolumeRampMulti, MIXTYPE_MULTI_STEREOVOL, NCHAN); \
+BENCHMARK_VOLUME_MIX_SIMD(NCHAN)
+
+#if USE_MIXER_SIMD
+#define BENCHMARK_VOLUME_MIX_SIMD(NCHAN) \
+BENCHMARK_TEMPLATE(BM_VolumeMixSimd, MIXTYPE_MULTI_STEREOVOL, NCHAN, false); \
+BENCHMARK_TEMPLATE(BM_VolumeMixSimd, MIXTYPE_MULTI_STEREOVOL, NCHAN, true);
+#else
+#define BENCHMARK_VOLUME_MIX_SIMD(NCHAN)
+#endif
+
+BENCHMARK_VOLUME_MIX(2);
+BENCHMARK_VOLUME_MIX(3);
+BENCHMARK_VOLUME_MIX(4);
+BENCHMARK_VOLUME_MIX(5);
+BENCHMARK_VOLUME_MIX(6);
+BENCHMARK_VOLUME_MIX(7);
+BENCHMARK_VOLUME_MIX(8);
+
+// AudioVolumeRamp in place on 1000 frames, ramping (arg 1) or at constant volume (arg 0).
+template <audio_format_t FORMAT, int NCHAN>
+static void BM_AudioVolumeRamp(benchmark::State& state) {
+    constexpr size_t FRAME_COUNT = 1000;
+    const bool ramp = state.range(0);
+
+    // data inialized to 0.
+    std::vector<uint8_t> data(FRAME_COUNT * NCHAN * audio_bytes_per_sample(FORMAT));
+
+    AudioVolumeRamp volumeRamp(FORMAT, NCHAN);
+    float volume = 0.25f;
+    volumeRamp.setVolume(volume, volume, 0 /* rampFrames */);
+
+    while (state.KeepRunning()) {
+        if (ramp) {
+            volume = 1.f - volume; // alternate between 0.25 and 0.75.
+            volumeRamp.setVolume(volume, volume, FRAME_COUNT);
+        }
+        benchmark::DoNotOptimize(data.data());
+        volumeRamp.process(data.data(), FRAME_COUNT);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * FRAME_COUNT);
+}
+
+#define BENCHMARK_AUDIO_VOLUME_RAMP(FORMAT, NCHAN) \
+BENCHMARK_TEMPLATE(BM_AudioVolumeRamp, FORMAT, NCHAN)->ArgName("ramp")->Arg(0)->Arg(1);
+
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_FLOAT, 2);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_FLOAT, 8);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_16_BIT, 2);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_16_BIT, 8);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_24_BIT_PACKED, 2);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_24_BIT_PACKED, 8);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_32_BIT, 2);
+BENCHMARK_AUDIO_VOLUME_RAMP(AUDIO_FORMAT_PCM_32_BIT, 8);
+
 BENCHMARK_MAIN();
@@ -20,9 +20,12 @@
 
 #include <inttypes.h>
 #include <type_traits>
+#include <vector>
 
 #include <../AudioMixerOps.h>
+#include <../AudioMixerOpsSimd.h>
 #include <gtest/gtest.h>
+#include <media/AudioVolumeRamp.h>
 
 using namespace android;
 
@@ -176,3 +179,179 @@ TEST(mixerops, channel_equivalence) {
         EXPECT_EQ(system, actual);
     }
 }
+
+#if USE_MIXER_SIMD
+// The SIMD kernels must match the scalar implementation.
+template <int MIXTYPE, int NCHAN>
+class MixerOpsSimdTest {
+public:
+    static void testVolumeMix() {
+        constexpr size_t FRAME_COUNT = 1001; // not a multiple of the SIMD block size.
+        constexpr size_t SAMPLE_COUNT = FRAME_COUNT * NCHAN;
+
+        float in[SAMPLE_COUNT];
+        float outScalar[SAMPLE_COUNT];
+        float outSimd[SAMPLE_COUNT];
+        for (size_t i = 0; i < SAMPLE_COUNT; ++i) {
+            in[i] = (i % 17) * 0.05f - 0.4f;
+            outScalar[i] = outSimd[i] = (i % 5) * 0.1f; // accumulation starts from non-zero.
+        }
+        {
+            const float vol[2] = {0.3f, 0.7f};
+            float volSimd[2] = {vol[0], vol[1]};
+            volumeMulti<MIXTYPE, NCHAN>(
+                    outScalar, FRAME_COUNT, in, (float *)nullptr, vol, 0.f /* vola */);
+            volumeMixSimd<MIXTYPE, NCHAN, false /* RAMP */>(
+                    outSimd, FRAME_COUNT, in, volSimd, nullptr /* volinc */);
+            for (size_t i = 0; i < SAMPLE_COUNT; ++i) {
+                EXPECT_EQ(outScalar[i], outSimd[i]);
+            }
+        }
+        {
+            float vol[2] = {0.3f, 0.7f};
+            float volSimd[2] = {vol[0], vol[1]};
+            const float volinc[2] = {1e-4f, -2e-4f};
+            volumeRampMulti<MIXTYPE, NCHAN>(outScalar, FRAME_COUNT, in, (float *)nullptr,
+                    vol, volinc, (float *)nullptr, 0.f /* volainc */);
+            volumeMixSimd<MIXTYPE, NCHAN, true /* RAMP */>(
+                    outSimd, FRAME_COUNT, in, volSimd, volinc);
+            // the scalar ramp accumulates rounding error per frame.
+            constexpr float kTolerance = 1e-4f;
+            for (size_t i = 0; i < SAMPLE_COUNT; ++i) {
+                EXPECT_NEAR(outScalar[i], outSimd[i], kTolerance);
+            }
+            EXPECT_NEAR(vol[0], volSimd[0], kTolerance);
+            EXPECT_NEAR(vol[1], volSimd[1], kTolerance);
+        }
+    }
+};
+
+TEST(mixerops, simd_multi_1) {
+    MixerOpsSimdTest<MIXTYPE_MULTI, 1>::testVolumeMix();
+}
+TEST(mixerops, simd_multi_2) {
+    MixerOpsSimdTest<MIXTYPE_MULTI, 2>::testVolumeMix();
+}
+TEST(mixerops, simd_multi_saveonly_2) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_SAVEONLY, 2>::testVolumeMix();
+}
+TEST(mixerops, simd_multi_monovol_6) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_MONOVOL, 6>::testVolumeMix();
+}
+TEST(mixerops, simd_multi_saveonly_monovol_8) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_SAVEONLY_MONOVOL, 8>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_2) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 2>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_3) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 3>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_4) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 4>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_5) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 5>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_6) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 6>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_7) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 7>::testVolumeMix();
+}
+TEST(mixerops, simd_stereovolume_8) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_STEREOVOL, 8>::testVolumeMix();
+}
+TEST(mixerops, simd_saveonly_stereovolume_6) {
+    MixerOpsSimdTest<MIXTYPE_MULTI_SAVEONLY_STEREOVOL, 6>::testVolumeMix();
+}
+#endif // USE_MIXER_SIMD
+
+// AudioVolumeRamp applies the stereo volume affinity of MIXTYPE_MULTI_SAVEONLY_STEREOVOL,
+// ramping linearly per frame.
+TEST(mixerops, volume_ramp_float) {
+    constexpr size_t NCHAN = 2;
+    constexpr size_t FRAME_COUNT = 1001;
+    constexpr size_t RAMP_FRAMES = 600;
+    std::vector<float> in(FRAME_COUNT * NCHAN);
+    for (size_t i = 0; i < in.size(); ++i) {
+        in[i] = (i % 17) * 0.05f - 0.4f;
+    }
+
+    AudioVolumeRamp ramp(AUDIO_FORMAT_PCM_FLOAT, NCHAN);
+    std::vector<float> out = in;
+    ramp.setVolume(0.2f, 0.8f, 0 /* rampFrames */);
+    ramp.process(out.data(), FRAME_COUNT);
+    for (size_t i = 0; i < out.size(); ++i) {
+        EXPECT_EQ(in[i] * (i % NCHAN == 0 ? 0.2f : 0.8f), out[i]);
+    }
+
+    // ramp across two process() calls.
+    out = in;
+    ramp.setVolume(1.f, 0.f, RAMP_FRAMES);
+    EXPECT_TRUE(ramp.isRamping());
+    ramp.process(out.data(), 500);
+    ramp.process(out.data() + 500 * NCHAN, FRAME_COUNT - 500);
+    EXPECT_FALSE(ramp.isRamping());
+    constexpr float kTolerance = 1e-4f;
+    for (size_t f = 0; f < FRAME_COUNT; ++f) {
+        const float t = std::min(f, RAMP_FRAMES) / (float)RAMP_FRAMES;
+        const float left = 0.2f + (1.f - 0.2f) * t;
+        const float right = 0.8f + (0.f - 0.8f) * t;
+        EXPECT_NEAR(in[f * NCHAN] * left, out[f * NCHAN], kTolerance);
+        EXPECT_NEAR(in[f * NCHAN + 1] * right, out[f * NCHAN + 1], kTolerance);
+    }
+}
+
+static void testVolumeRampFormat(audio_format_t format, size_t channelCount) {
+    constexpr size_t FRAME_COUNT = 1001; // more than one conversion block.
+    const size_t sampleCount = FRAME_COUNT * channelCount;
+    const size_t sampleSize = audio_bytes_per_sample(format);
+    std::vector<float> in(sampleCount);
+    for (size_t i = 0; i < sampleCount; ++i) {
+        in[i] = (i % 17) * 0.05f - 0.4f;
+    }
+    std::vector<uint8_t> data(sampleCount * sampleSize);
+    memcpy_by_audio_format(data.data(), format, in.data(), AUDIO_FORMAT_PCM_FLOAT, sampleCount);
+    AudioVolumeRamp ramp(format, channelCount);
+
+    // unity volume leaves the data untouched.
+    std::vector<uint8_t> buffer = data;
+    ramp.process(buffer.data(), FRAME_COUNT);
+    EXPECT_EQ(data, buffer);
+
+    // with all channels at the same volume, the stereo affinity does not matter.
+    ramp.setVolume(0.5f, 0.5f, 0 /* rampFrames */);
+    ramp.process(buffer.data(), FRAME_COUNT);
+    std::vector<float> out(sampleCount);
+    memcpy_by_audio_format(out.data(), AUDIO_FORMAT_PCM_FLOAT, buffer.data(), format, sampleCount);
+    const float tolerance = format == AUDIO_FORMAT_PCM_16_BIT ? 2.f / 32768 : 1e-6f;
+    for (size_t i = 0; i < sampleCount; ++i) {
+        EXPECT_NEAR(in[i] * 0.5f, out[i], tolerance) << "sample " << i;
+    }
+
+    // zero volume clears the data.
+    ramp.setVolume(0.f, 0.f, 0 /* rampFrames */);
+    ramp.process(buffer.data(), FRAME_COUNT);
+    EXPECT_EQ(std::vector<uint8_t>(data.size()), buffer);
+}
+
+TEST(mixerops, volume_ramp_i16) {
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_16_BIT, 2);
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_16_BIT, 12);
+}
+TEST(mixerops, volume_ramp_p24) {
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_24_BIT_PACKED, 2);
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_24_BIT_PACKED, 6);
+}
+TEST(mixerops, volume_ramp_i32) {
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_32_BIT, 2);
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_32_BIT, 8);
+}
+TEST(mixerops, volume_ramp_q8_23) {
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_8_24_BIT, 2);
+}
+TEST(mixerops, volume_ramp_float_multichannel) {
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_FLOAT, 5);
+    testVolumeRampFormat(AUDIO_FORMAT_PCM_FLOAT, 12);
+}
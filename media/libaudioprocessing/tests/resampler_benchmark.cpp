@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/AudioBufferProvider.h>
+#include <media/AudioResampler.h>
+
+using namespace android;
+
+// Provides the same block of float frames over and over.
+class LoopProvider : public AudioBufferProvider {
+public:
+    LoopProvider(size_t channels, size_t frames)
+        : mChannels(channels), mFrames(frames), mData(channels * frames) {
+        for (size_t i = 0; i < mData.size(); ++i) {
+            mData[i] = sinf(i * 0.01f) * 0.5f;
+        }
+    }
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        const size_t frames = std::min(buffer->frameCount, mFrames - mOffset);
+        buffer->raw = mData.data() + mOffset * mChannels;
+        buffer->frameCount = frames;
+        return NO_ERROR;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mOffset += buffer->frameCount;
+        if (mOffset == mFrames) {
+            mOffset = 0;
+        }
+        buffer->raw = nullptr;
+        buffer->frameCount = 0;
+    }
+
+private:
+    const size_t mChannels;
+    const size_t mFrames;
+    std::vector<float> mData;
+    size_t mOffset = 0;
+};
+
+// Resamples float frames to 48kHz.
+// Arguments are the channel count, the AudioResampler::src_quality and the input sample rate;
+// 44.1kHz uses the fixed phase filter, 22.05kHz the interpolated phase filter.
+static void BM_ResampleFloat(benchmark::State& state) {
+    constexpr size_t FRAME_COUNT = 960;   // 20 ms
+    constexpr int32_t OUTPUT_RATE = 48000;
+    const size_t channels = state.range(0);
+    const auto quality = static_cast<AudioResampler::src_quality>(state.range(1));
+    const int32_t inputRate = state.range(2);
+
+    LoopProvider provider(channels, 4096);
+    std::unique_ptr<AudioResampler> resampler(AudioResampler::create(
+            AUDIO_FORMAT_PCM_FLOAT, channels, OUTPUT_RATE, quality));
+    resampler->setSampleRate(inputRate);
+    resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT, AudioResampler::UNITY_GAIN_FLOAT);
+
+    // mono is resampled to stereo.
+    std::vector<float> out(FRAME_COUNT * std::max(channels, (size_t)2));
+
+    while (state.KeepRunning()) {
+        // resample() accumulates into out.
+        std::fill(out.begin(), out.end(), 0.f);
+        benchmark::DoNotOptimize(out.data());
+        resampler->resample(reinterpret_cast<int32_t*>(out.data()), FRAME_COUNT, &provider);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * FRAME_COUNT);
+}
+
+static void ResampleArgs(benchmark::internal::Benchmark* b) {
+    b->ArgNames({"channels", "quality", "in_rate"});
+    for (int channels : {1, 2, 4, 6, 8, 12, 16, 24}) {
+        for (int quality : {AudioResampler::DYN_LOW_QUALITY,
+                            AudioResampler::DYN_MED_QUALITY,
+                            AudioResampler::DYN_HIGH_QUALITY}) {
+            for (int inputRate : {44100, 22050}) {
+                b->Args({channels, quality, inputRate});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_ResampleFloat)->Apply(ResampleArgs);
+
+BENCHMARK_MAIN();
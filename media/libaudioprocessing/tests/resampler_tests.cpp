@@ -155,6 +155,86 @@ void testBufferIncrement(size_t channels, bool useFloat,
     delete resampler;
 }
 
+// Checks that each FIR kernel the CPU supports (see AudioResampler::setFirSimd())
+// matches the default kernel, within float rounding.
+void testFirSimd(size_t channels, unsigned inputFreq, unsigned outputFreq,
+        enum android::AudioResampler::src_quality quality)
+{
+    SignalProvider provider;
+    provider.setChirp<float>(channels,
+            0., outputFreq/2., outputFreq, outputFreq/2000.);
+    std::vector<int> inputIncr;
+    provider.setIncr(inputIncr);
+
+    const size_t outputFrames = ((int64_t) provider.getNumFrames() * outputFreq) / inputFreq;
+    const size_t outputSamples = outputFrames * (channels == 1 ? 2 : channels);
+    const std::vector<size_t> outIncr{outputFrames};
+
+    const android::AudioResampler::fir_simd maxFirSimd =
+            android::AudioResampler::maxFirSimd();
+    std::vector<float> reference;
+    for (int simd = android::AudioResampler::FIR_SIMD_DEFAULT; simd <= maxFirSimd; ++simd) {
+        ASSERT_EQ(simd, android::AudioResampler::setFirSimd(
+                static_cast<android::AudioResampler::fir_simd>(simd)));
+        std::unique_ptr<android::AudioResampler> resampler(android::AudioResampler::create(
+                AUDIO_FORMAT_PCM_FLOAT, channels, outputFreq, quality));
+        resampler->setSampleRate(inputFreq);
+        resampler->setVolume(android::AudioResampler::UNITY_GAIN_FLOAT,
+                android::AudioResampler::UNITY_GAIN_FLOAT);
+
+        std::vector<float> test(outputSamples);
+        provider.reset();
+        resample(channels, test.data(), outputFrames, outIncr, &provider, resampler.get());
+        if (simd == android::AudioResampler::FIR_SIMD_DEFAULT) {
+            reference = std::move(test);
+            continue;
+        }
+        for (size_t i = 0; i < outputSamples; ++i) {
+            ASSERT_NEAR(reference[i], test[i], 1e-5) << "fir_simd " << simd << " sample " << i;
+        }
+    }
+    android::AudioResampler::setFirSimd(android::AudioResampler::defaultFirSimd());
+}
+
+// Checks that each channel of a multichannel float resampler matches the mono resampler,
+// within float rounding. The chirp of channel j is the mono chirp divided by j + 1.
+void testMultichannel(size_t channels, unsigned inputFreq, unsigned outputFreq,
+        enum android::AudioResampler::src_quality quality)
+{
+    auto resampleChirp = [&](size_t chirpChannels, std::vector<float> *out) {
+        SignalProvider provider;
+        provider.setChirp<float>(chirpChannels,
+                0., outputFreq/2., outputFreq, outputFreq/2000.);
+        std::vector<int> inputIncr;
+        provider.setIncr(inputIncr);
+
+        const size_t outputFrames =
+                ((int64_t) provider.getNumFrames() * outputFreq) / inputFreq;
+        out->assign(outputFrames * (chirpChannels == 1 ? 2 : chirpChannels), 0.f);
+
+        std::unique_ptr<android::AudioResampler> resampler(android::AudioResampler::create(
+                AUDIO_FORMAT_PCM_FLOAT, chirpChannels, outputFreq, quality));
+        resampler->setSampleRate(inputFreq);
+        resampler->setVolume(android::AudioResampler::UNITY_GAIN_FLOAT,
+                android::AudioResampler::UNITY_GAIN_FLOAT);
+        resample(chirpChannels, out->data(), outputFrames, {outputFrames},
+                &provider, resampler.get());
+        return outputFrames;
+    };
+
+    std::vector<float> reference; // mono resampler output is stereo
+    const size_t outputFrames = resampleChirp(1, &reference);
+    std::vector<float> test;
+    ASSERT_EQ(outputFrames, resampleChirp(channels, &test));
+
+    for (size_t i = 0; i < outputFrames; ++i) {
+        for (size_t j = 0; j < channels; ++j) {
+            ASSERT_NEAR(reference[i * 2] / (j + 1), test[i * channels + j], 1e-5)
+                    << "channels " << channels << " frame " << i << " channel " << j;
+        }
+    }
+}
+
 template <typename T>
 inline double sqr(T v)
 {
@@ -371,6 +451,38 @@ TEST(audioflinger_resampler, bufferincrement_interpolatedphase_multi_float) {
     }
 }
 
+TEST(audioflinger_resampler, firsimd_float) {
+    // only dynamic quality, mono and stereo have SIMD kernels
+    static const enum android::AudioResampler::src_quality kQualityArray[] = {
+            android::AudioResampler::DYN_LOW_QUALITY,
+            android::AudioResampler::DYN_MED_QUALITY,
+            android::AudioResampler::DYN_HIGH_QUALITY,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(kQualityArray); ++i) {
+        for (size_t channels : {1, 2}) {
+            testFirSimd(channels, 48000, 32000, kQualityArray[i]); // fixed phase
+            testFirSimd(channels, 22050, 48000, kQualityArray[i]); // interpolated phase
+        }
+    }
+}
+
+TEST(audioflinger_resampler, multichannel_float) {
+    // only dynamic quality
+    static const enum android::AudioResampler::src_quality kQualityArray[] = {
+            android::AudioResampler::DYN_LOW_QUALITY,
+            android::AudioResampler::DYN_MED_QUALITY,
+            android::AudioResampler::DYN_HIGH_QUALITY,
+    };
+
+    for (size_t i = 0; i < ARRAY_SIZE(kQualityArray); ++i) {
+        for (size_t channels : {4, 6, 8, 12, 16, 24}) {
+            testMultichannel(channels, 48000, 32000, kQualityArray[i]); // fixed phase
+            testMultichannel(channels, 22050, 48000, kQualityArray[i]); // interpolated phase
+        }
+    }
+}
+
 /* Simple aliasing test
  *
  * This checks stopband response of the chirp signal to make sure frequencies
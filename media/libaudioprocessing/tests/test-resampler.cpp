@@ -26,6 +26,7 @@
 #include <inttypes.h>
 #include <time.h>
 #include <math.h>
+#include <algorithm>
 #include <audio_utils/primitives.h>
 #include <audio_utils/sndfile.h>
 #include <android-base/macros.h>
@@ -38,13 +39,15 @@ using namespace android;
 static bool gVerbose = false;
 
 static int usage(const char* name) {
-    fprintf(stderr,"Usage: %s [-p] [-f] [-F] [-v] [-c channels]"
+    fprintf(stderr,"Usage: %s [-p] [-f] [-s] [-F] [-v] [-c channels]"
                    " [-q {dq|lq|mq|hq|vhq|dlq|dmq|dhq}]"
                    " [-i input-sample-rate] [-o output-sample-rate]"
                    " [-O csv] [-P csv] [<input-file>]"
                    " <output-file>\n", name);
     fprintf(stderr,"    -p    enable profiling\n");
     fprintf(stderr,"    -f    enable filter profiling\n");
+    fprintf(stderr,"    -s    profile and compare each FIR kernel (AVX2, AVX-512) the CPU supports,"
+                   " -F -q {dlq|dmq|dhq} only\n");
     fprintf(stderr,"    -F    enable floating point -q {dlq|dmq|dhq} only");
     fprintf(stderr,"    -v    verbose : log buffer provider calls\n");
     fprintf(stderr,"    -c    # channels (1-2 for lq|mq|hq; 1-8 for dlq|dmq|dhq)\n");
@@ -107,6 +110,7 @@ int main(int argc, char* argv[]) {
     const char* const progname = argv[0];
     bool profileResample = false;
     bool profileFilter = false;
+    bool profileFirSimd = false;
     bool useFloat = false;
     int channels = 1;
     int input_freq = 0;
@@ -116,7 +120,7 @@ int main(int argc, char* argv[]) {
     Vector<int> Pvalues;
 
     int ch;
-    while ((ch = getopt(argc, argv, "pfFvc:q:i:o:O:P:")) != -1) {
+    while ((ch = getopt(argc, argv, "pfsFvc:q:i:o:O:P:")) != -1) {
         switch (ch) {
         case 'p':
             profileResample = true;
@@ -124,6 +128,9 @@ int main(int argc, char* argv[]) {
         case 'f':
             profileFilter = true;
             break;
+        case 's':
+            profileFirSimd = true;
+            break;
         case 'F':
             useFloat = true;
             break;
@@ -189,6 +196,10 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "float processing is only possible for dynamic resamplers\n");
         return -1;
     }
+    if (profileFirSimd && !useFloat) {
+        fprintf(stderr, "FIR kernel profiling is only possible for float processing\n");
+        return -1;
+    }
 
     argc -= optind;
     argv += optind;
@@ -379,6 +390,59 @@ int main(int argc, char* argv[]) {
         delete resampler;
     }
 
+    if (profileFirSimd) {
+        // Profile the resampler with each FIR kernel the CPU supports, as for -p,
+        // and compare the output of each kernel with that of the default kernel.
+        static const char* const kFirSimdNames[] = { "default", "avx2", "avx512" };
+        const AudioResampler::fir_simd maxFirSimd = AudioResampler::maxFirSimd();
+        const size_t output_samples = output_frames * output_channels;
+        std::unique_ptr<float[]> reference(new float[output_samples]);
+        std::unique_ptr<float[]> test(new float[output_samples]);
+
+        for (int simd = AudioResampler::FIR_SIMD_DEFAULT; simd <= maxFirSimd; ++simd) {
+            AudioResampler::setFirSimd(static_cast<AudioResampler::fir_simd>(simd));
+            AudioResampler* resampler = AudioResampler::create(format, channels,
+                    output_freq, quality);
+            resampler->setSampleRate(input_freq);
+            resampler->setVolume(AudioResampler::UNITY_GAIN_FLOAT,
+                    AudioResampler::UNITY_GAIN_FLOAT);
+
+            float* out = simd == AudioResampler::FIR_SIMD_DEFAULT ? reference.get() : test.get();
+            memset(out, 0, output_samples * sizeof(float));
+            resampler->resample((int*) out, output_frames, &provider);
+            provider.reset();
+            float maxDiff = 0.f;
+            for (size_t i = 0; i < output_samples; ++i) {
+                maxDiff = std::max(maxDiff, fabsf(out[i] - reference[i]));
+            }
+
+            const int trials = 4;
+            const int looplimit = 4;
+            timespec start, end;
+            int64_t time = 0;
+            for (int n = 0; n < trials; ++n) {
+                clock_gettime(CLOCK_MONOTONIC, &start);
+                for (int i = 0; i < looplimit; ++i) {
+                    resampler->resample((int*) test.get(), output_frames, &provider);
+                    provider.reset();
+                }
+                clock_gettime(CLOCK_MONOTONIC, &end);
+                int64_t start_ns = start.tv_sec * 1000000000LL + start.tv_nsec;
+                int64_t end_ns = end.tv_sec * 1000000000LL + end.tv_nsec;
+                int64_t diff_ns = end_ns - start_ns;
+                if (n == 0 || diff_ns < time) {
+                    time = diff_ns;   // save the best out of our trials.
+                }
+            }
+            printf("fir: %s  quality: %d  channels: %d  msec: %" PRId64 "  Mfrms/s: %.2lf"
+                    "  max diff: %g\n",
+                    kFirSimdNames[simd], quality, channels, time/1000000,
+                    output_frames * looplimit / (time / 1e9) / 1e6, maxDiff);
+            delete resampler;
+        }
+        AudioResampler::setFirSimd(AudioResampler::defaultFirSimd());
+    }
+
     void* output_vaddr = malloc(output_size);
     AudioResampler* resampler = AudioResampler::create(format, channels,
             output_freq, quality);
@@ -17,6 +17,7 @@
 #define LOG_TAG "DataSource"
 
 
+#include <cutils/properties.h>
 #include <datasource/DataSourceFactory.h>
 #include <datasource/DataURISource.h>
 #include <datasource/HTTPBase.h>
@@ -108,9 +109,22 @@ sp<DataSource> DataSourceFactory::CreateFromURI(
     return source;
 }
 
+// Local files are read through a memory mapping when enabled. This is opt-in: reads
+// which race with a truncation of the file can still fault.
+static void maybeEnableMmap(const sp<FileSource> &source) {
+    if (source->initCheck() == OK
+            && property_get_bool("media.stagefright.filesource.mmap", false /* default */)) {
+        (void)source->enableMmap();
+    }
+}
+
 sp<DataSource> DataSourceFactory::CreateFromFd(int fd, int64_t offset, int64_t length) {
     sp<FileSource> source = new FileSource(fd, offset, length);
-    return source->initCheck() != OK ? nullptr : source;
+    if (source->initCheck() != OK) {
+        return nullptr;
+    }
+    maybeEnableMmap(source);
+    return source;
 }
 
 sp<DataSource> DataSourceFactory::CreateMediaHTTP(const sp<MediaHTTPService> &httpService) {
@@ -128,7 +142,9 @@ sp<DataSource> DataSourceFactory::CreateMediaHTTP(const sp<MediaHTTPService> &ht
 }
 
 sp<DataSource> DataSourceFactory::CreateFileSource(const char *uri) {
-    return new FileSource(uri);
+    sp<FileSource> source = new FileSource(uri);
+    maybeEnableMmap(source);
+    return source;
 }
 
 }  // namespace android
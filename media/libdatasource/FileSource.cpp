@@ -24,16 +24,74 @@
 #include <sys/types.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
+#include <setjmp.h>
+#include <signal.h>
 
 namespace android {
 
+// Mapped reads copy under a SIGBUS guard: if the file is truncated after it was mapped,
+// touching the pages no longer in the file raises SIGBUS, which fails the copy instead of
+// the process. sigsetjmp() does not save the signal mask, so the guard costs no system
+// call; the handler is installed with SA_NODEFER so that SIGBUS is not left blocked by the
+// jump out of it. A SIGBUS raised outside of a guarded copy goes to the previous handler.
+static thread_local sigjmp_buf *sMappedCopyJmp = NULL;
+static struct sigaction sPreviousSigbusAction;
+static pthread_once_t sSigbusHandlerOnce = PTHREAD_ONCE_INIT;
+
+static void sigbusHandler(int sig, siginfo_t *info, void *context) {
+    sigjmp_buf *jmp = sMappedCopyJmp;
+    if (jmp != NULL) {
+        siglongjmp(*jmp, 1);
+    }
+    if (sPreviousSigbusAction.sa_flags & SA_SIGINFO) {
+        sPreviousSigbusAction.sa_sigaction(sig, info, context);
+    } else if (sPreviousSigbusAction.sa_handler != SIG_DFL
+            && sPreviousSigbusAction.sa_handler != SIG_IGN) {
+        sPreviousSigbusAction.sa_handler(sig);
+    } else {
+        // the faulting access is retried on return, and now terminates the process
+        signal(SIGBUS, SIG_DFL);
+    }
+}
+
+static void installSigbusHandler() {
+    struct sigaction action = {};
+    action.sa_sigaction = sigbusHandler;
+    action.sa_flags = SA_SIGINFO | SA_NODEFER | SA_ONSTACK;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGBUS, &action, &sPreviousSigbusAction) != 0) {
+        ALOGE("cannot install the SIGBUS handler (%s)", strerror(errno));
+    }
+}
+
+// Returns false if the mapping faulted.
+static bool copyFromMapping(void *data, const uint8_t *mapData, size_t size) {
+    sigjmp_buf jmp;
+    if (sigsetjmp(jmp, 0 /* savesigs */) != 0) {
+        sMappedCopyJmp = NULL;
+        return false;
+    }
+    sMappedCopyJmp = &jmp;
+    // keep the compiler from moving the copy out of the guard, or eliding the guard
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    memcpy(data, mapData, size);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    sMappedCopyJmp = NULL;
+    return true;
+}
+
 FileSource::FileSource(const char *filename)
     : mFd(-1),
       mOffset(0),
       mLength(-1),
-      mName("<null>") {
+      mName("<null>"),
+      mMapData(NULL),
+      mMapBase(NULL),
+      mMapSize(0) {
 
     if (filename) {
         mName = String8::format("FileSource(%s)", filename);
@@ -52,7 +110,10 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
     : mFd(fd),
       mOffset(offset),
       mLength(length),
-      mName("<null>") {
+      mName("<null>"),
+      mMapData(NULL),
+      mMapBase(NULL),
+      mMapSize(0) {
     ALOGV("fd=%d (%s), offset=%lld, length=%lld",
             fd, nameForFd(fd).c_str(), (long long) offset, (long long) length);
 
@@ -90,6 +151,11 @@ FileSource::FileSource(int fd, int64_t offset, int64_t length)
 }
 
 FileSource::~FileSource() {
+    if (mMapBase != NULL) {
+        munmap(mMapBase, mMapSize);
+        mMapBase = NULL;
+        mMapData.store(NULL);
+    }
     if (mFd >= 0) {
         ::close(mFd);
         mFd = -1;
@@ -100,12 +166,51 @@ status_t FileSource::initCheck() const {
     return mFd >= 0 ? OK : NO_INIT;
 }
 
-ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
+status_t FileSource::enableMmap() {
+    Mutex::Autolock autoLock(mLock);
     if (mFd < 0) {
         return NO_INIT;
     }
+    if (mMapBase != NULL) {
+        return OK;
+    }
+    if (mLength <= 0) {
+        return BAD_VALUE;
+    }
+    // touching a page past the end of the file raises SIGBUS, so only map what the file holds.
+    // This is checked once: a later truncation is caught by the guard of the copies.
+    struct stat st;
+    if (fstat(mFd, &st) != 0 || mOffset + mLength > st.st_size) {
+        ALOGW("%s does not fit in the file, not mapping it", mName.c_str());
+        return BAD_VALUE;
+    }
 
-    Mutex::Autolock autoLock(mLock);
+    // the mapping has to start at a page boundary, so map from the page holding mOffset
+    const int64_t pageSize = sysconf(_SC_PAGESIZE);
+    const int64_t mapOffset = mOffset - (mOffset % pageSize);
+    const uint64_t mapSize = (uint64_t)(mOffset - mapOffset) + (uint64_t)mLength;
+    if (mapSize > SIZE_MAX) {
+        ALOGW("%s is too large to map", mName.c_str());
+        return BAD_VALUE;
+    }
+
+    pthread_once(&sSigbusHandlerOnce, installSigbusHandler);
+    void *base = mmap(NULL, (size_t)mapSize, PROT_READ, MAP_SHARED, mFd, mapOffset);
+    if (base == MAP_FAILED) {
+        ALOGW("failed to map %s (%s)", mName.c_str(), strerror(errno));
+        return UNKNOWN_ERROR;
+    }
+    // samples are mostly read front to back
+    (void)madvise(base, (size_t)mapSize, MADV_SEQUENTIAL);
+
+    mMapBase = base;
+    mMapSize = (size_t)mapSize;
+    mMapData.store((const uint8_t *)base + (mOffset - mapOffset), std::memory_order_release);
+    return OK;
+}
+
+// mLength is constant after construction, so clamping does not need mLock.
+ssize_t FileSource::clampRange(off64_t offset, size_t *size) const {
     if (mLength >= 0) {
         if (offset < 0) {
             return UNKNOWN_ERROR;
@@ -114,14 +219,58 @@ ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
             return 0;  // read beyond EOF.
         }
         uint64_t numAvailable = mLength - offset;
-        if ((uint64_t)size > numAvailable) {
-            size = numAvailable;
+        if ((uint64_t)*size > numAvailable) {
+            *size = numAvailable;
         }
     }
+    return *size;
+}
+
+bool FileSource::readMapped(off64_t offset, void *data, size_t size) {
+    const uint8_t *mapData = mMapData.load(std::memory_order_acquire);
+    if (mapData == NULL) {
+        return false;
+    }
+    if (copyFromMapping(data, mapData + offset, size)) {
+        return true;
+    }
+    // The file was truncated since it was mapped. Other threads may still be copying
+    // from the mapping, so it is only unmapped by the destructor.
+    if (mMapData.exchange(NULL, std::memory_order_acq_rel) != NULL) {
+        ALOGW("%s was truncated while mapped, reading from the file", mName.c_str());
+    }
+    return false;
+}
+
+ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+
+    if (mMapData.load(std::memory_order_acquire) != NULL) {
+        ssize_t available = clampRange(offset, &size);
+        if (available <= 0) {
+            return available;
+        }
+        if (readMapped(offset, data, size)) {
+            return available;
+        }
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    ssize_t available = clampRange(offset, &size);
+    if (available <= 0) {
+        return available;
+    }
     return readAt_l(offset, data, size);
 }
 
 ssize_t FileSource::readAt_l(off64_t offset, void *data, size_t size) {
+    // callers have clamped the range to [0, mLength)
+    if (readMapped(offset, data, size)) {
+        return size;
+    }
+
     off64_t result = lseek64(mFd, offset + mOffset, SEEK_SET);
     if (result == -1) {
         ALOGE("seek to %lld failed", (long long)(offset + mOffset));
@@ -26,6 +26,7 @@
 #include <cutils/properties.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/foundation/AString.h>
 #include <media/stagefright/MediaErrors.h>
 
 namespace android {
@@ -45,6 +46,15 @@ struct PageCache {
     void appendPage(Page *page);
     size_t releaseFromStart(size_t maxBytes);
 
+    // moves all pages of |other| to the end of this cache
+    void appendPages(PageCache *other);
+
+    // keeps only [from, from + size) of the cache
+    void trim(size_t from, size_t size);
+
+    // frees pages kept for reuse
+    void releaseFreePages();
+
     size_t totalSize() const {
         return mTotalSize;
     }
@@ -112,6 +122,47 @@ void PageCache::appendPage(Page *page) {
     mActivePages.push_back(page);
 }
 
+void PageCache::appendPages(PageCache *other) {
+    for (List<Page *>::iterator it = other->mActivePages.begin();
+            it != other->mActivePages.end(); ++it) {
+        appendPage(*it);
+    }
+    other->mActivePages.clear();
+    other->mTotalSize = 0;
+}
+
+void PageCache::trim(size_t from, size_t size) {
+    CHECK_LE(from + size, mTotalSize);
+
+    size_t end = from + size;
+    while (mTotalSize > end) {
+        List<Page *>::iterator it = --mActivePages.end();
+        Page *page = *it;
+        size_t excess = mTotalSize - end;
+        if (excess < page->mSize) {
+            page->mSize -= excess;
+            mTotalSize = end;
+            break;
+        }
+        mActivePages.erase(it);
+        mTotalSize -= page->mSize;
+        releasePage(page);
+    }
+
+    from -= releaseFromStart(from);
+    if (from > 0) {
+        Page *page = *mActivePages.begin();
+        memmove(page->mData, (const uint8_t *)page->mData + from, page->mSize - from);
+        page->mSize -= from;
+        mTotalSize -= from;
+    }
+}
+
+void PageCache::releaseFreePages() {
+    freePages(&mFreePages);
+    mFreePages.clear();
+}
+
 size_t PageCache::releaseFromStart(size_t maxBytes) {
     size_t bytesReleased = 0;
 
@@ -188,6 +239,16 @@ NuCachedSource2::NuCachedSource2(
       mLooper(new ALooper),
       mCache(new PageCache(kPageSize)),
       mCacheOffset(0),
+      mRetainedBytes(0),
+      mRetainedThresholdBytes(kDefaultRetainedThreshold),
+      mActivateOffset(-1),
+      mHintCache(NULL),
+      mHintOffset(0),
+      mHintEnd(0),
+      mNumReads(0),
+      mNumCacheHits(0),
+      mBytesFetched(0),
+      mBytesRefetched(0),
       mFinalStatus(OK),
       mLastAccessPos(0),
       mFetching(true),
@@ -234,6 +295,15 @@ NuCachedSource2::~NuCachedSource2() {
 
     delete mCache;
     mCache = NULL;
+
+    delete mHintCache;
+    mHintCache = NULL;
+
+    for (List<RetainedRange>::iterator it = mRetainedRanges.begin();
+            it != mRetainedRanges.end(); ++it) {
+        delete it->mCache;
+    }
+    mRetainedRanges.clear();
 }
 
 // static
@@ -326,11 +396,18 @@ void NuCachedSource2::fetchInternal() {
     ALOGV("fetchInternal");
 
     bool reconnect = false;
+    size_t fetchSize;
 
     {
         Mutex::Autolock autoLock(mLock);
         CHECK(mFinalStatus == OK || mNumRetriesLeft > 0);
 
+        // take over a retained range that the active range has grown into
+        if (mergeNextRetainedRange_l()) {
+            return;
+        }
+        fetchSize = clampToNextRange_l(mCacheOffset + mCache->totalSize(), kPageSize);
+
         if (mFinalStatus != OK) {
             --mNumRetriesLeft;
 
@@ -363,8 +440,8 @@ void NuCachedSource2::fetchInternal() {
 
     PageCache::Page *page = mCache->acquirePage();
 
-    ssize_t n = mSource->readAt(
-            mCacheOffset + mCache->totalSize(), page->mData, kPageSize);
+    const off64_t fetchOffset = mCacheOffset + mCache->totalSize();
+    ssize_t n = mSource->readAt(fetchOffset, page->mData, fetchSize);
 
     Mutex::Autolock autoLock(mLock);
 
@@ -394,12 +471,22 @@ void NuCachedSource2::fetchInternal() {
 
         page->mSize = n;
         mCache->appendPage(page);
+        recordFetch_l(fetchOffset, n);
     }
 }
 
 void NuCachedSource2::onFetch() {
     ALOGV("onFetch");
 
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mActivateOffset >= 0) {
+            // the reader is about to run out of a retained range, continue fetching it
+            activateRetainedRange_l(mActivateOffset);
+            mActivateOffset = -1;
+        }
+    }
+
     if (mFinalStatus != OK && mNumRetriesLeft == 0) {
         ALOGV("EOS reached, done prefetching for now");
         mFetching = false;
@@ -432,12 +519,24 @@ void NuCachedSource2::onFetch() {
             }
         }
     } else {
-        Mutex::Autolock autoLock(mLock);
-        restartPrefetcherIfNecessary_l();
+        {
+            Mutex::Autolock autoLock(mLock);
+            restartPrefetcherIfNecessary_l();
+        }
+        // the reader of the active range goes first, hints are fetched a page at a time
+        // while it does not need more
+        if (!mFetching) {
+            fetchPrefetchHint();
+        }
     }
 
     int64_t delayUs;
-    if (mFetching) {
+    bool hintsPending;
+    {
+        Mutex::Autolock autoLock(mLock);
+        hintsPending = mHintCache != NULL || !mPrefetchHints.empty();
+    }
+    if (mFetching || hintsPending) {
         if (mFinalStatus != OK && mNumRetriesLeft > 0) {
             // We failed this time and will try again in 3 seconds.
             delayUs = 3000000LL;
@@ -525,6 +624,8 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         return ERROR_END_OF_STREAM;
     }
 
+    ++mNumReads;
+
     // If the request can be completely satisfied from the cache, do so.
 
     if (offset >= mCacheOffset
@@ -533,6 +634,23 @@ ssize_t NuCachedSource2::readAt(off64_t offset, void *data, size_t size) {
         mCache->copy(delta, data, size);
 
         mLastAccessPos = offset + size;
+        ++mNumCacheHits;
+
+        return size;
+    }
+
+    RetainedRange *range = findRetainedRange_l(offset, size);
+    if (range != NULL) {
+        range->mCache->copy(offset - range->mOffset, data, size);
+        range->mLastAccessPos = offset + size;
+        ++mNumCacheHits;
+
+        // Apply the low water mark to the range being read: when the reader gets close
+        // to its end, have the fetcher continue this range.
+        off64_t rangeEnd = range->mOffset + range->mCache->totalSize();
+        if (rangeEnd - range->mLastAccessPos < (off64_t)mLowwaterThresholdBytes) {
+            mActivateOffset = range->mLastAccessPos;
+        }
 
         return size;
     }
@@ -593,9 +711,18 @@ size_t NuCachedSource2::approxDataRemaining_l(off64_t offset, status_t *finalSta
 
     offset = offset >= 0 ? offset : mLastAccessPos;
     off64_t lastBytePosCached = mCacheOffset + mCache->totalSize();
-    if (offset < lastBytePosCached) {
+    if (offset >= mCacheOffset && offset < lastBytePosCached) {
         return lastBytePosCached - offset;
     }
+    // the reader may be in a retained range, which the fetcher continues as it gets close
+    // to its end
+    for (List<RetainedRange>::const_iterator it = mRetainedRanges.begin();
+            it != mRetainedRanges.end(); ++it) {
+        off64_t rangeEnd = it->mOffset + it->mCache->totalSize();
+        if (offset >= it->mOffset && offset < rangeEnd) {
+            return rangeEnd - offset;
+        }
+    }
     return 0;
 }
 
@@ -613,7 +740,10 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         return ERROR_END_OF_STREAM;
     }
 
-    if (!mFetching) {
+    // Outside of the active range, the seek below starts fetching again; releasing the
+    // start of the active range would only throw away data that can be retained.
+    if (!mFetching && offset >= mCacheOffset
+            && offset <= (off64_t)(mCacheOffset + mCache->totalSize())) {
         mLastAccessPos = offset;
         restartPrefetcherIfNecessary_l(
                 false, // ignoreLowWaterThreshold
@@ -630,7 +760,9 @@ ssize_t NuCachedSource2::readInternal(off64_t offset, void *data, size_t size) {
         // does not trigger another seek.
         off64_t seekOffset = (offset > kPadding) ? offset - kPadding : 0;
 
-        seekInternal_l(seekOffset);
+        if (!activateRetainedRange_l(offset)) {
+            seekInternal_l(seekOffset);
+        }
     }
 
     size_t delta = offset - mCacheOffset;
@@ -670,19 +802,309 @@ status_t NuCachedSource2::seekInternal_l(off64_t offset) {
         return OK;
     }
 
+    if (activateRetainedRange_l(offset)) {
+        return OK;
+    }
+
     ALOGI("new range: offset= %lld", (long long)offset);
 
+    retireActiveRange_l();
     mCacheOffset = offset;
 
-    size_t totalSize = mCache->totalSize();
-    CHECK_EQ(mCache->releaseFromStart(totalSize), totalSize);
-
     mNumRetriesLeft = kMaxNumRetries;
     mFetching = true;
 
     return OK;
 }
 
+void NuCachedSource2::retireActiveRange_l() {
+    size_t totalSize = mCache->totalSize();
+    if (totalSize == 0) {
+        return;
+    }
+
+    mCache->releaseFreePages();
+    off64_t lastAccessPos = mLastAccessPos;
+    if (lastAccessPos < mCacheOffset || lastAccessPos > (off64_t)(mCacheOffset + totalSize)) {
+        lastAccessPos = mCacheOffset;
+    }
+    RetainedRange range = { mCacheOffset, mCache, lastAccessPos };
+    mRetainedRanges.push_back(range);
+    mRetainedBytes += totalSize;
+    mCache = new PageCache(kPageSize);
+
+    evictRetainedRanges_l();
+}
+
+bool NuCachedSource2::activateRetainedRange_l(off64_t offset) {
+    for (List<RetainedRange>::iterator it = mRetainedRanges.begin();
+            it != mRetainedRanges.end(); ++it) {
+        // a range also continues at its end
+        if (offset < it->mOffset
+                || offset > (off64_t)(it->mOffset + it->mCache->totalSize())) {
+            continue;
+        }
+
+        RetainedRange range = *it;
+        mRetainedRanges.erase(it);
+        mRetainedBytes -= range.mCache->totalSize();
+
+        ALOGV("resuming range: offset= %lld, size= %zu",
+                (long long)range.mOffset, range.mCache->totalSize());
+
+        retireActiveRange_l();
+        delete mCache;
+        mCache = range.mCache;
+        mCacheOffset = range.mOffset;
+        mLastAccessPos = offset;
+
+        mNumRetriesLeft = kMaxNumRetries;
+        mFetching = true;
+        return true;
+    }
+    return false;
+}
+
+bool NuCachedSource2::mergeNextRetainedRange_l() {
+    off64_t end = mCacheOffset + mCache->totalSize();
+    for (List<RetainedRange>::iterator it = mRetainedRanges.begin();
+            it != mRetainedRanges.end(); ++it) {
+        if (it->mOffset == end) {
+            ALOGV("merging range: offset= %lld, size= %zu",
+                    (long long)it->mOffset, it->mCache->totalSize());
+            mRetainedBytes -= it->mCache->totalSize();
+            mCache->appendPages(it->mCache);
+            delete it->mCache;
+            mRetainedRanges.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t NuCachedSource2::clampToNextRange_l(off64_t offset, size_t size) const {
+    off64_t end = offset + size;
+    if (mCacheOffset > offset && mCacheOffset < end) {
+        end = mCacheOffset;
+    }
+    for (List<RetainedRange>::const_iterator it = mRetainedRanges.begin();
+            it != mRetainedRanges.end(); ++it) {
+        if (it->mOffset > offset && it->mOffset < end) {
+            end = it->mOffset;
+        }
+    }
+    return end - offset;
+}
+
+NuCachedSource2::RetainedRange *NuCachedSource2::findRetainedRange_l(
+        off64_t offset, size_t size) {
+    for (List<RetainedRange>::iterator it = mRetainedRanges.begin();
+            it != mRetainedRanges.end(); ++it) {
+        if (offset >= it->mOffset
+                && offset + size <= it->mOffset + it->mCache->totalSize()) {
+            // move to the most recently used end
+            RetainedRange range = *it;
+            mRetainedRanges.erase(it);
+            mRetainedRanges.push_back(range);
+            return &*--mRetainedRanges.end();
+        }
+    }
+    return NULL;
+}
+
+void NuCachedSource2::evictRetainedRanges_l() {
+    while (mRetainedBytes > mRetainedThresholdBytes && !mRetainedRanges.empty()) {
+        List<RetainedRange>::iterator it = mRetainedRanges.begin();
+        ALOGV("evicting range: offset= %lld, size= %zu",
+                (long long)it->mOffset, it->mCache->totalSize());
+        mRetainedBytes -= it->mCache->totalSize();
+        delete it->mCache;
+        mRetainedRanges.erase(it);
+    }
+}
+
+void NuCachedSource2::addPrefetchHint(off64_t offset, size_t size) {
+    if (offset < 0 || size == 0) {
+        return;
+    }
+    Mutex::Autolock autoLock(mLock);
+    if (mPrefetchHints.size() >= kMaxPrefetchHints) {
+        mPrefetchHints.erase(mPrefetchHints.begin());
+    }
+    PrefetchHint hint = { offset, size < kMaxPrefetchHintSize ? size : kMaxPrefetchHintSize };
+    mPrefetchHints.push_back(hint);
+}
+
+// Fetches the next page of the current prefetch hint, which becomes a retained range once
+// fetched.
+void NuCachedSource2::fetchPrefetchHint() {
+    off64_t offset;
+    size_t size;
+    PageCache::Page *page;
+    {
+        Mutex::Autolock autoLock(mLock);
+        if (mDisconnecting) {
+            return;
+        }
+        if (mHintCache == NULL && !startPrefetchHint_l()) {
+            return;
+        }
+
+        offset = mHintOffset + mHintCache->totalSize();
+        // a seek since the last page may have started a range over the rest of the hint
+        if (offset >= mHintEnd || skipCachedRanges_l(offset, mHintEnd) != offset) {
+            finishPrefetchHint_l();
+            return;
+        }
+        size = clampToNextRange_l(offset, mHintEnd - offset);
+        if (size > kPageSize) {
+            size = kPageSize;
+        }
+        page = mHintCache->acquirePage();
+    }
+
+    ssize_t n = mSource->readAt(offset, page->mData, size);
+
+    Mutex::Autolock autoLock(mLock);
+    if (n <= 0 || mDisconnecting) {
+        mHintCache->releasePage(page);
+        finishPrefetchHint_l();
+        return;
+    }
+    page->mSize = n;
+    mHintCache->appendPage(page);
+    recordFetch_l(offset, n);
+    if (offset + n >= mHintEnd) {
+        finishPrefetchHint_l();
+    }
+}
+
+// Takes the next hint that is not cached yet. Returns false if there is none.
+bool NuCachedSource2::startPrefetchHint_l() {
+    while (!mPrefetchHints.empty()) {
+        PrefetchHint hint = *mPrefetchHints.begin();
+        mPrefetchHints.erase(mPrefetchHints.begin());
+
+        off64_t end = hint.mOffset + hint.mSize;
+        off64_t offset = skipCachedRanges_l(hint.mOffset, end);
+        // the active range is continued by the fetcher itself
+        if (offset >= end || offset == mCacheOffset + (off64_t)mCache->totalSize()) {
+            continue;
+        }
+
+        ALOGV("prefetching hint: offset= %lld, size= %lld",
+                (long long)offset, (long long)(end - offset));
+
+        mHintCache = new PageCache(kPageSize);
+        mHintOffset = offset;
+        mHintEnd = end;
+        return true;
+    }
+    return false;
+}
+
+// Makes what was fetched of the hint a retained range. A seek while the hint was fetched
+// may have started a range over part of it: only the part before the first such range is
+// kept, so that ranges never overlap.
+void NuCachedSource2::finishPrefetchHint_l() {
+    PageCache *cache = mHintCache;
+    mHintCache = NULL;
+
+    off64_t end = mHintOffset + cache->totalSize();
+    off64_t start = skipCachedRanges_l(mHintOffset, end);
+    if (start < end) {
+        end = start + clampToNextRange_l(start, end - start);
+    }
+    if (start >= end || mDisconnecting) {
+        delete cache;
+        return;
+    }
+    if (start != mHintOffset || end != (off64_t)(mHintOffset + cache->totalSize())) {
+        ALOGV("trimming hint: offset= %lld, size= %zu to offset= %lld, size= %lld",
+                (long long)mHintOffset, cache->totalSize(),
+                (long long)start, (long long)(end - start));
+        cache->trim(start - mHintOffset, end - start);
+    }
+
+    cache->releaseFreePages();
+    RetainedRange range = { start, cache, start };
+    mRetainedRanges.push_back(range);
+    mRetainedBytes += cache->totalSize();
+    evictRetainedRanges_l();
+}
+
+// Returns the first position in [offset, end) that no range caches, or end.
+off64_t NuCachedSource2::skipCachedRanges_l(off64_t offset, off64_t end) const {
+    bool moved = true;
+    while (moved && offset < end) {
+        moved = false;
+        off64_t activeEnd = mCacheOffset + mCache->totalSize();
+        if (offset >= mCacheOffset && offset < activeEnd) {
+            offset = activeEnd;
+            moved = true;
+        }
+        for (List<RetainedRange>::const_iterator it = mRetainedRanges.begin();
+                it != mRetainedRanges.end(); ++it) {
+            off64_t rangeEnd = it->mOffset + it->mCache->totalSize();
+            if (offset >= it->mOffset && offset < rangeEnd) {
+                offset = rangeEnd;
+                moved = true;
+            }
+        }
+    }
+    return offset < end ? offset : end;
+}
+
+void NuCachedSource2::recordFetch_l(off64_t offset, size_t size) {
+    static const size_t kMaxFetchedExtents = 1024;
+
+    off64_t start = offset;
+    off64_t end = offset + size;
+    off64_t refetched = 0;
+
+    // merge with all extents that overlap or touch [start, end)
+    std::map<off64_t, off64_t>::iterator it = mFetchedExtents.upper_bound(start);
+    if (it != mFetchedExtents.begin()) {
+        --it;
+        if (it->second < start) {
+            ++it;
+        }
+    }
+    while (it != mFetchedExtents.end() && it->first <= end) {
+        off64_t overlapStart = it->first > offset ? it->first : offset;
+        off64_t overlapEnd = it->second < (off64_t)(offset + size) ? it->second : offset + size;
+        if (overlapEnd > overlapStart) {
+            refetched += overlapEnd - overlapStart;
+        }
+        if (it->first < start) {
+            start = it->first;
+        }
+        if (it->second > end) {
+            end = it->second;
+        }
+        it = mFetchedExtents.erase(it);
+    }
+    if (mFetchedExtents.size() >= kMaxFetchedExtents) {
+        mFetchedExtents.erase(mFetchedExtents.begin());
+    }
+    mFetchedExtents[start] = end;
+
+    mBytesFetched += size;
+    mBytesRefetched += refetched;
+}
+
+void NuCachedSource2::dump(AString &logString) const {
+    Mutex::Autolock autoLock(mLock);
+    logString.append(AStringPrintf(
+            "hits(%lld/%lld, %.1f%%), fetched(%lld), refetched(%lld), "
+            "active(%lld+%zu), retained(%zu ranges, %zu bytes)",
+            (long long)mNumCacheHits, (long long)mNumReads,
+            mNumReads > 0 ? mNumCacheHits * 100. / mNumReads : 0.,
+            (long long)mBytesFetched, (long long)mBytesRefetched,
+            (long long)mCacheOffset, mCache->totalSize(),
+            mRetainedRanges.size(), mRetainedBytes).c_str());
+}
+
 void NuCachedSource2::resumeFetchingIfNecessary() {
     Mutex::Autolock autoLock(mLock);
 
@@ -707,11 +1129,12 @@ void NuCachedSource2::updateCacheParamsFromSystemProperty() {
 }
 
 void NuCachedSource2::updateCacheParamsFromString(const char *s) {
-    ssize_t lowwaterMarkKb, highwaterMarkKb;
+    ssize_t lowwaterMarkKb, highwaterMarkKb, retainedKb = -1;
     int keepAliveSecs;
 
-    if (sscanf(s, "%zd/%zd/%d",
-               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs) != 3) {
+    // the retained range size is optional
+    if (sscanf(s, "%zd/%zd/%d/%zd",
+               &lowwaterMarkKb, &highwaterMarkKb, &keepAliveSecs, &retainedKb) < 3) {
         ALOGE("Failed to parse cache parameters from '%s'.", s);
         return;
     }
@@ -741,10 +1164,18 @@ void NuCachedSource2::updateCacheParamsFromString(const char *s) {
         mKeepAliveIntervalUs = kDefaultKeepAliveIntervalUs;
     }
 
-    ALOGV("lowwater = %zu bytes, highwater = %zu bytes, keepalive = %lld us",
+    if (retainedKb >= 0) {
+        mRetainedThresholdBytes = retainedKb * 1024;
+    } else {
+        mRetainedThresholdBytes = kDefaultRetainedThreshold;
+    }
+
+    ALOGV("lowwater = %zu bytes, highwater = %zu bytes, keepalive = %lld us, "
+            "retained = %zu bytes",
          mLowwaterThresholdBytes,
          mHighwaterThresholdBytes,
-         (long long)mKeepAliveIntervalUs);
+         (long long)mKeepAliveIntervalUs,
+         mRetainedThresholdBytes);
 }
 
 // static
@@ -20,6 +20,8 @@
 
 #include <stdio.h>
 
+#include <atomic>
+
 #include <media/DataSource.h>
 #include <media/stagefright/MediaErrors.h>
 #include <utils/threads.h>
@@ -38,6 +40,12 @@ public:
 
     virtual status_t getSize(off64_t *size);
 
+    // Maps the file range into memory, so that reads are copied from the mapping
+    // without taking mLock or making a system call.
+    // If the file is truncated while mapped, reads fall back to the file descriptor.
+    // Returns OK if the source is mapped; otherwise reads keep using the file descriptor.
+    status_t enableMmap();
+
     virtual uint32_t flags() {
         return kIsLocalFileSource;
     }
@@ -58,6 +66,20 @@ protected:
 private:
     String8 mName;
 
+    // mapping of [mOffset, mOffset + mLength) once enableMmap() succeeded, or NULL.
+    // Set once, and cleared if the file is truncated, so readers do not need mLock.
+    std::atomic<const uint8_t *> mMapData;
+    void *mMapBase;
+    size_t mMapSize;
+
+    // Clamps |*size| to the end of the source. Returns the clamped size, 0 at or beyond
+    // the end of the source, or an error for a negative offset.
+    ssize_t clampRange(off64_t offset, size_t *size) const;
+
+    // Copies [offset, offset + size) of the source from the mapping. Returns false if the
+    // source is not mapped, or if the file no longer holds the range, which drops the mapping.
+    bool readMapped(off64_t offset, void *data, size_t size);
+
     FileSource(const FileSource &);
     FileSource &operator=(const FileSource &);
 };
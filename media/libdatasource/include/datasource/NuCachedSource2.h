@@ -18,13 +18,17 @@
 
 #define NU_CACHED_SOURCE_2_H_
 
+#include <map>
+
 #include <media/DataSource.h>
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AHandlerReflector.h>
+#include <utils/List.h>
 
 namespace android {
 
 struct ALooper;
+struct AString;
 struct PageCache;
 
 struct NuCachedSource2 : public DataSource {
@@ -61,6 +65,14 @@ struct NuCachedSource2 : public DataSource {
 
     void resumeFetchingIfNecessary();
 
+    // Hints that [offset, offset + size) will be read soon, e.g. an index located at the
+    // end of the file. The range is fetched into the cache once the fetcher is idle.
+    // GenericSource hints the end of the file, since extractors cannot call this.
+    void addPrefetchHint(off64_t offset, size_t size);
+
+    // Appends cache statistics (hit ratio, fetched and refetched bytes, ranges).
+    void dump(AString &logString) const;
+
     // The following methods are supported only if the
     // data source is HTTP-based; otherwise, ERROR_UNSUPPORTED
     // is returned.
@@ -77,6 +89,7 @@ protected:
 
 private:
     friend struct AHandlerReflector<NuCachedSource2>;
+    friend class NuCachedSource2Test;
 
     NuCachedSource2(
             const sp<DataSource> &source,
@@ -87,6 +100,10 @@ private:
         kPageSize                       = 65536,
         kDefaultHighWaterThreshold      = 20 * 1024 * 1024,
         kDefaultLowWaterThreshold       = 4 * 1024 * 1024,
+        kDefaultRetainedThreshold       = 8 * 1024 * 1024,
+
+        kMaxPrefetchHints               = 16,
+        kMaxPrefetchHintSize            = 2 * 1024 * 1024,
 
         // Read data after a 15 sec timeout whether we're actively
         // fetching or not.
@@ -111,10 +128,48 @@ private:
     mutable Mutex mLock;
     Condition mCondition;
 
+    // The active range, which the fetcher extends.
     PageCache *mCache;
     off64_t mCacheOffset;
+
+    // Ranges that were cached before the fetcher moved elsewhere, least recently used
+    // first. They never overlap each other or the active range. Reads are served from
+    // them, and seeking into one continues fetching at its end instead of refetching it.
+    // Each keeps the position its reader got to, the low water mark applies to it.
+    struct RetainedRange {
+        off64_t mOffset;
+        PageCache *mCache;
+        off64_t mLastAccessPos;
+    };
+    List<RetainedRange> mRetainedRanges;
+    size_t mRetainedBytes;
+    size_t mRetainedThresholdBytes;
+
+    // Set by readAt() when the reader approaches the end of a retained range, so that the
+    // fetcher makes that range active. -1 if none.
+    off64_t mActivateOffset;
+
+    struct PrefetchHint {
+        off64_t mOffset;
+        size_t mSize;
+    };
+    List<PrefetchHint> mPrefetchHints;
+
+    // The hint being fetched, a page at a time so that reads are not held up behind it,
+    // into [mHintOffset, mHintEnd). NULL if none. Only used on the looper thread.
+    PageCache *mHintCache;
+    off64_t mHintOffset;
+    off64_t mHintEnd;
+
+    // statistics
+    int64_t mNumReads;
+    int64_t mNumCacheHits;
+    int64_t mBytesFetched;
+    int64_t mBytesRefetched;
+    // merged [start, end) extents fetched so far, to account refetched bytes
+    std::map<off64_t, off64_t> mFetchedExtents;
     status_t mFinalStatus;
-    off64_t mLastAccessPos;
+    off64_t mLastAccessPos;     // the position the reader got to in the active range
     sp<AMessage> mAsyncResult;
     bool mFetching;
     bool mDisconnecting;
@@ -138,6 +193,18 @@ private:
     ssize_t readInternal(off64_t offset, void *data, size_t size);
     status_t seekInternal_l(off64_t offset);
 
+    void retireActiveRange_l();
+    bool activateRetainedRange_l(off64_t offset);
+    bool mergeNextRetainedRange_l();
+    size_t clampToNextRange_l(off64_t offset, size_t size) const;
+    RetainedRange *findRetainedRange_l(off64_t offset, size_t size);
+    void evictRetainedRanges_l();
+    void fetchPrefetchHint();
+    bool startPrefetchHint_l();
+    void finishPrefetchHint_l();
+    off64_t skipCachedRanges_l(off64_t offset, off64_t end) const;
+    void recordFetch_l(off64_t offset, size_t size);
+
     size_t approxDataRemaining_l(off64_t offset, status_t *finalStatus) const;
 
     void restartPrefetcherIfNecessary_l(
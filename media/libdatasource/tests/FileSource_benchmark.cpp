@@ -0,0 +1,134 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <datasource/FileSource.h>
+
+using namespace android;
+
+/*
+ * Measures sample read throughput of FileSource in the way MPEG4Extractor and
+ * MatroskaExtractor read a local file: for every sample a few small table/header
+ * reads followed by the sample payload.
+ *
+ * By default a synthetic 64 MB file is used; set FILESOURCE_BENCHMARK_FILE to the path
+ * of a large local MP4 or MKV file to use that instead.
+ */
+
+enum Mode {
+    kModePread,  // readAt() through the file descriptor
+    kModeMmap,   // readAt() copying from the mapping
+};
+
+static constexpr size_t kSyntheticFileSize = 64 << 20;
+static constexpr size_t kMaxSampleSize = 64 << 10;
+
+static std::string sSyntheticFile;
+
+static std::string getFile() {
+    const char *path = getenv("FILESOURCE_BENCHMARK_FILE");
+    if (path != nullptr) {
+        return path;
+    }
+    if (sSyntheticFile.empty()) {
+        const char *tmpDir = getenv("TMPDIR");
+        std::string tmpl = std::string(tmpDir != nullptr ? tmpDir : "/data/local/tmp")
+                + "/FileSource_benchmark_XXXXXX";
+        int fd = mkstemp(tmpl.data());
+        if (fd < 0) {
+            return "";
+        }
+        std::vector<uint8_t> chunk(1 << 20);
+        std::mt19937 rng(42);
+        for (size_t written = 0; written < kSyntheticFileSize; written += chunk.size()) {
+            for (uint8_t &b : chunk) {
+                b = rng();
+            }
+            if (write(fd, chunk.data(), chunk.size()) != (ssize_t)chunk.size()) {
+                break;
+            }
+        }
+        close(fd);
+        sSyntheticFile = tmpl;
+    }
+    return sSyntheticFile;
+}
+
+static void BM_FileSourceSampleRead(benchmark::State& state) {
+    const Mode mode = static_cast<Mode>(state.range(0));
+    const std::string path = getFile();
+    int fd = open(path.c_str(), O_RDONLY | O_LARGEFILE);
+    if (fd < 0) {
+        state.SkipWithError("cannot open file");
+        return;
+    }
+    sp<FileSource> source = new FileSource(fd, 0, lseek64(fd, 0, SEEK_END));
+    off64_t length;
+    source->getSize(&length);
+    if (mode != kModePread && source->enableMmap() != OK) {
+        state.SkipWithError("cannot map file");
+        return;
+    }
+
+    // sample sizes of a typical 1080p video track, read front to back
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<size_t> sampleSizes(1024, kMaxSampleSize);
+    std::vector<uint8_t> buffer(kMaxSampleSize);
+    off64_t offset = 0;
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        // sample table lookups: size, chunk offset and sync flag of the sample
+        uint32_t value;
+        for (int i = 0; i < 3; ++i) {
+            source->getUInt32((offset / 4096) * 4 % length, &value);
+        }
+
+        size_t size = sampleSizes(rng);
+        if (offset + (off64_t)size > length) {
+            offset = 0;
+        }
+        ssize_t n = source->readAt(offset, buffer.data(), size);
+        benchmark::DoNotOptimize(buffer[0]);
+        if (n <= 0) {
+            state.SkipWithError("read failed");
+            break;
+        }
+        offset += n;
+        bytes += n;
+    }
+    state.SetBytesProcessed(bytes);
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_FileSourceSampleRead)
+        ->Arg(kModePread)->Arg(kModeMmap)->ArgName("mode");
+
+int main(int argc, char **argv) {
+    ::benchmark::Initialize(&argc, argv);
+    ::benchmark::RunSpecifiedBenchmarks();
+    if (!sSyntheticFile.empty()) {
+        unlink(sSyntheticFile.c_str());
+    }
+    return 0;
+}
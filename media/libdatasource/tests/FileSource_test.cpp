@@ -0,0 +1,106 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "FileSource_test"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <android-base/file.h>
+#include <datasource/FileSource.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+namespace {
+
+constexpr size_t kFileSize = 256 << 10;
+
+class FileSourceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mContents.resize(kFileSize);
+        for (size_t i = 0; i < kFileSize; ++i) {
+            mContents[i] = (uint8_t)(i * 7 + (i >> 8));
+        }
+        ASSERT_TRUE(base::WriteFully(mFile.fd, mContents.data(), mContents.size()));
+    }
+
+    // FileSource takes ownership of the fd; mFile keeps its own for ftruncate().
+    sp<FileSource> openSource(int64_t offset, int64_t length) {
+        return new FileSource(open(mFile.path, O_RDONLY), offset, length);
+    }
+
+    TemporaryFile mFile;
+    std::vector<uint8_t> mContents;
+};
+
+TEST_F(FileSourceTest, MmapReadsMatchTheFile) {
+    constexpr int64_t kOffset = 1000;  // not page aligned
+    sp<FileSource> source = openSource(kOffset, kFileSize - kOffset);
+    ASSERT_EQ(OK, source->enableMmap());
+
+    std::vector<uint8_t> buffer(4096);
+    ASSERT_EQ((ssize_t)buffer.size(), source->readAt(5000, buffer.data(), buffer.size()));
+    EXPECT_EQ(0, memcmp(buffer.data(), &mContents[kOffset + 5000], buffer.size()));
+
+    // reads are clamped to the end of the source
+    EXPECT_EQ(10, source->readAt(kFileSize - kOffset - 10, buffer.data(), buffer.size()));
+    EXPECT_EQ(0, source->readAt(kFileSize - kOffset, buffer.data(), buffer.size()));
+}
+
+TEST_F(FileSourceTest, MmapRejectsRangeBeyondTheFile) {
+    sp<FileSource> source = openSource(0, kFileSize);
+    ASSERT_EQ(0, ftruncate(mFile.fd, kFileSize / 2));
+    EXPECT_NE(OK, source->enableMmap());
+
+    // reads still go through the file descriptor
+    std::vector<uint8_t> buffer(4096);
+    ASSERT_EQ((ssize_t)buffer.size(), source->readAt(0, buffer.data(), buffer.size()));
+    EXPECT_EQ(0, memcmp(buffer.data(), mContents.data(), buffer.size()));
+    EXPECT_EQ(0, source->readAt(kFileSize / 2, buffer.data(), buffer.size()));
+}
+
+// Reading pages of a mapping past the end of the file raises SIGBUS; the copy must fail
+// and the source fall back to the file descriptor instead.
+TEST_F(FileSourceTest, TruncatedWhileMapped) {
+    sp<FileSource> source = openSource(0, kFileSize);
+    ASSERT_EQ(OK, source->enableMmap());
+    std::vector<uint8_t> buffer(4096);
+    ASSERT_EQ((ssize_t)buffer.size(), source->readAt(0, buffer.data(), buffer.size()));
+
+    ASSERT_EQ(0, ftruncate(mFile.fd, kFileSize / 2));
+
+    EXPECT_EQ(0, source->readAt(kFileSize - buffer.size(), buffer.data(), buffer.size()));
+    // the part still in the file is read from the file descriptor
+    EXPECT_EQ(100, source->readAt(kFileSize / 2 - 100, buffer.data(), buffer.size()));
+    EXPECT_EQ(0, memcmp(buffer.data(), &mContents[kFileSize / 2 - 100], 100));
+    ASSERT_EQ((ssize_t)buffer.size(), source->readAt(0, buffer.data(), buffer.size()));
+    EXPECT_EQ(0, memcmp(buffer.data(), mContents.data(), buffer.size()));
+}
+
+// A SIGBUS outside of a read of the source still reaches the default action.
+TEST_F(FileSourceTest, SigbusOutsideReadsIsNotCaught) {
+    sp<FileSource> source = openSource(0, kFileSize);
+    ASSERT_EQ(OK, source->enableMmap());
+    EXPECT_DEATH(raise(SIGBUS), "");
+}
+
+}  // namespace
@@ -0,0 +1,417 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "NuCachedSource2_test"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <datasource/NuCachedSource2.h>
+#include <gtest/gtest.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+namespace android {
+
+namespace {
+
+constexpr off64_t kKB = 1024;
+constexpr off64_t kMB = 1024 * kKB;
+
+// low water 256KB, high water 1MB, no keep-alive, 2MB of retained ranges
+constexpr char kCacheConfig[] = "256/1024/0/2048";
+
+uint8_t byteAt(off64_t offset) {
+    return (uint8_t)(offset ^ (offset >> 8) ^ (offset >> 16));
+}
+
+// Serves byteAt() for each offset, from memory.
+class PatternSource : public DataSource {
+public:
+    explicit PatternSource(off64_t size) : mSize(size), mReadDelayUs(0) {}
+
+    // Makes each read take |delayUs|, like a network source.
+    void setReadDelayUs(useconds_t delayUs) {
+        mReadDelayUs = delayUs;
+    }
+
+    status_t initCheck() const override {
+        return OK;
+    }
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        if (offset >= mSize) {
+            return 0;
+        }
+        if ((off64_t)size > mSize - offset) {
+            size = mSize - offset;
+        }
+        if (mReadDelayUs > 0) {
+            usleep(mReadDelayUs);
+        }
+        for (size_t i = 0; i < size; ++i) {
+            ((uint8_t *)data)[i] = byteAt(offset + i);
+        }
+        return size;
+    }
+
+    status_t getSize(off64_t *size) override {
+        *size = mSize;
+        return OK;
+    }
+
+private:
+    const off64_t mSize;
+    std::atomic<useconds_t> mReadDelayUs;
+};
+
+}  // namespace
+
+class NuCachedSource2Test : public ::testing::Test {
+protected:
+    void create(off64_t size) {
+        mSource = new PatternSource(size);
+        mCachedSource = NuCachedSource2::Create(mSource, kCacheConfig);
+    }
+
+    void TearDown() override {
+        mCachedSource.clear();
+        mSource.clear();
+    }
+
+    // Waits for the fetcher to make |condition| true; |condition| is called with mLock held.
+    bool waitFor(const std::function<bool()> &condition) {
+        for (int i = 0; i < 500; ++i) {
+            {
+                Mutex::Autolock autoLock(mCachedSource->mLock);
+                if (condition()) {
+                    return true;
+                }
+            }
+            usleep(10000);
+        }
+        return false;
+    }
+
+    // Waits until the fetcher has filled the active range up to the high water mark and
+    // returns its offset, or -1. A read that seeks may release the start of the new range.
+    off64_t waitForFullActiveRange() {
+        off64_t offset = -1;
+        waitFor([this, &offset] {
+            status_t finalStatus;
+            if (mCachedSource->mFetching
+                    || mCachedSource->approxDataRemaining_l(
+                            mCachedSource->mCacheOffset, &finalStatus)
+                                    < mCachedSource->mHighwaterThresholdBytes) {
+                return false;
+            }
+            offset = mCachedSource->mCacheOffset;
+            return true;
+        });
+        return offset;
+    }
+
+    // Reads [offset, offset + size) and checks the data.
+    void expectRead(off64_t offset, size_t size) {
+        std::vector<uint8_t> data(size);
+        ASSERT_EQ((ssize_t)size, mCachedSource->readAt(offset, data.data(), size));
+        for (size_t i = 0; i < size; ++i) {
+            ASSERT_EQ(byteAt(offset + i), data[i]) << "offset " << offset + i;
+        }
+    }
+
+    // Called with mLock held, from waitFor().
+    size_t numRetainedRanges_l() {
+        return mCachedSource->mRetainedRanges.size();
+    }
+
+    size_t retainedBytes_l() {
+        return mCachedSource->mRetainedBytes;
+    }
+
+    bool prefetchHintsPending_l() {
+        return !mCachedSource->mPrefetchHints.empty();
+    }
+
+    bool fetchingPrefetchHint_l() {
+        return mCachedSource->mHintCache != NULL;
+    }
+
+    int64_t bytesFetched_l() {
+        return mCachedSource->mBytesFetched;
+    }
+
+    bool fetching_l() {
+        return mCachedSource->mFetching;
+    }
+
+    bool reachedEndOfStream_l() {
+        return mCachedSource->mFinalStatus == ERROR_END_OF_STREAM;
+    }
+
+    off64_t activeOffset() {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        return mCachedSource->mCacheOffset;
+    }
+
+    // The [start, end) of the active range, then of the retained ranges.
+    std::vector<std::pair<off64_t, off64_t>> ranges() {
+        std::vector<off64_t> offsets = retainedOffsets();
+        offsets.insert(offsets.begin(), activeOffset());
+        std::vector<std::pair<off64_t, off64_t>> ranges;
+        for (off64_t offset : offsets) {
+            off64_t size;
+            EXPECT_EQ(OK, mCachedSource->getAvailableSize(offset, &size));
+            ranges.emplace_back(offset, offset + size);
+        }
+        return ranges;
+    }
+
+    std::vector<off64_t> retainedOffsets() {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        std::vector<off64_t> offsets;
+        for (const NuCachedSource2::RetainedRange &range : mCachedSource->mRetainedRanges) {
+            offsets.push_back(range.mOffset);
+        }
+        return offsets;
+    }
+
+    int64_t numCacheHits() {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        return mCachedSource->mNumCacheHits;
+    }
+
+    int64_t bytesFetched() {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        return mCachedSource->mBytesFetched;
+    }
+
+    int64_t bytesRefetched() {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        return mCachedSource->mBytesRefetched;
+    }
+
+    void recordFetch(off64_t offset, size_t size) {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        mCachedSource->recordFetch_l(offset, size);
+    }
+
+    std::map<off64_t, off64_t> fetchedExtents() {
+        Mutex::Autolock autoLock(mCachedSource->mLock);
+        return mCachedSource->mFetchedExtents;
+    }
+
+    sp<PatternSource> mSource;
+    sp<NuCachedSource2> mCachedSource;
+};
+
+// Seeking away keeps the range that was being fetched, and reads are served from it.
+TEST_F(NuCachedSource2Test, RetainsRangeAcrossSeek) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+
+    expectRead(4 * kMB, 1000);
+    const off64_t offset = waitForFullActiveRange();
+    ASSERT_GE(4 * kMB, offset);
+    ASSERT_LE(4 * kMB - 256 * kKB, offset);
+    EXPECT_EQ(std::vector<off64_t>({0}), retainedOffsets());
+
+    const int64_t hits = numCacheHits();
+    expectRead(100, 1000);
+    expectRead(kMB - 1000, 1000);
+    EXPECT_EQ(hits + 2, numCacheHits());
+    EXPECT_EQ(0, bytesRefetched());
+}
+
+// Reading just past the end of a retained range continues fetching that range.
+TEST_F(NuCachedSource2Test, SeekIntoRetainedRangeResumesAtItsEnd) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+    expectRead(4 * kMB, 1000);
+    const off64_t offset = waitForFullActiveRange();
+    ASSERT_LE(0, offset);
+
+    // the seek lands in the range at 0, which becomes active again instead of fetching
+    // [kMB - 256KB, kMB) a second time
+    expectRead(kMB + 100, 1000);
+    EXPECT_GE(kMB + 100, activeOffset());
+    EXPECT_EQ(std::vector<off64_t>({offset}), retainedOffsets());
+    EXPECT_EQ(0, bytesRefetched());
+}
+
+// The active range stops short of a retained range, then takes it over once it grows
+// into it.
+TEST_F(NuCachedSource2Test, MergesRetainedRangeWhenGrowingIntoIt) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+    // not a whole number of pages after the range fetched below
+    expectRead(4 * kMB + 1000, 1000);
+    const off64_t retainedOffset = waitForFullActiveRange();
+    ASSERT_LE(0, retainedOffset);
+
+    // fills up to the high water mark, short of the retained range
+    expectRead(3 * kMB, 1000);
+    ASSERT_LE(0, waitForFullActiveRange());
+    const off64_t end = mCachedSource->cachedSize();
+    ASSERT_LT(end, retainedOffset);
+    EXPECT_EQ(2u, retainedOffsets().size());
+
+    // reading past the end restarts the fetcher, which only fetches the gap
+    const int64_t fetched = bytesFetched();
+    expectRead(end - 500, 1000);
+    ASSERT_TRUE(waitFor([this] { return numRetainedRanges_l() == 1; }));
+    EXPECT_EQ(std::vector<off64_t>({0}), retainedOffsets());
+    EXPECT_EQ(retainedOffset + kMB, (off64_t)mCachedSource->cachedSize());
+    EXPECT_EQ(fetched + retainedOffset - end, bytesFetched());
+
+    // across the point where the two ranges were joined
+    const int64_t hits = numCacheHits();
+    expectRead(retainedOffset - 5000, 10000);
+    EXPECT_EQ(hits + 1, numCacheHits());
+}
+
+// Retained ranges over budget are evicted least recently used first.
+TEST_F(NuCachedSource2Test, EvictsLeastRecentlyUsedRange) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+    expectRead(4 * kMB, 1000);
+    const off64_t offset1 = waitForFullActiveRange();
+    ASSERT_LE(0, offset1);
+    expectRead(8 * kMB, 1000);
+    const off64_t offset2 = waitForFullActiveRange();
+    ASSERT_LE(0, offset2);
+    EXPECT_EQ(std::vector<off64_t>({0, offset1}), retainedOffsets());
+
+    // makes the range at 0 the most recently used one
+    expectRead(100, 1000);
+    EXPECT_EQ(std::vector<off64_t>({offset1, 0}), retainedOffsets());
+
+    // retiring the third range goes over the 2MB budget
+    expectRead(12 * kMB, 1000);
+    EXPECT_EQ(std::vector<off64_t>({0, offset2}), retainedOffsets());
+}
+
+// Hints are fetched into retained ranges once the fetcher is idle, skipping and stopping
+// at what is already cached.
+TEST_F(NuCachedSource2Test, FetchesPrefetchHints) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+
+    mCachedSource->addPrefetchHint(8 * kMB, 512 * kKB);
+    ASSERT_TRUE(waitFor([this] { return retainedBytes_l() == 512 * kKB; }));
+    EXPECT_EQ(std::vector<off64_t>({8 * kMB}), retainedOffsets());
+    const int64_t hits = numCacheHits();
+    expectRead(8 * kMB + 1000, 1000);
+    EXPECT_EQ(hits + 1, numCacheHits());
+
+    // starts at the end of the range at 8MB
+    int64_t fetched = bytesFetched();
+    mCachedSource->addPrefetchHint(8 * kMB + 256 * kKB, 512 * kKB);
+    ASSERT_TRUE(waitFor([this] { return numRetainedRanges_l() == 2; }));
+    EXPECT_EQ(std::vector<off64_t>({8 * kMB, 8 * kMB + 512 * kKB}), retainedOffsets());
+    EXPECT_EQ(fetched + 256 * kKB, bytesFetched());
+
+    // stops at the start of the range at 8MB
+    fetched = bytesFetched();
+    mCachedSource->addPrefetchHint(8 * kMB - 64 * kKB, 128 * kKB);
+    ASSERT_TRUE(waitFor([this] { return numRetainedRanges_l() == 3; }));
+    EXPECT_EQ(fetched + 64 * kKB, bytesFetched());
+
+    // already cached
+    fetched = bytesFetched();
+    mCachedSource->addPrefetchHint(100 * kKB, 100 * kKB);
+    ASSERT_TRUE(waitFor([this] { return !prefetchHintsPending_l(); }));
+    EXPECT_EQ(fetched, bytesFetched());
+    EXPECT_EQ(3u, retainedOffsets().size());
+    EXPECT_EQ(0, bytesRefetched());
+}
+
+// A seek while a hint is fetched starts a range inside it; the hint is trimmed to end
+// where that range starts.
+TEST_F(NuCachedSource2Test, TrimsPrefetchHintOverlappedBySeek) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+
+    // the hint is fetched a page at a time, so reads are served while it is fetched
+    mSource->setReadDelayUs(10000);
+    const int64_t fetched = bytesFetched();
+    mCachedSource->addPrefetchHint(8 * kMB, 2 * kMB);
+    ASSERT_TRUE(waitFor([this, fetched] {
+        return fetchingPrefetchHint_l() && bytesFetched_l() >= fetched + 512 * kKB;
+    }));
+
+    // seeks to 8MB + 44KB, which the hint has fetched already
+    expectRead(8 * kMB + 300 * kKB, 1000);
+    ASSERT_TRUE(waitFor([this] { return !fetching_l() && !fetchingPrefetchHint_l(); }));
+    mSource->setReadDelayUs(0);
+
+    std::vector<std::pair<off64_t, off64_t>> cached = ranges();
+    ASSERT_EQ(3u, cached.size());
+    const off64_t activeOffset = cached[0].first;
+    EXPECT_EQ(8 * kMB + 44 * kKB, activeOffset);
+    EXPECT_EQ(std::make_pair((off64_t)0, kMB), cached[1]);
+    EXPECT_EQ(std::make_pair(8 * kMB, activeOffset), cached[2]);
+
+    // across the end of the trimmed hint and the start of the active range
+    int64_t hits = numCacheHits();
+    expectRead(8 * kMB, 44 * kKB);
+    expectRead(activeOffset, 100 * kKB);
+    EXPECT_EQ(hits + 2, numCacheHits());
+}
+
+// The data available is that of the range the offset is in.
+TEST_F(NuCachedSource2Test, ReportsAvailableSizeOfRetainedRange) {
+    create(16 * kMB);
+    ASSERT_EQ(0, waitForFullActiveRange());
+    expectRead(4 * kMB, 1000);
+    ASSERT_LE(0, waitForFullActiveRange());
+
+    off64_t size;
+    EXPECT_EQ(OK, mCachedSource->getAvailableSize(kMB - 1000, &size));
+    EXPECT_EQ(1000, size);
+    EXPECT_EQ(OK, mCachedSource->getAvailableSize(2 * kMB, &size));
+    EXPECT_EQ(0, size);
+}
+
+// Fetched extents are merged, and bytes fetched again are counted as refetched.
+TEST_F(NuCachedSource2Test, CountsRefetchedBytes) {
+    create(0);  // nothing to fetch
+    ASSERT_TRUE(waitFor([this] { return reachedEndOfStream_l(); }));
+
+    recordFetch(0, 100);
+    recordFetch(50, 100);
+    EXPECT_EQ(50, bytesRefetched());
+    recordFetch(200, 50);
+    EXPECT_EQ((std::map<off64_t, off64_t>{{0, 150}, {200, 250}}), fetchedExtents());
+
+    // overlaps both extents
+    recordFetch(100, 150);
+    EXPECT_EQ(150, bytesRefetched());
+    EXPECT_EQ((std::map<off64_t, off64_t>{{0, 250}}), fetchedExtents());
+
+    // touches the end
+    recordFetch(250, 10);
+    EXPECT_EQ(150, bytesRefetched());
+    EXPECT_EQ((std::map<off64_t, off64_t>{{0, 260}}), fetchedExtents());
+    EXPECT_EQ(410, bytesFetched());
+}
+
+}  // namespace android
@@ -52,6 +52,11 @@ static const int kInitialMarkMs        = 5000;  // 5secs
 //static const int kPausePlaybackMarkMs  = 2000;  // 2secs
 static const int kResumePlaybackMarkMs = 15000;  // 15secs
 
+// Indexes at the end of a file, e.g. Matroska cues or an MP4 'mfra' box, are often
+// only read on the first seek. The cache fetches this much of the end of the file once
+// it is otherwise idle.
+static const off64_t kPrefetchEndBytes = 512 * 1024;
+
 NuPlayer::GenericSource::GenericSource(
         const sp<AMessage> &notify,
         bool uidValid,
@@ -499,6 +504,10 @@ void NuPlayer::GenericSource::finishPrepareAsync() {
 
     if (mIsStreaming) {
         mCachedSource->resumeFetchingIfNecessary();
+        off64_t size;
+        if (mCachedSource->getSize(&size) == OK && size > kPrefetchEndBytes) {
+            mCachedSource->addPrefetchHint(size - kPrefetchEndBytes, kPrefetchEndBytes);
+        }
         mPreparing = true;
         schedulePollBuffering();
     } else {
@@ -514,16 +523,24 @@ void NuPlayer::GenericSource::finishPrepareAsync() {
     }
 }
 
+void NuPlayer::GenericSource::dump(AString &logString) {
+    Mutex::Autolock _l_d(mDisconnectLock);
+    if (mCachedSource != NULL) {
+        logString.append("cache(");
+        mCachedSource->dump(logString);
+        logString.append(")");
+    }
+}
+
 void NuPlayer::GenericSource::notifyPreparedAndCleanup(status_t err) {
     if (err != OK) {
         {
             Mutex::Autolock _l_d(mDisconnectLock);
             mDataSource.clear();
             mHttpSource.clear();
+            mCachedSource.clear();
         }
 
-        mCachedSource.clear();
-
         mBitrate = -1;
         mPrevBufferPercentage = -1;
         ++mPollBufferingGeneration;
@@ -3060,6 +3060,17 @@ const char *NuPlayer::getDataSourceType() {
         logString.append("null");
     }
     logString.append(")");
+
+    sp<Source> source;
+    {
+        Mutex::Autolock autoLock(mSourceLock);
+        source = mSource;
+    }
+    if (source != nullptr) {
+        logString.append(", source(");
+        source->dump(logString);
+        logString.append(")");
+    }
  }
 
 // Modular DRM begin
@@ -83,7 +83,10 @@ void NuPlayer::StreamingSource::start() {
 
     uint32_t sourceFlags = mSource->flags();
 
-    uint32_t parserFlags = ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE;
+    // Packets are fed without a SyncEvent and the access units are dequeued
+    // asynchronously, so they can be assembled off the feeding thread.
+    uint32_t parserFlags =
+        ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE | ATSParser::PARALLEL_ES_ASSEMBLY;
     if (sourceFlags & IStreamSource::kFlagAlignedVideoData) {
         parserFlags |= ATSParser::ALIGNED_VIDEO_DATA;
     }
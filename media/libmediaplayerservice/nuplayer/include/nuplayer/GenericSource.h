@@ -93,6 +93,8 @@ struct NuPlayer::GenericSource : public NuPlayer::Source,
 
     virtual status_t releaseDrm();
 
+    virtual void dump(AString &logString);
+
 
 protected:
     virtual ~GenericSource();
@@ -170,7 +172,8 @@ private:
     sp<ABuffer> mGlobalTimedText;
 
     mutable Mutex mLock;
-    mutable Mutex mDisconnectLock; // Protects mDataSource, mHttpSource and mDisconnected
+    mutable Mutex mDisconnectLock; // Protects mDataSource, mHttpSource, mDisconnected and
+                                   // clearing mCachedSource
 
     sp<ALooper> mLooper;
 
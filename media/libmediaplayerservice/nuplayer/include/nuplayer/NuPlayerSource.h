@@ -145,6 +145,9 @@ struct NuPlayer::Source : public AHandler {
         return INVALID_OPERATION;
     }
 
+    // Appends source specific state, e.g. cache statistics.
+    virtual void dump(AString & /* logString */) {}
+
 protected:
     virtual ~Source() {}
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SharedPipe"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <cutils/compiler.h>
+#include <utils/Log.h>
+#include <utils/Timers.h>
+#include <media/nbaio/SharedPipe.h>
+#include <audio_utils/roundup.h>
+
+namespace android {
+
+SharedPipe::SharedPipe(size_t maxFrames, const NBAIO_Format& format, void *buffer) :
+        NBAIO_Sink(format),
+        mMaxFrames(roundup(maxFrames)),
+        mBuffer(buffer == nullptr ? malloc(mMaxFrames * Format_frameSize(format)) : buffer),
+        mFreeBufferInDestructor(buffer == nullptr)
+{
+}
+
+SharedPipe::~SharedPipe()
+{
+    ALOG_ASSERT(mReaders.load() == 0);
+    if (mFreeBufferInDestructor) {
+        free(mBuffer);
+    }
+}
+
+ssize_t SharedPipe::write(const void *buffer, size_t count)
+{
+    // count == 0 is unlikely and not worth checking for
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    const int64_t rear = mRear.load(std::memory_order_relaxed);   // only written by this thread
+    const int64_t newRear = rear + (int64_t) count;
+
+    // Announce the frames about to be overwritten before overwriting them: a reader checks
+    // mWriting after reading, with an acquire fence, and sees this store if it could have
+    // read any of the new data.
+    mWriting.store(newRear, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // only the last mMaxFrames frames of a larger write can be read
+    size_t skip = count > mMaxFrames ? count - mMaxFrames : 0;
+    const char *src = (const char *) buffer + skip * mFrameSize;
+    int64_t position = rear + (int64_t) skip;
+    for (size_t remaining = count - skip; remaining > 0; ) {
+        const size_t offset = (size_t) position & (mMaxFrames - 1);
+        const size_t part = std::min(remaining, mMaxFrames - offset);
+        memcpy((char *) mBuffer + offset * mFrameSize, src, part * mFrameSize);
+        src += part * mFrameSize;
+        position += part;
+        remaining -= part;
+    }
+
+    mRear.store(newRear, std::memory_order_release);
+    mFramesWritten += count;
+    publishWriteTime(newRear);
+    return count;
+}
+
+void SharedPipe::publishWriteTime(int64_t position)
+{
+    const uint32_t sequence = mWriteTimeSequence.load(std::memory_order_relaxed);
+    mWriteTimeSequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    mWriteTimePosition.store(position, std::memory_order_relaxed);
+    mWriteTimeNs.store(systemTime(SYSTEM_TIME_MONOTONIC), std::memory_order_relaxed);
+    mWriteTimeSequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool SharedPipe::readWriteTime(int64_t *position, int64_t *timeNs) const
+{
+    // bounded, as SingleStateQueue::Observer::poll(): the reader never waits for the writer
+    static constexpr int kMaxTries = 5;
+    for (int tries = 0; tries < kMaxTries; ++tries) {
+        const uint32_t before = mWriteTimeSequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        const int64_t p = mWriteTimePosition.load(std::memory_order_relaxed);
+        const int64_t t = mWriteTimeNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (mWriteTimeSequence.load(std::memory_order_relaxed) == before) {
+            *position = p;
+            *timeNs = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+}   // namespace android
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "SharedPipeReader"
+//#define LOG_NDEBUG 0
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <cutils/compiler.h>
+#include <utils/Log.h>
+#include <utils/Timers.h>
+#include <media/nbaio/SharedPipeReader.h>
+
+namespace android {
+
+SharedPipeReader::SharedPipeReader(SharedPipe& pipe) :
+        NBAIO_Source(pipe.mFormat),
+        mPipe(pipe),
+        mFront(pipe.mRear.load(std::memory_order_acquire))
+{
+    mPipe.mReaders.fetch_add(1, std::memory_order_relaxed);
+}
+
+SharedPipeReader::~SharedPipeReader()
+{
+#if !LOG_NDEBUG
+    int32_t readers =
+#else
+    (void)
+#endif
+            mPipe.mReaders.fetch_sub(1, std::memory_order_relaxed);
+    ALOG_ASSERT(readers > 0);
+}
+
+void SharedPipeReader::overrun(int64_t rear)
+{
+    // skip to the oldest frame that is not being overwritten
+    const int64_t front = rear - (int64_t) mPipe.mMaxFrames;
+    mFramesOverrun += front - mFront;
+    ++mOverruns;
+    mFront = front;
+}
+
+ssize_t SharedPipeReader::checkOverrun(int64_t rear)
+{
+    const int64_t filled = rear - mFront;
+    if (CC_UNLIKELY(filled > (int64_t) mPipe.mMaxFrames)) {
+        overrun(rear);
+        return OVERRUN;
+    }
+    return (ssize_t) filled;
+}
+
+bool SharedPipeReader::isOverwritten() const
+{
+    return writing() - mFront > (int64_t) mPipe.mMaxFrames;
+}
+
+int64_t SharedPipeReader::writing() const
+{
+    // pairs with the release fence in SharedPipe::write()
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return mPipe.mWriting.load(std::memory_order_relaxed);
+}
+
+ssize_t SharedPipeReader::availableToRead()
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    return checkOverrun(mPipe.mRear.load(std::memory_order_acquire));
+}
+
+ssize_t SharedPipeReader::read(void *buffer, size_t count)
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    const ssize_t available = checkOverrun(mPipe.mRear.load(std::memory_order_acquire));
+    if (available <= 0) {
+        return available;
+    }
+    count = std::min(count, (size_t) available);
+    const size_t mask = mPipe.mMaxFrames - 1;
+    char *dst = (char *) buffer;
+    int64_t position = mFront;
+    for (size_t remaining = count; remaining > 0; ) {
+        const size_t offset = (size_t) position & mask;
+        const size_t part = std::min(remaining, mPipe.mMaxFrames - offset);
+        memcpy(dst, (const char *) mPipe.mBuffer + offset * mFrameSize, part * mFrameSize);
+        dst += part * mFrameSize;
+        position += part;
+        remaining -= part;
+    }
+    if (CC_UNLIKELY(isOverwritten())) {
+        overrun(writing());
+        return OVERRUN;
+    }
+    mFront += count;
+    mFramesRead += count;
+    mReadTimeNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    return count;
+}
+
+ssize_t SharedPipeReader::readVia(readVia_t via, size_t total, void *user, size_t block)
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    const ssize_t available = checkOverrun(mPipe.mRear.load(std::memory_order_acquire));
+    if (available <= 0) {
+        return available;
+    }
+    const size_t mask = mPipe.mMaxFrames - 1;
+    size_t remaining = std::min(total, (size_t) available);
+    size_t accumulator = 0;
+    while (remaining > 0) {
+        const size_t offset = (size_t) mFront & mask;
+        size_t part = std::min(remaining, mPipe.mMaxFrames - offset);
+        if (block != 0 && part > block) {
+            part = block;
+        }
+        ssize_t ret = via(user, (char *) mPipe.mBuffer + offset * mFrameSize, part);
+        if (ret <= 0) {
+            if (accumulator == 0) {
+                return ret;
+            }
+            break;
+        }
+        ALOG_ASSERT((size_t) ret <= part);
+        if (CC_UNLIKELY(isOverwritten())) {
+            overrun(writing());
+            return OVERRUN;
+        }
+        mFront += ret;
+        mFramesRead += ret;
+        accumulator += ret;
+        remaining -= ret;
+        if ((size_t) ret < part) {
+            break;
+        }
+    }
+    mReadTimeNs = systemTime(SYSTEM_TIME_MONOTONIC);
+    return accumulator;
+}
+
+ssize_t SharedPipeReader::flush()
+{
+    if (CC_UNLIKELY(!mNegotiated)) {
+        return NEGOTIATE;
+    }
+    const int64_t rear = mPipe.mRear.load(std::memory_order_acquire);
+    const ssize_t flushed = checkOverrun(rear);
+    if (flushed <= 0) {
+        return flushed;
+    }
+    mFront = rear;
+    mFramesRead += flushed;  // we consider flushed frames as read, but not lost frames
+    return flushed;
+}
+
+status_t SharedPipeReader::getTimestamp(ExtendedTimestamp& timestamp) const
+{
+    int64_t position, timeNs;
+    if (!mPipe.readWriteTime(&position, &timeNs)) {
+        return WOULD_BLOCK;
+    }
+    if (timeNs < 0) {
+        return INVALID_OPERATION;   // nothing written yet
+    }
+    timestamp.clear();
+    timestamp.mPosition[ExtendedTimestamp::LOCATION_SERVER] = position;
+    timestamp.mTimeNs[ExtendedTimestamp::LOCATION_SERVER] = timeNs;
+    timestamp.mPosition[ExtendedTimestamp::LOCATION_CLIENT] = mFront;
+    timestamp.mTimeNs[ExtendedTimestamp::LOCATION_CLIENT] = mReadTimeNs;
+    return OK;
+}
+
+}   // namespace android
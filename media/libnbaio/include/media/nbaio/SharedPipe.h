@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SHARED_PIPE_H
+#define ANDROID_AUDIO_SHARED_PIPE_H
+
+#include <atomic>
+
+#include <media/nbaio/NBAIO.h>
+
+namespace android {
+
+// SharedPipe is a single writer, multiple reader ring buffer (see SharedPipeReader),
+// for fanning out one stream, such as a FastMixer or capture stream, to several consumers.
+//
+// Like Pipe:
+//  - write() never blocks and never returns a short transfer count; flow control is
+//    the caller's responsibility, and a reader that does not keep up is overrun;
+//  - readers can be added and removed dynamically, and it's OK to have no readers.
+// Unlike Pipe:
+//  - each reader detects its own overruns, including frames overwritten by the writer
+//    while they were being read;
+//  - SharedPipeReader::readVia() hands out the frames in place, without an intermediate copy;
+//  - the writer publishes the time of each write, so that each reader can get a timestamp.
+//
+// Neither the writer nor the readers wait for each other, and there are no mutexes,
+// so SharedPipe is safe to use between SCHED_NORMAL and SCHED_FIFO threads.
+// write() is safe for only a single writer thread, and each SharedPipeReader for only
+// a single thread.
+class SharedPipe : public NBAIO_Sink {
+
+    friend class SharedPipeReader;
+
+public:
+    // maxFrames will be rounded up to a power of 2, and all slots are available. Must be >= 2.
+    // buffer is an optional parameter specifying the virtual address of the pipe buffer,
+    // which must be of size roundup(maxFrames) * Format_frameSize(format) bytes.
+    SharedPipe(size_t maxFrames, const NBAIO_Format& format, void *buffer = nullptr);
+
+    // If a buffer was specified in the constructor, it is not automatically freed by destructor.
+    // All readers must have been destroyed.
+    virtual ~SharedPipe();
+
+    // NBAIO_Sink interface
+
+    //virtual int64_t framesWritten() const;
+
+    // The write side of a pipe permits overruns, as Pipe.
+    virtual ssize_t availableToWrite() { return mMaxFrames; }
+
+    virtual ssize_t write(const void *buffer, size_t count);
+
+    // NBAIO_Sink end
+
+            size_t  maxFrames() const { return mMaxFrames; }
+
+            // Number of SharedPipeReader currently attached.
+            int32_t readers() const { return mReaders.load(std::memory_order_relaxed); }
+
+private:
+    // Position and CLOCK_MONOTONIC time of the last write, in a sequence lock.
+    void    publishWriteTime(int64_t position);
+    bool    readWriteTime(int64_t *position, int64_t *timeNs) const;
+
+    const size_t    mMaxFrames;     // always a power of 2
+    void * const    mBuffer;
+    const bool      mFreeBufferInDestructor;
+
+    // Frames written, including the write in progress: set before the data is copied,
+    // so that readers can tell which of the frames they have read were overwritten.
+    std::atomic<int64_t> mWriting{0};
+    // Frames written and available to readers: set after the data is copied.
+    std::atomic<int64_t> mRear{0};
+
+    std::atomic<uint32_t> mWriteTimeSequence{0};   // odd while being updated
+    std::atomic<int64_t>  mWriteTimePosition{0};
+    std::atomic<int64_t>  mWriteTimeNs{-1};
+
+    std::atomic<int32_t> mReaders{0};
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_SHARED_PIPE_H
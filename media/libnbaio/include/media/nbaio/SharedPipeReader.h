@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_SHARED_PIPE_READER_H
+#define ANDROID_AUDIO_SHARED_PIPE_READER_H
+
+#include "SharedPipe.h"
+
+namespace android {
+
+// SharedPipeReader is safe for only a single thread.
+// It holds a naked reference to its SharedPipe, which must outlive it.
+class SharedPipeReader : public NBAIO_Source {
+
+public:
+
+    // Construct a SharedPipeReader and associate it with a SharedPipe.
+    // The reader starts at the current write position: frames written before are not visible.
+    SharedPipeReader(SharedPipe& pipe);
+    virtual ~SharedPipeReader();
+
+    // NBAIO_Source interface
+
+    //virtual size_t framesRead() const;
+    virtual int64_t framesOverrun() { return mFramesOverrun; }
+    virtual int64_t overruns()  { return mOverruns; }
+
+    // On overrun, the reader skips to the oldest frame that the writer has not overwritten:
+    // the frames it skips are counted in framesOverrun(), and OVERRUN is returned once.
+    virtual ssize_t availableToRead();
+
+    virtual ssize_t read(void *buffer, size_t count);
+
+    // Calls via directly on the frames in the pipe, without copy.
+    // Because the writer never waits for readers, the frames passed to via may be overwritten
+    // while via is using them: overwrites are detected, but not prevented. So via must treat
+    // its frames as tentative, for example accumulate them into a scratch buffer,
+    // and only commit what it made of them once readVia() has returned a positive count.
+    // The frames are checked after each callback; if the writer has overwritten some of them
+    // in the meantime, readVia() stops and returns OVERRUN, and everything passed to via
+    // during that call must be discarded, including the blocks before the torn one.
+    // Readers that cannot discard their work, or that may fall behind by nearly maxFrames(),
+    // should use read(), which copies the frames before checking them.
+    virtual ssize_t readVia(readVia_t via, size_t total, void *user, size_t block = 0);
+
+    virtual ssize_t flush();
+
+    // NBAIO_Source end
+
+    // Returns the timestamp of this reader, if the writer has written:
+    //  - LOCATION_CLIENT is the position and time of the last read,
+    //  - LOCATION_SERVER is the position and time of the last write,
+    // so that timestamp.getLatencyMs(sampleRate, LOCATION_SERVER, LOCATION_CLIENT)
+    // is the latency of this reader behind the writer.
+    // Returns WOULD_BLOCK if the writer time could not be read consistently, try again.
+    status_t getTimestamp(ExtendedTimestamp& timestamp) const;
+
+private:
+    // Returns the frames available from mFront, or skips ahead and returns OVERRUN.
+    ssize_t checkOverrun(int64_t rear);
+    // Returns true if the writer has started overwriting the frames from mFront,
+    // after they were read.
+    bool    isOverwritten() const;
+    int64_t writing() const;
+    // Skips to the oldest frame not overwritten, when the writer has written up to rear.
+    void    overrun(int64_t rear);
+
+    SharedPipe&     mPipe;
+    int64_t         mFront;         // position of the next frame to read
+    int64_t         mReadTimeNs = -1;
+    int64_t         mFramesOverrun = 0;
+    int64_t         mOverruns = 0;
+};
+
+}   // namespace android
+
+#endif  // ANDROID_AUDIO_SHARED_PIPE_READER_H
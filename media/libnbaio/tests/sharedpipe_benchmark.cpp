@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/nbaio/PipeReader.h>
+#include <media/nbaio/SharedPipeReader.h>
+
+using namespace android;
+
+/*
+ * Fan-out of one stream to several readers, as a FastMixer output to a tee,
+ * a sound dose processor and a duplicating output.
+ *
+ * BM_Fanout measures the cost of one period: one write and one read per reader.
+ * Readers of Pipe and SharedPipe copy the period out; SharedPipe readVia() passes it
+ * in place to the consumer, which only sums it here.
+ *
+ * BM_SharedPipeLatency measures, with the readers on their own threads, the time from
+ * the end of a write to the end of the read of the same frames.
+ */
+
+namespace {
+
+constexpr size_t kFrameCount = 192;     // 4 ms at 48 kHz
+constexpr uint32_t kChannelCount = 2;
+constexpr size_t kPipeFrames = 16 * kFrameCount;
+const NBAIO_Format kFormat = Format_from_SR_C(48000, kChannelCount, AUDIO_FORMAT_PCM_FLOAT);
+
+enum Mode {
+    MODE_PIPE,
+    MODE_SHARED_PIPE,
+    MODE_SHARED_PIPE_VIA,
+};
+
+template <typename T>
+void negotiate(const sp<T>& port) {
+    size_t numCounterOffers = 0;
+    const NBAIO_Format offers[1] = {kFormat};
+    (void)port->negotiate(offers, 1, nullptr, numCounterOffers);
+}
+
+ssize_t consume(void *user, const void *buffer, size_t count) {
+    const float *samples = static_cast<const float *>(buffer);
+    float sum = 0.f;
+    for (size_t i = 0; i < count * kChannelCount; ++i) {
+        sum += samples[i];
+    }
+    *static_cast<float *>(user) += sum;
+    return count;
+}
+
+void BM_Fanout(benchmark::State& state) {
+    const Mode mode = (Mode)state.range(0);
+    const size_t readerCount = state.range(1);
+    std::vector<float> period(kFrameCount * kChannelCount, 0.25f);
+    std::vector<float> buffer(kFrameCount * kChannelCount);
+    float sum = 0.f;
+
+    sp<NBAIO_Sink> sink;
+    std::vector<sp<NBAIO_Source>> readers;
+    if (mode == MODE_PIPE) {
+        sp<Pipe> pipe = new Pipe(kPipeFrames, kFormat);
+        for (size_t i = 0; i < readerCount; ++i) {
+            readers.push_back(new PipeReader(*pipe));
+        }
+        sink = pipe;
+    } else {
+        sp<SharedPipe> pipe = new SharedPipe(kPipeFrames, kFormat);
+        for (size_t i = 0; i < readerCount; ++i) {
+            readers.push_back(new SharedPipeReader(*pipe));
+        }
+        sink = pipe;
+    }
+    negotiate(sink);
+    for (const auto& reader : readers) {
+        negotiate(reader);
+    }
+
+    for (auto _ : state) {
+        sink->write(period.data(), kFrameCount);
+        for (const auto& reader : readers) {
+            if (mode == MODE_SHARED_PIPE_VIA) {
+                reader->readVia(consume, kFrameCount, &sum);
+            } else {
+                reader->read(buffer.data(), kFrameCount);
+                consume(&sum, buffer.data(), kFrameCount);
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetBytesProcessed(state.iterations() * readerCount * kFrameCount * kChannelCount
+            * sizeof(float));
+    readers.clear();
+}
+
+void FanoutArgs(benchmark::internal::Benchmark* b) {
+    for (int mode : {MODE_PIPE, MODE_SHARED_PIPE, MODE_SHARED_PIPE_VIA}) {
+        for (int readers : {1, 2, 3, 4}) {
+            b->Args({mode, readers});
+        }
+    }
+}
+
+BENCHMARK(BM_Fanout)->Apply(FanoutArgs);
+
+void BM_SharedPipeLatency(benchmark::State& state) {
+    const size_t readerCount = state.range(0);
+    sp<SharedPipe> pipe = new SharedPipe(kPipeFrames, kFormat);
+    negotiate(pipe);
+    std::vector<sp<SharedPipeReader>> readers;
+    for (size_t i = 0; i < readerCount; ++i) {
+        readers.push_back(new SharedPipeReader(*pipe));
+        negotiate(readers.back());
+    }
+
+    std::atomic<bool> done{false};
+    std::atomic<int64_t> latencyNs{0};
+    std::atomic<int64_t> reads{0};
+    std::vector<std::thread> threads;
+    for (const auto& reader : readers) {
+        threads.emplace_back([&, reader] {
+            float sum = 0.f;
+            while (!done.load(std::memory_order_relaxed)) {
+                if (reader->readVia(consume, kFrameCount, &sum) <= 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                ExtendedTimestamp timestamp;
+                if (reader->getTimestamp(timestamp) == OK
+                        && timestamp.mPosition[ExtendedTimestamp::LOCATION_CLIENT]
+                        == timestamp.mPosition[ExtendedTimestamp::LOCATION_SERVER]) {
+                    latencyNs += timestamp.mTimeNs[ExtendedTimestamp::LOCATION_CLIENT]
+                            - timestamp.mTimeNs[ExtendedTimestamp::LOCATION_SERVER];
+                    ++reads;
+                }
+            }
+            benchmark::DoNotOptimize(sum);
+        });
+    }
+
+    std::vector<float> period(kFrameCount * kChannelCount, 0.25f);
+    for (auto _ : state) {
+        pipe->write(period.data(), kFrameCount);
+        // let the readers catch up, as the next period of a real stream would
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    state.counters["latency_us"] = reads > 0 ? latencyNs * 1e-3 / reads : 0.;
+    int64_t overruns = 0;
+    for (const auto& reader : readers) {
+        overruns += reader->overruns();
+    }
+    state.counters["overruns"] = overruns;
+    readers.clear();
+}
+
+BENCHMARK(BM_SharedPipeLatency)->Arg(1)->Arg(2)->Arg(4);
+
+} // namespace
+
+BENCHMARK_MAIN();
@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "sharedpipe_tests"
+
+#include <atomic>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/nbaio/SharedPipeReader.h>
+
+using namespace android;
+
+namespace {
+
+constexpr size_t kMaxFrames = 256;
+const NBAIO_Format kFormat = Format_from_SR_C(48000, 1, AUDIO_FORMAT_PCM_32_BIT);
+
+template <typename T>
+void negotiate(const sp<T>& port) {
+    size_t numCounterOffers = 0;
+    const NBAIO_Format offers[1] = {kFormat};
+    ASSERT_EQ(0, port->negotiate(offers, 1, nullptr, numCounterOffers));
+}
+
+// Writes the frame positions, so that readers can check what they read.
+ssize_t writeRamp(const sp<SharedPipe>& pipe, size_t count) {
+    std::vector<int32_t> buffer(count);
+    std::iota(buffer.begin(), buffer.end(), (int32_t)pipe->framesWritten());
+    return pipe->write(buffer.data(), count);
+}
+
+ssize_t sumVia(void *user, const void *buffer, size_t count) {
+    const int32_t *frames = static_cast<const int32_t *>(buffer);
+    *static_cast<int64_t *>(user) += std::accumulate(frames, frames + count, int64_t{0});
+    return count;
+}
+
+} // namespace
+
+TEST(SharedPipeTest, ReadersSeeEveryFrameIndependently) {
+    sp<SharedPipe> pipe = new SharedPipe(kMaxFrames, kFormat);
+    negotiate(pipe);
+    sp<SharedPipeReader> reader1 = new SharedPipeReader(*pipe);
+    sp<SharedPipeReader> reader2 = new SharedPipeReader(*pipe);
+    negotiate(reader1);
+    negotiate(reader2);
+    EXPECT_EQ(2, pipe->readers());
+
+    ASSERT_EQ(100, writeRamp(pipe, 100));
+    std::vector<int32_t> buffer(kMaxFrames);
+    ASSERT_EQ(100, reader1->availableToRead());
+    ASSERT_EQ(60, reader1->read(buffer.data(), 60));
+    EXPECT_EQ(59, buffer[59]);
+    ASSERT_EQ(100, reader2->read(buffer.data(), kMaxFrames));
+    EXPECT_EQ(99, buffer[99]);
+    EXPECT_EQ(0, reader2->availableToRead());
+
+    // wraps around the end of the pipe
+    ASSERT_EQ(200, writeRamp(pipe, 200));
+    ASSERT_EQ(240, reader1->read(buffer.data(), kMaxFrames));
+    for (size_t i = 0; i < 240; ++i) {
+        ASSERT_EQ((int32_t)(60 + i), buffer[i]);
+    }
+    EXPECT_EQ(300, reader1->framesRead());
+    EXPECT_EQ(0, reader1->framesOverrun());
+
+    // a reader added later starts at the write position
+    sp<SharedPipeReader> reader3 = new SharedPipeReader(*pipe);
+    negotiate(reader3);
+    EXPECT_EQ(0, reader3->availableToRead());
+    reader3.clear();
+    EXPECT_EQ(2, pipe->readers());
+}
+
+TEST(SharedPipeTest, OverrunIsPerReader) {
+    sp<SharedPipe> pipe = new SharedPipe(kMaxFrames, kFormat);
+    negotiate(pipe);
+    sp<SharedPipeReader> fast = new SharedPipeReader(*pipe);
+    sp<SharedPipeReader> slow = new SharedPipeReader(*pipe);
+    negotiate(fast);
+    negotiate(slow);
+    std::vector<int32_t> buffer(kMaxFrames);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(200, writeRamp(pipe, 200));
+        ASSERT_EQ(200, fast->read(buffer.data(), kMaxFrames));
+    }
+    EXPECT_EQ(0, fast->overruns());
+
+    // the slow reader skips to the oldest frames still in the pipe
+    EXPECT_EQ((ssize_t)OVERRUN, slow->availableToRead());
+    EXPECT_EQ(1, slow->overruns());
+    EXPECT_EQ((int64_t)(600 - kMaxFrames), slow->framesOverrun());
+    ASSERT_EQ((ssize_t)kMaxFrames, slow->read(buffer.data(), kMaxFrames));
+    EXPECT_EQ((int32_t)(600 - kMaxFrames), buffer[0]);
+    EXPECT_EQ(599, buffer[kMaxFrames - 1]);
+}
+
+TEST(SharedPipeTest, ReadViaPassesTheFramesInPlace) {
+    sp<SharedPipe> pipe = new SharedPipe(kMaxFrames, kFormat);
+    negotiate(pipe);
+    sp<SharedPipeReader> reader = new SharedPipeReader(*pipe);
+    negotiate(reader);
+    ASSERT_EQ(200, writeRamp(pipe, 200));
+    std::vector<int32_t> buffer(kMaxFrames);
+    ASSERT_EQ(200, reader->read(buffer.data(), kMaxFrames));
+    ASSERT_EQ(100, writeRamp(pipe, 100));   // 200..299, wrapping at 256
+
+    int64_t sum = 0;
+    ASSERT_EQ(100, reader->readVia(sumVia, kMaxFrames, &sum, 0 /* block */));
+    EXPECT_EQ((200 + 299) * 100 / 2, sum);
+    EXPECT_EQ(300, reader->framesRead());
+    EXPECT_EQ(0, reader->readVia(sumVia, kMaxFrames, &sum, 0 /* block */));
+}
+
+// The writer does not wait for readVia(): frames overwritten while via uses them are reported,
+// and via must then discard them.
+TEST(SharedPipeTest, ReadViaReportsFramesOverwrittenDuringTheCallback) {
+    sp<SharedPipe> pipe = new SharedPipe(kMaxFrames, kFormat);
+    negotiate(pipe);
+    sp<SharedPipeReader> reader = new SharedPipeReader(*pipe);
+    negotiate(reader);
+    ASSERT_EQ(100, writeRamp(pipe, 100));
+
+    struct Context {
+        sp<SharedPipe> pipe;
+        int64_t sum = 0;
+    } context{pipe};
+    auto overwritingVia = [](void *user, const void *buffer, size_t count) -> ssize_t {
+        Context *context = static_cast<Context *>(user);
+        sumVia(&context->sum, buffer, count);
+        writeRamp(context->pipe, kMaxFrames);   // wraps over the frames being read
+        return count;
+    };
+    EXPECT_EQ((ssize_t)OVERRUN, reader->readVia(overwritingVia, kMaxFrames, &context));
+    EXPECT_EQ(0, reader->framesRead());
+    EXPECT_EQ(1, reader->overruns());
+
+    // The reader skipped to the oldest frames still in the pipe, which are intact.
+    std::vector<int32_t> buffer(kMaxFrames);
+    ASSERT_EQ((ssize_t)kMaxFrames, reader->read(buffer.data(), kMaxFrames));
+    EXPECT_EQ(100, buffer[0]);
+    EXPECT_EQ((int32_t)(100 + kMaxFrames - 1), buffer[kMaxFrames - 1]);
+}
+
+TEST(SharedPipeTest, Timestamp) {
+    sp<SharedPipe> pipe = new SharedPipe(kMaxFrames, kFormat);
+    negotiate(pipe);
+    sp<SharedPipeReader> reader = new SharedPipeReader(*pipe);
+    negotiate(reader);
+    ExtendedTimestamp timestamp;
+    EXPECT_EQ(INVALID_OPERATION, reader->getTimestamp(timestamp));
+
+    ASSERT_EQ(200, writeRamp(pipe, 200));
+    std::vector<int32_t> buffer(kMaxFrames);
+    ASSERT_EQ(50, reader->read(buffer.data(), 50));
+    ASSERT_EQ(OK, reader->getTimestamp(timestamp));
+    EXPECT_EQ(200, timestamp.mPosition[ExtendedTimestamp::LOCATION_SERVER]);
+    EXPECT_EQ(50, timestamp.mPosition[ExtendedTimestamp::LOCATION_CLIENT]);
+    EXPECT_GT(timestamp.mTimeNs[ExtendedTimestamp::LOCATION_SERVER], 0);
+    EXPECT_GE(timestamp.mTimeNs[ExtendedTimestamp::LOCATION_CLIENT],
+            timestamp.mTimeNs[ExtendedTimestamp::LOCATION_SERVER]);
+}
+
+// A writer and readers on different threads: every frame a reader returns is intact,
+// and whatever a reader misses is accounted for as overrun.
+TEST(SharedPipeTest, ConcurrentReadersNeverSeeTornFrames) {
+    constexpr int64_t kTotalFrames = 1 << 20;
+    constexpr size_t kReaders = 3;
+    sp<SharedPipe> pipe = new SharedPipe(kMaxFrames, kFormat);
+    negotiate(pipe);
+    std::vector<sp<SharedPipeReader>> readers;
+    for (size_t i = 0; i < kReaders; ++i) {
+        readers.push_back(new SharedPipeReader(*pipe));
+        negotiate(readers.back());
+    }
+
+    std::atomic<bool> done{false};
+    std::vector<std::thread> threads;
+    std::vector<int> errors(kReaders);
+    for (size_t i = 0; i < kReaders; ++i) {
+        threads.emplace_back([&, i] {
+            const sp<SharedPipeReader>& reader = readers[i];
+            // one in three readers is slow, and will be overrun
+            const size_t count = i == 0 ? 7 : 64;
+            std::vector<int32_t> buffer(count);
+            int64_t expected = 0;
+            for (bool last = false; !last;) {
+                last = done.load();
+                ssize_t actual;
+                while ((actual = reader->read(buffer.data(), count)) != 0) {
+                    if (actual == (ssize_t)OVERRUN) {
+                        expected = reader->framesRead() + reader->framesOverrun();
+                        continue;
+                    }
+                    for (ssize_t j = 0; j < actual; ++j) {
+                        if (buffer[j] != expected++) ++errors[i];
+                    }
+                }
+            }
+            EXPECT_EQ(kTotalFrames, reader->framesRead() + reader->framesOverrun());
+        });
+    }
+    for (int64_t written = 0; written < kTotalFrames; written += 32) {
+        ASSERT_EQ(32, writeRamp(pipe, 32));
+    }
+    done = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < kReaders; ++i) {
+        EXPECT_EQ(0, errors[i]) << "reader " << i;
+    }
+}
@@ -39,6 +39,7 @@
 #include <media/stagefright/foundation/ColorUtils.h>
 #include <media/stagefright/foundation/avc_utils.h>
 #include <mediadrm/ICrypto.h>
+#include <mediautils/WorkerPool.h>
 #include <private/media/VideoFrame.h>
 #include <utils/Log.h>
 #include <utils/Trace.h>
@@ -48,6 +49,9 @@
 #include <C2Buffer.h>
 #include <Codec2BufferUtils.h>
 
+#include <algorithm>
+#include <thread>
+
 namespace android {
 
 static const int64_t kBufferTimeOutUs = 10000LL; // 10 msec
@@ -57,6 +61,8 @@ static const int64_t kDefaultSampleDurationUs = 33333LL; // 33ms
 // For codec, 0 is the highest importance; higher the number lesser important.
 // To make codec for thumbnail less important, give it a value more than 0.
 static const int kThumbnailImportance = 1;
+// frames are converted in bands of rows on up to this many threads
+static const size_t kMaxColorConversionThreads = 4;
 
 sp<IMemory> allocVideoFrame(const sp<MetaData>& trackMeta,
         int32_t width, int32_t height, int32_t tileWidth, int32_t tileHeight,
@@ -421,6 +427,18 @@ FrameDecoder::~FrameDecoder() {
     }
 }
 
+mediautils::WorkerPool *FrameDecoder::colorConversionPool() {
+    if (mColorConversionPool == nullptr) {
+        // the calling thread converts bands too
+        const size_t numThreads = std::clamp(
+                (size_t)std::thread::hardware_concurrency(), (size_t)1,
+                kMaxColorConversionThreads);
+        mColorConversionPool.reset(
+                new mediautils::WorkerPool(numThreads - 1, "FrameDecoder"));
+    }
+    return mColorConversionPool.get();
+}
+
 bool isHDR(const sp<AMessage> &format) {
     uint32_t standard, transfer;
     if (!format->findInt32("color-standard", (int32_t*)&standard)) {
@@ -1037,6 +1055,7 @@ status_t VideoFrameDecoder::onOutputReceived(
         return ERROR_UNSUPPORTED;
     }
     colorConverter.setSrcColorSpace(standard, range, transfer);
+    colorConverter.setWorkerPool(colorConversionPool());
     if (colorConverter.isValid()) {
         ScopedTrace trace(ATRACE_TAG, "FrameDecoder::ColorConverter");
         if (frameData == nullptr) {
@@ -1325,6 +1344,7 @@ status_t MediaImageDecoder::onOutputReceived(
         return ERROR_UNSUPPORTED;
     }
     converter.setSrcColorSpace(standard, range, transfer);
+    converter.setWorkerPool(colorConversionPool());
 
     int32_t crop_left, crop_top, crop_right, crop_bottom;
     if (!outputFormat->findRect("crop", &crop_left, &crop_top, &crop_right, &crop_bottom)) {
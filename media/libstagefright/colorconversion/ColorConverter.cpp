@@ -25,13 +25,17 @@
 #include <media/stagefright/ColorConverter.h>
 #include <media/stagefright/MediaCodecConstants.h>
 #include <media/stagefright/MediaErrors.h>
+#include <mediautils/WorkerPool.h>
 
 #include "libyuv/convert_from.h"
 #include "libyuv/convert_argb.h"
 #include "libyuv/planar_functions.h"
 #include "libyuv/video_common.h"
+#include <algorithm>
 #include <functional>
 #include <sys/time.h>
+#include <utility>
+#include <vector>
 
 #define PERF_PROFILING 0
 
@@ -41,10 +45,26 @@
 #define USE_NEON_Y410 0
 #endif
 
-#if USE_NEON_Y410
+// SIMD row kernels for the conversions that libyuv does not handle
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#define USE_NEON_YUV 1
+#define USE_SSE2_YUV 0
+#elif defined(__SSE2__)
+#define USE_NEON_YUV 0
+#define USE_SSE2_YUV 1
+#else
+#define USE_NEON_YUV 0
+#define USE_SSE2_YUV 0
+#endif
+
+#if USE_NEON_Y410 || USE_NEON_YUV
 #include <arm_neon.h>
 #endif
 
+#if USE_SSE2_YUV
+#include <emmintrin.h>
+#endif
+
 namespace android {
 typedef const struct libyuv::YuvConstants LibyuvConstants;
 
@@ -456,6 +476,310 @@ constexpr int CLIP_RANGE_MAX_8BIT = 552;
 constexpr int CLIP_RANGE_MIN_10BIT = -1175;
 constexpr int CLIP_RANGE_MAX_10BIT = 2218;
 
+// Frames are only split into bands of at least this many rows; smaller bands
+// are not worth waking up a worker for.
+constexpr size_t kMinRowsPerBand = 64;
+
+/**
+ * Row kernels for the conversions that libyuv does not handle. Each kernel
+ * converts the largest multiple of 8 pixels of a row and returns the number of
+ * pixels converted; the caller converts the rest with the per-pixel code.
+ *
+ * The kernels produce the same values as the per-pixel code: they compute
+ * (y * _y + 128 + chroma term) >> 8 in 32-bit lanes and clamp it to the output
+ * range. The per-pixel code divides by 256 instead, which rounds negative values
+ * differently, but any negative value clips to 0 either way.
+ */
+
+#if USE_SSE2_YUV
+
+struct RGBKernelSSE2 {
+    RGBKernelSSE2(const ColorConverter::Coeffs &matrix, int16_t max)
+        // _mm_madd_epi16() of (y, 1) pairs
+        : mY(_mm_set1_epi32((128 << 16) | (uint16_t)matrix._y)),
+          // _mm_madd_epi16() of (u, v) pairs
+          mBU(_mm_set1_epi32((uint16_t)matrix._b_u)),
+          mRV(_mm_set1_epi32((uint32_t)(uint16_t)matrix._r_v << 16)),
+          mG(_mm_set1_epi32(((uint32_t)(uint16_t)-matrix._g_v << 16)
+                  | (uint16_t)-matrix._g_u)),
+          mMax(_mm_set1_epi16(max)) {
+    }
+
+    // Converts 8 pixels from their luma (minus the black level) and the chroma of
+    // the 4 pixel pairs, as interleaved (u, v) samples. Returns 16-bit R, G and B.
+    inline void convert(__m128i y, __m128i uv, __m128i *r, __m128i *g, __m128i *b) const {
+        const __m128i one = _mm_set1_epi16(1);
+        __m128i tmpLo = _mm_madd_epi16(_mm_unpacklo_epi16(y, one), mY);
+        __m128i tmpHi = _mm_madd_epi16(_mm_unpackhi_epi16(y, one), mY);
+        *r = addChroma(tmpLo, tmpHi, _mm_madd_epi16(uv, mRV));
+        *g = addChroma(tmpLo, tmpHi, _mm_madd_epi16(uv, mG));
+        *b = addChroma(tmpLo, tmpHi, _mm_madd_epi16(uv, mBU));
+    }
+
+private:
+    __m128i mY, mBU, mRV, mG, mMax;
+
+    inline __m128i addChroma(__m128i tmpLo, __m128i tmpHi, __m128i chroma) const {
+        __m128i lo = _mm_srai_epi32(_mm_add_epi32(tmpLo, _mm_unpacklo_epi32(chroma, chroma)), 8);
+        __m128i hi = _mm_srai_epi32(_mm_add_epi32(tmpHi, _mm_unpackhi_epi32(chroma, chroma)), 8);
+        return _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128()), mMax);
+    }
+};
+
+template <int DST_FORMAT>
+inline void storeRGB8(uint8_t *dst, __m128i r, __m128i g, __m128i b) {
+    if (DST_FORMAT == OMX_COLOR_Format16bitRGB565) {
+        __m128i rgb = _mm_or_si128(
+                _mm_or_si128(
+                        _mm_slli_epi16(_mm_and_si128(r, _mm_set1_epi16(0xF8)), 8),
+                        _mm_slli_epi16(_mm_and_si128(g, _mm_set1_epi16(0xFC)), 3)),
+                _mm_srli_epi16(b, 3));
+        _mm_storeu_si128((__m128i *)dst, rgb);
+    } else {
+        if (DST_FORMAT == OMX_COLOR_Format32bitBGRA8888) {
+            std::swap(r, b);
+        }
+        __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+        __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_set1_epi8((char)0xFF));
+        _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128((__m128i *)dst + 1, _mm_unpackhi_epi16(rg, ba));
+    }
+}
+
+template <int DST_FORMAT>
+size_t convertRowPlanar16ToRGB8(
+        const uint16_t *src_y, const uint16_t *src_u, const uint16_t *src_v,
+        uint8_t *dst, size_t width, const ColorConverter::Coeffs &matrix) {
+    const RGBKernelSSE2 kernel(matrix, 255);
+    const __m128i mask = _mm_set1_epi16(0xFF);
+    const __m128i c16 = _mm_set1_epi16(matrix._c16);
+    const __m128i c128 = _mm_set1_epi16(128);
+    const size_t bpp = DST_FORMAT == OMX_COLOR_Format16bitRGB565 ? 2 : 4;
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_loadu_si128((const __m128i *)(src_y + x));
+        __m128i u = _mm_loadl_epi64((const __m128i *)(src_u + x / 2));
+        __m128i v = _mm_loadl_epi64((const __m128i *)(src_v + x / 2));
+        y = _mm_sub_epi16(_mm_and_si128(_mm_srli_epi16(y, 2), mask), c16);
+        u = _mm_sub_epi16(_mm_and_si128(_mm_srli_epi16(u, 2), mask), c128);
+        v = _mm_sub_epi16(_mm_and_si128(_mm_srli_epi16(v, 2), mask), c128);
+
+        __m128i r, g, b;
+        kernel.convert(y, _mm_unpacklo_epi16(u, v), &r, &g, &b);
+        storeRGB8<DST_FORMAT>(dst + x * bpp, r, g, b);
+    }
+    return x;
+}
+
+size_t convertRowP010ToRGBA1010102(
+        const uint16_t *src_y, const uint16_t *src_uv,
+        uint32_t *dst, size_t width, const ColorConverter::Coeffs &matrix) {
+    const RGBKernelSSE2 kernel(matrix, 1023);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i c64 = _mm_set1_epi16(matrix._c16 * 4);
+    const __m128i c512 = _mm_set1_epi16(512);
+    const __m128i alpha = _mm_set1_epi32((int32_t)0xC0000000);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i y = _mm_sub_epi16(
+                _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src_y + x)), 6), c64);
+        __m128i uv = _mm_sub_epi16(
+                _mm_srli_epi16(_mm_loadu_si128((const __m128i *)(src_uv + x)), 6), c512);
+
+        __m128i r, g, b;
+        kernel.convert(y, uv, &r, &g, &b);
+        __m128i lo = _mm_or_si128(
+                _mm_or_si128(_mm_unpacklo_epi16(r, zero),
+                        _mm_slli_epi32(_mm_unpacklo_epi16(g, zero), 10)),
+                _mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(b, zero), 20), alpha));
+        __m128i hi = _mm_or_si128(
+                _mm_or_si128(_mm_unpackhi_epi16(r, zero),
+                        _mm_slli_epi32(_mm_unpackhi_epi16(g, zero), 10)),
+                _mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(b, zero), 20), alpha));
+        _mm_storeu_si128((__m128i *)(dst + x), lo);
+        _mm_storeu_si128((__m128i *)(dst + x + 4), hi);
+    }
+    return x;
+}
+
+// Converts two rows sharing a chroma row. Like the per-pixel loop, only the
+// samples at even positions of each 4-pixel block are masked to 10 bits.
+size_t convertRowsPlanar16ToY410(
+        const uint16_t *src_ytop, const uint16_t *src_ybot,
+        const uint16_t *src_u, const uint16_t *src_v,
+        uint32_t *dst_top, uint32_t *dst_bot, size_t width) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i mask = _mm_set1_epi32((int32_t)0xFFFF03FF);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i u = _mm_and_si128(_mm_loadl_epi64((const __m128i *)(src_u + x / 2)), mask);
+        __m128i v = _mm_and_si128(_mm_loadl_epi64((const __m128i *)(src_v + x / 2)), mask);
+        __m128i uv = _mm_or_si128(
+                _mm_unpacklo_epi16(u, zero), _mm_slli_epi32(_mm_unpacklo_epi16(v, zero), 20));
+        __m128i uvLo = _mm_unpacklo_epi32(uv, uv);
+        __m128i uvHi = _mm_unpackhi_epi32(uv, uv);
+
+        __m128i y = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src_ytop + x)), mask);
+        _mm_storeu_si128((__m128i *)(dst_top + x),
+                _mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(y, zero), 10), uvLo));
+        _mm_storeu_si128((__m128i *)(dst_top + x + 4),
+                _mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(y, zero), 10), uvHi));
+
+        y = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src_ybot + x)), mask);
+        _mm_storeu_si128((__m128i *)(dst_bot + x),
+                _mm_or_si128(_mm_slli_epi32(_mm_unpacklo_epi16(y, zero), 10), uvLo));
+        _mm_storeu_si128((__m128i *)(dst_bot + x + 4),
+                _mm_or_si128(_mm_slli_epi32(_mm_unpackhi_epi16(y, zero), 10), uvHi));
+    }
+    return x;
+}
+
+#elif USE_NEON_YUV
+
+struct RGBKernelNEON {
+    RGBKernelNEON(const ColorConverter::Coeffs &matrix, int16_t max)
+        : mY(matrix._y),
+          mBU(matrix._b_u),
+          mRV(matrix._r_v),
+          mNegGU(-matrix._g_u),
+          mNegGV(-matrix._g_v),
+          mMax(vdupq_n_s16(max)) {
+    }
+
+    // Converts 8 pixels from their luma (minus the black level) and the chroma of
+    // the 4 pixel pairs. Returns 16-bit R, G and B.
+    inline void convert(int16x8_t y, int16x4_t u, int16x4_t v,
+            int16x8_t *r, int16x8_t *g, int16x8_t *b) const {
+        int32x4_t tmpLo = vmlal_n_s16(vdupq_n_s32(128), vget_low_s16(y), mY);
+        int32x4_t tmpHi = vmlal_n_s16(vdupq_n_s32(128), vget_high_s16(y), mY);
+        *r = addChroma(tmpLo, tmpHi, vmull_n_s16(v, mRV));
+        *g = addChroma(tmpLo, tmpHi, vmlal_n_s16(vmull_n_s16(u, mNegGU), v, mNegGV));
+        *b = addChroma(tmpLo, tmpHi, vmull_n_s16(u, mBU));
+    }
+
+private:
+    int16_t mY, mBU, mRV, mNegGU, mNegGV;
+    int16x8_t mMax;
+
+    inline int16x8_t addChroma(int32x4_t tmpLo, int32x4_t tmpHi, int32x4_t chroma) const {
+        int32x4x2_t pairs = vzipq_s32(chroma, chroma);
+        int16x8_t rgb = vcombine_s16(
+                vqmovn_s32(vshrq_n_s32(vaddq_s32(tmpLo, pairs.val[0]), 8)),
+                vqmovn_s32(vshrq_n_s32(vaddq_s32(tmpHi, pairs.val[1]), 8)));
+        return vminq_s16(vmaxq_s16(rgb, vdupq_n_s16(0)), mMax);
+    }
+};
+
+template <int DST_FORMAT>
+inline void storeRGB8(uint8_t *dst, int16x8_t r, int16x8_t g, int16x8_t b) {
+    if (DST_FORMAT == OMX_COLOR_Format16bitRGB565) {
+        uint16x8_t r16 = vreinterpretq_u16_s16(r);
+        uint16x8_t g16 = vreinterpretq_u16_s16(g);
+        uint16x8_t b16 = vreinterpretq_u16_s16(b);
+        uint16x8_t rgb = vorrq_u16(
+                vorrq_u16(
+                        vshlq_n_u16(vandq_u16(r16, vdupq_n_u16(0xF8)), 8),
+                        vshlq_n_u16(vandq_u16(g16, vdupq_n_u16(0xFC)), 3)),
+                vshrq_n_u16(b16, 3));
+        vst1q_u16((uint16_t *)dst, rgb);
+    } else {
+        uint8x8x4_t rgba;
+        rgba.val[0] = vqmovun_s16(DST_FORMAT == OMX_COLOR_Format32bitBGRA8888 ? b : r);
+        rgba.val[1] = vqmovun_s16(g);
+        rgba.val[2] = vqmovun_s16(DST_FORMAT == OMX_COLOR_Format32bitBGRA8888 ? r : b);
+        rgba.val[3] = vdup_n_u8(0xFF);
+        vst4_u8(dst, rgba);
+    }
+}
+
+template <int DST_FORMAT>
+size_t convertRowPlanar16ToRGB8(
+        const uint16_t *src_y, const uint16_t *src_u, const uint16_t *src_v,
+        uint8_t *dst, size_t width, const ColorConverter::Coeffs &matrix) {
+    const RGBKernelNEON kernel(matrix, 255);
+    const size_t bpp = DST_FORMAT == OMX_COLOR_Format16bitRGB565 ? 2 : 4;
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t y = vandq_u16(vshrq_n_u16(vld1q_u16(src_y + x), 2), vdupq_n_u16(0xFF));
+        uint16x4_t u = vand_u16(vshr_n_u16(vld1_u16(src_u + x / 2), 2), vdup_n_u16(0xFF));
+        uint16x4_t v = vand_u16(vshr_n_u16(vld1_u16(src_v + x / 2), 2), vdup_n_u16(0xFF));
+
+        int16x8_t r, g, b;
+        kernel.convert(
+                vsubq_s16(vreinterpretq_s16_u16(y), vdupq_n_s16(matrix._c16)),
+                vsub_s16(vreinterpret_s16_u16(u), vdup_n_s16(128)),
+                vsub_s16(vreinterpret_s16_u16(v), vdup_n_s16(128)),
+                &r, &g, &b);
+        storeRGB8<DST_FORMAT>(dst + x * bpp, r, g, b);
+    }
+    return x;
+}
+
+size_t convertRowP010ToRGBA1010102(
+        const uint16_t *src_y, const uint16_t *src_uv,
+        uint32_t *dst, size_t width, const ColorConverter::Coeffs &matrix) {
+    const RGBKernelNEON kernel(matrix, 1023);
+    const uint32x4_t alpha = vdupq_n_u32(0xC0000000);
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t y = vshrq_n_u16(vld1q_u16(src_y + x), 6);
+        uint16x4x2_t uv = vld2_u16(src_uv + x);
+
+        int16x8_t r, g, b;
+        kernel.convert(
+                vsubq_s16(vreinterpretq_s16_u16(y), vdupq_n_s16(matrix._c16 * 4)),
+                vsub_s16(vreinterpret_s16_u16(vshr_n_u16(uv.val[0], 6)), vdup_n_s16(512)),
+                vsub_s16(vreinterpret_s16_u16(vshr_n_u16(uv.val[1], 6)), vdup_n_s16(512)),
+                &r, &g, &b);
+        uint16x8_t r16 = vreinterpretq_u16_s16(r);
+        uint16x8_t g16 = vreinterpretq_u16_s16(g);
+        uint16x8_t b16 = vreinterpretq_u16_s16(b);
+        uint32x4_t lo = vorrq_u32(
+                vorrq_u32(vmovl_u16(vget_low_u16(r16)), vshlq_n_u32(vmovl_u16(vget_low_u16(g16)), 10)),
+                vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(b16)), 20), alpha));
+        uint32x4_t hi = vorrq_u32(
+                vorrq_u32(vmovl_u16(vget_high_u16(r16)), vshlq_n_u32(vmovl_u16(vget_high_u16(g16)), 10)),
+                vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(b16)), 20), alpha));
+        vst1q_u32(dst + x, lo);
+        vst1q_u32(dst + x + 4, hi);
+    }
+    return x;
+}
+
+#else
+
+template <int DST_FORMAT>
+size_t convertRowPlanar16ToRGB8(
+        const uint16_t *, const uint16_t *, const uint16_t *,
+        uint8_t *, size_t, const ColorConverter::Coeffs &) {
+    return 0;
+}
+
+size_t convertRowP010ToRGBA1010102(
+        const uint16_t *, const uint16_t *, uint32_t *, size_t, const ColorConverter::Coeffs &) {
+    return 0;
+}
+
+#endif // USE_SSE2_YUV
+
+typedef size_t (*Planar16ToRGB8Func)(
+        const uint16_t *, const uint16_t *, const uint16_t *,
+        uint8_t *, size_t, const ColorConverter::Coeffs &);
+
+// Returns the row kernel converting OMX_COLOR_FormatYUV420Planar16 to |dstFormat|.
+Planar16ToRGB8Func getPlanar16ToRGB8Func(OMX_COLOR_FORMATTYPE dstFormat) {
+    switch ((int)dstFormat) {
+    case OMX_COLOR_Format16bitRGB565:
+        return convertRowPlanar16ToRGB8<OMX_COLOR_Format16bitRGB565>;
+    case OMX_COLOR_Format32BitRGBA8888:
+        return convertRowPlanar16ToRGB8<OMX_COLOR_Format32BitRGBA8888>;
+    case OMX_COLOR_Format32bitBGRA8888:
+        return convertRowPlanar16ToRGB8<OMX_COLOR_Format32bitBGRA8888>;
+    default:
+        return nullptr;
+    }
+}
+
 }
 
 ColorConverter::ColorConverter(
@@ -464,16 +788,39 @@ ColorConverter::ColorConverter(
       mDstFormat(to),
       mSrcColorSpace({0, 0, 0}),
       mClip(NULL),
-      mClip10Bit(NULL) {
+      mClip10Bit(NULL),
+      mNumThreads(1),
+      mSharedPool(nullptr),
+      mUseRowKernels(true) {
 }
 
 ColorConverter::~ColorConverter() {
+    mBandPool.reset();
     delete[] mClip;
     mClip = NULL;
     delete[] mClip10Bit;
     mClip10Bit = NULL;
 }
 
+void ColorConverter::setNumThreads(size_t numThreads) {
+    numThreads = std::max(numThreads, (size_t)1);
+    mSharedPool = nullptr;
+    if (numThreads != mNumThreads) {
+        mBandPool.reset();
+        mNumThreads = numThreads;
+    }
+}
+
+void ColorConverter::setWorkerPool(mediautils::WorkerPool *pool) {
+    mBandPool.reset();
+    mSharedPool = pool;
+    mNumThreads = (pool != nullptr) ? pool->numWorkers() + 1 : 1;
+}
+
+void ColorConverter::setUseRowKernels(bool useRowKernels) {
+    mUseRowKernels = useRowKernels;
+}
+
 // Set MediaImage2 Flexible formats
 void ColorConverter::setSrcMediaImage2(MediaImage2 img) {
     mSrcImage = Image(img);
@@ -667,10 +1014,10 @@ status_t ColorConverter::convert(
 #if PERF_PROFILING
     int64_t startTimeUs = ALooper::GetNowUs();
 #endif
-    status_t err;
+    ConvertFunc func = nullptr;
     switch ((int32_t)mSrcFormat) {
         case COLOR_FormatYUV420Flexible:
-            err = convertYUVMediaImage(src, dst);
+            func = &ColorConverter::convertYUVMediaImage;
             break;
 
         case OMX_COLOR_FormatYUV420Planar:
@@ -678,21 +1025,21 @@ status_t ColorConverter::convert(
                 mSrcImage = Image(CreateYUV420PlanarMediaImage2(
                         srcWidth, srcHeight, srcStride, srcHeight, 8 /*bitDepth*/));
             }
-            err = convertYUVMediaImage(src, dst);
+            func = &ColorConverter::convertYUVMediaImage;
 
             break;
 
         case OMX_COLOR_FormatYUV420Planar16:
-            err = convertYUV420Planar16(src, dst);
+            func = &ColorConverter::convertYUV420Planar16;
             break;
 
         case COLOR_FormatYUVP010:
-            err = convertYUVP010(src, dst);
+            func = &ColorConverter::convertYUVP010;
 
             break;
 
         case OMX_COLOR_FormatCbYCrY:
-            err = convertCbYCrY(src, dst);
+            func = &ColorConverter::convertCbYCrY;
             break;
 
         case OMX_QCOM_COLOR_FormatYVU420SemiPlanar:
@@ -700,7 +1047,7 @@ status_t ColorConverter::convert(
                 mSrcImage = Image(CreateYUV420SemiPlanarMediaImage2(
                     srcWidth, srcHeight, srcStride, srcHeight, 8 /*bitDepth*/, false));
             }
-            err = convertYUVMediaImage(src, dst);
+            func = &ColorConverter::convertYUVMediaImage;
 
             break;
 
@@ -710,7 +1057,7 @@ status_t ColorConverter::convert(
                 mSrcImage = Image(CreateYUV420SemiPlanarMediaImage2(
                     srcWidth, srcHeight, srcStride, srcHeight, 8 /*bitDepth*/));
             }
-            err = convertYUVMediaImage(src, dst);
+            func = &ColorConverter::convertYUVMediaImage;
 
             break;
 
@@ -720,6 +1067,13 @@ status_t ColorConverter::convert(
             break;
     }
 
+    status_t err;
+    if (mNumThreads > 1 && src.cropHeight() >= 2 * kMinRowsPerBand) {
+        err = convertInBands(func, src, dst);
+    } else {
+        err = (this->*func)(src, dst);
+    }
+
 #if PERF_PROFILING
     int64_t endTimeUs = ALooper::GetNowUs();
     ALOGD("%s image took %lld us", asString_ColorFormat(mSrcFormat,"Unknown"),
@@ -729,6 +1083,51 @@ status_t ColorConverter::convert(
     return err;
 }
 
+status_t ColorConverter::convertInBands(
+        ConvertFunc func, const BitmapParams &src, const BitmapParams &dst) {
+    // Bands start an even number of rows apart, so each one starts at the same
+    // position within a chroma row pair as the full frame does.
+    const size_t height = src.cropHeight();
+    const size_t numBands = std::min(mNumThreads, height / kMinRowsPerBand);
+    const size_t rowsPerBand = ((height + numBands - 1) / numBands + 1) & ~(size_t)1;
+
+    // The clip tables are set up lazily; do it before the bands race for them.
+    initClip();
+    initClip10Bit();
+
+    mediautils::WorkerPool *pool = mSharedPool;
+    if (pool == nullptr) {
+        if (mBandPool == nullptr) {
+            // the calling thread converts bands too
+            mBandPool.reset(new mediautils::WorkerPool(mNumThreads - 1, "ColorConverter"));
+        }
+        pool = mBandPool.get();
+    }
+
+    std::vector<status_t> results(numBands, OK);
+    pool->run(numBands, [&](size_t band) {
+        const size_t top = band * rowsPerBand;
+        if (top >= height) {
+            return;
+        }
+        const size_t rows = std::min(rowsPerBand, height - top);
+        BitmapParams srcBand = src;
+        srcBand.mCropTop = src.mCropTop + top;
+        srcBand.mCropBottom = srcBand.mCropTop + rows - 1;
+        BitmapParams dstBand = dst;
+        dstBand.mCropTop = dst.mCropTop + top;
+        dstBand.mCropBottom = dstBand.mCropTop + rows - 1;
+        results[band] = (this->*func)(srcBand, dstBand);
+    });
+
+    for (status_t result : results) {
+        if (result != OK) {
+            return result;
+        }
+    }
+    return OK;
+}
+
 const struct ColorConverter::Coeffs *ColorConverter::getMatrix() const {
     const bool isFullRange = mSrcColorSpace.mRange == ColorUtils::kColorRangeFull;
     const bool is10Bit = (mSrcFormat == COLOR_FormatYUVP010
@@ -1395,6 +1794,8 @@ status_t ColorConverter::convertYUV420Planar16(
 
     auto readFromSrc = getReadFromChromaHorizSubsampled2Image8b(std::nullopt, mSrcFormat);
     auto writeToDst = getWriteToDst(mDstFormat, (void *)kAdjustedClip);
+    Planar16ToRGB8Func convertRow =
+            mUseRowKernels ? getPlanar16ToRGB8Func(mDstFormat) : nullptr;
 
     uint8_t *dst_ptr = (uint8_t *)dst.mBits
             + dst.mCropTop * dst.mStride + dst.mCropLeft * dst.mBpp;
@@ -1408,7 +1809,12 @@ status_t ColorConverter::convertYUV420Planar16(
     uint8_t *src_v = src_u + (src.mStride / 2) * (src.mHeight / 2);
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+        size_t x = 0;
+        if (convertRow != nullptr) {
+            x = convertRow((const uint16_t *)src_y, (const uint16_t *)src_u,
+                    (const uint16_t *)src_v, dst_ptr, src.cropWidth(), *matrix);
+        }
+        for (; x < src.cropWidth(); x += 2) {
             signed y1, y2, u, v;
             readFromSrc(src_y, src_u, src_v, x, &y1, &y2, &u, &v);
 
@@ -1482,7 +1888,12 @@ status_t ColorConverter::convertYUVP010ToRGBA1010102(
             + (src.mCropTop / 2) * src.mStride + src.mCropLeft * src.mBpp);
 
     for (size_t y = 0; y < src.cropHeight(); ++y) {
-        for (size_t x = 0; x < src.cropWidth(); x += 2) {
+        size_t x = 0;
+        if (mUseRowKernels) {
+            x = convertRowP010ToRGBA1010102(
+                    src_y, src_uv, (uint32_t *)dst_ptr, src.cropWidth(), *matrix);
+        }
+        for (; x < src.cropWidth(); x += 2) {
             signed y1, y2, u, v;
             y1 = (src_y[x] >> 6) - _c64;
             y2 = (src_y[x + 1] >> 6) - _c64;
@@ -1550,6 +1961,18 @@ status_t ColorConverter::convertYUV420Planar16ToY410(
 
         uint32_t u01, v01, y01, y23, y45, y67, uv0, uv1;
         size_t x = 0;
+#if USE_SSE2_YUV
+        if (mUseRowKernels) {
+            x = convertRowsPlanar16ToY410(
+                    ptr_ytop, ptr_ybot, ptr_u, ptr_v, dst_top, dst_bot, src.cropWidth());
+            ptr_ytop += x;
+            ptr_ybot += x;
+            ptr_u += x / 2;
+            ptr_v += x / 2;
+            dst_top += x;
+            dst_bot += x;
+        }
+#endif
         // x % 4 is always 0 so x + 3 will never overflow.
         for (; x + 3 < src.cropWidth(); x += 4) {
             u01 = *((uint32_t*)ptr_u); ptr_u += 2;
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaCodecConstants.h>
+#include <media/stagefright/foundation/ColorUtils.h>
+
+using namespace android;
+
+/*
+ * Measures ColorConverter::convert() of a 1080p and a 4K frame for each
+ * source/destination format pair the converter supports, on 1, 2 and 4 threads.
+ */
+
+namespace {
+
+struct Format {
+    OMX_COLOR_FORMATTYPE format;
+    const char *name;
+};
+
+const Format kSrcFormats[] = {
+    { OMX_COLOR_FormatYUV420Planar, "YUV420Planar" },
+    { OMX_COLOR_FormatYUV420SemiPlanar, "YUV420SemiPlanar" },
+    { OMX_QCOM_COLOR_FormatYVU420SemiPlanar, "YVU420SemiPlanar" },
+    { OMX_COLOR_FormatYUV420Planar16, "YUV420Planar16" },
+    { (OMX_COLOR_FORMATTYPE)COLOR_FormatYUVP010, "P010" },
+    { OMX_COLOR_FormatCbYCrY, "CbYCrY" },
+};
+
+const Format kDstFormats[] = {
+    { OMX_COLOR_Format16bitRGB565, "RGB565" },
+    { OMX_COLOR_Format32BitRGBA8888, "RGBA8888" },
+    { OMX_COLOR_Format32bitBGRA8888, "BGRA8888" },
+    { (OMX_COLOR_FORMATTYPE)COLOR_Format32bitABGR2101010, "RGBA1010102" },
+    { OMX_COLOR_FormatYUV444Y410, "Y410" },
+};
+
+// Large enough for any of the source and destination formats above.
+constexpr size_t kMaxBytesPerPixel = 4;
+
+}  // namespace
+
+static void BM_ColorConvert(benchmark::State& state,
+        OMX_COLOR_FORMATTYPE srcFormat, OMX_COLOR_FORMATTYPE dstFormat) {
+    const size_t width = state.range(0);
+    const size_t height = state.range(1);
+
+    ColorConverter converter(srcFormat, dstFormat);
+    converter.setSrcColorSpace(
+            ColorUtils::kColorStandardBT709, ColorUtils::kColorRangeLimited, 0 /* transfer */);
+    converter.setNumThreads(state.range(2));
+
+    std::vector<uint8_t> src(width * height * kMaxBytesPerPixel);
+    srand(1);
+    for (size_t i = 0; i < src.size(); i += 2) {
+        // 10-bit samples, both LSB aligned (YUV420Planar16) and MSB aligned (P010)
+        // land in range for the 8-bit formats too.
+        const uint16_t sample = (rand() & 0x3ff) << (srcFormat == COLOR_FormatYUVP010 ? 6 : 0);
+        src[i] = sample;
+        src[i + 1] = sample >> 8;
+    }
+    std::vector<uint8_t> dst(width * height * kMaxBytesPerPixel);
+
+    for (auto _ : state) {
+        status_t err = converter.convert(
+                src.data(), width, height, 0 /* stride */,
+                0, 0, width - 1, height - 1,
+                dst.data(), width, height, 0 /* stride */,
+                0, 0, width - 1, height - 1);
+        if (err != OK) {
+            state.SkipWithError("convert() failed");
+            break;
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * width * height);
+}
+
+static void ColorConvertArgs(benchmark::internal::Benchmark* b) {
+    for (int threads : {1, 2, 4}) {
+        b->Args({1920, 1080, threads});
+        b->Args({3840, 2160, threads});
+    }
+}
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    for (const Format &src : kSrcFormats) {
+        for (const Format &dst : kDstFormats) {
+            if (!ColorConverter(src.format, dst.format).isValid()) {
+                continue;
+            }
+            std::string name = std::string("BM_ColorConvert/") + src.name + "/" + dst.name;
+            benchmark::RegisterBenchmark(name.c_str(), BM_ColorConvert, src.format, dst.format)
+                    ->Apply(ColorConvertArgs)->ArgNames({"width", "height", "threads"})
+                    ->Unit(benchmark::kMillisecond)->UseRealTime();
+        }
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ColorConverter_test"
+
+#include <ostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/stagefright/ColorConverter.h>
+#include <media/stagefright/MediaCodecConstants.h>
+#include <media/stagefright/foundation/ColorUtils.h>
+#include <mediautils/WorkerPool.h>
+
+namespace android {
+
+namespace {
+
+struct Format {
+    OMX_COLOR_FORMATTYPE format;
+    const char *name;
+};
+
+void PrintTo(const Format &format, std::ostream *os) {
+    *os << format.name;
+}
+
+const Format kSrcFormats[] = {
+    { OMX_COLOR_FormatYUV420Planar, "YUV420Planar" },
+    { OMX_COLOR_FormatYUV420SemiPlanar, "YUV420SemiPlanar" },
+    { OMX_QCOM_COLOR_FormatYVU420SemiPlanar, "YVU420SemiPlanar" },
+    { OMX_COLOR_FormatYUV420Planar16, "YUV420Planar16" },
+    { (OMX_COLOR_FORMATTYPE)COLOR_FormatYUVP010, "P010" },
+    { OMX_COLOR_FormatCbYCrY, "CbYCrY" },
+};
+
+const Format kDstFormats[] = {
+    { OMX_COLOR_Format16bitRGB565, "RGB565" },
+    { OMX_COLOR_Format32BitRGBA8888, "RGBA8888" },
+    { OMX_COLOR_Format32bitBGRA8888, "BGRA8888" },
+    { (OMX_COLOR_FORMATTYPE)COLOR_Format32bitABGR2101010, "RGBA1010102" },
+    { OMX_COLOR_FormatYUV444Y410, "Y410" },
+};
+
+// Large enough for any of the source and destination formats above.
+constexpr size_t kMaxBytesPerPixel = 4;
+
+struct Geometry {
+    size_t width;
+    size_t height;
+    size_t cropLeft;
+    size_t cropTop;
+    size_t cropRight;
+    size_t cropBottom;
+};
+
+// Tall enough to be split into bands. The crops start on odd rows and have widths that
+// are not a multiple of the 8 pixels the row kernels convert at a time.
+const Geometry kGeometries[] = {
+    { 320, 256, 0, 0, 319, 255 },
+    { 646, 301, 4, 1, 641, 300 },
+    { 1000, 400, 10, 21, 989, 380 },
+};
+
+const uint32_t kStandards[] = {
+    ColorUtils::kColorStandardBT601_625,
+    ColorUtils::kColorStandardBT709,
+    ColorUtils::kColorStandardBT2020,
+};
+
+const uint32_t kRanges[] = {
+    ColorUtils::kColorRangeFull,
+    ColorUtils::kColorRangeLimited,
+};
+
+}  // namespace
+
+class ColorConverterTest : public ::testing::TestWithParam<std::tuple<Format, Format>> {
+protected:
+    void SetUp() override {
+        mSrcFormat = std::get<0>(GetParam()).format;
+        mDstFormat = std::get<1>(GetParam()).format;
+        if (!ColorConverter(mSrcFormat, mDstFormat).isValid()) {
+            GTEST_SKIP() << "conversion not supported";
+        }
+    }
+
+    // Converts |src| into the middle of a destination larger than the crop, so that
+    // writes outside of the crop rectangle show up as differences. Bands run on |pool|
+    // if it is set.
+    std::vector<uint8_t> convert(const std::vector<uint8_t> &src, const Geometry &geometry,
+            uint32_t standard, uint32_t range, size_t numThreads, bool useRowKernels,
+            mediautils::WorkerPool *pool = nullptr) {
+        ColorConverter converter(mSrcFormat, mDstFormat);
+        converter.setSrcColorSpace(standard, range, 0 /* transfer */);
+        if (pool != nullptr) {
+            converter.setWorkerPool(pool);
+        } else {
+            converter.setNumThreads(numThreads);
+        }
+        converter.setUseRowKernels(useRowKernels);
+
+        const size_t cropWidth = geometry.cropRight - geometry.cropLeft + 1;
+        const size_t cropHeight = geometry.cropBottom - geometry.cropTop + 1;
+        const size_t dstWidth = cropWidth + 4;
+        const size_t dstHeight = cropHeight + 4;
+        std::vector<uint8_t> dst(dstWidth * dstHeight * kMaxBytesPerPixel, 0x5a);
+        EXPECT_EQ(OK, converter.convert(
+                src.data(), geometry.width, geometry.height, 0 /* stride */,
+                geometry.cropLeft, geometry.cropTop, geometry.cropRight, geometry.cropBottom,
+                dst.data(), dstWidth, dstHeight, 0 /* stride */,
+                2, 2, cropWidth + 1, cropHeight + 1));
+        return dst;
+    }
+
+    OMX_COLOR_FORMATTYPE mSrcFormat;
+    OMX_COLOR_FORMATTYPE mDstFormat;
+};
+
+// Converting in bands on several threads, or with the SSE2/NEON row kernels, gives the
+// same output as converting the whole frame on one thread with the per-pixel code.
+TEST_P(ColorConverterTest, MatchesSingleThreadPerPixelConversion) {
+    std::mt19937 rng(42);
+    // shared by the converters, as FrameDecoder does for the frames it converts
+    mediautils::WorkerPool pool(2, "ColorConverter");
+    for (const Geometry &geometry : kGeometries) {
+        // random samples, including 16-bit values outside of the 10-bit range
+        std::vector<uint8_t> src(geometry.width * geometry.height * kMaxBytesPerPixel);
+        for (uint8_t &byte : src) {
+            byte = rng();
+        }
+        for (uint32_t standard : kStandards) {
+            for (uint32_t range : kRanges) {
+                SCOPED_TRACE(::testing::Message() << geometry.width << "x" << geometry.height
+                        << " standard " << standard << " range " << range);
+                const std::vector<uint8_t> expected =
+                        convert(src, geometry, standard, range, 1, false /* useRowKernels */);
+                EXPECT_EQ(expected, convert(src, geometry, standard, range, 1, true))
+                        << "row kernels";
+                EXPECT_EQ(expected, convert(src, geometry, standard, range, 3, false))
+                        << "3 bands";
+                EXPECT_EQ(expected, convert(src, geometry, standard, range, 4, true))
+                        << "4 bands with row kernels";
+                EXPECT_EQ(expected, convert(src, geometry, standard, range, 0, true, &pool))
+                        << "3 bands on a shared pool";
+            }
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        ColorConverter, ColorConverterTest,
+        ::testing::Combine(::testing::ValuesIn(kSrcFormats), ::testing::ValuesIn(kDstFormats)),
+        [](const ::testing::TestParamInfo<ColorConverterTest::ParamType> &info) {
+            return std::string(std::get<0>(info.param).name) + "_to_"
+                    + std::get<1>(info.param).name;
+        });
+
+}  // namespace android
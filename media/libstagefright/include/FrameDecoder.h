@@ -39,6 +39,10 @@ class Surface;
 class VideoFrame;
 struct AsyncCodecHandler;
 
+namespace mediautils {
+class WorkerPool;
+}
+
 struct FrameRect {
     int32_t left, top, right, bottom;
 };
@@ -106,6 +110,9 @@ protected:
     ui::PixelFormat captureFormat() const   { return mCaptureFormat; }
     int32_t dstBpp()             const      { return mDstBpp; }
     void setFrame(const sp<IMemory> &frameMem) { mFrameMemory = frameMem; }
+    // The threads that color convert the frames of this decoder, started on
+    // first use and kept until the decoder is destroyed.
+    mediautils::WorkerPool *colorConversionPool();
 
 private:
     sp<MetaData> mTrackMeta;
@@ -126,6 +133,7 @@ private:
     std::mutex mMutex;
     std::condition_variable mOutputFramePending;
     InputBufferIndexQueue mInputBufferIndexQueue;
+    std::unique_ptr<mediautils::WorkerPool> mColorConversionPool;
 
     status_t extractInternal();
     status_t extractInternalUsingBlockModel();
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <utils/Errors.h>
 
+#include <memory>
 #include <optional>
 
 #include <OMX_Video.h>
@@ -30,6 +31,10 @@
 
 namespace android {
 
+namespace mediautils {
+class WorkerPool;
+}
+
 struct ColorConverter {
     ColorConverter(OMX_COLOR_FORMATTYPE from, OMX_COLOR_FORMATTYPE to);
     ~ColorConverter();
@@ -42,6 +47,23 @@ struct ColorConverter {
 
     void setSrcColorSpace(uint32_t standard, uint32_t range, uint32_t transfer);
 
+    // Sets the number of threads convert() may use, including the calling
+    // thread. With more than one, frames are split into bands of rows that are
+    // converted in parallel by a pool of worker threads owned by this
+    // converter. The default is 1 (convert on the calling thread only).
+    void setNumThreads(size_t numThreads);
+
+    // Converts bands on |pool| instead of on a pool owned by this converter,
+    // using its workers and the calling thread. The caller keeps |pool| alive
+    // while converting, and does not convert on it from two threads at once.
+    // Lets a caller converting many frames keep one set of threads.
+    void setWorkerPool(mediautils::WorkerPool *pool);
+
+    // Sets whether the SSE2 or NEON row kernels may be used for the conversions
+    // that libyuv does not handle. The default is true; tests turn them off to
+    // compare against the per-pixel code.
+    void setUseRowKernels(bool useRowKernels);
+
     status_t convert(
             const void *srcBits,
             size_t srcWidth, size_t srcHeight, size_t srcStride,
@@ -100,6 +122,9 @@ private:
 
     struct BitmapParams;
 
+    typedef status_t (ColorConverter::*ConvertFunc)(
+            const BitmapParams &src, const BitmapParams &dst);
+
 
     class Image {
     public:
@@ -166,6 +191,10 @@ private:
     ColorSpace mSrcColorSpace;
     uint8_t *mClip;
     uint16_t *mClip10Bit;
+    size_t mNumThreads;
+    std::unique_ptr<mediautils::WorkerPool> mBandPool;
+    mediautils::WorkerPool *mSharedPool;
+    bool mUseRowKernels;
 
     uint8_t *initClip();
     uint16_t *initClip10Bit();
@@ -183,6 +212,10 @@ private:
             size_t *u_stride,
             size_t *v_stride) const;
 
+    // runs |func| over bands of rows of the crop rectangle on mBandPool
+    status_t convertInBands(
+            ConvertFunc func, const BitmapParams &src, const BitmapParams &dst);
+
     status_t convertYUVMediaImage(
         const BitmapParams &src, const BitmapParams &dst);
 
@@ -381,6 +381,7 @@ private:
 
     struct typed_data;
     struct Rect;
+    struct ItemStore;
     struct MetaDataInternal;
     MetaDataInternal *mInternalData;
 #ifndef __ANDROID_VNDK__
@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <limits>
 
 #include "SampleTable.h"
@@ -128,7 +129,16 @@ SampleTable::SampleTable(DataSourceHelper *source)
       mHasTimeToSample(false),
       mTimeToSampleCount(0),
       mTimeToSample(NULL),
-      mSampleTimeEntries(NULL),
+      mSampleTimeBlocks(NULL),
+      mNumSampleTimeBlocks(0),
+      mNumTimedSamples(0),
+      mSampleTimesMonotonic(true),
+      mDecodedTimes(NULL),
+      mNextDecodedTimeBlock(0),
+      mSampleSizeBlockStart(0),
+      mSampleSizeBlockCount(0),
+      mChunkOffsetBlockStart(0),
+      mChunkOffsetBlockCount(0),
       mCompositionTimeDeltaEntries(NULL),
       mNumCompositionTimeDeltaEntries(0),
       mCompositionDeltaLookup(new CompositionDeltaLookup),
@@ -138,6 +148,9 @@ SampleTable::SampleTable(DataSourceHelper *source)
       mLastSyncSampleIndex(0),
       mSampleToChunkEntries(NULL),
       mTotalSize(0) {
+    for (uint32_t i = 0; i < kNumDecodedTimeBlocks; ++i) {
+        mDecodedTimeBlocks[i] = UINT32_MAX;
+    }
     mSampleIterator = new SampleIterator(this);
 }
 
@@ -157,8 +170,11 @@ SampleTable::~SampleTable() {
     delete[] mCompositionTimeDeltaEntries;
     mCompositionTimeDeltaEntries = NULL;
 
-    delete[] mSampleTimeEntries;
-    mSampleTimeEntries = NULL;
+    delete[] mSampleTimeBlocks;
+    mSampleTimeBlocks = NULL;
+
+    delete[] mDecodedTimes;
+    mDecodedTimes = NULL;
 
     delete mSampleIterator;
     mSampleIterator = NULL;
@@ -615,111 +631,247 @@ uint32_t abs_difference(uint64_t time1, uint64_t time2) {
     return time1 > time2 ? time1 - time2 : time2 - time1;
 }
 
-// static
-int SampleTable::CompareIncreasingTime(const void *_a, const void *_b) {
-    const SampleTimeEntry *a = (const SampleTimeEntry *)_a;
-    const SampleTimeEntry *b = (const SampleTimeEntry *)_b;
+// Returns the composition time of the sample at |cursor| and advances it to the
+// next sample.
+uint64_t SampleTable::nextSampleTime(SampleTimeCursor *cursor) const {
+    uint32_t sampleIndex = cursor->mSampleIndex++;
 
-    if (a->mCompositionTime < b->mCompositionTime) {
-        return -1;
-    } else if (a->mCompositionTime > b->mCompositionTime) {
-        return 1;
+    while (cursor->mTimeToSampleIndex < mTimeToSampleCount
+            && sampleIndex >= cursor->mTimeToSampleStart
+                    + mTimeToSample[2 * cursor->mTimeToSampleIndex]) {
+        cursor->mTimeToSampleStart += mTimeToSample[2 * cursor->mTimeToSampleIndex];
+        ++cursor->mTimeToSampleIndex;
     }
 
-    return 0;
+    if (cursor->mTimeToSampleIndex == mTimeToSampleCount) {
+        // Technically this should never be the case if the file
+        // is well-formed, but you know... there's (gasp) malformed
+        // content out there.
+        return 0;
+    }
+
+    uint32_t delta = mTimeToSample[2 * cursor->mTimeToSampleIndex + 1];
+
+    int32_t compTimeDelta = 0;
+    if (mCompositionTimeDeltaEntries != NULL) {
+        while (cursor->mCompositionDeltaIndex < mNumCompositionTimeDeltaEntries
+                && sampleIndex >= cursor->mCompositionDeltaStart
+                        + (uint32_t)mCompositionTimeDeltaEntries[
+                                2 * cursor->mCompositionDeltaIndex]) {
+            cursor->mCompositionDeltaStart +=
+                    (uint32_t)mCompositionTimeDeltaEntries[2 * cursor->mCompositionDeltaIndex];
+            ++cursor->mCompositionDeltaIndex;
+        }
+        if (cursor->mCompositionDeltaIndex < mNumCompositionTimeDeltaEntries) {
+            compTimeDelta =
+                    mCompositionTimeDeltaEntries[2 * cursor->mCompositionDeltaIndex + 1];
+        }
+    }
+
+    uint64_t sampleTime = cursor->mDecodeTime;
+    if ((compTimeDelta < 0 && sampleTime < (uint64_t)(-(int64_t)compTimeDelta))
+            || (compTimeDelta > 0 &&
+                    sampleTime > UINT64_MAX - compTimeDelta)) {
+        ALOGV("%llu + %d would overflow, clamping",
+                (unsigned long long) sampleTime, compTimeDelta);
+        if (compTimeDelta < 0) {
+            sampleTime = 0;
+        } else {
+            sampleTime = UINT64_MAX;
+        }
+        compTimeDelta = 0;
+    }
+
+    uint64_t compositionTime = compTimeDelta > 0 ? sampleTime + compTimeDelta :
+            sampleTime - (uint64_t)(-(int64_t)compTimeDelta);
+
+    if (sampleTime > UINT64_MAX - delta) {
+        ALOGV("%llu + %u would overflow, clamping",
+            (unsigned long long) sampleTime, delta);
+        sampleTime = UINT64_MAX;
+    } else {
+        sampleTime += delta;
+    }
+    cursor->mDecodeTime = sampleTime;
+
+    return compositionTime;
 }
 
-void SampleTable::buildSampleEntriesTable() {
-    Mutex::Autolock autoLock(mLock);
+uint32_t SampleTable::numSamplesInTimeBlock(uint32_t block) const {
+    uint32_t firstSample = block * kSampleTimeBlockSize;
+    return std::min(kSampleTimeBlockSize, mNumSampleSizes - firstSample);
+}
 
-    if (mSampleTimeEntries != NULL || mNumSampleSizes == 0) {
+void SampleTable::buildSampleTimeIndex_l() {
+    if (mSampleTimeBlocks != NULL || mNumSampleSizes == 0) {
         if (mNumSampleSizes == 0) {
             ALOGE("b/23247055, mNumSampleSizes(%u)", mNumSampleSizes);
         }
         return;
     }
 
-    mTotalSize += (uint64_t)mNumSampleSizes * sizeof(SampleTimeEntry);
+    uint32_t numBlocks = (mNumSampleSizes - 1) / kSampleTimeBlockSize + 1;
+    uint64_t allocSize = (uint64_t)numBlocks * sizeof(SampleTimeBlock)
+            + kNumDecodedTimeBlocks * kSampleTimeBlockSize * sizeof(uint64_t);
+    mTotalSize += allocSize;
     if (mTotalSize > kMaxTotalSize) {
-        ALOGE("Sample entry table size would make sample table too large.\n"
-              "    Requested sample entry table size = %llu\n"
+        ALOGE("Sample time index size would make sample table too large.\n"
+              "    Requested sample time index size = %llu\n"
               "    Eventual sample table size >= %llu\n"
               "    Allowed sample table size = %llu\n",
-              (unsigned long long)mNumSampleSizes * sizeof(SampleTimeEntry),
+              (unsigned long long)allocSize,
               (unsigned long long)mTotalSize,
               (unsigned long long)kMaxTotalSize);
         return;
     }
 
-    mSampleTimeEntries = new (std::nothrow) SampleTimeEntry[mNumSampleSizes];
-
-    if (!mSampleTimeEntries) {
-        ALOGE("Cannot allocate sample entry table with %llu entries.",
-                (unsigned long long)mNumSampleSizes);
+    mSampleTimeBlocks = new (std::nothrow) SampleTimeBlock[numBlocks];
+    mDecodedTimes = new (std::nothrow) uint64_t[kNumDecodedTimeBlocks * kSampleTimeBlockSize];
+    if (!mSampleTimeBlocks || !mDecodedTimes) {
+        ALOGE("Cannot allocate sample time index with %u blocks.", numBlocks);
+        delete[] mSampleTimeBlocks;
+        mSampleTimeBlocks = NULL;
+        delete[] mDecodedTimes;
+        mDecodedTimes = NULL;
         return;
     }
-    memset(mSampleTimeEntries, 0, sizeof(SampleTimeEntry) * mNumSampleSizes);
-
-    uint32_t sampleIndex = 0;
-    uint64_t sampleTime = 0;
 
+    uint64_t numTimedSamples = 0;
     for (uint32_t i = 0; i < mTimeToSampleCount; ++i) {
-        uint32_t n = mTimeToSample[2 * i];
-        uint32_t delta = mTimeToSample[2 * i + 1];
-
-        for (uint32_t j = 0; j < n; ++j) {
-            if (sampleIndex < mNumSampleSizes) {
-                // Technically this should always be the case if the file
-                // is well-formed, but you know... there's (gasp) malformed
-                // content out there.
-
-                mSampleTimeEntries[sampleIndex].mSampleIndex = sampleIndex;
-
-                int32_t compTimeDelta =
-                    mCompositionDeltaLookup->getCompositionTimeOffset(
-                            sampleIndex);
-
-                if ((compTimeDelta < 0 && sampleTime <
-                        (compTimeDelta == INT32_MIN ?
-                                INT32_MAX : uint32_t(-compTimeDelta)))
-                        || (compTimeDelta > 0 &&
-                                sampleTime > UINT64_MAX - compTimeDelta)) {
-                    ALOGE("%llu + %d would overflow, clamping",
-                            (unsigned long long) sampleTime, compTimeDelta);
-                    if (compTimeDelta < 0) {
-                        sampleTime = 0;
-                    } else {
-                        sampleTime = UINT64_MAX;
-                    }
-                    compTimeDelta = 0;
-                }
+        numTimedSamples += mTimeToSample[2 * i];
+    }
+    mNumTimedSamples = std::min(numTimedSamples, (uint64_t)mNumSampleSizes);
+
+    // Compute the time of every sample once, but only keep the time range of
+    // each block.
+    SampleTimeCursor cursor = {};
+    uint64_t prevTime = 0;
+    for (uint32_t b = 0; b < numBlocks; ++b) {
+        SampleTimeBlock *block = &mSampleTimeBlocks[b];
+        block->mStart = cursor;
+
+        uint32_t numSamples = numSamplesInTimeBlock(b);
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            uint32_t sampleIndex = cursor.mSampleIndex;
+            uint64_t time = nextSampleTime(&cursor);
+
+            if (i == 0 || time < block->mMinTime) {
+                block->mMinTime = time;
+                block->mMinTimeSample = sampleIndex;
+            }
+            if (i == 0 || time > block->mMaxTime) {
+                block->mMaxTime = time;
+                block->mMaxTimeSample = sampleIndex;
+            }
+            if (sampleIndex > 0 && time < prevTime) {
+                mSampleTimesMonotonic = false;
+            }
+            prevTime = time;
+        }
+    }
+    mNumSampleTimeBlocks = numBlocks;
+}
+
+// Returns the composition times of the samples in |block|, decoding them if
+// they are not cached.
+const uint64_t *SampleTable::getSampleTimeBlock_l(uint32_t block) {
+    for (uint32_t i = 0; i < kNumDecodedTimeBlocks; ++i) {
+        if (mDecodedTimeBlocks[i] == block) {
+            return &mDecodedTimes[i * kSampleTimeBlockSize];
+        }
+    }
+
+    uint32_t slot = mNextDecodedTimeBlock;
+    mNextDecodedTimeBlock = (slot + 1) % kNumDecodedTimeBlocks;
+
+    uint64_t *times = &mDecodedTimes[slot * kSampleTimeBlockSize];
+    SampleTimeCursor cursor = mSampleTimeBlocks[block].mStart;
+    uint32_t numSamples = numSamplesInTimeBlock(block);
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        times[i] = nextSampleTime(&cursor);
+    }
+    mDecodedTimeBlocks[slot] = block;
 
-                mSampleTimeEntries[sampleIndex].mCompositionTime =
-                        compTimeDelta > 0 ? sampleTime + compTimeDelta:
-                                sampleTime - (-compTimeDelta);
+    return times;
+}
+
+uint64_t SampleTable::countSamplesAtMost_l(uint64_t time) {
+    uint64_t count = 0;
+    for (uint32_t b = 0; b < mNumSampleTimeBlocks; ++b) {
+        const SampleTimeBlock &block = mSampleTimeBlocks[b];
+        uint32_t numSamples = numSamplesInTimeBlock(b);
+        if (block.mMaxTime <= time) {
+            count += numSamples;
+        } else if (block.mMinTime <= time) {
+            const uint64_t *times = getSampleTimeBlock_l(b);
+            for (uint32_t i = 0; i < numSamples; ++i) {
+                if (times[i] <= time) {
+                    ++count;
+                }
             }
+        }
+    }
+    return count;
+}
 
-            ++sampleIndex;
-            if (sampleTime > UINT64_MAX - delta) {
-                ALOGE("%llu + %u would overflow, clamping",
-                    (unsigned long long) sampleTime, delta);
-                sampleTime = UINT64_MAX;
-            } else {
-                sampleTime += delta;
+// Finds the sample at position |rank| when all samples are ordered by
+// composition time.
+status_t SampleTable::findSampleByPresentationOrder_l(
+        uint32_t rank, uint32_t *sample_index) {
+    if (mSampleTimesMonotonic) {
+        *sample_index = timedSampleIndex(rank);
+        return OK;
+    }
+
+    // Find the time of that sample: the smallest time that more than |rank|
+    // samples do not exceed.
+    uint64_t low = UINT64_MAX;
+    uint64_t high = 0;
+    for (uint32_t b = 0; b < mNumSampleTimeBlocks; ++b) {
+        low = std::min(low, mSampleTimeBlocks[b].mMinTime);
+        high = std::max(high, mSampleTimeBlocks[b].mMaxTime);
+    }
+    while (low < high) {
+        uint64_t mid = low + (high - low) / 2;
+        if (countSamplesAtMost_l(mid) > rank) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    // Samples with the same time are ordered by sample index.
+    uint64_t skip = rank - (low > 0 ? countSamplesAtMost_l(low - 1) : 0);
+    for (uint32_t b = 0; b < mNumSampleTimeBlocks; ++b) {
+        const SampleTimeBlock &block = mSampleTimeBlocks[b];
+        if (low < block.mMinTime || low > block.mMaxTime) {
+            continue;
+        }
+        const uint64_t *times = getSampleTimeBlock_l(b);
+        uint32_t numSamples = numSamplesInTimeBlock(b);
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            if (times[i] != low) {
+                continue;
+            }
+            if (skip == 0) {
+                *sample_index = timedSampleIndex(b * kSampleTimeBlockSize + i);
+                return OK;
             }
+            --skip;
         }
     }
 
-    qsort(mSampleTimeEntries, mNumSampleSizes, sizeof(SampleTimeEntry),
-          CompareIncreasingTime);
+    return ERROR_OUT_OF_RANGE;
 }
 
 status_t SampleTable::findSampleAtTime(
         uint64_t req_time, uint64_t scale_num, uint64_t scale_den,
         uint32_t *sample_index, uint32_t flags) {
-    buildSampleEntriesTable();
+    Mutex::Autolock autoLock(mLock);
 
-    if (mSampleTimeEntries == NULL) {
+    buildSampleTimeIndex_l();
+
+    if (mSampleTimeBlocks == NULL) {
         return ERROR_OUT_OF_RANGE;
     }
 
@@ -727,35 +879,71 @@ status_t SampleTable::findSampleAtTime(
         if (req_time >= mNumSampleSizes) {
             return ERROR_OUT_OF_RANGE;
         }
-        *sample_index = mSampleTimeEntries[req_time].mSampleIndex;
-        return OK;
-    }
+        return findSampleByPresentationOrder_l(req_time, sample_index);
+    }
+
+    // Find a sample at exactly req_time, or else the latest sample before and
+    // the earliest sample after it. Only blocks whose time range contains
+    // req_time need to be decoded.
+    bool hasBefore = false;
+    bool hasAfter = false;
+    uint32_t beforeIndex = 0;
+    uint32_t afterIndex = 0;
+    uint64_t beforeTime = 0;
+    uint64_t afterTime = 0;
+
+    for (uint32_t b = 0; b < mNumSampleTimeBlocks; ++b) {
+        const SampleTimeBlock &block = mSampleTimeBlocks[b];
+        uint64_t minTime = scaleTime(block.mMinTime, scale_num, scale_den);
+        uint64_t maxTime = scaleTime(block.mMaxTime, scale_num, scale_den);
+
+        if (maxTime < req_time) {
+            if (!hasBefore || maxTime > beforeTime) {
+                hasBefore = true;
+                beforeTime = maxTime;
+                beforeIndex = block.mMaxTimeSample;
+            }
+            continue;
+        }
 
-    uint32_t left = 0;
-    uint32_t right_plus_one = mNumSampleSizes;
-    while (left < right_plus_one) {
-        uint32_t center = left + (right_plus_one - left) / 2;
-        uint64_t centerTime =
-            getSampleTime(center, scale_num, scale_den);
+        if (minTime > req_time) {
+            if (!hasAfter || minTime < afterTime) {
+                hasAfter = true;
+                afterTime = minTime;
+                afterIndex = block.mMinTimeSample;
+            }
+            continue;
+        }
 
-        if (req_time < centerTime) {
-            right_plus_one = center;
-        } else if (req_time > centerTime) {
-            left = center + 1;
-        } else {
-            *sample_index = mSampleTimeEntries[center].mSampleIndex;
-            return OK;
+        const uint64_t *times = getSampleTimeBlock_l(b);
+        uint32_t numSamples = numSamplesInTimeBlock(b);
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            uint32_t sampleIndex = b * kSampleTimeBlockSize + i;
+            uint64_t time = scaleTime(times[i], scale_num, scale_den);
+
+            if (time == req_time) {
+                *sample_index = timedSampleIndex(sampleIndex);
+                return OK;
+            } else if (time < req_time) {
+                if (!hasBefore || time > beforeTime) {
+                    hasBefore = true;
+                    beforeTime = time;
+                    beforeIndex = sampleIndex;
+                }
+            } else if (!hasAfter || time < afterTime) {
+                hasAfter = true;
+                afterTime = time;
+                afterIndex = sampleIndex;
+            }
         }
     }
 
-    uint32_t closestIndex = left;
-
-    if (closestIndex == mNumSampleSizes) {
+    if (!hasAfter) {
         if (flags == kFlagAfter) {
             return ERROR_OUT_OF_RANGE;
         }
         flags = kFlagBefore;
-    } else if (closestIndex == 0) {
+    } else if (!hasBefore) {
         if (flags == kFlagBefore) {
             // normally we should return out of range, but that is
             // treated as end-of-stream.  instead return first sample
@@ -765,16 +953,17 @@ status_t SampleTable::findSampleAtTime(
         flags = kFlagAfter;
     }
 
+    uint32_t closestIndex;
     switch (flags) {
         case kFlagBefore:
         {
-            --closestIndex;
+            closestIndex = beforeIndex;
             break;
         }
 
         case kFlagAfter:
         {
-            // nothing to do
+            closestIndex = afterIndex;
             break;
         }
 
@@ -782,17 +971,17 @@ status_t SampleTable::findSampleAtTime(
         {
             CHECK(flags == kFlagClosest);
             // pick closest based on timestamp. use abs_difference for safety
-            if (abs_difference(
-                    getSampleTime(closestIndex, scale_num, scale_den), req_time) >
-                abs_difference(
-                    req_time, getSampleTime(closestIndex - 1, scale_num, scale_den))) {
-                --closestIndex;
+            if (abs_difference(afterTime, req_time) >
+                abs_difference(req_time, beforeTime)) {
+                closestIndex = beforeIndex;
+            } else {
+                closestIndex = afterIndex;
             }
             break;
         }
     }
 
-    *sample_index = mSampleTimeEntries[closestIndex].mSampleIndex;
+    *sample_index = timedSampleIndex(closestIndex);
     return OK;
 }
 
@@ -945,6 +1134,94 @@ status_t SampleTable::getSampleSize_l(
             sampleIndex, sampleSize);
 }
 
+// Reads the sample size table one block at a time instead of with one read
+// per sample.
+status_t SampleTable::getSampleSizeFromBlock_l(
+        uint32_t sampleIndex, size_t *sampleSize) {
+    *sampleSize = 0;
+
+    if (sampleIndex < mSampleSizeBlockStart
+            || sampleIndex - mSampleSizeBlockStart >= mSampleSizeBlockCount) {
+        uint32_t start = sampleIndex - sampleIndex % kTableBlockEntries;
+        uint32_t count = std::min(kTableBlockEntries, mNumSampleSizes - start);
+        uint32_t fieldSize = mSampleSizeFieldSize;
+
+        ssize_t n = mDataSource->readAt(
+                mSampleSizeOffset + 12 + (off64_t)start * fieldSize / 8,
+                mSampleSizeBlock, ((size_t)count * fieldSize + 7) / 8);
+        uint32_t available =
+                n > 0 ? std::min((uint64_t)n * 8 / fieldSize, (uint64_t)count) : 0;
+
+        // Expand in place, starting from the last entry so that no entry is
+        // overwritten before it is read.
+        const uint8_t *data = (const uint8_t *)mSampleSizeBlock;
+        for (uint32_t j = available; j > 0; --j) {
+            uint32_t i = j - 1;
+            uint32_t size;
+            switch (fieldSize) {
+                case 32:
+                    size = U32_AT(&data[4 * i]);
+                    break;
+                case 16:
+                    size = U16_AT(&data[2 * i]);
+                    break;
+                case 8:
+                    size = data[i];
+                    break;
+                default:
+                    CHECK_EQ(fieldSize, 4u);
+                    size = (i & 1) ? data[i / 2] & 0x0f : data[i / 2] >> 4;
+                    break;
+            }
+            mSampleSizeBlock[i] = size;
+        }
+
+        mSampleSizeBlockStart = start;
+        mSampleSizeBlockCount = available;
+
+        if (sampleIndex - start >= available) {
+            return ERROR_IO;
+        }
+    }
+
+    *sampleSize = mSampleSizeBlock[sampleIndex - mSampleSizeBlockStart];
+    return OK;
+}
+
+// Reads the chunk offset table one block at a time.
+status_t SampleTable::getChunkOffsetFromBlock_l(uint32_t chunk, off64_t *offset) {
+    *offset = 0;
+
+    if (chunk < mChunkOffsetBlockStart
+            || chunk - mChunkOffsetBlockStart >= mChunkOffsetBlockCount) {
+        uint32_t start = chunk - chunk % kTableBlockEntries;
+        uint32_t count = std::min(kTableBlockEntries, mNumChunkOffsets - start);
+        size_t entrySize = (mChunkOffsetType == kChunkOffsetType32) ? 4 : 8;
+
+        ssize_t n = mDataSource->readAt(
+                mChunkOffsetOffset + 8 + (off64_t)start * entrySize,
+                mChunkOffsetBlock, count * entrySize);
+        uint32_t available = n > 0 ? std::min((size_t)n / entrySize, (size_t)count) : 0;
+
+        // 32-bit offsets are widened in place, so start from the last entry.
+        const uint8_t *data = (const uint8_t *)mChunkOffsetBlock;
+        for (uint32_t j = available; j > 0; --j) {
+            uint32_t i = j - 1;
+            mChunkOffsetBlock[i] = (entrySize == 4) ? U32_AT(&data[4 * i]) : U64_AT(&data[8 * i]);
+        }
+
+        mChunkOffsetBlockStart = start;
+        mChunkOffsetBlockCount = available;
+
+        if (chunk - start >= available) {
+            return ERROR_IO;
+        }
+    }
+
+    *offset = mChunkOffsetBlock[chunk - mChunkOffsetBlockStart];
+    return OK;
+}
+
 uint32_t SampleTable::getLastSampleIndexInChunk() {
     Mutex::Autolock autoLock(mLock);
     return mSampleIterator->getLastSampleIndexInChunk();
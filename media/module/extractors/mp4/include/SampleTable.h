@@ -107,6 +107,15 @@ private:
     // Limit the total size of all internal tables to 200MiB.
     static const size_t kMaxTotalSize = 200 * (1 << 20);
 
+    // Sample sizes and chunk offsets are read from the file in blocks of this
+    // many entries as they are needed.
+    static constexpr uint32_t kTableBlockEntries = 1024;
+
+    // The time index keeps one entry per this many samples in decode order.
+    static constexpr uint32_t kSampleTimeBlockSize = 1024;
+    // Number of blocks of composition times kept decoded.
+    static constexpr uint32_t kNumDecodedTimeBlocks = 4;
+
     DataSourceHelper *mDataSource;
     Mutex mLock;
 
@@ -126,11 +135,46 @@ private:
     uint32_t mTimeToSampleCount;
     uint32_t* mTimeToSample;
 
-    struct SampleTimeEntry {
+    // Position in the time-to-sample and composition offset tables, from which
+    // the composition times of consecutive samples are computed.
+    struct SampleTimeCursor {
         uint32_t mSampleIndex;
-        uint64_t mCompositionTime;
+        uint32_t mTimeToSampleIndex;
+        uint64_t mTimeToSampleStart;
+        uint64_t mDecodeTime;
+        uint32_t mCompositionDeltaIndex;
+        uint64_t mCompositionDeltaStart;
+    };
+
+    // Sparse time index, one entry per kSampleTimeBlockSize samples. Lookups by
+    // time only decode the blocks whose time range contains the requested time.
+    struct SampleTimeBlock {
+        SampleTimeCursor mStart;
+        uint64_t mMinTime;
+        uint64_t mMaxTime;
+        uint32_t mMinTimeSample;
+        uint32_t mMaxTimeSample;
     };
-    SampleTimeEntry *mSampleTimeEntries;
+    SampleTimeBlock *mSampleTimeBlocks;
+    uint32_t mNumSampleTimeBlocks;
+    // Samples past the end of the time-to-sample table have time 0.
+    uint32_t mNumTimedSamples;
+    // Composition times never decrease in decode order.
+    bool mSampleTimesMonotonic;
+
+    uint64_t *mDecodedTimes;
+    uint32_t mDecodedTimeBlocks[kNumDecodedTimeBlocks];
+    uint32_t mNextDecodedTimeBlock;
+
+    // The block of the sample size table read last.
+    uint32_t mSampleSizeBlockStart;
+    uint32_t mSampleSizeBlockCount;
+    uint32_t mSampleSizeBlock[kTableBlockEntries];
+
+    // The block of the chunk offset table read last.
+    uint32_t mChunkOffsetBlockStart;
+    uint32_t mChunkOffsetBlockCount;
+    uint64_t mChunkOffsetBlock[kTableBlockEntries];
 
     int32_t *mCompositionTimeDeltaEntries;
     size_t mNumCompositionTimeDeltaEntries;
@@ -156,19 +200,26 @@ private:
     friend struct SampleIterator;
 
     // normally we don't round
-    inline uint64_t getSampleTime(
-            size_t sample_index, uint64_t scale_num, uint64_t scale_den) const {
-        return (sample_index < (size_t)mNumSampleSizes && mSampleTimeEntries != NULL
-                && scale_den != 0)
-                ? (mSampleTimeEntries[sample_index].mCompositionTime * scale_num) / scale_den : 0;
+    static inline uint64_t scaleTime(uint64_t time, uint64_t scale_num, uint64_t scale_den) {
+        return scale_den != 0 ? (time * scale_num) / scale_den : 0;
     }
 
     status_t getSampleSize_l(uint32_t sample_index, size_t *sample_size);
     int32_t getCompositionTimeOffset(uint32_t sampleIndex);
 
-    static int CompareIncreasingTime(const void *, const void *);
+    status_t getSampleSizeFromBlock_l(uint32_t sampleIndex, size_t *sampleSize);
+    status_t getChunkOffsetFromBlock_l(uint32_t chunk, off64_t *offset);
+
+    uint64_t nextSampleTime(SampleTimeCursor *cursor) const;
+    uint32_t numSamplesInTimeBlock(uint32_t block) const;
+    const uint64_t *getSampleTimeBlock_l(uint32_t block);
+    uint32_t timedSampleIndex(uint32_t sampleIndex) const {
+        return sampleIndex < mNumTimedSamples ? sampleIndex : 0;
+    }
+    uint64_t countSamplesAtMost_l(uint64_t time);
+    status_t findSampleByPresentationOrder_l(uint32_t rank, uint32_t *sample_index);
 
-    void buildSampleEntriesTable();
+    void buildSampleTimeIndex_l();
 
     SampleTable(const SampleTable &);
     SampleTable &operator=(const SampleTable &);
@@ -0,0 +1,629 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <vector>
+
+#include <SampleTable.h>
+#include <gtest/gtest.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+
+/*
+ * Checks the sparse time index and the block reads of SampleTable against the
+ * sorted table of all sample times that they replaced, on synthetic tracks.
+ */
+
+namespace {
+
+using android::CDataSource;
+using android::DataSourceHelper;
+using android::FOURCC;
+using android::OK;
+using android::SampleTable;
+using android::sp;
+using android::status_t;
+
+constexpr uint64_t kTimescale = 30000;
+
+struct Run {
+    uint32_t count;
+    int32_t value;
+};
+
+// The tables of a track. Sample indices are 0-based.
+struct TrackParams {
+    const char *name;
+    uint32_t numSamples;
+    std::vector<Run> timeToSample;           // stts: count, duration
+    std::vector<Run> compositionOffsets;     // ctts: count, offset; none if empty
+    bool signedCompositionOffsets;           // ctts version 1
+    uint32_t sampleSizeFieldSize;            // 32 for stsz, else the stz2 field size
+    bool chunkOffsets64;                     // co64 instead of stco
+    std::vector<uint32_t> syncSamples;       // stss; none if empty
+};
+
+uint32_t sampleSizeOf(uint32_t sampleIndex, uint32_t fieldSize) {
+    uint32_t size = sampleIndex % 30 == 0 ? 60000 : 4000 + sampleIndex * 7 % 1000;
+    return fieldSize == 32 ? size : size % (1u << fieldSize);
+}
+
+// Serves the boxes of a track from memory.
+class SyntheticTrack : public DataSourceHelper {
+public:
+    explicit SyntheticTrack(const TrackParams &params)
+        : DataSourceHelper((CDataSource *)nullptr),
+          mParams(params) {
+        mTimeToSampleOffset = mData.size();
+        put32(0);
+        put32(params.timeToSample.size());
+        for (const Run &run : params.timeToSample) {
+            put32(run.count);
+            put32(run.value);
+        }
+        mTimeToSampleSize = mData.size() - mTimeToSampleOffset;
+
+        mCompositionOffset = mData.size();
+        put32(params.signedCompositionOffsets ? 0x01000000 : 0);
+        put32(params.compositionOffsets.size());
+        for (const Run &run : params.compositionOffsets) {
+            put32(run.count);
+            put32(run.value);
+        }
+        mCompositionSize = mData.size() - mCompositionOffset;
+
+        mSampleSizeOffset = mData.size();
+        const uint32_t fieldSize = params.sampleSizeFieldSize;
+        put32(0);
+        put32(fieldSize == 32 ? 0 : fieldSize);
+        put32(params.numSamples);
+        for (uint32_t i = 0; i < params.numSamples; ++i) {
+            uint32_t size = sampleSizeOf(i, fieldSize);
+            switch (fieldSize) {
+                case 32: put32(size); break;
+                case 16: mData.push_back(size >> 8); mData.push_back(size); break;
+                case 8: mData.push_back(size); break;
+                default:
+                    if (i % 2 == 0) {
+                        mData.push_back(size << 4);
+                    } else {
+                        mData.back() |= size;
+                    }
+                    break;
+            }
+        }
+        mSampleSizeSize = mData.size() - mSampleSizeOffset;
+
+        // 3 samples per chunk, then 1, then 5, so that the chunk offset table
+        // spans several blocks.
+        mSampleToChunkOffset = mData.size();
+        put32(0);
+        put32(3);
+        for (const Run &run : kSampleToChunk) {
+            put32(run.count);
+            put32(run.value);
+            put32(1);
+        }
+        mSampleToChunkSize = mData.size() - mSampleToChunkOffset;
+
+        mChunkOffsetOffset = mData.size();
+        const uint32_t numChunks = chunkOf(params.numSamples - 1) + 1;
+        put32(0);
+        put32(numChunks);
+        for (uint32_t i = 0; i < numChunks; ++i) {
+            if (params.chunkOffsets64) {
+                put64(chunkOffset(i));
+            } else {
+                put32(chunkOffset(i));
+            }
+        }
+        mChunkOffsetSize = mData.size() - mChunkOffsetOffset;
+
+        mSyncSampleOffset = mData.size();
+        put32(0);
+        put32(params.syncSamples.size());
+        for (uint32_t sample : params.syncSamples) {
+            put32(sample + 1);
+        }
+        mSyncSampleSize = mData.size() - mSyncSampleOffset;
+    }
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        if (offset < 0 || (size_t)offset >= mData.size()) {
+            return 0;
+        }
+        size = std::min(size, mData.size() - (size_t)offset);
+        memcpy(data, &mData[offset], size);
+        return size;
+    }
+
+    status_t getSize(off64_t *size) override {
+        *size = mData.size();
+        return OK;
+    }
+
+    uint32_t flags() override {
+        return 0;
+    }
+
+    sp<SampleTable> open() {
+        sp<SampleTable> table = new SampleTable(this);
+        EXPECT_EQ(OK, table->setChunkOffsetParams(
+                FOURCC(mParams.chunkOffsets64 ? "co64" : "stco"),
+                mChunkOffsetOffset, mChunkOffsetSize));
+        EXPECT_EQ(OK, table->setSampleToChunkParams(mSampleToChunkOffset, mSampleToChunkSize));
+        EXPECT_EQ(OK, table->setSampleSizeParams(
+                FOURCC(mParams.sampleSizeFieldSize == 32 ? "stsz" : "stz2"),
+                mSampleSizeOffset, mSampleSizeSize));
+        EXPECT_EQ(OK, table->setTimeToSampleParams(mTimeToSampleOffset, mTimeToSampleSize));
+        if (!mParams.compositionOffsets.empty()) {
+            EXPECT_EQ(OK, table->setCompositionTimeToSampleParams(
+                    mCompositionOffset, mCompositionSize));
+        }
+        if (!mParams.syncSamples.empty()) {
+            EXPECT_EQ(OK, table->setSyncSampleParams(mSyncSampleOffset, mSyncSampleSize));
+        }
+        return table;
+    }
+
+    // The stsc entries: first chunk (1-based), samples per chunk.
+    static constexpr Run kSampleToChunk[] = { {1, 3}, {700, 1}, {1500, 5} };
+
+    static uint32_t chunkOf(uint32_t sampleIndex) {
+        uint32_t chunk = 0;
+        uint32_t firstSample = 0;
+        for (size_t i = 0; i < std::size(kSampleToChunk); ++i) {
+            uint32_t perChunk = kSampleToChunk[i].value;
+            if (i + 1 < std::size(kSampleToChunk)) {
+                uint32_t chunks = kSampleToChunk[i + 1].count - kSampleToChunk[i].count;
+                if (sampleIndex >= firstSample + chunks * perChunk) {
+                    firstSample += chunks * perChunk;
+                    chunk += chunks;
+                    continue;
+                }
+            }
+            return chunk + (sampleIndex - firstSample) / perChunk;
+        }
+        return chunk;
+    }
+
+    // co64 offsets go past 4GB.
+    uint64_t chunkOffset(uint32_t chunk) const {
+        return (mParams.chunkOffsets64 ? (5ull << 30) : 0) + chunk * 300000ull;
+    }
+
+private:
+    void put32(uint32_t x) {
+        mData.push_back(x >> 24);
+        mData.push_back(x >> 16);
+        mData.push_back(x >> 8);
+        mData.push_back(x);
+    }
+
+    void put64(uint64_t x) {
+        put32(x >> 32);
+        put32(x);
+    }
+
+    const TrackParams mParams;
+    std::vector<uint8_t> mData;
+
+    off64_t mTimeToSampleOffset;
+    size_t mTimeToSampleSize;
+    off64_t mCompositionOffset;
+    size_t mCompositionSize;
+    off64_t mSampleSizeOffset;
+    size_t mSampleSizeSize;
+    off64_t mSampleToChunkOffset;
+    size_t mSampleToChunkSize;
+    off64_t mChunkOffsetOffset;
+    size_t mChunkOffsetSize;
+    off64_t mSyncSampleOffset;
+    size_t mSyncSampleSize;
+};
+
+int32_t compositionOffsetOf(const TrackParams &params, uint32_t sampleIndex) {
+    for (const Run &run : params.compositionOffsets) {
+        if (sampleIndex < run.count) {
+            return run.value;
+        }
+        sampleIndex -= run.count;
+    }
+    return 0;
+}
+
+struct TimeEntry {
+    uint32_t mSampleIndex;
+    uint64_t mCompositionTime;
+};
+
+// The table that findSampleAtTime() used to build: the composition time of
+// every sample, sorted by time. Samples past the end of the stts table keep the
+// zeroed entry {0, 0}.
+std::vector<TimeEntry> buildSortedTimeTable(const TrackParams &params) {
+    std::vector<TimeEntry> entries(params.numSamples, TimeEntry{0, 0});
+    uint32_t sampleIndex = 0;
+    uint64_t sampleTime = 0;
+    for (const Run &run : params.timeToSample) {
+        for (uint32_t j = 0; j < run.count; ++j) {
+            if (sampleIndex < params.numSamples) {
+                entries[sampleIndex].mSampleIndex = sampleIndex;
+                int32_t compTimeDelta = compositionOffsetOf(params, sampleIndex);
+                if (compTimeDelta < 0 && sampleTime < (uint64_t)(-(int64_t)compTimeDelta)) {
+                    sampleTime = 0;
+                    compTimeDelta = 0;
+                }
+                entries[sampleIndex].mCompositionTime = sampleTime + compTimeDelta;
+            }
+            ++sampleIndex;
+            sampleTime += (uint32_t)run.value;
+        }
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+            [](const TimeEntry &a, const TimeEntry &b) {
+                return a.mCompositionTime < b.mCompositionTime;
+            });
+    return entries;
+}
+
+uint64_t scaleTime(uint64_t time, uint64_t scaleNum, uint64_t scaleDen) {
+    return time * scaleNum / scaleDen;
+}
+
+uint32_t absDifference(uint64_t time1, uint64_t time2) {
+    return time1 > time2 ? time1 - time2 : time2 - time1;
+}
+
+// The lookup of the sorted table. Returns the position of the entry found.
+status_t findInSortedTimeTable(
+        const std::vector<TimeEntry> &entries, uint64_t reqTime,
+        uint64_t scaleNum, uint64_t scaleDen, uint32_t flags, size_t *position) {
+    if (flags == SampleTable::kFlagFrameIndex) {
+        if (reqTime >= entries.size()) {
+            return android::ERROR_OUT_OF_RANGE;
+        }
+        *position = reqTime;
+        return OK;
+    }
+
+    auto timeAt = [&](size_t i) {
+        return scaleTime(entries[i].mCompositionTime, scaleNum, scaleDen);
+    };
+    size_t left = 0;
+    size_t rightPlusOne = entries.size();
+    while (left < rightPlusOne) {
+        size_t center = left + (rightPlusOne - left) / 2;
+        if (reqTime < timeAt(center)) {
+            rightPlusOne = center;
+        } else if (reqTime > timeAt(center)) {
+            left = center + 1;
+        } else {
+            *position = center;
+            return OK;
+        }
+    }
+
+    if (left == entries.size()) {
+        if (flags == SampleTable::kFlagAfter) {
+            return android::ERROR_OUT_OF_RANGE;
+        }
+        flags = SampleTable::kFlagBefore;
+    } else if (left == 0) {
+        flags = SampleTable::kFlagAfter;
+    }
+
+    if (flags == SampleTable::kFlagBefore) {
+        --left;
+    } else if (flags == SampleTable::kFlagClosest
+            && absDifference(timeAt(left), reqTime) > absDifference(reqTime, timeAt(left - 1))) {
+        --left;
+    }
+    *position = left;
+    return OK;
+}
+
+// The composition time and duration that SampleIterator computes, or false if
+// the sample has none.
+bool sampleTimeOf(const TrackParams &params, uint32_t sampleIndex,
+        uint64_t *time, uint64_t *duration) {
+    uint64_t decodeTime = 0;
+    uint32_t first = 0;
+    for (const Run &run : params.timeToSample) {
+        if (sampleIndex < first + run.count) {
+            decodeTime += (uint64_t)(sampleIndex - first) * (uint32_t)run.value;
+            int32_t offset = compositionOffsetOf(params, sampleIndex);
+            if (offset < 0 && decodeTime < (uint64_t)(-(int64_t)offset)) {
+                return false;
+            }
+            *time = decodeTime + offset;
+            *duration = (uint32_t)run.value;
+            return true;
+        }
+        decodeTime += (uint64_t)run.count * (uint32_t)run.value;
+        first += run.count;
+    }
+    return false;
+}
+
+void PrintTo(const TrackParams &params, std::ostream *os) {
+    *os << params.name;
+}
+
+const char *flagName(uint32_t flags) {
+    switch (flags) {
+        case SampleTable::kFlagBefore: return "before";
+        case SampleTable::kFlagAfter: return "after";
+        case SampleTable::kFlagClosest: return "closest";
+        default: return "frame index";
+    }
+}
+
+class SampleTableTest : public ::testing::TestWithParam<TrackParams> {
+protected:
+    void SetUp() override {
+        mTrack.reset(new SyntheticTrack(GetParam()));
+        mTable = mTrack->open();
+        mSortedTimes = buildSortedTimeTable(GetParam());
+    }
+
+    void TearDown() override {
+        mTable.clear();
+        mTrack.reset();
+    }
+
+    // Expects findSampleAtTime() to find what the sorted table finds. Samples
+    // whose times are equal at this scale are interchangeable: the order of the
+    // sorted table between them was not defined.
+    void expectSameSample(uint64_t reqTime, uint64_t scaleNum, uint64_t scaleDen,
+            uint32_t flags) {
+        SCOPED_TRACE(testing::Message() << flagName(flags) << " " << reqTime
+                << " at " << scaleNum << "/" << scaleDen);
+        size_t position = 0;
+        status_t expected = findInSortedTimeTable(
+                mSortedTimes, reqTime, scaleNum, scaleDen, flags, &position);
+        uint32_t sampleIndex = UINT32_MAX;
+        ASSERT_EQ(expected, mTable->findSampleAtTime(
+                reqTime, scaleNum, scaleDen, &sampleIndex, flags));
+        if (expected != OK) {
+            return;
+        }
+
+        // scaling keeps the order, so the equal times are next to each other
+        auto timeAt = [&](size_t i) {
+            return scaleTime(mSortedTimes[i].mCompositionTime, scaleNum, scaleDen);
+        };
+        const uint64_t time = timeAt(position);
+        size_t first = position;
+        while (first > 0 && timeAt(first - 1) == time) {
+            --first;
+        }
+        std::set<uint32_t> candidates;
+        for (size_t i = first; i < mSortedTimes.size() && timeAt(i) == time; ++i) {
+            candidates.insert(mSortedTimes[i].mSampleIndex);
+        }
+        EXPECT_TRUE(candidates.count(sampleIndex))
+                << "found sample " << sampleIndex << ", expected sample "
+                << mSortedTimes[position].mSampleIndex << " at time " << time;
+    }
+
+    std::unique_ptr<SyntheticTrack> mTrack;
+    sp<SampleTable> mTable;
+    std::vector<TimeEntry> mSortedTimes;
+};
+
+TEST_P(SampleTableTest, FindsSampleAtTicks) {
+    // every sample time, the times next to it, halfway to the next one, and
+    // past both ends
+    std::set<uint64_t> times = {0};
+    for (size_t i = 0; i < mSortedTimes.size(); ++i) {
+        uint64_t time = mSortedTimes[i].mCompositionTime;
+        times.insert(time);
+        times.insert(time + 1);
+        if (time > 0) {
+            times.insert(time - 1);
+        }
+        if (i + 1 < mSortedTimes.size()) {
+            times.insert((time + mSortedTimes[i + 1].mCompositionTime) / 2);
+        }
+    }
+    for (uint64_t time : times) {
+        for (uint32_t flags : {SampleTable::kFlagBefore, SampleTable::kFlagAfter,
+                               SampleTable::kFlagClosest}) {
+            ASSERT_NO_FATAL_FAILURE(expectSameSample(time, 1, 1, flags));
+        }
+    }
+}
+
+// As MPEG4Extractor seeks: in microseconds, shifted by the edit list.
+TEST_P(SampleTableTest, FindsSampleAtMicroseconds) {
+    const uint64_t endUs = scaleTime(mSortedTimes.back().mCompositionTime, 1000000, kTimescale);
+    const int64_t kElstShiftStartUs = 66733;  // 2002 ticks
+    for (uint64_t timeUs = 0; timeUs <= endUs + 100000; timeUs += 4999) {
+        for (uint64_t seekTimeUs : {timeUs, timeUs + kElstShiftStartUs}) {
+            for (uint32_t flags : {SampleTable::kFlagBefore, SampleTable::kFlagAfter,
+                                   SampleTable::kFlagClosest}) {
+                ASSERT_NO_FATAL_FAILURE(
+                        expectSameSample(seekTimeUs, 1000000, kTimescale, flags));
+            }
+        }
+    }
+}
+
+TEST_P(SampleTableTest, FindsSampleAtFrameIndex) {
+    for (uint64_t index = 0; index <= GetParam().numSamples; ++index) {
+        ASSERT_NO_FATAL_FAILURE(expectSameSample(index, 1, 1, SampleTable::kFlagFrameIndex));
+    }
+}
+
+TEST_P(SampleTableTest, FindsSyncSampleNear) {
+    const TrackParams &params = GetParam();
+    const std::vector<uint32_t> &sync = params.syncSamples;
+    if (sync.empty()) {
+        // every sample is a sync sample
+        for (uint32_t i = 0; i < params.numSamples; ++i) {
+            for (uint32_t flags : {SampleTable::kFlagBefore, SampleTable::kFlagAfter,
+                                   SampleTable::kFlagClosest}) {
+                uint32_t syncSample;
+                ASSERT_EQ(OK, mTable->findSyncSampleNear(i, &syncSample, flags));
+                ASSERT_EQ(i, syncSample);
+            }
+        }
+        return;
+    }
+    for (uint32_t i = 0; i < params.numSamples; ++i) {
+        auto next = std::lower_bound(sync.begin(), sync.end(), i);
+        uint32_t syncSample;
+
+        uint32_t before = next != sync.end() && *next == i ? i
+                : next == sync.begin() ? sync.front() : *(next - 1);
+        ASSERT_EQ(OK, mTable->findSyncSampleNear(i, &syncSample, SampleTable::kFlagBefore));
+        ASSERT_EQ(before, syncSample) << "before sample " << i;
+
+        status_t err = mTable->findSyncSampleNear(i, &syncSample, SampleTable::kFlagAfter);
+        if (next == sync.end()) {
+            ASSERT_EQ(android::ERROR_OUT_OF_RANGE, err) << "after sample " << i;
+        } else {
+            ASSERT_EQ(OK, err);
+            ASSERT_EQ(*next, syncSample) << "after sample " << i;
+        }
+
+        if (next == sync.begin() || next == sync.end() || *next == i) {
+            continue;
+        }
+        // between two sync samples: the one closest in time
+        uint64_t time, lowerTime, upperTime, duration;
+        if (!sampleTimeOf(params, i, &time, &duration)
+                || !sampleTimeOf(params, *next, &upperTime, &duration)
+                || !sampleTimeOf(params, *(next - 1), &lowerTime, &duration)) {
+            continue;
+        }
+        ASSERT_EQ(OK, mTable->findSyncSampleNear(i, &syncSample, SampleTable::kFlagClosest));
+        uint32_t closest = absDifference(upperTime, time) > absDifference(time, lowerTime)
+                ? *(next - 1) : *next;
+        ASSERT_EQ(closest, syncSample) << "closest to sample " << i;
+    }
+}
+
+// The sample sizes and chunk offsets are read in blocks; read them in an order
+// that goes back and forth across block boundaries.
+TEST_P(SampleTableTest, ReadsMetaDataAcrossBlocks) {
+    const TrackParams &params = GetParam();
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < params.numSamples; ++i) {
+        order.push_back(i);
+    }
+    for (uint32_t i = params.numSamples; i > 0; i -= std::min(i, 997u)) {
+        order.push_back(i - 1);
+    }
+    for (uint32_t boundary = 1024; boundary < params.numSamples; boundary += 1024) {
+        order.push_back(boundary);
+        order.push_back(boundary - 1);
+        order.push_back(boundary + 1);
+    }
+
+    const std::set<uint32_t> sync(params.syncSamples.begin(), params.syncSamples.end());
+    for (uint32_t i : order) {
+        SCOPED_TRACE(testing::Message() << "sample " << i);
+        off64_t offset;
+        size_t size;
+        uint64_t time, duration;
+        bool isSyncSample;
+        status_t err = mTable->getMetaDataForSample(
+                i, &offset, &size, &time, &isSyncSample, &duration);
+
+        uint64_t expectedTime, expectedDuration;
+        if (!sampleTimeOf(params, i, &expectedTime, &expectedDuration)) {
+            ASSERT_NE(OK, err);
+            continue;
+        }
+        ASSERT_EQ(OK, err);
+
+        uint32_t chunk = SyntheticTrack::chunkOf(i);
+        off64_t expectedOffset = mTrack->chunkOffset(chunk);
+        for (uint32_t j = i; j > 0 && SyntheticTrack::chunkOf(j - 1) == chunk; --j) {
+            expectedOffset += sampleSizeOf(j - 1, params.sampleSizeFieldSize);
+        }
+        ASSERT_EQ(expectedOffset, offset);
+        ASSERT_EQ(sampleSizeOf(i, params.sampleSizeFieldSize), size);
+        ASSERT_EQ(expectedTime, time);
+        ASSERT_EQ(expectedDuration, duration);
+        ASSERT_EQ(sync.empty() || sync.count(i), isSyncSample);
+    }
+
+    size_t maxSize = 0;
+    ASSERT_EQ(OK, mTable->getMaxSampleSize(&maxSize));
+    size_t expectedMaxSize = 0;
+    for (uint32_t i = 0; i < params.numSamples; ++i) {
+        expectedMaxSize = std::max<size_t>(
+                expectedMaxSize, sampleSizeOf(i, params.sampleSizeFieldSize));
+    }
+    EXPECT_EQ(expectedMaxSize, maxSize);
+}
+
+std::vector<Run> repeat(std::vector<Run> pattern, uint32_t numSamples) {
+    std::vector<Run> runs;
+    for (uint32_t i = 0; i < numSamples; ++i) {
+        runs.push_back(pattern[i % pattern.size()]);
+    }
+    return runs;
+}
+
+std::vector<uint32_t> everyNth(uint32_t n, uint32_t first, uint32_t numSamples) {
+    std::vector<uint32_t> samples;
+    for (uint32_t i = first; i < numSamples; i += n) {
+        samples.push_back(i);
+    }
+    return samples;
+}
+
+// The tracks span several blocks of 1024 samples, and do not end on a block.
+// Their last chunk is whole: SampleIterator shortens a chunk that runs past the
+// sample sizes.
+const TrackParams kTracks[] = {
+    // 30 fps without B-frames: times only increase.
+    { "constant", 5002, { {5002, 1001} }, {}, false, 32, false, everyNth(30, 0, 5002) },
+    // IPBB, one ctts entry per sample as muxers write it.
+    { "reordered", 4102, { {4102, 1001} },
+      repeat({ {1, 1001}, {1, 4004}, {1, 0}, {1, 0} }, 4102), false, 32, true,
+      everyNth(24, 0, 4102) },
+    // Negative ctts: the first samples clamp to time 0, so several share it.
+    { "negative_offsets", 3002, { {3002, 1001} },
+      repeat({ {1, -2002}, {1, 1001}, {1, -1001} }, 3002), true, 16, false,
+      everyNth(12, 0, 3002) },
+    // Runs of durations, and ctts runs shifting every sample by an edit list
+    // offset, with a reordered stretch across a block boundary.
+    { "runs", 3502, { {1000, 1001}, {500, 2002}, {1000, 0}, {1002, 1001} },
+      { {1000, 2002}, {100, 6006}, {100, 0}, {2302, 2002} }, false, 8, true,
+      everyNth(100, 5, 3502) },
+    // stts runs out before the last samples, which then have no time.
+    { "untimed_tail", 2500, { {2100, 1001} }, {}, false, 4, false, everyNth(50, 0, 2500) },
+    // Equal times: zero durations, so ties at the same time inside blocks.
+    { "equal_times", 2100, { {300, 1001}, {1500, 0}, {300, 512} },
+      repeat({ {1, 0}, {1, 1001} }, 2100), false, 32, false, {} },
+};
+
+INSTANTIATE_TEST_SUITE_P(Tracks, SampleTableTest, ::testing::ValuesIn(kTracks),
+        [](const ::testing::TestParamInfo<TrackParams> &info) {
+            return std::string(info.param.name);
+        });
+
+}  // namespace
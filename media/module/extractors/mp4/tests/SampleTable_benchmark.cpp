@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <SampleTable.h>
+#include <benchmark/benchmark.h>
+#include <media/stagefright/foundation/ByteUtils.h>
+
+using namespace android;
+
+/*
+ * Measures the time to open the sample table of a synthetic track with millions
+ * of samples (parse the boxes and find the largest sample, as MPEG4Extractor
+ * does), the time of the first seek, and the resident memory used by the table.
+ */
+
+namespace {
+
+// Sample tables of a 30 fps video track, 30 samples per chunk, with or without
+// B-frames.
+class SyntheticTrack : public DataSourceHelper {
+public:
+    SyntheticTrack(uint32_t numSamples, bool reordered)
+        : DataSourceHelper((CDataSource *)nullptr),
+          mNumSamples(numSamples),
+          mReordered(reordered),
+          mNumReads(0) {
+        const uint32_t kSamplesPerChunk = 30;
+        const uint32_t numChunks = (numSamples + kSamplesPerChunk - 1) / kSamplesPerChunk;
+
+        // stts: constant duration
+        mTimeToSampleOffset = mData.size();
+        put32(0);
+        put32(1);
+        put32(numSamples);
+        put32(1001);
+        mTimeToSampleSize = mData.size() - mTimeToSampleOffset;
+
+        // ctts: IPBB pattern, one entry per sample as muxers write it
+        mCompositionOffset = mData.size();
+        if (reordered) {
+            static const int32_t kOffsets[] = { 1001, 4004, 0, 0 };
+            put32(0);
+            put32(numSamples);
+            for (uint32_t i = 0; i < numSamples; ++i) {
+                put32(1);
+                put32(kOffsets[i % 4]);
+            }
+        }
+        mCompositionSize = mData.size() - mCompositionOffset;
+
+        // stsz
+        mSampleSizeOffset = mData.size();
+        put32(0);
+        put32(0);
+        put32(numSamples);
+        for (uint32_t i = 0; i < numSamples; ++i) {
+            put32(i % 30 == 0 ? 60000 : 4000 + i % 1000);
+        }
+        mSampleSizeSize = mData.size() - mSampleSizeOffset;
+
+        // stsc
+        mSampleToChunkOffset = mData.size();
+        put32(0);
+        put32(1);
+        put32(1);
+        put32(kSamplesPerChunk);
+        put32(1);
+        mSampleToChunkSize = mData.size() - mSampleToChunkOffset;
+
+        // co64
+        mChunkOffsetOffset = mData.size();
+        put32(0);
+        put32(numChunks);
+        for (uint64_t i = 0; i < numChunks; ++i) {
+            put32((i * 250000) >> 32);
+            put32(i * 250000);
+        }
+        mChunkOffsetSize = mData.size() - mChunkOffsetOffset;
+
+        // stss: one sync sample per second
+        mSyncSampleOffset = mData.size();
+        put32(0);
+        put32(numChunks);
+        for (uint32_t i = 0; i < numChunks; ++i) {
+            put32(i * kSamplesPerChunk + 1);
+        }
+        mSyncSampleSize = mData.size() - mSyncSampleOffset;
+    }
+
+    ssize_t readAt(off64_t offset, void *data, size_t size) override {
+        ++mNumReads;
+        if (offset < 0 || (size_t)offset >= mData.size()) {
+            return 0;
+        }
+        size = std::min(size, mData.size() - (size_t)offset);
+        memcpy(data, &mData[offset], size);
+        return size;
+    }
+
+    status_t getSize(off64_t *size) override {
+        *size = mData.size();
+        return OK;
+    }
+
+    uint32_t flags() override {
+        return 0;
+    }
+
+    sp<SampleTable> open() {
+        sp<SampleTable> table = new SampleTable(this);
+        table->setChunkOffsetParams(FOURCC("co64"), mChunkOffsetOffset, mChunkOffsetSize);
+        table->setSampleToChunkParams(mSampleToChunkOffset, mSampleToChunkSize);
+        table->setSampleSizeParams(FOURCC("stsz"), mSampleSizeOffset, mSampleSizeSize);
+        table->setTimeToSampleParams(mTimeToSampleOffset, mTimeToSampleSize);
+        if (mReordered) {
+            table->setCompositionTimeToSampleParams(mCompositionOffset, mCompositionSize);
+        }
+        table->setSyncSampleParams(mSyncSampleOffset, mSyncSampleSize);
+        return table;
+    }
+
+    uint32_t numSamples() const { return mNumSamples; }
+    int64_t numReads() const { return mNumReads; }
+
+private:
+    void put32(uint32_t x) {
+        mData.push_back(x >> 24);
+        mData.push_back(x >> 16);
+        mData.push_back(x >> 8);
+        mData.push_back(x);
+    }
+
+    std::vector<uint8_t> mData;
+    uint32_t mNumSamples;
+    bool mReordered;
+    int64_t mNumReads;
+
+    off64_t mTimeToSampleOffset;
+    size_t mTimeToSampleSize;
+    off64_t mCompositionOffset;
+    size_t mCompositionSize;
+    off64_t mSampleSizeOffset;
+    size_t mSampleSizeSize;
+    off64_t mSampleToChunkOffset;
+    size_t mSampleToChunkSize;
+    off64_t mChunkOffsetOffset;
+    size_t mChunkOffsetSize;
+    off64_t mSyncSampleOffset;
+    size_t mSyncSampleSize;
+};
+
+size_t residentBytes() {
+    size_t pages = 0;
+    size_t resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f != nullptr) {
+        if (fscanf(f, "%zu %zu", &pages, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+}  // namespace
+
+static void BM_SampleTableOpen(benchmark::State& state) {
+    SyntheticTrack track(state.range(0), state.range(1));
+
+    int64_t reads = 0;
+    for (auto _ : state) {
+        int64_t readsBefore = track.numReads();
+        sp<SampleTable> table = track.open();
+        size_t maxSize;
+        table->getMaxSampleSize(&maxSize);
+        benchmark::DoNotOptimize(maxSize);
+        reads += track.numReads() - readsBefore;
+    }
+    state.counters["reads"] = benchmark::Counter(reads, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_SampleTableFirstSeek(benchmark::State& state) {
+    SyntheticTrack track(state.range(0), state.range(1));
+    const uint64_t seekTimeUs = (uint64_t)track.numSamples() * 1001 / 2 * 1000000 / 30000;
+
+    double tableBytes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        sp<SampleTable> table = track.open();
+        size_t residentBefore = residentBytes();
+        state.ResumeTiming();
+
+        uint32_t sampleIndex;
+        table->findSampleAtTime(
+                seekTimeUs, 1000000, 30000, &sampleIndex, SampleTable::kFlagClosest);
+        uint32_t syncSampleIndex;
+        table->findSyncSampleNear(sampleIndex, &syncSampleIndex, SampleTable::kFlagBefore);
+        off64_t offset;
+        size_t size;
+        uint64_t time;
+        table->getMetaDataForSample(syncSampleIndex, &offset, &size, &time);
+        benchmark::DoNotOptimize(offset);
+
+        state.PauseTiming();
+        size_t residentAfter = residentBytes();
+        tableBytes += residentAfter > residentBefore ? residentAfter - residentBefore : 0;
+        table.clear();
+        state.ResumeTiming();
+    }
+    state.counters["rss_growth_bytes"] =
+            benchmark::Counter(tableBytes, benchmark::Counter::kAvgIterations);
+}
+
+static void SampleTableArgs(benchmark::internal::Benchmark* b) {
+    for (int reordered : {0, 1}) {
+        for (int numSamples : {100000, 1000000, 10000000}) {
+            b->Args({numSamples, reordered});
+        }
+    }
+}
+
+BENCHMARK(BM_SampleTableOpen)->Apply(SampleTableArgs)->ArgNames({"samples", "ctts"})
+        ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SampleTableFirstSeek)->Apply(SampleTableArgs)->ArgNames({"samples", "ctts"})
+        ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <string.h>
 #include <sys/types.h>
 
 #include "AAtomizer.h"
@@ -21,47 +22,67 @@
 namespace android {
 
 // static
-AAtomizer AAtomizer::gAtomizer;
+AAtomizer *AAtomizer::Get() {
+    // constructed on first use, as atoms may be requested during static initialization
+    // (e.g. by AMessage item names).
+    static AAtomizer *atomizer = new AAtomizer;
+    return atomizer;
+}
 
 // static
 const char *AAtomizer::Atomize(const char *name) {
-    return gAtomizer.atomize(name);
+    size_t len;
+    uint32_t hash = Hash(name, &len);
+    return Get()->atomize(name, len, hash, false /* bounded */);
 }
 
-AAtomizer::AAtomizer() {
-    for (size_t i = 0; i < 128; ++i) {
-        mAtoms.push(List<AString>());
-    }
+// static
+const char *AAtomizer::AtomizeBounded(const char *name, size_t len, uint32_t hash) {
+    return Get()->atomize(name, len, hash, true /* bounded */);
 }
 
-const char *AAtomizer::atomize(const char *name) {
-    Mutex::Autolock autoLock(mLock);
+AAtomizer::AAtomizer()
+    : mNumAtoms(0) {
+    for (size_t i = 0; i < kNumBuckets; ++i) {
+        mBuckets[i].store(NULL, std::memory_order_relaxed);
+    }
+}
 
-    const size_t n = mAtoms.size();
-    size_t index = AAtomizer::Hash(name) % n;
-    List<AString> &entry = mAtoms.editItemAt(index);
-    List<AString>::iterator it = entry.begin();
-    while (it != entry.end()) {
-        if ((*it) == name) {
-            return (*it).c_str();
+// static
+const char *AAtomizer::Find(
+        const Atom *atom, const char *name, size_t len, uint32_t hash) {
+    for (; atom != NULL; atom = atom->mNext) {
+        if (atom->mHash == hash && atom->mLength == len
+                && !memcmp(atom->mName.c_str(), name, len)) {
+            return atom->mName.c_str();
         }
-        ++it;
     }
+    return NULL;
+}
 
-    entry.push_back(AString(name));
+const char *AAtomizer::atomize(const char *name, size_t len, uint32_t hash, bool bounded) {
+    std::atomic<const Atom *> &bucket = mBuckets[hash % kNumBuckets];
 
-    return (*--entry.end()).c_str();
-}
+    // after warm-up nearly all names are already known
+    const char *atom = Find(bucket.load(std::memory_order_acquire), name, len, hash);
+    if (atom != NULL) {
+        return atom;
+    }
 
-// static
-uint32_t AAtomizer::Hash(const char *s) {
-    uint32_t sum = 0;
-    while (*s != '\0') {
-        sum = (sum * 31) + *s;
-        ++s;
+    Mutex::Autolock autoLock(mLock);
+    const Atom *head = bucket.load(std::memory_order_relaxed);
+    atom = Find(head, name, len, hash);
+    if (atom != NULL) {
+        return atom;
+    }
+    if (bounded && mNumAtoms >= kMaxAtoms) {
+        return NULL;
     }
 
-    return sum;
+    Atom *newAtom = new Atom{head, hash, len, AString(name, len)};
+    ++mNumAtoms;
+    bucket.store(newAtom, std::memory_order_release);
+    return newAtom->mName.c_str();
 }
 
 }  // namespace android
@@ -17,6 +17,7 @@
 #include "ABitReader.h"
 
 #include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/avc_utils.h>
 
 namespace android {
 
@@ -135,6 +136,19 @@ const uint8_t *ABitReader::data() const {
 NALBitReader::NALBitReader(const uint8_t *data, size_t size)
     : ABitReader(data, size),
       mNumZeros(0) {
+    findNextEmulationPreventionByte();
+}
+
+void NALBitReader::findNextEmulationPreventionByte() {
+    mScanStart = mData;
+    if (mNumZeros >= 2 && mSize > 0 && mData[0] == 3) {
+        mNextEmulationPrevention = mData;
+    } else if (mNumZeros >= 1 && mSize > 1 && mData[0] == 0 && mData[1] == 3) {
+        mNextEmulationPrevention = mData + 1;
+    } else {
+        size_t offset = findNextEmulationPrevention(mData, mSize);
+        mNextEmulationPrevention = offset < mSize ? mData + offset + 2 : mData + mSize;
+    }
 }
 
 bool NALBitReader::atLeastNumBitsLeft(size_t n) const {
@@ -175,6 +189,24 @@ bool NALBitReader::fillReservoir() {
         return false;
     }
 
+    if (mData < mScanStart) {
+        // rewound by putBits()
+        findNextEmulationPreventionByte();
+    }
+
+    if (mSize >= 4 && mData + 4 <= mNextEmulationPrevention) {
+        mReservoir = ((uint32_t)mData[0] << 24) | (mData[1] << 16) | (mData[2] << 8) | mData[3];
+        if (mReservoir == 0) {
+            mNumZeros += 4;
+        } else {
+            mNumZeros = __builtin_ctz(mReservoir) / 8;
+        }
+        mData += 4;
+        mSize -= 4;
+        mNumBitsLeft = 32;
+        return true;
+    }
+
     mReservoir = 0;
     size_t i = 0;
     while (mSize > 0 && i < 4) {
@@ -196,6 +228,10 @@ bool NALBitReader::fillReservoir() {
         --mSize;
     }
 
+    if (mData > mNextEmulationPrevention) {
+        findNextEmulationPreventionByte();
+    }
+
     mNumBitsLeft = 8 * i;
     mReservoir <<= 32 - mNumBitsLeft;
     return true;
@@ -23,6 +23,9 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "ALooper.h"
 
 #include "AHandler.h"
@@ -64,6 +67,158 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(LooperThread);
 };
 
+struct ALooper::EventQueue {
+    virtual ~EventQueue() {}
+
+    virtual bool empty() const = 0;
+
+    // Returns the event with the earliest delivery time. Must not be empty.
+    virtual const Event &front() const = 0;
+    virtual Event popFront() = 0;
+
+    // Events with the same delivery time are delivered in the order they were pushed.
+    virtual void push(Event &&event) = 0;
+
+    // Erases all events posted with the token.
+    virtual void eraseToken(const sp<RefBase> &token) = 0;
+};
+
+struct ALooper::ListEventQueue : public ALooper::EventQueue {
+    bool empty() const override {
+        return mEvents.empty();
+    }
+
+    const Event &front() const override {
+        return *mEvents.begin();
+    }
+
+    Event popFront() override {
+        Event event = *mEvents.begin();
+        mEvents.erase(mEvents.begin());
+        return event;
+    }
+
+    void push(Event &&event) override {
+        List<Event>::iterator it = mEvents.begin();
+        while (it != mEvents.end() && (*it).mWhenUs <= event.mWhenUs) {
+            ++it;
+        }
+        mEvents.insert(it, event);
+    }
+
+    void eraseToken(const sp<RefBase> &token) override {
+        for (auto i = mEvents.begin(); i != mEvents.end();) {
+            if (i->mToken == token) {
+                i = mEvents.erase(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    List<Event> mEvents;
+};
+
+struct ALooper::HeapEventQueue : public ALooper::EventQueue {
+    bool empty() const override {
+        return mHeap.empty();
+    }
+
+    const Event &front() const override {
+        return mHeap.front();
+    }
+
+    Event popFront() override {
+        std::pop_heap(mHeap.begin(), mHeap.end(), Later());
+        Event event = std::move(mHeap.back());
+        mHeap.pop_back();
+        return event;
+    }
+
+    void push(Event &&event) override {
+        mHeap.push_back(std::move(event));
+        std::push_heap(mHeap.begin(), mHeap.end(), Later());
+    }
+
+    void eraseToken(const sp<RefBase> &token) override {
+        auto it = std::remove_if(mHeap.begin(), mHeap.end(), [&token](const Event &event) {
+            return event.mToken == token;
+        });
+        if (it != mHeap.end()) {
+            mHeap.erase(it, mHeap.end());
+            std::make_heap(mHeap.begin(), mHeap.end(), Later());
+        }
+    }
+
+private:
+    // Makes a min-heap on (mWhenUs, mSequence). The sequence is taken when the event is
+    // posted, so that an event still in mPostedEvents when a later event is pushed under
+    // mLock keeps its place.
+    struct Later {
+        bool operator()(const Event &a, const Event &b) const {
+            if (a.mWhenUs != b.mWhenUs) {
+                return a.mWhenUs > b.mWhenUs;
+            }
+            return a.mSequence > b.mSequence;
+        }
+    };
+
+    std::vector<Event> mHeap;
+};
+
+// Multiple producer, single consumer lock-free queue (linked list with a dummy node).
+// The consumer is the looper thread, holding mLock.
+struct ALooper::PostedEventQueue {
+    PostedEventQueue()
+        : mHead(new Node),
+          mTail(mHead.load()) {
+    }
+
+    ~PostedEventQueue() {
+        Event event;
+        while (pop(&event)) {
+        }
+        delete mTail;
+    }
+
+    void push(Event &&event) {
+        Node *node = new Node;
+        node->mEvent = std::move(event);
+        Node *prev = mHead.exchange(node, std::memory_order_acq_rel);
+        // sequentially consistent, see ALooper::waitQueueChanged_l().
+        prev->mNext.store(node);
+    }
+
+    // May return false while a push() is in progress.
+    bool pop(Event *event) {
+        Node *next = mTail->mNext.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        *event = std::move(next->mEvent);
+        delete mTail;
+        mTail = next;
+        return true;
+    }
+
+    bool empty() const {
+        // sequentially consistent, see ALooper::waitQueueChanged_l().
+        return mTail->mNext.load() == nullptr;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node *> mNext{nullptr};
+        Event mEvent;
+    };
+
+    std::atomic<Node *> mHead; // last pushed node, shared by producers
+    Node *mTail;               // dummy node, owned by the consumer
+
+    DISALLOW_EVIL_CONSTRUCTORS(PostedEventQueue);
+};
+
 // static
 int64_t ALooper::GetNowUs() {
     return systemTime(SYSTEM_TIME_MONOTONIC) / 1000LL;
@@ -74,7 +229,12 @@ int64_t ALooper::getNowUs() {
 }
 
 ALooper::ALooper()
-    : mRunningLocally(false) {
+    : mQueueType(QUEUE_TYPE_LIST),
+      mEventQueue(new ListEventQueue),
+      mPostedEvents(new PostedEventQueue),
+      mLoopWaiting(false),
+      mNextSequence(0),
+      mRunningLocally(false) {
     // clean up stale AHandlers. Doing it here instead of in the destructor avoids
     // the side effect of objects being deleted from the unregister function recursively.
     gLooperRoster.unregisterStaleHandlers();
@@ -89,6 +249,35 @@ void ALooper::setName(const char *name) {
     mName = name;
 }
 
+status_t ALooper::setQueueType(queue_type_t type) {
+    Mutex::Autolock autoLock(mLock);
+
+    if (mThread != NULL || mRunningLocally) {
+        return INVALID_OPERATION;
+    }
+
+    std::unique_ptr<EventQueue> queue;
+    switch (type) {
+        case QUEUE_TYPE_LIST:
+            queue.reset(new ListEventQueue);
+            break;
+        case QUEUE_TYPE_HEAP:
+            queue.reset(new HeapEventQueue);
+            break;
+        default:
+            return BAD_VALUE;
+    }
+
+    drainPostedEvents_l();
+    while (!mEventQueue->empty()) {
+        queue->push(mEventQueue->popFront());
+    }
+    mEventQueue = std::move(queue);
+    mQueueType = type;
+
+    return OK;
+}
+
 ALooper::handler_id ALooper::registerHandler(const sp<AHandler> &handler) {
     return gLooperRoster.registerHandler(this, handler);
 }
@@ -170,6 +359,22 @@ status_t ALooper::stop() {
 }
 
 void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
+    if (delayUs <= 0 && mQueueType.load(std::memory_order_relaxed) == QUEUE_TYPE_HEAP) {
+        Event event;
+        event.mWhenUs = getNowUs();
+        event.mMessage = msg;
+        event.mToken = nullptr;
+        event.mSequence = mNextSequence.fetch_add(1, std::memory_order_relaxed);
+        mPostedEvents->push(std::move(event));
+
+        // sequentially consistent, see waitQueueChanged_l().
+        if (mLoopWaiting.load()) {
+            Mutex::Autolock autoLock(mLock);
+            mQueueChangedCondition.signal();
+        }
+        return;
+    }
+
     Mutex::Autolock autoLock(mLock);
 
     int64_t whenUs;
@@ -181,21 +386,17 @@ void ALooper::post(const sp<AMessage> &msg, int64_t delayUs) {
         whenUs = getNowUs();
     }
 
-    List<Event>::iterator it = mEventQueue.begin();
-    while (it != mEventQueue.end() && (*it).mWhenUs <= whenUs) {
-        ++it;
-    }
-
     Event event;
     event.mWhenUs = whenUs;
     event.mMessage = msg;
     event.mToken = nullptr;
+    event.mSequence = mNextSequence.fetch_add(1, std::memory_order_relaxed);
 
-    if (it == mEventQueue.begin()) {
+    if (mEventQueue->empty() || whenUs < mEventQueue->front().mWhenUs) {
         mQueueChangedCondition.signal();
     }
 
-    mEventQueue.insert(it, event);
+    mEventQueue->push(std::move(event));
 }
 
 status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token, int64_t delayUs) {
@@ -215,28 +416,18 @@ status_t ALooper::postUnique(const sp<AMessage> &msg, const sp<RefBase> &token,
     // We only need to wake the loop up if we're rescheduling to the earliest event in the queue.
     // This needs to be checked now, before we reschedule the message, in case this message is
     // already at the beginning of the queue.
-    bool shouldAwakeLoop = mEventQueue.empty() || whenUs < mEventQueue.begin()->mWhenUs;
+    bool shouldAwakeLoop = mEventQueue->empty() || whenUs < mEventQueue->front().mWhenUs;
 
     // Erase any previously-posted event with this token.
-    for (auto i = mEventQueue.begin(); i != mEventQueue.end();) {
-        if (i->mToken == token) {
-            i = mEventQueue.erase(i);
-        } else {
-            ++i;
-        }
-    }
-
-    // Find the insertion point for the rescheduled message.
-    List<Event>::iterator i = mEventQueue.begin();
-    while (i != mEventQueue.end() && i->mWhenUs <= whenUs) {
-        ++i;
-    }
+    mEventQueue->eraseToken(token);
 
+    // Insert the rescheduled message.
     Event event;
     event.mWhenUs = whenUs;
     event.mMessage = msg;
     event.mToken = token;
-    mEventQueue.insert(i, event);
+    event.mSequence = mNextSequence.fetch_add(1, std::memory_order_relaxed);
+    mEventQueue->push(std::move(event));
 
     // If we rescheduled the event to be earlier than the first event, then we need to wake up the
     // looper earlier than it was previously scheduled to be woken up. Otherwise, it can sleep until
@@ -256,11 +447,12 @@ bool ALooper::loop() {
         if (mThread == NULL && !mRunningLocally) {
             return false;
         }
-        if (mEventQueue.empty()) {
-            mQueueChangedCondition.wait(mLock);
+        drainPostedEvents_l();
+        if (mEventQueue->empty()) {
+            waitQueueChanged_l(-1 /* timeoutNs */);
             return true;
         }
-        int64_t whenUs = (*mEventQueue.begin()).mWhenUs;
+        int64_t whenUs = mEventQueue->front().mWhenUs;
         int64_t nowUs = getNowUs();
 
         if (whenUs > nowUs) {
@@ -268,13 +460,12 @@ bool ALooper::loop() {
             if (delayUs > INT64_MAX / 1000) {
                 delayUs = INT64_MAX / 1000;
             }
-            mQueueChangedCondition.waitRelative(mLock, delayUs * 1000ll);
+            waitQueueChanged_l(delayUs * 1000ll);
 
             return true;
         }
 
-        event = *mEventQueue.begin();
-        mEventQueue.erase(mEventQueue.begin());
+        event = mEventQueue->popFront();
     }
 
     event.mMessage->deliver();
@@ -287,6 +478,29 @@ bool ALooper::loop() {
     return true;
 }
 
+void ALooper::drainPostedEvents_l() {
+    Event event;
+    while (mPostedEvents->pop(&event)) {
+        mEventQueue->push(std::move(event));
+    }
+}
+
+void ALooper::waitQueueChanged_l(int64_t timeoutNs) {
+    // A lock-free post() pushes its event and then reads mLoopWaiting; here we set
+    // mLoopWaiting and then check for posted events. Both sides are sequentially
+    // consistent, so either we see the event, or the poster sees mLoopWaiting and
+    // signals (after acquiring mLock, so after we started waiting).
+    mLoopWaiting.store(true);
+    if (mPostedEvents->empty()) {
+        if (timeoutNs < 0) {
+            mQueueChangedCondition.wait(mLock);
+        } else {
+            mQueueChangedCondition.waitRelative(mLock, timeoutNs);
+        }
+    }
+    mLoopWaiting.store(false);
+}
+
 // to be called by AMessage::postAndAwaitResponse only
 sp<AReplyToken> ALooper::createReplyToken() {
     return new AReplyToken(this);
@@ -33,6 +33,9 @@
 
 #include <media/stagefright/foundation/hexdump.h>
 
+#include <algorithm>
+#include <type_traits>
+
 #if defined(__ANDROID__) && !defined(__ANDROID_VNDK__) && !defined(__ANDROID_APEX__)
 #include <binder/Parcel.h>
 #endif
@@ -89,8 +92,7 @@ void AMessage::setTarget(const sp<const AHandler> &handler) {
 void AMessage::clear() {
     // Item needs to be handled delicately
     for (Item &item : mItems) {
-        delete[] item.mName;
-        item.mName = NULL;
+        item.freeName();
         freeItemValue(&item);
     }
     mItems.clear();
@@ -150,19 +152,73 @@ static void reportStats() {
 }
 #endif
 
-inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
+// FNV-1a hash of a NUL-terminated item name; also returns its length so that callers
+// only walk the name once.
+// the same hash as the atom table, so that interning a name does not hash it again.
+static inline uint32_t hashName(const char *name, size_t *len) {
+    return AAtomizer::Hash(name, len);
+}
+
+AMessage::ItemVector::~ItemVector() {
+    if (mData != mInline) {
+        delete[] mData;
+    }
+}
+
+AMessage::ItemVector &AMessage::ItemVector::operator=(const ItemVector &other) {
+    static_assert(std::is_trivially_copyable<Item>::value, "items are copied bitwise");
+    if (this != &other) {
+        mSize = 0;
+        reserve(other.mSize);
+        std::copy(other.begin(), other.end(), mData);
+        mSize = other.mSize;
+    }
+    return *this;
+}
+
+void AMessage::ItemVector::reserve(size_t capacity) {
+    if (capacity <= mCapacity) {
+        return;
+    }
+    // grow geometrically, but never beyond what a message may hold
+    capacity = std::min(std::max(capacity, mCapacity * 2), (size_t)kMaxNumItems);
+    Item *data = new Item[capacity];
+    std::copy(begin(), end(), data);
+    if (mData != mInline) {
+        delete[] mData;
+    }
+    mData = data;
+    mCapacity = capacity;
+}
+
+AMessage::Item &AMessage::ItemVector::emplace_back(const char *name, size_t len, uint32_t hash) {
+    reserve(mSize + 1);
+    mData[mSize] = Item(name, len, hash);
+    return mData[mSize++];
+}
+
+void AMessage::ItemVector::resize(size_t size) {
+    reserve(size);
+    for (size_t i = mSize; i < size; ++i) {
+        mData[i] = Item();
+    }
+    mSize = size;
+}
+
+inline size_t AMessage::findItemIndex(const char *name, size_t len, uint32_t hash) const {
 #ifdef DUMP_STATS
     size_t memchecks = 0;
 #endif
     size_t i = 0;
     for (; i < mItems.size(); i++) {
-        if (len != mItems[i].mNameLength) {
+        const Item &item = mItems[i];
+        if (hash != item.mNameHash || len != item.mNameLength) {
             continue;
         }
 #ifdef DUMP_STATS
         ++memchecks;
 #endif
-        if (!memcmp(mItems[i].mName, name, len)) {
+        if (item.mName == name || !memcmp(item.mName, name, len)) {
             break;
         }
     }
@@ -179,22 +235,56 @@ inline size_t AMessage::findItemIndex(const char *name, size_t len) const {
     return i;
 }
 
-// assumes item's name was uninitialized or NULL
-void AMessage::Item::setName(const char *name, size_t len) {
+size_t AMessage::findItemIndex(const char *name) const {
+    size_t len;
+    uint32_t hash = hashName(name, &len);
+    return findItemIndex(name, len, hash);
+}
+
+// assumes item's name was uninitialized, NULL or freed
+void AMessage::Item::setName(const char *name, size_t len, uint32_t hash) {
+    // item names are almost always string literals from a small fixed set, so they are
+    // interned once per process instead of being copied into every message. Once the
+    // atom table is full, new names (e.g. created at runtime) are copied instead.
+    const char *atom = AAtomizer::AtomizeBounded(name, len, hash);
+    if (atom == nullptr) {
+        setOwnedName(name, len, hash);
+        return;
+    }
+    mName = atom;
+    mNameLength = len;
+    mNameHash = hash;
+    mNameOwned = false;
+}
+
+// assumes item's name was uninitialized, NULL or freed
+void AMessage::Item::setOwnedName(const char *name, size_t len, uint32_t hash) {
+    char *copy = new char[len + 1];
+    memcpy(copy, name, len + 1);
+    mName = copy;
     mNameLength = len;
-    mName = new char[len + 1];
-    memcpy((void*)mName, name, len + 1);
+    mNameHash = hash;
+    mNameOwned = true;
+}
+
+void AMessage::Item::freeName() {
+    if (mNameOwned) {
+        delete[] mName;
+        mNameOwned = false;
+    }
+    mName = nullptr;
 }
 
-AMessage::Item::Item(const char *name, size_t len)
+AMessage::Item::Item(const char *name, size_t len, uint32_t hash)
     : mType(kTypeInt32) {
-    // mName and mNameLength are initialized by setName
-    setName(name, len);
+    // mName, mNameLength, mNameHash and mNameOwned are initialized by setName
+    setName(name, len, hash);
 }
 
 AMessage::Item *AMessage::allocateItem(const char *name) {
-    size_t len = strlen(name);
-    size_t i = findItemIndex(name, len);
+    size_t len;
+    uint32_t hash = hashName(name, &len);
+    size_t i = findItemIndex(name, len, hash);
     Item *item;
 
     if (i < mItems.size()) {
@@ -204,8 +294,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
         CHECK(mItems.size() < kMaxNumItems);
         i = mItems.size();
         // place a 'blank' item at the end - this is of type kTypeInt32
-        mItems.emplace_back(name, len);
-        item = &mItems[i];
+        item = &mItems.emplace_back(name, len, hash);
     }
 
     return item;
@@ -213,7 +302,7 @@ AMessage::Item *AMessage::allocateItem(const char *name) {
 
 const AMessage::Item *AMessage::findItem(
         const char *name, Type type) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t i = findItemIndex(name);
     if (i < mItems.size()) {
         const Item *item = &mItems[i];
         return item->mType == type ? item : NULL;
@@ -223,7 +312,7 @@ const AMessage::Item *AMessage::findItem(
 }
 
 bool AMessage::findAsFloat(const char *name, float *value) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t i = findItemIndex(name);
     if (i < mItems.size()) {
         const Item *item = &mItems[i];
         switch (item->mType) {
@@ -250,7 +339,7 @@ bool AMessage::findAsFloat(const char *name, float *value) const {
 }
 
 bool AMessage::findAsInt64(const char *name, int64_t *value) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t i = findItemIndex(name);
     if (i < mItems.size()) {
         const Item *item = &mItems[i];
         switch (item->mType) {
@@ -268,7 +357,7 @@ bool AMessage::findAsInt64(const char *name, int64_t *value) const {
 }
 
 bool AMessage::contains(const char *name) const {
-    size_t i = findItemIndex(name, strlen(name));
+    size_t i = findItemIndex(name);
     return i < mItems.size();
 }
 
@@ -505,7 +594,10 @@ sp<AMessage> AMessage::dup() const {
         const Item *from = &mItems[i];
         Item *to = &msg->mItems[i];
 
-        to->setName(from->mName, from->mNameLength);
+        // interned names are shared; only private copies need duplicating
+        if (from->mNameOwned) {
+            to->setOwnedName(from->mName, from->mNameLength, from->mNameHash);
+        }
         to->mType = from->mType;
 
         switch (from->mType) {
@@ -695,7 +787,7 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
         }
 
         item->mType = static_cast<Type>(parcel.readInt32());
-        // setName() happens below so that we don't leak memory when parsing
+        // setOwnedName() happens below so that we don't leak memory when parsing
         // is aborted in the middle.
         switch (item->mType) {
             case kTypeInt32:
@@ -771,7 +863,9 @@ sp<AMessage> AMessage::FromParcel(const Parcel &parcel, size_t maxNestingLevel)
             }
         }
 
-        item->setName(name, strlen(name));
+        size_t len;
+        uint32_t hash = hashName(name, &len);
+        item->setOwnedName(name, len, hash);
     }
 
     return msg;
@@ -1022,13 +1116,13 @@ status_t AMessage::setEntryNameAt(size_t index, const char *name) {
     if (!strcmp(name, mItems[index].mName)) {
         return OK; // name has not changed
     }
-    size_t len = strlen(name);
-    if (findItemIndex(name, len) < mItems.size()) {
+    size_t len;
+    uint32_t hash = hashName(name, &len);
+    if (findItemIndex(name, len, hash) < mItems.size()) {
         return ALREADY_EXISTS;
     }
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
-    mItems[index].setName(name, len);
+    mItems[index].freeName();
+    mItems[index].setName(name, len, hash);
     return OK;
 }
 
@@ -1091,8 +1185,7 @@ status_t AMessage::removeEntryAt(size_t index) {
         return BAD_INDEX;
     }
     // delete entry data and objects
-    delete[] mItems[index].mName;
-    mItems[index].mName = nullptr;
+    mItems[index].freeName();
     freeItemValue(&mItems[index]);
 
     // swap entry with last entry and clear last entry's data
@@ -1100,6 +1193,7 @@ status_t AMessage::removeEntryAt(size_t index) {
     if (index < lastIndex) {
         mItems[index] = mItems[lastIndex];
         mItems[lastIndex].mName = nullptr;
+        mItems[lastIndex].mNameOwned = false;
         mItems[lastIndex].mType = kTypeInt32;
     }
     mItems.pop_back();
@@ -1121,7 +1215,7 @@ void AMessage::setItem(const char *name, const ItemData &item) {
     if (item.used()) {
         Item *it = allocateItem(name);
         if (it != nullptr) {
-            setEntryAt(it - &mItems[0], item);
+            setEntryAt(it - mItems.begin(), item);
         }
     }
 }
@@ -1140,13 +1234,13 @@ void AMessage::extend(const sp<AMessage> &other) {
         Item *it = allocateItem(other->mItems[ix].mName);
         if (it != nullptr) {
             ItemData data = other->getEntryAt(ix);
-            setEntryAt(it - &mItems[0], data);
+            setEntryAt(it - mItems.begin(), data);
         }
     }
 }
 
 size_t AMessage::findEntryByName(const char *name) const {
-    return name == nullptr ? countEntries() : findItemIndex(name, strlen(name));
+    return name == nullptr ? countEntries() : findItemIndex(name);
 }
 
 }  // namespace android
@@ -17,13 +17,16 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "MetaDataBase"
 #include <inttypes.h>
-#include <utils/KeyedVector.h>
 #include <utils/Log.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
 #include <mutex>
+#include <type_traits>
+#include <vector>
 
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AString.h>
@@ -42,6 +45,9 @@ struct MetaDataBase::typed_data {
 
     typed_data(const MetaDataBase::typed_data &);
     typed_data &operator=(const MetaDataBase::typed_data &);
+    // noexcept, so that std::vector moves the items when it reallocates.
+    typed_data(MetaDataBase::typed_data &&) noexcept;
+    typed_data &operator=(MetaDataBase::typed_data &&) noexcept;
 
     void clear();
     void setData(uint32_t type, const void *data, size_t size);
@@ -53,9 +59,10 @@ private:
     uint32_t mType;
     size_t mSize;
 
+    // values up to the size of a Rect (all fixed-size types) are stored inline.
     union {
         void *ext_data;
-        float reservoir;
+        int64_t reservoir[2];
     } u;
 
     bool usesReservoir() const {
@@ -63,7 +70,7 @@ private:
     }
 
     void *allocateStorage(size_t size);
-    void freeStorage();
+    void freeStorage() noexcept;
 
     void *storage() {
         return usesReservoir() ? &u.reservoir : u.ext_data;
@@ -79,9 +86,82 @@ struct MetaDataBase::Rect {
 };
 
 
+// Items sorted by key, with keys and values in separate arrays so that lookups only touch
+// the keys. A store is immutable while it is shared between MetaDataBase instances.
+struct MetaDataBase::ItemStore {
+    static_assert(std::is_nothrow_move_constructible_v<MetaDataBase::typed_data>);
+    static_assert(std::is_nothrow_move_assignable_v<MetaDataBase::typed_data>);
+
+    std::vector<uint32_t> mKeys;
+    std::vector<MetaDataBase::typed_data> mValues;
+
+    ItemStore() : mRefCount(0) { }
+    ItemStore(const ItemStore &from)
+        : mKeys(from.mKeys), mValues(from.mValues), mRefCount(0) { }
+
+    // for sp<>
+    void incStrong(const void * /* id */) const {
+        mRefCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void decStrong(const void * /* id */) const {
+        if (mRefCount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+    // Returns true if other references exist. A store only becomes shared through its
+    // owner, so a false result is stable while the owner's lock is held; the acquire
+    // pairs with the release of other references so their reads happen before our writes.
+    bool isShared() const {
+        return mRefCount.load(std::memory_order_acquire) > 1;
+    }
+
+    size_t size() const {
+        return mKeys.size();
+    }
+
+    // returns the index of |key|, or -1 if not found
+    ssize_t indexOfKey(uint32_t key) const {
+        auto it = std::lower_bound(mKeys.begin(), mKeys.end(), key);
+        if (it == mKeys.end() || *it != key) {
+            return -1;
+        }
+        return it - mKeys.begin();
+    }
+
+private:
+    mutable std::atomic<int32_t> mRefCount;
+
+    ItemStore &operator=(const ItemStore &) = delete;
+};
+
 struct MetaDataBase::MetaDataInternal {
     std::mutex mLock;
-    KeyedVector<uint32_t, MetaDataBase::typed_data> mItems;
+    // copy-on-write backing store, null when empty
+    sp<ItemStore> mItems;
+
+    // returns a store that is safe to modify, unsharing it if necessary.
+    ItemStore *editItems_l() {
+        if (mItems == nullptr) {
+            mItems = new ItemStore();
+        } else if (mItems->isShared()) {
+            mItems = new ItemStore(*mItems);
+        }
+        return mItems.get();
+    }
+
+    sp<ItemStore> items() {
+        std::lock_guard<std::mutex> guard(mLock);
+        return mItems;
+    }
+
+    void setItems(sp<ItemStore> items) {
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            std::swap(mItems, items);
+        }
+        // the previous store, if any, is released outside the lock
+    }
 };
 
 
@@ -91,11 +171,13 @@ MetaDataBase::MetaDataBase()
 
 MetaDataBase::MetaDataBase(const MetaDataBase &from)
     : mInternalData(new MetaDataInternal()) {
-    mInternalData->mItems = from.mInternalData->mItems;
+    mInternalData->mItems = from.mInternalData->items();
 }
 
 MetaDataBase& MetaDataBase::operator = (const MetaDataBase &rhs) {
-    this->mInternalData->mItems = rhs.mInternalData->mItems;
+    if (this != &rhs) {
+        mInternalData->setItems(rhs.mInternalData->items());
+    }
     return *this;
 }
 
@@ -105,19 +187,23 @@ MetaDataBase::~MetaDataBase() {
 }
 
 void MetaDataBase::clear() {
-    std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    mInternalData->mItems.clear();
+    mInternalData->setItems(sp<ItemStore>());
 }
 
 bool MetaDataBase::remove(uint32_t key) {
     std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    ssize_t i = mInternalData->mItems.indexOfKey(key);
+    if (mInternalData->mItems == nullptr) {
+        return false;
+    }
+    ssize_t i = mInternalData->mItems->indexOfKey(key);
 
     if (i < 0) {
         return false;
     }
 
-    mInternalData->mItems.removeItemsAt(i);
+    ItemStore *items = mInternalData->editItems_l();
+    items->mKeys.erase(items->mKeys.begin() + i);
+    items->mValues.erase(items->mValues.begin() + i);
 
     return true;
 }
@@ -258,15 +344,17 @@ bool MetaDataBase::setData(
     bool overwrote_existing = true;
 
     std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    ssize_t i = mInternalData->mItems.indexOfKey(key);
-    if (i < 0) {
-        typed_data item;
-        i = mInternalData->mItems.add(key, item);
+    ItemStore *items = mInternalData->editItems_l();
+    auto it = std::lower_bound(items->mKeys.begin(), items->mKeys.end(), key);
+    size_t i = it - items->mKeys.begin();
+    if (it == items->mKeys.end() || *it != key) {
+        items->mKeys.insert(it, key);
+        items->mValues.emplace(items->mValues.begin() + i);
 
         overwrote_existing = false;
     }
 
-    typed_data &item = mInternalData->mItems.editValueAt(i);
+    typed_data &item = items->mValues[i];
 
     item.setData(type, data, size);
 
@@ -276,13 +364,14 @@ bool MetaDataBase::setData(
 bool MetaDataBase::findData(uint32_t key, uint32_t *type,
                         const void **data, size_t *size) const {
     std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    ssize_t i = mInternalData->mItems.indexOfKey(key);
+    const ItemStore *items = mInternalData->mItems.get();
+    ssize_t i = items == nullptr ? -1 : items->indexOfKey(key);
 
     if (i < 0) {
         return false;
     }
 
-    const typed_data &item = mInternalData->mItems.valueAt(i);
+    const typed_data &item = items->mValues[i];
 
     item.getData(type, data, size);
 
@@ -291,13 +380,8 @@ bool MetaDataBase::findData(uint32_t key, uint32_t *type,
 
 bool MetaDataBase::hasData(uint32_t key) const {
     std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    ssize_t i = mInternalData->mItems.indexOfKey(key);
-
-    if (i < 0) {
-        return false;
-    }
-
-    return true;
+    const ItemStore *items = mInternalData->mItems.get();
+    return items != nullptr && items->indexOfKey(key) >= 0;
 }
 
 MetaDataBase::typed_data::typed_data()
@@ -333,6 +417,29 @@ MetaDataBase::typed_data &MetaDataBase::typed_data::operator=(
     return *this;
 }
 
+MetaDataBase::typed_data::typed_data(typed_data &&from) noexcept
+    : mType(from.mType),
+      mSize(from.mSize),
+      u(from.u) {
+    // external storage is now owned by us
+    from.mType = 0;
+    from.mSize = 0;
+}
+
+MetaDataBase::typed_data &MetaDataBase::typed_data::operator=(
+        MetaDataBase::typed_data &&from) noexcept {
+    if (this != &from) {
+        clear();
+        mType = from.mType;
+        mSize = from.mSize;
+        u = from.u;
+        from.mType = 0;
+        from.mSize = 0;
+    }
+
+    return *this;
+}
+
 void MetaDataBase::typed_data::clear() {
     freeStorage();
 
@@ -373,7 +480,7 @@ void *MetaDataBase::typed_data::allocateStorage(size_t size) {
     return u.ext_data;
 }
 
-void MetaDataBase::typed_data::freeStorage() {
+void MetaDataBase::typed_data::freeStorage() noexcept {
     if (!usesReservoir()) {
         if (u.ext_data) {
             free(u.ext_data);
@@ -437,12 +544,12 @@ static void MakeFourCCString(uint32_t x, char *s) {
 
 String8 MetaDataBase::toString() const {
     String8 s;
-    std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    for (int i = mInternalData->mItems.size(); --i >= 0;) {
-        int32_t key = mInternalData->mItems.keyAt(i);
+    sp<ItemStore> items = mInternalData->items();
+    for (int i = items == nullptr ? 0 : items->size(); --i >= 0;) {
+        int32_t key = items->mKeys[i];
         char cc[5];
         MakeFourCCString(key, cc);
-        const typed_data &item = mInternalData->mItems.valueAt(i);
+        const typed_data &item = items->mValues[i];
         s.appendFormat("%s: %s", cc, item.asString(false).c_str());
         if (i != 0) {
             s.append(", ");
@@ -452,12 +559,12 @@ String8 MetaDataBase::toString() const {
 }
 
 void MetaDataBase::dumpToLog() const {
-    std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    for (int i = mInternalData->mItems.size(); --i >= 0;) {
-        int32_t key = mInternalData->mItems.keyAt(i);
+    sp<ItemStore> items = mInternalData->items();
+    for (int i = items == nullptr ? 0 : items->size(); --i >= 0;) {
+        int32_t key = items->mKeys[i];
         char cc[5];
         MakeFourCCString(key, cc);
-        const typed_data &item = mInternalData->mItems.valueAt(i);
+        const typed_data &item = items->mValues[i];
         ALOGI("%s: %s", cc, item.asString(true /* verbose */).c_str());
     }
 }
@@ -465,15 +572,15 @@ void MetaDataBase::dumpToLog() const {
 #if defined(__ANDROID__) && !defined(__ANDROID_VNDK__) && !defined(__ANDROID_APEX__)
 status_t MetaDataBase::writeToParcel(Parcel &parcel) {
     status_t ret;
-    std::lock_guard<std::mutex> guard(mInternalData->mLock);
-    size_t numItems = mInternalData->mItems.size();
+    sp<ItemStore> items = mInternalData->items();
+    size_t numItems = items == nullptr ? 0 : items->size();
     ret = parcel.writeUint32(uint32_t(numItems));
     if (ret) {
         return ret;
     }
     for (size_t i = 0; i < numItems; i++) {
-        int32_t key = mInternalData->mItems.keyAt(i);
-        const typed_data &item = mInternalData->mItems.valueAt(i);
+        int32_t key = items->mKeys[i];
+        const typed_data &item = items->mValues[i];
         uint32_t type;
         const void *data;
         size_t size;
@@ -28,8 +28,72 @@
 #include <media/stagefright/MetaData.h>
 #include <utils/misc.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace android {
 
+// Returns the offset of the first |00 00 last| sequence in |data|, or |size| if there is none.
+template<uint8_t last>
+static size_t findZeroZeroByte(const uint8_t *data, size_t size) {
+    size_t offset = 0;
+
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lastByte = _mm_set1_epi8(last);
+    for (; offset + 18 <= size; offset += 16) {
+        // Candidate positions offset..offset+15 need the two following bytes too.
+        const __m128i b0 = _mm_loadu_si128((const __m128i *)&data[offset]);
+        const __m128i b1 = _mm_loadu_si128((const __m128i *)&data[offset + 1]);
+        const __m128i b2 = _mm_loadu_si128((const __m128i *)&data[offset + 2]);
+        const __m128i match = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                _mm_cmpeq_epi8(b2, lastByte));
+        const unsigned mask = _mm_movemask_epi8(match);
+        if (mask != 0) {
+            return offset + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__ARM_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t lastByte = vdupq_n_u8(last);
+    for (; offset + 18 <= size; offset += 16) {
+        const uint8x16_t match = vandq_u8(
+                vandq_u8(vceqq_u8(vld1q_u8(&data[offset]), zero),
+                         vceqq_u8(vld1q_u8(&data[offset + 1]), zero)),
+                vceqq_u8(vld1q_u8(&data[offset + 2]), lastByte));
+#if defined(__aarch64__)
+        const bool found = vmaxvq_u8(match) != 0;
+#else
+        const uint64x2_t match64 = vreinterpretq_u64_u8(match);
+        const bool found =
+                (vgetq_lane_u64(match64, 0) | vgetq_lane_u64(match64, 1)) != 0;
+#endif
+        if (found) {
+            break;
+        }
+    }
+#endif
+
+    for (; offset + 2 < size; ++offset) {
+        if (data[offset + 2] == last && data[offset] == 0x00 && data[offset + 1] == 0x00) {
+            return offset;
+        }
+    }
+    return size;
+}
+
+size_t findNextStartCode(const uint8_t *data, size_t size) {
+    return findZeroZeroByte<0x01>(data, size);
+}
+
+size_t findNextEmulationPrevention(const uint8_t *data, size_t size) {
+    return findZeroZeroByte<0x03>(data, size);
+}
+
 unsigned parseUE(ABitReader *br) {
     unsigned numZeroes = 0;
     while (br->getBits(1) == 0) {
@@ -302,17 +366,10 @@ status_t getNextNALUnit(
         return -EAGAIN;
     }
 
-    size_t offset = 0;
-
     // A valid startcode consists of at least two 0x00 bytes followed by 0x01.
-    for (; offset + 2 < size; ++offset) {
-        if (data[offset + 2] == 0x01 && data[offset] == 0x00
-                && data[offset + 1] == 0x00) {
-            break;
-        }
-    }
-    if (offset + 2 >= size) {
-        *_data = &data[offset];
+    size_t offset = findNextStartCode(data, size);
+    if (offset == size) {
+        *_data = &data[size - 2];
         *_size = 2;
         return -EAGAIN;
     }
@@ -320,25 +377,15 @@ status_t getNextNALUnit(
 
     size_t startOffset = offset;
 
-    for (;;) {
-        while (offset < size && data[offset] != 0x01) {
-            ++offset;
-        }
-
-        if (offset == size) {
-            if (startCodeFollows) {
-                offset = size + 2;
-                break;
-            }
-
+    // |offset| is left at the 0x01 of the next startcode.
+    size_t nextOffset = findNextStartCode(&data[startOffset], size - startOffset);
+    if (nextOffset == size - startOffset) {
+        if (!startCodeFollows) {
             return -EAGAIN;
         }
-
-        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
-            break;
-        }
-
-        ++offset;
+        offset = size + 2;
+    } else {
+        offset = startOffset + nextOffset + 2;
     }
 
     size_t endOffset = offset - 2;
@@ -20,10 +20,10 @@
 
 #include <stdint.h>
 
+#include <atomic>
+
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AString.h>
-#include <utils/List.h>
-#include <utils/Vector.h>
 #include <utils/threads.h>
 
 namespace android {
@@ -31,17 +31,51 @@ namespace android {
 struct AAtomizer {
     static const char *Atomize(const char *name);
 
+    // Returns the atom for |name|, whose length is |len| and whose Hash() is |hash|, if it
+    // is already known or fewer than kMaxAtoms atoms exist. Otherwise returns NULL, so that
+    // names created at runtime cannot grow the table without bound.
+    static const char *AtomizeBounded(const char *name, size_t len, uint32_t hash);
+
+    // Returns the hash of |s| used by the atom table, and stores its length in |len|.
+    static inline uint32_t Hash(const char *s, size_t *len) {
+        uint32_t hash = 2166136261u;
+        const char *p = s;
+        for (; *p != '\0'; ++p) {
+            hash = (hash ^ static_cast<uint8_t>(*p)) * 16777619u;
+        }
+        *len = p - s;
+        return hash;
+    }
+
+    enum {
+        kMaxAtoms = 1024,
+    };
+
 private:
-    static AAtomizer gAtomizer;
+    // Atoms are never removed and do not change once published, so they are looked up
+    // without taking mLock.
+    struct Atom {
+        const Atom *mNext;
+        uint32_t mHash;
+        size_t mLength;
+        AString mName;
+    };
+
+    enum {
+        kNumBuckets = 128,
+    };
 
-    Mutex mLock;
-    Vector<List<AString> > mAtoms;
+    Mutex mLock;  // held while adding an atom
+    std::atomic<const Atom *> mBuckets[kNumBuckets];
+    size_t mNumAtoms;
 
     AAtomizer();
 
-    const char *atomize(const char *name);
+    static AAtomizer *Get();
+
+    const char *atomize(const char *name, size_t len, uint32_t hash, bool bounded);
 
-    static uint32_t Hash(const char *s);
+    static const char *Find(const Atom *atom, const char *name, size_t len, uint32_t hash);
 
     DISALLOW_EVIL_CONSTRUCTORS(AAtomizer);
 };
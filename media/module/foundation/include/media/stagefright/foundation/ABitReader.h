@@ -81,6 +81,13 @@ public:
 private:
     int32_t mNumZeros;
 
+    // No emulation_prevention_three_byte lies in [mScanStart, mNextEmulationPrevention), so
+    // whole words can be loaded into the reservoir up to there.
+    const uint8_t *mScanStart;
+    const uint8_t *mNextEmulationPrevention;
+
+    void findNextEmulationPreventionByte();
+
     virtual bool fillReservoir();
 
     DISALLOW_EVIL_CONSTRUCTORS(NALBitReader);
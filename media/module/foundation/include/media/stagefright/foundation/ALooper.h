@@ -18,6 +18,9 @@
 
 #define A_LOOPER_H_
 
+#include <atomic>
+#include <memory>
+
 #include <media/stagefright/foundation/ABase.h>
 #include <media/stagefright/foundation/AString.h>
 #include <utils/Errors.h>
@@ -36,11 +39,26 @@ struct ALooper : public RefBase {
     typedef int32_t event_id;
     typedef int32_t handler_id;
 
+    enum queue_type_t {
+        // Events are kept in a list sorted by delivery time. Posting is O(n)
+        // in the number of pending events.
+        QUEUE_TYPE_LIST,
+        // Delayed events are kept in a binary heap, and events posted without delay
+        // are handed to the looper thread through a lock-free queue.
+        // Suited for loopers with many producer threads or many pending events.
+        QUEUE_TYPE_HEAP,
+    };
+
     ALooper();
 
     // Takes effect in a subsequent call to start().
     void setName(const char *name);
 
+    // Selects the event queue implementation. The default is QUEUE_TYPE_LIST.
+    // Must be called before start(), returns INVALID_OPERATION otherwise.
+    // Events already posted are kept.
+    status_t setQueueType(queue_type_t type);
+
     handler_id registerHandler(const sp<AHandler> &handler);
     void unregisterHandler(handler_id handlerID);
 
@@ -71,14 +89,30 @@ private:
         int64_t mWhenUs;
         sp<AMessage> mMessage;
         sp<RefBase> mToken;
+        // post order, taken when posted: breaks ties between events with the same delivery time
+        uint64_t mSequence;
     };
 
+    struct EventQueue;
+    struct ListEventQueue;
+    struct HeapEventQueue;
+    struct PostedEventQueue;
+
     Mutex mLock;
     Condition mQueueChangedCondition;
 
     AString mName;
 
-    List<Event> mEventQueue;
+    std::atomic<queue_type_t> mQueueType;
+    std::unique_ptr<EventQueue> mEventQueue;
+
+    // Events posted without delay and token for QUEUE_TYPE_HEAP, without holding mLock.
+    // The looper thread moves them to mEventQueue.
+    std::unique_ptr<PostedEventQueue> mPostedEvents;
+    // true while the looper thread waits on mQueueChangedCondition.
+    std::atomic<bool> mLoopWaiting;
+    // the mSequence of the next posted event, shared by the locked and lock-free posts.
+    std::atomic<uint64_t> mNextSequence;
 
     struct LooperThread;
     sp<LooperThread> mThread;
@@ -112,6 +146,11 @@ private:
 
     bool loop();
 
+    // moves events from mPostedEvents into mEventQueue.
+    void drainPostedEvents_l();
+    // waits for a queue change, or for timeoutNs if positive.
+    void waitQueueChanged_l(int64_t timeoutNs);
+
     DISALLOW_EVIL_CONSTRUCTORS(ALooper);
 };
 
@@ -307,18 +307,63 @@ private:
             AString *stringValue;
             Rect rectValue;
         } u;
+        // mName is interned by AAtomizer unless mNameOwned is set, in which case it is a
+        // private copy that is freed with the item (used for names read from a Parcel, so
+        // that untrusted input cannot grow the process-wide atom table, and for new names
+        // once that table is full).
         const char *mName;
         size_t      mNameLength;
+        uint32_t    mNameHash;
         Type mType;
-        void setName(const char *name, size_t len);
-        Item() : mName(nullptr), mNameLength(0), mType(kTypeInt32) { }
-        Item(const char *name, size_t length);
+        bool        mNameOwned;
+        void setName(const char *name, size_t len, uint32_t hash);
+        void setOwnedName(const char *name, size_t len, uint32_t hash);
+        void freeName();
+        Item() : mName(nullptr), mNameLength(0), mNameHash(0), mType(kTypeInt32),
+                mNameOwned(false) { }
+        Item(const char *name, size_t length, uint32_t hash);
     };
 
     enum {
-        kMaxNumItems = 256
+        kMaxNumItems = 256,
+        // number of items stored inline in the message before spilling to the heap
+        kNumInlineItems = 8,
     };
-    std::vector<Item> mItems;
+
+    /**
+     * Contiguous item storage that keeps up to kNumInlineItems items inside the message, so
+     * that common messages do not allocate for their items. Items are trivially copyable; the
+     * owner is responsible for names and values.
+     */
+    class ItemVector {
+    public:
+        ItemVector() : mData(mInline), mSize(0), mCapacity(kNumInlineItems) { }
+        ItemVector(const ItemVector &) = delete;
+        ~ItemVector();
+        ItemVector &operator=(const ItemVector &other);
+
+        size_t size() const { return mSize; }
+        Item &operator[](size_t i) { return mData[i]; }
+        const Item &operator[](size_t i) const { return mData[i]; }
+        Item *begin() { return mData; }
+        Item *end() { return mData + mSize; }
+        const Item *begin() const { return mData; }
+        const Item *end() const { return mData + mSize; }
+
+        Item &emplace_back(const char *name, size_t len, uint32_t hash);
+        void pop_back() { --mSize; }
+        void resize(size_t size);
+        void clear() { mSize = 0; }
+
+    private:
+        void reserve(size_t capacity);
+
+        Item mInline[kNumInlineItems];
+        Item *mData;
+        size_t mSize;
+        size_t mCapacity;
+    };
+    ItemVector mItems;
 
     /**
      * Allocates an item with the given key |name|. If the key already exists, the corresponding
@@ -349,7 +394,9 @@ private:
     void setObjectInternal(
             const char *name, const sp<RefBase> &obj, Type type);
 
-    size_t findItemIndex(const char *name, size_t len) const;
+    /** Returns the index of the item with key |name| of |len| and |hash|, or countEntries(). */
+    size_t findItemIndex(const char *name, size_t len, uint32_t hash) const;
+    size_t findItemIndex(const char *name) const;
 
     void deliver();
 
@@ -75,6 +75,14 @@ inline void skipSE(ABitReader *br) {
     (void)parseSEWithFallback(br, 0);
 }
 
+// Returns the offset of the first 00 00 01 start code prefix in |data|, or |size| if there is
+// none. Scans 16 bytes at a time where SSE2 or NEON is available.
+size_t findNextStartCode(const uint8_t *data, size_t size);
+
+// Returns the offset of the first 00 00 03 sequence in |data|, i.e. two bytes before the first
+// emulation_prevention_three_byte, or |size| if there is none.
+size_t findNextEmulationPrevention(const uint8_t *data, size_t size);
+
 status_t getNextNALUnit(
         const uint8_t **_data, size_t *_size,
         const uint8_t **nalStart, size_t *nalSize,
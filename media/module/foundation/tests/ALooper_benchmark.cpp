@@ -0,0 +1,148 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/foundation/AHandler.h>
+#include <media/stagefright/foundation/ALooper.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+/*
+ * Measures post() to onMessageReceived() latency of an ALooper with 1, 4 and 16
+ * producer threads posting messages without delay, while a backlog of delayed
+ * messages is pending, for each queue type.
+ */
+
+static constexpr size_t kMessagesPerProducer = 1000;
+static constexpr size_t kDelayedBacklog = 256;
+
+class LatencyHandler : public AHandler {
+public:
+    enum {
+        kWhatPost,
+        kWhatDelayed,
+    };
+
+    void expect(size_t count) {
+        std::lock_guard<std::mutex> lock(mLock);
+        mExpected = count;
+        mReceived = 0;
+        mLatencySumUs = 0;
+        mLatencyMaxUs = 0;
+    }
+
+    void waitForAll() {
+        std::unique_lock<std::mutex> lock(mLock);
+        mCondition.wait(lock, [this] { return mReceived >= mExpected; });
+    }
+
+    int64_t latencySumUs() const { return mLatencySumUs; }
+    int64_t latencyMaxUs() const { return mLatencyMaxUs; }
+
+protected:
+    void onMessageReceived(const sp<AMessage> &msg) override {
+        if (msg->what() != kWhatPost) {
+            return;
+        }
+        int64_t postUs;
+        if (!msg->findInt64("postUs", &postUs)) {
+            return;
+        }
+        const int64_t latencyUs = ALooper::GetNowUs() - postUs;
+        std::lock_guard<std::mutex> lock(mLock);
+        mLatencySumUs += latencyUs;
+        mLatencyMaxUs = std::max(mLatencyMaxUs, latencyUs);
+        if (++mReceived >= mExpected) {
+            mCondition.notify_one();
+        }
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    size_t mExpected = 0;
+    size_t mReceived = 0;
+    int64_t mLatencySumUs = 0;
+    int64_t mLatencyMaxUs = 0;
+};
+
+static void BM_ALooperPostDeliver(benchmark::State& state) {
+    const auto queueType = static_cast<ALooper::queue_type_t>(state.range(0));
+    const size_t producers = state.range(1);
+
+    sp<ALooper> looper = new ALooper;
+    looper->setName("ALooper_benchmark");
+    looper->setQueueType(queueType);
+    sp<LatencyHandler> handler = new LatencyHandler;
+    looper->registerHandler(handler);
+    looper->start();
+
+    // delayed events that stay pending for the whole benchmark.
+    for (size_t i = 0; i < kDelayedBacklog; ++i) {
+        sp<AMessage> msg = new AMessage(LatencyHandler::kWhatDelayed, handler);
+        msg->post(3600000000LL /* delayUs */ + i);
+    }
+
+    int64_t latencySumUs = 0;
+    int64_t latencyMaxUs = 0;
+    for (auto _ : state) {
+        handler->expect(producers * kMessagesPerProducer);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < producers; ++i) {
+            threads.emplace_back([&handler] {
+                for (size_t j = 0; j < kMessagesPerProducer; ++j) {
+                    sp<AMessage> msg = new AMessage(LatencyHandler::kWhatPost, handler);
+                    msg->setInt64("postUs", ALooper::GetNowUs());
+                    msg->post();
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        handler->waitForAll();
+        latencySumUs += handler->latencySumUs();
+        latencyMaxUs = std::max(latencyMaxUs, handler->latencyMaxUs());
+    }
+
+    looper->unregisterHandler(handler->id());
+    looper->stop();
+
+    const int64_t messages = state.iterations() * producers * kMessagesPerProducer;
+    state.SetItemsProcessed(messages);
+    state.counters["latency_mean_us"] = messages > 0 ? (double)latencySumUs / messages : 0.;
+    state.counters["latency_max_us"] = latencyMaxUs;
+}
+
+static void ALooperArgs(benchmark::internal::Benchmark* b) {
+    for (int queueType : {ALooper::QUEUE_TYPE_LIST, ALooper::QUEUE_TYPE_HEAP}) {
+        for (int producers : {1, 4, 16}) {
+            b->Args({queueType, producers});
+        }
+    }
+}
+
+BENCHMARK(BM_ALooperPostDeliver)->Apply(ALooperArgs)->ArgNames({"queue", "producers"})
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/foundation/AMessage.h>
+
+using namespace android;
+
+/*
+ * Compares set/find/dup throughput of AMessage against a model of the previous item
+ * storage (std::vector of items with heap allocated names and length + memcmp lookup),
+ * for message sizes typical of per-buffer MediaCodec notifications (4) and output
+ * formats (16).
+ */
+
+static const char *const kKeys[] = {
+    "index", "offset", "size", "timeUs", "flags", "what", "buffer", "mime",
+    "width", "height", "stride", "slice-height", "color-format", "color-range",
+    "color-standard", "color-transfer",
+};
+static constexpr size_t kMaxKeys = sizeof(kKeys) / sizeof(kKeys[0]);
+
+class LegacyItems {
+public:
+    LegacyItems() = default;
+    LegacyItems(const LegacyItems &other) : mItems(other.mItems) {
+        for (Item &item : mItems) {
+            item.setName(item.mName, item.mNameLength);
+        }
+    }
+    ~LegacyItems() {
+        for (Item &item : mItems) {
+            delete[] item.mName;
+        }
+    }
+
+    void setInt64(const char *name, int64_t value) {
+        size_t len = strlen(name);
+        size_t i = findItemIndex(name, len);
+        if (i == mItems.size()) {
+            mItems.emplace_back();
+            mItems.back().setName(name, len);
+        }
+        mItems[i].mValue = value;
+    }
+
+    bool findInt64(const char *name, int64_t *value) const {
+        size_t i = findItemIndex(name, strlen(name));
+        if (i < mItems.size()) {
+            *value = mItems[i].mValue;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Item {
+        int64_t mValue = 0;
+        const char *mName = nullptr;
+        size_t mNameLength = 0;
+        void setName(const char *name, size_t len) {
+            mNameLength = len;
+            char *copy = new char[len + 1];
+            memcpy(copy, name, len + 1);
+            mName = copy;
+        }
+    };
+
+    size_t findItemIndex(const char *name, size_t len) const {
+        size_t i = 0;
+        for (; i < mItems.size(); i++) {
+            if (len == mItems[i].mNameLength && !memcmp(mItems[i].mName, name, len)) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    std::vector<Item> mItems;
+};
+
+static void BM_AMessageSet(benchmark::State& state) {
+    const size_t numKeys = state.range(0);
+    for (auto _ : state) {
+        sp<AMessage> msg = new AMessage;
+        for (size_t i = 0; i < numKeys; ++i) {
+            msg->setInt64(kKeys[i], i);
+        }
+        benchmark::DoNotOptimize(msg.get());
+    }
+    state.SetItemsProcessed(state.iterations() * numKeys);
+}
+
+static void BM_LegacySet(benchmark::State& state) {
+    const size_t numKeys = state.range(0);
+    for (auto _ : state) {
+        LegacyItems *items = new LegacyItems;
+        for (size_t i = 0; i < numKeys; ++i) {
+            items->setInt64(kKeys[i], i);
+        }
+        benchmark::DoNotOptimize(items);
+        delete items;
+    }
+    state.SetItemsProcessed(state.iterations() * numKeys);
+}
+
+static void BM_AMessageFind(benchmark::State& state) {
+    const size_t numKeys = state.range(0);
+    sp<AMessage> msg = new AMessage;
+    for (size_t i = 0; i < numKeys; ++i) {
+        msg->setInt64(kKeys[i], i);
+    }
+    int64_t value;
+    for (auto _ : state) {
+        for (size_t i = 0; i < numKeys; ++i) {
+            benchmark::DoNotOptimize(msg->findInt64(kKeys[i], &value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numKeys);
+}
+
+static void BM_LegacyFind(benchmark::State& state) {
+    const size_t numKeys = state.range(0);
+    LegacyItems items;
+    for (size_t i = 0; i < numKeys; ++i) {
+        items.setInt64(kKeys[i], i);
+    }
+    int64_t value;
+    for (auto _ : state) {
+        for (size_t i = 0; i < numKeys; ++i) {
+            benchmark::DoNotOptimize(items.findInt64(kKeys[i], &value));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * numKeys);
+}
+
+static void BM_AMessageDup(benchmark::State& state) {
+    const size_t numKeys = state.range(0);
+    sp<AMessage> msg = new AMessage;
+    for (size_t i = 0; i < numKeys; ++i) {
+        msg->setInt64(kKeys[i], i);
+    }
+    for (auto _ : state) {
+        sp<AMessage> copy = msg->dup();
+        benchmark::DoNotOptimize(copy.get());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_LegacyDup(benchmark::State& state) {
+    const size_t numKeys = state.range(0);
+    LegacyItems items;
+    for (size_t i = 0; i < numKeys; ++i) {
+        items.setInt64(kKeys[i], i);
+    }
+    for (auto _ : state) {
+        LegacyItems *copy = new LegacyItems(items);
+        benchmark::DoNotOptimize(copy);
+        delete copy;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_AMessageSet)->Arg(4)->Arg(kMaxKeys);
+BENCHMARK(BM_LegacySet)->Arg(4)->Arg(kMaxKeys);
+BENCHMARK(BM_AMessageFind)->Arg(4)->Arg(kMaxKeys);
+BENCHMARK(BM_LegacyFind)->Arg(4)->Arg(kMaxKeys);
+BENCHMARK(BM_AMessageDup)->Arg(4)->Arg(kMaxKeys);
+BENCHMARK(BM_LegacyDup)->Arg(4)->Arg(kMaxKeys);
+
+BENCHMARK_MAIN();
@@ -21,6 +21,7 @@
 #include <gtest/gtest.h>
 #include <utils/RefBase.h>
 
+#include <media/stagefright/foundation/AAtomizer.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/foundation/AHandler.h>
 #include <media/stagefright/foundation/ALooper.h>
@@ -169,6 +170,84 @@ TEST(AMessage_tests, settersAndGetters) {
   EXPECT_NE(OK, m1->removeEntryByName("notpresent"));
 }
 
+TEST(AMessage_tests, manyItemsRenameAndDup) {
+  sp<AMessage> m1 = new AMessage();
+
+  // enough items to outgrow the inline item storage
+  constexpr int32_t kNumItems = 40;
+  for (int32_t i = 0; i < kNumItems; ++i) {
+    m1->setInt32(AStringPrintf("key%d", i).c_str(), i);
+  }
+  m1->setString("name", "value");
+  EXPECT_EQ(kNumItems + 1, m1->countEntries());
+
+  int32_t i32;
+  for (int32_t i = 0; i < kNumItems; ++i) {
+    EXPECT_TRUE(m1->findInt32(AStringPrintf("key%d", i).c_str(), &i32));
+    EXPECT_EQ(i, i32);
+  }
+  // same length and prefix as existing keys
+  EXPECT_FALSE(m1->findInt32("key99", &i32));
+
+  // renaming must not collide with an existing key
+  size_t index = m1->findEntryByName("key3");
+  EXPECT_EQ(ALREADY_EXISTS, m1->setEntryNameAt(index, "key4"));
+  EXPECT_EQ(OK, m1->setEntryNameAt(index, "renamed"));
+  EXPECT_FALSE(m1->findInt32("key3", &i32));
+  EXPECT_TRUE(m1->findInt32("renamed", &i32));
+  EXPECT_EQ(3, i32);
+
+  EXPECT_EQ(OK, m1->removeEntryByName("key0"));
+  EXPECT_EQ(kNumItems, m1->countEntries());
+
+  sp<AMessage> m2 = m1->dup();
+  m1->clear();
+  EXPECT_EQ(kNumItems, m2->countEntries());
+  EXPECT_FALSE(m2->findInt32("key0", &i32));
+  EXPECT_TRUE(m2->findInt32("renamed", &i32));
+  EXPECT_EQ(3, i32);
+  EXPECT_TRUE(m2->findInt32(AStringPrintf("key%d", kNumItems - 1).c_str(), &i32));
+  EXPECT_EQ(kNumItems - 1, i32);
+  AString str;
+  EXPECT_TRUE(m2->findString("name", &str));
+  EXPECT_STREQ("value", str.c_str());
+}
+
+TEST(AMessage_tests, runtimeNamesBeyondAtomTable) {
+  // more distinct names than the atom table holds, as created at runtime
+  constexpr int32_t kNumNames = AAtomizer::kMaxAtoms + 100;
+  for (int32_t i = 0; i < kNumNames; i += 200) {
+    sp<AMessage> m1 = new AMessage();
+    for (int32_t j = i; j < std::min(i + 200, kNumNames); ++j) {
+      m1->setInt32(AStringPrintf("runtime-key-%d", j).c_str(), j);
+    }
+    sp<AMessage> m2 = m1->dup();
+    m1.clear();
+    int32_t i32;
+    for (int32_t j = i; j < std::min(i + 200, kNumNames); ++j) {
+      ASSERT_TRUE(m2->findInt32(AStringPrintf("runtime-key-%d", j).c_str(), &i32));
+      EXPECT_EQ(j, i32);
+    }
+  }
+
+  // the table is full: new names are no longer interned, known ones still are
+  size_t len;
+  const char *name = "runtime-key-not-interned";
+  uint32_t hash = AAtomizer::Hash(name, &len);
+  EXPECT_EQ(nullptr, AAtomizer::AtomizeBounded(name, len, hash));
+  name = "runtime-key-0";
+  hash = AAtomizer::Hash(name, &len);
+  EXPECT_EQ(AAtomizer::Atomize(name), AAtomizer::AtomizeBounded(name, len, hash));
+
+  sp<AMessage> m = new AMessage();
+  m->setInt32("runtime-key-not-interned", 1);
+  size_t index = m->findEntryByName("runtime-key-not-interned");
+  EXPECT_EQ(OK, m->setEntryNameAt(index, "runtime-key-renamed-not-interned"));
+  int32_t i32;
+  EXPECT_TRUE(m->dup()->findInt32("runtime-key-renamed-not-interned", &i32));
+  EXPECT_EQ(1, i32);
+}
+
 TEST(AMessage_tests, deliversMultipleMessagesInOrderImmediately) {
   sp<NiceMock<MockHandler>> mockHandler = new NiceMock<MockHandler>;
   sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
@@ -335,3 +414,99 @@ TEST(AMessage_tests, postUnique_withNullToken_returnsInvalidArgument) {
   sp<AMessage> msg = new AMessage(0, mockHandler);
   EXPECT_EQ(msg->postUnique(nullptr, 0), -EINVAL);
 }
+
+TEST(AMessage_tests, heapQueue_deliversDelayedMessagesInSequence) {
+  sp<NiceMock<MockHandler>> mockHandler = new NiceMock<MockHandler>;
+  sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
+  EXPECT_EQ(OK, looper->setQueueType(ALooper::QUEUE_TYPE_HEAP));
+  looper->registerHandler(mockHandler);
+
+  sp<AMessage> msgIn500 = new AMessage(0, mockHandler);
+  msgIn500->post(500);
+  sp<AMessage> msgNow1 = new AMessage(0, mockHandler);
+  msgNow1->post();
+  sp<AMessage> msgIn100 = new AMessage(0, mockHandler);
+  msgIn100->post(100);
+  sp<AMessage> msgNow2 = new AMessage(0, mockHandler);
+  msgNow2->post();
+  sp<AMessage> msgAlsoIn100 = new AMessage(0, mockHandler);
+  msgAlsoIn100->post(100);
+  // not expected to be received
+  sp<AMessage> msgIn1000 = new AMessage(0, mockHandler);
+  msgIn1000->post(1000);
+
+  looper->setClockUs(500);
+  {
+    InSequence inSequence;
+
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgNow1)).Times(1);
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgNow2)).Times(1);
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgIn100)).Times(1);
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgAlsoIn100)).Times(1);
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgIn500)).Times(1);
+  }
+  // note: never called
+  EXPECT_CALL(*mockHandler, onMessageReceived(msgIn1000)).Times(0);
+  looper->start();
+  nanosleep(&millis100, nullptr); // just enough time for the looper thread to run
+}
+
+TEST(AMessage_tests, heapQueue_deliversUniqueMessageOnce) {
+  sp<NiceMock<MockHandler>> mockHandler = new NiceMock<MockHandler>;
+  sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
+  looper->registerHandler(mockHandler);
+
+  sp<AMessage> msg1 = new AMessage(0, mockHandler);
+  msg1->postUnique(msg1, 50);
+  // events posted before the queue type change are kept.
+  EXPECT_EQ(OK, looper->setQueueType(ALooper::QUEUE_TYPE_HEAP));
+  sp<AMessage> msg2 = new AMessage(0, mockHandler);
+  msg2->postUnique(msg1, 75); // note, using the same token as msg1
+
+  looper->setClockUs(100);
+  EXPECT_CALL(*mockHandler, onMessageReceived(msg1)).Times(0);
+  EXPECT_CALL(*mockHandler, onMessageReceived(msg2)).Times(1);
+  looper->start();
+  nanosleep(&millis100, nullptr); // just enough time for the looper thread to run
+}
+
+TEST(AMessage_tests, heapQueue_deliversMessagePostedWhileWaiting) {
+  sp<NiceMock<MockHandler>> mockHandler = new NiceMock<MockHandler>;
+  sp<ALooper> looper = new ALooper();
+  EXPECT_EQ(OK, looper->setQueueType(ALooper::QUEUE_TYPE_HEAP));
+  looper->registerHandler(mockHandler);
+  looper->start();
+  EXPECT_EQ(INVALID_OPERATION, looper->setQueueType(ALooper::QUEUE_TYPE_LIST));
+
+  nanosleep(&millis100, nullptr); // the looper thread is now waiting for events
+  sp<AMessage> msg = new AMessage(0, mockHandler);
+  EXPECT_CALL(*mockHandler, onMessageReceived(msg)).Times(1);
+  msg->post();
+  nanosleep(&millis100, nullptr); // just enough time for the looper thread to run
+}
+
+TEST(AMessage_tests, heapQueue_keepsPostOrderAcrossLockedAndLockFreePosts) {
+  sp<NiceMock<MockHandler>> mockHandler = new NiceMock<MockHandler>;
+  sp<LooperWithSettableClock> looper = new LooperWithSettableClock();
+  EXPECT_EQ(OK, looper->setQueueType(ALooper::QUEUE_TYPE_HEAP));
+  looper->registerHandler(mockHandler);
+
+  // all posted in the same microsecond: post() without delay is lock-free,
+  // postUnique() takes the looper lock.
+  sp<AMessage> msgNow1 = new AMessage(0, mockHandler);
+  msgNow1->post();
+  sp<AMessage> msgUnique = new AMessage(0, mockHandler);
+  msgUnique->postUnique(msgUnique, 0);
+  sp<AMessage> msgNow2 = new AMessage(0, mockHandler);
+  msgNow2->post();
+
+  {
+    InSequence inSequence;
+
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgNow1)).Times(1);
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgUnique)).Times(1);
+    EXPECT_CALL(*mockHandler, onMessageReceived(msgNow2)).Times(1);
+  }
+  looper->start();
+  nanosleep(&millis100, nullptr); // just enough time for the looper thread to run
+}
@@ -276,4 +276,52 @@ TEST_F(MetaDataBaseUnitTest, ConvertToStringTest) {
                                 << info.length();
 }
 
+TEST_F(MetaDataBaseUnitTest, CopyOnWriteTest) {
+    MetaDataBase metaData;
+    metaData.setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+    metaData.setInt32(kKeyWidth, kWidth1);
+    metaData.setInt64(kKeyDuration, kDurationUs);
+    uint8_t csd[64];
+    memset(csd, 0xab, sizeof(csd));
+    metaData.setData(kKeyAVCC, MetaDataBase::TYPE_NONE, csd, sizeof(csd));
+
+    MetaDataBase copy(metaData);
+    MetaDataBase assigned;
+    assigned = metaData;
+
+    // modifying a copy must not affect the original or other copies
+    copy.setInt32(kKeyWidth, kWidth2);
+    copy.setInt32(kKeyHeight, kHeight2);
+    ASSERT_TRUE(assigned.remove(kKeyDuration));
+
+    int32_t width, height;
+    int64_t durationUs;
+    ASSERT_TRUE(metaData.findInt32(kKeyWidth, &width));
+    ASSERT_EQ(width, kWidth1);
+    ASSERT_FALSE(metaData.findInt32(kKeyHeight, &height));
+    ASSERT_TRUE(metaData.findInt64(kKeyDuration, &durationUs));
+    ASSERT_EQ(durationUs, kDurationUs);
+
+    ASSERT_TRUE(copy.findInt32(kKeyWidth, &width));
+    ASSERT_EQ(width, kWidth2);
+    ASSERT_TRUE(copy.findInt32(kKeyHeight, &height));
+    ASSERT_EQ(height, kHeight2);
+    ASSERT_TRUE(copy.findInt64(kKeyDuration, &durationUs));
+
+    ASSERT_FALSE(assigned.hasData(kKeyDuration));
+    ASSERT_TRUE(assigned.findInt32(kKeyWidth, &width));
+    ASSERT_EQ(width, kWidth1);
+
+    metaData.clear();
+    uint32_t type;
+    const void *data;
+    size_t size;
+    ASSERT_TRUE(copy.findData(kKeyAVCC, &type, &data, &size));
+    ASSERT_EQ(size, sizeof(csd));
+    ASSERT_EQ(memcmp(data, csd, sizeof(csd)), 0);
+    const char *mime;
+    ASSERT_TRUE(assigned.findCString(kKeyMIMEType, &mime));
+    ASSERT_STREQ(mime, MEDIA_MIMETYPE_VIDEO_AVC);
+}
+
 }  // namespace android
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MetaDataBase.h>
+
+using namespace android;
+
+/*
+ * Models the per-sample metadata traffic of MPEG4Extractor reads: MediaTrackCUnwrapper::read()
+ * fills the buffer meta with the sample keys, and downstream consumers (MPEG4Writer,
+ * NuPlayer, AnotherPacketSource) clone it and look up the sample time.
+ * Track formats are cloned the same way on every getFormat().
+ */
+
+static void fillSampleMeta(MetaDataBase &meta, int64_t timeUs, bool encrypted) {
+    meta.setInt64(kKeyTime, timeUs);
+    meta.setInt64(kKeyDuration, 33333);
+    meta.setInt64(kKeySampleFileOffset, timeUs * 4);
+    meta.setInt64(kKeyLastSampleIndexInChunk, 3);
+    meta.setInt32(kKeyIsSyncFrame, (timeUs % 30) == 0);
+    if (encrypted) {
+        static const size_t kSizes[4] = {16, 4080, 16, 2032};
+        static const uint8_t kKeyId[16] = {};
+        meta.setInt32(kKeyCryptoMode, kCryptoModeAesCtr);
+        meta.setInt32(kKeyCryptoDefaultIVSize, 16);
+        meta.setData(kKeyPlainSizes, MetaDataBase::TYPE_NONE, kSizes, sizeof(kSizes));
+        meta.setData(kKeyEncryptedSizes, MetaDataBase::TYPE_NONE, kSizes, sizeof(kSizes));
+        meta.setData(kKeyCryptoKey, MetaDataBase::TYPE_NONE, kKeyId, sizeof(kKeyId));
+        meta.setData(kKeyCryptoIV, MetaDataBase::TYPE_NONE, kKeyId, sizeof(kKeyId));
+    }
+}
+
+static void BM_SampleMetaRead(benchmark::State& state) {
+    const bool encrypted = state.range(0);
+    int64_t timeUs = 0;
+    for (auto _ : state) {
+        MetaDataBase meta;
+        fillSampleMeta(meta, timeUs++, encrypted);
+
+        // consumer clones the sample meta and reads it back
+        MetaDataBase clone(meta);
+        int64_t sampleTimeUs;
+        int32_t isSync;
+        benchmark::DoNotOptimize(clone.findInt64(kKeyTime, &sampleTimeUs));
+        benchmark::DoNotOptimize(clone.findInt32(kKeyIsSyncFrame, &isSync));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_TrackFormatClone(benchmark::State& state) {
+    MetaDataBase format;
+    format.setCString(kKeyMIMEType, MEDIA_MIMETYPE_VIDEO_AVC);
+    format.setInt32(kKeyWidth, 1920);
+    format.setInt32(kKeyHeight, 1080);
+    format.setInt32(kKeyDisplayWidth, 1920);
+    format.setInt32(kKeyDisplayHeight, 1080);
+    format.setInt32(kKeyTrackID, 1);
+    format.setInt32(kKeyMaxInputSize, 1 << 20);
+    format.setInt32(kKeyFrameRate, 30);
+    format.setInt64(kKeyDuration, 60000000);
+    format.setCString(kKeyMediaLanguage, "und");
+    uint8_t avcc[64];
+    memset(avcc, 0, sizeof(avcc));
+    format.setData(kKeyAVCC, MetaDataBase::TYPE_NONE, avcc, sizeof(avcc));
+
+    for (auto _ : state) {
+        MetaDataBase clone;
+        clone = format;
+        const char *mime;
+        benchmark::DoNotOptimize(clone.findCString(kKeyMIMEType, &mime));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_SampleMetaRead)->Arg(0)->Arg(1)->ArgName("encrypted");
+BENCHMARK(BM_TrackFormatClone);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <media/stagefright/foundation/ABitReader.h>
+#include <media/stagefright/foundation/avc_utils.h>
+
+using namespace android;
+
+/*
+ * Measures start code scanning (getNextNALUnit() over a whole Annex B stream,
+ * against the byte-at-a-time loop it replaced) and emulation prevention
+ * handling (reading every NAL unit through NALBitReader).
+ *
+ * usage: StartCode_benchmark [benchmark flags] [stream.h264 | stream.hevc ...]
+ *
+ * Each Annex B elementary stream given on the command line is benchmarked;
+ * without files, a synthetic stream of 4K-sized slices is used.
+ */
+
+namespace {
+
+// Slices of a ~20 Mbps 4K stream at 30 fps.
+constexpr size_t kSyntheticNALUnits = 300;
+constexpr size_t kSyntheticNALSize = 80000;
+
+std::vector<uint8_t> makeSyntheticStream() {
+    std::vector<uint8_t> data;
+    srand(1);
+    for (size_t i = 0; i < kSyntheticNALUnits; ++i) {
+        data.insert(data.end(), {0x00, 0x00, 0x00, 0x01, 0x41});
+        int zeros = 0;
+        for (size_t j = 0; j < kSyntheticNALSize; ++j) {
+            // Entropy coded data has runs of zero bytes now and then.
+            uint8_t byte = (rand() % 64 == 0) ? 0x00 : rand();
+            if (zeros >= 2 && byte <= 0x03) {
+                data.push_back(0x03);
+                zeros = 0;
+            }
+            data.push_back(byte);
+            zeros = byte == 0x00 ? zeros + 1 : 0;
+        }
+        if (data.back() == 0x00) {
+            data.push_back(0x80);
+        }
+    }
+    return data;
+}
+
+bool readFile(const char *path, std::vector<uint8_t> *data) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    uint8_t buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    fclose(fp);
+    return !data->empty();
+}
+
+// The loop getNextNALUnit() used to locate start codes with.
+size_t findNextStartCodeByteWise(const uint8_t *data, size_t size) {
+    for (size_t offset = 0; offset + 2 < size; ++offset) {
+        if (data[offset + 2] == 0x01 && data[offset] == 0x00 && data[offset + 1] == 0x00) {
+            return offset;
+        }
+    }
+    return size;
+}
+
+}  // namespace
+
+static void BM_FindStartCodeByteWise(benchmark::State& state, const std::vector<uint8_t> *data) {
+    size_t numNALUnits = 0;
+    for (auto _ : state) {
+        size_t offset = 0;
+        while (offset < data->size()) {
+            offset += findNextStartCodeByteWise(&(*data)[offset], data->size() - offset) + 3;
+            ++numNALUnits;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * data->size());
+    state.counters["nal_units"] = benchmark::Counter(numNALUnits, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_FindStartCode(benchmark::State& state, const std::vector<uint8_t> *data) {
+    size_t numNALUnits = 0;
+    for (auto _ : state) {
+        size_t offset = 0;
+        while (offset < data->size()) {
+            offset += findNextStartCode(&(*data)[offset], data->size() - offset) + 3;
+            ++numNALUnits;
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * data->size());
+    state.counters["nal_units"] = benchmark::Counter(numNALUnits, benchmark::Counter::kAvgIterations);
+}
+
+static void BM_GetNextNALUnit(benchmark::State& state, const std::vector<uint8_t> *data) {
+    for (auto _ : state) {
+        const uint8_t *ptr = data->data();
+        size_t size = data->size();
+        const uint8_t *nalStart;
+        size_t nalSize;
+        while (getNextNALUnit(&ptr, &size, &nalStart, &nalSize, true) == OK) {
+            benchmark::DoNotOptimize(nalStart);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * data->size());
+}
+
+static void BM_NALBitReader(benchmark::State& state, const std::vector<uint8_t> *data) {
+    for (auto _ : state) {
+        const uint8_t *ptr = data->data();
+        size_t size = data->size();
+        const uint8_t *nalStart;
+        size_t nalSize;
+        while (getNextNALUnit(&ptr, &size, &nalStart, &nalSize, true) == OK) {
+            NALBitReader br(nalStart, nalSize);
+            uint32_t sum = 0;
+            uint32_t bits;
+            while (br.getBitsGraceful(32, &bits)) {
+                sum += bits;
+            }
+            benchmark::DoNotOptimize(sum);
+        }
+    }
+    state.SetBytesProcessed(state.iterations() * data->size());
+}
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    // benchmark::Initialize() leaves the arguments it does not know about.
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::vector<uint8_t> data;
+        if (!readFile(argv[i], &data)) {
+            fprintf(stderr, "Failed to read stream %s\n", argv[i]);
+            return 1;
+        }
+        inputs.emplace_back(argv[i], std::move(data));
+    }
+    if (inputs.empty()) {
+        inputs.emplace_back("synthetic", makeSyntheticStream());
+    }
+
+    for (const auto &input : inputs) {
+        benchmark::RegisterBenchmark(
+                ("BM_FindStartCodeByteWise/" + input.first).c_str(), BM_FindStartCodeByteWise,
+                &input.second);
+        benchmark::RegisterBenchmark(
+                ("BM_FindStartCode/" + input.first).c_str(), BM_FindStartCode, &input.second);
+        benchmark::RegisterBenchmark(
+                ("BM_GetNextNALUnit/" + input.first).c_str(), BM_GetNextNALUnit, &input.second);
+        benchmark::RegisterBenchmark(
+                ("BM_NALBitReader/" + input.first).c_str(), BM_NALBitReader, &input.second);
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
@@ -0,0 +1,300 @@
+/*
+ * Copyright 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "StartCode_test"
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <media/stagefright/foundation/ABitReader.h>
+#include <media/stagefright/foundation/avc_utils.h>
+
+namespace android {
+
+namespace {
+
+// The byte-wise scan that findNextStartCode() and findNextEmulationPrevention() replace.
+size_t findBytewise(const uint8_t *data, size_t size, uint8_t last) {
+    for (size_t offset = 0; offset + 2 < size; ++offset) {
+        if (data[offset] == 0x00 && data[offset + 1] == 0x00 && data[offset + 2] == last) {
+            return offset;
+        }
+    }
+    return size;
+}
+
+// getNextNALUnit() as it was before it used findNextStartCode().
+status_t getNextNALUnitBytewise(
+        const uint8_t **_data, size_t *_size,
+        const uint8_t **nalStart, size_t *nalSize,
+        bool startCodeFollows) {
+    const uint8_t *data = *_data;
+    size_t size = *_size;
+
+    *nalStart = NULL;
+    *nalSize = 0;
+
+    if (size < 3) {
+        return -EAGAIN;
+    }
+
+    size_t offset = 0;
+    for (; offset + 2 < size; ++offset) {
+        if (data[offset + 2] == 0x01 && data[offset] == 0x00
+                && data[offset + 1] == 0x00) {
+            break;
+        }
+    }
+    if (offset + 2 >= size) {
+        *_data = &data[offset];
+        *_size = 2;
+        return -EAGAIN;
+    }
+    offset += 3;
+
+    size_t startOffset = offset;
+
+    for (;;) {
+        while (offset < size && data[offset] != 0x01) {
+            ++offset;
+        }
+
+        if (offset == size) {
+            if (startCodeFollows) {
+                offset = size + 2;
+                break;
+            }
+
+            return -EAGAIN;
+        }
+
+        if (data[offset - 1] == 0x00 && data[offset - 2] == 0x00) {
+            break;
+        }
+
+        ++offset;
+    }
+
+    size_t endOffset = offset - 2;
+    while (endOffset > startOffset + 1 && data[endOffset - 1] == 0x00) {
+        --endOffset;
+    }
+
+    *nalStart = &data[startOffset];
+    *nalSize = endOffset - startOffset;
+
+    if (offset + 2 < size) {
+        *_data = &data[offset - 2];
+        *_size = size - offset + 2;
+    } else {
+        *_data = NULL;
+        *_size = 0;
+    }
+
+    return OK;
+}
+
+// Random bytes where 00, 01 and 03 are frequent, so that start codes, emulation prevention
+// and runs of zeros land at every alignment.
+std::vector<uint8_t> makeStream(std::mt19937 *rng, size_t size) {
+    std::uniform_int_distribution<int> dist(0, 15);
+    std::vector<uint8_t> stream(size);
+    for (auto &byte : stream) {
+        const int r = dist(*rng);
+        byte = r < 8 ? 0x00 : r < 10 ? 0x01 : r < 12 ? 0x03 : (uint8_t)(r * 17);
+    }
+    return stream;
+}
+
+// Removes the emulation_prevention_three_bytes the way the byte-wise NALBitReader did.
+std::vector<uint8_t> unescape(const std::vector<uint8_t> &nal) {
+    std::vector<uint8_t> rbsp;
+    int numZeros = 0;
+    for (uint8_t byte : nal) {
+        const bool isEmulationPreventionByte = numZeros >= 2 && byte == 3;
+        numZeros = byte == 0 ? numZeros + 1 : 0;
+        if (!isEmulationPreventionByte) {
+            rbsp.push_back(byte);
+        }
+    }
+    return rbsp;
+}
+
+}  // namespace
+
+class StartCodeTest : public ::testing::Test {
+};
+
+TEST_F(StartCodeTest, FindsStartCodeAtEveryPosition) {
+    // covers the first and last positions of the buffer, both sides of every 16 byte block,
+    // and the tail which is scanned byte by byte.
+    for (size_t size = 0; size < 70; ++size) {
+        for (size_t position = 0; position + 3 <= size; ++position) {
+            std::vector<uint8_t> data(size, 0xff);
+            data[position] = 0x00;
+            data[position + 1] = 0x00;
+            data[position + 2] = 0x01;
+            EXPECT_EQ(position, findNextStartCode(data.data(), size))
+                    << "size " << size << " position " << position;
+            EXPECT_EQ(size, findNextEmulationPrevention(data.data(), size))
+                    << "size " << size << " position " << position;
+
+            data[position + 2] = 0x03;
+            EXPECT_EQ(position, findNextEmulationPrevention(data.data(), size))
+                    << "size " << size << " position " << position;
+            EXPECT_EQ(size, findNextStartCode(data.data(), size))
+                    << "size " << size << " position " << position;
+        }
+    }
+}
+
+TEST_F(StartCodeTest, IgnoresTruncatedStartCode) {
+    for (size_t size = 2; size < 70; ++size) {
+        std::vector<uint8_t> data(size, 0xff);
+        // 00 00 at the very end, with the 01 that would follow outside the buffer
+        data[size - 2] = 0x00;
+        data[size - 1] = 0x00;
+        EXPECT_EQ(size, findNextStartCode(data.data(), size)) << "size " << size;
+        // 00 01 at the start, with the first 00 outside the buffer
+        data[0] = 0x00;
+        data[1] = 0x01;
+        EXPECT_EQ(size, findNextStartCode(data.data(), size)) << "size " << size;
+    }
+}
+
+TEST_F(StartCodeTest, FindsFourByteStartCode) {
+    for (size_t position = 0; position < 40; ++position) {
+        std::vector<uint8_t> data(64, 0x55);
+        data[position] = 0x00;
+        data[position + 1] = 0x00;
+        data[position + 2] = 0x00;
+        data[position + 3] = 0x01;
+        // the 00 00 01 prefix starts after the leading zero byte
+        EXPECT_EQ(position + 1, findNextStartCode(data.data(), data.size()));
+    }
+
+    // 00 00 00 01 67 42 00 00 01 68 ce 38: the NAL units are 67 42 and 68 ce 38.
+    const uint8_t stream[] = {
+            0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x00, 0x01, 0x68, 0xce, 0x38 };
+    const uint8_t *data = stream;
+    size_t size = sizeof(stream);
+    const uint8_t *nalStart;
+    size_t nalSize;
+    ASSERT_EQ(OK, getNextNALUnit(&data, &size, &nalStart, &nalSize, true));
+    EXPECT_EQ(&stream[4], nalStart);
+    EXPECT_EQ(2u, nalSize);
+    ASSERT_EQ(OK, getNextNALUnit(&data, &size, &nalStart, &nalSize, true));
+    EXPECT_EQ(&stream[9], nalStart);
+    EXPECT_EQ(3u, nalSize);
+}
+
+TEST_F(StartCodeTest, MatchesBytewiseScan) {
+    std::mt19937 rng(42);
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        const std::vector<uint8_t> stream = makeStream(&rng, iteration % 200);
+        for (size_t start = 0; start < std::min<size_t>(stream.size(), 20); ++start) {
+            const uint8_t *data = stream.data() + start;
+            const size_t size = stream.size() - start;
+            ASSERT_EQ(findBytewise(data, size, 0x01), findNextStartCode(data, size));
+            ASSERT_EQ(findBytewise(data, size, 0x03), findNextEmulationPrevention(data, size));
+        }
+    }
+}
+
+TEST_F(StartCodeTest, GetNextNALUnitMatchesBytewiseScan) {
+    std::mt19937 rng(7);
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        const std::vector<uint8_t> stream = makeStream(&rng, iteration % 300);
+        for (bool startCodeFollows : { false, true }) {
+            const uint8_t *data = stream.data();
+            size_t size = stream.size();
+            const uint8_t *expectedData = data;
+            size_t expectedSize = size;
+            for (;;) {
+                const uint8_t *nalStart;
+                size_t nalSize;
+                const uint8_t *expectedNalStart;
+                size_t expectedNalSize;
+                const status_t err = getNextNALUnit(
+                        &data, &size, &nalStart, &nalSize, startCodeFollows);
+                const status_t expectedErr = getNextNALUnitBytewise(&expectedData,
+                        &expectedSize, &expectedNalStart, &expectedNalSize, startCodeFollows);
+                ASSERT_EQ(expectedErr, err);
+                ASSERT_EQ(expectedData, data);
+                ASSERT_EQ(expectedSize, size);
+                ASSERT_EQ(expectedNalStart, nalStart);
+                ASSERT_EQ(expectedNalSize, nalSize);
+                if (err != OK || data == NULL) {
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// NALBitReader loads whole words up to the next emulation_prevention_three_byte; put one
+// at every offset from a word boundary, including 00 00 at the end of a word and 03 at the
+// start of the next one.
+TEST_F(StartCodeTest, NALBitReaderSkipsEmulationPreventionAcrossWords) {
+    for (size_t position = 0; position < 16; ++position) {
+        std::vector<uint8_t> nal(24);
+        for (size_t i = 0; i < nal.size(); ++i) {
+            nal[i] = (uint8_t)(0x10 + i);
+        }
+        nal[position] = 0x00;
+        nal[position + 1] = 0x00;
+        nal[position + 2] = 0x03;
+        nal[position + 3] = 0x00;  // the escaped byte
+        const std::vector<uint8_t> rbsp = unescape(nal);
+        ASSERT_EQ(nal.size() - 1, rbsp.size());
+
+        NALBitReader reader(nal.data(), nal.size());
+        for (size_t i = 0; i < rbsp.size(); ++i) {
+            ASSERT_EQ(rbsp[i], reader.getBits(8)) << "position " << position << " byte " << i;
+        }
+        uint32_t bits;
+        EXPECT_FALSE(reader.getBitsGraceful(8, &bits));
+    }
+}
+
+TEST_F(StartCodeTest, NALBitReaderMatchesUnescapedReader) {
+    std::mt19937 rng(1234);
+    // getBits(32) shifts by 32 when the reservoir is full, so stay below it
+    std::uniform_int_distribution<int> bitCounts(0, 31);
+    for (int iteration = 0; iteration < 2000; ++iteration) {
+        const std::vector<uint8_t> nal = makeStream(&rng, iteration % 100);
+        const std::vector<uint8_t> rbsp = unescape(nal);
+        NALBitReader reader(nal.data(), nal.size());
+        ABitReader expected(rbsp.data(), rbsp.size());
+        for (;;) {
+            const size_t n = bitCounts(rng);
+            uint32_t bits = 0;
+            uint32_t expectedBits = 0;
+            const bool ok = reader.getBitsGraceful(n, &bits);
+            ASSERT_EQ(expected.getBitsGraceful(n, &expectedBits), ok);
+            if (!ok) {
+                break;
+            }
+            ASSERT_EQ(expectedBits, bits);
+            ASSERT_EQ(expected.overRead(), reader.overRead());
+        }
+    }
+}
+
+}  // namespace android
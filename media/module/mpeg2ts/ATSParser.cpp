@@ -40,10 +40,16 @@
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MetaData.h>
 #include <media/IStreamSource.h>
+#include <utils/Condition.h>
 #include <utils/KeyedVector.h>
+#include <utils/Mutex.h>
 #include <utils/Vector.h>
 
 #include <inttypes.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <thread>
 
 namespace android {
 using hardware::hidl_handle;
@@ -60,6 +66,11 @@ typedef hidl::memory::V1_0::IMemory TMemory;
 
 static const size_t kTSPacketSize = 188;
 
+// Bounds of the PARALLEL_ES_ASSEMBLY worker pool and of the payloads queued to
+// each worker before feedTSPacket() blocks.
+static const size_t kMaxAssemblyWorkers = 4;
+static const size_t kMaxQueuedPayloads = 64;
+
 struct ATSParser::Program : public RefBase {
     Program(ATSParser *parser, unsigned programNumber, unsigned programMapPID,
             int64_t lastRecoveredPTS);
@@ -117,6 +128,8 @@ struct ATSParser::Program : public RefBase {
 
     void signalNewSampleAesKey(const sp<AMessage> &keyItem);
 
+    sp<AssemblyWorker> nextAssemblyWorker();
+
 private:
 
     ATSParser *mParser;
@@ -147,6 +160,7 @@ struct ATSParser::Stream : public RefBase {
     unsigned pid() const { return mElementaryPID; }
     void setPID(unsigned pid) { mElementaryPID = pid; }
     void setAudioPresentations(AudioPresentationCollection audioPresentations) {
+        drainAssembly();
         mAudioPresentations = audioPresentations;
     }
 
@@ -180,10 +194,16 @@ struct ATSParser::Stream : public RefBase {
 
     void signalNewSampleAesKey(const sp<AMessage> &keyItem);
 
+    // Wait until the payloads queued to the assembly worker, if any, have been
+    // assembled into access units.
+    void drainAssembly();
+
 protected:
     virtual ~Stream();
 
 private:
+    friend struct AssemblyWorker;
+
     struct SubSampleInfo {
         size_t subSampleSize;
         unsigned transport_scrambling_mode;
@@ -197,6 +217,8 @@ private:
     int32_t mExpectedContinuityCounter;
 
     sp<ABuffer> mBuffer;
+    // Guards mSource, which the assembly worker creates.
+    Mutex mSourceLock;
     sp<AnotherPacketSource> mSource;
     bool mPayloadStarted;
     bool mEOSReached;
@@ -216,6 +238,12 @@ private:
     sp<IDescrambler> mDescrambler;
     AudioPresentationCollection mAudioPresentations;
 
+    // Set for clear streams of a PARALLEL_ES_ASSEMBLY parser. mQueue and the
+    // creation of mSource are then owned by the worker until drainAssembly().
+    sp<AssemblyWorker> mAssemblyWorker;
+    // Guarded by the lock of mAssemblyWorker.
+    size_t mNumQueuedPayloads;
+
     // Send audio presentations along with access units.
     void addAudioPresentations(const sp<ABuffer> &buffer);
 
@@ -238,13 +266,21 @@ private:
 
     // Feed the payload into mQueue and if a packet is identified, queue it
     // into mSource. If the packet is a sync frame. set event with start offset
-    // and timestamp of the packet.
+    // and timestamp of the packet. Without an event, the payload of a stream
+    // with an assembly worker is handed to that worker instead.
     void onPayloadData(
             unsigned PTS_DTS_flags, uint64_t PTS, uint64_t DTS,
             unsigned PES_scrambling_control,
             const uint8_t *data, size_t size,
             int32_t payloadOffset, SyncEvent *event);
 
+    // The part of onPayloadData() after the timestamp conversion. Runs on the
+    // assembly worker with NULL pesStartOffsets and event.
+    void assembleAccessUnits(
+            const uint8_t *data, size_t size, int64_t timeUs,
+            int32_t payloadOffset, unsigned PES_scrambling_control,
+            List<off64_t> *pesStartOffsets, SyncEvent *event);
+
     // Ensure internal buffers can hold specified size, and will re-allocate
     // as needed.
     bool ensureBufferCapacity(size_t size);
@@ -277,6 +313,44 @@ private:
     DISALLOW_EVIL_CONSTRUCTORS(PSISection);
 };
 
+// Assembles access units from PES payloads of the streams assigned to it, in
+// the order the payloads were queued.
+struct ATSParser::AssemblyWorker : public RefBase {
+    AssemblyWorker();
+
+    // Blocks while kMaxQueuedPayloads payloads are pending.
+    void queuePayload(
+            Stream *stream, const sp<ABuffer> &payload, int64_t timeUs,
+            int32_t payloadOffset, unsigned PES_scrambling_control);
+
+    // Wait until the payloads of stream, or of all streams if NULL, have been
+    // assembled.
+    void drain(Stream *stream);
+
+protected:
+    virtual ~AssemblyWorker();
+
+private:
+    struct Payload {
+        Stream *mStream;
+        sp<ABuffer> mData;
+        int64_t mTimeUs;
+        int32_t mPayloadOffset;
+        unsigned mPesScramblingControl;
+    };
+
+    Mutex mLock;
+    Condition mCondition;
+    List<Payload> mPayloads;
+    bool mBusy;
+    bool mDone;
+    std::thread mThread;
+
+    void threadLoop();
+
+    DISALLOW_EVIL_CONSTRUCTORS(AssemblyWorker);
+};
+
 ATSParser::SyncEvent::SyncEvent(off64_t offset)
     : mHasReturnedData(false), mOffset(offset), mTimeUs(0) {}
 
@@ -887,6 +961,10 @@ bool ATSParser::Program::hasSource(SourceType type) const {
     return false;
 }
 
+sp<ATSParser::AssemblyWorker> ATSParser::Program::nextAssemblyWorker() {
+    return mParser->nextAssemblyWorker();
+}
+
 int64_t ATSParser::Program::convertPTSToTimestamp(uint64_t PTS) {
     PTS = recoverPTS(PTS);
 
@@ -944,7 +1022,8 @@ ATSParser::Stream::Stream(
       mPrevPTS(0),
       mQueue(NULL),
       mScrambled(info.mCADescriptor.mSystemID >= 0),
-      mAudioPresentations(info.mAudioPresentations) {
+      mAudioPresentations(info.mAudioPresentations),
+      mNumQueuedPayloads(0) {
     mSampleEncrypted =
             mStreamType == STREAMTYPE_H264_ENCRYPTED ||
             mStreamType == STREAMTYPE_AAC_ENCRYPTED  ||
@@ -1047,11 +1126,14 @@ ATSParser::Stream::Stream(
                     descriptor.mPrivateData.size());
 
             mSource = new AnotherPacketSource(meta);
+        } else if (!mScrambled && !mSampleEncrypted) {
+            mAssemblyWorker = mProgram->nextAssemblyWorker();
         }
     }
 }
 
 ATSParser::Stream::~Stream() {
+    drainAssembly();
     delete mQueue;
     mQueue = NULL;
 }
@@ -1267,6 +1349,8 @@ void ATSParser::Stream::signalDiscontinuity(
         return;
     }
 
+    drainAssembly();
+
     mPayloadStarted = false;
     mPesStartOffsets.clear();
     mEOSReached = false;
@@ -1313,6 +1397,7 @@ void ATSParser::Stream::signalDiscontinuity(
 }
 
 void ATSParser::Stream::signalEOS(status_t finalResult) {
+    drainAssembly();
     if (mSource != NULL) {
         mSource->signalEOS(finalResult);
     }
@@ -1852,6 +1937,25 @@ void ATSParser::Stream::onPayloadData(
         timeUs = mProgram->convertPTSToTimestamp(PTS);
     }
 
+    if (mAssemblyWorker != NULL && event == NULL && !mEOSReached) {
+        // No event to report, so the start offsets are not needed.
+        mPesStartOffsets.clear();
+        mAssemblyWorker->queuePayload(
+                this, ABuffer::CreateAsCopy(data, size), timeUs, payloadOffset,
+                PES_scrambling_control);
+        return;
+    }
+
+    drainAssembly();
+    assembleAccessUnits(
+            data, size, timeUs, payloadOffset, PES_scrambling_control,
+            &mPesStartOffsets, event);
+}
+
+void ATSParser::Stream::assembleAccessUnits(
+        const uint8_t *data, size_t size, int64_t timeUs,
+        int32_t payloadOffset, unsigned PES_scrambling_control,
+        List<off64_t> *pesStartOffsets, SyncEvent *event) {
     status_t err = mQueue->appendData(
             data, size, timeUs, payloadOffset, PES_scrambling_control);
 
@@ -1881,7 +1985,10 @@ void ATSParser::Stream::onPayloadData(
                         continue;
                     }
                 }
-                mSource = new AnotherPacketSource(meta);
+                {
+                    Mutex::Autolock autoLock(mSourceLock);
+                    mSource = new AnotherPacketSource(meta);
+                }
                 if (mAudioPresentations.size() > 0) {
                     addAudioPresentations(accessUnit);
                 }
@@ -1905,9 +2012,9 @@ void ATSParser::Stream::onPayloadData(
 
         // Every access unit has a pesStartOffset queued in |mPesStartOffsets|.
         off64_t pesStartOffset = -1;
-        if (!mPesStartOffsets.empty()) {
-            pesStartOffset = *mPesStartOffsets.begin();
-            mPesStartOffsets.erase(mPesStartOffsets.begin());
+        if (pesStartOffsets != NULL && !pesStartOffsets->empty()) {
+            pesStartOffset = *pesStartOffsets->begin();
+            pesStartOffsets->erase(pesStartOffsets->begin());
         }
 
         if (pesStartOffset >= 0 && (event != NULL) && !found && mQueue->getFormat() != NULL) {
@@ -1935,6 +2042,7 @@ ATSParser::SourceType ATSParser::Stream::getSourceType() {
 }
 
 sp<AnotherPacketSource> ATSParser::Stream::getSource(SourceType type) {
+    Mutex::Autolock autoLock(mSourceLock);
     switch (type) {
         case VIDEO:
         {
@@ -1970,6 +2078,7 @@ sp<AnotherPacketSource> ATSParser::Stream::getSource(SourceType type) {
 void ATSParser::Stream::setCasInfo(
         int32_t systemId, const sp<IDescrambler> &descrambler,
         const std::vector<uint8_t> &sessionId) {
+    drainAssembly();
     if (mSource != NULL && mDescrambler == NULL && descrambler != NULL) {
         signalDiscontinuity(DISCONTINUITY_FORMAT_ONLY, NULL);
         mDescrambler = descrambler;
@@ -1981,8 +2090,90 @@ void ATSParser::Stream::setCasInfo(
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void ATSParser::Stream::drainAssembly() {
+    if (mAssemblyWorker != NULL) {
+        mAssemblyWorker->drain(this);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ATSParser::AssemblyWorker::AssemblyWorker()
+    : mBusy(false),
+      mDone(false),
+      mThread(&AssemblyWorker::threadLoop, this) {
+}
+
+ATSParser::AssemblyWorker::~AssemblyWorker() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mDone = true;
+        mCondition.broadcast();
+    }
+    mThread.join();
+}
+
+void ATSParser::AssemblyWorker::queuePayload(
+        Stream *stream, const sp<ABuffer> &payload, int64_t timeUs,
+        int32_t payloadOffset, unsigned PES_scrambling_control) {
+    Mutex::Autolock autoLock(mLock);
+    while (mPayloads.size() >= kMaxQueuedPayloads) {
+        mCondition.wait(mLock);
+    }
+    mPayloads.push_back({stream, payload, timeUs, payloadOffset, PES_scrambling_control});
+    ++stream->mNumQueuedPayloads;
+    mCondition.broadcast();
+}
+
+void ATSParser::AssemblyWorker::drain(Stream *stream) {
+    Mutex::Autolock autoLock(mLock);
+    if (stream != NULL) {
+        while (stream->mNumQueuedPayloads > 0) {
+            mCondition.wait(mLock);
+        }
+    } else {
+        while (!mPayloads.empty() || mBusy) {
+            mCondition.wait(mLock);
+        }
+    }
+}
+
+void ATSParser::AssemblyWorker::threadLoop() {
+    pthread_setname_np(pthread_self(), "TSAssembly");
+
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mPayloads.empty() && !mDone) {
+            mCondition.wait(mLock);
+        }
+        if (mPayloads.empty()) {
+            break;
+        }
+
+        Payload payload = *mPayloads.begin();
+        mPayloads.erase(mPayloads.begin());
+        mBusy = true;
+        mCondition.broadcast();
+
+        mLock.unlock();
+        payload.mStream->assembleAccessUnits(
+                payload.mData->data(), payload.mData->size(), payload.mTimeUs,
+                payload.mPayloadOffset, payload.mPesScramblingControl,
+                NULL /* pesStartOffsets */, NULL /* event */);
+        payload.mData.clear();
+        mLock.lock();
+
+        mBusy = false;
+        --payload.mStream->mNumQueuedPayloads;
+        mCondition.broadcast();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 ATSParser::ATSParser(uint32_t flags)
     : mFlags(flags),
+      mNextAssemblyWorker(0),
       mAbsoluteTimeAnchorUs(-1LL),
       mTimeOffsetValid(false),
       mTimeOffsetUs(0LL),
@@ -1991,6 +2182,30 @@ ATSParser::ATSParser(uint32_t flags)
       mNumPCRs(0) {
     mPSISections.add(0 /* PID */, new PSISection);
     mCasManager = new CasManager();
+
+    if (mFlags & PARALLEL_ES_ASSEMBLY) {
+        // Leave a core for the thread feeding the packets.
+        size_t numWorkers = std::thread::hardware_concurrency();
+        numWorkers = numWorkers > 1 ? std::min(numWorkers - 1, kMaxAssemblyWorkers) : 1;
+        for (size_t i = 0; i < numWorkers; ++i) {
+            mAssemblyWorkers.push_back(new AssemblyWorker);
+        }
+    }
+}
+
+sp<ATSParser::AssemblyWorker> ATSParser::nextAssemblyWorker() {
+    if (mAssemblyWorkers.empty()) {
+        return NULL;
+    }
+    sp<AssemblyWorker> worker = mAssemblyWorkers[mNextAssemblyWorker];
+    mNextAssemblyWorker = (mNextAssemblyWorker + 1) % mAssemblyWorkers.size();
+    return worker;
+}
+
+void ATSParser::drainAssembly() {
+    for (size_t i = 0; i < mAssemblyWorkers.size(); ++i) {
+        mAssemblyWorkers[i]->drain(NULL);
+    }
 }
 
 ATSParser::~ATSParser() {
@@ -2698,6 +2913,7 @@ void ATSParser::Stream::signalNewSampleAesKey(const sp<AMessage> &keyItem) {
     mSampleAesKeyItem = keyItem;
 
     flush(NULL);
+    drainAssembly();
     mQueue->signalNewSampleAesKey(keyItem);
 }
 
@@ -889,21 +889,14 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
-
-                if (startOffset < 0) {
+                size_t startOffset = findNextStartCode(ptr, size);
+                if (startOffset == size) {
                     return ERROR_MALFORMED;
                 }
 
                 if (mFormat == NULL && startOffset > 0) {
                     ALOGI("found something resembling an H.264/MPEG syncword "
-                          "at offset %zd",
+                          "at offset %zu",
                           startOffset);
                 }
 
@@ -922,21 +915,14 @@ status_t ElementaryStreamQueue::appendData(
 #else
                 uint8_t *ptr = (uint8_t *)data;
 
-                ssize_t startOffset = -1;
-                for (size_t i = 0; i + 2 < size; ++i) {
-                    if (!memcmp("\x00\x00\x01", &ptr[i], 3)) {
-                        startOffset = i;
-                        break;
-                    }
-                }
-
-                if (startOffset < 0) {
+                size_t startOffset = findNextStartCode(ptr, size);
+                if (startOffset == size) {
                     return ERROR_MALFORMED;
                 }
 
                 if (startOffset > 0) {
                     ALOGI("found something resembling an H.264/MPEG syncword "
-                          "at offset %zd",
+                          "at offset %zu",
                           startOffset);
                 }
 
@@ -2275,9 +2261,9 @@ sp<ABuffer> ElementaryStreamQueue::dequeueAccessUnitMPEGVideo() {
 
     size_t offset = 0;
     while (offset + 3 < size) {
-        if (memcmp(&data[offset], "\x00\x00\x01", 3)) {
-            ++offset;
-            continue;
+        offset += findNextStartCode(&data[offset], size - offset);
+        if (offset + 3 >= size) {
+            break;
         }
 
         pprevStartCode = prevStartCode;
@@ -2422,13 +2408,9 @@ static ssize_t getNextChunkSize(
         return -EAGAIN;
     }
 
-    size_t offset = 4;
-    while (offset + 2 < size) {
-        if (!memcmp(&data[offset], kStartCode, 3)) {
-            return offset;
-        }
-
-        ++offset;
+    size_t offset = 4 + findNextStartCode(&data[4], size - 4);
+    if (offset < size) {
+        return offset;
     }
 
     return -EAGAIN;
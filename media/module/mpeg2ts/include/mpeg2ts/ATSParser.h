@@ -69,6 +69,12 @@ struct ATSParser : public RefBase {
         TS_TIMESTAMPS_ARE_ABSOLUTE = 1,
         // Video PES packets contain exactly one (aligned) access unit.
         ALIGNED_VIDEO_DATA         = 2,
+        // Assemble access units of clear elementary streams on a small pool
+        // of worker threads. PID filtering and PES parsing stay on the thread
+        // calling feedTSPacket(), access units of each stream are still
+        // queued in order. Packets fed with a SyncEvent are assembled
+        // synchronously so that the event can be reported.
+        PARALLEL_ES_ASSEMBLY       = 4,
     };
 
     enum SourceType {
@@ -127,6 +133,10 @@ struct ATSParser : public RefBase {
 
     void signalEOS(status_t finalResult);
 
+    // With PARALLEL_ES_ASSEMBLY, wait until all payloads fed so far have been
+    // assembled into access units and queued to their sources.
+    void drainAssembly();
+
     sp<AnotherPacketSource> getSource(SourceType type);
     bool hasSource(SourceType type) const;
 
@@ -192,6 +202,7 @@ private:
     struct Stream;
     struct PSISection;
     struct CasManager;
+    struct AssemblyWorker;
     struct CADescriptor {
         CADescriptor() : mPID(0), mSystemID(-1) {}
         unsigned mPID;
@@ -210,6 +221,12 @@ private:
     sp<CasManager> mCasManager;
 
     uint32_t mFlags;
+
+    // Declared before mPrograms so that streams drain their pending payloads
+    // before the workers are joined.
+    Vector<sp<AssemblyWorker> > mAssemblyWorkers;
+    size_t mNextAssemblyWorker;
+
     Vector<sp<Program> > mPrograms;
 
     // Keyed by PID
@@ -253,6 +270,10 @@ private:
 
     void updatePCR(unsigned PID, uint64_t PCR, uint64_t byteOffsetFromStart);
 
+    // Returns the worker the next clear stream assembles its access units on,
+    // or NULL if PARALLEL_ES_ASSEMBLY is not set.
+    sp<AssemblyWorker> nextAssemblyWorker();
+
     uint64_t mPCR[2];
     uint64_t mPCRBytes[2];
     int64_t mSystemTimeUs[2];
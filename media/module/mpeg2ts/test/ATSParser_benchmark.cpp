@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <mpeg2ts/ATSParser.h>
+
+#include "SyntheticTS.h"
+
+using namespace android;
+using namespace android::synthetic_ts;
+
+/*
+ * Measures the demux throughput of ATSParser with and without
+ * PARALLEL_ES_ASSEMBLY. Packets are fed without a SyncEvent, as the streaming
+ * and HLS sources do.
+ *
+ * usage: ATSParser_benchmark [benchmark flags] [file.ts ...]
+ *
+ * Each recorded TS file given on the command line is benchmarked; without
+ * files, a synthetic program with several ADTS AAC streams is used.
+ */
+
+namespace {
+
+bool readFile(const char *path, std::vector<uint8_t> *data) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == nullptr) {
+        return false;
+    }
+    uint8_t buffer[kTSPacketSize * 1024];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0) {
+        data->insert(data->end(), buffer, buffer + n);
+    }
+    fclose(fp);
+    data->resize(data->size() - data->size() % kTSPacketSize);
+    return !data->empty();
+}
+
+}  // namespace
+
+static void BM_ATSParserFeed(benchmark::State& state, const std::vector<uint8_t> *data) {
+    const uint32_t flags = state.range(0) ? ATSParser::PARALLEL_ES_ASSEMBLY : 0;
+
+    for (auto _ : state) {
+        sp<ATSParser> parser = new ATSParser(flags);
+        for (size_t offset = 0; offset < data->size(); offset += kTSPacketSize) {
+            if (data->at(offset) != 0x47) {
+                continue;
+            }
+            parser->feedTSPacket(data->data() + offset, kTSPacketSize);
+        }
+        parser->drainAssembly();
+
+        state.PauseTiming();
+        parser.clear();
+        state.ResumeTiming();
+    }
+    state.SetBytesProcessed(state.iterations() * data->size());
+}
+
+int main(int argc, char **argv) {
+    benchmark::Initialize(&argc, argv);
+
+    // benchmark::Initialize() leaves the arguments it does not know about.
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> inputs;
+    for (int i = 1; i < argc; ++i) {
+        std::vector<uint8_t> data;
+        if (!readFile(argv[i], &data)) {
+            fprintf(stderr, "Failed to read TS file %s\n", argv[i]);
+            return 1;
+        }
+        inputs.emplace_back(argv[i], std::move(data));
+    }
+    if (inputs.empty()) {
+        inputs.emplace_back("synthetic", makeSyntheticStream());
+    }
+
+    for (const auto &input : inputs) {
+        benchmark::RegisterBenchmark(
+                ("BM_ATSParserFeed/" + input.first).c_str(), BM_ATSParserFeed, &input.second)
+                ->ArgName("parallel")->Arg(0)->Arg(1)
+                ->Unit(benchmark::kMillisecond)->UseRealTime();
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    return 0;
+}
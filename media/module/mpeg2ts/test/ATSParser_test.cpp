@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "ATSParser_test"
+
+#include <utils/Log.h>
+
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <mpeg2ts/ATSParser.h>
+#include <mpeg2ts/AnotherPacketSource.h>
+
+#include "SyntheticTS.h"
+
+using namespace android;
+using namespace android::synthetic_ts;
+
+namespace {
+
+constexpr size_t kStreams = 4;
+constexpr size_t kPESPerStream = 200;
+
+void feed(const sp<ATSParser> &parser, const std::vector<uint8_t> &data) {
+    for (size_t offset = 0; offset + kTSPacketSize <= data.size(); offset += kTSPacketSize) {
+        ASSERT_EQ(OK, parser->feedTSPacket(&data[offset], kTSPacketSize));
+    }
+}
+
+// Dequeues the access units of the first audio stream up to the end of stream.
+std::vector<sp<ABuffer>> dequeueAll(const sp<ATSParser> &parser) {
+    std::vector<sp<ABuffer>> accessUnits;
+    sp<AnotherPacketSource> source = parser->getSource(ATSParser::AUDIO);
+    if (source == NULL) {
+        ADD_FAILURE() << "no audio source";
+        return accessUnits;
+    }
+    for (;;) {
+        sp<ABuffer> accessUnit;
+        const status_t err = source->dequeueAccessUnit(&accessUnit);
+        if (err != OK) {
+            EXPECT_EQ(ERROR_END_OF_STREAM, err);
+            break;
+        }
+        accessUnits.push_back(accessUnit);
+    }
+    return accessUnits;
+}
+
+void expectSameAccessUnits(const std::vector<sp<ABuffer>> &expected,
+        const std::vector<sp<ABuffer>> &actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        SCOPED_TRACE(i);
+        int64_t expectedTimeUs;
+        int64_t timeUs;
+        ASSERT_TRUE(expected[i]->meta()->findInt64("timeUs", &expectedTimeUs));
+        ASSERT_TRUE(actual[i]->meta()->findInt64("timeUs", &timeUs));
+        EXPECT_EQ(expectedTimeUs, timeUs);
+        ASSERT_EQ(expected[i]->size(), actual[i]->size());
+        EXPECT_EQ(0, memcmp(expected[i]->data(), actual[i]->data(), actual[i]->size()));
+    }
+}
+
+}  // namespace
+
+// Access units assembled on the workers are the ones assembled on the feeding thread,
+// in the same order.
+TEST(ATSParserTest, ParallelAssemblyMatchesSerial) {
+    const std::vector<uint8_t> data = makeSyntheticStream(kStreams, kPESPerStream);
+
+    sp<ATSParser> serial = new ATSParser(ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE);
+    feed(serial, data);
+    serial->signalEOS(ERROR_END_OF_STREAM);
+    const std::vector<sp<ABuffer>> expected = dequeueAll(serial);
+    // the last PES packet of a stream is only assembled when the next one starts
+    ASSERT_GE(expected.size(), (kPESPerStream - 1) * kFramesPerPES);
+
+    sp<ATSParser> parallel = new ATSParser(
+            ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE | ATSParser::PARALLEL_ES_ASSEMBLY);
+    feed(parallel, data);
+    parallel->drainAssembly();
+    parallel->signalEOS(ERROR_END_OF_STREAM);
+    expectSameAccessUnits(expected, dequeueAll(parallel));
+}
+
+// signalEOS() queues the end of stream after all the payloads fed before it.
+TEST(ATSParserTest, ParallelAssemblyEOSFollowsPayloads) {
+    const std::vector<uint8_t> data = makeSyntheticStream(kStreams, kPESPerStream);
+
+    sp<ATSParser> serial = new ATSParser(ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE);
+    feed(serial, data);
+    serial->signalEOS(ERROR_END_OF_STREAM);
+    const std::vector<sp<ABuffer>> expected = dequeueAll(serial);
+
+    sp<ATSParser> parallel = new ATSParser(
+            ATSParser::TS_TIMESTAMPS_ARE_ABSOLUTE | ATSParser::PARALLEL_ES_ASSEMBLY);
+    feed(parallel, data);
+    parallel->signalEOS(ERROR_END_OF_STREAM);
+    expectSameAccessUnits(expected, dequeueAll(parallel));
+}
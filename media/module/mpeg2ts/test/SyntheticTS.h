@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SYNTHETIC_TS_H_
+#define SYNTHETIC_TS_H_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <mpeg2ts/ATSParser.h>
+
+namespace android {
+namespace synthetic_ts {
+
+// Single program transport streams for the ATSParser tests and benchmarks.
+
+constexpr size_t kTSPacketSize = 188;
+constexpr unsigned kPMTPID = 0x1000;
+constexpr unsigned kFirstStreamPID = 0x100;
+constexpr size_t kSyntheticStreams = 4;
+constexpr size_t kSyntheticPESPerStream = 1000;
+constexpr size_t kFramesPerPES = 8;
+constexpr size_t kADTSFrameSize = 371;
+
+inline uint32_t crc32(const std::vector<uint8_t> &data) {
+    uint32_t crc = 0xffffffff;
+    for (uint8_t byte : data) {
+        crc ^= (uint32_t)byte << 24;
+        for (int i = 0; i < 8; ++i) {
+            crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+class TSWriter {
+public:
+    explicit TSWriter(std::vector<uint8_t> *out) : mOut(out) {}
+
+    void writePAT() {
+        std::vector<uint8_t> section = {
+            0x00, 0xb0, 0x00, 0x00, 0x01, 0xc1, 0x00, 0x00,
+            0x00, 0x01, (uint8_t)(0xe0 | (kPMTPID >> 8)), (uint8_t)kPMTPID,
+        };
+        writeSection(0 /* pid */, &section);
+    }
+
+    void writePMT(size_t numStreams) {
+        std::vector<uint8_t> section = {
+            0x02, 0xb0, 0x00, 0x00, 0x01, 0xc1, 0x00, 0x00,
+            (uint8_t)(0xe0 | (kFirstStreamPID >> 8)), (uint8_t)kFirstStreamPID, 0xf0, 0x00,
+        };
+        for (size_t i = 0; i < numStreams; ++i) {
+            const unsigned pid = kFirstStreamPID + i;
+            section.insert(section.end(), {
+                ATSParser::STREAMTYPE_MPEG2_AUDIO_ADTS,
+                (uint8_t)(0xe0 | (pid >> 8)), (uint8_t)pid, 0xf0, 0x00,
+            });
+        }
+        writeSection(kPMTPID, &section);
+    }
+
+    void writePES(unsigned pid, uint64_t pts, const std::vector<uint8_t> &payload) {
+        std::vector<uint8_t> pes = {
+            0x00, 0x00, 0x01, 0xc0,
+            (uint8_t)((payload.size() + 8) >> 8), (uint8_t)(payload.size() + 8),
+            0x80, 0x80, 0x05,
+            (uint8_t)(0x21 | ((pts >> 29) & 0x0e)), (uint8_t)(pts >> 22),
+            (uint8_t)(0x01 | ((pts >> 14) & 0xfe)), (uint8_t)(pts >> 7),
+            (uint8_t)(0x01 | ((pts << 1) & 0xfe)),
+        };
+        pes.insert(pes.end(), payload.begin(), payload.end());
+        writePackets(pid, pes);
+    }
+
+private:
+    std::vector<uint8_t> *mOut;
+    uint8_t mContinuityCounter[0x2000] = {};
+
+    void writeSection(unsigned pid, std::vector<uint8_t> *section) {
+        const size_t sectionLength = section->size() - 3 + 4;
+        (*section)[1] |= sectionLength >> 8;
+        (*section)[2] = sectionLength;
+        const uint32_t crc = crc32(*section);
+        section->insert(section->end(), {
+            (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc,
+        });
+        section->insert(section->begin(), 0x00 /* pointer_field */);
+        writePackets(pid, *section);
+    }
+
+    void writePackets(unsigned pid, const std::vector<uint8_t> &data) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            const size_t size = std::min(data.size() - offset, kTSPacketSize - 4);
+            const size_t stuffing = kTSPacketSize - 4 - size;
+            uint8_t &cc = mContinuityCounter[pid];
+            mOut->insert(mOut->end(), {
+                0x47, (uint8_t)((offset == 0 ? 0x40 : 0x00) | (pid >> 8)), (uint8_t)pid,
+                (uint8_t)((stuffing > 0 ? 0x30 : 0x10) | cc),
+            });
+            cc = (cc + 1) & 0x0f;
+            if (stuffing > 0) {
+                mOut->push_back(stuffing - 1);
+                if (stuffing > 1) {
+                    mOut->push_back(0x00);
+                    mOut->insert(mOut->end(), stuffing - 2, 0xff);
+                }
+            }
+            mOut->insert(mOut->end(), data.begin() + offset, data.begin() + offset + size);
+            offset += size;
+        }
+    }
+};
+
+// Returns a program with |numStreams| ADTS AAC streams of |pesPerStream| PES packets each.
+// The frames of each PES packet are filled with a different byte, so that the access units
+// can be told apart.
+inline std::vector<uint8_t> makeSyntheticStream(
+        size_t numStreams = kSyntheticStreams, size_t pesPerStream = kSyntheticPESPerStream) {
+    std::vector<uint8_t> data;
+    TSWriter writer(&data);
+    writer.writePAT();
+    writer.writePMT(numStreams);
+    for (size_t i = 0; i < pesPerStream; ++i) {
+        // 1024 samples per frame at 44.1kHz, in 90kHz units
+        const uint64_t pts = 90000 + i * kFramesPerPES * 1024 * 90000 / 44100;
+        for (size_t j = 0; j < numStreams; ++j) {
+            std::vector<uint8_t> adtsPayload;
+            for (size_t k = 0; k < kFramesPerPES; ++k) {
+                // AAC LC, 44.1kHz, stereo, no CRC
+                adtsPayload.insert(adtsPayload.end(), {
+                    0xff, 0xf1, 0x50, (uint8_t)(0x80 | (kADTSFrameSize >> 11)),
+                    (uint8_t)(kADTSFrameSize >> 3),
+                    (uint8_t)(((kADTSFrameSize & 7) << 5) | 0x1f), 0xfc,
+                });
+                adtsPayload.insert(adtsPayload.end(), kADTSFrameSize - 7,
+                        (uint8_t)(i * kFramesPerPES + k + j));
+            }
+            writer.writePES(kFirstStreamPID + j, pts, adtsPayload);
+        }
+    }
+    return data;
+}
+
+}  // namespace synthetic_ts
+}  // namespace android
+
+#endif  // SYNTHETIC_TS_H_
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace android::mediautils {
+
+/**
+ * A fixed set of worker threads that run a batch of independent tasks together with the calling
+ * thread, e.g. the bands of a frame being color converted, or the effect chains of the audio
+ * sessions of a mixer thread within one period. run() returns only after every task of the
+ * batch has completed, so work issued after it sees the results of all tasks.
+ *
+ * The calling thread runs tasks too: a pool for N threads has N - 1 workers, and a pool with
+ * no worker runs the tasks on the calling thread.
+ *
+ * Batches are run one at a time; run() must not be called concurrently or from a task.
+ */
+class WorkerPool {
+  public:
+    /**
+     * Starts numWorkers threads named "<name>N", N being the index of the worker.
+     * Each worker calls onThreadStart, if any, before running tasks, e.g. to set its priority.
+     */
+    WorkerPool(size_t numWorkers, const std::string& name,
+            const std::function<void()>& onThreadStart = {}) {
+        for (size_t i = 0; i < numWorkers; ++i) {
+            mThreads.emplace_back(&WorkerPool::threadLoop, this,
+                    name + std::to_string(i), onThreadStart);
+        }
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard l(mLock);
+            mExiting = true;
+        }
+        mWorkCondition.notify_all();
+        for (auto& thread : mThreads) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    size_t numWorkers() const { return mThreads.size(); }
+
+    /**
+     * Calls task(i) for each i in [0, count) and waits for all calls to return. Tasks are
+     * claimed in index order by the calling thread and the workers.
+     */
+    void run(size_t count, const std::function<void(size_t)>& task) {
+        std::unique_lock l(mLock);
+        mTask = &task;
+        mCount = count;
+        mNext = 0;
+        mPending = count;
+        if (count > 1) {
+            mWorkCondition.notify_all();
+        }
+        runTasks_l(l);
+        mDoneCondition.wait(l, [this] { return mPending == 0; });
+        mTask = nullptr;
+    }
+
+  private:
+    // Runs tasks of the current batch until none are left to claim. Called with mLock held.
+    void runTasks_l(std::unique_lock<std::mutex>& l) {
+        while (mTask != nullptr && mNext < mCount) {
+            const auto& task = *mTask;
+            const size_t index = mNext++;
+            l.unlock();
+            task(index);
+            l.lock();
+            if (--mPending == 0) {
+                mDoneCondition.notify_all();
+            }
+        }
+    }
+
+    void threadLoop(std::string name, std::function<void()> onThreadStart) {
+        // thread names are limited to 16 characters including the terminator
+        name.resize(std::min(name.size(), (size_t)15));
+        pthread_setname_np(pthread_self(), name.c_str());
+        if (onThreadStart) {
+            onThreadStart();
+        }
+
+        std::unique_lock l(mLock);
+        while (!mExiting) {
+            runTasks_l(l);
+            mWorkCondition.wait(l, [this] {
+                return mExiting || (mTask != nullptr && mNext < mCount);
+            });
+        }
+    }
+
+    std::mutex mLock;
+    std::condition_variable mWorkCondition;  // a batch was posted, or exiting
+    std::condition_variable mDoneCondition;  // the last task of the batch completed
+    const std::function<void(size_t)>* mTask = nullptr;
+    size_t mCount = 0;
+    size_t mNext = 0;
+    size_t mPending = 0;
+    bool mExiting = false;
+    std::vector<std::thread> mThreads;
+};
+
+}  // namespace android::mediautils
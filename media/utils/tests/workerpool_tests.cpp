@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "workerpool_tests"
+
+#include <mediautils/WorkerPool.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace android::mediautils;
+using namespace std::chrono_literals;
+
+TEST(WorkerPoolTests, runsEachTaskOnce) {
+    WorkerPool pool(3, "WorkerPoolTest");
+    ASSERT_EQ(3u, pool.numWorkers());
+    for (size_t count : { 0, 1, 2, 3, 4, 7, 64 }) {
+        std::vector<std::atomic<int>> calls(count);
+        pool.run(count, [&calls](size_t i) { calls[i]++; });
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(1, calls[i].load()) << "task " << i << " of " << count;
+        }
+    }
+}
+
+TEST(WorkerPoolTests, runsOnCallerWithoutWorkers) {
+    WorkerPool pool(0, "WorkerPoolTest");
+    const auto caller = std::this_thread::get_id();
+    size_t calls = 0;
+    pool.run(5, [&](size_t) {
+        EXPECT_EQ(caller, std::this_thread::get_id());
+        ++calls;
+    });
+    EXPECT_EQ(5u, calls);
+}
+
+TEST(WorkerPoolTests, callsOnThreadStartOnEachWorker) {
+    std::atomic<size_t> started = 0;
+    {
+        WorkerPool pool(3, "WorkerPoolTest", [&started] { started++; });
+    }
+    EXPECT_EQ(3u, started.load());
+}
+
+TEST(WorkerPoolTests, joinsBeforeReturning) {
+    WorkerPool pool(3, "WorkerPoolTest");
+    for (int batch = 0; batch < 20; ++batch) {
+        std::atomic<size_t> done = 0;
+        pool.run(8, [&done](size_t i) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100 * (i % 3)));
+            done++;
+        });
+        EXPECT_EQ(8u, done.load());
+    }
+}
+
+TEST(WorkerPoolTests, runsTasksConcurrently) {
+    constexpr size_t kTasks = 4;
+    WorkerPool pool(kTasks - 1, "WorkerPoolTest");
+    // every task waits for all the others to start, which only completes if they run
+    // on different threads.
+    std::atomic<size_t> started = 0;
+    std::atomic<size_t> timeouts = 0;
+    pool.run(kTasks, [&](size_t) {
+        started++;
+        const auto deadline = std::chrono::steady_clock::now() + 5s;
+        while (started.load() < kTasks) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                timeouts++;
+                return;
+            }
+            std::this_thread::yield();
+        }
+    });
+    EXPECT_EQ(0u, timeouts.load());
+}
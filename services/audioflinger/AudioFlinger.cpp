@@ -851,6 +851,7 @@ static void dump_printHelp(int fd) {
             "  --stats: Include call/lock/watchdog stats\n"
             "  --effects: Include effect definitions\n"
             "  --memory: Include memory dump\n"
+            "  --periods: Save per-period pipeline timings to /data/misc/audioserver\n"
             "  -a/--all: Print all except --memory\n"sv;
 
     write(fd, helpStr.data(), helpStr.length());
@@ -3154,8 +3154,8 @@ status_t EffectChain::EffectCallback::createEffectHal(
         const effect_uuid_t *pEffectUuid, int32_t sessionId, int32_t deviceId,
         sp<EffectHalInterface> *effect) {
     status_t status = NO_INIT;
-    const sp<EffectsFactoryHalInterface> effectsFactory =
-            EffectConfiguration::getEffectsFactoryHal();
+    const sp<EffectsFactoryHalInterface>& effectsFactory =
+            mAfThreadCallback->getEffectsFactoryHal();
     if (effectsFactory != 0) {
         status = effectsFactory->createEffect(pEffectUuid, sessionId, io(), deviceId, effect);
     }
@@ -137,6 +137,8 @@ public:
         sp<TrackType> track() const { return mTrack; }
         sp<const ThreadType> const_thread() const { return mThread; }
         sp<const TrackType> const_track() const { return mTrack; }
+        // whether the thread was opened for the patch, and is closed with it
+        bool ownsThread() const { return mCloseThread; }
 
         void closeConnections_l(const sp<IAfPatchPanel>& panel)
                 REQUIRES(audio_utils::AudioFlinger_Mutex)
@@ -206,6 +208,7 @@ public:
             mRecord = other.mRecord;
             mThread = other.mThread;
             mIsEndpointPatch = other.mIsEndpointPatch;
+            mIsDirect = other.mIsDirect;
         }
         Patch(Patch&& other) noexcept { swap(other); }
         Patch& operator=(Patch&& other) noexcept {
@@ -221,6 +224,7 @@ public:
             swap(mRecord, other.mRecord);
             swap(mThread, other.mThread);
             swap(mIsEndpointPatch, other.mIsEndpointPatch);
+            swap(mIsDirect, other.mIsDirect);
         }
 
         friend void swap(Patch& a, Patch& b) noexcept { a.swap(b); }
@@ -257,6 +261,9 @@ public:
 
         wp<IAfThreadBase> mThread;
         bool mIsEndpointPatch;
+        // the software patch is bridged by the playback thread alone, which reads the source
+        // device through a PassthruPatchRecord and converts the PCM in place
+        bool mIsDirect = false;
     };
 
     /* List connected audio ports and their attributes */
@@ -301,6 +308,13 @@ public:
     virtual status_t getLatencyMs_l(audio_patch_handle_t patchHandle, double* latencyMs) const
             REQUIRES(audio_utils::AudioFlinger_Mutex) = 0;
 
+    // Whether the next device to device PCM software patches may be bridged by their playback
+    // thread alone, see Patch::mIsDirect. Initially the value of the af.patch.direct property.
+    virtual void setDirectSoftwarePatchEnabled_l(bool enabled)
+            REQUIRES(audio_utils::AudioFlinger_Mutex) = 0;
+    virtual bool isDirectSoftwarePatchEnabled_l() const
+            REQUIRES(audio_utils::AudioFlinger_Mutex) = 0;
+
     virtual void closeThreadInternal_l(const sp<IAfThreadBase>& thread) const
             REQUIRES(audio_utils::AudioFlinger_Mutex) = 0;
 
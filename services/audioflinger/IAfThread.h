@@ -32,6 +32,7 @@
 #include <media/MmapStreamInterface.h>
 #include <media/audiohal/StreamHalInterface.h>
 #include <media/nblog/NBLog.h>
+#include <timing/PeriodTracer.h>
 #include <timing/SyncEvent.h>
 #include <utils/RefBase.h>
 #include <vibrator/ExternalVibration.h>
@@ -460,7 +461,7 @@ public:
     // return estimated latency in milliseconds, as reported by HAL
     virtual uint32_t latency() const = 0;  // should be in IAfThreadBase?
 
-    virtual uint32_t& fastTrackAvailMask_l() REQUIRES(mutex()) = 0;
+    virtual FastTrackMask& fastTrackAvailMask_l() REQUIRES(mutex()) = 0;
 
     virtual sp<IAfTrack> createTrack_l(
             const sp<Client>& client,
@@ -559,6 +560,8 @@ public:
     virtual bool hasFastMixer() const = 0;
     virtual FastTrackUnderruns getFastTrackUnderruns(size_t fastIndex) const = 0;
     virtual const std::atomic<int64_t>& framesWritten() const = 0;
+    // Stage timestamps of the last periods of threadLoop(), may be read from any thread.
+    virtual const audioflinger::PeriodTracer& periodTracer() const = 0;
 
     virtual bool usesHwAvSync() const = 0;
 
@@ -636,8 +639,11 @@ public:
             EXCLUDES_ThreadBase_Mutex = 0;
     virtual void deletePatchTrack(const sp<IAfPatchRecord>& record)
             EXCLUDES_ThreadBase_Mutex = 0;
+    // FastCapture delivers to up to FastCaptureState::getMaxFastClients() fast tracks,
+    // of which at most one patch record.
     virtual bool fastTrackAvailable() const = 0;
-    virtual void setFastTrackAvailable(bool available) = 0;
+    virtual bool fastPatchRecordAvailable() const = 0;
+    virtual void acquireFastTrack(bool isPatch) = 0;
 
     virtual void setRecordSilenced(audio_port_handle_t portId, bool silenced)
             EXCLUDES_ThreadBase_Mutex = 0;
@@ -23,6 +23,7 @@
 #include "PatchCommandThread.h"
 
 #include <audio_utils/primitives.h>
+#include <cutils/properties.h>
 #include <media/AudioParameter.h>
 #include <media/AudioValidator.h>
 #include <media/DeviceDescriptorBase.h>
@@ -52,6 +53,15 @@ sp<IAfPatchPanel> IAfPatchPanel::create(const sp<IAfPatchPanelCallback>& afPatch
     return sp<PatchPanel>::make(afPatchPanelCallback);
 }
 
+// Device to device PCM software patches are bridged by their playback thread alone when set,
+// instead of by a record thread and a playback thread exchanging data through a PatchRecord
+// and a PatchTrack, each converting the format.
+PatchPanel::PatchPanel(const sp<IAfPatchPanelCallback>& afPatchPanelCallback)
+    : mAfPatchPanelCallback(afPatchPanelCallback)
+    , mDirectSoftwarePatchEnabled(
+            property_get_bool("af.patch.direct", false /* default_value */)) {
+}
+
 status_t SoftwarePatch::getLatencyMs_l(double* latencyMs) const {
     return mPatchPanel->getLatencyMs_l(mPatchHandle, latencyMs);
 }
@@ -551,7 +561,7 @@ status_t PatchPanel::Patch::createConnections_l(const sp<IAfPatchPanel>& panel)
             mAudioPatch.sources[0].flags.input : AUDIO_INPUT_FLAG_NONE;
     if (sampleRate == mRecord.thread()->sampleRate() &&
             inChannelMask == mRecord.thread()->channelMask() &&
-            mRecord.thread()->fastTrackAvailable() &&
+            mRecord.thread()->fastPatchRecordAvailable() &&
             mRecord.thread()->hasFastCapture()) {
         // Create a fast track if the record thread has fast capture to get better performance.
         // Only enable fast mode when there is no resample needed.
@@ -581,9 +591,28 @@ status_t PatchPanel::Patch::createConnections_l(const sp<IAfPatchPanel>& panel)
         outputFlags = (audio_output_flags_t) (outputFlags & ~AUDIO_OUTPUT_FLAG_FAST);
     }
 
+    // A direct patch lets the playback thread read the input stream in PatchTrack::getNextBuffer(),
+    // and the record thread only reads silence from the PassthruPatchRecord.
+    // Both threads must therefore be opened for the patch: the blocking read would delay
+    // the other tracks of a shared playback thread, and the other clients of the record thread
+    // would be silenced. The I/O handles of these threads are not known to the audio policy,
+    // so the patch tracks remain their only tracks.
+    // The read must not happen on a fast mixer or while a fast capture reads the same stream.
+    // The stream data is converted in place to the playback thread format, so only the sample
+    // rates need to match.
+    mIsDirect = panel->isDirectSoftwarePatchEnabled_l()
+            && mPlayback.ownsThread() && mRecord.ownsThread()
+            && audio_is_linear_pcm(inputFormat) && audio_is_linear_pcm(format)
+            && sampleRate == mRecord.thread()->sampleRate()
+            && !mRecord.thread()->hasFastCapture();
+    if (mIsDirect) {
+        inputFlags = (audio_input_flags_t) (inputFlags & ~AUDIO_INPUT_FLAG_FAST);
+        outputFlags = (audio_output_flags_t) (outputFlags & ~AUDIO_OUTPUT_FLAG_FAST);
+    }
+
     sp<IAfPatchRecord> tempRecordTrack;
-    const bool usePassthruPatchRecord =
-            (inputFlags & AUDIO_INPUT_FLAG_DIRECT) && (outputFlags & AUDIO_OUTPUT_FLAG_DIRECT);
+    const bool usePassthruPatchRecord = mIsDirect ||
+            ((inputFlags & AUDIO_INPUT_FLAG_DIRECT) && (outputFlags & AUDIO_OUTPUT_FLAG_DIRECT));
     const size_t playbackFrameCount = mPlayback.thread()->frameCount();
     const size_t recordFrameCount = mRecord.thread()->frameCount();
     size_t frameCount = 0;
@@ -704,6 +733,9 @@ status_t PatchPanel::Patch::getLatencyMs(double* latencyMs) const
     // TODO: is this stable enough? Consider a PatchTrack synchronized version of this.
 
     // For PCM tracks get server latency.
+    // For a direct patch, the record thread reads the capture position of the input stream
+    // through the PassthruPatchRecord, and the frames it reads are those the playback thread
+    // has read: the record server latency is that of the input stream.
     if (audio_is_linear_pcm(recordTrack->format())) {
         double recordServerLatencyMs, playbackTrackLatencyMs;
         if (recordTrack->getServerLatencyMs(&recordServerLatencyMs) == OK
@@ -748,7 +780,8 @@ String8 PatchPanel::Patch::dump(audio_patch_handle_t myHandle) const
 {
     // TODO: Consider table dump form for patches, just like tracks.
     String8 result = String8::format("Patch %d: %s (thread %p => thread %p)",
-            myHandle, isSoftware() ? "Software bridge between" : "No software bridge",
+            myHandle, !isSoftware() ? "No software bridge"
+                    : mIsDirect ? "Direct software bridge between" : "Software bridge between",
             mRecord.const_thread().get(), mPlayback.const_thread().get());
 
     bool hasSinkDevice =
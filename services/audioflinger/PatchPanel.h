@@ -26,8 +26,7 @@ namespace android {
 
 class PatchPanel : public IAfPatchPanel {
 public:
-    explicit PatchPanel(const sp<IAfPatchPanelCallback>& afPatchPanelCallback)
-        : mAfPatchPanelCallback(afPatchPanelCallback) {}
+    explicit PatchPanel(const sp<IAfPatchPanelCallback>& afPatchPanelCallback);
 
     /* List connected audio ports and their attributes */
     status_t listAudioPorts_l(unsigned int *num_ports,
@@ -70,6 +69,11 @@ public:
     status_t getLatencyMs_l(audio_patch_handle_t patchHandle, double* latencyMs) const final
             REQUIRES(audio_utils::AudioFlinger_Mutex);
 
+    void setDirectSoftwarePatchEnabled_l(bool enabled) final
+            REQUIRES(audio_utils::AudioFlinger_Mutex) { mDirectSoftwarePatchEnabled = enabled; }
+    bool isDirectSoftwarePatchEnabled_l() const final
+            REQUIRES(audio_utils::AudioFlinger_Mutex) { return mDirectSoftwarePatchEnabled; }
+
     void closeThreadInternal_l(const sp<IAfThreadBase>& thread) const final
             REQUIRES(audio_utils::AudioFlinger_Mutex);
 
@@ -124,6 +128,7 @@ private:
 
     const sp<IAfPatchPanelCallback> mAfPatchPanelCallback;
     std::map<audio_patch_handle_t, Patch> mPatches;
+    bool mDirectSoftwarePatchEnabled GUARDED_BY(audio_utils::AudioFlinger_Mutex);
 
     // This map allows going from a thread to "downstream" software patches
     // when a processing module inserted in between. Example:
@@ -219,8 +219,15 @@ private:
 
     sp<StreamInHalInterface> obtainStream(sp<IAfThreadBase>* thread);
     audio_utils::mutex& readMutex() const { return mReadMutex; }
+    // Converts frames read from the stream in mSinkBuffer to the track format and channel count.
+    void convertStreamFrames(size_t frameCount);
 
     PatchRecordAudioBufferProvider mPatchRecordAudioBufferProvider;
+    // Format of the input stream, which differs from the track format
+    // when the patch converts PCM between devices.
+    const audio_format_t mStreamFormat;
+    const uint32_t mStreamChannelCount;
+    const size_t mStreamFrameSize;
     std::unique_ptr<void, decltype(free)*> mSinkBuffer;  // frame size aligned continuous buffer
     std::unique_ptr<void, decltype(free)*> mStubBuffer;  // buffer used for AudioBufferProvider
     size_t mUnconsumedFrames = 0;
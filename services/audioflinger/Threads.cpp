@@ -29,6 +29,7 @@
 
 #include <afutils/FallibleLockGuard.h>
 #include <afutils/Permission.h>
+#include <afutils/SessionEffectChains.h>
 #include <afutils/TypedLogger.h>
 #include <afutils/Vibrator.h>
 #include <audio_utils/MelProcessor.h>
@@ -89,6 +90,7 @@
 #include <utils/Log.h>
 #include <utils/Trace.h>
 
+#include <algorithm>
 #include <fcntl.h>
 #include <linux/futex.h>
 #include <math.h>
@@ -130,6 +132,7 @@ namespace audioserver_flags = com::android::media::audioserver;
 
 namespace android {
 
+using audioflinger::PeriodTracer;
 using audioflinger::SyncEvent;
 using media::IEffectClient;
 using content::AttributionSourceState;
@@ -309,6 +312,10 @@ bool IAfThreadBase::isValidPcmSinkChannelMask(audio_channel_mask_t channelMask)
 // Set kEnableExtendedPrecision to true to use extended precision in MixerThread
 constexpr bool kEnableExtendedPrecision = true;
 
+// Upper bound of "af.effect_chain_workers", the number of threads processing the effect chains
+// of audio sessions alongside a MixerThread.
+constexpr int32_t kMaxEffectChainWorkers = 3;
+
 // Returns true if format is permitted for the PCM sink in the MixerThread
 /* static */
 bool IAfThreadBase::isValidPcmSinkFormat(audio_format_t format) {
@@ -2180,8 +2187,6 @@ PlaybackThread::PlaybackThread(const sp<IAfThreadCallback>& afThreadCallback,
         mWriteAckSequence(0),
         mDrainSequence(0),
         mScreenState(mAfThreadCallback->getScreenState()),
-        // index 0 is reserved for normal mixer's submix
-        mFastTrackAvailMask(((1 << FastMixerState::sMaxFastTracks) - 1) & ~1),
         mHwSupportsPause(false), mHwPaused(false), mFlushPending(false),
         mLeftVolFloat(-1.0), mRightVolFloat(-1.0),
         mDownStreamPatch{},
@@ -2190,6 +2195,11 @@ PlaybackThread::PlaybackThread(const sp<IAfThreadCallback>& afThreadCallback,
     snprintf(mThreadName, kThreadNameLength, "AudioOut_%X", id);
     mFlagsAsString = toString(output->flags);
 
+    // index 0 is reserved for normal mixer's submix
+    for (unsigned i = 1; i < FastMixerState::getMaxFastTracks(); ++i) {
+        mFastTrackAvailMask.set(i);
+    }
+
     // Assumes constructor is called by AudioFlinger with its mutex() held, but
     // it would be safer to explicitly pass initial masterVolume/masterMute as
     // parameter.
@@ -2244,6 +2254,22 @@ PlaybackThread::PlaybackThread(const sp<IAfThreadCallback>& afThreadCallback,
         mStreamTypes[AUDIO_STREAM_CALL_ASSISTANT].volume = 1.0f;
         mStreamTypes[AUDIO_STREAM_CALL_ASSISTANT].mute = false;
     }
+    if (type == MIXER && mEffectBufferEnabled) {
+        // Number of threads, besides this one, processing the effect chains of different
+        // audio sessions concurrently. 0 processes them one after the other on this thread.
+        const int32_t workers = std::clamp(
+                property_get_int32("af.effect_chain_workers", 0 /* default_value */),
+                0, kMaxEffectChainWorkers);
+        if (workers > 0) {
+            mEffectChainWorkers = std::make_unique<mediautils::WorkerPool>(
+                    workers, std::string(mThreadName).append("_Fx"), [] {
+                        if (androidSetThreadPriority(0 /* tid */,
+                                ANDROID_PRIORITY_URGENT_AUDIO) != 0) {
+                            ALOGW("cannot raise priority of an effect chain worker");
+                        }
+                    });
+        }
+    }
 }
 
 PlaybackThread::~PlaybackThread()
@@ -2356,6 +2382,35 @@ void PlaybackThread::dumpTracks_l(int fd, const Vector<String16>& /* args */)
     write(fd, result.c_str(), result.size());
 }
 
+// Directory of the period traces saved by "dumpsys media.audio_flinger --periods".
+static constexpr char kPeriodTraceDirectory[] = "/data/misc/audioserver";
+
+// Prints the stage statistics of tracer and, when requested by the "--periods" dump
+// argument, saves its records to kPeriodTraceDirectory/afperiods_<name>.bin in the
+// PeriodTracer::BinaryHeader format.
+static void dumpPeriodTrace(int fd, const Vector<String16>& args,
+        const PeriodTracer& tracer, const std::string& name)
+{
+    dprintf(fd, "%s", tracer.toString("  ").c_str());
+    bool savePeriods = false;
+    for (const auto& arg : args) {
+        savePeriods |= String8(arg) == "--periods";
+    }
+    if (!savePeriods) return;
+
+    const std::string path =
+            std::string(kPeriodTraceDirectory).append("/afperiods_").append(name).append(".bin");
+    const int traceFd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+    if (traceFd < 0) {
+        dprintf(fd, "  Cannot save period trace to %s: %s\n", path.c_str(), strerror(errno));
+        return;
+    }
+    if (tracer.writeBinary(traceFd)) {
+        dprintf(fd, "  Period trace saved to %s\n", path.c_str());
+    }
+    close(traceFd);
+}
+
 void PlaybackThread::dumpInternals_l(int fd, const Vector<String16>& args)
 {
     dprintf(fd, "  Master volume: %f\n", mMasterVolume);
@@ -2371,7 +2426,7 @@ void PlaybackThread::dumpInternals_l(int fd, const Vector<String16>& args)
     dprintf(fd, "  Delayed writes: %d\n", mNumDelayedWrites);
     dprintf(fd, "  Blocked in write: %s\n", mInWrite ? "yes" : "no");
     dprintf(fd, "  Suspend count: %d\n", (int32_t)mSuspended);
-    dprintf(fd, "  Fast track availMask=%#x\n", mFastTrackAvailMask);
+    dprintf(fd, "  Fast track availMask=%s\n", mFastTrackAvailMask.toString().c_str());
     dprintf(fd, "  Standby delay ns=%lld\n", (long long)mStandbyDelayNs);
     AudioStreamOut *output = mOutput;
     audio_output_flags_t flags = output != NULL ? output->flags : AUDIO_OUTPUT_FLAG_NONE;
@@ -2382,6 +2437,7 @@ void PlaybackThread::dumpInternals_l(int fd, const Vector<String16>& args)
     if (mPipeSink.get() != nullptr) {
         dprintf(fd, "  PipeSink frames written: %lld\n", (long long)mPipeSink->framesWritten());
     }
+    dumpPeriodTrace(fd, args, mPeriodTracer, std::to_string(mId));
     if (output != nullptr) {
         dprintf(fd, "  Hal stream dump:\n");
         (void)output->stream->dump(fd, args);
@@ -2481,7 +2537,7 @@ sp<IAfTrack> PlaybackThread::createTrack_l(
             // normal mixer has an associated fast mixer
             hasFastMixer() &&
             // there are sufficient fast track slots available
-            (mFastTrackAvailMask != 0)
+            mFastTrackAvailMask.any()
             // FIXME test that MixerThread for this fast track has a capable output HAL
             // FIXME add a permission test also?
         ) {
@@ -2525,7 +2581,7 @@ sp<IAfTrack> PlaybackThread::createTrack_l(
                 "hasFastMixer=%d tid=%d fastTrackAvailMask=%#x",
                 sharedBuffer.get(), frameCount, mFrameCount, format, mFormat,
                 audio_is_linear_pcm(format), channelMask, sampleRate,
-                mSampleRate, hasFastMixer(), tid, mFastTrackAvailMask);
+                mSampleRate, hasFastMixer(), tid, mFastTrackAvailMask.toString().c_str());
         *flags = (audio_output_flags_t)(*flags & ~AUDIO_OUTPUT_FLAG_FAST);
       }
     }
@@ -3052,8 +3108,8 @@ void PlaybackThread::removeTrack_l(const sp<IAfTrack>& track)
     if (track->isFastTrack()) {
         int index = track->fastIndex();
         ALOG_ASSERT(0 < index && index < (int)FastMixerState::sMaxFastTracks);
-        ALOG_ASSERT(!(mFastTrackAvailMask & (1 << index)));
-        mFastTrackAvailMask |= 1 << index;
+        ALOG_ASSERT(!mFastTrackAvailMask.test(index));
+        mFastTrackAvailMask.set(index);
         // redundant as track is about to be destroyed, for dumpsys only
         track->fastIndex() = -1;
     }
@@ -3879,6 +3935,16 @@ status_t PlaybackThread::addEffectChain_l(const sp<IAfEffectChain>& chain)
                 buffer = halInBuffer ? halInBuffer->audioBuffer()->f32 : buffer;
                 ALOGV("addEffectChain_l() creating new input buffer %p session %d",
                         buffer, session);
+
+                // Chains processed concurrently cannot accumulate into the same buffer:
+                // threadLoop() sums their outputs into mEffectBuffer once all are done.
+                if (mEffectChainWorkers != nullptr) {
+                    const status_t outputStatus =
+                            mAfThreadCallback->getEffectsFactoryHal()->allocateBuffer(
+                            numSamples * sizeof(float),
+                            &halOutBuffer);
+                    if (outputStatus != OK) return outputStatus;
+                }
             }
         }
     }
@@ -4088,6 +4154,7 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
     for (int64_t loopCount = 0; !exitPending(); ++loopCount)
     {
         cpuStats.sample(myName);
+        mPeriodTracer.beginPeriod();
 
         Vector<sp<IAfEffectChain>> effectChains;
         audio_session_t activeHapticSessionId = AUDIO_SESSION_NONE;
@@ -4233,7 +4300,9 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
                 }
             }
             // mMixerStatusIgnoringFastTracks is also updated internally
+            mPeriodTracer.beginStage(PeriodTracer::STAGE_PREPARE);
             mMixerStatus = prepareTracks_l(&tracksToRemove);
+            mPeriodTracer.endStage(PeriodTracer::STAGE_PREPARE);
 
             mActiveTracks.updatePowerState_l(this);
 
@@ -4307,7 +4376,9 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
             mCurrentWriteLength = 0;
             if (mMixerStatus == MIXER_TRACKS_READY) {
                 // threadLoop_mix() sets mCurrentWriteLength
+                mPeriodTracer.beginStage(PeriodTracer::STAGE_MIX);
                 threadLoop_mix();
+                mPeriodTracer.endStage(PeriodTracer::STAGE_MIX);
             } else if ((mMixerStatus != MIXER_DRAIN_TRACK)
                         && (mMixerStatus != MIXER_DRAIN_ALL)) {
                 // threadLoop_sleepTime sets mSleepTimeUs to 0 if data
@@ -4395,10 +4466,20 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
 
             // only process effects if we're going to write
             if (mSleepTimeUs == 0 && mType != OFFLOAD) {
+                mPeriodTracer.beginStage(PeriodTracer::STAGE_EFFECTS);
+                if (mEffectChainWorkers != nullptr) {
+                    processSessionEffectChains(effectChains, activeHapticSessionId);
+                }
                 for (size_t i = 0; i < effectChains.size(); i ++) {
-                    effectChains[i]->process_l();
+                    // the session chains have already run on mEffectChainWorkers
+                    const bool processed = mEffectChainWorkers != nullptr
+                            && !audio_is_global_session(effectChains[i]->sessionId());
+                    if (!processed) {
+                        effectChains[i]->process_l();
+                    }
                     // TODO: Write haptic data directly to sink buffer when mixing.
-                    if (activeHapticSessionId != AUDIO_SESSION_NONE
+                    // processSessionEffectChains() copies the haptic data of the chains it ran.
+                    if (!processed && activeHapticSessionId != AUDIO_SESSION_NONE
                             && activeHapticSessionId == effectChains[i]->sessionId()) {
                         // Haptic data is active in this case, copy it directly from
                         // in buffer to out buffer.
@@ -4419,6 +4500,7 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
                                 AUDIO_FORMAT_PCM_FLOAT, mNormalFrameCount * mHapticChannelCount);
                     }
                 }
+                mPeriodTracer.endStage(PeriodTracer::STAGE_EFFECTS);
             }
         }
         // Process effect chains for offloaded thread even if no audio
@@ -4510,6 +4592,8 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
                     const int64_t lastIoBeginNs = systemTime();
                     ret = threadLoop_write();
                     const int64_t lastIoEndNs = systemTime();
+                    mPeriodTracer.beginStage(PeriodTracer::STAGE_WRITE, lastIoBeginNs);
+                    mPeriodTracer.endStage(PeriodTracer::STAGE_WRITE, lastIoEndNs);
                     if (ret < 0) {
                         mBytesRemaining = 0;
                     } else if (ret > 0) {
@@ -4665,6 +4749,8 @@ NO_THREAD_SAFETY_ANALYSIS  // manual locking of AudioFlinger
             }
         }
 
+        mPeriodTracer.endPeriod(activeTracks.size());
+
         // Finally let go of removed track(s), without the lock held
         // since we can't guarantee the destructors won't acquire that
         // same lock.  This will also mutate and push a new fast mixer state.
@@ -4836,6 +4922,38 @@ void PlaybackThread::collectTimestamps_l()
 #endif
 }
 
+// The effect chains are locked by threadLoop() for the whole period, see lockEffectChains_l().
+static void processEffectChain(const sp<IAfEffectChain>& chain)
+NO_THREAD_SAFETY_ANALYSIS
+{
+    chain->process_l();
+}
+
+void PlaybackThread::processSessionEffectChains(const Vector<sp<IAfEffectChain>>& effectChains,
+        audio_session_t activeHapticSessionId)
+{
+    // Session chains are at the front of the chains list, see addEffectChain_l().
+    size_t sessionChainCount = 0;
+    const float* hapticInBuffer = nullptr;
+    while (sessionChainCount < effectChains.size()
+            && !audio_is_global_session(effectChains[sessionChainCount]->sessionId())) {
+        if (activeHapticSessionId != AUDIO_SESSION_NONE
+                && activeHapticSessionId == effectChains[sessionChainCount]->sessionId()) {
+            hapticInBuffer = effectChains[sessionChainCount]->inBuffer();
+        }
+        sessionChainCount++;
+    }
+    if (sessionChainCount == 0) {
+        return;
+    }
+
+    afutils::processSessionEffectChains(*mEffectChainWorkers, sessionChainCount,
+            [&effectChains](size_t i) { processEffectChain(effectChains[i]); },
+            [&effectChains](size_t i) { return effectChains[i]->outBuffer(); },
+            hapticInBuffer, static_cast<float*>(mEffectBuffer), mNormalFrameCount,
+            audio_channel_count_from_out_mask(mMixerChannelMask), mHapticChannelCount);
+}
+
 // removeTracks_l() must be called with ThreadBase::mutex() held
 void PlaybackThread::removeTracks_l(const Vector<sp<IAfTrack>>& tracksToRemove)
 NO_THREAD_SAFETY_ANALYSIS  // release and re-acquire mutex()
@@ -5258,7 +5376,7 @@ MixerThread::MixerThread(const sp<IAfThreadCallback>& afThreadCallback, AudioStr
         snprintf(fastTrack->mTraceName, sizeof(fastTrack->mTraceName),
                  "%s.0.0.%d", AUDIO_TRACE_PREFIX_AUDIO_TRACK_FRDY, mId);
         state->mFastTracksGen++;
-        state->mTrackMask = 1;
+        state->mTrackMask = FastTrackMask(1);
         // fast mixer will use the HAL output sink
         state->mOutputSink = mOutputSink.get();
         state->mOutputSinkGen++;
@@ -5341,7 +5459,7 @@ MixerThread::~MixerThread()
         // We'll use that extract the final state which contains one remaining fast track
         // corresponding to our sub-mix.
         state = sq->begin();
-        ALOG_ASSERT(state->mTrackMask == 1);
+        ALOG_ASSERT(state->mTrackMask == FastTrackMask(1));
         FastTrack *fastTrack = &state->mFastTracks[0];
         ALOG_ASSERT(fastTrack->mBufferProvider != NULL);
         delete fastTrack->mBufferProvider;
@@ -5391,7 +5509,8 @@ ssize_t MixerThread::threadLoop_write()
         FastMixerStateQueue *sq = mFastMixer->sq();
         FastMixerState *state = sq->begin();
         if (state->mCommand != FastMixerState::MIX_WRITE &&
-                (kUseFastMixer != FastMixer_Dynamic || state->mTrackMask > 1)) {
+                (kUseFastMixer != FastMixer_Dynamic ||
+                        state->mTrackMask.findFirst(1) < FastTrackMask::kBits)) {
             if (state->mCommand == FastMixerState::COLD_IDLE) {
 
                 // FIXME workaround for first HAL write being CPU bound on some devices
@@ -5706,7 +5825,7 @@ PlaybackThread::mixer_state MixerThread::prepareTracks_l(
             // is impossible because the slot isn't marked available until the end of each cycle.
             int j = track->fastIndex();
             ALOG_ASSERT(0 < j && j < (int)FastMixerState::sMaxFastTracks);
-            ALOG_ASSERT(!(mFastTrackAvailMask & (1 << j)));
+            ALOG_ASSERT(!mFastTrackAvailMask.test(j));
             FastTrack *fastTrack = &state->mFastTracks[j];
 
             // Determine whether the track is currently in underrun condition,
@@ -5816,7 +5935,7 @@ PlaybackThread::mixer_state MixerThread::prepareTracks_l(
 
             if (isActive) {
                 // was it previously inactive?
-                if (!(state->mTrackMask & (1 << j))) {
+                if (!state->mTrackMask.test(j)) {
                     ExtendedAudioBufferProvider *eabp = track->asExtendedAudioBufferProvider();
                     VolumeProvider *vp = track->asVolumeProvider();
                     fastTrack->mBufferProvider = eabp;
@@ -5830,7 +5949,7 @@ PlaybackThread::mixer_state MixerThread::prepareTracks_l(
                     snprintf(fastTrack->mTraceName, sizeof(fastTrack->mTraceName),
                              "%s%s", AUDIO_TRACE_PREFIX_AUDIO_TRACK_FRDY,
                              track->getTraceSuffix().c_str());
-                    state->mTrackMask |= 1 << j;
+                    state->mTrackMask.set(j);
                     didModify = true;
                     // no acknowledgement required for newly active tracks
                 }
@@ -5899,10 +6018,10 @@ PlaybackThread::mixer_state MixerThread::prepareTracks_l(
                 ++fastTracks;
             } else {
                 // was it previously active?
-                if (state->mTrackMask & (1 << j)) {
+                if (state->mTrackMask.test(j)) {
                     fastTrack->mBufferProvider = NULL;
                     fastTrack->mGeneration++;
-                    state->mTrackMask &= ~(1 << j);
+                    state->mTrackMask.reset(j);
                     didModify = true;
                     // If any fast tracks were removed, we must wait for acknowledgement
                     // because we're about to decrement the last sp<> on those tracks.
@@ -5914,8 +6033,9 @@ PlaybackThread::mixer_state MixerThread::prepareTracks_l(
                     // FastTrack state hasn't had time to update.
                     // TODO Remove the ALOGW when this theory is confirmed.
                     ALOGW("fast track %d should have been active; "
-                            "mState=%d, mTrackMask=%#x, recentUnderruns=%u, isShared=%d",
-                            j, (int)track->state(), state->mTrackMask, recentUnderruns,
+                            "mState=%d, mTrackMask=%s, recentUnderruns=%u, isShared=%d",
+                            j, (int)track->state(), state->mTrackMask.toString().c_str(),
+                            recentUnderruns,
                             track->sharedBuffer() != 0);
                     // Since the FastMixer state already has the track inactive, do nothing here.
                 }
@@ -6349,7 +6469,8 @@ PlaybackThread::mixer_state MixerThread::prepareTracks_l(
         state->mFastTracksGen++;
         // if the fast mixer was active, but now there are no fast tracks, then put it in cold idle
         if (kUseFastMixer == FastMixer_Dynamic &&
-                state->mCommand == FastMixerState::MIX_WRITE && state->mTrackMask <= 1) {
+                state->mCommand == FastMixerState::MIX_WRITE &&
+                state->mTrackMask.findFirst(1) == FastTrackMask::kBits) {
             state->mCommand = FastMixerState::COLD_IDLE;
             state->mColdFutexAddr = &mFastMixerFutex;
             state->mColdGen++;
@@ -6617,6 +6738,8 @@ void MixerThread::dumpInternals_l(int fd, const Vector<String16>& args)
         const std::unique_ptr<FastMixerDumpState> copy =
                 std::make_unique<FastMixerDumpState>(mFastMixerDumpState);
         copy->dump(fd);
+        dprintf(fd, "  FastMixer:\n");
+        dumpPeriodTrace(fd, args, mFastMixer->periodTracer(), std::to_string(mId) + "_F");
 
 #ifdef STATE_QUEUE_DUMP
         // Similar for state queue
@@ -6789,6 +6912,7 @@ void DirectOutputThread::dumpInternals_l(int fd, const Vector<String16>& args)
     PlaybackThread::dumpInternals_l(fd, args);
     dprintf(fd, "  Master balance: %f  Left: %f  Right: %f\n",
             mMasterBalance.load(), mMasterBalanceLeft, mMasterBalanceRight);
+    dprintf(fd, "  Software volume: %s\n", mSoftwareVolume != nullptr ? "yes" : "no");
 }
 
 void DirectOutputThread::setMasterBalance(float balance)
@@ -6912,9 +7036,15 @@ void DirectOutputThread::processVolume_l(IAfTrack* track, bool lastTrack)
                 uint32_t vr = (uint32_t)(right * (1 << 24));
                 // Direct/Offload effect chains set output volume in setVolume().
                 (void)mEffectChains[0]->setVolume(&vl, &vr);
-            } else {
-                // otherwise we directly set the volume.
-                setVolumeForOutput_l(left, right);
+            } else if (mSoftwareVolume != nullptr) {
+                mSoftwareVolume->setVolume(left, right, mFrameCount);
+            } else if (mOutput->stream->setVolume(left, right) != NO_ERROR
+                    && mType == DIRECT && AudioVolumeRamp::isFormatSupported(mFormat)) {
+                // The HAL does not control the volume of this PCM stream,
+                // apply it to the data written from now on.
+                ALOGI("%s: HAL stream volume not supported, using software volume", __func__);
+                mSoftwareVolume = std::make_unique<AudioVolumeRamp>(mFormat, mChannelCount);
+                mSoftwareVolume->setVolume(left, right, mFrameCount);
             }
         }
     }
@@ -7190,6 +7320,9 @@ void DirectOutputThread::threadLoop_mix()
         mActiveTrack->releaseBuffer(&buffer);
     }
     mCurrentWriteLength = curBuf - (int8_t *)mSinkBuffer;
+    if (mSoftwareVolume != nullptr) {
+        mSoftwareVolume->process(mSinkBuffer, mFrameCount);
+    }
     mSleepTimeUs = 0;
     mStandbyTimeNs = systemTime() + mStandbyDelayNs;
     mActiveTrack.clear();
@@ -8258,7 +8391,8 @@ RecordThread::RecordThread(const sp<IAfThreadCallback>& afThreadCallback,
     , mPipeFramesP2(0)
     // mPipeMemory
     // mFastCaptureNBLogWriter
-    , mFastTrackAvail(false)
+    , mFastTracksAvail(0)
+    , mFastPatchRecordAvail(false)
     , mBtNrecSuspended(false)
 {
     snprintf(mThreadName, kThreadNameLength, "AudioIn_%X", id);
@@ -8356,7 +8490,6 @@ RecordThread::RecordThread(const sp<IAfThreadCallback>& afThreadCallback,
         // FIXME
 #endif
         FastCaptureState *state = sq->begin();
-        state->mCblk = NULL;
         state->mInputSource = mInputSource.get();
         state->mInputSourceGen++;
         state->mPipeSink = pipe;
@@ -8385,7 +8518,8 @@ RecordThread::RecordThread(const sp<IAfThreadCallback>& afThreadCallback,
         // FIXME
 #endif
 
-        mFastTrackAvail = true;
+        mFastTracksAvail = FastCaptureState::getMaxFastClients();
+        mFastPatchRecordAvail = true;
     }
 #ifdef TEE_SINK
     mTee.set(mInputSource->format(), NBAIO_Tee::TEE_FLAG_INPUT_THREAD);
@@ -8466,11 +8600,11 @@ reacquire_wakelock:
         // activeTracks accumulates a copy of a subset of mActiveTracks
         Vector<sp<IAfRecordTrack>> activeTracks;
 
-        // reference to the (first and only) active fast track
-        sp<IAfRecordTrack> fastTrack;
+        // references to the active fast tracks, delivered directly by FastCapture
+        std::vector<sp<IAfRecordTrack>> fastTracks;
 
-        // reference to a fast track which is about to be removed
-        sp<IAfRecordTrack> fastTrackToRemove;
+        // references to fast tracks which are about to be removed
+        std::vector<sp<IAfRecordTrack>> fastTracksToRemove;
 
         bool silenceFastCapture = false;
 
@@ -8516,8 +8650,7 @@ reacquire_wakelock:
                 activeTrack = mActiveTracks[i];
                 if (activeTrack->isTerminated()) {
                     if (activeTrack->isFastTrack()) {
-                        ALOG_ASSERT(fastTrackToRemove == 0);
-                        fastTrackToRemove = activeTrack;
+                        fastTracksToRemove.push_back(activeTrack);
                     }
                     removeTrack_l(activeTrack);
                     mActiveTracks.remove(activeTrack);
@@ -8535,7 +8668,7 @@ reacquire_wakelock:
                         ALOGV("%s fast track is paused, thus removed from active list", __func__);
                         // Keep a ref on fast track to wait for FastCapture thread to get updated
                         // state before potential track removal
-                        fastTrackToRemove = activeTrack;
+                        fastTracksToRemove.push_back(activeTrack);
                     }
                     doBroadcast = true;
                     size--;
@@ -8571,8 +8704,7 @@ reacquire_wakelock:
                 }
 
                 if (activeTrack->isFastTrack()) {
-                    ALOG_ASSERT(!mFastTrackAvail);
-                    ALOG_ASSERT(fastTrack == 0);
+                    ALOG_ASSERT(fastTracks.size() < FastCaptureState::getMaxFastClients());
                     // if the active fast track is silenced either:
                     // 1) silence the whole capture from fast capture buffer if this is
                     //    the only active track
@@ -8594,13 +8726,13 @@ reacquire_wakelock:
                     }
                     if (invalidate) {
                         activeTrack->invalidate();
-                        fastTrackToRemove = activeTrack;
+                        fastTracksToRemove.push_back(activeTrack);
                         removeTrack_l(activeTrack);
                         mActiveTracks.remove(activeTrack);
                         size--;
                         continue;
                     }
-                    fastTrack = activeTrack;
+                    fastTracks.push_back(activeTrack);
                 }
 
                 activeTracks.add(activeTrack);
@@ -8650,6 +8782,10 @@ reacquire_wakelock:
 
         // thread mutex is now unlocked, mActiveTracks unknown, activeTracks.size() > 0
 
+        // With only fast tracks active, nothing waits on this thread: the pipe is read
+        // in larger blocks and less often, just to keep the server position running.
+        const bool fastTracksOnly = fastTracks.size() == activeTracks.size();
+
         size_t size = effectChains.size();
         for (size_t i = 0; i < size; i++) {
             // thread mutex is not locked, but effect chain is locked
@@ -8663,7 +8799,8 @@ reacquire_wakelock:
             bool didModify = false;
             FastCaptureStateQueue::block_t block = FastCaptureStateQueue::BLOCK_UNTIL_PUSHED;
             if (state->mCommand != FastCaptureState::READ_WRITE /* FIXME &&
-                    (kUseFastMixer != FastMixer_Dynamic || state->mTrackMask > 1)*/) {
+                    (kUseFastMixer != FastMixer_Dynamic ||
+                            state->mTrackMask.findFirst(1) < FastTrackMask::kBits)*/) {
                 if (state->mCommand == FastCaptureState::COLD_IDLE) {
                     int32_t old = android_atomic_inc(&mFastCaptureFutex);
                     if (old == -1) {
@@ -8678,22 +8815,39 @@ reacquire_wakelock:
 #endif
                 didModify = true;
             }
-            audio_track_cblk_t *cblkOld = state->mCblk;
-            audio_track_cblk_t *cblkNew = fastTrack != 0 ? fastTrack->cblk() : NULL;
-            if (cblkNew != cblkOld) {
-                state->mCblk = cblkNew;
+            // a patch record is served through its buffer provider, the other fast tracks
+            // share the pipe buffer and are delivered through their control block.
+            audio_track_cblk_t *cblkNew[FastCaptureState::kMaxFastClients] = {};
+            sp<IAfRecordTrack> fastPatchRecord;
+            size_t fastClients = 0;
+            for (const auto& track : fastTracks) {
+                if (track->isPatchTrack()) {
+                    fastPatchRecord = track;
+                } else {
+                    cblkNew[fastClients++] = track->cblk();
+                }
+            }
+            if (!std::equal(std::begin(cblkNew), std::end(cblkNew), std::begin(state->mCblk))) {
                 // block until acked if removing a fast track
-                if (cblkOld != NULL) {
-                    block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+                for (audio_track_cblk_t *cblkOld : state->mCblk) {
+                    if (cblkOld != NULL && std::find(std::begin(cblkNew), std::end(cblkNew),
+                            cblkOld) == std::end(cblkNew)) {
+                        block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+                    }
                 }
+                std::copy(std::begin(cblkNew), std::end(cblkNew), std::begin(state->mCblk));
                 didModify = true;
             }
-            AudioBufferProvider* abp = (fastTrack != 0 && fastTrack->isPatchTrack()) ?
-                    reinterpret_cast<AudioBufferProvider*>(fastTrack.get()) : nullptr;
+            AudioBufferProvider* abp = fastPatchRecord != 0 ?
+                    reinterpret_cast<AudioBufferProvider*>(fastPatchRecord.get()) : nullptr;
             if (state->mFastPatchRecordBufferProvider != abp) {
+                // block until acked if removing a fast patch record
+                if (state->mFastPatchRecordBufferProvider != nullptr) {
+                    block = FastCaptureStateQueue::BLOCK_UNTIL_ACKED;
+                }
                 state->mFastPatchRecordBufferProvider = abp;
-                state->mFastPatchRecordFormat = fastTrack == 0 ?
-                        AUDIO_FORMAT_INVALID : fastTrack->format();
+                state->mFastPatchRecordFormat = fastPatchRecord == 0 ?
+                        AUDIO_FORMAT_INVALID : fastPatchRecord->format();
                 didModify = true;
             }
             if (state->mSilenceCapture != silenceFastCapture) {
@@ -8711,8 +8865,8 @@ reacquire_wakelock:
             }
         }
 
-        // now run the fast track destructor with thread mutex unlocked
-        fastTrackToRemove.clear();
+        // now run the fast track destructors with thread mutex unlocked
+        fastTracksToRemove.clear();
 
         // Read from HAL to keep up with fastest client if multiple active tracks, not slowest one.
         // Only the client(s) that are too slow will overrun. But if even the fastest client is too
@@ -8726,7 +8880,8 @@ reacquire_wakelock:
 
         // If an NBAIO source is present, use it to read the normal capture's data
         if (mPipeSource != 0) {
-            size_t framesToRead = min(mRsmpInFramesOA - rear, mRsmpInFramesP2 / 2);
+            size_t framesToRead = fastTracksOnly ? mRsmpInFramesOA - rear
+                    : min(mRsmpInFramesOA - rear, mRsmpInFramesP2 / 2);
 
             // The audio fifo read() returns OVERRUN on overflow, and advances the read pointer
             // to the full buffer point (clearing the overflow condition).  Upon OVERRUN error,
@@ -8746,7 +8901,13 @@ reacquire_wakelock:
                         "more frames to read than fifo size, %zd > %zu",
                         availableToRead, mPipeFramesP2);
                 const size_t pipeFramesFree = mPipeFramesP2 - availableToRead;
-                const size_t sleepFrames = min(pipeFramesFree, mRsmpInFramesP2) / 2;
+                size_t sleepFrames = min(pipeFramesFree, mRsmpInFramesP2) / 2;
+                if (fastTracksOnly) {
+                    // wake up when the pipe holds a full input buffer, keeping 1/4 pipe margin
+                    const size_t targetFrames = min(mPipeFramesP2 * 3 / 4, mRsmpInFramesP2);
+                    sleepFrames = targetFrames > (size_t)availableToRead
+                            ? targetFrames - availableToRead : 0;
+                }
                 ALOGVV("mPipeFramesP2:%zu mRsmpInFramesP2:%zu sleepFrames:%zu availableToRead:%zd",
                         mPipeFramesP2, mRsmpInFramesP2, sleepFrames, availableToRead);
                 sleepUs = (sleepFrames * 1000000LL) / mSampleRate;
@@ -9192,7 +9353,7 @@ sp<IAfRecordTrack> RecordThread::createRecordTrack_l(
             // record thread has an associated fast capture
             hasFastCapture() &&
             // there are sufficient fast track slots available
-            mFastTrackAvail
+            fastTrackAvailable()
         ) {
           // check compatibility with audio effects.
           audio_utils::lock_guard _l(mutex());
@@ -9212,10 +9373,10 @@ sp<IAfRecordTrack> RecordThread::createRecordTrack_l(
       } else {
         ALOGV("%p AUDIO_INPUT_FLAG_FAST denied: frameCount=%zu mFrameCount=%zu mPipeFramesP2=%zu "
                 "format=%#x isLinear=%d mFormat=%#x channelMask=%#x sampleRate=%u mSampleRate=%u "
-                "hasFastCapture=%d tid=%d mFastTrackAvail=%d",
+                "hasFastCapture=%d tid=%d mFastTracksAvail=%u",
                 this, frameCount, mFrameCount, mPipeFramesP2,
                 format, audio_is_linear_pcm(format), mFormat, channelMask, sampleRate, mSampleRate,
-                hasFastCapture(), tid, mFastTrackAvail);
+                hasFastCapture(), tid, mFastTracksAvail);
         *flags = (audio_input_flags_t)(*flags & ~AUDIO_INPUT_FLAG_FAST);
       }
     }
@@ -9597,8 +9758,12 @@ void RecordThread::removeTrack_l(const sp<IAfRecordTrack>& track)
     mTracks.remove(track);
     // need anything related to effects here?
     if (track->isFastTrack()) {
-        ALOG_ASSERT(!mFastTrackAvail);
-        mFastTrackAvail = true;
+        ALOG_ASSERT(mFastTracksAvail < FastCaptureState::getMaxFastClients());
+        ++mFastTracksAvail;
+        if (track->isPatchTrack()) {
+            ALOG_ASSERT(!mFastPatchRecordAvail);
+            mFastPatchRecordAvail = true;
+        }
     }
 }
 
@@ -9619,7 +9784,7 @@ void RecordThread::dumpInternals_l(int fd, const Vector<String16>& /* args */)
     }
 
     dprintf(fd, "  Fast capture thread: %s\n", hasFastCapture() ? "yes" : "no");
-    dprintf(fd, "  Fast track available: %s\n", mFastTrackAvail ? "yes" : "no");
+    dprintf(fd, "  Fast tracks available: %u\n", mFastTracksAvail);
 
     // Make a non-atomic copy of fast capture dump state so it won't change underneath us
     // while we are dumping it.  It may be inconsistent, but it won't mutate!
@@ -31,10 +31,13 @@
 #include <datapath/ThreadMetrics.h>
 #include <fastpath/FastCapture.h>
 #include <fastpath/FastMixer.h>
+#include <media/AudioVolumeRamp.h>
 #include <mediautils/Synchronization.h>
 #include <mediautils/ThreadSnapshot.h>
+#include <mediautils/WorkerPool.h>
 #include <psh_utils/Token.h>
 #include <timing/MonotonicFrameCounter.h>
+#include <timing/PeriodTracer.h>
 #include <utils/Log.h>
 
 namespace android {
@@ -960,6 +963,13 @@ protected:
     virtual void threadLoop_removeTracks(const Vector<sp<IAfTrack>>& tracksToRemove)
             REQUIRES(ThreadBase_ThreadLoop);
 
+    // Runs the effect chains of the audio sessions on mEffectChainWorkers and sums their outputs
+    // into mEffectBuffer, in chain order, once all of them have completed.
+    // Also copies the haptic data of activeHapticSessionId, if one of them.
+    void processSessionEffectChains(const Vector<sp<IAfEffectChain>>& effectChains,
+            audio_session_t activeHapticSessionId)
+            REQUIRES(ThreadBase_ThreadLoop, audio_utils::EffectChain_Mutex);
+
                 // prepareTracks_l reads and writes mActiveTracks, and returns
                 // the pending set of tracks to remove via Vector 'tracksToRemove'.  The caller
                 // is responsible for clearing or destroying this Vector later on, when it
@@ -1326,6 +1336,16 @@ protected:
     // Set to "true" to enable when data has already copied to sink
     bool mHasDataCopiedToSinkBuffer GUARDED_BY(ThreadBase_ThreadLoop) = false;
 
+    // Workers processing the effect chains of different audio sessions concurrently, or null
+    // when they are processed one after the other by threadLoop() (the default).
+    // Only MIXER threads with an effect buffer use them, see "af.effect_chain_workers".
+    // Each session chain then outputs to its own buffer instead of mEffectBuffer.
+    std::unique_ptr<mediautils::WorkerPool> mEffectChainWorkers;
+
+    // Stage timestamps of the last periods of threadLoop(), for dumpsys.
+    // Written by threadLoop() only, read by dump without lock.
+    audioflinger::PeriodTracer mPeriodTracer;
+
     // Frame size aligned buffer used as input and output to all post processing effects
     // except the Spatializer in a SPATIALIZER thread. Non spatialized tracks are mixed into
     // this buffer so that post processing effects can be applied.
@@ -1567,11 +1587,12 @@ public:
     FastTrackUnderruns getFastTrackUnderruns(size_t /* fastIndex */) const override
         { return {}; }
     const std::atomic<int64_t>& framesWritten() const final { return mFramesWritten; }
+    const audioflinger::PeriodTracer& periodTracer() const final { return mPeriodTracer; }
 
 protected:
                 // accessed by both binder threads and within threadLoop(), lock on mutex needed
-     uint32_t& fastTrackAvailMask_l() final REQUIRES(mutex()) { return mFastTrackAvailMask; }
-     uint32_t mFastTrackAvailMask;  // bit i set if fast track [i] is available
+     FastTrackMask& fastTrackAvailMask_l() final REQUIRES(mutex()) { return mFastTrackAvailMask; }
+     FastTrackMask mFastTrackAvailMask;  // bit i set if fast track [i] is available
                 bool        mHwSupportsPause;
                 bool        mHwPaused;
                 bool        mFlushPending;
@@ -1812,6 +1833,10 @@ protected:
     float                   mMasterBalanceLeft = 1.f;
     float                   mMasterBalanceRight = 1.f;
 
+    // Volume applied to the PCM data when the HAL stream does not support setVolume(),
+    // set in processVolume_l() and applied in threadLoop_mix(), both on the thread loop.
+    std::unique_ptr<AudioVolumeRamp> mSoftwareVolume;
+
 public:
     virtual     bool        hasFastMixer() const { return false; }
 
@@ -2122,8 +2147,17 @@ public:
 
     MetadataUpdate updateMetadata_l() override REQUIRES(mutex());
 
-    bool fastTrackAvailable() const final { return mFastTrackAvail; }
-    void setFastTrackAvailable(bool available) final { mFastTrackAvail = available; }
+    bool fastTrackAvailable() const final { return mFastTracksAvail > 0; }
+    bool fastPatchRecordAvailable() const final {
+        return mFastTracksAvail > 0 && mFastPatchRecordAvail;
+    }
+    void acquireFastTrack(bool isPatch) final {
+        ALOG_ASSERT(isPatch ? fastPatchRecordAvailable() : fastTrackAvailable());
+        --mFastTracksAvail;
+        if (isPatch) {
+            mFastPatchRecordAvail = false;
+        }
+    }
 
     bool isTimestampCorrectionEnabled_l() const override REQUIRES(mutex()) {
                             // checks popcount for exactly one device.
@@ -2221,7 +2255,9 @@ private:
             static const size_t                 kFastCaptureLogSize = 4 * 1024;
             sp<NBLog::Writer>                   mFastCaptureNBLogWriter;
 
-            bool                                mFastTrackAvail;    // true if fast track available
+            // number of fast tracks that can be added, 0 if there is no fast capture
+            unsigned                            mFastTracksAvail;
+            bool                                mFastPatchRecordAvail;  // no fast patch record
             // common state to all record threads
             std::atomic_bool                    mBtNrecSuspended;
 
@@ -29,7 +29,9 @@
 #include "ResamplerBufferProvider.h"
 
 #include <audio_utils/StringUtils.h>
+#include <audio_utils/channels.h>
 #include <audio_utils/minifloat.h>
+#include <audio_utils/primitives.h>
 #include <com_android_media_audio.h>
 #include <com_android_media_audioserver.h>
 #include <media/AppOpsSession.h>
@@ -955,15 +957,15 @@ Track::Track(
         // race with setSyncEvent(). However, if we call it, we cannot properly start
         // static fast tracks (SoundPool) immediately after stopping.
         //mAudioTrackServerProxy->framesReadyIsCalledByMultipleThreads();
-        ALOG_ASSERT(thread->fastTrackAvailMask_l() != 0);
-        const int i = __builtin_ctz(thread->fastTrackAvailMask_l());
+        ALOG_ASSERT(thread->fastTrackAvailMask_l().any());
+        const int i = thread->fastTrackAvailMask_l().findFirst();
         ALOG_ASSERT(0 < i && i < (int)FastMixerState::sMaxFastTracks);
         // FIXME This is too eager.  We allocate a fast track index before the
         //       fast track becomes active.  Since fast tracks are a scarce resource,
         //       this means we are potentially denying other more important fast tracks from
         //       being created.  It would be better to allocate the index dynamically.
         mFastIndex = i;
-        thread->fastTrackAvailMask_l() &= ~(1 << i);
+        thread->fastTrackAvailMask_l().reset(i);
     }
 
     populateUsageAndContentTypeFromStreamType();
@@ -2998,8 +3000,7 @@ RecordTrack::RecordTrack(
     mResamplerBufferProvider = new ResamplerBufferProvider(this);
 
     if (flags & AUDIO_INPUT_FLAG_FAST) {
-        ALOG_ASSERT(thread->fastTrackAvailable());
-        thread->setFastTrackAvailable(false);
+        thread->acquireFastTrack(isPatchTrack());
     } else {
         // TODO: only Normal Record has timestamps (Fast Record does not).
         mServerLatencySupported = checkServerLatencySupported(mFormat, flags);
@@ -3530,10 +3531,23 @@ PassthruPatchRecord::PassthruPatchRecord(
         : PatchRecord(recordThread, sampleRate, channelMask, format, frameCount,
                 nullptr /*buffer*/, 0 /*bufferSize*/, flags, {} /* timeout */, source),
           mPatchRecordAudioBufferProvider(*this),
-          mSinkBuffer(allocAligned(32, mFrameCount * mFrameSize)),
+          mStreamFormat(recordThread->format()),
+          mStreamChannelCount(recordThread->channelCount()),
+          mStreamFrameSize(recordThread->frameSize()),
+          // large enough for the stream frames and any intermediate of their conversion
+          mSinkBuffer(allocAligned(32, mFrameCount * std::max(mFrameSize,
+                  audio_is_linear_pcm(mStreamFormat) && audio_is_linear_pcm(mFormat)
+                          ? std::max(mStreamChannelCount, mChannelCount)
+                                  * std::max(audio_bytes_per_sample(mStreamFormat),
+                                          audio_bytes_per_sample(mFormat))
+                          : mStreamFrameSize))),
           mStubBuffer(allocAligned(32, mFrameCount * mFrameSize))
 {
     memset(mStubBuffer.get(), 0, mFrameCount * mFrameSize);
+    ALOGW_IF((mStreamFormat != mFormat || mStreamChannelCount != mChannelCount)
+            && !(audio_is_linear_pcm(mStreamFormat) && audio_is_linear_pcm(mFormat)),
+            "%s(%d): cannot convert stream format %#x to %#x", __func__, mId,
+            mStreamFormat, mFormat);
 }
 
 sp<StreamInHalInterface> PassthruPatchRecord::obtainStream(
@@ -3563,6 +3577,7 @@ status_t PassthruPatchRecord::obtainBuffer(
         startTimeNs = systemTime();
     }
     const size_t framesToRead = std::min(buffer->mFrameCount, mFrameCount);
+    size_t framesRead = 0;
     buffer->mFrameCount = 0;
     buffer->mRaw = nullptr;
     sp<IAfThreadBase> thread;
@@ -3573,10 +3588,12 @@ status_t PassthruPatchRecord::obtainBuffer(
     size_t bytesRead = 0;
     {
         ATRACE_NAME("read");
-        result = stream->read(mSinkBuffer.get(), framesToRead * mFrameSize, &bytesRead);
+        result = stream->read(mSinkBuffer.get(), framesToRead * mStreamFrameSize, &bytesRead);
         if (result != NO_ERROR) goto stream_error;
         if (bytesRead == 0) return NO_ERROR;
     }
+    framesRead = bytesRead / mStreamFrameSize;
+    convertStreamFrames(framesRead);
 
     {
         audio_utils::lock_guard lock(readMutex());
@@ -3587,10 +3604,9 @@ status_t PassthruPatchRecord::obtainBuffer(
     // writeFrames handles wraparound and should write all the provided frames.
     // If it couldn't, there is something wrong with the client/server buffer of the software patch.
     buffer->mFrameCount = writeFrames(
-            &mPatchRecordAudioBufferProvider,
-            mSinkBuffer.get(), bytesRead / mFrameSize, mFrameSize);
-    ALOGW_IF(buffer->mFrameCount < bytesRead / mFrameSize,
-            "Lost %zu frames obtained from HAL", bytesRead / mFrameSize - buffer->mFrameCount);
+            &mPatchRecordAudioBufferProvider, mSinkBuffer.get(), framesRead, mFrameSize);
+    ALOGW_IF(buffer->mFrameCount < framesRead,
+            "Lost %zu frames obtained from HAL", framesRead - buffer->mFrameCount);
     mUnconsumedFrames = buffer->mFrameCount;
     struct timespec newTimeOut;
     if (startTimeNs) {
@@ -3613,6 +3629,32 @@ stream_error:
     return result;
 }
 
+void PassthruPatchRecord::convertStreamFrames(size_t frameCount)
+{
+    if (mStreamFormat == mFormat && mStreamChannelCount == mChannelCount) return;
+    if (!audio_is_linear_pcm(mStreamFormat) || !audio_is_linear_pcm(mFormat)) return;
+
+    // Both conversions work in place. Change the channel count at the smaller sample size,
+    // so that the intermediate frames never exceed mSinkBuffer.
+    void* const frames = mSinkBuffer.get();
+    const auto adjustChannels = [&](audio_format_t format) {
+        const size_t sampleSize = audio_bytes_per_sample(format);
+        adjust_channels(frames, mStreamChannelCount, frames, mChannelCount,
+                sampleSize, frameCount * mStreamChannelCount * sampleSize);
+    };
+    if (audio_bytes_per_sample(mStreamFormat) <= audio_bytes_per_sample(mFormat)) {
+        if (mStreamChannelCount != mChannelCount) adjustChannels(mStreamFormat);
+        if (mStreamFormat != mFormat) {
+            memcpy_by_audio_format(frames, mFormat, frames, mStreamFormat,
+                    frameCount * mChannelCount);
+        }
+    } else {
+        memcpy_by_audio_format(frames, mFormat, frames, mStreamFormat,
+                frameCount * mStreamChannelCount);
+        if (mStreamChannelCount != mChannelCount) adjustChannels(mFormat);
+    }
+}
+
 void PassthruPatchRecord::releaseBuffer(Proxy::Buffer* buffer)
 {
     if (buffer->mFrameCount <= mUnconsumedFrames) {
@@ -3633,7 +3675,7 @@ void PassthruPatchRecord::releaseBuffer(Proxy::Buffer* buffer)
 status_t PassthruPatchRecord::read(
         void* buffer, size_t bytes, size_t* read)
 {
-    bytes = std::min(bytes, mFrameCount * mFrameSize);
+    bytes = std::min(bytes, mFrameCount * mStreamFrameSize);
     {
         audio_utils::unique_lock lock(readMutex());
         mReadCV.wait(lock, [&]{ return mReadError != NO_ERROR || mReadBytes != 0; });
@@ -3644,7 +3686,7 @@ status_t PassthruPatchRecord::read(
         *read = std::min(bytes, mReadBytes);
         mReadBytes -= *read;
     }
-    mLastReadFrames = *read / mFrameSize;
+    mLastReadFrames = *read / mStreamFrameSize;
     memset(buffer, 0, *read);
     return 0;
 }
@@ -27,7 +27,7 @@
 
 #include <audio_utils/format.h>
 #include <audio_utils/sndfile.h>
-#include <media/nbaio/PipeReader.h>
+#include <media/nbaio/SharedPipeReader.h>
 
 #include "Configuration.h"
 #include "NBAIO_Tee.h"
@@ -227,7 +227,7 @@ NBAIO_Tee::NBAIO_TeeImpl::NBAIO_SinkSource NBAIO_Tee::NBAIO_TeeImpl::makeSinkSou
         const NBAIO_Format &format, size_t frames, bool *enabled)
 {
     if (Format_isValid(format) && audio_has_proportional_frames(format.mFormat)) {
-        Pipe *pipe = new Pipe(frames, format);
+        SharedPipe *pipe = new SharedPipe(frames, format);
         size_t numCounterOffers = 0;
         const NBAIO_Format offers[1] = {format};
         ssize_t index = pipe->negotiate(
@@ -236,7 +236,7 @@ NBAIO_Tee::NBAIO_TeeImpl::NBAIO_SinkSource NBAIO_Tee::NBAIO_TeeImpl::makeSinkSou
             ALOGW("pipe failure to negotiate: %zd", index);
             goto exit;
         }
-        PipeReader *pipeReader = new PipeReader(*pipe);
+        SharedPipeReader *pipeReader = new SharedPipeReader(*pipe);
         numCounterOffers = 0;
         index = pipeReader->negotiate(
                 offers, 1 /* numOffers */, nullptr /* counterOffers */, numCounterOffers);
@@ -31,7 +31,7 @@
 namespace android {
 
 /**
- * The NBAIO_Tee uses the NBAIO Pipe and PipeReader for nonblocking
+ * The NBAIO_Tee uses the NBAIO SharedPipe and SharedPipeReader for nonblocking
  * data collection, for eventual dump to log files.
  * See https://source.android.com/devices/audio/debugging for how to
  * enable by ro.debuggable and af.tee properties.
@@ -254,7 +254,8 @@ private:
 
     private:
         // TRICKY: We need to keep the NBAIO_Sink and NBAIO_Source both alive at the same time
-        // because PipeReader holds a naked reference (not a strong or weak pointer) to Pipe.
+        // because SharedPipeReader holds a naked reference (not a strong or weak pointer)
+        // to SharedPipe.
         using NBAIO_SinkSource = std::pair<sp<NBAIO_Sink>, sp<NBAIO_Source>>;
 
         static void dumpTee(int fd, const NBAIO_SinkSource& sinkSource, const std::string& suffix);
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "AudioFlinger::SessionEffectChains"
+//#define LOG_NDEBUG 0
+
+#include "SessionEffectChains.h"
+
+#include <string.h>
+
+namespace android::afutils {
+
+void processSessionEffectChains(mediautils::WorkerPool& workers, size_t numChains,
+        const std::function<void(size_t)>& processChain,
+        const std::function<float*(size_t)>& outBuffer,
+        const float* hapticInBuffer, float* effectBuffer,
+        size_t frameCount, size_t channelCount, size_t hapticChannelCount) {
+    const size_t sampleCount = frameCount * channelCount;
+    const size_t outputSize = sampleCount + frameCount * hapticChannelCount;
+    for (size_t i = 0; i < numChains; i++) {
+        memset(outBuffer(i), 0, outputSize * sizeof(float));
+    }
+
+    workers.run(numChains, processChain);
+
+    for (size_t i = 0; i < numChains; i++) {
+        const float* const chainBuffer = outBuffer(i);
+        for (size_t j = 0; j < sampleCount; j++) {
+            effectBuffer[j] += chainBuffer[j];
+        }
+    }
+
+    if (hapticInBuffer != nullptr && hapticChannelCount > 0) {
+        memcpy(effectBuffer + sampleCount, hapticInBuffer + sampleCount,
+                frameCount * hapticChannelCount * sizeof(float));
+    }
+}
+
+}  // namespace android::afutils
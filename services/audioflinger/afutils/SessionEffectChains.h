@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+
+#include <mediautils/WorkerPool.h>
+
+namespace android::afutils {
+
+// Processes the effect chains of numChains audio sessions of a MixerThread concurrently on
+// workers, calling processChain(i) for chain i.
+//
+// Processed one after the other, the last effect of every session chain accumulates into the
+// effect buffer of the thread. Here chain i accumulates into its own buffer, outBuffer(i),
+// which is cleared before the chains run. Once all of them are done, the outputs are added to
+// effectBuffer in chain order, the order of the additions when processed serially.
+//
+// Buffers hold frameCount frames of channelCount channels, followed by frameCount frames of
+// hapticChannelCount channels. Haptic channels are not mixed: if hapticInBuffer is the input
+// buffer of one of the chains, its haptic channels are copied to effectBuffer, as threadLoop()
+// does for a chain processed serially.
+void processSessionEffectChains(mediautils::WorkerPool& workers, size_t numChains,
+        const std::function<void(size_t)>& processChain,
+        const std::function<float*(size_t)>& outBuffer,
+        const float* hapticInBuffer, float* effectBuffer,
+        size_t frameCount, size_t channelCount, size_t hapticChannelCount);
+
+}  // namespace android::afutils
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <chrono>
+#include <vector>
+
+#include <afutils/SessionEffectChains.h>
+#include <benchmark/benchmark.h>
+
+using namespace android::afutils;
+using android::mediautils::WorkerPool;
+using namespace std::chrono_literals;
+
+/*
+ * Period overruns of a MixerThread processing N session effect chains, one after the
+ * other (0 workers) or concurrently on "af.effect_chain_workers" workers.
+ *
+ * Each synthetic chain takes a quarter of a 256 frame period at 48 kHz; the global chains
+ * (output stage) take a sixteenth after the session chains. The "overruns" counter is the
+ * fraction of periods longer than 5333 us, which depends on the load and number of cores.
+ */
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kFrameCount = 256;
+constexpr size_t kChannelCount = 2;
+constexpr auto kPeriod = 5333us;
+constexpr auto kChainDuration = 1333us;
+
+void busyWait(Clock::duration duration) {
+    const auto end = Clock::now() + duration;
+    while (Clock::now() < end) {}
+}
+
+}  // namespace
+
+static void BM_EffectChainPeriod(benchmark::State& state) {
+    const size_t numChains = state.range(0);
+    WorkerPool workers(state.range(1), "EffectChainBM");
+    std::vector<std::vector<float>> outBuffers(numChains, std::vector<float>(
+            kFrameCount * kChannelCount));
+    std::vector<float> effectBuffer(kFrameCount * kChannelCount);
+
+    int64_t overruns = 0;
+    for (auto _ : state) {
+        const auto start = Clock::now();
+        processSessionEffectChains(workers, numChains,
+                [](size_t) { busyWait(kChainDuration); },
+                [&outBuffers](size_t i) { return outBuffers[i].data(); },
+                nullptr /* hapticInBuffer */, effectBuffer.data(),
+                kFrameCount, kChannelCount, 0 /* hapticChannelCount */);
+        busyWait(kChainDuration / 4);  // output stage
+        if (Clock::now() - start > kPeriod) {
+            ++overruns;
+        }
+    }
+    state.counters["overruns"] = benchmark::Counter(
+            overruns, benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_EffectChainPeriod)
+        ->ArgNames({"chains", "workers"})
+        ->ArgsProduct({{2, 4, 6}, {0, 1, 3}})
+        ->Iterations(100)
+        ->UseRealTime();
+
+BENCHMARK_MAIN();
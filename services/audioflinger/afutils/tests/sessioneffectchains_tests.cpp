@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "sessioneffectchains_tests"
+
+#include <afutils/SessionEffectChains.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace android::afutils;
+using android::mediautils::WorkerPool;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr size_t kFrameCount = 192;
+constexpr size_t kChannelCount = 2;
+constexpr size_t kHapticChannelCount = 1;
+constexpr size_t kAudioSamples = kFrameCount * kChannelCount;
+constexpr size_t kSamples = kAudioSamples + kFrameCount * kHapticChannelCount;
+
+// Session effect chains whose last effect accumulates a gain and a saturation of their input.
+class FakeChains {
+  public:
+    FakeChains(size_t numChains, std::mt19937* rng)
+        : mInBuffers(numChains, std::vector<float>(kSamples)),
+          mOutBuffers(numChains, std::vector<float>(kSamples)) {
+        std::uniform_real_distribution<float> dist(-1.f, 1.f);
+        for (auto& buffer : mInBuffers) {
+            for (float& sample : buffer) {
+                sample = dist(*rng);
+            }
+        }
+        // left over from the previous period
+        for (auto& buffer : mOutBuffers) {
+            for (float& sample : buffer) {
+                sample = dist(*rng);
+            }
+        }
+    }
+
+    size_t size() const { return mInBuffers.size(); }
+    const float* inBuffer(size_t i) const { return mInBuffers[i].data(); }
+    float* outBuffer(size_t i) { return mOutBuffers[i].data(); }
+
+    // Like the effects, only processes the audio channels.
+    void process(size_t i, float* outBuffer) const {
+        const float gain = 0.3f + 0.1f * i;
+        for (size_t j = 0; j < kAudioSamples; ++j) {
+            outBuffer[j] += std::tanh(gain * mInBuffers[i][j]);
+        }
+    }
+
+  private:
+    std::vector<std::vector<float>> mInBuffers;
+    std::vector<std::vector<float>> mOutBuffers;
+};
+
+std::vector<float> makeEffectBuffer(std::mt19937* rng) {
+    // the mix of the tracks without effects
+    std::uniform_real_distribution<float> dist(-1.f, 1.f);
+    std::vector<float> buffer(kSamples);
+    for (float& sample : buffer) {
+        sample = dist(*rng);
+    }
+    return buffer;
+}
+
+// What threadLoop() computes when processing the chains one after the other: each one
+// accumulates into the effect buffer, and the haptic channels of hapticChain are copied
+// from its input.
+std::vector<float> processSerially(const FakeChains& chains, std::vector<float> effectBuffer,
+        size_t hapticChain) {
+    for (size_t i = 0; i < chains.size(); ++i) {
+        chains.process(i, effectBuffer.data());
+        if (i == hapticChain) {
+            std::copy(chains.inBuffer(i) + kAudioSamples, chains.inBuffer(i) + kSamples,
+                    effectBuffer.begin() + kAudioSamples);
+        }
+    }
+    return effectBuffer;
+}
+
+// Chain slowChain, if any, first sleeps for slowChainDelay.
+std::vector<float> processConcurrently(WorkerPool& workers, FakeChains& chains,
+        std::vector<float> effectBuffer, size_t hapticChain,
+        size_t slowChain = SIZE_MAX, std::chrono::microseconds slowChainDelay = 0us) {
+    processSessionEffectChains(workers, chains.size(),
+            [&chains, slowChain, slowChainDelay](size_t i) {
+                if (i == slowChain) {
+                    std::this_thread::sleep_for(slowChainDelay);
+                }
+                chains.process(i, chains.outBuffer(i));
+            },
+            [&chains](size_t i) { return chains.outBuffer(i); },
+            hapticChain < chains.size() ? chains.inBuffer(hapticChain) : nullptr,
+            effectBuffer.data(), kFrameCount, kChannelCount, kHapticChannelCount);
+    return effectBuffer;
+}
+
+}  // namespace
+
+// The chains output to their own buffers, and summing them in chain order gives the same
+// effect buffer, bit for bit, as the chains accumulating into it one after the other.
+TEST(SessionEffectChainsTests, matchesSerialProcessing) {
+    std::mt19937 rng(42);
+    for (size_t numWorkers : { 0, 1, 3 }) {
+        WorkerPool workers(numWorkers, "SessionFxTest");
+        for (size_t numChains : { 1, 2, 5, 8 }) {
+            SCOPED_TRACE(testing::Message() << numChains << " chains, "
+                    << numWorkers << " workers");
+            FakeChains chains(numChains, &rng);
+            const std::vector<float> effectBuffer = makeEffectBuffer(&rng);
+            const size_t hapticChain = numChains - 1;
+            const std::vector<float> expected =
+                    processSerially(chains, effectBuffer, hapticChain);
+            EXPECT_EQ(expected, processConcurrently(workers, chains, effectBuffer, hapticChain));
+        }
+    }
+}
+
+// The haptic channels of the haptic session are copied, not mixed, and are left alone
+// without one.
+TEST(SessionEffectChainsTests, copiesHapticChannels) {
+    std::mt19937 rng(7);
+    WorkerPool workers(3, "SessionFxTest");
+    FakeChains chains(4, &rng);
+    const std::vector<float> effectBuffer = makeEffectBuffer(&rng);
+
+    std::vector<float> output = processConcurrently(workers, chains, effectBuffer, 2);
+    EXPECT_EQ(std::vector<float>(chains.inBuffer(2) + kAudioSamples, chains.inBuffer(2) + kSamples),
+            std::vector<float>(output.begin() + kAudioSamples, output.end()));
+
+    output = processConcurrently(workers, chains, effectBuffer, chains.size() /* none */);
+    EXPECT_EQ(std::vector<float>(effectBuffer.begin() + kAudioSamples, effectBuffer.end()),
+            std::vector<float>(output.begin() + kAudioSamples, output.end()));
+}
+
+// A session chain slower than the period, e.g. a heavy insert effect, in one period out of
+// three. The other chains finish first, yet the output still matches serial processing, and
+// each of these periods is counted as an overrun: the join waits for the slow chain.
+// Sleeping makes the slow periods overrun however loaded the device is; the others may
+// overrun too, so they are not checked.
+TEST(SessionEffectChainsTests, countsOverrunsOfSlowChain) {
+    constexpr auto kPeriod = 5333us;  // 256 frames at 48 kHz
+    constexpr size_t kPeriods = 12;
+    constexpr size_t kSlowChain = 1;
+    std::mt19937 rng(3);
+    WorkerPool workers(3, "SessionFxTest");
+
+    size_t overruns = 0;
+    size_t slowPeriodOverruns = 0;
+    for (size_t period = 0; period < kPeriods; ++period) {
+        SCOPED_TRACE(testing::Message() << "period " << period);
+        const bool slow = period % 3 == 0;
+        FakeChains chains(4, &rng);
+        const std::vector<float> effectBuffer = makeEffectBuffer(&rng);
+        const std::vector<float> expected = processSerially(chains, effectBuffer, kSlowChain);
+
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<float> output = processConcurrently(workers, chains, effectBuffer,
+                kSlowChain, slow ? kSlowChain : SIZE_MAX, 2 * kPeriod);
+        const bool overrun = std::chrono::steady_clock::now() - start > kPeriod;
+        overruns += overrun;
+        slowPeriodOverruns += slow && overrun;
+
+        EXPECT_EQ(expected, output);
+    }
+    EXPECT_EQ(kPeriods / 3, slowPeriodOverruns);
+    EXPECT_GE(overruns, kPeriods / 3);
+    ::testing::Test::RecordProperty("overruns", (int)overruns);
+}
@@ -20,6 +20,8 @@
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
 #include "Configuration.h"
+#include <algorithm>
+#include <iterator>
 #include <audio_utils/format.h>
 #include <linux/futex.h>
 #include <sys/syscall.h>
@@ -146,6 +148,22 @@ void FastCapture::onStateChange()
         mReadBufferState = -1;
         dumpState->mFrameCount = frameCount;
     }
+
+    // Align the position of new fast clients with the pipe, as they share its buffer.
+    // The client resynchronizes its front to the rear on the next obtainBuffer().
+    unsigned fastClients = 0;
+    for (audio_track_cblk_t* cblk : current->mCblk) {
+        if (cblk == nullptr) {
+            continue;
+        }
+        ++fastClients;
+        if (mPipeSink != nullptr && std::find(std::begin(previous->mCblk),
+                std::end(previous->mCblk), cblk) == std::end(previous->mCblk)) {
+            android_atomic_release_store((int32_t) mPipeSink->framesWritten(),
+                    &cblk->u.mStreaming.mRear);
+        }
+    }
+    dumpState->mFastClients = fastClients;
     dumpState->mSilenced = current->mSilenceCapture;
 }
 
@@ -204,25 +222,28 @@ void FastCapture::onWork()
                 memset(mReadBuffer, 0, mReadBufferState * Format_frameSize(mFormat));
             }
             const ssize_t framesWritten = mPipeSink->write(mReadBuffer, mReadBufferState);
-            audio_track_cblk_t* cblk = current->mCblk;
             if (fastPatchRecordBufferProvider != nullptr) {
-                // This indicates the fast track is a patch record, update the cblk by
+                // This indicates a fast track is a patch record, update the cblk by
                 // calling releaseBuffer().
                 memcpy_by_audio_format(patchBuffer.raw, current->mFastPatchRecordFormat,
                         mReadBuffer, mFormat.mFormat, framesWritten * mFormat.mChannelCount);
                 patchBuffer.frameCount = framesWritten;
                 fastPatchRecordBufferProvider->releaseBuffer(&patchBuffer);
-            } else if (cblk != nullptr && framesWritten > 0) {
-                // FIXME This supports at most one fast capture client.
-                //       To handle multiple clients this could be converted to an array,
-                //       or with a lot more work the control block could be shared by all clients.
-                const int32_t rear = cblk->u.mStreaming.mRear;
-                android_atomic_release_store(framesWritten + rear, &cblk->u.mStreaming.mRear);
-                cblk->mServer += framesWritten;
-                const int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
-                if (!(old & CBLK_FUTEX_WAKE)) {
-                    // client is never in server process, so don't use FUTEX_WAKE_PRIVATE
-                    (void) syscall(__NR_futex, &cblk->mFutex, FUTEX_WAKE, 1);
+            }
+            if (framesWritten > 0) {
+                // The other fast clients read the new frames directly from the pipe buffer.
+                for (audio_track_cblk_t* cblk : current->mCblk) {
+                    if (cblk == nullptr) {
+                        continue;
+                    }
+                    const int32_t rear = cblk->u.mStreaming.mRear;
+                    android_atomic_release_store(framesWritten + rear, &cblk->u.mStreaming.mRear);
+                    cblk->mServer += framesWritten;
+                    const int32_t old = android_atomic_or(CBLK_FUTEX_WAKE, &cblk->mFutex);
+                    if (!(old & CBLK_FUTEX_WAKE)) {
+                        // client is never in server process, so don't use FUTEX_WAKE_PRIVATE
+                        (void) syscall(__NR_futex, &cblk->mFutex, FUTEX_WAKE, 1);
+                    }
                 }
             }
         }
@@ -32,6 +32,7 @@ struct FastCaptureDumpState : FastThreadDumpState {
     uint32_t mReadErrors = 0;    // total number of read() errors
     uint32_t mSampleRate = 0;
     size_t   mFrameCount = 0;
+    uint32_t mFastClients = 0;  // number of fast clients reading from the pipe
     bool     mSilenced = false; // capture is silenced
 };
 
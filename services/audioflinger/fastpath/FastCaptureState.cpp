@@ -14,10 +14,33 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "FastCaptureState"
+//#define LOG_NDEBUG 0
+
+#include <stdlib.h>
+
+#include <cutils/properties.h>
+#include <utils/Log.h>
 #include "FastCaptureState.h"
 
 namespace android {
 
+// static
+unsigned FastCaptureState::getMaxFastClients()
+{
+    const int ok = pthread_once(&sMaxFastClientsOnce, sMaxFastClientsInit);
+    if (ok != 0) {
+        ALOGE("%s pthread_once failed: %d", __func__, ok);
+    }
+    return sMaxFastClients;
+}
+
+// static
+unsigned FastCaptureState::sMaxFastClients = kDefaultFastClients;
+
+// static
+pthread_once_t FastCaptureState::sMaxFastClientsOnce = PTHREAD_ONCE_INIT;
+
 // static
 const char *FastCaptureState::commandToString(Command command)
 {
@@ -33,4 +56,19 @@ const char *FastCaptureState::commandToString(Command command)
     LOG_ALWAYS_FATAL("%s: command %d invalid", __func__, (int) command);
 }
 
+// static
+void FastCaptureState::sMaxFastClientsInit()
+{
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("ro.audio.max_fast_capture_clients", value,
+            nullptr /* default_value */) > 0) {
+        char *endptr;
+        const auto ul = strtoul(value, &endptr, 0);
+        if (*endptr == '\0' && 1 <= ul && ul <= kMaxFastClients) {
+            sMaxFastClients = (unsigned) ul;
+        }
+    }
+    ALOGI("sMaxFastClients = %u", sMaxFastClients);
+}
+
 }  // namespace android
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <pthread.h>
 #include <type_traits>
 #include <media/nbaio/NBAIO.h>
 #include <media/AudioBufferProvider.h>
@@ -34,7 +35,18 @@ struct FastCaptureState : FastThreadState {
                                             // write to this pipe sink
     int             mPipeSinkGen = 0;       // increment when mPipeSink is assigned
     size_t          mFrameCount = 0;        // number of frames per fast capture buffer
-    audio_track_cblk_t* mCblk;          // control block for the single fast client, or NULL
+
+    // These are the maximum and default values for the maximum number of fast clients
+    static constexpr unsigned kMaxFastClients = 8;
+    static constexpr unsigned kDefaultFastClients = 1;
+
+    static unsigned sMaxFastClients;            // Configured maximum number of fast clients
+    static pthread_once_t sMaxFastClientsOnce;  // Protects initializer for sMaxFastClients
+
+    // Control blocks of the fast clients, which share the pipe buffer and are delivered
+    // each period directly after the pipe write. Only the first sMaxFastClients entries
+    // are used, unused entries are NULL.
+    audio_track_cblk_t* mCblk[kMaxFastClients] = {};
 
     audio_format_t  mFastPatchRecordFormat = AUDIO_FORMAT_INVALID;
     AudioBufferProvider* mFastPatchRecordBufferProvider = nullptr;   // a reference to a patch
@@ -51,6 +63,12 @@ struct FastCaptureState : FastThreadState {
 
     // never returns NULL; asserts if command is invalid
     static const char *commandToString(Command command);
+
+    // initialize sMaxFastClients
+    static void sMaxFastClientsInit();
+
+    // initializes sMaxFastClients if needed, and returns it
+    static unsigned getMaxFastClients();
 };  // struct FastCaptureState
 
 // No virtuals.
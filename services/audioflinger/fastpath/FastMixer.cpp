@@ -61,7 +61,7 @@ static audio_channel_mask_t getChannelMaskFromCount(size_t count) {
 FastMixer::FastMixer(audio_io_handle_t parentIoHandle)
     : FastThread("cycle_ms", "load_us"),
     // mFastTrackNames
-    // mGenerations
+    mGenerations(FastMixerState::getMaxFastTracks()),
     // timestamp
     mThreadIoHandle(parentIoHandle)
 {
@@ -204,7 +204,7 @@ void FastMixer::onStateChange()
 
     // handle state change here, but since we want to diff the state,
     // we're prepared for previous == &sInitial the first time through
-    unsigned previousTrackMask;
+    FastTrackMask previousTrackMask;
 
     // check for change in output HAL configuration
     const NBAIO_Format previousFormat = mFormat;
@@ -278,7 +278,7 @@ void FastMixer::onStateChange()
         }
         mMixerBufferState = UNDEFINED;
         // we need to reconfigure all active tracks
-        previousTrackMask = 0;
+        previousTrackMask = FastTrackMask();
         mFastTracksGen = current->mFastTracksGen - 1;
         dumpState->mFrameCount = frameCount;
 #ifdef TEE_SINK
@@ -290,34 +290,31 @@ void FastMixer::onStateChange()
     }
 
     // check for change in active track set
-    const unsigned currentTrackMask = current->mTrackMask;
+    const FastTrackMask& currentTrackMask = current->mTrackMask;
     dumpState->mTrackMask = currentTrackMask;
-    dumpState->mNumTracks = popcount(currentTrackMask);
+    dumpState->mNumTracks = currentTrackMask.count();
     if (current->mFastTracksGen != mFastTracksGen) {
 
         // process removed tracks first to avoid running out of track names
-        unsigned removedTracks = previousTrackMask & ~currentTrackMask;
-        while (removedTracks != 0) {
-            const int i = __builtin_ctz(removedTracks);
-            removedTracks &= ~(1 << i);
+        const FastTrackMask removedTracks = previousTrackMask & ~currentTrackMask;
+        for (unsigned i = removedTracks.findFirst(); i < FastTrackMask::kBits;
+                i = removedTracks.findFirst(i + 1)) {
             updateMixerTrack(i, REASON_REMOVE);
             // don't reset track dump state, since other side is ignoring it
         }
 
         // now process added tracks
-        unsigned addedTracks = currentTrackMask & ~previousTrackMask;
-        while (addedTracks != 0) {
-            const int i = __builtin_ctz(addedTracks);
-            addedTracks &= ~(1 << i);
+        const FastTrackMask addedTracks = currentTrackMask & ~previousTrackMask;
+        for (unsigned i = addedTracks.findFirst(); i < FastTrackMask::kBits;
+                i = addedTracks.findFirst(i + 1)) {
             updateMixerTrack(i, REASON_ADD);
         }
 
         // finally process (potentially) modified tracks; these use the same slot
         // but may have a different buffer provider or volume provider
-        unsigned modifiedTracks = currentTrackMask & previousTrackMask;
-        while (modifiedTracks != 0) {
-            const int i = __builtin_ctz(modifiedTracks);
-            modifiedTracks &= ~(1 << i);
+        const FastTrackMask modifiedTracks = currentTrackMask & previousTrackMask;
+        for (unsigned i = modifiedTracks.findFirst(); i < FastTrackMask::kBits;
+                i = modifiedTracks.findFirst(i + 1)) {
             updateMixerTrack(i, REASON_MODIFY);
         }
 
@@ -331,6 +328,7 @@ void FastMixer::onWork()
     // Or: pass both of these into a single call with a boolean
     const FastMixerState * const current = (const FastMixerState *) mCurrent;
     FastMixerDumpState * const dumpState = (FastMixerDumpState *) mDumpState;
+    mPeriodTracer.beginPeriod();
 
     if (mIsWarm) {
         // Logging timestamps for FastMixer is currently disabled to make memory room for logging
@@ -359,10 +357,9 @@ void FastMixer::onWork()
         bool anyEnabledTracks = false;
 
         // for each track, update volume and check for underrun
-        unsigned currentTrackMask = current->mTrackMask;
-        while (currentTrackMask != 0) {
-            const int i = __builtin_ctz(currentTrackMask);
-            currentTrackMask &= ~(1 << i);
+        const FastTrackMask& currentTrackMask = current->mTrackMask;
+        for (unsigned i = currentTrackMask.findFirst(); i < FastTrackMask::kBits;
+                i = currentTrackMask.findFirst(i + 1)) {
             const FastTrack* fastTrack = &current->mFastTracks[i];
 
             const int64_t trackFramesWrittenButNotPresented =
@@ -427,7 +424,9 @@ void FastMixer::onWork()
 
         if (anyEnabledTracks) {
             // process() is CPU-bound
+            mPeriodTracer.beginStage(audioflinger::PeriodTracer::STAGE_MIX);
             mMixer->process();
+            mPeriodTracer.endStage(audioflinger::PeriodTracer::STAGE_MIX);
             mMixerBufferState = MIXED;
         } else if (mMixerBufferState != ZEROED) {
             mMixerBufferState = UNDEFINED;
@@ -475,7 +474,9 @@ void FastMixer::onWork()
         //       but this code should be modified to handle both non-blocking and blocking sinks
         dumpState->mWriteSequence++;
         ATRACE_BEGIN("write");
+        mPeriodTracer.beginStage(audioflinger::PeriodTracer::STAGE_WRITE);
         const ssize_t framesWritten = mOutputSink->write(buffer, frameCount);
+        mPeriodTracer.endStage(audioflinger::PeriodTracer::STAGE_WRITE);
         ATRACE_END();
         dumpState->mWriteSequence++;
         if (framesWritten >= 0) {
@@ -536,6 +537,7 @@ void FastMixer::onWork()
             }
         }
     }
+    mPeriodTracer.endPeriod(current->mTrackMask.count());
 }
 
 }   // namespace android
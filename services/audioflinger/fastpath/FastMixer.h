@@ -17,12 +17,14 @@
 #pragma once
 
 #include <atomic>
+#include <vector>
 #include <audio_utils/Balance.h>
 #include "FastThread.h"
 #include "StateQueue.h"
 #include "FastMixerState.h"
 #include "FastMixerDumpState.h"
 #include <afutils/NBAIO_Tee.h>
+#include <timing/PeriodTracer.h>
 
 namespace android {
 
@@ -45,6 +47,8 @@ public:
     virtual void setBoottimeOffset(int64_t boottimeOffset) {
         mBoottimeOffset.store(boottimeOffset); /* memory_order_seq_cst */
     }
+    // Stage timestamps of the last cycles, may be read while the fast mixer runs.
+    const audioflinger::PeriodTracer& periodTracer() const { return mPeriodTracer; }
 private:
             FastMixerStateQueue mSQ;
 
@@ -69,8 +73,8 @@ private:
     static const FastMixerState sInitial;
 
     FastMixerState  mPreIdle;   // copy of state before we went into idle
-    int             mGenerations[FastMixerState::kMaxFastTracks]{};
-                                // last observed mFastTracks[i].mGeneration
+    std::vector<int> mGenerations;  // last observed mFastTracks[i].mGeneration,
+                                    // FastMixerState::sMaxFastTracks entries
     NBAIO_Sink*     mOutputSink = nullptr;
     int             mOutputSinkGen = 0;
     AudioMixer*     mMixer = nullptr;
@@ -106,6 +110,8 @@ private:
     std::atomic<float> mMasterBalance{};
     std::atomic_int_fast64_t mBoottimeOffset{};
 
+    audioflinger::PeriodTracer mPeriodTracer;
+
     // parent thread id for debugging purposes
     [[maybe_unused]] const audio_io_handle_t mThreadIoHandle;
 #ifdef TEE_SINK
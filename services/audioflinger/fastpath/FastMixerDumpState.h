@@ -72,7 +72,7 @@ struct FastMixerDumpState : FastThreadDumpState {
     uint32_t mWriteErrors = 0;    // total number of write() errors
     uint32_t mSampleRate = 0;
     size_t   mFrameCount = 0;
-    uint32_t mTrackMask = 0;      // mask of active tracks
+    FastTrackMask mTrackMask;     // mask of active tracks
     FastTrackDump   mTracks[FastMixerState::kMaxFastTracks];
 
     // For timestamp statistics.
@@ -17,17 +17,39 @@
 #define LOG_TAG "FastMixerState"
 //#define LOG_NDEBUG 0
 
+#include <stdio.h>
+
 #include <cutils/properties.h>
 #include "FastMixerState.h"
 
 namespace android {
 
-FastMixerState::FastMixerState() : FastThreadState()
+std::string FastTrackMask::toString() const
+{
+    std::string result = "0x";
+    bool leading = true;
+    for (unsigned w = kWords; w-- > 0; ) {
+        if (leading && mWords[w] == 0 && w > 0) continue;
+        char word[17];
+        snprintf(word, sizeof(word), leading ? "%llx" : "%016llx", (unsigned long long)mWords[w]);
+        result.append(word);
+        leading = false;
+    }
+    return result;
+}
+
+FastMixerState::FastMixerState() : FastThreadState(), mFastTracks(getMaxFastTracks())
+{
+}
+
+// static
+unsigned FastMixerState::getMaxFastTracks()
 {
     const int ok = pthread_once(&sMaxFastTracksOnce, sMaxFastTracksInit);
     if (ok != 0) {
         ALOGE("%s pthread_once failed: %d", __func__, ok);
     }
+    return sMaxFastTracks;
 }
 
 // static
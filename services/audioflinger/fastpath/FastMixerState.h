@@ -17,6 +17,9 @@
 #pragma once
 
 #include <math.h>
+#include <algorithm>
+#include <memory>
+#include <string>
 #include <type_traits>
 
 #include <audio_utils/minifloat.h>
@@ -62,23 +65,110 @@ struct FastTrack {
 // No virtuals.
 static_assert(!std::is_polymorphic_v<FastTrack>);
 
+// Set of fast track indices, as a fixed size bit mask.
+// Iterating over the set costs one word per 64 indices plus one step per member.
+class FastTrackMask {
+public:
+    static constexpr unsigned kBits = 256;
+
+    constexpr FastTrackMask() = default;
+    // Mask of indices 0 to 63 from their bits.
+    constexpr explicit FastTrackMask(uint64_t bits) : mWords{bits} {}
+
+    bool test(unsigned i) const { return (mWords[i / 64] >> (i % 64)) & 1; }
+    void set(unsigned i) { mWords[i / 64] |= uint64_t(1) << (i % 64); }
+    void reset(unsigned i) { mWords[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+    unsigned count() const {
+        unsigned count = 0;
+        for (const uint64_t word : mWords) count += __builtin_popcountll(word);
+        return count;
+    }
+    bool any() const {
+        return std::any_of(std::begin(mWords), std::end(mWords), [](uint64_t w) { return w; });
+    }
+    bool none() const { return !any(); }
+
+    // Returns the lowest index of the set which is >= from, or kBits if there is none.
+    unsigned findFirst(unsigned from = 0) const {
+        for (unsigned w = from / 64; w < kWords; ++w) {
+            uint64_t word = mWords[w];
+            if (w == from / 64) word &= ~uint64_t(0) << (from % 64);
+            if (word != 0) return w * 64 + __builtin_ctzll(word);
+        }
+        return kBits;
+    }
+
+    FastTrackMask operator&(const FastTrackMask& other) const {
+        FastTrackMask result;
+        for (unsigned w = 0; w < kWords; ++w) result.mWords[w] = mWords[w] & other.mWords[w];
+        return result;
+    }
+    FastTrackMask operator~() const {
+        FastTrackMask result;
+        for (unsigned w = 0; w < kWords; ++w) result.mWords[w] = ~mWords[w];
+        return result;
+    }
+    bool operator==(const FastTrackMask& other) const {
+        return std::equal(std::begin(mWords), std::end(mWords), std::begin(other.mWords));
+    }
+    bool operator!=(const FastTrackMask& other) const { return !(*this == other); }
+
+    // Hexadecimal, as an integer of kBits bits.
+    std::string toString() const;
+
+private:
+    static constexpr unsigned kWords = kBits / 64;
+    uint64_t mWords[kWords]{};
+};
+
+// The fast tracks of a FastMixerState, a fixed capacity array allocated when constructed.
+// Assignment between arrays of the same capacity copies in place, so states can be copied
+// on the fast mixer thread (see FastMixer::onIdle()) without allocating.
+class FastTrackArray {
+public:
+    explicit FastTrackArray(unsigned capacity)
+        : mCapacity(capacity), mTracks(std::make_unique<FastTrack[]>(capacity)) {}
+    FastTrackArray(const FastTrackArray& other) : FastTrackArray(other.mCapacity) {
+        std::copy_n(other.mTracks.get(), mCapacity, mTracks.get());
+    }
+    FastTrackArray& operator=(const FastTrackArray& other) {
+        if (this != &other) {
+            if (mCapacity != other.mCapacity) {
+                mCapacity = other.mCapacity;
+                mTracks = std::make_unique<FastTrack[]>(mCapacity);
+            }
+            std::copy_n(other.mTracks.get(), mCapacity, mTracks.get());
+        }
+        return *this;
+    }
+
+    unsigned capacity() const { return mCapacity; }
+    FastTrack& operator[](unsigned i) { return mTracks[i]; }
+    const FastTrack& operator[](unsigned i) const { return mTracks[i]; }
+
+private:
+    unsigned mCapacity;
+    std::unique_ptr<FastTrack[]> mTracks;
+};
+
 // Represents a single state of the fast mixer
 struct FastMixerState : FastThreadState {
     FastMixerState();
 
     // These are the minimum, maximum, and default values for maximum number of fast tracks
     static constexpr unsigned kMinFastTracks = 2;
-    static constexpr unsigned kMaxFastTracks = 32;
+    static constexpr unsigned kMaxFastTracks = FastTrackMask::kBits;
     static constexpr unsigned kDefaultFastTracks = 8;
 
     static unsigned sMaxFastTracks;             // Configured maximum number of fast tracks
     static pthread_once_t sMaxFastTracksOnce;   // Protects initializer for sMaxFastTracks
 
     // all pointer fields use raw pointers; objects are owned and ref-counted by the normal mixer
-    FastTrack   mFastTracks[kMaxFastTracks];
+    FastTrackArray mFastTracks;     // sMaxFastTracks entries
     int         mFastTracksGen = 0; // increment when any
                                     // mFastTracks[i].mGeneration is incremented
-    unsigned    mTrackMask = 0;     // bit i is set if and only if mFastTracks[i] is active
+    FastTrackMask mTrackMask;       // bit i is set if and only if mFastTracks[i] is active
     NBAIO_Sink* mOutputSink = nullptr; // HAL output device, must already be negotiated
     int         mOutputSinkGen = 0; // increment when mOutputSink is assigned
     size_t      mFrameCount = 0;    // number of frames per fast mix buffer
@@ -99,6 +189,9 @@ struct FastMixerState : FastThreadState {
     // initialize sMaxFastTracks
     static void sMaxFastTracksInit();
 
+    // initializes sMaxFastTracks if needed, and returns it
+    static unsigned getMaxFastTracks();
+
 };  // struct FastMixerState
 
 // No virtuals.
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "FastCapture_loopback_tests"
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fastpath/FastCapture.h>
+#include <gtest/gtest.h>
+#include <media/nbaio/Pipe.h>
+#include <media/nbaio/PipeReader.h>
+#include <private/media/AudioTrackShared.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+/*
+ * Runs FastCapture on a paced source whose samples are their own frame index, and
+ * measures the capture latency of each path, from the end of the source read to:
+ *  - direct: a fast client reading the pipe buffer through its AudioRecordClientProxy,
+ *    as delivered by FastCapture.
+ *  - normal: the RecordThread read from the pipe, with the RecordThread wait policy.
+ *    The normal clients are notified later still, after the conversion into their buffer.
+ */
+
+namespace {
+
+constexpr unsigned kSampleRate = 48000;
+constexpr size_t kFrameCount = 96;          // 2 ms capture period
+constexpr size_t kPipeFrames = 4096;        // as RecordThread, roundup(4 * 20 ms)
+constexpr size_t kRsmpInFrames = 2048;      // RecordThread input buffer
+constexpr size_t kPeriods = 4096;           // capture times kept by PacedSource
+constexpr int64_t kRunNs = 1000 * 1000000LL;
+
+const NBAIO_Format kFormat = Format_from_SR_C(kSampleRate, 1, AUDIO_FORMAT_PCM_FLOAT);
+
+// A source which returns one period at the sample rate, like a HAL input.
+class PacedSource : public NBAIO_Source {
+public:
+    PacedSource() : NBAIO_Source(kFormat) {
+        mNegotiated = true;
+    }
+
+    ssize_t read(void* buffer, size_t count) override {
+        if (mNextNs == 0) {
+            mNextNs = systemTime();
+        }
+        mNextNs += (int64_t) count * 1000000000LL / kSampleRate;
+        const struct timespec ts = {(time_t) (mNextNs / 1000000000LL),
+                (long) (mNextNs % 1000000000LL)};
+        (void) clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr);
+
+        float* frames = static_cast<float*>(buffer);
+        for (size_t i = 0; i < count; ++i) {
+            frames[i] = (float) (mFramesRead + i);
+        }
+        mCaptureNs[(mFramesRead / kFrameCount) % kPeriods].store(
+                systemTime(), std::memory_order_relaxed);
+        mFramesRead += count;
+        return count;
+    }
+
+    // Returns the time the period of frame was read.
+    int64_t captureNs(int64_t frame) const {
+        return mCaptureNs[(frame / kFrameCount) % kPeriods].load(std::memory_order_relaxed);
+    }
+
+private:
+    int64_t mNextNs = 0;
+    std::atomic<int64_t> mCaptureNs[kPeriods] = {};
+};
+
+struct PathStats {
+    std::vector<int64_t> latencyNs;
+    size_t frames = 0;
+    size_t discontinuities = 0;     // frames not following the previous one
+    size_t misaligned = 0;          // frames not at their pipe position
+
+    double percentileMs(unsigned percent) {
+        if (latencyNs.empty()) return 0.;
+        std::sort(latencyNs.begin(), latencyNs.end());
+        return latencyNs[(latencyNs.size() - 1) * percent / 100] * 1e-6;
+    }
+};
+
+// A fast client: reads the pipe buffer shared with FastCapture, as AudioRecord does.
+void runDirectClient(audio_track_cblk_t* cblk, float* pipeBuffer, const PacedSource& source,
+        const std::atomic<bool>& done, PathStats* stats)
+{
+    AudioRecordClientProxy proxy(cblk, pipeBuffer, kPipeFrames, sizeof(float));
+    int64_t expected = -1;
+    while (!done.load()) {
+        Proxy::Buffer buffer;
+        buffer.mFrameCount = kPipeFrames;
+        const struct timespec timeout = {0, 100000000}; // 100 ms
+        if (proxy.obtainBuffer(&buffer, &timeout) != NO_ERROR) {
+            continue;
+        }
+        const int64_t nowNs = systemTime();
+        const float* frames = static_cast<const float*>(buffer.mRaw);
+        const size_t position = frames - pipeBuffer;
+        int64_t frame = 0;
+        for (size_t i = 0; i < buffer.mFrameCount; ++i) {
+            frame = (int64_t) frames[i];
+            if ((size_t) (frame & (kPipeFrames - 1)) != position + i) {
+                ++stats->misaligned;
+            }
+            if (expected >= 0 && frame != expected) {
+                ++stats->discontinuities;
+            }
+            expected = frame + 1;
+        }
+        // the first buffer may hold history from before the client was added.
+        if (stats->frames > 0) {
+            stats->latencyNs.push_back(nowNs - source.captureNs(frame));
+        }
+        stats->frames += buffer.mFrameCount;
+        proxy.releaseBuffer(&buffer);
+    }
+}
+
+// The RecordThread side of the pipe, see RecordThread::threadLoop().
+void runNormalReader(Pipe* pipe, const PacedSource& source, const std::atomic<bool>& done,
+        PathStats* stats)
+{
+    const NBAIO_Format offers[1] = {kFormat};
+    size_t numCounterOffers = 0;
+    PipeReader reader(*pipe);
+    ASSERT_EQ(0, reader.negotiate(offers, 1, nullptr /* counterOffers */, numCounterOffers));
+
+    std::vector<float> rsmpIn(kRsmpInFrames);
+    int64_t expected = -1;
+    while (!done.load()) {
+        const ssize_t framesRead = reader.read(rsmpIn.data(), kRsmpInFrames / 2);
+        const int64_t nowNs = systemTime();
+        if (framesRead > 0) {
+            for (ssize_t i = 0; i < framesRead; ++i) {
+                const int64_t frame = (int64_t) rsmpIn[i];
+                if (expected >= 0 && frame != expected) {
+                    ++stats->discontinuities;
+                }
+                expected = frame + 1;
+            }
+            stats->latencyNs.push_back(nowNs - source.captureNs(expected - 1));
+            stats->frames += framesRead;
+        }
+        const ssize_t availableToRead = reader.availableToRead();
+        const size_t pipeFramesFree = kPipeFrames - std::max(availableToRead, (ssize_t) 0);
+        const size_t sleepFrames = std::min(pipeFramesFree, kRsmpInFrames) / 2;
+        const int64_t sleepNs = sleepFrames * 1000000000LL / kSampleRate;
+        const struct timespec ts = {0, (long) sleepNs};
+        (void) nanosleep(&ts, nullptr);
+    }
+}
+
+void sleepNs(int64_t ns) {
+    const struct timespec ts = {(time_t) (ns / 1000000000LL), (long) (ns % 1000000000LL)};
+    (void) nanosleep(&ts, nullptr);
+}
+
+void report(const char* path, PathStats* stats) {
+    const double medianMs = stats->percentileMs(50);
+    const double p99Ms = stats->percentileMs(99);
+    printf("%s: frames %zu latency median %.3f ms p99 %.3f ms\n",
+            path, stats->frames, medianMs, p99Ms);
+    ::testing::Test::RecordProperty(std::string(path) + "_median_us",
+            std::to_string((int) (medianMs * 1e3)));
+    ::testing::Test::RecordProperty(std::string(path) + "_p99_us",
+            std::to_string((int) (p99Ms * 1e3)));
+}
+
+}  // namespace
+
+TEST(FastCaptureLoopback, LatencyPerPath) {
+    ASSERT_GE(FastCaptureState::kMaxFastClients, 2u);
+
+    PacedSource source;
+    std::vector<float> pipeBuffer(kPipeFrames);
+    Pipe pipe(kPipeFrames, kFormat, pipeBuffer.data());
+    const NBAIO_Format offers[1] = {kFormat};
+    size_t numCounterOffers = 0;
+    ASSERT_EQ(0, pipe.negotiate(offers, 1, nullptr /* counterOffers */, numCounterOffers));
+
+    // the second client joins once the pipe has wrapped, to check its position.
+    auto cblk0 = std::make_unique<audio_track_cblk_t>();
+    auto cblk1 = std::make_unique<audio_track_cblk_t>();
+
+    FastCaptureDumpState dumpState;
+    int32_t coldFutex = 0;
+    sp<FastCapture> fastCapture = new FastCapture();
+    FastCaptureStateQueue* sq = fastCapture->sq();
+    FastCaptureState* state = sq->begin();
+    state->mInputSource = &source;
+    state->mInputSourceGen++;
+    state->mPipeSink = &pipe;
+    state->mPipeSinkGen++;
+    state->mFrameCount = kFrameCount;
+    state->mCblk[0] = cblk0.get();
+    state->mCommand = FastCaptureState::READ_WRITE;
+    state->mColdFutexAddr = &coldFutex;
+    state->mColdGen++;
+    state->mDumpState = &dumpState;
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+    fastCapture->run("FastCapture", PRIORITY_URGENT_AUDIO);
+
+    std::atomic<bool> done{false};
+    PathStats direct0, direct1, normal;
+    std::thread client0(runDirectClient, cblk0.get(), pipeBuffer.data(), std::cref(source),
+            std::cref(done), &direct0);
+    std::thread reader(runNormalReader, &pipe, std::cref(source), std::cref(done), &normal);
+
+    sleepNs(kRunNs / 2);
+    state = sq->begin();
+    state->mCblk[1] = cblk1.get();
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+    std::thread client1(runDirectClient, cblk1.get(), pipeBuffer.data(), std::cref(source),
+            std::cref(done), &direct1);
+    sleepNs(kRunNs / 2);
+
+    state = sq->begin();
+    state->mCommand = FastCaptureState::EXIT;
+    sq->end();
+    sq->push(FastCaptureStateQueue::BLOCK_UNTIL_PUSHED);
+    fastCapture->join();
+    done = true;
+    client0.join();
+    client1.join();
+    reader.join();
+
+    EXPECT_EQ(2u, dumpState.mFastClients);
+    for (PathStats* stats : {&direct0, &direct1, &normal}) {
+        EXPECT_GT(stats->frames, 0u);
+        EXPECT_EQ(0u, stats->discontinuities);
+        EXPECT_EQ(0u, stats->misaligned);
+    }
+    report("direct", &direct0);
+    report("direct_joined", &direct1);
+    report("normal", &normal);
+    // the normal path waits for the RecordThread, which reads the pipe every few periods.
+    EXPECT_LT(direct0.percentileMs(50), normal.percentileMs(50));
+}
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <fastpath/FastMixer.h>
+
+using namespace android;
+
+/*
+ * Measures the cost of one FastMixer cycle (mix and write, as recorded by its
+ * PeriodTracer) against the number of active fast tracks, up to 255 tracks.
+ * The sink discards the mix without blocking.
+ *
+ * Only FastMixerState::getMaxFastTracks() - 1 tracks are available; set
+ * ro.audio.max_fast_tracks=256 to run all the track counts.
+ */
+
+namespace {
+
+constexpr unsigned kSampleRate = 48000;
+constexpr unsigned kChannelCount = 2;
+constexpr size_t kFrameCount = 256;
+constexpr int64_t kRunNs = 200 * 1000000LL;
+
+class NullSink : public NBAIO_Sink {
+public:
+    NullSink() : NBAIO_Sink(Format_from_SR_C(kSampleRate, kChannelCount, AUDIO_FORMAT_PCM_FLOAT)) {
+        mNegotiated = true;
+    }
+
+    ssize_t write(const void* /* buffer */, size_t count) override {
+        mFramesWritten += count;
+        return count;
+    }
+};
+
+// A track with an endless buffer of silence.
+class SilenceProvider : public ExtendedAudioBufferProvider {
+public:
+    SilenceProvider() : mBuffer(kFrameCount * kChannelCount) {}
+
+    status_t getNextBuffer(Buffer* buffer) override {
+        buffer->frameCount = std::min(buffer->frameCount, kFrameCount);
+        buffer->raw = mBuffer.data();
+        return NO_ERROR;
+    }
+    void releaseBuffer(Buffer* buffer) override {
+        buffer->raw = nullptr;
+        buffer->frameCount = 0;
+    }
+    size_t framesReady() const override { return kFrameCount; }
+
+private:
+    std::vector<float> mBuffer;
+};
+
+}  // namespace
+
+static void BM_FastMixerCycle(benchmark::State& state) {
+    const unsigned numTracks = state.range(0);
+    if (numTracks >= FastMixerState::getMaxFastTracks()) {
+        state.SkipWithError("ro.audio.max_fast_tracks is too low");
+        return;
+    }
+
+    NullSink sink;
+    std::vector<std::unique_ptr<SilenceProvider>> providers(numTracks + 1);
+    FastMixerDumpState dumpState;
+    int32_t coldFutex = 0;
+
+    sp<FastMixer> fastMixer = new FastMixer(AUDIO_IO_HANDLE_NONE);
+    FastMixerStateQueue* sq = fastMixer->sq();
+    FastMixerState* fastState = sq->begin();
+    // index 0 is the normal mixer's submix, as in MixerThread.
+    for (unsigned i = 0; i <= numTracks; ++i) {
+        providers[i] = std::make_unique<SilenceProvider>();
+        FastTrack* fastTrack = &fastState->mFastTracks[i];
+        fastTrack->mBufferProvider = providers[i].get();
+        fastTrack->mChannelMask = AUDIO_CHANNEL_OUT_STEREO;
+        fastTrack->mFormat = AUDIO_FORMAT_PCM_FLOAT;
+        fastTrack->mGeneration++;
+        fastState->mTrackMask.set(i);
+    }
+    fastState->mFastTracksGen++;
+    fastState->mOutputSink = &sink;
+    fastState->mOutputSinkGen++;
+    fastState->mFrameCount = kFrameCount;
+    fastState->mSinkChannelMask = AUDIO_CHANNEL_NONE;
+    fastState->mCommand = FastMixerState::MIX_WRITE;
+    fastState->mColdFutexAddr = &coldFutex;
+    fastState->mColdGen++;
+    fastState->mDumpState = &dumpState;
+    sq->end();
+    sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
+    fastMixer->run("FastMixer", PRIORITY_URGENT_AUDIO);
+
+    std::vector<int64_t> durationsNs;
+    for (auto _ : state) {
+        struct timespec ts = {0, kRunNs};
+        nanosleep(&ts, nullptr);
+        int64_t sumNs = 0;
+        size_t cycles = 0;
+        for (const auto& record : fastMixer->periodTracer().getRecords()) {
+            // skip the cycles before the state was applied
+            if (record.activeTracks != (int32_t)numTracks + 1) continue;
+            sumNs += record.durationNs;
+            durationsNs.push_back(record.durationNs);
+            ++cycles;
+        }
+        state.SetIterationTime(cycles > 0 ? sumNs * 1e-9 / cycles : 0.);
+    }
+
+    fastState = sq->begin();
+    fastState->mCommand = FastMixerState::EXIT;
+    sq->end();
+    sq->push(FastMixerStateQueue::BLOCK_UNTIL_PUSHED);
+    fastMixer->join();
+
+    if (!durationsNs.empty()) {
+        std::sort(durationsNs.begin(), durationsNs.end());
+        state.counters["p99_us"] = durationsNs[durationsNs.size() * 99 / 100] * 1e-3;
+        state.counters["max_us"] = durationsNs.back() * 1e-3;
+    }
+    state.counters["period_us"] = kFrameCount * 1e6 / kSampleRate;
+}
+
+BENCHMARK(BM_FastMixerCycle)->ArgName("tracks")->Arg(1)->Arg(8)->Arg(32)->Arg(64)->Arg(128)
+        ->Arg(255)->UseManualTime()->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,602 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflineBaseMixer"
+
+#include "OfflineBaseMixer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <audio_utils/format.h>
+#include <audio_utils/primitives.h>
+#include <media/AudioResamplerPublic.h>
+#include <utils/Log.h>
+
+namespace android::audioflinger {
+
+// AudioMixerBase, with the buffer provider of a track set directly:
+// there is no conversion stage before the mixer, as in AudioMixer.
+class OfflineBaseMixer::Mixer : public AudioMixerBase {
+public:
+    using AudioMixerBase::AudioMixerBase;
+
+    void setBufferProvider(int name, AudioBufferProvider* bufferProvider) {
+        LOG_ALWAYS_FATAL_IF(!exists(name), "invalid name: %d", name);
+        mTracks[name]->bufferProvider = bufferProvider;
+    }
+};
+
+// The server side of a track and its simulated client.
+// The client writes into a circular buffer, which the AudioMixer reads as buffer provider.
+class OfflineBaseMixer::Track : public AudioBufferProvider {
+public:
+    enum FillingStatus {
+        FS_FILLING,
+        FS_FILLED,
+        FS_ACTIVE,
+    };
+
+    Track(int id, const TrackConfig& config, uint32_t mixerSampleRate, size_t mixerFrameCount)
+        : mId(id)
+        , mConfig(config)
+        , mChannelCount(audio_channel_count_from_out_mask(config.channelMask))
+        , mFrameSize(audio_bytes_per_frame(mChannelCount, config.format))
+        , mPeriodFrames(sourceFramesNeeded(config.sampleRate, mixerFrameCount, mixerSampleRate))
+        , mBufferFrames(config.bufferFrames != 0 ? config.bufferFrames : 2 * mPeriodFrames)
+        , mWriteFrames(config.writeFrames != 0 ? config.writeFrames : mPeriodFrames)
+        , mBuffer(mBufferFrames * mFrameSize)
+        , mScratch(mBufferFrames * mChannelCount)
+        , mMixerInBuffer(mBufferFrames * mChannelCount) {
+    }
+
+    int id() const { return mId; }
+    const TrackConfig& config() const { return mConfig; }
+
+    bool isStopped() const { return mStats.state == STOPPED; }
+    bool isPausing() const { return mStats.state == PAUSING; }
+    bool isPaused() const { return mStats.state == PAUSED; }
+    bool isTerminated() const { return mTerminated; }
+
+    size_t framesReady() const {
+        return (size_t)(mStats.framesWritten - mStats.framesReleased);
+    }
+
+    // See Track::isReady().
+    bool isReady() {
+        if (mFillingStatus != FS_FILLING || isStopped() || isPausing()) {
+            return true;
+        }
+        if (framesReady() >= mBufferFrames) {
+            mFillingStatus = FS_FILLED;
+            return true;
+        }
+        return false;
+    }
+
+    // The client write of one period, or of the whole free space if fill is true
+    // (as an application writing its buffer before start()).
+    void clientWrite(bool fill = false) {
+        if (mStats.state == IDLE || isStopped() || mTerminated) {
+            return;
+        }
+        if (!fill && mStarvePeriods > 0) {
+            --mStarvePeriods;
+            return;
+        }
+        size_t frames = mBufferFrames - framesReady();
+        if (!fill) {
+            frames = std::min(frames, mWriteFrames);
+        }
+        generate(mScratch.data(), frames);
+        const float* src = mScratch.data();
+        while (frames > 0) {
+            const size_t offset = (size_t)(mStats.framesWritten % mBufferFrames);
+            const size_t part = std::min(frames, mBufferFrames - offset);
+            memcpy_by_audio_format(mBuffer.data() + offset * mFrameSize, mConfig.format,
+                    src, AUDIO_FORMAT_PCM_FLOAT, part * mChannelCount);
+            src += part * mChannelCount;
+            mStats.framesWritten += part;
+            frames -= part;
+        }
+    }
+
+    // AudioBufferProvider
+    status_t getNextBuffer(Buffer* buffer) override {
+        const size_t offset = (size_t)(mStats.framesReleased % mBufferFrames);
+        const size_t frames = std::min({buffer->frameCount, framesReady(), mBufferFrames - offset});
+        if (frames == 0) {
+            buffer->raw = nullptr;
+            buffer->frameCount = 0;
+            return NOT_ENOUGH_DATA;
+        }
+        // AudioMixerBase mixes float: convert, as the ReformatBufferProvider of AudioMixer.
+        memcpy_by_audio_format(mMixerInBuffer.data(), AUDIO_FORMAT_PCM_FLOAT,
+                mBuffer.data() + offset * mFrameSize, mConfig.format, frames * mChannelCount);
+        buffer->raw = mMixerInBuffer.data();
+        buffer->frameCount = frames;
+        return NO_ERROR;
+    }
+
+    void releaseBuffer(Buffer* buffer) override {
+        mStats.framesReleased += buffer->frameCount;
+        buffer->raw = nullptr;
+        buffer->frameCount = 0;
+    }
+
+    TrackStats mStats;
+    FillingStatus mFillingStatus = FS_FILLING;
+    int8_t mRetryCount = 0;
+    float mVolume[2] = {1.f, 1.f};
+    uint32_t mStarvePeriods = 0;
+    bool mTerminated = false;
+
+private:
+    void generate(float* out, size_t frames) {
+        const double sampleRate = mConfig.sampleRate;
+        for (size_t i = 0; i < frames; ++i) {
+            const int64_t n = mStats.framesWritten + (int64_t)i;
+            switch (mConfig.signal) {
+            case SIGNAL_SINE: {
+                const double phase = 2. * M_PI * mConfig.frequencyHz * (double)n / sampleRate;
+                for (uint32_t c = 0; c < mChannelCount; ++c) {
+                    *out++ = mConfig.amplitude * (float)sin(phase + c * M_PI / 4.);
+                }
+            } break;
+            case SIGNAL_CHIRP: {
+                constexpr double kStartHz = 20.;
+                const double t = (double)(n % mConfig.sampleRate) / sampleRate;
+                const double phase = 2. * M_PI
+                        * (kStartHz * t + (sampleRate / 2. - kStartHz) * t * t / 2.);
+                const float value = mConfig.amplitude * (float)sin(phase);
+                for (uint32_t c = 0; c < mChannelCount; ++c) {
+                    *out++ = value;
+                }
+            } break;
+            case SIGNAL_NOISE:
+                for (uint32_t c = 0; c < mChannelCount; ++c) {
+                    mNoiseSeed = mNoiseSeed * 1664525u + 1013904223u;
+                    *out++ = mConfig.amplitude
+                            * (float)((int32_t)mNoiseSeed >> 8) * (1.f / (1 << 23));
+                }
+                break;
+            }
+        }
+    }
+
+    const int mId;
+    const TrackConfig mConfig;
+    const uint32_t mChannelCount;
+    const size_t mFrameSize;
+    const size_t mPeriodFrames;
+    const size_t mBufferFrames;
+    const size_t mWriteFrames;
+    std::vector<uint8_t> mBuffer;
+    std::vector<float> mScratch;        // client samples before conversion to the track format
+    std::vector<float> mMixerInBuffer;  // provided to the mixer
+    uint32_t mNoiseSeed = 1;
+};
+
+struct OfflineBaseMixer::EffectChain {
+    std::vector<std::unique_ptr<OfflineEffect>> mEffects;
+    std::vector<float> mInBuffer;
+    size_t mActiveTracks = 0;   // tracks mixed into mInBuffer in the current period
+};
+
+OfflineBaseMixer::OfflineBaseMixer(const Config& config, SinkCallback sink)
+    : OfflineMixer(config, std::move(sink))
+    , mAudioMixer(std::make_unique<Mixer>(config.frameCount, config.sampleRate))
+    , mMixerBuffer(config.frameCount * mChannelCount)
+    , mEffectBuffer(config.frameCount * mChannelCount)
+    , mSinkBuffer(config.frameCount * mSinkFrameSize) {
+}
+
+OfflineBaseMixer::~OfflineBaseMixer() {
+    // the mixer tracks refer to the buffer providers
+    mAudioMixer.reset();
+}
+
+OfflineBaseMixer::Track* OfflineBaseMixer::getTrack(int id) const {
+    const auto it = mTracks.find(id);
+    return it != mTracks.end() && !it->second->isTerminated() ? it->second.get() : nullptr;
+}
+
+OfflineBaseMixer::EffectChain* OfflineBaseMixer::getEffectChain(audio_session_t sessionId) const {
+    const auto it = mEffectChains.find(sessionId);
+    return it != mEffectChains.end() ? it->second.get() : nullptr;
+}
+
+status_t OfflineBaseMixer::addTrack(int id, const TrackConfig& config) {
+    if (mTracks.count(id) != 0) {
+        ALOGE("%s: track %d already exists", __func__, id);
+        return BAD_VALUE;
+    }
+    if (config.sampleRate == 0
+            || config.sampleRate > mConfig.sampleRate * AUDIO_RESAMPLER_DOWN_RATIO_MAX) {
+        ALOGE("%s: track %d invalid sample rate %u", __func__, id, config.sampleRate);
+        return BAD_VALUE;
+    }
+    switch (config.format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+    case AUDIO_FORMAT_PCM_FLOAT:
+        break;
+    default:
+        ALOGE("%s: track %d invalid format %#x", __func__, id, config.format);
+        return BAD_VALUE;
+    }
+    // without the downmixer of AudioMixer, only mono and stereo are expanded to the mix.
+    const uint32_t channelCount = audio_channel_count_from_out_mask(config.channelMask);
+    if (channelCount != 1 && channelCount != mChannelCount
+            && !(channelCount == 2 && mChannelCount > 2)) {
+        ALOGE("%s: track %d cannot mix channel mask %#x into %#x",
+                __func__, id, config.channelMask, mConfig.channelMask);
+        return BAD_VALUE;
+    }
+    const status_t status = mAudioMixer->create(
+            id, config.channelMask, AUDIO_FORMAT_PCM_FLOAT, config.sessionId);
+    if (status != OK) {
+        ALOGE("%s: track %d invalid channel mask %#x", __func__, id, config.channelMask);
+        return status;
+    }
+    mTracks[id] = std::make_unique<Track>(id, config, mConfig.sampleRate, mConfig.frameCount);
+    return OK;
+}
+
+status_t OfflineBaseMixer::removeTrack(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    if (track->mStats.active) {
+        // removed by the next prepareTracks()
+        track->mTerminated = true;
+    } else {
+        mAudioMixer->destroy(id);
+        mTracks.erase(id);
+    }
+    return OK;
+}
+
+status_t OfflineBaseMixer::start(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    TrackStats& stats = track->mStats;
+    switch (stats.state) {
+    case PAUSED:
+    case PAUSING:
+        stats.state = RESUMING;
+        break;
+    case ACTIVE:
+    case RESUMING:
+        if (!stats.disabled) return OK;
+        break;
+    default:
+        stats.state = ACTIVE;
+        track->clientWrite(true /* fill */);
+        break;
+    }
+    // see PlaybackThread::addTrack_l()
+    stats.disabled = false;
+    track->mFillingStatus = Track::FS_FILLING;
+    track->mRetryCount = kMaxTrackRetries;
+    if (!stats.active) {
+        stats.active = true;
+        mActiveTracks.push_back(track);
+    }
+    return OK;
+}
+
+status_t OfflineBaseMixer::pause(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    TrackStats& stats = track->mStats;
+    switch (stats.state) {
+    case ACTIVE:
+    case RESUMING:
+        // an inactive track has nothing to ramp down
+        stats.state = stats.active ? PAUSING : PAUSED;
+        return OK;
+    case PAUSING:
+    case PAUSED:
+        return OK;
+    default:
+        return INVALID_OPERATION;
+    }
+}
+
+status_t OfflineBaseMixer::stop(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    // a normal track drains what was written, see prepareTracks()
+    track->mStats.state = STOPPED;
+    return OK;
+}
+
+status_t OfflineBaseMixer::setVolume(int id, float left, float right) {
+    Track* const track = getTrack(id);
+    if (track == nullptr || !(left >= 0.f) || !(right >= 0.f)) return BAD_VALUE;
+    track->mVolume[0] = left;
+    track->mVolume[1] = right;
+    return OK;
+}
+
+status_t OfflineBaseMixer::starve(int id, uint32_t periods) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    track->mStarvePeriods = periods;
+    return OK;
+}
+
+status_t OfflineBaseMixer::addEffect(audio_session_t sessionId,
+        std::unique_ptr<OfflineEffect> effect) {
+    if (effect == nullptr || sessionId == AUDIO_SESSION_OUTPUT_MIX) return BAD_VALUE;
+    auto& chain = mEffectChains[sessionId];
+    if (chain == nullptr) {
+        chain = std::make_unique<EffectChain>();
+        chain->mInBuffer.resize(mConfig.frameCount * mChannelCount);
+    }
+    chain->mEffects.push_back(std::move(effect));
+    return OK;
+}
+
+status_t OfflineBaseMixer::getTrackStats(int id, TrackStats* stats) const {
+    const Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    *stats = track->mStats;
+    return OK;
+}
+
+// See MixerThread::prepareTracks_l(), for normal tracks on a thread without FastMixer.
+OfflineBaseMixer::MixerStatus OfflineBaseMixer::prepareTracks() {
+    MixerStatus mixerStatus = MIXER_IDLE;
+    std::vector<Track*> tracksToRemove;
+    std::vector<std::pair<Track*, size_t>> underruns;
+
+    mMixerBufferValid = false;
+    mEffectBufferValid = false;
+    for (auto& [sessionId, chain] : mEffectChains) {
+        chain->mActiveTracks = 0;
+    }
+
+    for (Track* track : mActiveTracks) {
+        const int trackId = track->id();
+        TrackStats& stats = track->mStats;
+
+        // make sure that we have enough frames to mix one full buffer.
+        const size_t desiredFrames = sourceFramesNeeded(track->config().sampleRate,
+                mConfig.frameCount, mConfig.sampleRate)
+                + mAudioMixer->getUnreleasedFrames(trackId);
+        size_t minFrames = 1;
+        if (!track->isStopped() && !track->isPausing() && mMixerStatus == MIXER_TRACKS_READY) {
+            minFrames = desiredFrames;
+        }
+
+        const size_t framesReady = track->framesReady();
+        if (framesReady >= minFrames && track->isReady()
+                && !track->isPaused() && !track->isTerminated()) {
+            EffectChain* const chain = getEffectChain(track->config().sessionId);
+            if (chain != nullptr) {
+                mEffectBufferValid = true;
+                ++chain->mActiveTracks;
+            }
+
+            int param = AudioMixerBase::VOLUME;
+            if (track->mFillingStatus == Track::FS_FILLED) {
+                // no ramp for the first volume setting
+                track->mFillingStatus = Track::FS_ACTIVE;
+                if (stats.state == RESUMING) {
+                    stats.state = ACTIVE;
+                    // If a new track is paused immediately after start, do not ramp on resume.
+                    if (stats.framesReleased != 0) {
+                        param = AudioMixerBase::RAMP_VOLUME;
+                    }
+                }
+                mAudioMixer->setParameter(trackId, AudioMixerBase::RESAMPLE,
+                        AudioMixerBase::RESET, nullptr);
+            } else if (stats.framesReleased != 0) {
+                // If the track is stopped before the first frame was mixed,
+                // do not apply ramp
+                param = AudioMixerBase::RAMP_VOLUME;
+            }
+
+            float vlf, vrf;
+            if (track->isPausing()) {
+                vlf = vrf = 0.f;
+                stats.state = PAUSED;
+            } else {
+                const float v = mConfig.masterVolume;
+                vlf = std::min(track->mVolume[0], AudioMixerBase::UNITY_GAIN_FLOAT) * v;
+                vrf = std::min(track->mVolume[1], AudioMixerBase::UNITY_GAIN_FLOAT) * v;
+            }
+            float vaf = 0.f;
+
+            mAudioMixer->setBufferProvider(trackId, track);
+            mAudioMixer->enable(trackId);
+            mAudioMixer->setParameter(trackId, param, AudioMixerBase::VOLUME0, &vlf);
+            mAudioMixer->setParameter(trackId, param, AudioMixerBase::VOLUME1, &vrf);
+            mAudioMixer->setParameter(trackId, param, AudioMixerBase::AUXLEVEL, &vaf);
+            mAudioMixer->setParameter(trackId, AudioMixerBase::TRACK, AudioMixerBase::FORMAT,
+                    (void *)(uintptr_t)AUDIO_FORMAT_PCM_FLOAT);
+            mAudioMixer->setParameter(trackId, AudioMixerBase::TRACK,
+                    AudioMixerBase::CHANNEL_MASK, (void *)(uintptr_t)track->config().channelMask);
+            mAudioMixer->setParameter(trackId, AudioMixerBase::TRACK,
+                    AudioMixerBase::MIXER_CHANNEL_MASK, (void *)(uintptr_t)mConfig.channelMask);
+            mAudioMixer->setParameter(trackId, AudioMixerBase::RESAMPLE,
+                    AudioMixerBase::SAMPLE_RATE, (void *)(uintptr_t)track->config().sampleRate);
+            mAudioMixer->setParameter(trackId, AudioMixerBase::TRACK,
+                    AudioMixerBase::MIXER_FORMAT, (void *)(uintptr_t)AUDIO_FORMAT_PCM_FLOAT);
+            // tracks with effects go into their session chain buffer
+            float* const mainBuffer = chain != nullptr
+                    ? chain->mInBuffer.data() : mMixerBuffer.data();
+            mAudioMixer->setParameter(trackId, AudioMixerBase::TRACK,
+                    AudioMixerBase::MAIN_BUFFER, mainBuffer);
+            mAudioMixer->setParameter(trackId, AudioMixerBase::TRACK,
+                    AudioMixerBase::AUX_BUFFER, nullptr);
+            if (chain == nullptr) {
+                mMixerBufferValid = true;
+            }
+
+            // reset retry count
+            track->mRetryCount = kMaxTrackRetries;
+
+            // If one track is ready, set the mixer ready if:
+            //  - the mixer was not ready during previous round OR
+            //  - no other track is not ready
+            if (mMixerStatus != MIXER_TRACKS_READY || mixerStatus != MIXER_TRACKS_ENABLED) {
+                mixerStatus = MIXER_TRACKS_READY;
+            }
+        } else {
+            if (framesReady < desiredFrames && !track->isStopped() && !track->isPaused()) {
+                ALOGV("%s: track(%d) underrun, state %s framesReady(%zu) < desiredFrames(%zu)",
+                        __func__, trackId, trackStateToString(stats.state),
+                        framesReady, desiredFrames);
+                underruns.emplace_back(track, desiredFrames);
+            }
+            if (track->isTerminated() || track->isStopped() || track->isPaused()) {
+                // We have consumed all the buffers of this track.
+                if (track->isStopped()) {
+                    track->mFillingStatus = Track::FS_FILLING;
+                }
+                tracksToRemove.push_back(track);
+            } else {
+                // No buffers for this track. Give it a few chances to
+                // fill a buffer, then remove it from active list.
+                if (--track->mRetryCount <= 0) {
+                    ALOGI("%s: BUFFER TIMEOUT: remove track(%d) from active list due to "
+                            "underrun", __func__, trackId);
+                    stats.disabled = true;
+                    tracksToRemove.push_back(track);
+                // If one track is not ready, mark the mixer also not ready if:
+                //  - the mixer was ready during previous round OR
+                //  - no other track is ready
+                } else if (mMixerStatus == MIXER_TRACKS_READY ||
+                        mixerStatus != MIXER_TRACKS_READY) {
+                    mixerStatus = MIXER_TRACKS_ENABLED;
+                }
+            }
+            mAudioMixer->disable(trackId);
+        }
+    }
+
+    // Tally underrun frames only if we are actually mixing, see DeferredOperations.
+    if (mixerStatus == MIXER_TRACKS_READY) {
+        for (const auto& [track, frames] : underruns) {
+            track->mStats.underrunFrames += frames;
+        }
+    }
+    removeTracks(tracksToRemove);
+
+    // clear the input buffer of chains without active track, to avoid sending
+    // the previous audio buffer again to effects
+    for (auto& [sessionId, chain] : mEffectChains) {
+        if (chain->mActiveTracks == 0) {
+            std::fill(chain->mInBuffer.begin(), chain->mInBuffer.end(), 0.f);
+        }
+    }
+    return mixerStatus;
+}
+
+void OfflineBaseMixer::removeTracks(const std::vector<Track*>& tracksToRemove) {
+    for (Track* track : tracksToRemove) {
+        track->mStats.active = false;
+        mActiveTracks.erase(std::find(mActiveTracks.begin(), mActiveTracks.end(), track));
+        if (track->isTerminated()) {
+            const int id = track->id();
+            mAudioMixer->destroy(id);
+            mTracks.erase(id);
+        }
+    }
+}
+
+void OfflineBaseMixer::processEffects() {
+    if (!mEffectBufferValid) return;
+    // the tracks without effect are merged first, then the chains accumulate their output.
+    if (mMixerBufferValid) {
+        std::copy(mMixerBuffer.begin(), mMixerBuffer.end(), mEffectBuffer.begin());
+    } else {
+        std::fill(mEffectBuffer.begin(), mEffectBuffer.end(), 0.f);
+    }
+    for (auto& [sessionId, chain] : mEffectChains) {
+        if (chain->mActiveTracks == 0) continue;
+        float* const buffer = chain->mInBuffer.data();
+        for (const auto& effect : chain->mEffects) {
+            effect->process(buffer, mConfig.frameCount, mChannelCount);
+        }
+        accumulate_float(mEffectBuffer.data(), buffer, mEffectBuffer.size());
+    }
+}
+
+void OfflineBaseMixer::write() {
+    const float* const buffer = mEffectBufferValid ? mEffectBuffer.data() : mMixerBuffer.data();
+    const size_t sampleCount = mConfig.frameCount * mChannelCount;
+    if (mConfig.sinkFormat == AUDIO_FORMAT_PCM_FLOAT) {
+        // Clamp PCM float values more than this distance from 0, as PlaybackThread does.
+        static constexpr float HAL_FLOAT_SAMPLE_LIMIT = 2.0f;
+        memcpy_to_float_from_float_with_clamping(reinterpret_cast<float*>(mSinkBuffer.data()),
+                buffer, sampleCount, HAL_FLOAT_SAMPLE_LIMIT /* absMax */);
+    } else {
+        memcpy_by_audio_format(mSinkBuffer.data(), mConfig.sinkFormat,
+                buffer, AUDIO_FORMAT_PCM_FLOAT, sampleCount);
+    }
+    if (mSink) {
+        mSink(mSinkBuffer.data(), mConfig.frameCount);
+    }
+}
+
+bool OfflineBaseMixer::processPeriod() {
+    // the clients run in other processes, outside of the period
+    for (Track* track : mActiveTracks) {
+        track->clientWrite();
+    }
+
+    mPeriodTracer.beginPeriod();
+
+    mPeriodTracer.beginStage(PeriodTracer::STAGE_PREPARE);
+    mMixerStatus = prepareTracks();
+    mPeriodTracer.endStage(PeriodTracer::STAGE_PREPARE);
+
+    if (mMixerStatus == MIXER_TRACKS_READY) {
+        mPeriodTracer.beginStage(PeriodTracer::STAGE_MIX);
+        mAudioMixer->process();
+        mPeriodTracer.endStage(PeriodTracer::STAGE_MIX);
+    } else {
+        // Unlike MixerThread, which sleeps or goes to standby, always write a period
+        // so that the output has one period per call.
+        mMixerBufferValid = false;
+        mEffectBufferValid = false;
+    }
+    if (!mMixerBufferValid) {
+        std::fill(mMixerBuffer.begin(), mMixerBuffer.end(), 0.f);
+    }
+
+    if (!mEffectChains.empty()) {
+        mPeriodTracer.beginStage(PeriodTracer::STAGE_EFFECTS);
+        processEffects();
+        mPeriodTracer.endStage(PeriodTracer::STAGE_EFFECTS);
+    }
+
+    mPeriodTracer.beginStage(PeriodTracer::STAGE_WRITE);
+    write();
+    mPeriodTracer.endStage(PeriodTracer::STAGE_WRITE);
+
+    mPeriodTracer.endPeriod(mActiveTracks.size());
+    ++mPeriods;
+    return !mActiveTracks.empty();
+}
+
+} // namespace android::audioflinger
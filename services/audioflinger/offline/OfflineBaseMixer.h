@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <media/AudioMixerBase.h>
+
+#include "OfflineMixer.h"
+
+namespace android::audioflinger {
+
+/**
+ * OfflineBaseMixer
+ *
+ * Runs the period of a MixerThread on top of AudioMixerBase, without libaudioflinger,
+ * so that it builds on host:
+ *  - the prepare stage follows MixerThread::prepareTracks_l(): track state machine,
+ *    filling status, start/resume volume ramps, underrun retries and AudioMixer parameters;
+ *  - the mix stage runs the AudioMixer into the float mixer buffer, or into the buffer
+ *    of the session effect chain of a track;
+ *  - the effects stage runs the session chains in place and accumulates their output
+ *    into the effect buffer, as PlaybackThread::threadLoop() does;
+ *  - the write stage converts to the sink format and hands the period to the sink.
+ *
+ * Unlike the MixerThread, an effect runs from the period of addEffect(), a stopped track
+ * is removed once drained, and a period where no track is ready is written as silence.
+ * Timestretch, haptic playback and downmix, which depend on device libraries, are not
+ * available. Tracks are converted to float before the mix, and must be mono, stereo or
+ * have the channel count of the mix.
+ */
+class OfflineBaseMixer final : public OfflineMixer {
+public:
+    explicit OfflineBaseMixer(const Config& config, SinkCallback sink = nullptr);
+    ~OfflineBaseMixer() override;
+
+    status_t addTrack(int id, const TrackConfig& config) override;
+    status_t removeTrack(int id) override;
+    status_t start(int id) override;
+    status_t pause(int id) override;
+    status_t stop(int id) override;
+    status_t setVolume(int id, float left, float right) override;
+    status_t starve(int id, uint32_t periods) override;
+
+    status_t addEffect(audio_session_t sessionId,
+            std::unique_ptr<OfflineEffect> effect) override;
+    void setMasterVolume(float volume) override { mConfig.masterVolume = volume; }
+
+    bool processPeriod() override;
+
+    size_t activeTracks() const override { return mActiveTracks.size(); }
+    status_t getTrackStats(int id, TrackStats* stats) const override;
+    const PeriodTracer& periodTracer() const override { return mPeriodTracer; }
+
+private:
+    class Mixer;
+    class Track;
+    struct EffectChain;
+
+    enum MixerStatus {
+        MIXER_IDLE,             // no active tracks
+        MIXER_TRACKS_ENABLED,   // at least one active track, but no track has any data ready
+        MIXER_TRACKS_READY,     // at least one active track, and at least one track has data
+    };
+
+    // as in Threads.cpp
+    static constexpr int8_t kMaxTrackRetries = 50;
+
+    Track* getTrack(int id) const;
+    EffectChain* getEffectChain(audio_session_t sessionId) const;
+    MixerStatus prepareTracks();
+    void removeTracks(const std::vector<Track*>& tracksToRemove);
+    void processEffects();
+    void write();
+
+    std::unique_ptr<Mixer> mAudioMixer;
+    std::vector<float> mMixerBuffer;
+    std::vector<float> mEffectBuffer;
+    std::vector<uint8_t> mSinkBuffer;
+    bool mMixerBufferValid = false;
+    bool mEffectBufferValid = false;
+
+    std::map<int, std::unique_ptr<Track>> mTracks;
+    std::vector<Track*> mActiveTracks;
+    std::map<audio_session_t, std::unique_ptr<EffectChain>> mEffectChains;
+
+    MixerStatus mMixerStatus = MIXER_IDLE;
+    PeriodTracer mPeriodTracer;
+};
+
+} // namespace android::audioflinger
@@ -0,0 +1,697 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflineHal"
+
+#include "OfflineHal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <audio_utils/clock.h>
+#include <audio_utils/format.h>
+#include <audio_utils/primitives.h>
+#include <utils/Log.h>
+
+#include "OfflineMixer.h"
+
+namespace android::audioflinger {
+
+// The thread is expected to write within this delay of the previous release().
+static constexpr std::chrono::seconds kWriteTimeout{5};
+
+OfflineStreamOutHal::OfflineStreamOutHal(const audio_config_base_t& config, size_t frameCount)
+    : mConfig(config)
+    , mFrameCount(frameCount)
+    , mFrameSize(audio_bytes_per_frame(
+            audio_channel_count_from_out_mask(config.channel_mask), config.format))
+    , mBuffer(frameCount * mFrameSize) {
+}
+
+const void* OfflineStreamOutHal::waitForWrite() {
+    std::unique_lock l(mLock);
+    LOG_ALWAYS_FATAL_IF(!mCondition.wait_for(l, kWriteTimeout, [this] { return mWriting; }),
+            "%s: no write from the mixer thread", __func__);
+    return mBuffer.data();
+}
+
+void OfflineStreamOutHal::release() {
+    {
+        std::lock_guard l(mLock);
+        if (!mWriting) return;
+        mWriting = false;
+        mPresentedFrames += mFrameCount;
+    }
+    mCondition.notify_all();
+}
+
+void OfflineStreamOutHal::waitForPresentedFrames(uint64_t frames) {
+    std::unique_lock l(mLock);
+    mCondition.wait(l, [&] { return mPresentedFrames >= frames || mExiting; });
+}
+
+status_t OfflineStreamOutHal::write(const void* buffer, size_t bytes, size_t* written) {
+    std::unique_lock l(mLock);
+    if (mExiting) {
+        *written = bytes;
+        return OK;
+    }
+    LOG_ALWAYS_FATAL_IF(bytes != mBuffer.size(), "%s: write of %zu bytes, expected %zu",
+            __func__, bytes, mBuffer.size());
+    memcpy(mBuffer.data(), buffer, bytes);
+    mWriting = true;
+    mCondition.notify_all();
+    mCondition.wait(l, [this] { return !mWriting || mExiting; });
+    *written = bytes;
+    return OK;
+}
+
+status_t OfflineStreamOutHal::exit() {
+    {
+        std::lock_guard l(mLock);
+        mExiting = true;
+    }
+    mCondition.notify_all();
+    return OK;
+}
+
+status_t OfflineStreamOutHal::getPresentationPosition(uint64_t* frames,
+        struct timespec* timestamp) {
+    {
+        std::lock_guard l(mLock);
+        *frames = mPresentedFrames;
+    }
+    clock_gettime(CLOCK_MONOTONIC, timestamp);
+    return OK;
+}
+
+status_t OfflineStreamOutHal::getRenderPosition(uint64_t* dspFrames) {
+    std::lock_guard l(mLock);
+    *dspFrames = mPresentedFrames;
+    return OK;
+}
+
+status_t OfflineStreamOutHal::getBufferSize(size_t* size) {
+    *size = mFrameCount * mFrameSize;
+    return OK;
+}
+
+status_t OfflineStreamOutHal::getAudioProperties(audio_config_base_t* configBase) {
+    *configBase = mConfig;
+    return OK;
+}
+
+status_t OfflineStreamOutHal::getFrameSize(size_t* size) {
+    *size = mFrameSize;
+    return OK;
+}
+
+status_t OfflineStreamOutHal::getLatency(uint32_t* latency) {
+    // one period in the HAL
+    *latency = (uint32_t)(mFrameCount * 1000 / mConfig.sample_rate);
+    return OK;
+}
+
+status_t OfflineStreamOutHal::supportsPauseAndResume(bool* supportsPause, bool* supportsResume) {
+    *supportsPause = false;
+    *supportsResume = false;
+    return OK;
+}
+
+status_t OfflineStreamOutHal::supportsDrain(bool* supportsDrain) {
+    *supportsDrain = false;
+    return OK;
+}
+
+// The stream has no parameters, effects, mmap buffer, async callbacks or latency modes.
+status_t OfflineStreamOutHal::setParameters(const String8& /* kvPairs */) { return OK; }
+status_t OfflineStreamOutHal::getParameters(const String8& /* keys */, String8* values) {
+    *values = String8();
+    return OK;
+}
+status_t OfflineStreamOutHal::addEffect(sp<EffectHalInterface> /* effect */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::removeEffect(sp<EffectHalInterface> /* effect */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::standby() { return OK; }
+status_t OfflineStreamOutHal::dump(int /* fd */, const Vector<String16>& /* args */) { return OK; }
+status_t OfflineStreamOutHal::start() { return INVALID_OPERATION; }
+status_t OfflineStreamOutHal::stop() { return INVALID_OPERATION; }
+status_t OfflineStreamOutHal::createMmapBuffer(int32_t /* minSizeFrames */,
+        struct audio_mmap_buffer_info* /* info */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::getMmapPosition(struct audio_mmap_position* /* position */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setHalThreadPriority(int /* priority */) { return OK; }
+// the stream is routed to any device
+status_t OfflineStreamOutHal::legacyCreateAudioPatch(const struct audio_port_config& /* port */,
+        std::optional<audio_source_t> /* source */, audio_devices_t /* type */) {
+    return OK;
+}
+status_t OfflineStreamOutHal::legacyReleaseAudioPatch() { return OK; }
+status_t OfflineStreamOutHal::setVolume(float /* left */, float /* right */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::selectPresentation(int /* presentationId */, int /* programId */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setCallback(wp<StreamOutHalInterfaceCallback> /* callback */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::pause() { return INVALID_OPERATION; }
+status_t OfflineStreamOutHal::resume() { return INVALID_OPERATION; }
+status_t OfflineStreamOutHal::drain(bool /* earlyNotify */) { return INVALID_OPERATION; }
+status_t OfflineStreamOutHal::flush() { return INVALID_OPERATION; }
+status_t OfflineStreamOutHal::presentationComplete() { return OK; }
+status_t OfflineStreamOutHal::updateSourceMetadata(const SourceMetadata& /* sourceMetadata */) {
+    return OK;
+}
+status_t OfflineStreamOutHal::getDualMonoMode(audio_dual_mono_mode_t* /* mode */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setDualMonoMode(audio_dual_mono_mode_t /* mode */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::getAudioDescriptionMixLevel(float* /* leveldB */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setAudioDescriptionMixLevel(float /* leveldB */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::getPlaybackRateParameters(
+        audio_playback_rate_t* /* playbackRate */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setPlaybackRateParameters(
+        const audio_playback_rate_t& /* playbackRate */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setEventCallback(
+        const sp<StreamOutHalInterfaceEventCallback>& /* callback */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setLatencyMode(audio_latency_mode_t /* mode */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::getRecommendedLatencyModes(
+        std::vector<audio_latency_mode_t>* /* modes */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamOutHal::setLatencyModeCallback(
+        const sp<StreamOutHalInterfaceLatencyModeCallback>& /* callback */) {
+    return INVALID_OPERATION;
+}
+
+OfflineStreamOut::OfflineStreamOut(AudioHwDevice* dev, const sp<OfflineStreamOutHal>& halStream)
+    : AudioStreamOut(dev) {
+    stream = halStream;
+    // a deep buffer output has no FastMixer: the mix period is the HAL buffer.
+    flags = (audio_output_flags_t)(AUDIO_OUTPUT_FLAG_PRIMARY | AUDIO_OUTPUT_FLAG_DEEP_BUFFER);
+    (void)halStream->getFrameSize(&mHalFrameSize);
+    mHalFormatHasProportionalFrames = true;
+}
+
+OfflineStreamInHal::OfflineStreamInHal(const audio_config_base_t& config, size_t frameCount,
+        const sp<OfflineStreamOutHal>& clock, uint64_t markerFrame, uint32_t latencyFrames)
+    : mConfig(config)
+    , mFrameCount(frameCount)
+    , mChannelCount(audio_channel_count_from_in_mask(config.channel_mask))
+    , mFrameSize(audio_bytes_per_frame(mChannelCount, config.format))
+    , mClock(clock)
+    , mMarkerFrame(markerFrame)
+    , mLatencyFrames(latencyFrames) {
+}
+
+status_t OfflineStreamInHal::read(void* buffer, size_t bytes, size_t* read) {
+    const size_t frameCount = bytes / mFrameSize;
+    uint64_t position;
+    {
+        std::lock_guard l(mLock);
+        position = mFramesRead;
+    }
+    // the frames up to the end of the period being rendered are captured.
+    const uint64_t end = position + frameCount;
+    mClock->waitForPresentedFrames(end > mFrameCount ? end - mFrameCount : 0);
+
+    std::lock_guard l(mLock);
+    mScratch.assign(frameCount * mChannelCount, 0.f);
+    if (mMarkerFrame >= mFramesRead && mMarkerFrame < mFramesRead + frameCount) {
+        std::fill_n(&mScratch[(mMarkerFrame - mFramesRead) * mChannelCount], mChannelCount,
+                kMarkerValue);
+    }
+    memcpy_by_audio_format(buffer, mConfig.format, mScratch.data(), AUDIO_FORMAT_PCM_FLOAT,
+            mScratch.size());
+    mFramesRead += frameCount;
+    *read = frameCount * mFrameSize;
+    return OK;
+}
+
+status_t OfflineStreamInHal::getCapturePosition(int64_t* frames, int64_t* time) {
+    {
+        std::lock_guard l(mLock);
+        *frames = (int64_t)(mFramesRead + mLatencyFrames);
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    *time = audio_utils_ns_from_timespec(&now);
+    return OK;
+}
+
+status_t OfflineStreamInHal::getBufferSize(size_t* size) {
+    *size = mFrameCount * mFrameSize;
+    return OK;
+}
+
+status_t OfflineStreamInHal::getAudioProperties(audio_config_base_t* configBase) {
+    *configBase = mConfig;
+    return OK;
+}
+
+status_t OfflineStreamInHal::getFrameSize(size_t* size) {
+    *size = mFrameSize;
+    return OK;
+}
+
+status_t OfflineStreamInHal::getInputFramesLost(uint32_t* framesLost) {
+    *framesLost = 0;
+    return OK;
+}
+
+// The stream has no parameters, effects, mmap buffer, gain or microphones.
+status_t OfflineStreamInHal::setParameters(const String8& /* kvPairs */) { return OK; }
+status_t OfflineStreamInHal::getParameters(const String8& /* keys */, String8* values) {
+    *values = String8();
+    return OK;
+}
+status_t OfflineStreamInHal::addEffect(sp<EffectHalInterface> /* effect */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamInHal::removeEffect(sp<EffectHalInterface> /* effect */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamInHal::standby() { return OK; }
+status_t OfflineStreamInHal::dump(int /* fd */, const Vector<String16>& /* args */) { return OK; }
+status_t OfflineStreamInHal::start() { return INVALID_OPERATION; }
+status_t OfflineStreamInHal::stop() { return INVALID_OPERATION; }
+status_t OfflineStreamInHal::createMmapBuffer(int32_t /* minSizeFrames */,
+        struct audio_mmap_buffer_info* /* info */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamInHal::getMmapPosition(struct audio_mmap_position* /* position */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamInHal::setHalThreadPriority(int /* priority */) { return OK; }
+// the stream is routed from any device
+status_t OfflineStreamInHal::legacyCreateAudioPatch(const struct audio_port_config& /* port */,
+        std::optional<audio_source_t> /* source */, audio_devices_t /* type */) {
+    return OK;
+}
+status_t OfflineStreamInHal::legacyReleaseAudioPatch() { return OK; }
+status_t OfflineStreamInHal::setGain(float /* gain */) { return INVALID_OPERATION; }
+status_t OfflineStreamInHal::getActiveMicrophones(
+        std::vector<media::MicrophoneInfoFw>* microphones) {
+    microphones->clear();
+    return OK;
+}
+status_t OfflineStreamInHal::setPreferredMicrophoneDirection(
+        audio_microphone_direction_t /* direction */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamInHal::setPreferredMicrophoneFieldDimension(float /* zoom */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineStreamInHal::updateSinkMetadata(const SinkMetadata& /* sinkMetadata */) {
+    return OK;
+}
+
+OfflineStreamIn::OfflineStreamIn(AudioHwDevice* dev, const sp<OfflineStreamInHal>& halStream)
+    : AudioStreamIn(dev, AUDIO_INPUT_FLAG_NONE) {
+    stream = halStream;
+    (void)halStream->getFrameSize(&mHalFrameSize);
+    mHalFormatHasProportionalFrames = true;
+}
+
+// A device with no port, route, stream or volume of its own.
+status_t OfflineDeviceHal::getAudioPorts(
+        std::vector<media::audio::common::AudioPort>* ports) {
+    ports->clear();
+    return OK;
+}
+status_t OfflineDeviceHal::getAudioRoutes(std::vector<media::AudioRoute>* routes) {
+    routes->clear();
+    return OK;
+}
+status_t OfflineDeviceHal::getSupportedModes(
+        std::vector<media::audio::common::AudioMode>* modes) {
+    modes->clear();
+    return OK;
+}
+status_t OfflineDeviceHal::getSupportedDevices(uint32_t* /* devices */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::initCheck() { return OK; }
+status_t OfflineDeviceHal::setVoiceVolume(float /* volume */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::setMasterVolume(float /* volume */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::getMasterVolume(float* /* volume */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::setMode(audio_mode_t /* mode */) { return OK; }
+status_t OfflineDeviceHal::setMicMute(bool /* state */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::getMicMute(bool* /* state */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::setMasterMute(bool /* state */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::getMasterMute(bool* /* state */) { return INVALID_OPERATION; }
+status_t OfflineDeviceHal::setParameters(const String8& /* kvPairs */) { return OK; }
+status_t OfflineDeviceHal::getParameters(const String8& /* keys */, String8* values) {
+    *values = String8();
+    return OK;
+}
+status_t OfflineDeviceHal::getInputBufferSize(struct audio_config* /* config */,
+        size_t* /* size */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::openOutputStream(audio_io_handle_t /* handle */,
+        audio_devices_t /* deviceType */, audio_output_flags_t /* flags */,
+        struct audio_config* /* config */, const char* /* address */,
+        sp<StreamOutHalInterface>* /* outStream */,
+        const std::vector<playback_track_metadata_v7_t>& /* sourceMetadata */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::openInputStream(audio_io_handle_t /* handle */,
+        audio_devices_t /* devices */, struct audio_config* /* config */,
+        audio_input_flags_t /* flags */, const char* /* address */,
+        audio_source_t /* source */, audio_devices_t /* outputDevice */,
+        const char* /* outputDeviceAddress */, sp<StreamInHalInterface>* /* inStream */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::supportsAudioPatches(bool* supportsPatches) {
+    *supportsPatches = false;
+    return OK;
+}
+status_t OfflineDeviceHal::createAudioPatch(unsigned int /* num_sources */,
+        const struct audio_port_config* /* sources */, unsigned int /* num_sinks */,
+        const struct audio_port_config* /* sinks */, audio_patch_handle_t* /* patch */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::releaseAudioPatch(audio_patch_handle_t /* patch */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::getAudioPort(struct audio_port* /* port */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::getAudioPort(struct audio_port_v7* /* port */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::setAudioPortConfig(const struct audio_port_config* /* config */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::getMicrophones(
+        std::vector<audio_microphone_characteristic_t>* microphones) {
+    microphones->clear();
+    return OK;
+}
+status_t OfflineDeviceHal::addDeviceEffect(const struct audio_port_config* /* device */,
+        sp<EffectHalInterface> /* effect */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::removeDeviceEffect(const struct audio_port_config* /* device */,
+        sp<EffectHalInterface> /* effect */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::getMmapPolicyInfos(
+        media::audio::common::AudioMMapPolicyType /* policyType */,
+        std::vector<media::audio::common::AudioMMapPolicyInfo>* /* policyInfos */) {
+    return INVALID_OPERATION;
+}
+int32_t OfflineDeviceHal::getAAudioMixerBurstCount() { return 0; }
+int32_t OfflineDeviceHal::getAAudioHardwareBurstMinUsec() { return 0; }
+status_t OfflineDeviceHal::supportsBluetoothVariableLatency(bool* supports) {
+    *supports = false;
+    return OK;
+}
+status_t OfflineDeviceHal::setConnectedState(const struct audio_port_v7* /* port */,
+        bool /* connected */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::setSimulateDeviceConnections(bool /* enabled */) {
+    return INVALID_OPERATION;
+}
+error::Result<audio_hw_sync_t> OfflineDeviceHal::getHwAvSync() {
+    return base::unexpected(INVALID_OPERATION);
+}
+status_t OfflineDeviceHal::dump(int /* fd */, const Vector<String16>& /* args */) { return OK; }
+status_t OfflineDeviceHal::getSoundDoseInterface(const std::string& /* module */,
+        ::ndk::SpAIBinder* /* soundDoseBinder */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::prepareToDisconnectExternalDevice(
+        const struct audio_port_v7* /* port */) {
+    return INVALID_OPERATION;
+}
+status_t OfflineDeviceHal::getAudioMixPort(const struct audio_port_v7* /* devicePort */,
+        struct audio_port_v7* /* mixPort */) {
+    return INVALID_OPERATION;
+}
+
+OfflineEffectBufferHal::OfflineEffectBufferHal(size_t size)
+    : mBufferSize(size) {
+    if (posix_memalign(&mAudioBuffer.raw, 32, mBufferSize) != 0) {
+        mAudioBuffer.raw = nullptr;
+    } else {
+        memset(mAudioBuffer.raw, 0, mBufferSize);
+    }
+}
+
+OfflineEffectBufferHal::~OfflineEffectBufferHal() {
+    free(mAudioBuffer.raw);
+}
+
+void OfflineEffectBufferHal::setFrameCount(size_t frameCount) {
+    mAudioBuffer.frameCount = frameCount;
+    mFrameCountChanged = true;
+}
+
+bool OfflineEffectBufferHal::checkFrameCountChange() {
+    const bool result = mFrameCountChanged;
+    mFrameCountChanged = false;
+    return result;
+}
+
+void OfflineEffectBufferHal::copy(void* dst, const void* src, size_t n) const {
+    if (dst == nullptr || src == nullptr) {
+        return;
+    }
+    memcpy(dst, src, std::min(n, mBufferSize));
+}
+
+void OfflineEffectBufferHal::update(size_t size) {
+    copy(mAudioBuffer.raw, mExternalData, size);
+}
+
+void OfflineEffectBufferHal::commit(size_t size) {
+    copy(mExternalData, mAudioBuffer.raw, size);
+}
+
+OfflineEffectHal::OfflineEffectHal(const effect_descriptor_t& descriptor,
+        std::unique_ptr<OfflineEffect> effect)
+    : mDescriptor(descriptor)
+    , mEffect(std::move(effect)) {
+}
+
+status_t OfflineEffectHal::setInBuffer(const sp<EffectBufferHalInterface>& buffer) {
+    mInBuffer = buffer;
+    return OK;
+}
+
+status_t OfflineEffectHal::setOutBuffer(const sp<EffectBufferHalInterface>& buffer) {
+    mOutBuffer = buffer;
+    return OK;
+}
+
+status_t OfflineEffectHal::process() {
+    if (mInBuffer == nullptr || mOutBuffer == nullptr) {
+        return NO_INIT;
+    }
+    const size_t frameCount = mConfig.inputCfg.buffer.frameCount;
+    const uint32_t channelCount = audio_channel_count_from_out_mask(mConfig.inputCfg.channels);
+    const size_t sampleCount = std::min(frameCount * channelCount, mScratch.size());
+    // the input and output buffers are the same for an insert effect other than the last.
+    memcpy(mScratch.data(), mInBuffer->audioBuffer()->f32, sampleCount * sizeof(float));
+    mEffect->process(mScratch.data(), sampleCount / channelCount, channelCount);
+    float* const out = mOutBuffer->audioBuffer()->f32;
+    if (mConfig.outputCfg.accessMode == EFFECT_BUFFER_ACCESS_ACCUMULATE) {
+        accumulate_float(out, mScratch.data(), sampleCount);
+    } else {
+        memcpy(out, mScratch.data(), sampleCount * sizeof(float));
+    }
+    return OK;
+}
+
+status_t OfflineEffectHal::processReverse() {
+    return INVALID_OPERATION;
+}
+
+status_t OfflineEffectHal::command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData,
+        uint32_t* replySize, void* pReplyData) {
+    switch (cmdCode) {
+    case EFFECT_CMD_SET_CONFIG:
+        if (pCmdData == nullptr || cmdSize != sizeof(effect_config_t)) {
+            return BAD_VALUE;
+        }
+        mConfig = *static_cast<const effect_config_t*>(pCmdData);
+        if (mConfig.inputCfg.format != AUDIO_FORMAT_PCM_FLOAT
+                || mConfig.inputCfg.channels != mConfig.outputCfg.channels) {
+            return BAD_VALUE;
+        }
+        mScratch.assign(mConfig.inputCfg.buffer.frameCount
+                * audio_channel_count_from_out_mask(mConfig.inputCfg.channels), 0.f);
+        break;
+    case EFFECT_CMD_INIT:
+    case EFFECT_CMD_ENABLE:
+    case EFFECT_CMD_DISABLE:
+    case EFFECT_CMD_RESET:
+        break;
+    default:
+        ALOGV("%s: ignored command %u", __func__, cmdCode);
+        break;
+    }
+    // the reply of these commands is a status, if any.
+    if (replySize != nullptr && pReplyData != nullptr && *replySize >= sizeof(int32_t)) {
+        *static_cast<int32_t*>(pReplyData) = 0;
+        *replySize = sizeof(int32_t);
+    }
+    return OK;
+}
+
+status_t OfflineEffectHal::getDescriptor(effect_descriptor_t* pDescriptor) {
+    *pDescriptor = mDescriptor;
+    return OK;
+}
+
+status_t OfflineEffectHal::close() {
+    return OK;
+}
+
+status_t OfflineEffectHal::dump(int /* fd */) {
+    return OK;
+}
+
+status_t OfflineEffectHal::setDevices(const AudioDeviceTypeAddrVector& /* deviceTypes */) {
+    return OK;
+}
+
+// The type of all offline effects, not one of the types known to AudioFlinger.
+static constexpr effect_uuid_t kOfflineEffectType =
+        {0x3e1a6f52, 0x8b0c, 0x4d4e, 0x9a51, {0x6f, 0x66, 0x66, 0x6c, 0x69, 0x6e}};
+
+effect_descriptor_t OfflineEffectsFactoryHal::add(std::unique_ptr<OfflineEffect> effect) {
+    std::lock_guard l(mLock);
+    effect_descriptor_t descriptor{};
+    descriptor.type = kOfflineEffectType;
+    descriptor.uuid = kOfflineEffectType;
+    descriptor.uuid.timeLow = mNextId++;
+    descriptor.apiVersion = EFFECT_CONTROL_API_VERSION;
+    // in the order added to the chain.
+    descriptor.flags = EFFECT_FLAG_TYPE_INSERT | EFFECT_FLAG_INSERT_FIRST;
+    strlcpy(descriptor.name, "Offline effect", sizeof(descriptor.name));
+    strlcpy(descriptor.implementor, "The Android Open Source Project",
+            sizeof(descriptor.implementor));
+    mPending[descriptor.uuid.timeLow] = {descriptor, std::move(effect)};
+    return descriptor;
+}
+
+status_t OfflineEffectsFactoryHal::createEffect(const effect_uuid_t* pEffectUuid,
+        int32_t /* sessionId */, int32_t /* ioId */, int32_t /* deviceId */,
+        sp<EffectHalInterface>* effect) {
+    std::lock_guard l(mLock);
+    const auto it = mPending.find(pEffectUuid->timeLow);
+    if (it == mPending.end() || it->second.effect == nullptr) {
+        return NAME_NOT_FOUND;
+    }
+    *effect = sp<OfflineEffectHal>::make(it->second.descriptor, std::move(it->second.effect));
+    mPending.erase(it);
+    return OK;
+}
+
+status_t OfflineEffectsFactoryHal::getDescriptor(const effect_uuid_t* pEffectUuid,
+        effect_descriptor_t* pDescriptor) {
+    std::lock_guard l(mLock);
+    const auto it = mPending.find(pEffectUuid->timeLow);
+    if (it == mPending.end()) {
+        return NAME_NOT_FOUND;
+    }
+    *pDescriptor = it->second.descriptor;
+    return OK;
+}
+
+status_t OfflineEffectsFactoryHal::allocateBuffer(size_t size,
+        sp<EffectBufferHalInterface>* buffer) {
+    return mirrorBuffer(nullptr, size, buffer);
+}
+
+status_t OfflineEffectsFactoryHal::mirrorBuffer(void* external, size_t size,
+        sp<EffectBufferHalInterface>* buffer) {
+    const auto result = sp<OfflineEffectBufferHal>::make(size);
+    if (result->audioBuffer()->raw == nullptr) {
+        return NO_MEMORY;
+    }
+    result->setExternalData(external);
+    *buffer = result;
+    return OK;
+}
+
+// Only the effects added by the OfflineThreadMixer exist: none is listed.
+status_t OfflineEffectsFactoryHal::queryNumberEffects(uint32_t* pNumEffects) {
+    *pNumEffects = 0;
+    return OK;
+}
+
+status_t OfflineEffectsFactoryHal::getDescriptor(uint32_t /* index */,
+        effect_descriptor_t* /* pDescriptor */) {
+    return INVALID_OPERATION;
+}
+
+status_t OfflineEffectsFactoryHal::getDescriptors(const effect_uuid_t* /* pEffectType */,
+        std::vector<effect_descriptor_t>* descriptors) {
+    descriptors->clear();
+    return OK;
+}
+
+std::shared_ptr<const effectsConfig::Processings>
+OfflineEffectsFactoryHal::getProcessings() const {
+    return nullptr;
+}
+
+error::Result<size_t> OfflineEffectsFactoryHal::getSkippedElements() const {
+    return 0;
+}
+
+status_t OfflineEffectsFactoryHal::dumpEffects(int /* fd */) {
+    return OK;
+}
+
+android::detail::AudioHalVersionInfo OfflineEffectsFactoryHal::getHalVersion() const {
+    return android::detail::AudioHalVersionInfo(
+            android::detail::AudioHalVersionInfo::Type::AIDL, 1 /* major */);
+}
+
+} // namespace android::audioflinger
@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <datapath/AudioHwDevice.h>
+#include <datapath/AudioStreamIn.h>
+#include <datapath/AudioStreamOut.h>
+#include <media/audiohal/DeviceHalInterface.h>
+#include <media/audiohal/EffectsFactoryHalInterface.h>
+#include <media/audiohal/StreamHalInterface.h>
+#include <system/audio.h>
+#include <system/audio_effect.h>
+
+namespace android::audioflinger {
+
+class OfflineEffect;
+
+/**
+ * OfflineStreamOutHal
+ *
+ * The HAL output stream of an OfflineThreadMixer. write() keeps the period and blocks the
+ * MixerThread until the harness calls release(), so that the harness runs its commands
+ * and the client writes while the thread is parked in write(), as a HAL blocks until
+ * there is room in its buffer.
+ * The presentation position is the frames of the released writes.
+ */
+class OfflineStreamOutHal : public StreamOutHalInterface {
+public:
+    OfflineStreamOutHal(const audio_config_base_t& config, size_t frameCount);
+
+    /**
+     * Waits for the thread to write the next period.
+     * \return the period, valid until release().
+     */
+    const void* waitForWrite();
+    // Lets the pending write() return.
+    void release();
+    // Waits until the released writes reach frames, or until exit().
+    void waitForPresentedFrames(uint64_t frames);
+
+    // StreamHalInterface
+    status_t getBufferSize(size_t* size) override;
+    status_t getAudioProperties(audio_config_base_t* configBase) override;
+    status_t setParameters(const String8& kvPairs) override;
+    status_t getParameters(const String8& keys, String8* values) override;
+    status_t getFrameSize(size_t* size) override;
+    status_t addEffect(sp<EffectHalInterface> effect) override;
+    status_t removeEffect(sp<EffectHalInterface> effect) override;
+    status_t standby() override;
+    status_t dump(int fd, const Vector<String16>& args) override;
+    status_t start() override;
+    status_t stop() override;
+    status_t createMmapBuffer(int32_t minSizeFrames, struct audio_mmap_buffer_info* info) override;
+    status_t getMmapPosition(struct audio_mmap_position* position) override;
+    status_t setHalThreadPriority(int priority) override;
+    status_t legacyCreateAudioPatch(const struct audio_port_config& port,
+            std::optional<audio_source_t> source, audio_devices_t type) override;
+    status_t legacyReleaseAudioPatch() override;
+
+    // StreamOutHalInterface
+    status_t getLatency(uint32_t* latency) override;
+    status_t setVolume(float left, float right) override;
+    status_t selectPresentation(int presentationId, int programId) override;
+    status_t write(const void* buffer, size_t bytes, size_t* written) override;
+    status_t getRenderPosition(uint64_t* dspFrames) override;
+    status_t setCallback(wp<StreamOutHalInterfaceCallback> callback) override;
+    status_t supportsPauseAndResume(bool* supportsPause, bool* supportsResume) override;
+    status_t pause() override;
+    status_t resume() override;
+    status_t supportsDrain(bool* supportsDrain) override;
+    status_t drain(bool earlyNotify) override;
+    status_t flush() override;
+    status_t getPresentationPosition(uint64_t* frames, struct timespec* timestamp) override;
+    status_t presentationComplete() override;
+    status_t updateSourceMetadata(const SourceMetadata& sourceMetadata) override;
+    status_t getDualMonoMode(audio_dual_mono_mode_t* mode) override;
+    status_t setDualMonoMode(audio_dual_mono_mode_t mode) override;
+    status_t getAudioDescriptionMixLevel(float* leveldB) override;
+    status_t setAudioDescriptionMixLevel(float leveldB) override;
+    status_t getPlaybackRateParameters(audio_playback_rate_t* playbackRate) override;
+    status_t setPlaybackRateParameters(const audio_playback_rate_t& playbackRate) override;
+    status_t setEventCallback(const sp<StreamOutHalInterfaceEventCallback>& callback) override;
+    status_t setLatencyMode(audio_latency_mode_t mode) override;
+    status_t getRecommendedLatencyModes(std::vector<audio_latency_mode_t>* modes) override;
+    status_t setLatencyModeCallback(
+            const sp<StreamOutHalInterfaceLatencyModeCallback>& callback) override;
+    // Unblocks write(), which then returns immediately.
+    status_t exit() override;
+
+private:
+    const audio_config_base_t mConfig;
+    const size_t mFrameCount;
+    const size_t mFrameSize;
+
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::vector<uint8_t> mBuffer;   // the pending write
+    bool mWriting = false;          // the thread waits in write() for release()
+    bool mExiting = false;
+    uint64_t mPresentedFrames = 0;
+};
+
+// The AudioStreamOut of a MixerThread on an OfflineStreamOutHal.
+class OfflineStreamOut : public AudioStreamOut {
+public:
+    OfflineStreamOut(AudioHwDevice* dev, const sp<OfflineStreamOutHal>& halStream);
+};
+
+/**
+ * OfflineStreamInHal
+ *
+ * The HAL input stream of a software patch: it captures a period whenever the output stream
+ * is about to render one, so read() blocks until the clock stream has released the writes
+ * of the previous periods. The input is silence but for one marker frame.
+ * The capture position is the frames read plus latencyFrames, the frames the HAL would hold.
+ */
+class OfflineStreamInHal : public StreamInHalInterface {
+public:
+    OfflineStreamInHal(const audio_config_base_t& config, size_t frameCount,
+            const sp<OfflineStreamOutHal>& clock, uint64_t markerFrame, uint32_t latencyFrames);
+
+    // StreamHalInterface
+    status_t getBufferSize(size_t* size) override;
+    status_t getAudioProperties(audio_config_base_t* configBase) override;
+    status_t setParameters(const String8& kvPairs) override;
+    status_t getParameters(const String8& keys, String8* values) override;
+    status_t getFrameSize(size_t* size) override;
+    status_t addEffect(sp<EffectHalInterface> effect) override;
+    status_t removeEffect(sp<EffectHalInterface> effect) override;
+    status_t standby() override;
+    status_t dump(int fd, const Vector<String16>& args) override;
+    status_t start() override;
+    status_t stop() override;
+    status_t createMmapBuffer(int32_t minSizeFrames, struct audio_mmap_buffer_info* info) override;
+    status_t getMmapPosition(struct audio_mmap_position* position) override;
+    status_t setHalThreadPriority(int priority) override;
+    status_t legacyCreateAudioPatch(const struct audio_port_config& port,
+            std::optional<audio_source_t> source, audio_devices_t type) override;
+    status_t legacyReleaseAudioPatch() override;
+
+    // StreamInHalInterface
+    status_t setGain(float gain) override;
+    status_t read(void* buffer, size_t bytes, size_t* read) override;
+    status_t getInputFramesLost(uint32_t* framesLost) override;
+    status_t getCapturePosition(int64_t* frames, int64_t* time) override;
+    status_t getActiveMicrophones(std::vector<media::MicrophoneInfoFw>* microphones) override;
+    status_t setPreferredMicrophoneDirection(audio_microphone_direction_t direction) override;
+    status_t setPreferredMicrophoneFieldDimension(float zoom) override;
+    status_t updateSinkMetadata(const SinkMetadata& sinkMetadata) override;
+
+    static constexpr float kMarkerValue = 0.5f;
+
+private:
+    const audio_config_base_t mConfig;
+    const size_t mFrameCount;
+    const uint32_t mChannelCount;
+    const size_t mFrameSize;
+    const sp<OfflineStreamOutHal> mClock;
+    const uint64_t mMarkerFrame;
+    const uint32_t mLatencyFrames;
+
+    std::mutex mLock;
+    uint64_t mFramesRead = 0;
+    std::vector<float> mScratch;    // the period before conversion to the stream format
+};
+
+// The AudioStreamIn of a RecordThread on an OfflineStreamInHal.
+class OfflineStreamIn : public AudioStreamIn {
+public:
+    OfflineStreamIn(AudioHwDevice* dev, const sp<OfflineStreamInHal>& halStream);
+};
+
+/**
+ * OfflineDeviceHal
+ *
+ * The HAL device of the modules of an OfflinePatch. It does not support audio patches,
+ * so that the threads route their streams with legacyCreateAudioPatch(), and opens no stream:
+ * the streams are created by the OfflinePatch.
+ */
+class OfflineDeviceHal : public DeviceHalInterface {
+public:
+    status_t getAudioPorts(std::vector<media::audio::common::AudioPort>* ports) override;
+    status_t getAudioRoutes(std::vector<media::AudioRoute>* routes) override;
+    status_t getSupportedModes(std::vector<media::audio::common::AudioMode>* modes) override;
+    status_t getSupportedDevices(uint32_t* devices) override;
+    status_t initCheck() override;
+    status_t setVoiceVolume(float volume) override;
+    status_t setMasterVolume(float volume) override;
+    status_t getMasterVolume(float* volume) override;
+    status_t setMode(audio_mode_t mode) override;
+    status_t setMicMute(bool state) override;
+    status_t getMicMute(bool* state) override;
+    status_t setMasterMute(bool state) override;
+    status_t getMasterMute(bool* state) override;
+    status_t setParameters(const String8& kvPairs) override;
+    status_t getParameters(const String8& keys, String8* values) override;
+    status_t getInputBufferSize(struct audio_config* config, size_t* size) override;
+    status_t openOutputStream(audio_io_handle_t handle, audio_devices_t deviceType,
+            audio_output_flags_t flags, struct audio_config* config, const char* address,
+            sp<StreamOutHalInterface>* outStream,
+            const std::vector<playback_track_metadata_v7_t>& sourceMetadata) override;
+    status_t openInputStream(audio_io_handle_t handle, audio_devices_t devices,
+            struct audio_config* config, audio_input_flags_t flags, const char* address,
+            audio_source_t source, audio_devices_t outputDevice,
+            const char* outputDeviceAddress, sp<StreamInHalInterface>* inStream) override;
+    status_t supportsAudioPatches(bool* supportsPatches) override;
+    status_t createAudioPatch(unsigned int num_sources, const struct audio_port_config* sources,
+            unsigned int num_sinks, const struct audio_port_config* sinks,
+            audio_patch_handle_t* patch) override;
+    status_t releaseAudioPatch(audio_patch_handle_t patch) override;
+    status_t getAudioPort(struct audio_port* port) override;
+    status_t getAudioPort(struct audio_port_v7* port) override;
+    status_t setAudioPortConfig(const struct audio_port_config* config) override;
+    status_t getMicrophones(std::vector<audio_microphone_characteristic_t>* microphones) override;
+    status_t addDeviceEffect(
+            const struct audio_port_config* device, sp<EffectHalInterface> effect) override;
+    status_t removeDeviceEffect(
+            const struct audio_port_config* device, sp<EffectHalInterface> effect) override;
+    status_t getMmapPolicyInfos(media::audio::common::AudioMMapPolicyType policyType,
+            std::vector<media::audio::common::AudioMMapPolicyInfo>* policyInfos) override;
+    int32_t getAAudioMixerBurstCount() override;
+    int32_t getAAudioHardwareBurstMinUsec() override;
+    status_t supportsBluetoothVariableLatency(bool* supports) override;
+    status_t setConnectedState(const struct audio_port_v7* port, bool connected) override;
+    status_t setSimulateDeviceConnections(bool enabled) override;
+    error::Result<audio_hw_sync_t> getHwAvSync() override;
+    status_t dump(int fd, const Vector<String16>& args) override;
+    status_t getSoundDoseInterface(const std::string& module,
+            ::ndk::SpAIBinder* soundDoseBinder) override;
+    status_t prepareToDisconnectExternalDevice(const struct audio_port_v7* port) override;
+    status_t getAudioMixPort(const struct audio_port_v7* devicePort,
+            struct audio_port_v7* mixPort) override;
+};
+
+// An effect buffer in local memory, see EffectBufferHalAidl.
+class OfflineEffectBufferHal : public EffectBufferHalInterface {
+public:
+    explicit OfflineEffectBufferHal(size_t size);
+    ~OfflineEffectBufferHal() override;
+
+    audio_buffer_t* audioBuffer() override { return &mAudioBuffer; }
+    void* externalData() const override { return mExternalData; }
+    size_t getSize() const override { return mBufferSize; }
+    void setExternalData(void* external) override { mExternalData = external; }
+    void setFrameCount(size_t frameCount) override;
+    bool checkFrameCountChange() override;
+    void update() override { update(mBufferSize); }
+    void commit() override { commit(mBufferSize); }
+    void update(size_t size) override;
+    void commit(size_t size) override;
+
+private:
+    void copy(void* dst, const void* src, size_t n) const;
+
+    const size_t mBufferSize;
+    bool mFrameCountChanged = false;
+    void* mExternalData = nullptr;
+    audio_buffer_t mAudioBuffer{};
+};
+
+/**
+ * OfflineEffectHal
+ *
+ * Runs an OfflineEffect as an insert effect: process() processes a copy of the input
+ * buffer, then writes or accumulates it into the output buffer, per the configured
+ * output access mode.
+ */
+class OfflineEffectHal : public EffectHalInterface {
+public:
+    OfflineEffectHal(const effect_descriptor_t& descriptor,
+            std::unique_ptr<OfflineEffect> effect);
+
+    status_t setInBuffer(const sp<EffectBufferHalInterface>& buffer) override;
+    status_t setOutBuffer(const sp<EffectBufferHalInterface>& buffer) override;
+    status_t process() override;
+    status_t processReverse() override;
+    status_t command(uint32_t cmdCode, uint32_t cmdSize, void* pCmdData,
+            uint32_t* replySize, void* pReplyData) override;
+    status_t getDescriptor(effect_descriptor_t* pDescriptor) override;
+    status_t close() override;
+    status_t dump(int fd) override;
+    status_t setDevices(const AudioDeviceTypeAddrVector& deviceTypes) override;
+
+private:
+    const effect_descriptor_t mDescriptor;
+    const std::unique_ptr<OfflineEffect> mEffect;
+    sp<EffectBufferHalInterface> mInBuffer;
+    sp<EffectBufferHalInterface> mOutBuffer;
+    effect_config_t mConfig{};
+    std::vector<float> mScratch;
+};
+
+/**
+ * OfflineEffectsFactoryHal
+ *
+ * Creates the OfflineEffectHal of the effects added to an OfflineThreadMixer: add() gives the
+ * effect a descriptor with a unique uuid, which createEffect() then looks up.
+ */
+class OfflineEffectsFactoryHal : public EffectsFactoryHalInterface {
+public:
+    // Returns the descriptor to pass to the thread for the effect.
+    effect_descriptor_t add(std::unique_ptr<OfflineEffect> effect);
+
+    status_t queryNumberEffects(uint32_t* pNumEffects) override;
+    status_t getDescriptor(uint32_t index, effect_descriptor_t* pDescriptor) override;
+    status_t getDescriptor(const effect_uuid_t* pEffectUuid,
+            effect_descriptor_t* pDescriptor) override;
+    status_t getDescriptors(const effect_uuid_t* pEffectType,
+            std::vector<effect_descriptor_t>* descriptors) override;
+    std::shared_ptr<const effectsConfig::Processings> getProcessings() const override;
+    error::Result<size_t> getSkippedElements() const override;
+    status_t createEffect(const effect_uuid_t* pEffectUuid, int32_t sessionId, int32_t ioId,
+            int32_t deviceId, sp<EffectHalInterface>* effect) override;
+    status_t dumpEffects(int fd) override;
+    status_t allocateBuffer(size_t size, sp<EffectBufferHalInterface>* buffer) override;
+    status_t mirrorBuffer(void* external, size_t size,
+            sp<EffectBufferHalInterface>* buffer) override;
+    android::detail::AudioHalVersionInfo getHalVersion() const override;
+
+private:
+    struct Pending {
+        effect_descriptor_t descriptor;
+        std::unique_ptr<OfflineEffect> effect;
+    };
+
+    std::mutex mLock;
+    std::map<uint32_t, Pending> mPending;   // by uuid timeLow
+    uint32_t mNextId = 1;
+};
+
+} // namespace android::audioflinger
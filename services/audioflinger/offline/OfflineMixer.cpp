@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflineMixer"
+
+#include "OfflineMixer.h"
+
+#include <cmath>
+
+#include <utils/Log.h>
+
+namespace android::audioflinger {
+
+void GainEffect::process(float* buffer, size_t frameCount, uint32_t channelCount) {
+    const size_t samples = frameCount * channelCount;
+    for (size_t i = 0; i < samples; ++i) {
+        buffer[i] *= mGain;
+    }
+}
+
+LowPassEffect::LowPassEffect(float cutoffHz, uint32_t sampleRate)
+    : mAlpha(1.f - expf(-2.f * (float)M_PI * cutoffHz / sampleRate)) {
+}
+
+void LowPassEffect::process(float* buffer, size_t frameCount, uint32_t channelCount) {
+    if (mState.size() != channelCount) {
+        mState.assign(channelCount, 0.f);
+    }
+    for (size_t i = 0; i < frameCount; ++i) {
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            float& state = mState[c];
+            state += mAlpha * (buffer[c] - state);
+            buffer[c] = state;
+        }
+        buffer += channelCount;
+    }
+}
+
+OfflineMixer::OfflineMixer(const Config& config, SinkCallback sink)
+    : mConfig(config)
+    , mSink(std::move(sink))
+    , mChannelCount(audio_channel_count_from_out_mask(config.channelMask))
+    , mSinkFrameSize(audio_bytes_per_frame(mChannelCount, config.sinkFormat)) {
+    LOG_ALWAYS_FATAL_IF(!audio_is_linear_pcm(config.sinkFormat),
+            "%s: invalid sink format %#x", __func__, config.sinkFormat);
+}
+
+const char* OfflineMixer::trackStateToString(TrackState state) {
+    switch (state) {
+        case IDLE: return "IDLE";
+        case ACTIVE: return "ACTIVE";
+        case PAUSING: return "PAUSING";
+        case PAUSED: return "PAUSED";
+        case RESUMING: return "RESUMING";
+        case STOPPED: return "STOPPED";
+        default: return "UNKNOWN";
+    }
+}
+
+} // namespace android::audioflinger
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <system/audio.h>
+#include <timing/PeriodTracer.h>
+#include <utils/Errors.h>
+
+namespace android::audioflinger {
+
+/**
+ * OfflineEffect
+ *
+ * An effect of a session effect chain. process() runs in place on the session buffer,
+ * or on a copy of the effect input for an OfflineThreadMixer, which holds frameCount
+ * frames of channelCount float samples.
+ */
+class OfflineEffect {
+public:
+    virtual ~OfflineEffect() = default;
+    virtual void process(float* buffer, size_t frameCount, uint32_t channelCount) = 0;
+};
+
+// Multiplies the samples by a constant gain.
+class GainEffect : public OfflineEffect {
+public:
+    explicit GainEffect(float gain) : mGain(gain) {}
+    void process(float* buffer, size_t frameCount, uint32_t channelCount) override;
+
+private:
+    const float mGain;
+};
+
+// A one-pole low pass filter per channel.
+class LowPassEffect : public OfflineEffect {
+public:
+    LowPassEffect(float cutoffHz, uint32_t sampleRate);
+    void process(float* buffer, size_t frameCount, uint32_t channelCount) override;
+
+private:
+    const float mAlpha;
+    std::vector<float> mState;
+};
+
+/**
+ * OfflineMixer
+ *
+ * The period of a MixerThread without an audio HAL, binder or AudioFlinger, run one period
+ * at a time on tracks fed by simulated clients, which write a synthetic signal into each
+ * track buffer every period. There are two engines:
+ *  - OfflineThreadMixer runs the MixerThread of AudioFlinger itself: device only;
+ *  - OfflineBaseMixer follows MixerThread::prepareTracks_l() on top of AudioMixerBase:
+ *    host and device, for the mixer CPU cost on a build machine.
+ *
+ * Every stage of a period is recorded in the PeriodTracer. Given the same calls, the output
+ * of an engine is bit exact from run to run, so it can be compared against a reference file.
+ * Methods are not thread safe.
+ */
+class OfflineMixer {
+public:
+    struct Config {
+        uint32_t sampleRate = 48000;
+        audio_channel_mask_t channelMask = AUDIO_CHANNEL_OUT_STEREO;
+        audio_format_t sinkFormat = AUDIO_FORMAT_PCM_16_BIT;
+        size_t frameCount = 960;        // mix period, a multiple of 16 for OfflineThreadMixer
+        float masterVolume = 1.f;
+    };
+
+    enum Signal {
+        SIGNAL_SINE,    // at frequencyHz, with a different phase per channel
+        SIGNAL_CHIRP,   // from 20 Hz to half the sample rate, repeated every second
+        SIGNAL_NOISE,   // white noise from a fixed seed
+    };
+
+    struct TrackConfig {
+        audio_channel_mask_t channelMask = AUDIO_CHANNEL_OUT_STEREO;
+        audio_format_t format = AUDIO_FORMAT_PCM_16_BIT;
+        uint32_t sampleRate = 48000;
+        audio_session_t sessionId = AUDIO_SESSION_OUTPUT_MIX;
+        Signal signal = SIGNAL_SINE;
+        float frequencyHz = 1000.f;
+        float amplitude = 0.5f;
+        size_t bufferFrames = 0;        // track buffer, 0 for 2 mix periods at the track rate
+        size_t writeFrames = 0;         // written by the client each period, 0 for one period
+    };
+
+    // Track states, as in IAfTrackBase.
+    enum TrackState {
+        IDLE,
+        ACTIVE,
+        PAUSING,
+        PAUSED,
+        RESUMING,
+        STOPPED,
+    };
+
+    struct TrackStats {
+        TrackState state = IDLE;
+        bool active = false;            // in the active tracks of the mixer
+        bool disabled = false;          // removed on underrun, needs a new start()
+        int64_t framesWritten = 0;      // by the client
+        int64_t framesReleased = 0;     // consumed by the mixer
+        int64_t underrunFrames = 0;
+    };
+
+    // Receives each period in the sink format.
+    using SinkCallback = std::function<void(const void* buffer, size_t frameCount)>;
+
+    virtual ~OfflineMixer() = default;
+
+    const Config& config() const { return mConfig; }
+    uint32_t channelCount() const { return mChannelCount; }
+    size_t sinkFrameSize() const { return mSinkFrameSize; }
+
+    // Track commands, applied at the next period. They return BAD_VALUE for an
+    // unknown id and INVALID_OPERATION in a state where the client call would fail.
+    virtual status_t addTrack(int id, const TrackConfig& config) = 0;
+    virtual status_t removeTrack(int id) = 0;
+    virtual status_t start(int id) = 0;
+    virtual status_t pause(int id) = 0;
+    virtual status_t stop(int id) = 0;
+    virtual status_t setVolume(int id, float left, float right) = 0;
+    // The client writes nothing for the next periods periods.
+    virtual status_t starve(int id, uint32_t periods) = 0;
+
+    // Adds an effect at the end of the chain of sessionId, creating the chain.
+    virtual status_t addEffect(audio_session_t sessionId,
+            std::unique_ptr<OfflineEffect> effect) = 0;
+    virtual void setMasterVolume(float volume) = 0;
+
+    /**
+     * Runs one period: client writes, then prepare, mix, effects and write.
+     * \return true if a track is still active, false if the next period is silence.
+     */
+    virtual bool processPeriod() = 0;
+
+    uint64_t periods() const { return mPeriods; }
+    // The client tracks in the active tracks of the mixer.
+    virtual size_t activeTracks() const = 0;
+    virtual status_t getTrackStats(int id, TrackStats* stats) const = 0;
+    virtual const PeriodTracer& periodTracer() const = 0;
+
+    static const char* trackStateToString(TrackState state);
+
+protected:
+    OfflineMixer(const Config& config, SinkCallback sink);
+
+    Config mConfig;
+    const SinkCallback mSink;
+    const uint32_t mChannelCount;
+    const size_t mSinkFrameSize;
+    uint64_t mPeriods = 0;
+};
+
+} // namespace android::audioflinger
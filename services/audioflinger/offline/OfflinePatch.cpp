@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflinePatch"
+
+#include "OfflinePatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+
+#include <IAfPatchPanel.h>
+#include <IAfThread.h>
+#include <datapath/AudioHwDevice.h>
+#include <utils/Log.h>
+
+#include "OfflineHal.h"
+#include "OfflineThreadCallback.h"
+
+namespace android::audioflinger {
+
+/**
+ * OfflinePatchCallback
+ *
+ * The AudioFlinger of the PatchPanel of an OfflinePatch: it has a source and a sink module,
+ * and opens the threads of the patch on offline streams. The threads share the
+ * AudioFlinger_Mutex of the OfflineThreadCallback.
+ */
+class OfflinePatchCallback : public IAfPatchPanelCallback {
+public:
+    OfflinePatchCallback(const sp<OfflineThreadCallback>& threadCallback,
+            const OfflinePatch::Config& config);
+
+    audio_module_handle_t sourceModule() const { return mSourceModule; }
+    audio_module_handle_t sinkModule() const { return mSinkModule; }
+    // The output stream of the patch, or of the output it reuses.
+    const sp<OfflineStreamOutHal>& outHal() const { return mOutHal; }
+
+    // Unblocks the writes of the outputs, and so the reads of the inputs.
+    void exitStreams();
+
+    // IAfPatchPanelCallback
+    void closeThreadInternal_l(const sp<IAfPlaybackThread>& thread) final REQUIRES(mutex());
+    void closeThreadInternal_l(const sp<IAfRecordThread>& thread) final REQUIRES(mutex());
+    // there is no primary output to follow the patches of
+    IAfPlaybackThread* primaryPlaybackThread_l() const final REQUIRES(mutex()) {
+        return nullptr;
+    }
+    IAfPlaybackThread* checkPlaybackThread_l(audio_io_handle_t output) const final
+            REQUIRES(mutex());
+    IAfRecordThread* checkRecordThread_l(audio_io_handle_t input) const final REQUIRES(mutex());
+    IAfMmapThread* checkMmapThread_l(audio_io_handle_t /* io */) const final REQUIRES(mutex()) {
+        return nullptr;
+    }
+    sp<IAfThreadBase> openInput_l(audio_module_handle_t module,
+            audio_io_handle_t* input,
+            audio_config_t* config,
+            audio_devices_t device,
+            const char* address,
+            audio_source_t source,
+            audio_input_flags_t flags,
+            audio_devices_t outputDevice,
+            const String8& outputDeviceAddress) final REQUIRES(mutex());
+    sp<IAfThreadBase> openOutput_l(audio_module_handle_t module,
+            audio_io_handle_t* output,
+            audio_config_t* halConfig,
+            audio_config_base_t* mixerConfig,
+            audio_devices_t deviceType,
+            const String8& address,
+            audio_output_flags_t* flags,
+            audio_attributes_t attributes) final REQUIRES(mutex());
+    audio_utils::mutex& mutex() const final
+            RETURN_CAPABILITY(audio_utils::AudioFlinger_Mutex) {
+        return mThreadCallback->mutex();
+    }
+    const DefaultKeyedVector<audio_module_handle_t, AudioHwDevice*>&
+            getAudioHwDevs_l() const final REQUIRES(mutex()) { return mAudioHwDevs; }
+    audio_unique_id_t nextUniqueId(audio_unique_id_use_t use) final {
+        return mThreadCallback->nextUniqueId(use);
+    }
+    const sp<PatchCommandThread>& getPatchCommandThread() final {
+        return mThreadCallback->getPatchCommandThread();
+    }
+    // no module is inserted, and the record threads have no output device to follow
+    void updateDownStreamPatches_l(const struct audio_patch* /* patch */,
+            const std::set<audio_io_handle_t>& /* streams */) final REQUIRES(mutex()) {}
+    void updateOutDevicesForRecordThreads_l(const DeviceDescriptorBaseVector& /* devices */)
+            final REQUIRES(mutex()) {}
+
+private:
+    AudioHwDevice* addModule(const char* moduleName);
+
+    const sp<OfflineThreadCallback> mThreadCallback;
+    const OfflinePatch::Config mConfig;
+    std::vector<std::unique_ptr<AudioHwDevice>> mModules;
+    DefaultKeyedVector<audio_module_handle_t, AudioHwDevice*> mAudioHwDevs;
+    const audio_module_handle_t mSourceModule;
+    const audio_module_handle_t mSinkModule;
+    std::map<audio_io_handle_t, sp<IAfPlaybackThread>> mPlaybackThreads;
+    std::map<audio_io_handle_t, sp<IAfRecordThread>> mRecordThreads;
+    sp<OfflineStreamOutHal> mOutHal;
+};
+
+OfflinePatchCallback::OfflinePatchCallback(const sp<OfflineThreadCallback>& threadCallback,
+        const OfflinePatch::Config& config)
+    : mThreadCallback(threadCallback)
+    , mConfig(config)
+    // the modules differ, so that the PatchPanel bridges them in software.
+    , mSourceModule(addModule("offline_source")->handle())
+    , mSinkModule(addModule("offline_sink")->handle()) {
+}
+
+AudioHwDevice* OfflinePatchCallback::addModule(const char* moduleName) {
+    auto& module = mModules.emplace_back(std::make_unique<AudioHwDevice>(
+            mThreadCallback->nextUniqueId(AUDIO_UNIQUE_ID_USE_MODULE), moduleName,
+            sp<OfflineDeviceHal>::make(), AudioHwDevice::Flags(0)));
+    mAudioHwDevs.add(module->handle(), module.get());
+    return module.get();
+}
+
+void OfflinePatchCallback::exitStreams() {
+    if (mOutHal != nullptr) {
+        (void)mOutHal->exit();
+    }
+}
+
+// as AudioFlinger::closeThreadInternal_l()
+void OfflinePatchCallback::closeThreadInternal_l(const sp<IAfPlaybackThread>& thread) {
+    mPlaybackThreads.erase(thread->id());
+    thread->exit();
+    delete thread->clearOutput();
+}
+
+void OfflinePatchCallback::closeThreadInternal_l(const sp<IAfRecordThread>& thread) {
+    mRecordThreads.erase(thread->id());
+    thread->exit();
+    delete thread->clearInput();
+}
+
+IAfPlaybackThread* OfflinePatchCallback::checkPlaybackThread_l(audio_io_handle_t output) const {
+    const auto it = mPlaybackThreads.find(output);
+    return it != mPlaybackThreads.end() ? it->second.get() : nullptr;
+}
+
+IAfRecordThread* OfflinePatchCallback::checkRecordThread_l(audio_io_handle_t input) const {
+    const auto it = mRecordThreads.find(input);
+    return it != mRecordThreads.end() ? it->second.get() : nullptr;
+}
+
+// The streams open at the configuration of the patch, whatever the request.
+sp<IAfThreadBase> OfflinePatchCallback::openOutput_l(audio_module_handle_t module,
+        audio_io_handle_t* output,
+        audio_config_t* halConfig,
+        audio_config_base_t* /* mixerConfig */,
+        audio_devices_t /* deviceType */,
+        const String8& /* address */,
+        audio_output_flags_t* flags,
+        audio_attributes_t /* attributes */) {
+    const ssize_t index = mAudioHwDevs.indexOfKey(module);
+    if (index < 0) {
+        ALOGW("%s: unknown module %d", __func__, module);
+        return nullptr;
+    }
+    halConfig->sample_rate = mConfig.sampleRate;
+    halConfig->channel_mask = mConfig.channelMask;
+    halConfig->format = AUDIO_FORMAT_PCM_FLOAT;
+    mOutHal = sp<OfflineStreamOutHal>::make(audio_config_base_t{
+            .sample_rate = halConfig->sample_rate,
+            .channel_mask = halConfig->channel_mask,
+            .format = halConfig->format}, mConfig.frameCount);
+    auto* const out = new OfflineStreamOut(mAudioHwDevs.valueAt(index), mOutHal);
+    *flags = out->flags;
+    *output = nextUniqueId(AUDIO_UNIQUE_ID_USE_OUTPUT);
+    const sp<IAfPlaybackThread> thread = IAfPlaybackThread::createMixerThread(
+            mThreadCallback, out, *output, false /* systemReady */);
+    mPlaybackThreads.emplace(*output, thread);
+    return thread;
+}
+
+sp<IAfThreadBase> OfflinePatchCallback::openInput_l(audio_module_handle_t module,
+        audio_io_handle_t* input,
+        audio_config_t* config,
+        audio_devices_t /* device */,
+        const char* /* address */,
+        audio_source_t /* source */,
+        audio_input_flags_t /* flags */,
+        audio_devices_t /* outputDevice */,
+        const String8& /* outputDeviceAddress */) {
+    const ssize_t index = mAudioHwDevs.indexOfKey(module);
+    if (index < 0) {
+        ALOGW("%s: unknown module %d", __func__, module);
+        return nullptr;
+    }
+    // the PatchPanel opens the output first: it is the clock of the input.
+    LOG_ALWAYS_FATAL_IF(mOutHal == nullptr, "%s: no output is open", __func__);
+    config->sample_rate = mConfig.inputSampleRate;
+    config->channel_mask = mConfig.inputChannelMask;
+    config->format = mConfig.inputFormat;
+    const auto inHal = sp<OfflineStreamInHal>::make(audio_config_base_t{
+            .sample_rate = config->sample_rate,
+            .channel_mask = config->channel_mask,
+            .format = config->format}, mConfig.frameCount, mOutHal,
+            mConfig.markerFrame, mConfig.inputLatencyFrames);
+    auto* const in = new OfflineStreamIn(mAudioHwDevs.valueAt(index), inHal);
+    *input = nextUniqueId(AUDIO_UNIQUE_ID_USE_INPUT);
+    const sp<IAfRecordThread> thread = IAfRecordThread::create(
+            mThreadCallback, in, *input, false /* systemReady */);
+    mRecordThreads.emplace(*input, thread);
+    return thread;
+}
+
+OfflinePatch::OfflinePatch(const Config& config)
+    : mConfig(config)
+    , mChannelCount(audio_channel_count_from_out_mask(config.channelMask))
+    , mThreadCallback(sp<OfflineThreadCallback>::make(sp<OfflineEffectsFactoryHal>::make()))
+    , mCallback(sp<OfflinePatchCallback>::make(mThreadCallback, config))
+    , mPanel(IAfPatchPanel::create(mCallback)) {
+    LOG_ALWAYS_FATAL_IF(config.frameCount == 0 || config.frameCount % 16 != 0,
+            "%s: invalid frame count %zu", __func__, config.frameCount);
+
+    struct audio_patch patch{};
+    patch.num_sources = 1;
+    patch.sources[0].role = AUDIO_PORT_ROLE_SOURCE;
+    patch.sources[0].type = AUDIO_PORT_TYPE_DEVICE;
+    patch.sources[0].ext.device.hw_module = mCallback->sourceModule();
+    patch.sources[0].ext.device.type = AUDIO_DEVICE_IN_USB_DEVICE;
+    patch.num_sinks = 1;
+    patch.sinks[0].role = AUDIO_PORT_ROLE_SINK;
+    patch.sinks[0].type = AUDIO_PORT_TYPE_DEVICE;
+    patch.sinks[0].ext.device.hw_module = mCallback->sinkModule();
+    patch.sinks[0].ext.device.type = AUDIO_DEVICE_OUT_SPEAKER;
+
+    audio_utils::lock_guard _l(mCallback->mutex());
+    mPanel->setDirectSoftwarePatchEnabled_l(config.direct);
+    if (config.shareOutput) {
+        // as the audio policy, which opens the output and sets its volume beforehand
+        audio_config_t halConfig = AUDIO_CONFIG_INITIALIZER;
+        audio_config_base_t mixerConfig = AUDIO_CONFIG_BASE_INITIALIZER;
+        audio_output_flags_t flags = AUDIO_OUTPUT_FLAG_NONE;
+        const sp<IAfThreadBase> thread = mCallback->openOutput_l(mCallback->sinkModule(),
+                &mSharedOutput, &halConfig, &mixerConfig, AUDIO_DEVICE_OUT_SPEAKER,
+                String8(), &flags, AUDIO_ATTRIBUTES_INITIALIZER);
+        thread->asIAfPlaybackThread()->setStreamVolume(
+                AUDIO_STREAM_MUSIC, 1.f, false /* muted */);
+        patch.num_sources = 2;
+        patch.sources[1].role = AUDIO_PORT_ROLE_SOURCE;
+        patch.sources[1].type = AUDIO_PORT_TYPE_MIX;
+        patch.sources[1].ext.mix.hw_module = mCallback->sinkModule();
+        patch.sources[1].ext.mix.handle = mSharedOutput;
+        patch.sources[1].ext.mix.usecase.stream = AUDIO_STREAM_MUSIC;
+    }
+    mStatus = mPanel->createAudioPatch_l(&patch, &mHandle, false /* endpointPatch */);
+    ALOGW_IF(mStatus != OK, "%s: cannot create the patch: %d", __func__, mStatus);
+}
+
+OfflinePatch::~OfflinePatch() {
+    // the threads must not wait for the harness while they stop.
+    mCallback->exitStreams();
+    {
+        audio_utils::lock_guard _l(mCallback->mutex());
+        if (mHandle != AUDIO_PATCH_HANDLE_NONE) {
+            (void)mPanel->releaseAudioPatch_l(mHandle);
+        }
+        if (mSharedOutput != AUDIO_IO_HANDLE_NONE) {
+            const sp<IAfPlaybackThread> thread = mCallback->checkPlaybackThread_l(mSharedOutput);
+            if (thread != nullptr) {
+                mCallback->closeThreadInternal_l(thread);
+            }
+        }
+    }
+    mThreadCallback->exit();
+}
+
+bool OfflinePatch::isDirect() const {
+    audio_utils::lock_guard _l(mCallback->mutex());
+    const auto& patches = mPanel->patches_l();
+    const auto it = patches.find(mHandle);
+    return it != patches.end() && it->second.mIsDirect;
+}
+
+status_t OfflinePatch::getLatencyMs(double* latencyMs) const {
+    audio_utils::lock_guard _l(mCallback->mutex());
+    return mPanel->getLatencyMs_l(mHandle, latencyMs);
+}
+
+std::vector<float> OfflinePatch::processPeriod() {
+    const sp<OfflineStreamOutHal>& outHal = mCallback->outHal();
+    const auto* const buffer = static_cast<const float*>(outHal->waitForWrite());
+    std::vector<float> period(buffer, buffer + mConfig.frameCount * mChannelCount);
+    outHal->release();
+    ++mPeriods;
+    return period;
+}
+
+int64_t OfflinePatch::findMarker(size_t maxPeriods, std::vector<float>* marker) {
+    for (size_t i = 0; i < maxPeriods; ++i) {
+        const uint64_t periodFrame = mPeriods * mConfig.frameCount;
+        const std::vector<float> period = processPeriod();
+        for (size_t frame = 0; frame < mConfig.frameCount; ++frame) {
+            const auto first = period.begin() + frame * mChannelCount;
+            // the input is silence but for the marker
+            if (std::any_of(first, first + mChannelCount, [](float sample) {
+                    return std::fabs(sample) > OfflineStreamInHal::kMarkerValue / 2; })) {
+                marker->assign(first, first + mChannelCount);
+                return (int64_t)(periodFrame + frame);
+            }
+        }
+    }
+    return -1;
+}
+
+} // namespace android::audioflinger
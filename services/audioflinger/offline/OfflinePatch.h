@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <system/audio.h>
+#include <utils/Errors.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+
+class IAfPatchPanel;
+
+} // namespace android
+
+namespace android::audioflinger {
+
+class OfflinePatchCallback;
+class OfflineThreadCallback;
+
+/**
+ * OfflinePatch
+ *
+ * A device to device software patch of the PatchPanel, between a RecordThread on an
+ * OfflineStreamInHal of one module and a MixerThread on an OfflineStreamOutHal of another.
+ * The input stream captures a period whenever the output stream renders one, so that the
+ * frame of the marker in the output is the latency of the bridge in frames.
+ * The harness owns the output: processPeriod() takes the period written by the MixerThread
+ * and lets it mix the next one.
+ */
+class OfflinePatch {
+public:
+    struct Config {
+        uint32_t sampleRate = 48000;
+        uint32_t inputSampleRate = 48000;
+        audio_channel_mask_t channelMask = AUDIO_CHANNEL_OUT_STEREO;
+        audio_channel_mask_t inputChannelMask = AUDIO_CHANNEL_IN_STEREO;
+        audio_format_t inputFormat = AUDIO_FORMAT_PCM_16_BIT;
+        // the buffer of both HAL streams: a multiple of 16 frames, and at least 12 ms
+        // so that the RecordThread has no FastCapture.
+        size_t frameCount = 960;
+        uint64_t markerFrame = 0;           // the input frame of the marker
+        uint32_t inputLatencyFrames = 0;    // the capture latency of the input stream
+        bool direct = false;                // see IAfPatchPanel::setDirectSoftwarePatchEnabled_l()
+        bool shareOutput = false;           // a two source patch reusing an opened output
+    };
+
+    explicit OfflinePatch(const Config& config);
+    ~OfflinePatch();
+
+    OfflinePatch(const OfflinePatch&) = delete;
+    OfflinePatch& operator=(const OfflinePatch&) = delete;
+
+    // The status of the creation of the patch.
+    status_t initCheck() const { return mStatus; }
+    // Whether the patch is bridged by the playback thread alone.
+    bool isDirect() const;
+    // The latency reported by the PatchPanel for the patch.
+    status_t getLatencyMs(double* latencyMs) const;
+
+    /**
+     * Waits for the MixerThread to write the next period, and lets it mix the one after.
+     * \return the frameCount frames of the period, in float.
+     */
+    std::vector<float> processPeriod();
+
+    /**
+     * Processes up to maxPeriods periods, until the marker is found.
+     * \param marker receives the samples of the frame of the marker.
+     * \return the output frame of the marker, or -1 if it is not found.
+     */
+    int64_t findMarker(size_t maxPeriods, std::vector<float>* marker);
+
+private:
+    const Config mConfig;
+    const uint32_t mChannelCount;
+    const sp<OfflineThreadCallback> mThreadCallback;
+    const sp<OfflinePatchCallback> mCallback;
+    const sp<IAfPatchPanel> mPanel;
+    audio_patch_handle_t mHandle = AUDIO_PATCH_HANDLE_NONE;
+    audio_io_handle_t mSharedOutput = AUDIO_IO_HANDLE_NONE;
+    status_t mStatus = NO_INIT;
+    uint64_t mPeriods = 0;   // the periods processed
+};
+
+} // namespace android::audioflinger
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflineScript"
+
+#include "OfflineScript.h"
+
+#include <cmath>
+#include <sstream>
+
+#include <android-base/parsedouble.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
+
+namespace android::audioflinger {
+
+using base::ParseFloat;
+using base::ParseInt;
+using base::ParseUint;
+using base::StringPrintf;
+
+namespace {
+
+bool parseFormat(const std::string& s, audio_format_t* format) {
+    static const struct {
+        const char* name;
+        audio_format_t format;
+    } kFormats[] = {
+        {"i16", AUDIO_FORMAT_PCM_16_BIT},
+        {"i32", AUDIO_FORMAT_PCM_32_BIT},
+        {"p24", AUDIO_FORMAT_PCM_24_BIT_PACKED},
+        {"q8_24", AUDIO_FORMAT_PCM_8_24_BIT},
+        {"float", AUDIO_FORMAT_PCM_FLOAT},
+    };
+    for (const auto& entry : kFormats) {
+        if (s == entry.name) {
+            *format = entry.format;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseSignal(const std::string& s, OfflineMixer::Signal* signal) {
+    if (s == "sine") {
+        *signal = OfflineMixer::SIGNAL_SINE;
+    } else if (s == "chirp") {
+        *signal = OfflineMixer::SIGNAL_CHIRP;
+    } else if (s == "noise") {
+        *signal = OfflineMixer::SIGNAL_NOISE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Parses the key=value options of the add command.
+bool parseTrackOption(const std::string& option, OfflineMixer::TrackConfig* track) {
+    const size_t equal = option.find('=');
+    if (equal == std::string::npos) return false;
+    const std::string key = option.substr(0, equal);
+    const std::string value = option.substr(equal + 1);
+    uint32_t u32;
+    size_t frames;
+    int session;
+    if (key == "signal") {
+        return parseSignal(value, &track->signal);
+    } else if (key == "freq") {
+        return ParseFloat(value, &track->frequencyHz, 0.f);
+    } else if (key == "amp") {
+        return ParseFloat(value, &track->amplitude, 0.f, 1.f);
+    } else if (key == "rate") {
+        return ParseUint(value, &track->sampleRate, 384000u) && track->sampleRate > 0;
+    } else if (key == "channels") {
+        if (!ParseUint(value, &u32, (uint32_t)FCC_LIMIT) || u32 == 0) return false;
+        track->channelMask = audio_channel_out_mask_from_count(u32);
+        return track->channelMask != AUDIO_CHANNEL_INVALID;
+    } else if (key == "format") {
+        return parseFormat(value, &track->format);
+    } else if (key == "session") {
+        if (!ParseInt(value, &session, 0)) return false;
+        track->sessionId = (audio_session_t)session;
+        return true;
+    } else if (key == "buffer") {
+        if (!ParseUint(value, &frames)) return false;
+        track->bufferFrames = frames;
+        return true;
+    } else if (key == "write") {
+        if (!ParseUint(value, &frames)) return false;
+        track->writeFrames = frames;
+        return true;
+    }
+    return false;
+}
+
+} // namespace
+
+// static
+status_t OfflineScript::parse(std::istream& in, OfflineScript* script, std::string* error) {
+    std::vector<Command> commands;
+    uint64_t periods = 0;
+    bool hasEnd = false;
+    std::string text;
+    for (size_t line = 1; std::getline(in, text); ++line) {
+        const size_t comment = text.find('#');
+        if (comment != std::string::npos) {
+            text.resize(comment);
+        }
+        std::istringstream words(text);
+        std::vector<std::string> w;
+        for (std::string word; words >> word;) {
+            w.push_back(std::move(word));
+        }
+        if (w.empty()) continue;
+
+        const auto fail = [&](const char* what) {
+            *error = StringPrintf("line %zu: %s: %s", line, what, text.c_str());
+            return BAD_VALUE;
+        };
+        Command command{};
+        command.line = line;
+        if (!ParseUint(w[0], &command.period)) return fail("invalid period");
+        if (!commands.empty() && command.period < commands.back().period) {
+            return fail("period before the previous command");
+        }
+        if (hasEnd) return fail("command after end");
+        if (w.size() < 2) return fail("missing command");
+        const std::string& name = w[1];
+
+        if (name == "end") {
+            if (w.size() != 2) return fail("end takes no argument");
+            hasEnd = true;
+            periods = command.period;
+            continue;
+        }
+        if (w.size() < 3) return fail("missing argument");
+        if (name == "master") {
+            command.type = Command::MASTER;
+            if (w.size() != 3 || !ParseFloat(w[2], &command.values[0], 0.f, 1.f)) {
+                return fail("invalid master volume");
+            }
+        } else {
+            if (!ParseInt(w[2], &command.id, 0)) return fail("invalid id");
+            if (name == "add") {
+                command.type = Command::ADD;
+                for (size_t i = 3; i < w.size(); ++i) {
+                    if (!parseTrackOption(w[i], &command.track)) return fail("invalid option");
+                }
+            } else if (name == "start" || name == "pause" || name == "stop"
+                    || name == "remove") {
+                if (w.size() != 3) return fail("too many arguments");
+                command.type = name == "start" ? Command::START
+                        : name == "pause" ? Command::PAUSE
+                        : name == "stop" ? Command::STOP : Command::REMOVE;
+            } else if (name == "volume") {
+                command.type = Command::VOLUME;
+                if (w.size() < 4 || w.size() > 5
+                        || !ParseFloat(w[3], &command.values[0], 0.f, 1.f)
+                        || !ParseFloat(w.size() == 5 ? w[4] : w[3], &command.values[1],
+                                0.f, 1.f)) {
+                    return fail("invalid volume");
+                }
+            } else if (name == "starve") {
+                command.type = Command::STARVE;
+                if (w.size() != 4 || !ParseUint(w[3], &command.count)) {
+                    return fail("invalid periods");
+                }
+            } else if (name == "effect") {
+                if (w.size() != 4) return fail("invalid effect");
+                const std::string& effect = w[3];
+                if (effect.rfind("gain=", 0) == 0) {
+                    command.type = Command::EFFECT_GAIN;
+                    if (!ParseFloat(effect.substr(5), &command.values[0])) {
+                        return fail("invalid gain");
+                    }
+                } else if (effect.rfind("lowpass=", 0) == 0) {
+                    command.type = Command::EFFECT_LOWPASS;
+                    if (!ParseFloat(effect.substr(8), &command.values[0], 1.f)) {
+                        return fail("invalid cutoff");
+                    }
+                } else {
+                    return fail("unknown effect");
+                }
+            } else {
+                return fail("unknown command");
+            }
+        }
+        commands.push_back(command);
+    }
+    if (!hasEnd) {
+        periods = commands.empty() ? 0 : commands.back().period + 1;
+    }
+    script->mCommands = std::move(commands);
+    script->mNext = 0;
+    script->mPeriods = periods;
+    return OK;
+}
+
+status_t OfflineScript::apply(uint64_t period, OfflineMixer* mixer, std::string* error) {
+    for (; mNext < mCommands.size() && mCommands[mNext].period <= period; ++mNext) {
+        const Command& command = mCommands[mNext];
+        status_t status = OK;
+        switch (command.type) {
+        case Command::ADD:
+            status = mixer->addTrack(command.id, command.track);
+            break;
+        case Command::START:
+            status = mixer->start(command.id);
+            break;
+        case Command::PAUSE:
+            status = mixer->pause(command.id);
+            break;
+        case Command::STOP:
+            status = mixer->stop(command.id);
+            break;
+        case Command::REMOVE:
+            status = mixer->removeTrack(command.id);
+            break;
+        case Command::VOLUME:
+            status = mixer->setVolume(command.id, command.values[0], command.values[1]);
+            break;
+        case Command::STARVE:
+            status = mixer->starve(command.id, command.count);
+            break;
+        case Command::EFFECT_GAIN:
+            status = mixer->addEffect((audio_session_t)command.id,
+                    std::make_unique<GainEffect>(powf(10.f, command.values[0] / 20.f)));
+            break;
+        case Command::EFFECT_LOWPASS:
+            status = mixer->addEffect((audio_session_t)command.id,
+                    std::make_unique<LowPassEffect>(command.values[0],
+                            mixer->config().sampleRate));
+            break;
+        case Command::MASTER:
+            mixer->setMasterVolume(command.values[0]);
+            break;
+        }
+        if (status != OK) {
+            *error = StringPrintf("line %zu: command failed with status %d",
+                    command.line, status);
+            ++mNext;
+            return status;
+        }
+    }
+    return OK;
+}
+
+status_t OfflineScript::run(OfflineMixer* mixer, std::string* error) {
+    for (uint64_t period = mixer->periods(); period < mPeriods; ++period) {
+        const status_t status = apply(period, mixer, error);
+        if (status != OK) return status;
+        mixer->processPeriod();
+    }
+    return OK;
+}
+
+} // namespace android::audioflinger
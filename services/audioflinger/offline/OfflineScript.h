@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "OfflineMixer.h"
+
+namespace android::audioflinger {
+
+/**
+ * OfflineScript
+ *
+ * The track lifecycles of an OfflineMixer run, as text. Each line is a command run at the
+ * start of a period, before the mix; '#' starts a comment. Periods must not decrease.
+ *
+ *   <period> add <id> [<key>=<value> ...]
+ *            signal=sine|chirp|noise freq=<Hz> amp=<0..1> rate=<Hz> channels=<count>
+ *            format=i16|i32|p24|q8_24|float session=<id> buffer=<frames> write=<frames>
+ *   <period> start|pause|stop|remove <id>
+ *   <period> volume <id> <left> [<right>]
+ *   <period> starve <id> <periods>        the client writes nothing for <periods>
+ *   <period> effect <session> gain=<dB>|lowpass=<Hz>
+ *   <period> master <volume>
+ *   <period> end                          the run stops before <period>
+ *
+ * Without an end command, the run stops after the period of the last command.
+ */
+class OfflineScript {
+public:
+    /**
+     * Parses a script.
+     *
+     * \return OK, or BAD_VALUE with a message naming the line in error.
+     */
+    static status_t parse(std::istream& in, OfflineScript* script, std::string* error);
+
+    // Number of periods of the run.
+    uint64_t periods() const { return mPeriods; }
+
+    /**
+     * Applies the commands of the given period to mixer; call before each processPeriod().
+     *
+     * \return OK, or the error of the first failed command, with a message in error.
+     */
+    status_t apply(uint64_t period, OfflineMixer* mixer, std::string* error);
+
+    /**
+     * Runs the whole script on mixer, from its current period.
+     */
+    status_t run(OfflineMixer* mixer, std::string* error);
+
+private:
+    struct Command {
+        enum Type {
+            ADD,
+            START,
+            PAUSE,
+            STOP,
+            REMOVE,
+            VOLUME,
+            STARVE,
+            EFFECT_GAIN,
+            EFFECT_LOWPASS,
+            MASTER,
+        };
+        uint64_t period;
+        size_t line;
+        Type type;
+        int id;                         // track, or session for effects
+        float values[2];
+        uint32_t count;                 // starve periods
+        OfflineMixer::TrackConfig track;
+    };
+
+    std::vector<Command> mCommands;
+    size_t mNext = 0;                   // first command not applied
+    uint64_t mPeriods = 0;
+};
+
+} // namespace android::audioflinger
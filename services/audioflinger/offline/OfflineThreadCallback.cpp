@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflineThreadCallback"
+
+#include "OfflineThreadCallback.h"
+
+#include <binder/Status.h>
+#include <utils/Log.h>
+
+namespace android::audioflinger {
+
+using ::android::base::unexpected;
+using ::android::binder::Status;
+using ::android::error::BinderResult;
+using ::com::android::media::permission::PermissionEnum;
+
+OfflineThreadCallback::OfflineThreadCallback(
+        const sp<EffectsFactoryHalInterface>& effectsFactory)
+    : mEffectsFactoryHal(effectsFactory) {
+}
+
+void OfflineThreadCallback::onFirstRef() {
+    // as AudioFlinger::onFirstRef()
+    mPatchCommandThread = sp<PatchCommandThread>::make();
+    mMelReporter = sp<MelReporter>::make(sp<IAfMelReporterCallback>::fromExisting(this),
+            mPatchPanel);
+}
+
+void OfflineThreadCallback::exit() {
+    // the MelReporter and this callback refer to each other
+    if (mMelReporter != nullptr) {
+        mMelReporter->resetReferencesForTest();
+        mMelReporter.clear();
+    }
+    if (mPatchCommandThread != nullptr) {
+        mPatchCommandThread->exit();
+        mPatchCommandThread.clear();
+    }
+}
+
+sp<IAfThreadBase> OfflineThreadCallback::checkOutputThread_l(
+        audio_io_handle_t /* ioHandle */) const {
+    // the only patches are those of an OfflinePatch, to a speaker: the MelReporter
+    // computes no dose for them, and never looks up a thread.
+    return nullptr;
+}
+
+audio_unique_id_t OfflineThreadCallback::nextUniqueId(audio_unique_id_use_t use) {
+    LOG_ALWAYS_FATAL_IF((unsigned) use >= (unsigned) AUDIO_UNIQUE_ID_USE_MAX);
+    return (audio_unique_id_t) (mNextUniqueId.fetch_add(AUDIO_UNIQUE_ID_USE_MAX) | use);
+}
+
+bool OfflineThreadCallback::updateOrphanEffectChains(const sp<IAfEffectModule>& /* effect */) {
+    return false;
+}
+
+status_t OfflineThreadCallback::moveEffectChain_ll(audio_session_t /* sessionId */,
+        IAfPlaybackThread* /* srcThread */, IAfPlaybackThread* /* dstThread */,
+        IAfEffectChain* /* srcChain */) {
+    return INVALID_OPERATION;
+}
+
+sp<audioflinger::SyncEvent> OfflineThreadCallback::createSyncEvent(
+        AudioSystem::sync_event_t /* type */,
+        audio_session_t /* triggerSession */,
+        audio_session_t /* listenerSession */,
+        const audioflinger::SyncEventCallback& /* callBack */,
+        const wp<IAfTrackBase>& /* cookie */) {
+    return nullptr;
+}
+
+void OfflineThreadCallback::ioConfigChanged_l(audio_io_config_event_t event,
+        const sp<AudioIoDescriptor>& /* ioDesc */, pid_t /* pid */) {
+    ALOGV("%s: event %d", __func__, event);
+}
+
+void OfflineThreadCallback::onSupportedLatencyModesChanged(audio_io_handle_t /* output */,
+        const std::vector<audio_latency_mode_t>& /* modes */) {
+}
+
+void OfflineThreadCallback::onHardError(std::set<audio_port_handle_t>& /* trackPortIds */) {
+    ALOGE("%s: unexpected hard error of the offline stream", __func__);
+}
+
+BinderResult<std::vector<std::string>> OfflineThreadCallback::getPackagesForUid(
+        uid_t /* uid */) const {
+    return unexpected{Status::fromExceptionCode(Status::EX_ILLEGAL_STATE)};
+}
+
+BinderResult<bool> OfflineThreadCallback::validateUidPackagePair(
+        uid_t /* uid */, const std::string& /* packageName */) const {
+    return false;
+}
+
+BinderResult<bool> OfflineThreadCallback::checkPermission(
+        PermissionEnum /* permission */, uid_t /* uid */) const {
+    return false;
+}
+
+} // namespace android::audioflinger
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <atomic>
+
+#include <IAfThread.h>
+#include <MelReporter.h>
+#include <PatchCommandThread.h>
+#include <audio_utils/mutex.h>
+#include <media/IPermissionProvider.h>
+#include <media/audiohal/EffectsFactoryHalInterface.h>
+
+namespace android::audioflinger {
+
+/**
+ * OfflineThreadCallback
+ *
+ * The AudioFlinger of the threads of an OfflineThreadMixer: it owns the effects factory and
+ * the MelReporter, and otherwise reports a device at rest, with no audio policy, patch
+ * panel or AudioService. The master volume and mute are those of the thread.
+ */
+class OfflineThreadCallback : public IAfThreadCallback,
+                              public IAfMelReporterCallback,
+                              public ::com::android::media::permission::IPermissionProvider {
+public:
+    explicit OfflineThreadCallback(const sp<EffectsFactoryHalInterface>& effectsFactory);
+
+    // Releases the MelReporter and stops the PatchCommandThread,
+    // to be called once the threads have exited.
+    void exit();
+
+    // IAfThreadCallback and IAfMelReporterCallback
+    audio_utils::mutex& mutex() const final
+            RETURN_CAPABILITY(audio_utils::AudioFlinger_Mutex)
+            EXCLUDES_BELOW_AudioFlinger_Mutex { return mMutex; }
+
+    // IAfMelReporterCallback
+    const sp<PatchCommandThread>& getPatchCommandThread() final { return mPatchCommandThread; }
+    sp<IAfThreadBase> checkOutputThread_l(audio_io_handle_t ioHandle) const final
+            REQUIRES(mutex());
+
+    // IAfThreadCallback
+    bool isNonOffloadableGlobalEffectEnabled_l() const final
+            REQUIRES(mutex()) EXCLUDES_ThreadBase_Mutex { return false; }
+    audio_unique_id_t nextUniqueId(audio_unique_id_use_t use) final;
+    bool btNrecIsOff() const final { return false; }
+    float masterVolume_l() const final REQUIRES(mutex()) { return 1.f; }
+    bool masterMute_l() const final REQUIRES(mutex()) { return false; }
+    float getMasterBalance_l() const final REQUIRES(mutex()) { return 0.f; }
+    bool streamMute_l(audio_stream_type_t /* stream */) const final REQUIRES(mutex()) {
+        return false;
+    }
+    audio_mode_t getMode() const final { return AUDIO_MODE_NORMAL; }
+    bool isLowRamDevice() const final { return false; }
+    // the effects are not registered with the audio policy
+    bool isAudioPolicyReady() const final { return false; }
+    uint32_t getScreenState() const final { return 1; }  // on
+    std::optional<media::AudioVibratorInfo> getDefaultVibratorInfo_l() const final
+            REQUIRES(mutex()) { return std::nullopt; }
+    const sp<IAfPatchPanel>& getPatchPanel() const final { return mPatchPanel; }
+    const sp<MelReporter>& getMelReporter() const final { return mMelReporter; }
+    const sp<EffectsFactoryHalInterface>& getEffectsFactoryHal() const final {
+        return mEffectsFactoryHal;
+    }
+    sp<IAudioManager> getOrCreateAudioManager() final { return nullptr; }
+    sp<media::IAudioManagerNative> getAudioManagerNative() const final { return nullptr; }
+    bool updateOrphanEffectChains(const sp<IAfEffectModule>& effect) final
+            EXCLUDES_AudioFlinger_Mutex;
+    status_t moveEffectChain_ll(audio_session_t sessionId,
+            IAfPlaybackThread* srcThread, IAfPlaybackThread* dstThread,
+            IAfEffectChain* srcChain = nullptr) final
+            REQUIRES(mutex(), audio_utils::ThreadBase_Mutex);
+    sp<audioflinger::SyncEvent> createSyncEvent(AudioSystem::sync_event_t type,
+            audio_session_t triggerSession,
+            audio_session_t listenerSession,
+            const audioflinger::SyncEventCallback& callBack,
+            const wp<IAfTrackBase>& cookie) final EXCLUDES_AudioFlinger_Mutex;
+    void ioConfigChanged_l(audio_io_config_event_t event,
+            const sp<AudioIoDescriptor>& ioDesc,
+            pid_t pid = 0) final EXCLUDES_AudioFlinger_ClientMutex;
+    void onNonOffloadableGlobalEffectEnable() final EXCLUDES_AudioFlinger_Mutex {}
+    void onSupportedLatencyModesChanged(
+            audio_io_handle_t output, const std::vector<audio_latency_mode_t>& modes) final
+            EXCLUDES_AudioFlinger_ClientMutex;
+    void onHardError(std::set<audio_port_handle_t>& trackPortIds) final;
+    const ::com::android::media::permission::IPermissionProvider& getPermissionProvider() final {
+        return *this;
+    }
+    bool isHardeningOverrideEnabled() const final { return false; }
+    bool hasAlreadyCaptured(uid_t /* uid */) const final { return false; }
+
+    // IPermissionProvider: no package is known and no permission is held.
+    ::android::error::BinderResult<std::vector<std::string>> getPackagesForUid(
+            uid_t uid) const final;
+    ::android::error::BinderResult<bool> validateUidPackagePair(
+            uid_t uid, const std::string& packageName) const final;
+    ::android::error::BinderResult<bool> checkPermission(
+            ::com::android::media::permission::PermissionEnum permission,
+            uid_t uid) const final;
+
+private:
+    void onFirstRef() final;
+
+    mutable audio_utils::mutex mMutex{audio_utils::MutexOrder::kAudioFlinger_Mutex};
+    const sp<EffectsFactoryHalInterface> mEffectsFactoryHal;
+    const sp<IAfPatchPanel> mPatchPanel;    // none
+    sp<PatchCommandThread> mPatchCommandThread;
+    sp<MelReporter> mMelReporter;
+    std::atomic<audio_unique_id_t> mNextUniqueId{AUDIO_UNIQUE_ID_USE_MAX};
+};
+
+} // namespace android::audioflinger
@@ -0,0 +1,435 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "OfflineThreadMixer"
+
+#include "OfflineThreadMixer.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <IAfEffect.h>
+#include <IAfThread.h>
+#include <IAfTrack.h>
+#include <android/content/AttributionSourceState.h>
+#include <audio_utils/format.h>
+#include <audio_utils/minifloat.h>
+#include <cutils/atomic.h>
+#include <datapath/AudioHwDevice.h>
+#include <media/AudioResamplerPublic.h>
+#include <private/android_filesystem_config.h>
+#include <private/media/AudioTrackShared.h>
+#include <utils/Log.h>
+
+#include "OfflineHal.h"
+#include "OfflineThreadCallback.h"
+
+namespace android::audioflinger {
+
+// A Track of the thread and its simulated client, which writes through the client proxy
+// of the track, as an OutputTrack does.
+class OfflineThreadMixer::Track {
+public:
+    Track(const TrackConfig& config, const sp<IAfTrack>& track, size_t bufferFrames,
+            size_t writeFrames)
+        : mConfig(config)
+        , mTrack(track)
+        , mChannelCount(audio_channel_count_from_out_mask(config.channelMask))
+        , mFrameSize(audio_bytes_per_frame(mChannelCount, config.format))
+        , mWriteFrames(writeFrames)
+        , mClientProxy(sp<AudioTrackClientProxy>::make(track->cblk(), track->buffer(),
+                bufferFrames, mFrameSize, true /* clientInServer */))
+        , mScratch(bufferFrames * mChannelCount) {
+        mClientProxy->setSendLevel(0.0);
+        mClientProxy->setSampleRate(config.sampleRate);
+        setVolume(1.f, 1.f);
+    }
+
+    ~Track() {
+        // the proxy refers to the shared memory of the track
+        mClientProxy.clear();
+        mTrack->destroy();
+    }
+
+    const sp<IAfTrack>& track() const { return mTrack; }
+    int64_t framesWritten() const { return mFramesWritten; }
+
+    void setVolume(float left, float right) {
+        mClientProxy->setVolumeLR(gain_minifloat_pack(gain_from_float(left),
+                gain_from_float(right)));
+    }
+
+    // See AudioTrack::start(): re-enables a track disabled on underrun.
+    status_t start() {
+        const auto state = mTrack->state();
+        if (state == IAfTrackBase::IDLE || state == IAfTrackBase::STOPPED
+                || state == IAfTrackBase::FLUSHED) {
+            // as an application writing its buffer before start()
+            clientWrite(true /* fill */);
+        }
+        android_atomic_and(~(CBLK_STREAM_END_DONE | CBLK_DISABLED), &mTrack->cblk()->mFlags);
+        return mTrack->start();
+    }
+
+    // The client write of one period, or of the whole free space if fill is true.
+    void clientWrite(bool fill = false) {
+        if (!fill && mStarvePeriods > 0) {
+            --mStarvePeriods;
+            return;
+        }
+        size_t frames = fill ? mScratch.size() / mChannelCount : mWriteFrames;
+        while (frames > 0) {
+            Proxy::Buffer buffer;
+            buffer.mFrameCount = frames;
+            if (mClientProxy->obtainBuffer(&buffer, &ClientProxy::kNonBlocking) != NO_ERROR
+                    || buffer.mFrameCount == 0) {
+                break;  // the buffer is full
+            }
+            generate(mScratch.data(), buffer.mFrameCount);
+            memcpy_by_audio_format(buffer.mRaw, mConfig.format,
+                    mScratch.data(), AUDIO_FORMAT_PCM_FLOAT, buffer.mFrameCount * mChannelCount);
+            mFramesWritten += buffer.mFrameCount;
+            frames -= buffer.mFrameCount;
+            mClientProxy->releaseBuffer(&buffer);
+        }
+    }
+
+    uint32_t mStarvePeriods = 0;
+
+private:
+    void generate(float* out, size_t frames) {
+        const double sampleRate = mConfig.sampleRate;
+        for (size_t i = 0; i < frames; ++i) {
+            const int64_t n = mFramesWritten + (int64_t)i;
+            switch (mConfig.signal) {
+            case SIGNAL_SINE: {
+                const double phase = 2. * M_PI * mConfig.frequencyHz * (double)n / sampleRate;
+                for (uint32_t c = 0; c < mChannelCount; ++c) {
+                    *out++ = mConfig.amplitude * (float)sin(phase + c * M_PI / 4.);
+                }
+            } break;
+            case SIGNAL_CHIRP: {
+                constexpr double kStartHz = 20.;
+                const double t = (double)(n % mConfig.sampleRate) / sampleRate;
+                const double phase = 2. * M_PI
+                        * (kStartHz * t + (sampleRate / 2. - kStartHz) * t * t / 2.);
+                const float value = mConfig.amplitude * (float)sin(phase);
+                for (uint32_t c = 0; c < mChannelCount; ++c) {
+                    *out++ = value;
+                }
+            } break;
+            case SIGNAL_NOISE:
+                for (uint32_t c = 0; c < mChannelCount; ++c) {
+                    mNoiseSeed = mNoiseSeed * 1664525u + 1013904223u;
+                    *out++ = mConfig.amplitude
+                            * (float)((int32_t)mNoiseSeed >> 8) * (1.f / (1 << 23));
+                }
+                break;
+            }
+        }
+    }
+
+    const TrackConfig mConfig;
+    const sp<IAfTrack> mTrack;
+    const uint32_t mChannelCount;
+    const size_t mFrameSize;
+    const size_t mWriteFrames;
+    sp<AudioTrackClientProxy> mClientProxy;
+    std::vector<float> mScratch;        // client samples before conversion to the track format
+    int64_t mFramesWritten = 0;
+    uint32_t mNoiseSeed = 1;
+};
+
+OfflineThreadMixer::OfflineThreadMixer(const Config& config, SinkCallback sink)
+    : OfflineMixer(config, std::move(sink))
+    , mEffectsFactory(sp<OfflineEffectsFactoryHal>::make())
+    , mThreadCallback(sp<OfflineThreadCallback>::make(mEffectsFactory))
+    , mStream(sp<OfflineStreamOutHal>::make(audio_config_base_t{
+            .sample_rate = config.sampleRate,
+            .channel_mask = config.channelMask,
+            .format = config.sinkFormat}, config.frameCount)) {
+    // the mix period of a deep buffer thread is the HAL buffer rounded up to 16 frames.
+    LOG_ALWAYS_FATAL_IF(config.frameCount == 0 || config.frameCount % 16 != 0,
+            "%s: invalid frame count %zu", __func__, config.frameCount);
+
+    mHwDevice = std::make_unique<AudioHwDevice>(
+            mThreadCallback->nextUniqueId(AUDIO_UNIQUE_ID_USE_MODULE), "offline",
+            nullptr /* hwDevice */, AudioHwDevice::Flags(0));
+    mOutput = std::make_unique<OfflineStreamOut>(mHwDevice.get(), mStream);
+    {
+        audio_utils::lock_guard _l(mThreadCallback->mutex());
+        mThread = IAfPlaybackThread::createMixerThread(mThreadCallback, mOutput.get(),
+                mThreadCallback->nextUniqueId(AUDIO_UNIQUE_ID_USE_OUTPUT),
+                false /* systemReady */);
+    }
+    mThread->setMasterVolume(config.masterVolume);
+    mThread->setStreamVolume(AUDIO_STREAM_MUSIC, 1.f, false /* muted */);
+
+    TrackConfig clockConfig;
+    clockConfig.channelMask = config.channelMask;
+    clockConfig.sampleRate = config.sampleRate;
+    clockConfig.amplitude = 0.f;
+    LOG_ALWAYS_FATAL_IF(createTrack(clockConfig, &mClock) != OK,
+            "%s: cannot create the clock track", __func__);
+    mClock->setVolume(0.f, 0.f);
+    LOG_ALWAYS_FATAL_IF(mClock->start() != OK, "%s: cannot start the clock track", __func__);
+    // the first period only has the clock track: keep the thread in its write.
+    (void)mStream->waitForWrite();
+}
+
+OfflineThreadMixer::~OfflineThreadMixer() {
+    for (const auto& handle : mEffectHandles) {
+        (void)handle->asIEffect()->disconnect();
+    }
+    mEffectHandles.clear();
+    mTracks.clear();
+    mClock.reset();
+    // exit() unblocks the write of the thread and waits for it.
+    mThread->exit();
+    mThread.clear();
+    mOutput.reset();
+    mHwDevice.reset();
+    mThreadCallback->exit();
+}
+
+OfflineThreadMixer::Track* OfflineThreadMixer::getTrack(int id) const {
+    const auto it = mTracks.find(id);
+    return it != mTracks.end() ? it->second.get() : nullptr;
+}
+
+bool OfflineThreadMixer::isActive(const Track& track) const {
+    audio_utils::lock_guard _l(mThread->mutex());
+    return mThread->isTrackActive(track.track());
+}
+
+status_t OfflineThreadMixer::createTrack(const TrackConfig& config, std::unique_ptr<Track>* track) {
+    const size_t periodFrames =
+            sourceFramesNeeded(config.sampleRate, mConfig.frameCount, mConfig.sampleRate);
+    const size_t bufferFrames = config.bufferFrames != 0 ? config.bufferFrames : 2 * periodFrames;
+
+    audio_attributes_t attr = AUDIO_ATTRIBUTES_INITIALIZER;
+    attr.usage = AUDIO_USAGE_MEDIA;
+    attr.content_type = AUDIO_CONTENT_TYPE_MUSIC;
+    // a service uid, so that the track is not subject to app ops
+    content::AttributionSourceState attributionSource;
+    attributionSource.uid = AID_AUDIOSERVER;
+    attributionSource.pid = getpid();
+    const sp<IAfTrack> t = IAfTrack::create(mThread.get(), nullptr /* client */,
+            AUDIO_STREAM_MUSIC, attr, config.sampleRate, config.format, config.channelMask,
+            bufferFrames, nullptr /* buffer */, 0 /* bufferSize */, nullptr /* sharedBuffer */,
+            config.sessionId, getpid(), attributionSource, AUDIO_OUTPUT_FLAG_NONE,
+            IAfTrackBase::TYPE_OUTPUT, AUDIO_PORT_HANDLE_NONE, SIZE_MAX /* frameCountToBeReady */,
+            1.f /* speed */, false /* isSpatialized */, false /* isBitPerfect */,
+            1.f /* volume */);
+    const status_t status = t->initCheck();
+    if (status != NO_ERROR) {
+        return status;
+    }
+    {
+        // see PlaybackThread::createTrack_l()
+        audio_utils::lock_guard _l(mThread->mutex());
+        mThread->addOutputTrack_l(t);
+        const sp<IAfEffectChain> chain = mThread->getEffectChain_l(config.sessionId);
+        if (chain != nullptr) {
+            t->setMainBuffer(chain->inBuffer());
+            chain->incTrackCnt();
+        }
+    }
+    *track = std::make_unique<Track>(config, t, bufferFrames,
+            config.writeFrames != 0 ? config.writeFrames : periodFrames);
+    return OK;
+}
+
+status_t OfflineThreadMixer::addTrack(int id, const TrackConfig& config) {
+    if (mTracks.count(id) != 0) {
+        ALOGE("%s: track %d already exists", __func__, id);
+        return BAD_VALUE;
+    }
+    if (config.sampleRate == 0
+            || config.sampleRate > mConfig.sampleRate * AUDIO_RESAMPLER_DOWN_RATIO_MAX) {
+        ALOGE("%s: track %d invalid sample rate %u", __func__, id, config.sampleRate);
+        return BAD_VALUE;
+    }
+    switch (config.format) {
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+    case AUDIO_FORMAT_PCM_FLOAT:
+        break;
+    default:
+        ALOGE("%s: track %d invalid format %#x", __func__, id, config.format);
+        return BAD_VALUE;
+    }
+    const uint32_t channelCount = audio_channel_count_from_out_mask(config.channelMask);
+    if (!audio_is_output_channel(config.channelMask)
+            || channelCount == 0 || channelCount > FCC_LIMIT) {
+        ALOGE("%s: track %d invalid channel mask %#x", __func__, id, config.channelMask);
+        return BAD_VALUE;
+    }
+    std::unique_ptr<Track> track;
+    const status_t status = createTrack(config, &track);
+    if (status != OK) {
+        ALOGE("%s: track %d cannot be created: %d", __func__, id, status);
+        return status;
+    }
+    mTracks[id] = std::move(track);
+    return OK;
+}
+
+status_t OfflineThreadMixer::removeTrack(int id) {
+    if (getTrack(id) == nullptr) return BAD_VALUE;
+    // an active track is removed from the thread at the next period
+    mTracks.erase(id);
+    return OK;
+}
+
+status_t OfflineThreadMixer::start(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    return track->start();
+}
+
+status_t OfflineThreadMixer::pause(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    switch (track->track()->state()) {
+    case IAfTrackBase::ACTIVE:
+    case IAfTrackBase::RESUMING:
+    case IAfTrackBase::PAUSING:
+    case IAfTrackBase::PAUSED:
+        track->track()->pause();
+        return OK;
+    default:
+        return INVALID_OPERATION;
+    }
+}
+
+status_t OfflineThreadMixer::stop(int id) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    // a normal track drains what was written
+    track->track()->stop();
+    return OK;
+}
+
+status_t OfflineThreadMixer::setVolume(int id, float left, float right) {
+    Track* const track = getTrack(id);
+    if (track == nullptr || !(left >= 0.f) || !(right >= 0.f)) return BAD_VALUE;
+    track->setVolume(left, right);
+    return OK;
+}
+
+status_t OfflineThreadMixer::starve(int id, uint32_t periods) {
+    Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    track->mStarvePeriods = periods;
+    return OK;
+}
+
+status_t OfflineThreadMixer::addEffect(audio_session_t sessionId,
+        std::unique_ptr<OfflineEffect> effect) {
+    if (effect == nullptr || audio_is_global_session(sessionId)) return BAD_VALUE;
+    effect_descriptor_t descriptor = mEffectsFactory->add(std::move(effect));
+    int enabled = 0;
+    status_t status = NO_ERROR;
+    sp<IAfEffectHandle> handle;
+    {
+        // see AudioFlinger::createEffect()
+        audio_utils::lock_guard _l(mThreadCallback->mutex());
+        handle = mThread->createEffect_l(nullptr /* client */, nullptr /* effectClient */,
+                0 /* priority */, sessionId, &descriptor, &enabled, &status, true /* pinned */,
+                false /* probe */, false /* notifyFramesProcessed */);
+    }
+    if (handle == nullptr || (status != NO_ERROR && status != ALREADY_EXISTS)) {
+        ALOGE("%s: cannot create the effect of session %d: %d", __func__, sessionId, status);
+        return status != NO_ERROR ? status : NO_INIT;
+    }
+    int32_t result = NO_ERROR;
+    (void)handle->asIEffect()->enable(&result);
+    mEffectHandles.push_back(handle);
+    return result;
+}
+
+void OfflineThreadMixer::setMasterVolume(float volume) {
+    mConfig.masterVolume = volume;
+    mThread->setMasterVolume(volume);
+}
+
+static OfflineThreadMixer::TrackState toTrackState(IAfTrackBase::track_state state) {
+    switch (state) {
+    case IAfTrackBase::ACTIVE: return OfflineThreadMixer::ACTIVE;
+    case IAfTrackBase::PAUSING: return OfflineThreadMixer::PAUSING;
+    case IAfTrackBase::PAUSED: return OfflineThreadMixer::PAUSED;
+    case IAfTrackBase::RESUMING: return OfflineThreadMixer::RESUMING;
+    case IAfTrackBase::STOPPED:
+    case IAfTrackBase::STOPPING_1:
+    case IAfTrackBase::STOPPING_2: return OfflineThreadMixer::STOPPED;
+    default: return OfflineThreadMixer::IDLE;
+    }
+}
+
+status_t OfflineThreadMixer::getTrackStats(int id, TrackStats* stats) const {
+    const Track* const track = getTrack(id);
+    if (track == nullptr) return BAD_VALUE;
+    const sp<IAfTrack>& t = track->track();
+    stats->state = toTrackState(t->state());
+    stats->active = isActive(*track);
+    stats->disabled = t->isDisabled();
+    stats->framesWritten = track->framesWritten();
+    stats->framesReleased = t->audioTrackServerProxy()->framesReleased();
+    stats->underrunFrames = t->audioTrackServerProxy()->getUnderrunFrames();
+    return OK;
+}
+
+size_t OfflineThreadMixer::activeTracks() const {
+    return std::count_if(mTracks.begin(), mTracks.end(),
+            [this](const auto& entry) { return isActive(*entry.second); });
+}
+
+const PeriodTracer& OfflineThreadMixer::periodTracer() const {
+    return mThread->periodTracer();
+}
+
+bool OfflineThreadMixer::processPeriod() {
+    // the clients run in other processes, while the thread waits for the HAL
+    for (const auto& [id, track] : mTracks) {
+        switch (track->track()->state()) {
+        case IAfTrackBase::IDLE:
+        case IAfTrackBase::FLUSHED:
+        case IAfTrackBase::STOPPED:
+            break;
+        default:
+            track->clientWrite();
+            break;
+        }
+    }
+    mClock->clientWrite();
+
+    // the thread mixes the next period and writes it.
+    mStream->release();
+    const void* const buffer = mStream->waitForWrite();
+    if (mSink) {
+        mSink(buffer, mConfig.frameCount);
+    }
+    ++mPeriods;
+    return activeTracks() != 0;
+}
+
+} // namespace android::audioflinger
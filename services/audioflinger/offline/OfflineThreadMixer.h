@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <utils/StrongPointer.h>
+
+#include "OfflineMixer.h"
+
+namespace android {
+
+class AudioHwDevice;
+class IAfEffectHandle;
+class IAfPlaybackThread;
+
+} // namespace android
+
+namespace android::audioflinger {
+
+class OfflineEffectsFactoryHal;
+class OfflineStreamOut;
+class OfflineStreamOutHal;
+class OfflineThreadCallback;
+
+/**
+ * OfflineThreadMixer
+ *
+ * Runs a MixerThread without an audio HAL, binder or AudioFlinger, one period at a time:
+ *  - the thread is the MixerThread of AudioFlinger, on a deep buffer output without
+ *    FastMixer, with an OfflineThreadCallback in place of AudioFlinger;
+ *  - its HAL stream is an OfflineStreamOutHal: write() blocks until the next
+ *    processPeriod(), so that the commands and the client writes of the harness run
+ *    while the thread is parked, as it is on a device while the HAL buffer is full;
+ *  - the tracks are real Tracks, fed by simulated clients through an
+ *    AudioTrackClientProxy;
+ *  - the session effects are OfflineEffects in the EffectChains of the thread, created
+ *    by an OfflineEffectsFactoryHal.
+ *
+ * The thread keeps a muted clock track active in AUDIO_SESSION_OUTPUT_MIX, so that it
+ * writes a period for each processPeriod() instead of going to standby. The clock track
+ * is counted in the activeTracks of the PeriodTracer records, and the write stage
+ * of the records includes the wait of the thread for the next processPeriod().
+ *
+ * The thread runs as on a device: an effect is started by the period after addEffect(),
+ * a stopped track drains what was written and then waits for the frames in the HAL, and a
+ * period where no track is ready is retried before writing silence.
+ * Device only: the thread is the one of the static libaudioflinger.
+ */
+class OfflineThreadMixer final : public OfflineMixer {
+public:
+    explicit OfflineThreadMixer(const Config& config, SinkCallback sink = nullptr);
+    ~OfflineThreadMixer() override;
+
+    status_t addTrack(int id, const TrackConfig& config) override;
+    status_t removeTrack(int id) override;
+    status_t start(int id) override;
+    status_t pause(int id) override;
+    status_t stop(int id) override;
+    status_t setVolume(int id, float left, float right) override;
+    status_t starve(int id, uint32_t periods) override;
+
+    status_t addEffect(audio_session_t sessionId,
+            std::unique_ptr<OfflineEffect> effect) override;
+    void setMasterVolume(float volume) override;
+
+    bool processPeriod() override;
+
+    // The tracks in the active tracks of the thread, but the clock track.
+    size_t activeTracks() const override;
+    status_t getTrackStats(int id, TrackStats* stats) const override;
+    const PeriodTracer& periodTracer() const override;
+
+private:
+    class Track;
+
+    Track* getTrack(int id) const;
+    status_t createTrack(const TrackConfig& config, std::unique_ptr<Track>* track);
+    bool isActive(const Track& track) const;
+
+    const sp<OfflineEffectsFactoryHal> mEffectsFactory;
+    const sp<OfflineThreadCallback> mThreadCallback;
+    const sp<OfflineStreamOutHal> mStream;
+    std::unique_ptr<AudioHwDevice> mHwDevice;
+    std::unique_ptr<OfflineStreamOut> mOutput;
+    sp<IAfPlaybackThread> mThread;
+
+    std::unique_ptr<Track> mClock;      // keeps the thread writing
+    std::map<int, std::unique_ptr<Track>> mTracks;
+    std::vector<sp<IAfEffectHandle>> mEffectHandles;
+};
+
+} // namespace android::audioflinger
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Runs an OfflineScript on an OfflineMixer and writes:
+ *  - the mix as a WAV file,
+ *  - the stage durations of each period as CSV,
+ * then prints the PeriodTracer summary of the last periods.
+ *
+ * offline_mixer runs an OfflineBaseMixer and also builds on host, offline_thread_mixer runs
+ * an OfflineThreadMixer on a device.
+ *
+ * For example:
+ *   offline_mixer -o mix.wav -t periods.csv mixer_script.txt
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <audio_utils/sndfile.h>
+
+#include "OfflineScript.h"
+#ifdef OFFLINE_THREAD_MIXER
+#include "OfflineThreadMixer.h"
+#else
+#include "OfflineBaseMixer.h"
+#endif
+
+using namespace android;
+using namespace android::audioflinger;
+
+#ifdef OFFLINE_THREAD_MIXER
+using Mixer = OfflineThreadMixer;
+#else
+using Mixer = OfflineBaseMixer;
+#endif
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-r sample-rate] [-c channels] [-f frames] [-m] [-o out.wav]"
+                    " [-t periods.csv] (<script> | -)\n", name);
+    fprintf(stderr, "    -r    mixer sample rate, default 48000\n");
+    fprintf(stderr, "    -c    mixer channel count, default 2\n");
+    fprintf(stderr, "    -f    frames per period, default 960\n");
+    fprintf(stderr, "    -m    float sink, default 16 bit\n");
+    fprintf(stderr, "    -o    WAV file of the mix\n");
+    fprintf(stderr, "    -t    CSV file of the stage durations of each period, in us\n");
+    fprintf(stderr, "    <script> is an OfflineScript, '-' for stdin\n");
+}
+
+// Appends the periods recorded since the last call to the CSV file.
+class PeriodWriter {
+public:
+    explicit PeriodWriter(FILE* file) : mFile(file) {
+        if (mFile == nullptr) return;
+        fprintf(mFile, "period,start_us,duration_us,active_tracks");
+        for (uint32_t stage = 0; stage < PeriodTracer::STAGE_COUNT; ++stage) {
+            fprintf(mFile, ",%s_us", PeriodTracer::stageToString((PeriodTracer::Stage)stage));
+        }
+        fprintf(mFile, "\n");
+    }
+
+    void drain(const PeriodTracer& tracer) {
+        if (mFile == nullptr) return;
+        for (const auto& record : tracer.getRecords()) {
+            if (record.startNs <= mLastStartNs) continue;
+            if (mFirstStartNs == 0) mFirstStartNs = record.startNs;
+            mLastStartNs = record.startNs;
+            fprintf(mFile, "%llu,%.3f,%.3f,%d", (unsigned long long)mPeriod++,
+                    (record.startNs - mFirstStartNs) * 1e-3, record.durationNs * 1e-3,
+                    record.activeTracks);
+            for (uint32_t stage = 0; stage < PeriodTracer::STAGE_COUNT; ++stage) {
+                if (record.stageBeginNs[stage] == PeriodTracer::kNotRun
+                        || record.stageEndNs[stage] == PeriodTracer::kNotRun) {
+                    fprintf(mFile, ",");
+                } else {
+                    fprintf(mFile, ",%.3f",
+                            (record.stageEndNs[stage] - record.stageBeginNs[stage]) * 1e-3);
+                }
+            }
+            fprintf(mFile, "\n");
+        }
+    }
+
+private:
+    FILE* const mFile;
+    int64_t mFirstStartNs = 0;
+    int64_t mLastStartNs = 0;
+    uint64_t mPeriod = 0;
+};
+
+int main(int argc, char* argv[]) {
+    const char* const progname = argv[0];
+    OfflineMixer::Config config;
+    const char* outputFilename = nullptr;
+    const char* traceFilename = nullptr;
+
+    for (int ch; (ch = getopt(argc, argv, "r:c:f:mo:t:")) != -1;) {
+        switch (ch) {
+        case 'r':
+            config.sampleRate = atoi(optarg);
+            break;
+        case 'c':
+            config.channelMask = audio_channel_out_mask_from_count(atoi(optarg));
+            break;
+        case 'f':
+            config.frameCount = atoi(optarg);
+            break;
+        case 'm':
+            config.sinkFormat = AUDIO_FORMAT_PCM_FLOAT;
+            break;
+        case 'o':
+            outputFilename = optarg;
+            break;
+        case 't':
+            traceFilename = optarg;
+            break;
+        case '?':
+        default:
+            usage(progname);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind + 1 != argc || config.sampleRate == 0 || config.frameCount == 0
+            || config.channelMask == AUDIO_CHANNEL_INVALID) {
+        usage(progname);
+        return EXIT_FAILURE;
+    }
+
+    OfflineScript script;
+    std::string error;
+    status_t status;
+    if (strcmp(argv[optind], "-") == 0) {
+        status = OfflineScript::parse(std::cin, &script, &error);
+    } else {
+        std::ifstream in(argv[optind]);
+        if (!in) {
+            perror(argv[optind]);
+            return EXIT_FAILURE;
+        }
+        status = OfflineScript::parse(in, &script, &error);
+    }
+    if (status != OK) {
+        fprintf(stderr, "%s: %s\n", argv[optind], error.c_str());
+        return EXIT_FAILURE;
+    }
+
+    FILE* traceFile = nullptr;
+    if (traceFilename != nullptr && (traceFile = fopen(traceFilename, "w")) == nullptr) {
+        perror(traceFilename);
+        return EXIT_FAILURE;
+    }
+
+    // the mix is kept in memory so that file I/O does not run during the periods.
+    std::vector<uint8_t> output;
+    const size_t sinkFrameSize = audio_bytes_per_frame(
+            audio_channel_count_from_out_mask(config.channelMask), config.sinkFormat);
+    if (outputFilename != nullptr) {
+        output.reserve(script.periods() * config.frameCount * sinkFrameSize);
+    }
+    Mixer mixer(config, [&](const void* buffer, size_t frameCount) {
+        if (outputFilename == nullptr) return;
+        const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+        output.insert(output.end(), bytes, bytes + frameCount * sinkFrameSize);
+    });
+
+    PeriodWriter periodWriter(traceFile);
+    for (uint64_t period = 0; period < script.periods(); ++period) {
+        status = script.apply(period, &mixer, &error);
+        if (status != OK) {
+            fprintf(stderr, "%s: %s\n", argv[optind], error.c_str());
+            return EXIT_FAILURE;
+        }
+        mixer.processPeriod();
+        if ((period + 1) % (PeriodTracer::kCapacity / 2) == 0) {
+            periodWriter.drain(mixer.periodTracer());
+        }
+    }
+    periodWriter.drain(mixer.periodTracer());
+    if (traceFile != nullptr) {
+        fclose(traceFile);
+    }
+
+    if (outputFilename != nullptr) {
+        SF_INFO info{};
+        info.samplerate = config.sampleRate;
+        info.channels = mixer.channelCount();
+        info.format = SF_FORMAT_WAV | (config.sinkFormat == AUDIO_FORMAT_PCM_FLOAT
+                ? SF_FORMAT_FLOAT : SF_FORMAT_PCM_16);
+        SNDFILE* sf = sf_open(outputFilename, SFM_WRITE, &info);
+        if (sf == nullptr) {
+            perror(outputFilename);
+            return EXIT_FAILURE;
+        }
+        const size_t frames = output.size() / sinkFrameSize;
+        if (config.sinkFormat == AUDIO_FORMAT_PCM_FLOAT) {
+            (void) sf_writef_float(sf, reinterpret_cast<const float*>(output.data()), frames);
+        } else {
+            (void) sf_writef_short(sf, reinterpret_cast<const int16_t*>(output.data()), frames);
+        }
+        sf_close(sf);
+    }
+
+    printf("%llu periods of %zu frames at %u Hz\n", (unsigned long long)mixer.periods(),
+            config.frameCount, config.sampleRate);
+    printf("%s", mixer.periodTracer().toString().c_str());
+    return EXIT_SUCCESS;
+}
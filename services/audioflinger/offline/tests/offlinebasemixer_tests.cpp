@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "offlinebasemixer_tests"
+
+#include "../OfflineBaseMixer.h"
+#include "../OfflineScript.h"
+
+#include <cmath>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+using namespace android;
+using namespace android::audioflinger;
+
+namespace {
+
+constexpr size_t kFrameCount = 480;
+constexpr uint32_t kChannelCount = 2;
+
+OfflineMixer::Config floatConfig() {
+    OfflineMixer::Config config;
+    config.frameCount = kFrameCount;
+    config.sinkFormat = AUDIO_FORMAT_PCM_FLOAT;
+    return config;
+}
+
+OfflineMixer::TrackConfig floatTrack(uint32_t sampleRate = 48000,
+        audio_session_t sessionId = AUDIO_SESSION_OUTPUT_MIX) {
+    OfflineMixer::TrackConfig track;
+    track.format = AUDIO_FORMAT_PCM_FLOAT;
+    track.sampleRate = sampleRate;
+    track.sessionId = sessionId;
+    return track;
+}
+
+// Keeps the periods written by an OfflineMixer.
+struct Output {
+    std::vector<std::vector<float>> periods;
+
+    OfflineMixer::SinkCallback sink() {
+        return [this](const void* buffer, size_t frameCount) {
+            const float* samples = static_cast<const float*>(buffer);
+            periods.emplace_back(samples, samples + frameCount * kChannelCount);
+        };
+    }
+
+    float peak(size_t period) const {
+        float peak = 0.f;
+        for (float sample : periods[period]) {
+            peak = std::max(peak, fabsf(sample));
+        }
+        return peak;
+    }
+};
+
+std::vector<uint8_t> runScript(const std::string& text) {
+    std::istringstream in(text);
+    OfflineScript script;
+    std::string error;
+    EXPECT_EQ(OK, OfflineScript::parse(in, &script, &error)) << error;
+
+    std::vector<uint8_t> output;
+    OfflineBaseMixer mixer(OfflineMixer::Config{}, [&](const void* buffer, size_t frameCount) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+        output.insert(output.end(), bytes, bytes + frameCount * sizeof(int16_t) * kChannelCount);
+    });
+    EXPECT_EQ(OK, script.run(&mixer, &error)) << error;
+    EXPECT_EQ(script.periods(), mixer.periods());
+    return output;
+}
+
+} // namespace
+
+TEST(OfflineBaseMixerTest, ScriptIsDeterministic) {
+    const std::string text =
+            "0 add 1 signal=noise rate=44100 format=i16\n"
+            "0 add 2 signal=chirp rate=48000 channels=1 format=float session=5\n"
+            "0 effect 5 lowpass=2000\n"
+            "0 start 1\n"
+            "3 start 2\n"
+            "10 starve 2 4\n"
+            "20 pause 1\n"
+            "25 start 1\n"
+            "30 volume 2 0.25\n"
+            "40 stop 1\n"
+            "50 end\n";
+    const std::vector<uint8_t> first = runScript(text);
+    ASSERT_EQ(50u * 960 * sizeof(int16_t) * kChannelCount, first.size());
+    EXPECT_EQ(first, runScript(text));
+}
+
+TEST(OfflineBaseMixerTest, StartRampsPauseRampsDownAndResumes) {
+    Output output;
+    OfflineBaseMixer mixer(floatConfig(), output.sink());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer.start(1));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(mixer.processPeriod());
+    }
+    // the first period has no ramp: the track starts at full volume.
+    EXPECT_GT(output.peak(0), 0.4f);
+
+    ASSERT_EQ(OK, mixer.pause(1));
+    EXPECT_TRUE(mixer.processPeriod());     // ramps down
+    const std::vector<float>& ramp = output.periods.back();
+    EXPECT_LT(fabsf(ramp[ramp.size() - 1]), 1e-3f);
+
+    mixer.processPeriod();
+    OfflineMixer::TrackStats stats;
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(OfflineMixer::PAUSED, stats.state);
+    EXPECT_FALSE(stats.active);
+    EXPECT_EQ(0.f, output.peak(output.periods.size() - 1));
+
+    ASSERT_EQ(OK, mixer.start(1));
+    for (int i = 0; i < 3; ++i) {
+        mixer.processPeriod();
+    }
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(OfflineMixer::ACTIVE, stats.state);
+    EXPECT_GT(output.peak(output.periods.size() - 1), 0.4f);
+}
+
+TEST(OfflineBaseMixerTest, StopDrainsTheTrack) {
+    OfflineBaseMixer mixer(floatConfig());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack(44100)));
+    ASSERT_EQ(OK, mixer.start(1));
+    for (int i = 0; i < 10; ++i) {
+        mixer.processPeriod();
+    }
+    ASSERT_EQ(OK, mixer.stop(1));
+    for (int i = 0; i < 5; ++i) {
+        mixer.processPeriod();
+    }
+    OfflineMixer::TrackStats stats;
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(OfflineMixer::STOPPED, stats.state);
+    EXPECT_FALSE(stats.active);
+    EXPECT_EQ(stats.framesWritten, stats.framesReleased);
+    EXPECT_EQ(0, stats.underrunFrames);
+    EXPECT_EQ(0u, mixer.activeTracks());
+}
+
+TEST(OfflineBaseMixerTest, UnderrunDisablesTheTrackAfterRetries) {
+    OfflineBaseMixer mixer(floatConfig());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer.addTrack(2, floatTrack()));
+    ASSERT_EQ(OK, mixer.start(1));
+    ASSERT_EQ(OK, mixer.start(2));
+    ASSERT_EQ(OK, mixer.starve(2, 100));
+    for (int i = 0; i < 60; ++i) {
+        mixer.processPeriod();
+    }
+    OfflineMixer::TrackStats stats;
+    ASSERT_EQ(OK, mixer.getTrackStats(2, &stats));
+    EXPECT_TRUE(stats.disabled);
+    EXPECT_FALSE(stats.active);
+    // tallied while track 1 was mixed
+    EXPECT_GT(stats.underrunFrames, 0);
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_TRUE(stats.active);
+    EXPECT_FALSE(stats.disabled);
+    // without the retries of track 2, track 1 is mixed every period
+    const int64_t framesReleased = stats.framesReleased;
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(mixer.processPeriod());
+    }
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(framesReleased + 10 * (int64_t)kFrameCount, stats.framesReleased);
+}
+
+TEST(OfflineBaseMixerTest, SessionEffectChain) {
+    Output direct, withEffect;
+    OfflineBaseMixer mixer1(floatConfig(), direct.sink());
+    OfflineBaseMixer mixer2(floatConfig(), withEffect.sink());
+    ASSERT_EQ(OK, mixer1.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer2.addTrack(1, floatTrack(48000, (audio_session_t)17)));
+    ASSERT_EQ(OK, mixer2.addEffect((audio_session_t)17, std::make_unique<GainEffect>(0.5f)));
+    ASSERT_EQ(BAD_VALUE, mixer2.addEffect(AUDIO_SESSION_OUTPUT_MIX,
+            std::make_unique<GainEffect>(0.5f)));
+    for (OfflineMixer* mixer : {&mixer1, &mixer2}) {
+        ASSERT_EQ(OK, mixer->start(1));
+        for (int i = 0; i < 5; ++i) {
+            mixer->processPeriod();
+        }
+    }
+    for (size_t period = 0; period < direct.periods.size(); ++period) {
+        for (size_t i = 0; i < direct.periods[period].size(); ++i) {
+            ASSERT_NEAR(direct.periods[period][i] * 0.5f, withEffect.periods[period][i], 1e-6f);
+        }
+    }
+    // the effects stage is traced.
+    const auto records = mixer2.periodTracer().getRecords();
+    ASSERT_EQ(5u, records.size());
+    EXPECT_NE(PeriodTracer::kNotRun, records.back().stageEndNs[PeriodTracer::STAGE_EFFECTS]);
+}
+
+TEST(OfflineBaseMixerTest, ResamplingTrackDoesNotUnderrun) {
+    OfflineBaseMixer mixer(floatConfig());
+    for (int id : {1, 2, 3}) {
+        ASSERT_EQ(OK, mixer.addTrack(id, floatTrack(id == 1 ? 44100 : id == 2 ? 22050 : 96000)));
+        ASSERT_EQ(OK, mixer.start(id));
+    }
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_TRUE(mixer.processPeriod());
+    }
+    for (int id : {1, 2, 3}) {
+        OfflineMixer::TrackStats stats;
+        ASSERT_EQ(OK, mixer.getTrackStats(id, &stats));
+        EXPECT_EQ(0, stats.underrunFrames) << "track " << id;
+        EXPECT_TRUE(stats.active) << "track " << id;
+    }
+    EXPECT_EQ(3u, mixer.activeTracks());
+    EXPECT_EQ(3, mixer.periodTracer().getRecords().back().activeTracks);
+}
+
+TEST(OfflineBaseMixerTest, RemoveTrack) {
+    OfflineBaseMixer mixer(floatConfig());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(BAD_VALUE, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer.start(1));
+    mixer.processPeriod();
+    ASSERT_EQ(OK, mixer.removeTrack(1));
+    EXPECT_EQ(BAD_VALUE, mixer.start(1));
+    mixer.processPeriod();
+    EXPECT_EQ(0u, mixer.activeTracks());
+    // the id can be reused once removed
+    EXPECT_EQ(OK, mixer.addTrack(1, floatTrack()));
+}
+
+TEST(OfflineBaseMixerTest, InvalidTracks) {
+    OfflineBaseMixer mixer(floatConfig());
+    OfflineMixer::TrackConfig track = floatTrack();
+    track.channelMask = AUDIO_CHANNEL_OUT_5POINT1;  // no downmix
+    EXPECT_EQ(BAD_VALUE, mixer.addTrack(1, track));
+    track = floatTrack();
+    track.format = AUDIO_FORMAT_MP3;
+    EXPECT_EQ(BAD_VALUE, mixer.addTrack(1, track));
+    EXPECT_EQ(BAD_VALUE, mixer.addTrack(1, floatTrack(0)));
+    EXPECT_EQ(OK, mixer.addTrack(1, floatTrack()));
+}
+
+TEST(OfflineScriptTest, ParseErrors) {
+    const char* const kInvalid[] = {
+        "x start 1\n",
+        "0 jump 1\n",
+        "0 add 1 rate=0\n",
+        "0 add 1 color=red\n",
+        "0 volume 1 2.0\n",
+        "0 effect 3 reverb=1\n",
+        "5 start 1\n2 stop 1\n",
+        "5 end\n6 start 1\n",
+    };
+    for (const char* text : kInvalid) {
+        std::istringstream in(text);
+        OfflineScript script;
+        std::string error;
+        EXPECT_EQ(BAD_VALUE, OfflineScript::parse(in, &script, &error)) << text;
+        EXPECT_EQ(0u, error.rfind("line ", 0)) << error;
+    }
+
+    std::istringstream in("# comment\n\n0 add 1  # track\n7 start 1\n");
+    OfflineScript script;
+    std::string error;
+    ASSERT_EQ(OK, OfflineScript::parse(in, &script, &error)) << error;
+    EXPECT_EQ(8u, script.periods());
+}
+
+TEST(OfflineScriptTest, CommandFailureNamesTheLine) {
+    std::istringstream in("0 start 4\n");
+    OfflineScript script;
+    std::string error;
+    ASSERT_EQ(OK, OfflineScript::parse(in, &script, &error));
+    OfflineBaseMixer mixer(floatConfig());
+    EXPECT_EQ(BAD_VALUE, script.run(&mixer, &error));
+    EXPECT_EQ("line 1: command failed with status -22", error);
+}
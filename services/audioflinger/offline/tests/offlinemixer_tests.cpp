@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "offlinemixer_tests"
+
+#include "../OfflineScript.h"
+#include "../OfflineThreadMixer.h"
+
+#include <cmath>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+using namespace android;
+using namespace android::audioflinger;
+
+namespace {
+
+constexpr size_t kFrameCount = 480;
+constexpr uint32_t kChannelCount = 2;
+
+OfflineMixer::Config floatConfig() {
+    OfflineMixer::Config config;
+    config.frameCount = kFrameCount;
+    config.sinkFormat = AUDIO_FORMAT_PCM_FLOAT;
+    return config;
+}
+
+OfflineMixer::TrackConfig floatTrack(uint32_t sampleRate = 48000,
+        audio_session_t sessionId = AUDIO_SESSION_OUTPUT_MIX) {
+    OfflineMixer::TrackConfig track;
+    track.format = AUDIO_FORMAT_PCM_FLOAT;
+    track.sampleRate = sampleRate;
+    track.sessionId = sessionId;
+    return track;
+}
+
+// Keeps the periods written by an OfflineMixer.
+struct Output {
+    std::vector<std::vector<float>> periods;
+
+    OfflineMixer::SinkCallback sink() {
+        return [this](const void* buffer, size_t frameCount) {
+            const float* samples = static_cast<const float*>(buffer);
+            periods.emplace_back(samples, samples + frameCount * kChannelCount);
+        };
+    }
+
+    float peak(size_t period) const {
+        float peak = 0.f;
+        for (float sample : periods[period]) {
+            peak = std::max(peak, fabsf(sample));
+        }
+        return peak;
+    }
+};
+
+// Runs periods until track id is no longer active, up to maxPeriods.
+void runUntilInactive(OfflineMixer* mixer, int id, int maxPeriods) {
+    OfflineMixer::TrackStats stats;
+    for (int i = 0; i < maxPeriods; ++i) {
+        mixer->processPeriod();
+        ASSERT_EQ(OK, mixer->getTrackStats(id, &stats));
+        if (!stats.active) return;
+    }
+    FAIL() << "track " << id << " still active after " << maxPeriods << " periods";
+}
+
+std::vector<uint8_t> runScript(const std::string& text) {
+    std::istringstream in(text);
+    OfflineScript script;
+    std::string error;
+    EXPECT_EQ(OK, OfflineScript::parse(in, &script, &error)) << error;
+
+    std::vector<uint8_t> output;
+    OfflineThreadMixer mixer(OfflineMixer::Config{}, [&](const void* buffer, size_t frameCount) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+        output.insert(output.end(), bytes, bytes + frameCount * sizeof(int16_t) * kChannelCount);
+    });
+    EXPECT_EQ(OK, script.run(&mixer, &error)) << error;
+    EXPECT_EQ(script.periods(), mixer.periods());
+    return output;
+}
+
+} // namespace
+
+TEST(OfflineThreadMixerTest, ScriptIsDeterministic) {
+    const std::string text =
+            "0 add 1 signal=noise rate=44100 format=i16\n"
+            "0 add 2 signal=chirp rate=48000 channels=1 format=float session=5\n"
+            "0 effect 5 lowpass=2000\n"
+            "0 start 1\n"
+            "3 start 2\n"
+            "10 starve 2 4\n"
+            "20 pause 1\n"
+            "25 start 1\n"
+            "30 volume 2 0.25\n"
+            "40 stop 1\n"
+            "50 end\n";
+    const std::vector<uint8_t> first = runScript(text);
+    ASSERT_EQ(50u * 960 * sizeof(int16_t) * kChannelCount, first.size());
+    EXPECT_EQ(first, runScript(text));
+}
+
+TEST(OfflineThreadMixerTest, StartRampsPauseRampsDownAndResumes) {
+    Output output;
+    OfflineThreadMixer mixer(floatConfig(), output.sink());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer.start(1));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(mixer.processPeriod());
+    }
+    // the first period has no ramp: the track starts at full volume.
+    EXPECT_GT(output.peak(0), 0.4f);
+
+    ASSERT_EQ(OK, mixer.pause(1));
+    EXPECT_TRUE(mixer.processPeriod());     // ramps down
+    const std::vector<float>& ramp = output.periods.back();
+    EXPECT_LT(fabsf(ramp[ramp.size() - 1]), 1e-3f);
+
+    ASSERT_NO_FATAL_FAILURE(runUntilInactive(&mixer, 1, 5));
+    OfflineMixer::TrackStats stats;
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(OfflineMixer::PAUSED, stats.state);
+    EXPECT_FALSE(stats.active);
+    EXPECT_EQ(0.f, output.peak(output.periods.size() - 1));
+
+    ASSERT_EQ(OK, mixer.start(1));
+    for (int i = 0; i < 3; ++i) {
+        mixer.processPeriod();
+    }
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(OfflineMixer::ACTIVE, stats.state);
+    EXPECT_GT(output.peak(output.periods.size() - 1), 0.4f);
+}
+
+TEST(OfflineThreadMixerTest, StopDrainsTheTrack) {
+    OfflineThreadMixer mixer(floatConfig());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack(44100)));
+    ASSERT_EQ(OK, mixer.start(1));
+    for (int i = 0; i < 10; ++i) {
+        mixer.processPeriod();
+    }
+    ASSERT_EQ(OK, mixer.stop(1));
+    // the track drains, then waits for the frames in the HAL
+    ASSERT_NO_FATAL_FAILURE(runUntilInactive(&mixer, 1, 20));
+    OfflineMixer::TrackStats stats;
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_EQ(OfflineMixer::STOPPED, stats.state);
+    EXPECT_FALSE(stats.active);
+    EXPECT_EQ(stats.framesWritten, stats.framesReleased);
+    EXPECT_EQ(0, stats.underrunFrames);
+    EXPECT_EQ(0u, mixer.activeTracks());
+}
+
+TEST(OfflineThreadMixerTest, UnderrunDisablesTheTrackAfterRetries) {
+    OfflineThreadMixer mixer(floatConfig());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer.addTrack(2, floatTrack()));
+    ASSERT_EQ(OK, mixer.start(1));
+    ASSERT_EQ(OK, mixer.start(2));
+    ASSERT_EQ(OK, mixer.starve(2, 100));
+    for (int i = 0; i < 60; ++i) {
+        mixer.processPeriod();
+    }
+    OfflineMixer::TrackStats stats;
+    ASSERT_EQ(OK, mixer.getTrackStats(2, &stats));
+    EXPECT_TRUE(stats.disabled);
+    EXPECT_FALSE(stats.active);
+    // tallied while track 1 was mixed
+    EXPECT_GT(stats.underrunFrames, 0);
+    ASSERT_EQ(OK, mixer.getTrackStats(1, &stats));
+    EXPECT_TRUE(stats.active);
+    EXPECT_FALSE(stats.disabled);
+}
+
+TEST(OfflineThreadMixerTest, SessionEffectChain) {
+    Output direct, withEffect;
+    OfflineThreadMixer mixer1(floatConfig(), direct.sink());
+    OfflineThreadMixer mixer2(floatConfig(), withEffect.sink());
+    ASSERT_EQ(OK, mixer1.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer2.addTrack(1, floatTrack(48000, (audio_session_t)17)));
+    ASSERT_EQ(OK, mixer2.addEffect((audio_session_t)17, std::make_unique<GainEffect>(0.5f)));
+    ASSERT_EQ(BAD_VALUE, mixer2.addEffect(AUDIO_SESSION_OUTPUT_MIX,
+            std::make_unique<GainEffect>(0.5f)));
+    for (OfflineMixer* mixer : {&mixer1, &mixer2}) {
+        // the effect is started by the first period
+        mixer->processPeriod();
+        ASSERT_EQ(OK, mixer->start(1));
+        for (int i = 0; i < 5; ++i) {
+            mixer->processPeriod();
+        }
+    }
+    ASSERT_EQ(6u, withEffect.periods.size());
+    for (size_t period = 0; period < direct.periods.size(); ++period) {
+        for (size_t i = 0; i < direct.periods[period].size(); ++i) {
+            ASSERT_NEAR(direct.periods[period][i] * 0.5f, withEffect.periods[period][i], 1e-6f);
+        }
+    }
+    // the effects stage is traced.
+    const auto records = mixer2.periodTracer().getRecords();
+    ASSERT_GE(records.size(), 6u);
+    EXPECT_NE(PeriodTracer::kNotRun, records.back().stageEndNs[PeriodTracer::STAGE_EFFECTS]);
+}
+
+TEST(OfflineThreadMixerTest, ResamplingTrackDoesNotUnderrun) {
+    OfflineThreadMixer mixer(floatConfig());
+    for (int id : {1, 2, 3}) {
+        ASSERT_EQ(OK, mixer.addTrack(id, floatTrack(id == 1 ? 44100 : id == 2 ? 22050 : 96000)));
+        ASSERT_EQ(OK, mixer.start(id));
+    }
+    for (int i = 0; i < 500; ++i) {
+        EXPECT_TRUE(mixer.processPeriod());
+    }
+    for (int id : {1, 2, 3}) {
+        OfflineMixer::TrackStats stats;
+        ASSERT_EQ(OK, mixer.getTrackStats(id, &stats));
+        EXPECT_EQ(0, stats.underrunFrames) << "track " << id;
+        EXPECT_TRUE(stats.active) << "track " << id;
+    }
+    EXPECT_EQ(3u, mixer.activeTracks());
+    // and the clock track of the mixer
+    EXPECT_EQ(4, mixer.periodTracer().getRecords().back().activeTracks);
+}
+
+TEST(OfflineThreadMixerTest, RemoveTrack) {
+    OfflineThreadMixer mixer(floatConfig());
+    ASSERT_EQ(OK, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(BAD_VALUE, mixer.addTrack(1, floatTrack()));
+    ASSERT_EQ(OK, mixer.start(1));
+    mixer.processPeriod();
+    ASSERT_EQ(OK, mixer.removeTrack(1));
+    EXPECT_EQ(BAD_VALUE, mixer.start(1));
+    mixer.processPeriod();
+    EXPECT_EQ(0u, mixer.activeTracks());
+    // the id can be reused once removed
+    EXPECT_EQ(OK, mixer.addTrack(1, floatTrack()));
+}
+
+TEST(OfflineThreadMixerTest, InvalidTracks) {
+    OfflineThreadMixer mixer(floatConfig());
+    OfflineMixer::TrackConfig track = floatTrack();
+    track.channelMask = AUDIO_CHANNEL_INVALID;
+    EXPECT_EQ(BAD_VALUE, mixer.addTrack(1, track));
+    track = floatTrack();
+    track.format = AUDIO_FORMAT_MP3;
+    EXPECT_EQ(BAD_VALUE, mixer.addTrack(1, track));
+    EXPECT_EQ(BAD_VALUE, mixer.addTrack(1, floatTrack(0)));
+    EXPECT_EQ(OK, mixer.addTrack(1, floatTrack()));
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "offlinepatch_tests"
+
+#include "../OfflineHal.h"
+#include "../OfflinePatch.h"
+
+#include <gtest/gtest.h>
+
+using namespace android;
+using namespace android::audioflinger;
+
+namespace {
+
+constexpr size_t kFrameCount = 960;   // 20 ms: no FastCapture
+constexpr uint32_t kSampleRate = 48000;
+// past the volume ramp of the start of the patch track, on a period boundary
+constexpr uint64_t kMarkerFrame = 10 * kFrameCount;
+constexpr size_t kMaxPeriods = 40;
+
+OfflinePatch::Config patchConfig(bool direct) {
+    OfflinePatch::Config config;
+    config.sampleRate = kSampleRate;
+    config.inputSampleRate = kSampleRate;
+    config.frameCount = kFrameCount;
+    config.markerFrame = kMarkerFrame;
+    config.direct = direct;
+    return config;
+}
+
+// Returns the latency of the marker through the patch in frames, or -1 if it is not found.
+int64_t markerLatencyFrames(const OfflinePatch::Config& config) {
+    OfflinePatch patch(config);
+    EXPECT_EQ(OK, patch.initCheck());
+    if (patch.initCheck() != OK) return -1;
+    std::vector<float> marker;
+    const int64_t frame = patch.findMarker(kMaxPeriods, &marker);
+    EXPECT_GE(frame, 0) << "marker not found";
+    if (frame < 0) return -1;
+    for (float sample : marker) {
+        EXPECT_NEAR(OfflineStreamInHal::kMarkerValue, sample, 1e-3);
+    }
+    return frame - (int64_t)config.markerFrame;
+}
+
+} // namespace
+
+TEST(OfflinePatch, DirectPatchIsBridgedByPlaybackThread) {
+    OfflinePatch patch(patchConfig(true /* direct */));
+    ASSERT_EQ(OK, patch.initCheck());
+    EXPECT_TRUE(patch.isDirect());
+}
+
+TEST(OfflinePatch, DisabledDirectPatchUsesTwoThreads) {
+    OfflinePatch patch(patchConfig(false /* direct */));
+    ASSERT_EQ(OK, patch.initCheck());
+    EXPECT_FALSE(patch.isDirect());
+}
+
+// The playback thread would need to resample the stream.
+TEST(OfflinePatch, SampleRateMismatchIsNotDirect) {
+    OfflinePatch::Config config = patchConfig(true /* direct */);
+    config.inputSampleRate = 44100;
+    OfflinePatch patch(config);
+    ASSERT_EQ(OK, patch.initCheck());
+    EXPECT_FALSE(patch.isDirect());
+}
+
+// The reused output has other tracks, which the reads of the input stream would delay.
+TEST(OfflinePatch, SharedOutputIsNotDirect) {
+    OfflinePatch::Config config = patchConfig(true /* direct */);
+    config.shareOutput = true;
+    OfflinePatch patch(config);
+    ASSERT_EQ(OK, patch.initCheck());
+    EXPECT_FALSE(patch.isDirect());
+    std::vector<float> marker;
+    EXPECT_GE(patch.findMarker(kMaxPeriods, &marker), (int64_t)kMarkerFrame);
+}
+
+// The 16 bit input is converted to the float output on both paths.
+TEST(OfflinePatch, MarkerIsBridged) {
+    EXPECT_GE(markerLatencyFrames(patchConfig(true /* direct */)), 0);
+    EXPECT_GE(markerLatencyFrames(patchConfig(false /* direct */)), 0);
+}
+
+// The round trip latency of the marker, from the input stream to the output stream.
+TEST(OfflinePatch, DirectLatencyIsNotAboveTwoThreads) {
+    const int64_t directFrames = markerLatencyFrames(patchConfig(true /* direct */));
+    const int64_t twoThreadFrames = markerLatencyFrames(patchConfig(false /* direct */));
+    ASSERT_GE(directFrames, 0);
+    ASSERT_GE(twoThreadFrames, 0);
+    ::testing::Test::RecordProperty("directLatencyFrames", (int)directFrames);
+    ::testing::Test::RecordProperty("twoThreadLatencyFrames", (int)twoThreadFrames);
+    EXPECT_LE(directFrames, twoThreadFrames);
+}
+
+// The latency of a direct patch includes the frames held by the input stream.
+TEST(OfflinePatch, DirectLatencyIncludesInputLatency) {
+    OfflinePatch::Config config = patchConfig(true /* direct */);
+    config.inputLatencyFrames = 4 * kFrameCount;
+    OfflinePatch patch(config);
+    ASSERT_EQ(OK, patch.initCheck());
+    ASSERT_TRUE(patch.isDirect());
+    for (size_t i = 0; i < 20; ++i) {
+        (void)patch.processPeriod();
+    }
+    double latencyMs;
+    ASSERT_EQ(OK, patch.getLatencyMs(&latencyMs));
+    EXPECT_GE(latencyMs, config.inputLatencyFrames * 1e3 / kSampleRate);
+}
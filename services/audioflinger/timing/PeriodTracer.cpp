@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "PeriodTracer"
+
+#include "PeriodTracer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+#include <utils/Log.h>
+
+namespace android::audioflinger {
+
+namespace {
+
+// Durations in ns of one stage, or of the whole period, in the recorded periods.
+struct Percentiles {
+    size_t count = 0;
+    int64_t p50 = 0;
+    int64_t p99 = 0;
+    int64_t max = 0;
+};
+
+Percentiles computePercentiles(std::vector<int64_t>& values) {
+    Percentiles result;
+    result.count = values.size();
+    if (values.empty()) return result;
+    std::sort(values.begin(), values.end());
+    result.p50 = values[(values.size() - 1) * 50 / 100];
+    result.p99 = values[(values.size() - 1) * 99 / 100];
+    result.max = values.back();
+    return result;
+}
+
+} // namespace
+
+const char* PeriodTracer::stageToString(Stage stage) {
+    switch (stage) {
+        case STAGE_PREPARE: return "prepare";
+        case STAGE_MIX: return "mix";
+        case STAGE_EFFECTS: return "effects";
+        case STAGE_WRITE: return "write";
+        default: return "unknown";
+    }
+}
+
+int32_t PeriodTracer::offsetNs(int64_t nowNs) const {
+    return (int32_t)std::clamp(nowNs - mCurrent.startNs,
+            (int64_t)0, (int64_t)std::numeric_limits<int32_t>::max());
+}
+
+void PeriodTracer::beginPeriod(int64_t nowNs) {
+    mCurrent.startNs = nowNs;
+    mCurrent.durationNs = kNotRun;
+    mCurrent.activeTracks = 0;
+    std::fill(std::begin(mCurrent.stageBeginNs), std::end(mCurrent.stageBeginNs), kNotRun);
+    std::fill(std::begin(mCurrent.stageEndNs), std::end(mCurrent.stageEndNs), kNotRun);
+}
+
+void PeriodTracer::endPeriod(size_t activeTracks, int64_t nowNs) {
+    mCurrent.durationNs = offsetNs(nowNs);
+    mCurrent.activeTracks = (int32_t)std::min(activeTracks,
+            (size_t)std::numeric_limits<int32_t>::max());
+
+    const uint64_t ended = mEnded.load(std::memory_order_relaxed);
+    uint32_t words[std::tuple_size_v<Slot>];
+    memcpy(words, &mCurrent, sizeof(words));
+    // Pairs with the fence in getRecords(): a reader which sees any of the words below
+    // also sees the mEnded increment which retired the period previously in the slot.
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot& slot = mRecords[ended % kCapacity];
+    for (size_t i = 0; i < slot.size(); ++i) {
+        slot[i].store(words[i], std::memory_order_relaxed);
+    }
+    // publishes the record.
+    mEnded.store(ended + 1, std::memory_order_release);
+}
+
+std::vector<PeriodTracer::Record> PeriodTracer::getRecords() const {
+    const uint64_t ended = mEnded.load(std::memory_order_acquire);
+    // the slot of period 'ended' is the next one written.
+    const uint64_t first = ended >= kCapacity ? ended - kCapacity + 1 : 0;
+    std::vector<Record> records(ended - first);
+    for (uint64_t i = first; i < ended; ++i) {
+        const Slot& slot = mRecords[i % kCapacity];
+        uint32_t words[std::tuple_size_v<Slot>];
+        for (size_t j = 0; j < slot.size(); ++j) {
+            words[j] = slot[j].load(std::memory_order_relaxed);
+        }
+        memcpy(&records[i - first], words, sizeof(words));
+    }
+    // Drop the records the writer may have overwritten while they were copied.
+    // Period 'endedNow' is written to the slot of period 'endedNow - kCapacity'.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t endedNow = mEnded.load(std::memory_order_relaxed);
+    const uint64_t firstValid = endedNow >= kCapacity ? endedNow - kCapacity + 1 : 0;
+    if (firstValid > first) {
+        records.erase(records.begin(),
+                records.begin() + std::min(firstValid - first, (uint64_t)records.size()));
+    }
+    return records;
+}
+
+std::string PeriodTracer::toString(const std::string& prefix) const {
+    const std::vector<Record> records = getRecords();
+    if (records.empty()) {
+        return prefix + "Period trace: no periods\n";
+    }
+    std::string result = base::StringPrintf(
+            "%sPeriod trace: %zu periods over %.3f s\n"
+            "%s  %-8s %6s %9s %9s %9s\n", prefix.c_str(), records.size(),
+            (records.back().startNs - records.front().startNs) * 1e-9,
+            prefix.c_str(), "stage", "count", "P50 us", "P99 us", "max us");
+
+    std::vector<int64_t> values;
+    values.reserve(records.size());
+    const auto appendLine = [&](const char* name) {
+        const Percentiles p = computePercentiles(values);
+        result.append(base::StringPrintf("%s  %-8s %6zu %9.1f %9.1f %9.1f\n",
+                prefix.c_str(), name, p.count, p.p50 * 1e-3, p.p99 * 1e-3, p.max * 1e-3));
+        values.clear();
+    };
+    for (uint32_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        for (const auto& record : records) {
+            if (record.stageBeginNs[stage] != kNotRun && record.stageEndNs[stage] != kNotRun) {
+                values.push_back(record.stageEndNs[stage] - record.stageBeginNs[stage]);
+            }
+        }
+        appendLine(stageToString(static_cast<Stage>(stage)));
+    }
+    for (const auto& record : records) {
+        values.push_back(record.durationNs);
+    }
+    appendLine("period");
+    // time from the start of a period to the HAL return, when written
+    for (const auto& record : records) {
+        if (record.stageEndNs[STAGE_WRITE] != kNotRun) {
+            values.push_back(record.stageEndNs[STAGE_WRITE]);
+        }
+    }
+    appendLine("to HAL");
+    return result;
+}
+
+bool PeriodTracer::writeBinary(int fd) const {
+    const std::vector<Record> records = getRecords();
+    BinaryHeader header{};
+    memcpy(header.magic, "AFPT", sizeof(header.magic));
+    header.version = kBinaryVersion;
+    header.recordSize = sizeof(Record);
+    header.stageCount = STAGE_COUNT;
+    header.count = (uint32_t)records.size();
+    if (!base::WriteFully(fd, &header, sizeof(header))
+            || !base::WriteFully(fd, records.data(), records.size() * sizeof(Record))) {
+        ALOGW("%s: cannot write %zu records: %s", __func__, records.size(), strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+} // namespace android::audioflinger
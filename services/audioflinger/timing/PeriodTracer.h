@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace android::audioflinger {
+
+/**
+ * PeriodTracer
+ *
+ * Records when each stage of the audio pipeline starts and ends in every period of a
+ * playback thread (prepareTracks_l(), threadLoop_mix(), effects, threadLoop_write() up to
+ * the HAL return), in a ring buffer of kCapacity periods: the period being recorded and
+ * the last kCapacity - 1 ones.
+ *
+ * Recording is meant to be always on: it takes a few clock reads and stores per period,
+ * no locks and no allocation.
+ * The stages of a period are recorded between beginPeriod() and endPeriod() by a single
+ * thread. Any other thread may read the records at the same time with getRecords(),
+ * toString() or writeBinary(); a record being overwritten while read is discarded.
+ */
+class PeriodTracer {
+public:
+    enum Stage : uint32_t {
+        STAGE_PREPARE,  // prepareTracks_l()
+        STAGE_MIX,      // threadLoop_mix(), or AudioMixer::process() on the FastMixer
+        STAGE_EFFECTS,  // effect chains
+        STAGE_WRITE,    // threadLoop_write(), ends on HAL (or sink) return
+        STAGE_COUNT,
+    };
+
+    static constexpr size_t kCapacity = 1024;
+    // Stage times are offsets from the period start, kNotRun if the stage did not run.
+    static constexpr int32_t kNotRun = -1;
+
+    struct Record {
+        int64_t startNs;        // CLOCK_MONOTONIC time of beginPeriod()
+        int32_t durationNs;     // beginPeriod() to endPeriod()
+        int32_t activeTracks;
+        int32_t stageBeginNs[STAGE_COUNT];
+        int32_t stageEndNs[STAGE_COUNT];
+    };
+
+    /**
+     * Layout of writeBinary(): the header followed by header.count Records, oldest first,
+     * in native byte order.
+     */
+    struct BinaryHeader {
+        char magic[4];          // "AFPT"
+        uint32_t version;       // kBinaryVersion
+        uint32_t recordSize;    // sizeof(Record)
+        uint32_t stageCount;    // STAGE_COUNT
+        uint32_t count;
+    };
+    static constexpr uint32_t kBinaryVersion = 1;
+
+    static const char* stageToString(Stage stage);
+
+    static int64_t getNowNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+    }
+
+    /**
+     * Starts recording a new period. A period which was begun but not ended is dropped.
+     */
+    void beginPeriod(int64_t nowNs = getNowNs());
+
+    void beginStage(Stage stage, int64_t nowNs = getNowNs()) {
+        mCurrent.stageBeginNs[stage] = offsetNs(nowNs);
+    }
+
+    void endStage(Stage stage, int64_t nowNs = getNowNs()) {
+        mCurrent.stageEndNs[stage] = offsetNs(nowNs);
+    }
+
+    /**
+     * Completes the period and makes it visible to readers.
+     *
+     * \param activeTracks  number of tracks served during the period.
+     */
+    void endPeriod(size_t activeTracks, int64_t nowNs = getNowNs());
+
+    /**
+     * Returns the recorded periods, oldest first.
+     */
+    [[nodiscard]] std::vector<Record> getRecords() const;
+
+    /**
+     * Returns the P50, P99 and max of each stage and of the whole period, one line each.
+     */
+    [[nodiscard]] std::string toString(const std::string& prefix = "") const;
+
+    /**
+     * Writes the records to fd in the BinaryHeader format.
+     *
+     * \return true on success.
+     */
+    bool writeBinary(int fd) const;
+
+private:
+    // A Record stored as relaxed atomic words, so that a reader racing with the writer
+    // reads stale or torn values instead of causing undefined behavior.
+    static_assert(std::is_trivially_copyable_v<Record> && sizeof(Record) % sizeof(uint32_t) == 0);
+    using Slot = std::array<std::atomic<uint32_t>, sizeof(Record) / sizeof(uint32_t)>;
+
+    int32_t offsetNs(int64_t nowNs) const;
+
+    Record mCurrent{};  // period being recorded, only accessed by the writer
+    std::array<Slot, kCapacity> mRecords{};
+    // Number of periods ended so far; mRecords[mEnded % kCapacity] is the next one written.
+    std::atomic<uint64_t> mEnded{0};
+};
+
+} // namespace android::audioflinger
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "periodtracer_tests"
+
+#include "../PeriodTracer.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+#include <android-base/scopeguard.h>
+#include <gtest/gtest.h>
+
+using namespace android::audioflinger;
+
+namespace {
+
+// Records a period of 'periodNs' starting at 'startNs' where every stage runs for 'stageNs'.
+void recordPeriod(PeriodTracer* tracer, int64_t startNs, int64_t stageNs, int64_t periodNs,
+        size_t activeTracks = 1) {
+    tracer->beginPeriod(startNs);
+    int64_t nowNs = startNs;
+    for (uint32_t stage = 0; stage < PeriodTracer::STAGE_COUNT; ++stage) {
+        const auto s = static_cast<PeriodTracer::Stage>(stage);
+        tracer->beginStage(s, nowNs);
+        nowNs += stageNs;
+        tracer->endStage(s, nowNs);
+    }
+    tracer->endPeriod(activeTracks, startNs + periodNs);
+}
+
+TEST(PeriodTracerTest, RecordsStages) {
+    auto tracer = std::make_unique<PeriodTracer>();
+    EXPECT_TRUE(tracer->getRecords().empty());
+
+    recordPeriod(tracer.get(), 1000, 100, 5000, 3 /* activeTracks */);
+    // a period where only the mixer ran
+    tracer->beginPeriod(10000);
+    tracer->beginStage(PeriodTracer::STAGE_MIX, 10200);
+    tracer->endStage(PeriodTracer::STAGE_MIX, 10500);
+    tracer->endPeriod(2, 15000);
+    // a period which is not ended is not recorded
+    tracer->beginPeriod(20000);
+    tracer->beginStage(PeriodTracer::STAGE_PREPARE, 20100);
+
+    const auto records = tracer->getRecords();
+    ASSERT_EQ(2u, records.size());
+    EXPECT_EQ(1000, records[0].startNs);
+    EXPECT_EQ(5000, records[0].durationNs);
+    EXPECT_EQ(3, records[0].activeTracks);
+    EXPECT_EQ(0, records[0].stageBeginNs[PeriodTracer::STAGE_PREPARE]);
+    EXPECT_EQ(400, records[0].stageEndNs[PeriodTracer::STAGE_WRITE]);
+
+    EXPECT_EQ(PeriodTracer::kNotRun, records[1].stageBeginNs[PeriodTracer::STAGE_PREPARE]);
+    EXPECT_EQ(200, records[1].stageBeginNs[PeriodTracer::STAGE_MIX]);
+    EXPECT_EQ(500, records[1].stageEndNs[PeriodTracer::STAGE_MIX]);
+    EXPECT_EQ(PeriodTracer::kNotRun, records[1].stageEndNs[PeriodTracer::STAGE_WRITE]);
+}
+
+TEST(PeriodTracerTest, KeepsLastPeriods) {
+    auto tracer = std::make_unique<PeriodTracer>();
+    constexpr size_t kPeriods = PeriodTracer::kCapacity * 2 + 10;
+    for (size_t i = 0; i < kPeriods; ++i) {
+        recordPeriod(tracer.get(), i * 5000, 100, 5000);
+    }
+    const auto records = tracer->getRecords();
+    ASSERT_EQ(PeriodTracer::kCapacity - 1, records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        EXPECT_EQ((int64_t)((kPeriods - records.size() + i) * 5000), records[i].startNs);
+    }
+}
+
+TEST(PeriodTracerTest, Percentiles) {
+    auto tracer = std::make_unique<PeriodTracer>();
+    // 100 periods with stages of 1..100 us
+    for (int64_t i = 1; i <= 100; ++i) {
+        recordPeriod(tracer.get(), i * 10'000'000, i * 1000, 5'000'000);
+    }
+    const std::string dump = tracer->toString("  ");
+    SCOPED_TRACE(dump);
+    EXPECT_NE(std::string::npos, dump.find("100 periods"));
+    EXPECT_NE(std::string::npos, dump.find("mix         100      50.0      99.0     100.0"));
+    EXPECT_NE(std::string::npos, dump.find("period      100    5000.0    5000.0    5000.0"));
+    EXPECT_NE(std::string::npos, dump.find("to HAL      100     200.0     396.0     400.0"));
+}
+
+TEST(PeriodTracerTest, WriteBinary) {
+    auto tracer = std::make_unique<PeriodTracer>();
+    for (size_t i = 0; i < 10; ++i) {
+        recordPeriod(tracer.get(), i * 5000, 100, 5000);
+    }
+    FILE* file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_TRUE(tracer->writeBinary(fileno(file)));
+    rewind(file);
+
+    PeriodTracer::BinaryHeader header;
+    ASSERT_EQ(1u, fread(&header, sizeof(header), 1, file));
+    EXPECT_EQ(0, memcmp(header.magic, "AFPT", 4));
+    EXPECT_EQ(PeriodTracer::kBinaryVersion, header.version);
+    EXPECT_EQ(sizeof(PeriodTracer::Record), header.recordSize);
+    EXPECT_EQ((uint32_t)PeriodTracer::STAGE_COUNT, header.stageCount);
+    ASSERT_EQ(10u, header.count);
+    PeriodTracer::Record records[10];
+    ASSERT_EQ(10u, fread(records, sizeof(PeriodTracer::Record), 10, file));
+    EXPECT_EQ(9 * 5000, records[9].startNs);
+    fclose(file);
+}
+
+// Records are read while the periods are recorded; every record read must be complete.
+TEST(PeriodTracerTest, ConcurrentReader) {
+    auto tracer = std::make_unique<PeriodTracer>();
+    std::atomic<bool> done = false;
+    std::thread writer([&] {
+        for (int64_t i = 0; i < 200'000; ++i) {
+            recordPeriod(tracer.get(), i, 10, 50);
+        }
+        done = true;
+    });
+    // an ASSERT failure returns early; the writer must still be joined.
+    const auto joinWriter = android::base::make_scope_guard([&] { writer.join(); });
+    while (!done) {
+        for (const auto& record : tracer->getRecords()) {
+            ASSERT_EQ(50, record.durationNs);
+            ASSERT_EQ(40, record.stageEndNs[PeriodTracer::STAGE_WRITE]);
+        }
+    }
+}
+
+} // namespace
@@ -17,6 +17,7 @@
 #define LOG_TAG "AAudioCommandQueue"
 //#define LOG_NDEBUG 0
 
+#include <algorithm>
 #include <chrono>
 
 #include <utils/Log.h>
@@ -35,6 +36,9 @@ aaudio_result_t AAudioCommandQueue::sendCommand(const std::shared_ptr<AAudioComm
         mCommands.push(command);
         mWaitWorkCond.notify_one();
     }
+    if (mCommandRing != nullptr) {
+        mCommandRing->ringDoorbell();
+    }
 
     std::unique_lock _cl(command->lock);
     android::base::ScopedLockAssertion lockAssertion(command->lock);
@@ -57,6 +61,9 @@ aaudio_result_t AAudioCommandQueue::sendCommand(const std::shared_ptr<AAudioComm
 }
 
 std::shared_ptr<AAudioCommand> AAudioCommandQueue::waitForCommand(int64_t timeoutNanos) {
+    if (mCommandRing != nullptr) {
+        return waitForCommandOrRing(timeoutNanos);
+    }
     std::shared_ptr<AAudioCommand> command;
     {
         std::unique_lock _l(mLock);
@@ -80,6 +87,39 @@ std::shared_ptr<AAudioCommand> AAudioCommandQueue::waitForCommand(int64_t timeou
     return command;
 }
 
+// The doorbell is rung after a command is pushed by sendCommand() or written in the ring,
+// so reading it before checking both of them cannot miss a wake up.
+std::shared_ptr<AAudioCommand> AAudioCommandQueue::waitForCommandOrRing(int64_t timeoutNanos) {
+    const int64_t deadlineNanos = timeoutNanos >= 0
+            ? AudioClock::getNanoseconds() + timeoutNanos : INT64_MAX;
+    while (true) {
+        const uint32_t doorbell = mCommandRing->getDoorbell();
+        {
+            std::scoped_lock<std::mutex> _l(mLock);
+            if (!mRunning) {
+                return nullptr;
+            }
+            if (!mCommands.empty()) {
+                auto command = mCommands.front();
+                mCommands.pop();
+                return command;
+            }
+        }
+        if (mCommandRing->hasCommand()) {
+            return nullptr; // the caller takes the commands from the ring
+        }
+        const int64_t remainingNanos = deadlineNanos - AudioClock::getNanoseconds();
+        if (remainingNanos <= 0) {
+            return nullptr;
+        }
+        mCommandRing->waitForDoorbell(doorbell, std::min(remainingNanos, kMaxRingWaitNanos));
+    }
+}
+
+void AAudioCommandQueue::setCommandRing(AAudioCommandRing *commandRing) {
+    mCommandRing = commandRing;
+}
+
 void AAudioCommandQueue::startWaiting() {
     std::scoped_lock<std::mutex> _l(mLock);
     mRunning = true;
@@ -102,6 +142,9 @@ void AAudioCommandQueue::stopWaiting() {
         }
     }
     mWaitWorkCond.notify_one();
+    if (mCommandRing != nullptr) {
+        mCommandRing->ringDoorbell();
+    }
 }
 
 } // namespace aaudio
\ No newline at end of file
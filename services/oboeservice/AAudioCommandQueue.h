@@ -24,6 +24,9 @@
 #include <aaudio/AAudio.h>
 #include <android-base/thread_annotations.h>
 
+#include "binding/AAudioCommandRing.h"
+#include "utility/AudioClock.h"
+
 namespace aaudio {
 
 using aaudio_command_opcode = int32_t;
@@ -77,6 +80,14 @@ public:
      */
     std::shared_ptr<AAudioCommand> waitForCommand(int64_t timeoutNanos = -1);
 
+    /**
+     * Also wake up waitForCommand() when the client sends a command through the ring.
+     * Must be called before startWaiting(). The ring must outlive the queue.
+     *
+     * @param commandRing a configured command ring shared with the client
+     */
+    void setCommandRing(AAudioCommandRing *commandRing);
+
     /**
      * Start waiting for commands. Commands can only be pushed into the command queue after it
      * starts waiting.
@@ -89,6 +100,13 @@ public:
     void stopWaiting();
 
 private:
+    std::shared_ptr<AAudioCommand> waitForCommandOrRing(int64_t timeoutNanos);
+
+    // The client can also write the doorbell, so a wait is capped in case it hid a wake up.
+    static constexpr int64_t kMaxRingWaitNanos = AAUDIO_NANOS_PER_SECOND;
+
+    AAudioCommandRing *mCommandRing = nullptr;
+
     std::mutex mLock;
     std::condition_variable mWaitWorkCond;
 
@@ -97,6 +97,7 @@ std::string AAudioEndpointManager::dump() const NO_THREAD_SAFETY_ANALYSIS {
     result << "  SharedFoundCount:      " << mSharedFoundCount << "\n";
     result << "  SharedOpenCount:       " << mSharedOpenCount << "\n";
     result << "  SharedCloseCount:      " << mSharedCloseCount << "\n";
+    result << "  SharedStolenCount:     " << mSharedStolenCount << "\n";
     result << "\n";
 
     if (isSharedLocked) {
@@ -127,20 +128,20 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::findExclusiveEndpoint_l(
 
 // Try to find an existing endpoint.
 sp<AAudioServiceEndpointShared> AAudioEndpointManager::findSharedEndpoint_l(
-        const AAudioStreamConfiguration &configuration) {
+        const AAudioStreamConfiguration &configuration, bool powerOptimized) {
     sp<AAudioServiceEndpointShared> endpoint;
     mSharedSearchCount++;
     for (const auto& ep  : mSharedStreams) {
-        if (ep->matches(configuration)) {
+        if (ep->isPowerOptimized() == powerOptimized && ep->matches(configuration)) {
             mSharedFoundCount++;
             endpoint = ep;
             break;
         }
     }
 
-    ALOGV("findSharedEndpoint_l(), found %p for devices = %s, sessionId = %d",
+    ALOGV("findSharedEndpoint_l(), found %p for devices = %s, sessionId = %d, power = %d",
           endpoint.get(), toString(configuration.getDeviceIds()).c_str(),
-          configuration.getSessionId());
+          configuration.getSessionId(), powerOptimized);
     return endpoint;
 }
 
@@ -155,7 +156,17 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openEndpoint(AAudioService &aud
         }
         return foundEndpoint;
     } else {
-        return openSharedEndpoint(audioService, request);
+        sp<AAudioServiceEndpointShared> endpointToSteal;
+        sp<AAudioServiceEndpoint> foundEndpoint =
+                openSharedEndpoint(audioService, request, endpointToSteal);
+        if (endpointToSteal.get()) {
+            // Low latency streams take priority over power optimized ones for the MMAP device.
+            // The disconnected streams can reopen, and then join the low latency endpoint.
+            endpointToSteal->releaseRegisteredStreams(); // free the MMAP resource
+            endpointToSteal.clear();
+            foundEndpoint = openSharedEndpoint(audioService, request, endpointToSteal);
+        }
+        return foundEndpoint;
     }
 }
 
@@ -218,15 +229,17 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openExclusiveEndpoint(
 
 sp<AAudioServiceEndpoint> AAudioEndpointManager::openSharedEndpoint(
         AAudioService &aaudioService,
-        const aaudio::AAudioStreamRequest &request) {
+        const aaudio::AAudioStreamRequest &request,
+        sp<AAudioServiceEndpointShared> &endpointToSteal) {
 
     const std::lock_guard<std::mutex> lock(mSharedLock);
 
     const AAudioStreamConfiguration &configuration = request.getConstantConfiguration();
     const aaudio_direction_t direction = configuration.getDirection();
+    const bool powerOptimized = AAudioServiceEndpointShared::isPowerOptimized(configuration);
 
     // Try to find an existing endpoint.
-    sp<AAudioServiceEndpointShared> endpoint = findSharedEndpoint_l(configuration);
+    sp<AAudioServiceEndpointShared> endpoint = findSharedEndpoint_l(configuration, powerOptimized);
 
     // If we can't find an existing one then open a new one.
     if (endpoint.get() == nullptr) {
@@ -256,6 +269,23 @@ sp<AAudioServiceEndpoint> AAudioEndpointManager::openSharedEndpoint(
               __func__, endpoint.get(), android::toString(configuration.getDeviceIds()).c_str(),
               (int)direction);
         IPCThreadState::self()->restoreCallingIdentity(token);
+
+        // The MMAP device may already be held by the other endpoint.
+        if (endpoint.get() == nullptr && powerOptimized) {
+            // Mix into the low latency endpoint rather than falling back to a legacy stream.
+            endpoint = findSharedEndpoint_l(configuration, false /* powerOptimized */);
+            ALOGD_IF(endpoint.get() != nullptr,
+                     "%s() power optimized endpoint not available, use low latency %p",
+                     __func__, endpoint.get());
+        } else if (endpoint.get() == nullptr) {
+            // Let the caller release the power optimized endpoint, outside of the lock.
+            endpointToSteal = findSharedEndpoint_l(configuration, true /* powerOptimized */);
+            if (endpointToSteal.get() != nullptr) {
+                ALOGD("%s() low latency endpoint not available, steal power optimized %p",
+                      __func__, endpointToSteal.get());
+                mSharedStolenCount++;
+            }
+        }
     }
 
     if (endpoint.get() != nullptr) {
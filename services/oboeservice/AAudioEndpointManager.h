@@ -73,17 +73,21 @@ private:
             sp<AAudioServiceEndpoint> &endpointToSteal)
             EXCLUDES(mExclusiveLock);
 
+    // If a low latency endpoint cannot be opened because a power optimized endpoint holds
+    // the MMAP device, that endpoint is returned in endpointToSteal.
     android::sp<AAudioServiceEndpoint> openSharedEndpoint(
             android::AAudioService &aaudioService,
-            const aaudio::AAudioStreamRequest &request)
+            const aaudio::AAudioStreamRequest &request,
+            sp<AAudioServiceEndpointShared> &endpointToSteal)
             EXCLUDES(mSharedLock);
 
     android::sp<AAudioServiceEndpoint> findExclusiveEndpoint_l(
             const AAudioStreamConfiguration& configuration)
             REQUIRES(mExclusiveLock);
 
+    // Power optimized and low latency streams do not share the same endpoint.
     android::sp<AAudioServiceEndpointShared> findSharedEndpoint_l(
-            const AAudioStreamConfiguration& configuration)
+            const AAudioStreamConfiguration& configuration, bool powerOptimized)
             REQUIRES(mSharedLock)
             EXCLUDES(mExclusiveLock);
 
@@ -114,6 +118,7 @@ private:
     int32_t mSharedFoundCount     GUARDED_BY(mSharedLock) = 0;
     int32_t mSharedOpenCount      GUARDED_BY(mSharedLock) = 0;
     int32_t mSharedCloseCount     GUARDED_BY(mSharedLock) = 0;
+    int32_t mSharedStolenCount    GUARDED_BY(mSharedLock) = 0; // # power optimized STOLEN
 
     // For easily disabling the stealing of exclusive streams.
     static constexpr bool kStealingEnabled = true;
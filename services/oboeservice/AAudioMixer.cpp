@@ -29,6 +29,14 @@
 #define AAUDIO_MIXER_ATRACE_ENABLED    1
 #endif
 
+#if defined(__aarch64__) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define AAUDIO_MIXER_USE_NEON    1
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#define AAUDIO_MIXER_USE_SSE     1
+#endif
+
 using android::WrappingBuffer;
 using android::FifoBuffer;
 using android::fifo_frames_t;
@@ -45,11 +53,19 @@ void AAudioMixer::clear() {
     memset(mOutputBuffer.get(), 0, mBufferSizeInBytes);
 }
 
-int32_t AAudioMixer::mix(
-        int streamIndex, const std::shared_ptr<FifoBuffer>& fifo, bool allowUnderflow) {
+int32_t AAudioMixer::mix(int streamIndex, const std::shared_ptr<FifoBuffer>& fifo,
+                         bool allowUnderflow, float gain, float previousGain) {
     WrappingBuffer wrappingBuffer;
     float *destination = mOutputBuffer.get();
 
+    // Ramp from the previous gain to reach the new gain on the last frame of the burst.
+    float gainIncrement = 0.0f;
+    float partGain = gain;
+    if (gain != previousGain) {
+        gainIncrement = (gain - previousGain) / mFramesPerBurst;
+        partGain = previousGain + gainIncrement;
+    }
+
 #if AAUDIO_MIXER_ATRACE_ENABLED
     ATRACE_BEGIN("aaMix");
 #endif /* AAUDIO_MIXER_ATRACE_ENABLED */
@@ -88,10 +104,11 @@ int32_t AAudioMixer::mix(
             if (framesToMixFromPart > framesAvailableFromPart) {
                 framesToMixFromPart = framesAvailableFromPart;
             }
-            mixPart(destination, (float *)wrappingBuffer.data[partIndex],
-                    framesToMixFromPart);
+            mixPart(destination, (const float *)wrappingBuffer.data[partIndex],
+                    framesToMixFromPart, partGain, gainIncrement);
 
             destination += framesToMixFromPart * mSamplesPerFrame;
+            partGain += gainIncrement * framesToMixFromPart;
             framesLeft -= framesToMixFromPart;
         }
         partIndex++;
@@ -105,11 +122,71 @@ int32_t AAudioMixer::mix(
     return (framesDesired - framesLeft); // framesRead
 }
 
-void AAudioMixer::mixPart(float *destination, float *source, int32_t numFrames) {
-    int32_t numSamples = numFrames * mSamplesPerFrame;
-    // TODO maybe optimize using SIMD
-    for (int sampleIndex = 0; sampleIndex < numSamples; sampleIndex++) {
-        *destination++ += *source++;
+// Accumulate source into destination with a constant gain, 4 samples at a time.
+// @return number of samples mixed, the caller mixes the remaining samples
+static int32_t mixSamplesSimd(float *destination, const float *source, int32_t numSamples,
+                              float gain) {
+    int32_t sampleIndex = 0;
+#if defined(AAUDIO_MIXER_USE_NEON)
+    if (gain == 1.0f) {
+        for (; sampleIndex + 4 <= numSamples; sampleIndex += 4) {
+            vst1q_f32(destination + sampleIndex, vaddq_f32(vld1q_f32(destination + sampleIndex),
+                                                           vld1q_f32(source + sampleIndex)));
+        }
+    } else {
+        const float32x4_t gains = vdupq_n_f32(gain);
+        for (; sampleIndex + 4 <= numSamples; sampleIndex += 4) {
+            vst1q_f32(destination + sampleIndex, vmlaq_f32(vld1q_f32(destination + sampleIndex),
+                                                           vld1q_f32(source + sampleIndex),
+                                                           gains));
+        }
+    }
+#elif defined(AAUDIO_MIXER_USE_SSE)
+    if (gain == 1.0f) {
+        for (; sampleIndex + 4 <= numSamples; sampleIndex += 4) {
+            _mm_storeu_ps(destination + sampleIndex,
+                          _mm_add_ps(_mm_loadu_ps(destination + sampleIndex),
+                                     _mm_loadu_ps(source + sampleIndex)));
+        }
+    } else {
+        const __m128 gains = _mm_set1_ps(gain);
+        for (; sampleIndex + 4 <= numSamples; sampleIndex += 4) {
+            _mm_storeu_ps(destination + sampleIndex,
+                          _mm_add_ps(_mm_loadu_ps(destination + sampleIndex),
+                                     _mm_mul_ps(_mm_loadu_ps(source + sampleIndex), gains)));
+        }
+    }
+#else
+    (void) destination;
+    (void) source;
+    (void) numSamples;
+    (void) gain;
+#endif
+    return sampleIndex;
+}
+
+void AAudioMixer::mixPart(float *destination, const float *source, int32_t numFrames,
+                          float gain, float gainIncrement) {
+    if (gainIncrement != 0.0f) {
+        // Ramps only last for one burst after a gain change, so keep them simple.
+        for (int32_t frameIndex = 0; frameIndex < numFrames; frameIndex++) {
+            for (int32_t channel = 0; channel < mSamplesPerFrame; channel++) {
+                *destination++ += *source++ * gain;
+            }
+            gain += gainIncrement;
+        }
+        return;
+    }
+    const int32_t numSamples = numFrames * mSamplesPerFrame;
+    int32_t sampleIndex = mixSamplesSimd(destination, source, numSamples, gain);
+    if (gain == 1.0f) {
+        for (; sampleIndex < numSamples; sampleIndex++) {
+            destination[sampleIndex] += source[sampleIndex];
+        }
+    } else {
+        for (; sampleIndex < numSamples; sampleIndex++) {
+            destination[sampleIndex] += source[sampleIndex] * gain;
+        }
     }
 }
 
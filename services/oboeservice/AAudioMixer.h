@@ -35,18 +35,28 @@ public:
      * @param streamIndex for marking stream variables in systrace
      * @param fifo to read from
      * @param allowUnderflow if true then allow mixer to advance read index past the write index
+     * @param gain to apply to this stream at the end of the burst
+     * @param previousGain applied to this stream at the end of the previous burst.
+     *        If different, the gain is ramped linearly over the burst to avoid a click.
      * @return frames read from this stream
      */
     int32_t mix(int streamIndex,
                 const std::shared_ptr<android::FifoBuffer>& fifo,
-                bool allowUnderflow);
+                bool allowUnderflow,
+                float gain = 1.0f,
+                float previousGain = 1.0f);
 
     float *getOutputBuffer();
 
     int32_t getFramesPerBurst() const { return mFramesPerBurst; }
 
 private:
-    void mixPart(float *destination, float *source, int32_t numFrames);
+    /**
+     * Accumulate source into destination, scaled by gain.
+     * @param gainIncrement added to the gain after each frame, for a ramp
+     */
+    void mixPart(float *destination, const float *source, int32_t numFrames,
+                 float gain, float gainIncrement);
 
     std::unique_ptr<float[]> mOutputBuffer;
     int32_t  mSamplesPerFrame = 0;
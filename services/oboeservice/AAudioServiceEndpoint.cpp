@@ -104,6 +104,7 @@ std::vector<android::sp<AAudioServiceStreamBase>>
     {
         const std::lock_guard<std::mutex> lock(mLockStreams);
         mRegisteredStreams.swap(streamsDisconnected);
+        publishRegisteredStreams_l();
     }
     mConnected.store(false);
     // We need to stop all the streams before we disconnect them.
@@ -137,6 +138,7 @@ void AAudioServiceEndpoint::releaseRegisteredStreams() {
 aaudio_result_t AAudioServiceEndpoint::registerStream(const sp<AAudioServiceStreamBase>& stream) {
     const std::lock_guard<std::mutex> lock(mLockStreams);
     mRegisteredStreams.push_back(stream);
+    publishRegisteredStreams_l();
     return AAUDIO_OK;
 }
 
@@ -145,6 +147,7 @@ aaudio_result_t AAudioServiceEndpoint::unregisterStream(const sp<AAudioServiceSt
     mRegisteredStreams.erase(std::remove(
             mRegisteredStreams.begin(), mRegisteredStreams.end(), stream),
                              mRegisteredStreams.end());
+    publishRegisteredStreams_l();
     return AAUDIO_OK;
 }
 
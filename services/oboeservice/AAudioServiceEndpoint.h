@@ -19,6 +19,7 @@
 
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -31,6 +32,7 @@
 #include "binding/AAudioStreamConfiguration.h"
 
 #include "AAudioServiceStreamBase.h"
+#include "SnapshotDoubleBuffer.h"
 
 namespace aaudio {
 
@@ -156,9 +158,25 @@ protected:
     std::vector<android::sp<AAudioServiceStreamBase>> disconnectRegisteredStreams()
             EXCLUDES(mLockStreams);
 
+    using RegisteredStreams = std::vector<android::sp<AAudioServiceStreamBase>>;
+
+    /**
+     * The registered streams, read by the data callback thread without locking mLockStreams.
+     *
+     * Only hold it for one burst: registerStream(), unregisterStream() and
+     * disconnectRegisteredStreams() wait for the end of the current scope, so that a stream
+     * is not used after it is unregistered, and the last reference to a stream is not
+     * dropped by a real-time thread.
+     */
+    class ScopedRegisteredStreams : public SnapshotDoubleBuffer<RegisteredStreams>::Reader {
+    public:
+        explicit ScopedRegisteredStreams(AAudioServiceEndpoint& endpoint)
+                : SnapshotDoubleBuffer<RegisteredStreams>::Reader(
+                        endpoint.mRegisteredStreamsSnapshot) {}
+    };
+
     mutable std::mutex       mLockStreams;
-    std::vector<android::sp<AAudioServiceStreamBase>> mRegisteredStreams
-            GUARDED_BY(mLockStreams);
+    RegisteredStreams        mRegisteredStreams GUARDED_BY(mLockStreams);
 
     SimpleDoubleBuffer<Timestamp>  mAtomicEndpointTimestamp;
 
@@ -173,6 +191,16 @@ protected:
 
     std::atomic<bool>        mConnected{true};
 
+private:
+    // Publish a copy of mRegisteredStreams to the data callback thread.
+    // Holding mLockStreams keeps the copies in order. The wait for the end of the current
+    // scope is short because the data callback thread never locks mLockStreams.
+    void publishRegisteredStreams_l() REQUIRES(mLockStreams) {
+        mRegisteredStreamsSnapshot.write(mRegisteredStreams);
+    }
+
+    SnapshotDoubleBuffer<RegisteredStreams> mRegisteredStreamsSnapshot;
+
 };
 
 } /* namespace aaudio */
@@ -75,9 +75,9 @@ void *AAudioServiceEndpointCapture::callbackLoop() {
         }
 
         // Distribute data to each active stream.
-        { // brackets are for lock_guard
-            std::lock_guard <std::mutex> lock(mLockStreams);
-            for (const auto& clientStream : mRegisteredStreams) {
+        { // brackets are for the snapshot, which must be released before the blocking read
+            const ScopedRegisteredStreams registeredStreams(*this);
+            for (const auto& clientStream : *registeredStreams) {
                 if (clientStream->isRunning() && !clientStream->isSuspended()) {
                     sp<AAudioServiceStreamShared> streamShared =
                             static_cast<AAudioServiceStreamShared *>(clientStream.get());
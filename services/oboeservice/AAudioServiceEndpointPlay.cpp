@@ -74,12 +74,12 @@ void *AAudioServiceEndpointPlay::callbackLoop() {
         // Mix data from each active stream.
         mMixer.clear();
 
-        { // brackets are for lock_guard
+        { // brackets are for the snapshot, which must be released before the blocking write
             int index = 0;
             int64_t mmapFramesWritten = getStreamInternal()->getFramesWritten();
 
-            std::lock_guard <std::mutex> lock(mLockStreams);
-            for (const auto& clientStream : mRegisteredStreams) {
+            const ScopedRegisteredStreams registeredStreams(*this);
+            for (const auto& clientStream : *registeredStreams) {
                 int64_t clientFramesRead = 0;
                 bool allowUnderflow = true;
 
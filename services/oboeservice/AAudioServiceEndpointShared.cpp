@@ -39,6 +39,8 @@ using namespace aaudio;
 
 // This is the maximum size in frames. The effective size can be tuned smaller at runtime.
 #define DEFAULT_BUFFER_CAPACITY   (48 * 8)
+// For the power optimized endpoint, whose burst is at most a quarter of the capacity.
+#define POWER_OPTIMIZED_BUFFER_CAPACITY   (48 * 160)
 
 AAudioServiceEndpointShared::AAudioServiceEndpointShared(AudioStreamInternal *streamInternal)
     : mStreamInternal(streamInternal) {}
@@ -51,6 +53,7 @@ std::string AAudioServiceEndpointShared::dump() const {
            << std::hex << mStreamInternal->getServiceHandle()
            << std::dec << std::setfill(' ');
     result << ", XRuns = " << mStreamInternal->getXRunCount();
+    result << (isPowerOptimized() ? ", power optimized" : ", low latency");
     result << "\n";
     result << "    Running Stream Count: " << mRunningStreamCount << "\n";
 
@@ -65,15 +68,23 @@ aaudio_result_t AAudioServiceEndpointShared::open(const aaudio::AAudioStreamRequ
 
     copyFrom(configuration);
     mRequestedDeviceId = android::getFirstDeviceId(configuration.getDeviceIds());
+    // The performance mode tells which endpoint this is, see AAudioEndpointManager.
+    const bool powerOptimized = isPowerOptimized(configuration);
+    setPerformanceMode(powerOptimized ? AAUDIO_PERFORMANCE_MODE_POWER_SAVING
+                                      : AAUDIO_PERFORMANCE_MODE_LOW_LATENCY);
 
     AudioStreamBuilder builder;
     builder.copyFrom(configuration);
+    builder.setPerformanceMode(getPerformanceMode());
 
     builder.setSharingMode(AAUDIO_SHARING_MODE_EXCLUSIVE);
     // Don't fall back to SHARED because that would cause recursion.
     builder.setSharingModeMatchRequired(true);
 
-    builder.setBufferCapacity(DEFAULT_BUFFER_CAPACITY);
+    // The internal stream scales up its burst to a quarter of this capacity
+    // when it is power optimized.
+    builder.setBufferCapacity(powerOptimized ? POWER_OPTIMIZED_BUFFER_CAPACITY
+                                             : DEFAULT_BUFFER_CAPACITY);
 
     // Each shared stream will use its own SRC.
     builder.setSampleRate(AAUDIO_UNSPECIFIED);
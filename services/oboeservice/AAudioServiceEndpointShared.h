@@ -62,6 +62,20 @@ public:
         return mStreamInternal.get();
     };
 
+    /**
+     * Should the streams with this configuration share a power optimized endpoint?
+     * That endpoint uses much larger bursts than the low latency one, so it wakes up less often.
+     * Only SHARED output streams with AAUDIO_PERFORMANCE_MODE_POWER_SAVING do.
+     */
+    static bool isPowerOptimized(const AAudioStreamParameters &parameters) {
+        return parameters.getDirection() == AAUDIO_DIRECTION_OUTPUT
+                && parameters.getPerformanceMode() == AAUDIO_PERFORMANCE_MODE_POWER_SAVING;
+    }
+
+    bool isPowerOptimized() const {
+        return getPerformanceMode() == AAUDIO_PERFORMANCE_MODE_POWER_SAVING;
+    }
+
 protected:
 
     aaudio_result_t          startSharingThread_l() REQUIRES(mLockStreams);
@@ -162,6 +162,21 @@ aaudio_result_t AAudioServiceStreamBase::open(const aaudio::AAudioStreamRequest
             goto error;
         }
 
+        // Without a command ring, the client falls back to Binder.
+        mDownMessageQueue = std::make_shared<SharedRingBuffer>();
+        if (mDownMessageQueue->allocate(AAudioCommandRing::kBytesPerFrame,
+                                        AAudioCommandRing::kCapacityInFrames) == AAUDIO_OK) {
+            RingBufferDescriptor descriptor;
+            mDownMessageQueue->fillDescriptor(&descriptor);
+            if (mCommandRing.configure(descriptor) == AAUDIO_OK) {
+                mCommandQueue.setCommandRing(&mCommandRing);
+            }
+        }
+        if (!mCommandRing.isConfigured()) {
+            ALOGW("%s() could not set up the command ring", __func__);
+            mDownMessageQueue.reset();
+        }
+
         // This is not protected by a lock because the stream cannot be
         // referenced until the service returns a handle to the client.
         // So only one thread can open a stream.
@@ -422,6 +437,33 @@ void AAudioServiceStreamBase::run() {
     // run with holding the lock.
     std::scoped_lock<std::mutex> _l(mLock);
 
+    // Start, pause, stop and flush are sent with Binder or through the command ring.
+    auto runControlCommand = [&](aaudio_command_opcode opCode) -> aaudio_result_t {
+        android::base::ScopedLockAssertion lockAssertion(mLock);
+        aaudio_result_t result = AAUDIO_ERROR_ILLEGAL_ARGUMENT;
+        switch (opCode) {
+            case START:
+                result = start_l();
+                timestampScheduler.setBurstPeriod(mFramesPerBurst, getSampleRate());
+                timestampScheduler.start(AudioClock::getNanoseconds());
+                nextTimestampReportTime = timestampScheduler.nextAbsoluteTime();
+                nextDataReportTime = nextDataReportTime_l();
+                break;
+            case PAUSE:
+                result = pause_l();
+                standbyTime = AudioClock::getNanoseconds() + IDLE_TIMEOUT_NANOS;
+                break;
+            case STOP:
+                result = stop_l();
+                standbyTime = AudioClock::getNanoseconds() + IDLE_TIMEOUT_NANOS;
+                break;
+            case FLUSH:
+                result = flush_l();
+                break;
+        }
+        return result;
+    };
+
     int32_t loopCount = 0;
     while (mThreadEnabled.load()) {
         loopCount++;
@@ -481,22 +523,10 @@ void AAudioServiceStreamBase::run() {
             std::scoped_lock<std::mutex> _commandLock(command->lock);
             switch (command->operationCode) {
                 case START:
-                    command->result = start_l();
-                    timestampScheduler.setBurstPeriod(mFramesPerBurst, getSampleRate());
-                    timestampScheduler.start(AudioClock::getNanoseconds());
-                    nextTimestampReportTime = timestampScheduler.nextAbsoluteTime();
-                    nextDataReportTime = nextDataReportTime_l();
-                    break;
                 case PAUSE:
-                    command->result = pause_l();
-                    standbyTime = AudioClock::getNanoseconds() + IDLE_TIMEOUT_NANOS;
-                    break;
                 case STOP:
-                    command->result = stop_l();
-                    standbyTime = AudioClock::getNanoseconds() + IDLE_TIMEOUT_NANOS;
-                    break;
                 case FLUSH:
-                    command->result = flush_l();
+                    command->result = runControlCommand(command->operationCode);
                     break;
                 case CLOSE:
                     command->result = close_l();
@@ -553,7 +583,36 @@ void AAudioServiceStreamBase::run() {
                 command->conditionVariable.notify_one();
             }
         }
+
+        // At most one ring of commands per loop, so that the timestamps are still sent.
+        AAudioCommandRing::Command ringCommand;
+        for (int32_t i = 0; i < AAudioCommandRing::kCapacity && mThreadEnabled
+                && mCommandRing.isConfigured() && mCommandRing.take(&ringCommand); i++) {
+            ALOGD("%s() got ring command %u after %d loops",
+                  __func__, ringCommand.command, loopCount);
+            aaudio_result_t result = AAUDIO_ERROR_ILLEGAL_ARGUMENT;
+            switch (ringCommand.command) {
+                case AAUDIO_CLIENT_COMMAND_START:
+                    result = runControlCommand(START);
+                    break;
+                case AAUDIO_CLIENT_COMMAND_PAUSE:
+                    result = runControlCommand(PAUSE);
+                    break;
+                case AAUDIO_CLIENT_COMMAND_STOP:
+                    result = runControlCommand(STOP);
+                    break;
+                case AAUDIO_CLIENT_COMMAND_FLUSH:
+                    result = runControlCommand(FLUSH);
+                    break;
+                default:
+                    ALOGE("Invalid ring command: %u", ringCommand.command);
+                    break;
+            }
+            mCommandRing.complete(ringCommand, result);
+        }
     }
+    // The client may be waiting for a command, or about to send one.
+    mCommandRing.close(AAUDIO_ERROR_INVALID_HANDLE);
     ALOGD("%s() %s exiting after %d loops <<<<<<<<<<<<<< COMMANDS",
           __func__, getTypeText(), loopCount);
 }
@@ -744,6 +803,10 @@ aaudio_result_t AAudioServiceStreamBase::getDescription_l(AudioEndpointParcelabl
         mUpMessageQueue->fillParcelable(parcelable,
                                         parcelable->mUpMessageQueueParcelable);
     }
+    if (mDownMessageQueue != nullptr) {
+        mDownMessageQueue->fillParcelable(parcelable,
+                                          parcelable->mDownMessageQueueParcelable);
+    }
     return getAudioDataDescription_l(parcelable);
 }
 
@@ -392,6 +392,11 @@ protected:
     std::mutex              mUpMessageQueueLock;
     std::shared_ptr<SharedRingBuffer> mUpMessageQueue PT_GUARDED_BY(mUpMessageQueueLock);
 
+    // Start, pause, stop and flush sent by the client without Binder.
+    // Set in open() before the command thread starts. Optional, so it may be null.
+    std::shared_ptr<SharedRingBuffer> mDownMessageQueue;
+    AAudioCommandRing       mCommandRing;
+
     enum : int32_t {
         START,
         PAUSE,
@@ -18,6 +18,7 @@
 //#define LOG_NDEBUG 0
 #include <utils/Log.h>
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
@@ -25,6 +26,7 @@
 #include <aaudio/AAudio.h>
 
 #include "binding/AAudioServiceMessage.h"
+#include "utility/AudioClock.h"
 #include "AAudioServiceStreamBase.h"
 #include "AAudioServiceStreamShared.h"
 #include "AAudioEndpointManager.h"
@@ -38,6 +40,9 @@ using namespace aaudio;
 #define DEFAULT_BURSTS_PER_BUFFER   16
 // This is an arbitrary range. TODO review.
 #define MAX_FRAMES_PER_BUFFER       (32 * 1024)
+// POWER_SAVING streams may be mixed in much larger bursts, so keep more headroom.
+#define POWER_SAVING_MIN_BURSTS_PER_BUFFER   4
+#define POWER_SAVING_DEFAULT_BUFFER_MILLIS   200
 
 AAudioServiceStreamShared::AAudioServiceStreamShared(AAudioService &audioService)
     : AAudioServiceStreamBase(audioService)
@@ -78,7 +83,8 @@ std::string AAudioServiceStreamShared::dump() const NO_THREAD_SAFETY_ANALYSIS {
 int32_t AAudioServiceStreamShared::calculateBufferCapacity(int32_t requestedCapacityFrames,
                                                            int32_t framesPerBurst,
                                                            int32_t requestedSampleRate,
-                                                           int32_t deviceSampleRate) {
+                                                           int32_t deviceSampleRate,
+                                                           aaudio_performance_mode_t performanceMode) {
     if (requestedSampleRate != AAUDIO_UNSPECIFIED && requestedSampleRate != deviceSampleRate) {
         // When sample rate conversion is needed, we use the device sample rate and the
         // requested sample rate to scale the capacity in configureDataInformation().
@@ -98,11 +104,24 @@ int32_t AAudioServiceStreamShared::calculateBufferCapacity(int32_t requestedCapa
         return AAUDIO_ERROR_OUT_OF_RANGE;
     }
 
+    if (framesPerBurst <= 0) {
+        ALOGE("calculateBufferCapacity() framesPerBurst = %d", framesPerBurst);
+        return AAUDIO_ERROR_OUT_OF_RANGE;
+    }
+
+    const bool powerSaving = performanceMode == AAUDIO_PERFORMANCE_MODE_POWER_SAVING;
     // Determine how many bursts will fit in the buffer.
     int32_t numBursts;
     if (requestedCapacityFrames == AAUDIO_UNSPECIFIED) {
-        // Use fewer bursts if default is too many.
-        if ((DEFAULT_BURSTS_PER_BUFFER * framesPerBurst) > MAX_FRAMES_PER_BUFFER) {
+        if (powerSaving && deviceSampleRate > 0) {
+            // Enough for the app to write rarely, whatever the burst of the endpoint.
+            const int64_t defaultFrames = static_cast<int64_t>(deviceSampleRate)
+                    * POWER_SAVING_DEFAULT_BUFFER_MILLIS / AAUDIO_MILLIS_PER_SECOND;
+            numBursts = static_cast<int32_t>(std::min<int64_t>(
+                    (defaultFrames + framesPerBurst - 1) / framesPerBurst,
+                    MAX_FRAMES_PER_BUFFER / framesPerBurst));
+        } else if ((DEFAULT_BURSTS_PER_BUFFER * framesPerBurst) > MAX_FRAMES_PER_BUFFER) {
+            // Use fewer bursts if default is too many.
             numBursts = MAX_FRAMES_PER_BUFFER / framesPerBurst;
         } else {
             numBursts = DEFAULT_BURSTS_PER_BUFFER;
@@ -113,8 +132,10 @@ int32_t AAudioServiceStreamShared::calculateBufferCapacity(int32_t requestedCapa
     }
 
     // Clip to bare minimum.
-    if (numBursts < MIN_BURSTS_PER_BUFFER) {
-        numBursts = MIN_BURSTS_PER_BUFFER;
+    const int32_t minBursts = powerSaving ? POWER_SAVING_MIN_BURSTS_PER_BUFFER
+                                          : MIN_BURSTS_PER_BUFFER;
+    if (numBursts < minBursts) {
+        numBursts = minBursts;
     }
     // Check for numeric overflow.
     if (numBursts > 0x8000 || framesPerBurst > 0x8000) {
@@ -183,7 +204,8 @@ aaudio_result_t AAudioServiceStreamShared::open(const aaudio::AAudioStreamReques
 
     setBufferCapacity(calculateBufferCapacity(configurationInput.getBufferCapacity(),
                                               mFramesPerBurst, configurationInput.getSampleRate(),
-                                              getSampleRate()));
+                                              getSampleRate(),
+                                              configurationInput.getPerformanceMode()));
     if (getBufferCapacity() < 0) {
         result = getBufferCapacity(); // negative error code
         setBufferCapacity(0);
@@ -101,12 +101,14 @@ protected:
     /**
      * @param requestedCapacityFrames
      * @param framesPerBurst
+     * @param performanceMode POWER_SAVING streams get a FIFO sized in time, not in bursts
      * @return capacity or negative error
      */
     static int32_t calculateBufferCapacity(int32_t requestedCapacityFrames,
                                            int32_t framesPerBurst,
                                            int32_t requestedSampleRate,
-                                           int32_t deviceSampleRate);
+                                           int32_t deviceSampleRate,
+                                           aaudio_performance_mode_t performanceMode);
 
 private:
 
@@ -97,6 +97,17 @@ void SharedRingBuffer::fillParcelable(AudioEndpointParcelable* endpointParcelabl
     ringBufferParcelable.setCapacityInFrames(mCapacityInFrames);
 }
 
+void SharedRingBuffer::fillDescriptor(RingBufferDescriptor *descriptor) const {
+    descriptor->dataAddress = &mSharedMemory[SHARED_RINGBUFFER_DATA_OFFSET];
+    descriptor->readCounterAddress = (fifo_counter_t *) &mSharedMemory[SHARED_RINGBUFFER_READ_OFFSET];
+    descriptor->writeCounterAddress =
+            (fifo_counter_t *) &mSharedMemory[SHARED_RINGBUFFER_WRITE_OFFSET];
+    descriptor->bytesPerFrame = mFifoBuffer->getBytesPerFrame();
+    descriptor->framesPerBurst = 1;
+    descriptor->capacityInFrames = mCapacityInFrames;
+    descriptor->flags = RingbufferFlags::NONE;
+}
+
 double SharedRingBuffer::getFractionalFullness() const {
   int32_t framesAvailable = mFifoBuffer->getFullFramesAvailable();
   int32_t capacity = mFifoBuffer->getBufferCapacityInFrames();
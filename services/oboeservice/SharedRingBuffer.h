@@ -48,6 +48,11 @@ public:
     void fillParcelable(AudioEndpointParcelable* endpointParcelable,
                         RingBufferParcelable &ringBufferParcelable);
 
+    /**
+     * Describe the shared memory as mapped in this process, as the client would resolve it.
+     */
+    void fillDescriptor(RingBufferDescriptor *descriptor) const;
+
     /**
      * Return available frames as a fraction of the capacity.
      * @return fullness between 0.0 and 1.0
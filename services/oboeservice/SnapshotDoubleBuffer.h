@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAUDIO_SNAPSHOT_DOUBLE_BUFFER_H
+#define AAUDIO_SNAPSHOT_DOUBLE_BUFFER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+
+namespace aaudio {
+
+/**
+ * Double buffer for a value that is read by ONE real-time thread without locking,
+ * and replaced occasionally by other threads.
+ *
+ * The reader accesses the value within the scope of a Reader, which only increments
+ * an epoch counter and loads the index of the current buffer.
+ * write() fills the other buffer and publishes it. If the reader is within a scope that
+ * may have started on the old buffer, write() waits until that scope ends, then resets
+ * the old buffer. So when write() returns, the old value is no longer seen by the reader,
+ * and it has been destroyed by the writer, not by the reader.
+ *
+ * Calls to write() must be serialized by the caller.
+ * write() must not be called from within a Reader scope.
+ */
+template <class T>
+class SnapshotDoubleBuffer {
+public:
+    class Reader {
+    public:
+        explicit Reader(SnapshotDoubleBuffer& buffer)
+                : mBuffer(buffer) {
+            mBuffer.mReaderEpoch++; // odd while reading
+            mValue = &mBuffer.mValues[mBuffer.mIndex.load()];
+        }
+
+        ~Reader() {
+            mBuffer.mReaderEpoch++;
+            if (mBuffer.mWriterWaiting.load()) {
+                std::lock_guard<std::mutex> lock(mBuffer.mRetireLock);
+                mBuffer.mRetireCondition.notify_all();
+            }
+        }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        const T& operator*() const { return *mValue; }
+        const T* operator->() const { return mValue; }
+
+    private:
+        SnapshotDoubleBuffer& mBuffer;
+        const T*              mValue;
+    };
+
+    void write(T value) {
+        const int32_t previous = mIndex.load();
+        mValues[previous ^ 1] = std::move(value);
+        mIndex.store(previous ^ 1);
+
+        // A scope that is open now may have loaded the previous index.
+        const uint32_t epoch = mReaderEpoch.load();
+        if (epoch & 1) {
+            std::unique_lock<std::mutex> lock(mRetireLock);
+            mWriterWaiting.store(true);
+            mRetireCondition.wait(lock, [this, epoch] { return mReaderEpoch.load() != epoch; });
+            mWriterWaiting.store(false);
+        }
+        mValues[previous] = T();
+    }
+
+private:
+    T                        mValues[2];
+    std::atomic<int32_t>     mIndex{0};
+    std::atomic<uint32_t>    mReaderEpoch{0};
+
+    // Only used when write() has to wait for the end of a Reader scope.
+    std::atomic<bool>        mWriterWaiting{false};
+    std::mutex               mRetireLock;
+    std::condition_variable  mRetireCondition;
+};
+
+} /* namespace aaudio */
+
+#endif //AAUDIO_SNAPSHOT_DOUBLE_BUFFER_H
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "AAudioMixer.h"
+
+using android::FifoBuffer;
+using android::FifoBufferAllocated;
+
+/*
+ * Measures the CPU time of one burst of the shared MMAP endpoint mixer
+ * against the number of client streams, as AAudioServiceEndpointPlay::callbackLoop()
+ * mixes them: clear, then mix a burst from the FIFO of each client.
+ *
+ * The gain argument selects the path taken for each stream:
+ *   0: unity gain, the default,
+ *   1: constant gain,
+ *   2: gain ramp, as after each gain change.
+ */
+
+namespace {
+
+constexpr int32_t kSampleRate = 48000;
+constexpr int32_t kFramesPerBurst = 192; // 4 ms
+constexpr int32_t kCapacityInFrames = 4 * kFramesPerBurst;
+
+} // namespace
+
+static void BM_AAudioMixerBurst(benchmark::State& state) {
+    const int32_t numClients = state.range(0);
+    const int32_t channelCount = state.range(1);
+    const int gainMode = state.range(2);
+
+    AAudioMixer mixer;
+    mixer.allocate(channelCount, kFramesPerBurst);
+
+    std::vector<std::shared_ptr<FifoBuffer>> fifos;
+    const std::vector<float> burst(kFramesPerBurst * channelCount, 0.25f);
+    for (int32_t i = 0; i < numClients; i++) {
+        auto fifo = std::make_shared<FifoBufferAllocated>(channelCount * sizeof(float),
+                                                          kCapacityInFrames);
+        // Fill the FIFO once, the client then keeps it full by advancing the write index.
+        for (int32_t frames = 0; frames < kCapacityInFrames; frames += kFramesPerBurst) {
+            fifo->write(burst.data(), kFramesPerBurst);
+        }
+        fifos.push_back(std::move(fifo));
+    }
+
+    const float gain = gainMode == 0 ? 1.0f : 0.5f;
+    const float previousGain = gainMode == 2 ? 0.0f : gain;
+    for (auto _ : state) {
+        mixer.clear();
+        for (int32_t i = 0; i < numClients; i++) {
+            mixer.mix(i, fifos[i], true /* allowUnderflow */, gain, previousGain);
+            fifos[i]->advanceWriteIndex(kFramesPerBurst);
+        }
+        benchmark::DoNotOptimize(mixer.getOutputBuffer());
+        benchmark::ClobberMemory();
+    }
+
+    state.SetItemsProcessed(state.iterations() * numClients * kFramesPerBurst);
+    state.counters["burst_us"] = kFramesPerBurst * 1e6 / kSampleRate;
+}
+
+BENCHMARK(BM_AAudioMixerBurst)
+        ->ArgNames({"clients", "channels", "gain"})
+        ->ArgsProduct({{1, 2, 4, 8, 16}, {2, 8}, {0, 1, 2}})
+        ->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
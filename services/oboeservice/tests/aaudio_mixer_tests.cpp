@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "AAudioMixer.h"
+
+using android::FifoBuffer;
+using android::FifoBufferAllocated;
+
+namespace {
+
+constexpr int32_t kChannelCount = 2;
+constexpr int32_t kFramesPerBurst = 11; // odd, to exercise the SIMD tails
+constexpr int32_t kCapacityInFrames = 32;
+
+std::shared_ptr<FifoBuffer> makeFifo() {
+    return std::make_shared<FifoBufferAllocated>(kChannelCount * sizeof(float),
+                                                 kCapacityInFrames);
+}
+
+// Write numFrames frames with every sample set to value.
+void writeFrames(const std::shared_ptr<FifoBuffer>& fifo, int32_t numFrames, float value) {
+    const std::vector<float> samples(numFrames * kChannelCount, value);
+    ASSERT_EQ(numFrames, fifo->write(samples.data(), numFrames));
+}
+
+class AAudioMixerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        mMixer.allocate(kChannelCount, kFramesPerBurst);
+        mMixer.clear();
+    }
+
+    float sample(int32_t frame, int32_t channel) {
+        return mMixer.getOutputBuffer()[frame * kChannelCount + channel];
+    }
+
+    AAudioMixer mMixer;
+};
+
+} // namespace
+
+TEST_F(AAudioMixerTest, SumsStreams) {
+    auto fifo1 = makeFifo();
+    auto fifo2 = makeFifo();
+    writeFrames(fifo1, kFramesPerBurst, 0.25f);
+    writeFrames(fifo2, kFramesPerBurst, 0.5f);
+
+    EXPECT_EQ(kFramesPerBurst, mMixer.mix(0, fifo1, true /* allowUnderflow */));
+    EXPECT_EQ(kFramesPerBurst, mMixer.mix(1, fifo2, true /* allowUnderflow */));
+    for (int32_t frame = 0; frame < kFramesPerBurst; frame++) {
+        for (int32_t channel = 0; channel < kChannelCount; channel++) {
+            EXPECT_EQ(0.75f, sample(frame, channel));
+        }
+    }
+}
+
+TEST_F(AAudioMixerTest, ConstantGain) {
+    auto fifo = makeFifo();
+    writeFrames(fifo, kFramesPerBurst, 0.5f);
+
+    EXPECT_EQ(kFramesPerBurst, mMixer.mix(0, fifo, true /* allowUnderflow */,
+                                          0.5f /* gain */, 0.5f /* previousGain */));
+    for (int32_t frame = 0; frame < kFramesPerBurst; frame++) {
+        for (int32_t channel = 0; channel < kChannelCount; channel++) {
+            EXPECT_EQ(0.25f, sample(frame, channel));
+        }
+    }
+}
+
+TEST_F(AAudioMixerTest, GainRampAcrossWrap) {
+    auto fifo = makeFifo();
+    // Place the burst across the end of the FIFO so that it is mixed in two parts.
+    writeFrames(fifo, kCapacityInFrames - 5, 0.0f);
+    fifo->advanceReadIndex(kCapacityInFrames - 5);
+    writeFrames(fifo, kFramesPerBurst, 1.0f);
+
+    EXPECT_EQ(kFramesPerBurst, mMixer.mix(0, fifo, true /* allowUnderflow */,
+                                          1.0f /* gain */, 0.0f /* previousGain */));
+    for (int32_t frame = 0; frame < kFramesPerBurst; frame++) {
+        const float expected = (frame + 1) / (float) kFramesPerBurst;
+        for (int32_t channel = 0; channel < kChannelCount; channel++) {
+            EXPECT_NEAR(expected, sample(frame, channel), 1e-6f) << "frame " << frame;
+        }
+    }
+}
+
+TEST_F(AAudioMixerTest, Underflow) {
+    auto fifo = makeFifo();
+    writeFrames(fifo, 4, 1.0f);
+
+    // Drain what is available without advancing past the write index.
+    EXPECT_EQ(4, mMixer.mix(0, fifo, false /* allowUnderflow */));
+    EXPECT_EQ(4, fifo->getReadCounter());
+    EXPECT_EQ(0.0f, sample(4, 0));
+
+    // Advance by a full burst regardless, to keep the timing.
+    writeFrames(fifo, 4, 1.0f);
+    mMixer.clear();
+    EXPECT_EQ(4, mMixer.mix(0, fifo, true /* allowUnderflow */));
+    EXPECT_EQ(4 + kFramesPerBurst, fifo->getReadCounter());
+    EXPECT_EQ(1.0f, sample(3, 1));
+    EXPECT_EQ(0.0f, sample(4, 0));
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2024 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "SnapshotDoubleBuffer.h"
+
+using aaudio::SnapshotDoubleBuffer;
+
+namespace {
+
+// Records the thread that destroys it.
+class Tracker {
+public:
+    Tracker(int value, std::atomic<std::thread::id>* destroyedBy)
+            : mValue(value)
+            , mDestroyedBy(destroyedBy) {}
+
+    ~Tracker() {
+        mDestroyedBy->store(std::this_thread::get_id());
+    }
+
+    int value() const { return mValue; }
+
+private:
+    const int                      mValue;
+    std::atomic<std::thread::id>*  mDestroyedBy;
+};
+
+using TrackerBuffer = SnapshotDoubleBuffer<std::shared_ptr<Tracker>>;
+
+} // namespace
+
+TEST(SnapshotDoubleBufferTest, ReaderSeesLatestWrite) {
+    std::atomic<std::thread::id> destroyedBy;
+    TrackerBuffer buffer;
+    {
+        const TrackerBuffer::Reader reader(buffer);
+        EXPECT_EQ(nullptr, *reader);
+    }
+    buffer.write(std::make_shared<Tracker>(1, &destroyedBy));
+    buffer.write(std::make_shared<Tracker>(2, &destroyedBy));
+    const TrackerBuffer::Reader reader(buffer);
+    EXPECT_EQ(2, (*reader)->value());
+}
+
+TEST(SnapshotDoubleBufferTest, WriteWaitsForOpenScope) {
+    std::atomic<std::thread::id> destroyedBy;
+    TrackerBuffer buffer;
+    buffer.write(std::make_shared<Tracker>(1, &destroyedBy));
+
+    std::atomic<bool> written{false};
+    std::thread::id writerId;
+    std::thread writer;
+    {
+        const TrackerBuffer::Reader reader(buffer);
+        writer = std::thread([&]() {
+            buffer.write(std::make_shared<Tracker>(2, &destroyedBy));
+            written = true;
+        });
+        writerId = writer.get_id();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        EXPECT_FALSE(written.load());
+        // The value of the open scope is still alive.
+        EXPECT_EQ(1, (*reader)->value());
+    }
+    writer.join();
+    EXPECT_TRUE(written.load());
+    // The previous value was released by the writer, not by the reader.
+    EXPECT_EQ(writerId, destroyedBy.load());
+
+    const TrackerBuffer::Reader reader(buffer);
+    EXPECT_EQ(2, (*reader)->value());
+}
+
+// The reader only sees live values, in the order they were written.
+// Run with a sanitizer to catch a use after free.
+TEST(SnapshotDoubleBufferTest, ConcurrentReadsAndWrites) {
+    constexpr int kNumWrites = 2000;
+    std::atomic<std::thread::id> destroyedBy;
+    TrackerBuffer buffer;
+    buffer.write(std::make_shared<Tracker>(0, &destroyedBy));
+
+    std::atomic<bool> done{false};
+    std::thread reader([&]() {
+        int previous = 0;
+        while (!done.load()) {
+            const TrackerBuffer::Reader scope(buffer);
+            const int value = (*scope)->value();
+            EXPECT_GE(value, previous);
+            previous = value;
+        }
+    });
+    for (int i = 1; i <= kNumWrites; i++) {
+        buffer.write(std::make_shared<Tracker>(i, &destroyedBy));
+    }
+    done = true;
+    reader.join();
+}